@@ -83,9 +83,15 @@ freely, subject to the following restrictions:
 #include <donut/core/log.h>
 
 #include <list>
+#include <memory>
 #include <functional>
 #include <optional>
 
+namespace donut::engine
+{
+    class GpuProfiler;
+}
+
 namespace donut::app
 {
     struct DefaultMessageCallback : public nvrhi::IMessageCallback
@@ -162,6 +168,10 @@ namespace donut::app
         bool enableComputeQueue = false;
         bool enableCopyQueue = false;
 
+        // Creates an engine::GpuProfiler after the device and makes it current, so that render passes record their
+        // GPU durations. The profiler is updated by the message loop, see DeviceManager::GetGpuProfiler.
+        bool enableGpuProfiler = false;
+
         // Index of the adapter (DX11, DX12) or physical device (Vk) on which to initialize the device.
         // Negative values mean automatic detection.
         // The order of indices matches that returned by DeviceManager::EnumerateAdapters.
@@ -298,8 +308,12 @@ namespace donut::app
 
         std::vector<nvrhi::FramebufferHandle> m_SwapChainFramebuffers;
 
+        std::shared_ptr<engine::GpuProfiler> m_GpuProfiler;
+
         DeviceManager();
 
+        void CreateGpuProfiler();
+
         void UpdateWindowSize();
         bool ShouldRenderUnfocused() const;
 
@@ -357,6 +371,9 @@ namespace donut::app
         [[nodiscard]] GLFWwindow* GetWindow() const { return m_Window; }
         [[nodiscard]] uint32_t GetFrameIndex() const { return m_FrameIndex; }
 
+        // Returns the profiler created with DeviceCreationParameters::enableGpuProfiler, or nullptr.
+        [[nodiscard]] const std::shared_ptr<engine::GpuProfiler>& GetGpuProfiler() const { return m_GpuProfiler; }
+
         virtual nvrhi::ITexture* GetCurrentBackBuffer() = 0;
         virtual nvrhi::ITexture* GetBackBuffer(uint32_t index) = 0;
         virtual uint32_t GetCurrentBackBufferIndex() = 0;
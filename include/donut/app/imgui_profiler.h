@@ -0,0 +1,74 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <donut/core/trace.h>
+#include <donut/engine/GpuProfiler.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace donut::app
+{
+	// ImGui window that shows the CPU zones collected by donut::trace:
+	// a frame time graph, a per-thread timeline of the selected frame, and the zone totals.
+	// When a GpuProfiler is current, the GPU durations of the same frame are listed as well.
+	class ImGui_Profiler
+	{
+	public:
+
+		struct Options
+		{
+			std::filesystem::path exportPath = "donut_trace.json"; // written by the "Export" button
+			float rowHeight = 18.f;                                  // height of one nesting level in the timeline
+		};
+
+		ImGui_Profiler() = default;
+
+		explicit ImGui_Profiler(Options const& opts) : m_Options(opts) { }
+
+		void Render(bool* open = nullptr);
+
+	private:
+
+		void RenderTimeline(trace::FrameRecord const& frame, std::vector<std::string> const& threadNames);
+
+		void RenderZoneTotals(trace::FrameRecord const& frame);
+
+		void RenderGpuZones(uint64_t frameIndex);
+
+	private:
+
+		Options m_Options;
+
+		bool m_Paused = false;
+		int m_SelectedFrame = -1; // index into m_Frames, -1 means the latest frame
+		float m_Zoom = 1.f;
+		std::vector<trace::FrameRecord> m_Frames;
+		std::vector<engine::GpuFrameRecord> m_GpuFrames;
+		std::string m_ExportStatus;
+	};
+
+} // namespace donut::app
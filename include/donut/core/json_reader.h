@@ -0,0 +1,116 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Json
+{
+    class Value;
+}
+
+namespace donut::json
+{
+    // Pull parser that reads JSON directly from a memory buffer, without building a document tree.
+    // It accepts the same relaxed syntax as the jsoncpp reader used by LoadFromFile: comments and trailing commas.
+    // 
+    // Objects are read with BeginObject followed by NextMember until it returns false, and arrays with
+    // BeginArray followed by NextElement. After NextMember or NextElement returns true, exactly one value
+    // must be consumed with one of the Read functions, Skip, or a nested Begin.
+    // 
+    // Once an error is encountered, all functions return false and GetErrorMessage describes the first error.
+    class Reader
+    {
+    public:
+        enum class ValueType
+        {
+            Invalid,
+            Null,
+            Boolean,
+            Number,
+            String,
+            Array,
+            Object
+        };
+
+        // The buffer must stay valid while the reader and the strings returned by it are used.
+        Reader(const char* data, size_t size);
+
+        // Returns the type of the next value without consuming it.
+        [[nodiscard]] ValueType Peek();
+
+        bool BeginObject();
+        bool NextMember(std::string_view& key);
+
+        bool BeginArray();
+        bool NextElement();
+
+        // Strings without escape sequences are returned as views into the buffer, other strings are decoded
+        // into an internal buffer that is overwritten by the next string.
+        bool ReadString(std::string_view& value);
+        bool ReadNumber(double& value);
+        bool ReadBool(bool& value);
+        bool ReadNull();
+
+        // Reads a number or an array of numbers, storing up to maxCount of them, and returns the number of
+        // array elements (1 for a single number), or -1 if the value is something else, which is skipped.
+        int ReadNumbers(double* values, int maxCount);
+
+        // Consumes the next value of any type, including nested objects and arrays.
+        bool Skip();
+
+        // Reads the next value into a jsoncpp document tree, for the parts of a file that are processed by
+        // code that expects one. Numbers are stored as integers when they are written without a fraction or exponent.
+        bool ReadValue(Json::Value& value);
+
+        // The offset of the next value, for returning to it later with SetOffset.
+        [[nodiscard]] size_t GetOffset();
+        void SetOffset(size_t offset);
+
+        [[nodiscard]] bool HasError() const { return !m_Error.empty(); }
+        [[nodiscard]] std::string GetErrorMessage() const;
+
+    private:
+        const char* m_Data;
+        size_t m_Size;
+        size_t m_Position = 0;
+        std::string m_Error;
+        size_t m_ErrorPosition = 0;
+        std::string m_Scratch;
+        std::vector<bool> m_HasItem; // For every open object or array, whether an item was read from it
+
+        void SkipWhitespace();
+        bool Expect(char c);
+        bool SetError(const char* message);
+        bool ParseString(std::string_view& value);
+        bool SkipString();
+        bool ScanNumber(std::string_view& token, bool& isInteger);
+        bool MatchLiteral(const char* literal);
+        bool NextInContainer(char closing);
+    };
+}
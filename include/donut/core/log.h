@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <functional>
 
 namespace donut::log
@@ -66,6 +67,30 @@ namespace donut::log
     // - EnableOutputToMessageBox(false);
     void ConsoleApplicationMode();
 
+    // Enables or disables the asynchronous logging mode.
+    // In this mode, messages are formatted on the calling thread and placed into a lock-free queue,
+    // and a background thread passes them to the callback. The callback is therefore called from that thread.
+    // When the queue is full, debug and info messages are dropped, and more severe messages wait for space.
+    // Fatal messages flush the queue and are delivered on the calling thread.
+    // Disabling the mode flushes the queue and stops the background thread.
+    // Should not be called while other threads are logging. The queue capacity is rounded up to a power of 2.
+    void EnableAsyncMode(bool enable, size_t queueCapacity = 256);
+
+    // Waits until all messages queued in the asynchronous mode are delivered to the callback.
+    // Has no effect in the synchronous mode.
+    void Flush();
+
+    // Asynchronous mode: a message that is repeated more than 'maxRepeats' times within 'intervalSeconds'
+    // is suppressed for the rest of the interval, and a summary with the number of suppressed copies is logged after it.
+    // Use maxRepeats = 0 to disable the limit, which is the default.
+    void SetRepeatedMessageLimit(uint32_t maxRepeats, float intervalSeconds = 1.f);
+
+    // Enables or disables printing of the time since startup and the logging thread index by the default callback.
+    void EnableTimestamps(bool enable);
+
+    // Returns the number of messages dropped in the asynchronous mode because the queue was full.
+    uint64_t GetDroppedMessageCount();
+
     void message(Severity severity, const char* fmt...);
     void debug(const char* fmt...);
     void info(const char* fmt...);
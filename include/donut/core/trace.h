@@ -0,0 +1,135 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// CPU tracing of scoped zones. Each thread records completed zones into its own lock-free buffer,
+// and trace::EndFrame collects them into a per-frame history that can be viewed or exported.
+// When tracing is disabled, a zone costs one relaxed atomic load.
+// Define DONUT_DISABLE_TRACING to compile the zone macros out completely.
+
+namespace donut::trace
+{
+    struct ZoneRecord
+    {
+        const char* name = nullptr; // Must be a string with static storage duration, such as a literal
+        uint64_t beginNs = 0;       // Time since the tracing epoch
+        uint64_t endNs = 0;
+        uint32_t threadIndex = 0;   // Index into GetThreadNames()
+        uint32_t depth = 0;         // Nesting level within the thread
+    };
+
+    struct FrameRecord
+    {
+        uint64_t frameIndex = 0;
+        uint64_t beginNs = 0;
+        uint64_t endNs = 0;
+        std::vector<ZoneRecord> zones; // Sorted by thread and begin time
+    };
+
+    struct TraceStats
+    {
+        uint64_t recordedZones = 0;
+        uint64_t droppedZones = 0; // Zones lost because a thread buffer was full
+        uint32_t threadCount = 0;
+    };
+
+    extern std::atomic<bool> g_Enabled;
+
+    void Enable(bool enable);
+    inline bool IsEnabled() { return g_Enabled.load(std::memory_order_relaxed); }
+
+    // Sets the number of frames kept by EndFrame, 120 by default.
+    void SetHistoryLength(uint32_t frames);
+
+    // Names the calling thread in the views and exports, for example "Main" or "Worker 3".
+    void SetThreadName(const char* name);
+
+    [[nodiscard]] uint64_t GetTimeNs();
+
+    // Records a zone that was measured externally. Normally called by ScopedZone.
+    void RecordZone(const char* name, uint64_t beginNs, uint64_t endNs, uint32_t depth);
+
+    // Creates a named track that is not tied to a thread, for zones measured elsewhere, such as on the GPU.
+    // Returns the track index to pass to RecordTrackZone. Each track must be written by one thread at a time.
+    [[nodiscard]] uint32_t RegisterTrack(const char* name);
+    void RecordTrackZone(uint32_t track, const char* name, uint64_t beginNs, uint64_t endNs, uint32_t depth);
+
+    // Collects the zones that all threads completed since the previous call into a new frame record.
+    // Should be called by the main thread once per frame, typically by DeviceManager.
+    void EndFrame(uint64_t frameIndex);
+
+    // Returns a copy of the collected frames, the oldest first.
+    [[nodiscard]] std::vector<FrameRecord> GetFrameHistory();
+    [[nodiscard]] std::vector<std::string> GetThreadNames();
+    [[nodiscard]] TraceStats GetStats();
+    void ClearHistory();
+
+    // Writes the collected frames in the Chrome trace event format, which can be opened
+    // in chrome://tracing or ui.perfetto.dev.
+    bool WriteChromeTrace(const std::filesystem::path& fileName);
+
+    class ScopedZone
+    {
+    public:
+        explicit ScopedZone(const char* name)
+        {
+            if (IsEnabled())
+                Begin(name);
+        }
+
+        ~ScopedZone()
+        {
+            if (m_Name)
+                End();
+        }
+
+        ScopedZone(const ScopedZone&) = delete;
+        ScopedZone& operator=(const ScopedZone&) = delete;
+
+    private:
+        const char* m_Name = nullptr;
+        uint64_t m_BeginNs = 0;
+        uint32_t m_Depth = 0;
+
+        void Begin(const char* name);
+        void End();
+    };
+}
+
+#define DONUT_TRACE_CONCAT_INNER(a, b) a##b
+#define DONUT_TRACE_CONCAT(a, b) DONUT_TRACE_CONCAT_INNER(a, b)
+
+#ifdef DONUT_DISABLE_TRACING
+#define DONUT_TRACE_ZONE(name)
+#define DONUT_TRACE_FUNCTION()
+#else
+#define DONUT_TRACE_ZONE(name) donut::trace::ScopedZone DONUT_TRACE_CONCAT(donutTraceZone_, __LINE__)(name)
+#define DONUT_TRACE_FUNCTION() DONUT_TRACE_ZONE(__func__)
+#endif
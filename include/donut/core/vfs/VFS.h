@@ -99,6 +99,11 @@ namespace donut::vfs
         // Returns nullptr if the file cannot be read.
         virtual std::shared_ptr<IBlob> readFile(const std::filesystem::path& name) = 0;
 
+        // Map the entire file into memory for reading, where supported, or read it otherwise.
+        // The mapping is released when the blob is destroyed; the file should not be modified while it's mapped.
+        // Returns nullptr if the file cannot be read.
+        virtual std::shared_ptr<IBlob> mapFile(const std::filesystem::path& name) { return readFile(name); }
+
         // Write the entire file.
         // Returns false if the file cannot be written.
         virtual bool writeFile(const std::filesystem::path& name, const void* data, size_t size) = 0;
@@ -122,6 +127,7 @@ namespace donut::vfs
         bool folderExists(const std::filesystem::path& name) override;
         bool fileExists(const std::filesystem::path& name) override;
         std::shared_ptr<IBlob> readFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> mapFile(const std::filesystem::path& name) override;
         bool writeFile(const std::filesystem::path& name, const void* data, size_t size) override;
         int enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates = false) override;
         int enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates = false) override;
@@ -143,6 +149,7 @@ namespace donut::vfs
         bool folderExists(const std::filesystem::path& name) override;
         bool fileExists(const std::filesystem::path& name) override;
         std::shared_ptr<IBlob> readFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> mapFile(const std::filesystem::path& name) override;
         bool writeFile(const std::filesystem::path& name, const void* data, size_t size) override;
         int enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates = false) override;
         int enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates = false) override;
@@ -164,6 +171,7 @@ namespace donut::vfs
         bool folderExists(const std::filesystem::path& name) override;
         bool fileExists(const std::filesystem::path& name) override;
         std::shared_ptr<IBlob> readFile(const std::filesystem::path& name) override;
+        std::shared_ptr<IBlob> mapFile(const std::filesystem::path& name) override;
         bool writeFile(const std::filesystem::path& name, const void* data, size_t size) override;
         int enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions, enumerate_callback_t callback, bool allowDuplicates = false) override;
         int enumerateDirectories(const std::filesystem::path& path, enumerate_callback_t callback, bool allowDuplicates = false) override;
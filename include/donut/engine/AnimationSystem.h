@@ -0,0 +1,111 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/engine/SceneGraph.h>
+#include <memory>
+#include <vector>
+
+namespace tf
+{
+    class Executor;
+}
+
+namespace donut::engine
+{
+    // Plays multiple SceneGraphAnimations on a scene graph, with weighted blending between clips that animate the same nodes.
+    // On every Update, all active clips are evaluated in parallel when an executor is provided. The results are then
+    // blended per node in the order in which the clips were started, which makes the output independent of the number
+    // of threads, and written with a single SceneGraph::SetNodeTransforms call.
+    // With one clip per node and a weight of 1, the result is the same as calling SceneGraphAnimation::Apply.
+    // When the total weight of the clips that animate a node is below 1, the rest of the weight goes to the node's
+    // rest pose, which is its transform when the system first animated it. Larger total weights are normalized.
+    class AnimationSystem
+    {
+    public:
+        typedef int PlaybackHandle;
+
+    private:
+        struct Playback
+        {
+            PlaybackHandle handle = -1;
+            std::shared_ptr<SceneGraphAnimation> animation;
+            std::unique_ptr<CompiledAnimationClip> clip;
+            std::vector<uint32_t> nodeSlots; // Index into m_Slots for every node track of the clip
+            float time = 0.f;
+            float weight = 1.f;
+            float speed = 1.f;
+            bool loop = true;
+        };
+
+        // Blending accumulators for one animated node
+        struct NodeSlot
+        {
+            SceneGraphNode* node = nullptr;
+            dm::double3 translation = 0.0;
+            dm::double4 rotation = 0.0;
+            dm::double3 scaling = 0.0;
+            double translationWeight = 0.0;
+            double rotationWeight = 0.0;
+            double scalingWeight = 0.0;
+            dm::double3 restTranslation = 0.0;
+            dm::dquat restRotation;
+            dm::double3 restScaling = 1.0;
+        };
+
+        std::shared_ptr<SceneGraph> m_Graph;
+        std::vector<Playback> m_Playbacks;
+        std::vector<NodeSlot> m_Slots;
+        std::vector<Playback*> m_ActivePlaybacks;
+        std::vector<SceneGraphNodeTransform> m_Transforms;
+        PlaybackHandle m_NextHandle = 0;
+        bool m_SlotsDirty = false;
+
+        Playback* FindPlayback(PlaybackHandle handle);
+        const Playback* FindPlayback(PlaybackHandle handle) const;
+        void UpdateSlots();
+
+    public:
+        explicit AnimationSystem(std::shared_ptr<SceneGraph> graph);
+
+        // Starts playing an animation and returns a handle to control the playback.
+        PlaybackHandle Play(const std::shared_ptr<SceneGraphAnimation>& animation, float weight = 1.f, bool loop = true);
+        void Stop(PlaybackHandle playback);
+        void StopAll();
+
+        void SetWeight(PlaybackHandle playback, float weight);
+        void SetSpeed(PlaybackHandle playback, float speed);
+        void SetTime(PlaybackHandle playback, float time);
+        [[nodiscard]] float GetTime(PlaybackHandle playback) const;
+        [[nodiscard]] size_t GetPlaybackCount() const { return m_Playbacks.size(); }
+
+        // Recompiles all clips. Must be called when nodes targeted by the playing animations are removed from the graph.
+        void Recompile();
+
+        // Advances the time of all playbacks, wrapping looped ones around their duration.
+        void Advance(float elapsedTime);
+
+        // Evaluates all playbacks with non-zero weights and writes the blended results into the graph.
+        void Update(tf::Executor* executor = nullptr);
+    };
+}
@@ -0,0 +1,188 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace donut::engine
+{
+    struct ReadbackImage
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        nvrhi::Format format = nvrhi::Format::UNKNOWN;
+        size_t rowPitch = 0;            // Rows are densely packed: width times the size of a pixel
+        std::vector<uint8_t> data;      // Empty if the readback failed
+    };
+
+    struct AsyncReadbackStats
+    {
+        uint32_t pendingRequests = 0;   // Requests recorded and not delivered yet
+        uint64_t completedRequests = 0; // Requests delivered since the service was created
+        uint64_t stalls = 0;            // Times BeginFrame had to wait for the GPU to finish an old frame
+        uint32_t stagingBuffers = 0;    // Staging resources owned by the service, in use or not
+        uint32_t stagingTextures = 0;
+    };
+
+    // Reads buffers and textures back from the GPU without stalling the CPU.
+    // The Read functions record a copy into a staging resource, which is taken from a pool and grouped with the other
+    // requests of the frame in a ring of framesInFlight slots. EndFrame sets an event query after the frame's command
+    // lists, and the following BeginFrame and Poll calls deliver the data of the frames whose query has completed,
+    // usually two or three frames later. BeginFrame only waits when the GPU is so far behind that the ring slot of the
+    // new frame is still in flight.
+    //
+    // The staging resources are returned to the pool when their request is delivered, and released by BeginFrame when
+    // they have not been used for more than framesInFlight frames, e.g. after the size of a texture read back every
+    // frame has changed.
+    //
+    // The results are delivered through an optional callback and a future, both on the thread that calls BeginFrame,
+    // Poll or Flush. The texture callback runs first and may move the image data out to avoid a copy, in which case
+    // the future receives an image without data. The service is not thread-safe; it should be used from the render thread only, which must not
+    // wait for the futures, since they are only fulfilled by that thread.
+    class AsyncReadback
+    {
+    public:
+        typedef std::function<void(const std::vector<uint8_t>& data)> BufferCallback;
+        typedef std::function<void(ReadbackImage& image)> TextureCallback;
+
+        // What BeginFrame does with the ring slot of the new frame
+        enum class SlotReuse
+        {
+            Free,           // No requests left from an older frame
+            Wait,           // The requests of an older frame are still in flight: wait for them and deliver them first
+            SubmitAndWait   // Same, but EndFrame was not called for that frame, so its query must be set first
+        };
+
+        explicit AsyncReadback(nvrhi::IDevice* device, uint32_t framesInFlight = 3);
+        ~AsyncReadback();
+
+        // Starts recording the requests of a frame and delivers the completed ones.
+        void BeginFrame(uint32_t frameIndex);
+
+        // Must be called after the command lists that recorded the requests of the frame have been executed.
+        void EndFrame(nvrhi::CommandQueue queue = nvrhi::CommandQueue::Graphics);
+
+        // Delivers the requests whose frames the GPU has finished, without waiting.
+        void Poll();
+
+        // Waits for the GPU to finish all submitted frames and delivers their requests.
+        void Flush();
+
+        // Copies size bytes of the buffer, starting at offset, into a staging buffer.
+        std::future<std::vector<uint8_t>> ReadBuffer(
+            nvrhi::ICommandList* commandList,
+            nvrhi::IBuffer* buffer,
+            uint64_t offset,
+            uint64_t size,
+            BufferCallback callback = nullptr);
+
+        // Copies one 2D slice of a texture into a staging texture.
+        // Block-compressed formats are not supported: the callback and the future immediately receive an image without data.
+        std::future<ReadbackImage> ReadTexture(
+            nvrhi::ICommandList* commandList,
+            nvrhi::ITexture* texture,
+            const nvrhi::TextureSlice& slice = nvrhi::TextureSlice(),
+            TextureCallback callback = nullptr);
+
+        [[nodiscard]] AsyncReadbackStats GetStats() const;
+
+        // Returns the ring slot that records the requests of a frame.
+        [[nodiscard]] static uint32_t GetSlotIndex(uint32_t frameIndex, uint32_t numSlots) { return frameIndex % numSlots; }
+
+        // Decides whether a slot that is about to record a new frame still holds requests, which is a stall.
+        [[nodiscard]] static SlotReuse GetSlotReuse(bool hasRequests, bool submitted);
+
+        struct FreeBuffer
+        {
+            nvrhi::BufferHandle buffer;
+            uint32_t lastUsedFrame = 0;
+        };
+
+        struct FreeTexture
+        {
+            nvrhi::StagingTextureHandle texture;
+            uint32_t lastUsedFrame = 0;
+        };
+
+        // Returns the index of the smallest free staging buffer that can hold size bytes, or -1 if there is none.
+        [[nodiscard]] static int FindFreeBuffer(const std::vector<FreeBuffer>& freeBuffers, uint64_t size);
+
+        // Returns the index of a free staging texture with the size and format of desc, or -1 if there is none.
+        [[nodiscard]] static int FindFreeTexture(const std::vector<FreeTexture>& freeTextures, const nvrhi::TextureDesc& desc);
+
+        // Removes the free resources that were last used more than maxUnusedFrames frames before frameIndex,
+        // and returns how many were removed.
+        template<typename FreeResource>
+        static uint32_t ReleaseUnused(std::vector<FreeResource>& freeResources, uint32_t frameIndex, uint32_t maxUnusedFrames)
+        {
+            size_t count = freeResources.size();
+            freeResources.erase(std::remove_if(freeResources.begin(), freeResources.end(),
+                [frameIndex, maxUnusedFrames](const FreeResource& resource)
+                {
+                    return frameIndex - resource.lastUsedFrame > maxUnusedFrames;
+                }), freeResources.end());
+            return uint32_t(count - freeResources.size());
+        }
+
+    private:
+        struct Request
+        {
+            nvrhi::BufferHandle stagingBuffer;
+            uint64_t size = 0;
+            std::promise<std::vector<uint8_t>> bufferPromise;
+            BufferCallback bufferCallback;
+
+            nvrhi::StagingTextureHandle stagingTexture;
+            std::promise<ReadbackImage> texturePromise;
+            TextureCallback textureCallback;
+        };
+
+        struct FrameSlot
+        {
+            nvrhi::EventQueryHandle query;
+            std::vector<std::unique_ptr<Request>> requests;
+            bool submitted = false;
+        };
+
+        nvrhi::DeviceHandle m_Device;
+        std::vector<FrameSlot> m_Slots;
+        uint32_t m_CurrentSlot = 0;
+        uint32_t m_FrameIndex = 0;
+        std::vector<FreeBuffer> m_FreeBuffers;
+        std::vector<FreeTexture> m_FreeTextures;
+        uint32_t m_StagingBufferCount = 0;
+        uint32_t m_StagingTextureCount = 0;
+        uint64_t m_CompletedRequests = 0;
+        uint64_t m_Stalls = 0;
+
+        nvrhi::BufferHandle AcquireBuffer(uint64_t size);
+        nvrhi::StagingTextureHandle AcquireTexture(const nvrhi::TextureDesc& desc);
+        void CompleteRequest(Request& request);
+        void CompleteSlot(FrameSlot& slot);
+    };
+}
@@ -0,0 +1,91 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <memory>
+#include <filesystem>
+
+namespace donut::vfs
+{
+    class IFileSystem;
+}
+
+namespace donut::engine
+{
+    struct SceneImportResult;
+    struct SceneLoadingStats;
+    class TextureCache;
+    class SceneTypeFactory;
+}
+
+namespace tf
+{
+    class Executor;
+}
+
+/*
+Baked scenes store a model in a chunk file in the form that the engine uses at runtime.
+
+The vertex and index data is stored in the final GPU buffer layout, with normals and tangents already
+packed and tangents already generated, so the loader doesn't do any per-vertex work. The file is memory-mapped,
+and the buffer groups of the loaded meshes point directly into the mapping until Scene uploads them.
+
+The file also contains the node hierarchy with mesh instances, lights and cameras, the materials,
+the node animations, and references to the texture files relative to the baked file.
+Skinning, morph targets and material animations are not stored: skinned meshes are baked in their bind pose.
+
+glTF models are converted with the donut_scene_baker tool, see tools/scene_baker.cpp, which is built when
+DONUT_WITH_TOOLS is enabled. Scene loads the baked files like any other model file.
+*/
+
+namespace donut::engine
+{
+    constexpr const char* c_BakedSceneExtension = ".bscene";
+
+    [[nodiscard]] bool IsBakedSceneFile(const std::filesystem::path& fileName);
+
+    // Writes a model into a baked scene file. The model must still have its vertex data on the CPU,
+    // i.e. it must be baked right after it has been imported, before a Scene creates its GPU buffers.
+    bool BakeScene(
+        vfs::IFileSystem& fs,
+        const std::filesystem::path& fileName,
+        const SceneImportResult& model);
+
+    class BakedSceneLoader
+    {
+    protected:
+        std::shared_ptr<vfs::IFileSystem> m_fs;
+        std::shared_ptr<SceneTypeFactory> m_SceneTypeFactory;
+
+    public:
+        explicit BakedSceneLoader(std::shared_ptr<vfs::IFileSystem> fs, std::shared_ptr<SceneTypeFactory> sceneTypeFactory);
+
+        bool Load(
+            const std::filesystem::path& fileName,
+            TextureCache& textureCache,
+            SceneLoadingStats& stats,
+            tf::Executor* executor,
+            SceneImportResult& result) const;
+    };
+}
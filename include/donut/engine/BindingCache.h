@@ -22,9 +22,8 @@
 
 #pragma once
 
+#include <donut/engine/ShardedCache.h>
 #include <nvrhi/nvrhi.h>
-#include <unordered_map>
-#include <shared_mutex>
 
 namespace donut::engine
 {
@@ -32,26 +31,32 @@ namespace donut::engine
     BindingCache maintains a dictionary that maps binding set descriptors
     into actual binding set objects. The binding sets are created on demand when 
     GetOrCreateBindingSet(...) is called and the requested binding set does not exist.
-    Created binding sets are stored for the lifetime of BindingCache, or until
-    Clear() is called.
+    Created binding sets are stored for the lifetime of BindingCache, until
+    Clear() is called, or until they are evicted when the cache capacity is set
+    and exceeded. The least recently used binding sets are evicted first.
     
-    All BindingCache methods are thread-safe.
+    All BindingCache methods are thread-safe. The cache is sharded by the hash
+    of the descriptor, so concurrent lookups rarely contend for the same lock,
+    and the binding sets are created without holding any lock.
     */
     class BindingCache
     {
     private:
         nvrhi::DeviceHandle m_Device;
-        std::unordered_map<size_t, nvrhi::BindingSetHandle> m_BindingSets;
-        std::shared_mutex m_Mutex;
+        ShardedCache<size_t, nvrhi::BindingSetHandle> m_BindingSets;
 
     public:
-        BindingCache(nvrhi::IDevice* device)
+        BindingCache(nvrhi::IDevice* device, size_t capacity = 0)
             : m_Device(device)
+            , m_BindingSets(capacity)
         { }
 
         nvrhi::BindingSetHandle GetCachedBindingSet(const nvrhi::BindingSetDesc& desc, nvrhi::IBindingLayout* layout);
         nvrhi::BindingSetHandle GetOrCreateBindingSet(const nvrhi::BindingSetDesc& desc, nvrhi::IBindingLayout* layout);
+        void SetCapacity(size_t capacity) { m_BindingSets.SetCapacity(capacity); }
         void Clear();
+
+        [[nodiscard]] ShardedCacheStats GetStats() const { return m_BindingSets.GetStats(); }
     };
 
 }
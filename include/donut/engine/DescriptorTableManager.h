@@ -25,6 +25,8 @@
 #include <nvrhi/nvrhi.h>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace donut::engine
 {
@@ -58,6 +60,50 @@ namespace donut::engine
         DescriptorHandle& operator=(DescriptorHandle&&) = default;
     };
 
+    // Tracks the allocated slots of a descriptor table with one bit per slot. Allocation returns the lowest free slot,
+    // found by skipping the full 64-slot words and counting the trailing ones in the first word with a free slot.
+    // Not thread-safe, DescriptorTableManager serializes the access.
+    class DescriptorSlotAllocator
+    {
+    private:
+        std::vector<uint64_t> m_Words;
+        uint32_t m_Capacity = 0;
+        uint32_t m_AllocatedCount = 0;
+        size_t m_SearchStart = 0; // Index of the first word that may have free slots
+
+    public:
+        // Returns the lowest free slot and marks it as allocated, or -1 if all slots within the capacity are taken.
+        DescriptorIndex Allocate();
+
+        // Marks the slot as free. Returns false if the slot is out of range or not allocated.
+        bool Release(DescriptorIndex index);
+
+        // Grows the capacity, smaller values are ignored.
+        void Grow(uint32_t capacity);
+
+        [[nodiscard]] bool IsAllocated(DescriptorIndex index) const;
+        [[nodiscard]] uint32_t GetCapacity() const { return m_Capacity; }
+        [[nodiscard]] uint32_t GetAllocatedCount() const { return m_AllocatedCount; }
+    };
+
+    struct DescriptorTableStats
+    {
+        uint32_t capacity = 0;
+        uint32_t allocatedDescriptors = 0;
+        uint32_t peakAllocatedDescriptors = 0;
+        uint32_t pendingWrites = 0;
+        uint64_t allocations = 0;
+        uint64_t reusedDescriptors = 0; // CreateDescriptor calls that returned an existing descriptor for the same item
+        uint64_t releases = 0;
+        uint64_t descriptorWrites = 0;  // Calls to writeDescriptorTable
+        uint32_t resizes = 0;
+    };
+
+    // Allocates descriptors in a bindless descriptor table. All methods are thread-safe.
+    // When deferred writes are enabled, the descriptors are only written into the table when Flush is called,
+    // which should be done once per frame before rendering. Multiple changes to the same slot are written once.
+    // Released slots are cleared in the table immediately in both modes, so that the table never references
+    // a resource after the manager drops its reference to it.
     class DescriptorTableManager : public std::enable_shared_from_this<DescriptorTableManager>
     {
     protected:
@@ -95,8 +141,16 @@ namespace donut::engine
 
         std::vector<nvrhi::BindingSetItem> m_Descriptors;
         std::unordered_map<nvrhi::BindingSetItem, DescriptorIndex, BindingSetItemHasher, BindingSetItemsEqual> m_DescriptorIndexMap;
-        std::vector<bool> m_AllocatedDescriptors;
-        int m_SearchStart = 0;
+        DescriptorSlotAllocator m_Slots;
+        std::vector<uint64_t> m_PendingDescriptors;   // One bit per slot, set when the slot needs to be written
+        std::vector<uint32_t> m_PendingWrites;
+        bool m_DeferredWrites = false;
+        DescriptorTableStats m_Stats;
+        mutable std::mutex m_Mutex;
+
+        void Resize(uint32_t newCapacity);
+        void WriteDescriptor(uint32_t index);
+        void FlushInternal();
         
     public:
         DescriptorTableManager(nvrhi::IDevice* device, nvrhi::IBindingLayout* layout);
@@ -108,5 +162,13 @@ namespace donut::engine
         DescriptorHandle CreateDescriptorHandle(nvrhi::BindingSetItem item);
         nvrhi::BindingSetItem GetDescriptor(DescriptorIndex index);
         void ReleaseDescriptor(DescriptorIndex index);
+
+        // Enables or disables batching of the descriptor table writes. Disabling flushes the pending writes.
+        void SetDeferredWrites(bool enable);
+
+        // Writes all pending descriptors into the table.
+        void Flush();
+
+        [[nodiscard]] DescriptorTableStats GetStats() const;
     };
 }
@@ -22,8 +22,11 @@
 
 #pragma once
 
+#include <donut/engine/KeyframeAnimation.h>
+#include <donut/engine/MeshSimplifier.h>
 #include <memory>
 #include <filesystem>
+#include <optional>
 
 namespace donut::vfs
 {
@@ -53,9 +56,17 @@ namespace donut::engine
     protected:
         std::shared_ptr<vfs::IFileSystem> m_fs;
         std::shared_ptr<SceneTypeFactory> m_SceneTypeFactory;
+        std::optional<animation::CompressionSettings> m_AnimationCompression;
+        std::optional<MeshLodSettings> m_LodGeneration;
         
     public:
         explicit GltfImporter(std::shared_ptr<vfs::IFileSystem> fs, std::shared_ptr<SceneTypeFactory> sceneTypeFactory);
+
+        // Enables key reduction and quantization of the imported animation samplers, or disables it when empty.
+        void SetAnimationCompression(const std::optional<animation::CompressionSettings>& settings) { m_AnimationCompression = settings; }
+
+        // Enables the generation of simplified levels of detail for the imported meshes, or disables it when empty.
+        void SetLodGeneration(const std::optional<MeshLodSettings>& settings) { m_LodGeneration = settings; }
         
         bool Load(
             const std::filesystem::path& fileName,
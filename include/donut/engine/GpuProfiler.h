@@ -0,0 +1,151 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace donut::engine
+{
+    struct GpuZoneRecord
+    {
+        const char* name = nullptr; // Interned, valid until the process exits
+        uint32_t depth = 0;
+        float durationMs = 0.f;
+        uint64_t cpuBeginNs = 0;    // trace::GetTimeNs() when the zone was recorded into the command list
+    };
+
+    struct GpuFrameRecord
+    {
+        uint64_t frameIndex = 0;
+        float totalMs = 0.f;        // Sum of the top-level zones
+        std::vector<GpuZoneRecord> zones;
+    };
+
+    struct GpuProfilerStats
+    {
+        uint64_t resolvedFrames = 0;
+        uint64_t stalledFrames = 0;  // Frames whose results were not ready when their queries had to be reused
+        uint64_t droppedZones = 0;   // Zones beyond maxZonesPerFrame
+    };
+
+    // Measures GPU durations of command list ranges with nvrhi timer queries.
+    // Each frame in flight uses its own pool of queries, and the results of a frame are read
+    // when its pool comes up for reuse, so normally the CPU never waits for the GPU.
+    // Resolved zones are also written to the "GPU" track of donut::trace, laid out sequentially
+    // from the CPU time when they were recorded, since timer queries only provide durations.
+    class GpuProfiler
+    {
+    public:
+        GpuProfiler(nvrhi::IDevice* device, uint32_t framesInFlight = 4, uint32_t maxZonesPerFrame = 256);
+
+        // Makes the profiler used by ScopedGpuZone. Pass nullptr to disable the zones.
+        static void SetCurrent(GpuProfiler* profiler);
+        [[nodiscard]] static GpuProfiler* GetCurrent();
+
+        void SetEnabled(bool enabled) { m_Enabled = enabled; }
+        [[nodiscard]] bool IsEnabled() const { return m_Enabled && m_Supported; }
+
+        // Switches to the next query pool, reading the results of the frame that used it before.
+        // Must be called once per frame before any zones are recorded, and not concurrently with them.
+        void BeginFrame(uint64_t frameIndex);
+
+        // Zones may be recorded from several threads into different command lists.
+        // Returns ~0u if the zone is not recorded, which EndZone ignores.
+        [[nodiscard]] uint32_t BeginZone(nvrhi::ICommandList* commandList, const char* name);
+        void EndZone(nvrhi::ICommandList* commandList, uint32_t zone);
+
+        void SetHistoryLength(uint32_t frames) { m_HistoryLength = std::max(frames, 1u); }
+        [[nodiscard]] std::vector<GpuFrameRecord> GetFrameHistory() const;
+        [[nodiscard]] GpuProfilerStats GetStats() const;
+
+    private:
+        struct Zone
+        {
+            nvrhi::TimerQueryHandle query;
+            const char* name = nullptr;
+            uint32_t depth = 0;
+            uint64_t cpuBeginNs = 0;
+        };
+
+        struct FramePool
+        {
+            std::vector<Zone> zones;
+            std::atomic<uint32_t> zoneCount = 0;
+            uint64_t frameIndex = 0;
+            bool pending = false;
+        };
+
+        nvrhi::DeviceHandle m_Device;
+        bool m_Supported = false;
+        bool m_Enabled = true;
+        uint32_t m_MaxZonesPerFrame;
+        uint32_t m_HistoryLength = 120;
+        uint32_t m_TraceTrack = 0;
+
+        std::vector<std::unique_ptr<FramePool>> m_Pools;
+        FramePool* m_CurrentPool = nullptr;
+        uint32_t m_CurrentPoolIndex = 0;
+
+        mutable std::mutex m_HistoryMutex;
+        std::deque<GpuFrameRecord> m_History;
+        GpuProfilerStats m_Stats;
+        std::atomic<uint64_t> m_DroppedZones = 0;
+
+        void ResolvePool(FramePool& pool);
+    };
+
+    // Records a GPU zone with the current profiler, if there is one, for the lifetime of the object.
+    // A null name makes the zone inactive, which is convenient for optional pass events.
+    class ScopedGpuZone
+    {
+    public:
+        ScopedGpuZone(nvrhi::ICommandList* commandList, const char* name)
+            : m_Profiler(name ? GpuProfiler::GetCurrent() : nullptr)
+            , m_CommandList(commandList)
+        {
+            if (m_Profiler)
+                m_Zone = m_Profiler->BeginZone(commandList, name);
+        }
+
+        ~ScopedGpuZone()
+        {
+            if (m_Profiler)
+                m_Profiler->EndZone(m_CommandList, m_Zone);
+        }
+
+        ScopedGpuZone(const ScopedGpuZone&) = delete;
+        ScopedGpuZone& operator=(const ScopedGpuZone&) = delete;
+
+    private:
+        GpuProfiler* m_Profiler;
+        nvrhi::ICommandList* m_CommandList;
+        uint32_t m_Zone = ~0u;
+    };
+}
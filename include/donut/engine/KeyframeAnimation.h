@@ -57,6 +57,13 @@ namespace donut::engine::animation
         const Keyframe& a, const Keyframe& b,
         const Keyframe& c, const Keyframe& d, float t, float dt);
 
+    // Same as Interpolate, but takes the keyframe values and tangents separately, which is used with SoA storage.
+    // The tangents are only used in the HermiteSpline mode.
+    dm::float4 Interpolate(InterpolationMode mode,
+        const dm::float4& a, const dm::float4& b,
+        const dm::float4& c, const dm::float4& d,
+        const dm::float4& bOutTangent, const dm::float4& cInTangent, float t, float dt);
+
     class Sampler
     {
     protected:
@@ -67,20 +74,112 @@ namespace donut::engine::animation
         Sampler() = default;
         virtual ~Sampler() = default;
 
-        std::optional<dm::float4> Evaluate(float time, bool extrapolateLastValues = false) const;
+        virtual std::optional<dm::float4> Evaluate(float time, bool extrapolateLastValues = false) const;
+
+        // The keyframes are accessed through virtual functions because derived samplers may store them
+        // in a different form, see CompressedSampler.
+        [[nodiscard]] virtual size_t GetKeyframeCount() const { return m_Keyframes.size(); }
+        [[nodiscard]] virtual std::vector<Keyframe> CopyKeyframes() const { return m_Keyframes; }
 
-        [[nodiscard]] std::vector<Keyframe>& GetKeyframes() { return m_Keyframes; }
+        // Returns the keyframes for modification. Derived samplers convert their keyframes to the uncompressed form first.
+        [[nodiscard]] virtual std::vector<Keyframe>& GetKeyframes() { return m_Keyframes; }
         void AddKeyframe(const Keyframe keyframe);
 
         [[nodiscard]] InterpolationMode GetMode() const { return m_Mode; }
         void SetInterpolationMode(InterpolationMode mode) { m_Mode = mode; }
 
-        [[nodiscard]] float GetStartTime() const;
-        [[nodiscard]] float GetEndTime() const;
+        [[nodiscard]] virtual float GetStartTime() const;
+        [[nodiscard]] virtual float GetEndTime() const;
+
+        // Returns the number of bytes used to store the keyframes.
+        [[nodiscard]] virtual size_t GetDataSize() const { return m_Keyframes.size() * sizeof(Keyframe); }
 
         void Load(Json::Value& node);
     };
 
+    struct CompressionSettings
+    {
+        // Maximum error of the compressed sampler, in value units, for translations, scaling and other linear values.
+        float valueTolerance = 1e-4f;
+
+        // Maximum error of the compressed sampler in any quaternion component, for Slerp samplers.
+        float rotationTolerance = 1e-4f;
+
+        // Store rotations as 48-bit smallest-three quaternions, and other values as 16-bit fractions of their range.
+        // The quantization error is taken out of the tolerance before key reduction, and samplers whose
+        // quantization error alone exceeds the tolerance are stored without quantization.
+        bool quantize = true;
+    };
+
+    // Removes the keyframes that interpolation between the remaining neighbors reproduces within tolerance.
+    // Only Step, Linear and Slerp samplers are reduced; returns the number of removed keyframes.
+    size_t ReduceKeyframes(Sampler& sampler, const CompressionSettings& settings);
+
+    // A sampler that stores its keyframes in a compressed form and decompresses them on evaluation.
+    // Supports the Step, Linear and Slerp modes; use CompressSampler to create one for any sampler.
+    // Modifying the keyframes through GetKeyframes or AddKeyframe converts the sampler to the uncompressed form.
+    class CompressedSampler : public Sampler
+    {
+    private:
+        std::vector<float> m_Times;
+        std::vector<uint16_t> m_QuantizedValues; // Three words per key for rotations, one per non-constant component otherwise
+        std::vector<dm::float4> m_Values;        // Used when the values are not quantized
+        dm::float4 m_RangeMin = 0.f;
+        dm::float4 m_RangeScale = 0.f;
+        uint32_t m_ComponentMask = 0;            // Components that are not constant over the whole sampler
+        uint32_t m_ComponentCount = 0;
+        bool m_Quantized = false;
+
+        [[nodiscard]] dm::float4 DecodeValue(size_t index) const;
+        [[nodiscard]] bool IsCompressed() const { return !m_Times.empty(); }
+
+    public:
+        CompressedSampler(const Sampler& sampler, const CompressionSettings& settings);
+
+        std::optional<dm::float4> Evaluate(float time, bool extrapolateLastValues = false) const override;
+        [[nodiscard]] float GetStartTime() const override;
+        [[nodiscard]] float GetEndTime() const override;
+        [[nodiscard]] size_t GetDataSize() const override;
+        [[nodiscard]] size_t GetKeyframeCount() const override;
+        [[nodiscard]] std::vector<Keyframe> CopyKeyframes() const override;
+        [[nodiscard]] std::vector<Keyframe>& GetKeyframes() override;
+    };
+
+    // Reduces and quantizes the keyframes of a sampler according to the settings.
+    // Returns a CompressedSampler, or the original sampler if its interpolation mode cannot be compressed.
+    std::shared_ptr<Sampler> CompressSampler(const std::shared_ptr<Sampler>& sampler, const CompressionSettings& settings);
+
+    // A read-only version of Sampler optimized for playback.
+    // The keyframe times and values are stored in separate arrays (SoA), and the tangents are only stored
+    // for the HermiteSpline mode. Evaluation uses a cursor, which is the index of the keyframe pair
+    // used on the previous call: with sequential playback, the next pair is found by stepping forward
+    // from the cursor instead of a binary search over all keyframes.
+    // The results are the same as those of Sampler::Evaluate for the same time.
+    class CompiledSampler
+    {
+    private:
+        std::vector<float> m_Times;
+        std::vector<dm::float4> m_Values;
+        std::vector<dm::float4> m_InTangents;
+        std::vector<dm::float4> m_OutTangents;
+        InterpolationMode m_Mode = InterpolationMode::Step;
+
+        [[nodiscard]] uint32_t FindKeyframePair(float time, uint32_t cursor) const;
+
+    public:
+        CompiledSampler() = default;
+        explicit CompiledSampler(const Sampler& sampler);
+
+        // Evaluates the sampler at the given time. 'cursor' should be initialized to 0 before the first call
+        // and preserved between calls for the same playback; it is updated with the new keyframe pair index.
+        std::optional<dm::float4> Evaluate(float time, uint32_t& cursor, bool extrapolateLastValues = false) const;
+
+        [[nodiscard]] InterpolationMode GetMode() const { return m_Mode; }
+        [[nodiscard]] size_t GetKeyframeCount() const { return m_Times.size(); }
+        [[nodiscard]] float GetStartTime() const { return m_Times.empty() ? 0.f : m_Times.front(); }
+        [[nodiscard]] float GetEndTime() const { return m_Times.empty() ? 0.f : m_Times.back(); }
+    };
+
     class Sequence
     {
     protected:
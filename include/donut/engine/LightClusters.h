@@ -0,0 +1,126 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <nvrhi/nvrhi.h>
+#include <vector>
+
+struct LightConstants;
+struct LightClusterConstants;
+
+namespace donut::engine
+{
+    class IView;
+
+    struct LightClusterSettings
+    {
+        uint32_t tileSize = 64;         // Width and height of the screen tiles, in pixels
+        uint32_t numSlices = 24;        // Number of depth slices, at least 2
+        float nearDepth = 1.f;          // View-space depth where the exponential slices start
+        float farDepth = 500.f;         // View-space depth where the last slice ends, it also contains everything farther
+        uint32_t maxLightsPerCluster = 128; // Further lights are dropped from the cluster, with a warning
+        bool enableClustering = true;   // When disabled, all lights are evaluated for every pixel
+    };
+
+    struct LightClusterStats
+    {
+        uint32_t numClusters = 0;
+        uint32_t numGlobalLights = 0;   // Lights that apply to every cluster
+        uint32_t numLocalLights = 0;    // Lights that were binned into clusters
+        uint32_t numLightIndices = 0;   // Sum of the cluster light counts
+        uint32_t maxLightsInCluster = 0;
+        uint32_t overflowedClusters = 0; // Clusters that had more than maxLightsPerCluster lights
+    };
+
+    // Assigns point and spot lights to the clusters of a view frustum on the CPU, using the light range
+    // and the spot cone, so that shaders only evaluate the lights that can reach each cluster.
+    // 
+    // Usage: SetLights once per frame after the light constants are filled, then Build for every view.
+    // The lights passed to SetLights should be ordered with the global lights first, see PartitionLights.
+    class LightClusterGrid
+    {
+    public:
+        explicit LightClusterGrid(const LightClusterSettings& settings = LightClusterSettings());
+
+        void SetSettings(const LightClusterSettings& settings);
+        [[nodiscard]] const LightClusterSettings& GetSettings() const { return m_Settings; }
+
+        // Returns true for the lights that have a finite range and can be assigned to clusters.
+        [[nodiscard]] static bool IsLocalLight(const LightConstants& light);
+
+        // Moves the global lights to the beginning of the array, keeping the order within both groups,
+        // and returns the number of global lights. With clustering disabled, all lights are global.
+        uint32_t PartitionLights(std::vector<LightConstants>& lights) const;
+
+        // Copies the bounds of the local lights, which must follow numGlobalLights global ones in the array.
+        void SetLights(const LightConstants* lights, uint32_t numLights, uint32_t numGlobalLights);
+
+        // Bins the lights into the clusters of a planar view. Cubemap views use a single cluster with all lights.
+        void Build(const IView& view);
+
+        void FillConstants(LightClusterConstants& constants) const;
+
+        // The same mapping as GetLightClusterIndex in light_clusters.hlsli
+        [[nodiscard]] uint32_t GetClusterIndex(dm::float2 pixelPosition, float viewDepth) const;
+
+        [[nodiscard]] dm::uint3 GetGridSize() const { return m_GridSize; }
+        [[nodiscard]] const std::vector<dm::uint2>& GetClusterRanges() const { return m_ClusterRanges; }
+        [[nodiscard]] const std::vector<uint32_t>& GetLightIndices() const { return m_LightIndices; }
+        [[nodiscard]] const LightClusterStats& GetStats() const { return m_Stats; }
+
+    private:
+        struct LocalLight
+        {
+            dm::float3 position = 0.f;
+            float range = 0.f;
+            dm::float3 direction = 0.f;
+            float cosAngle = -1.f;  // cosine and sine of the spot cone half-angle, cosAngle <= 0 for point lights
+            float sinAngle = 0.f;
+            uint32_t index = 0;
+        };
+
+        LightClusterSettings m_Settings;
+        std::vector<LocalLight> m_Lights;
+        std::vector<LocalLight> m_ViewLights;
+        uint32_t m_NumGlobalLights = 0;
+
+        dm::uint3 m_GridSize = dm::uint3(1u);
+        float m_SliceScale = 0.f;
+        float m_SliceBias = 0.f;
+        std::vector<dm::uint2> m_ClusterRanges;
+        std::vector<uint32_t> m_LightIndices;
+        std::vector<dm::box3> m_ClusterBounds;
+        LightClusterStats m_Stats;
+        bool m_OverflowReported = false;
+
+        [[nodiscard]] float GetSliceDepth(uint32_t slice) const;
+        void BuildSingleCluster();
+    };
+
+    // Makes sure that the structured buffer of lights, cluster ranges or light indices can hold numElements elements.
+    // A buffer that is too small is replaced with one that is at least twice as large, to avoid reallocating it on
+    // every small change. Returns true when a new buffer was created, and then the caller must release the binding
+    // sets that reference the old one.
+    bool EnsureLightBufferCapacity(nvrhi::IDevice* device, nvrhi::BufferHandle& buffer, size_t numElements, size_t elementSize, const char* debugName);
+}
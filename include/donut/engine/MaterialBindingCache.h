@@ -23,9 +23,8 @@
 #pragma once
 
 #include <donut/engine/SceneTypes.h>
+#include <donut/engine/ShardedCache.h>
 #include <nvrhi/nvrhi.h>
-#include <unordered_map>
-#include <mutex>
 
 namespace donut::engine
 {
@@ -48,16 +47,26 @@ namespace donut::engine
         uint32_t slot; // type depends on resource
     };
 
+    // Creates and caches binding sets for materials. All methods are thread-safe, and lookups of
+    // existing binding sets only take a shared lock on one shard of the cache.
+    // The binding set of a material is re-created when its Material::bindingHash changes.
+    // When a capacity is set, binding sets that were not used recently are evicted; the handles returned by
+    // GetMaterialBindingSet keep their binding sets alive after eviction.
     class MaterialBindingCache
     {
     private:
+        struct MaterialBindingSet
+        {
+            nvrhi::BindingSetHandle bindingSet;
+            size_t materialHash = 0;
+        };
+
         nvrhi::DeviceHandle m_Device;
         nvrhi::BindingLayoutHandle m_BindingLayout;
-        std::unordered_map<const Material*, nvrhi::BindingSetHandle> m_BindingSets;
+        ShardedCache<const Material*, MaterialBindingSet> m_BindingSets;
         std::vector<MaterialResourceBinding> m_BindingDesc;
         nvrhi::TextureHandle m_FallbackTexture;
         nvrhi::SamplerHandle m_Sampler;
-        std::mutex m_Mutex;
         bool m_TrackLiveness;
 
         nvrhi::BindingSetHandle CreateMaterialBindingSet(const Material* material);
@@ -75,7 +84,10 @@ namespace donut::engine
             bool trackLiveness = true);
 
         nvrhi::IBindingLayout* GetLayout() const;
-        nvrhi::IBindingSet* GetMaterialBindingSet(const Material* material);
+        nvrhi::BindingSetHandle GetMaterialBindingSet(const Material* material);
+        void SetCapacity(size_t capacity) { m_BindingSets.SetCapacity(capacity); }
         void Clear();
+
+        [[nodiscard]] ShardedCacheStats GetStats() const { return m_BindingSets.GetStats(); }
     };
 }
\ No newline at end of file
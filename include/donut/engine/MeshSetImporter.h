@@ -0,0 +1,89 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <memory>
+#include <filesystem>
+
+namespace donut::vfs
+{
+    class IFileSystem;
+}
+
+namespace donut::engine
+{
+    struct SceneImportResult;
+    struct SceneLoadingStats;
+    class TextureCache;
+    class SceneTypeFactory;
+}
+
+namespace tf
+{
+    class Executor;
+}
+
+/*
+Mesh set files are chunk files written by donut::chunk::serialize (see core/chunk/chunk.h) that contain
+a single vertex and index pool, a list of mesh infos, and a node hierarchy with mesh instances.
+
+The importer creates one MeshInfo with a single geometry per chunk mesh info, all sharing one BufferGroup
+whose index and vertex views point at the streams inside the file blob, so nothing is copied until Scene
+uploads the buffers. Normals and tangents are stored in the same packed format as BufferGroup uses, and
+the tangent W component holds the bitangent sign; bitangent streams are ignored.
+
+Mesh set files only reference materials by name, so the importer creates a default material for each one.
+*/
+
+namespace donut::engine
+{
+    constexpr const char* c_MeshSetExtension = ".meshset";
+
+    [[nodiscard]] bool IsMeshSetFile(const std::filesystem::path& fileName);
+
+    // Writes the static meshes and the node hierarchy of a model into a mesh set file. All meshes must use
+    // the same BufferGroup, which is the case for models loaded by GltfImporter, and their vertex data must
+    // still be on the CPU, i.e. the model must be exported before a Scene creates its GPU buffers.
+    // Meshes with multiple geometries are written as one chunk mesh info per geometry.
+    bool ExportMeshSet(
+        vfs::IFileSystem& fs,
+        const std::filesystem::path& fileName,
+        const SceneImportResult& model);
+
+    class MeshSetImporter
+    {
+    protected:
+        std::shared_ptr<vfs::IFileSystem> m_fs;
+        std::shared_ptr<SceneTypeFactory> m_SceneTypeFactory;
+
+    public:
+        explicit MeshSetImporter(std::shared_ptr<vfs::IFileSystem> fs, std::shared_ptr<SceneTypeFactory> sceneTypeFactory);
+
+        bool Load(
+            const std::filesystem::path& fileName,
+            TextureCache& textureCache,
+            SceneLoadingStats& stats,
+            tf::Executor* executor,
+            SceneImportResult& result) const;
+    };
+}
@@ -0,0 +1,64 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <vector>
+
+namespace donut::engine
+{
+    struct MeshInfo;
+
+    struct MeshLodSettings
+    {
+        // Maximum number of levels generated in addition to the original geometry.
+        uint32_t numLevels = 3;
+
+        // Every level targets this fraction of the triangles of the previous level.
+        float triangleRatio = 0.5f;
+
+        // Simplification of a level stops when the error would exceed this fraction of the mesh bounds diagonal.
+        float maxRelativeError = 0.02f;
+    };
+
+    // Simplifies an indexed triangle list with quadric error metric edge collapses. Every collapse moves a vertex onto
+    // one of its neighbors, so the result only references the original vertices and can share their vertex buffer.
+    // Vertices on open borders and attribute seams, i.e. vertices whose position is shared with other vertices,
+    // are never moved. Collapses that flip triangles or make the surface non-manifold are rejected.
+    // Simplification stops when at most targetNumIndices remain, or when the next collapse would introduce an error
+    // larger than maxError, in position units. resultError receives the largest error of the performed collapses.
+    std::vector<uint32_t> SimplifyMesh(
+        const dm::float3* positions,
+        size_t numVertices,
+        const uint32_t* indices,
+        size_t numIndices,
+        size_t targetNumIndices,
+        float maxError,
+        float* resultError = nullptr);
+
+    // Generates the levels of detail of every triangle geometry of the mesh with SimplifyMesh, appending their indices
+    // to the mesh's BufferGroup::indexData, and fills MeshGeometry::lods and MeshInfo::lodErrors.
+    // Must be called before the buffers are uploaded. Meshes without CPU index or position data, and meshes
+    // animated with morph targets, are left unchanged. Returns the number of generated levels.
+    uint32_t GenerateMeshLods(MeshInfo& mesh, const MeshLodSettings& settings);
+}
@@ -0,0 +1,142 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace tf
+{
+    class Executor;
+}
+
+namespace donut::engine
+{
+    struct PipelineManagerStats
+    {
+        uint64_t requests = 0;          // Calls to GetGraphicsPipeline
+        uint64_t readyHits = 0;         // Requests that found a ready pipeline
+        uint64_t pendingHits = 0;       // Requests for a pipeline that was still being created
+        uint64_t createdPipelines = 0;
+        uint64_t failedPipelines = 0;
+        uint32_t pendingPipelines = 0;
+        double totalCreationTimeMs = 0.0; // Time spent in the creation functions
+        double maxCreationTimeMs = 0.0;
+        double maxLatencyMs = 0.0;        // Longest time from the first request until a pipeline was ready
+
+        [[nodiscard]] double GetHitRate() const { return requests ? double(readyHits) / double(requests) : 0.0; }
+    };
+
+    /*
+    PipelineManager creates graphics pipelines on background threads, so that render passes
+    don't stall the frame when they encounter a new combination of material, cull mode, etc.
+
+    GetGraphicsPipeline returns the pipeline if it is ready. Otherwise it starts creating the
+    pipeline on the executor and returns null, and the caller should skip the draws that need it
+    until a later frame. Without an executor, pipelines are created synchronously on first use.
+
+    Each object that requests pipelines gets its own owner ID from RegisterOwner, and pipelines are
+    identified by the owner, a key chosen by the owner, and the framebuffer info. The creation functions
+    may reference the owner, so it must call ReleaseOwner before it is destroyed, which waits for the
+    pending pipelines and removes the owner's pipelines.
+
+    All PipelineManager methods are thread-safe.
+    */
+    class PipelineManager
+    {
+    public:
+        typedef std::function<nvrhi::GraphicsPipelineHandle()> CreateGraphicsPipelineFunc;
+
+    private:
+        struct EntryKey
+        {
+            uint64_t owner = 0;
+            size_t key = 0;
+            nvrhi::FramebufferInfo framebufferInfo;
+
+            bool operator==(const EntryKey& other) const
+            {
+                return owner == other.owner && key == other.key && framebufferInfo == other.framebufferInfo;
+            }
+        };
+
+        struct EntryKeyHash
+        {
+            size_t operator()(const EntryKey& entryKey) const;
+        };
+
+        struct Entry
+        {
+            nvrhi::GraphicsPipelineHandle pipeline;
+            std::atomic<bool> ready{ false };
+            bool failed = false;
+            size_t key = 0;
+        };
+
+        tf::Executor* m_Executor;
+        std::unordered_map<EntryKey, std::shared_ptr<Entry>, EntryKeyHash> m_Entries;
+        mutable std::shared_mutex m_EntriesMutex;
+        std::atomic<uint64_t> m_NextOwner{ 1 };
+
+        PipelineManagerStats m_Stats;
+        std::atomic<uint64_t> m_Requests{ 0 };
+        std::atomic<uint64_t> m_ReadyHits{ 0 };
+        mutable std::mutex m_StatsMutex;
+
+        uint32_t m_PendingCount = 0;
+        mutable std::mutex m_PendingMutex;
+        std::condition_variable m_PendingCondition;
+
+        void CreatePipeline(const std::shared_ptr<Entry>& entry, const CreateGraphicsPipelineFunc& createFunc, double requestTime);
+
+    public:
+        explicit PipelineManager(tf::Executor* executor = nullptr);
+        ~PipelineManager();
+
+        // Returns a new owner ID for an object that requests pipelines. IDs are never reused, unlike addresses.
+        [[nodiscard]] uint64_t RegisterOwner();
+
+        // Waits for the pending pipelines and removes the pipelines of the owner.
+        void ReleaseOwner(uint64_t owner);
+
+        // Returns the pipeline for the owner, key and framebuffer info, or null if it is not ready yet
+        // or could not be created. The key must identify the pipeline uniquely among the pipelines of the owner
+        // that are used with the same framebuffer info. Failed creations are reported through log::error once,
+        // and are not retried until Clear is called.
+        nvrhi::GraphicsPipelineHandle GetGraphicsPipeline(uint64_t owner, size_t key, const nvrhi::FramebufferInfo& framebufferInfo,
+            const CreateGraphicsPipelineFunc& createFunc);
+
+        void WaitForPendingPipelines();
+
+        // Waits for the pending pipelines and releases all pipelines.
+        void Clear();
+
+        [[nodiscard]] PipelineManagerStats GetStats() const;
+    };
+}
@@ -51,6 +51,30 @@ namespace donut::engine
     class TextureCache;
     class DescriptorTableManager;
     class GltfImporter;
+    class BakedSceneLoader;
+    class MeshSetImporter;
+    class IView;
+
+    // One level of the skinning LOD policy, see Scene::SetSkinningLodLevels.
+    struct SkinningLodLevel
+    {
+        // Minimum projected radius of the instance bounds, as a fraction of the view height, to use this level.
+        float minScreenSize = 0.f;
+
+        // The instance is re-skinned at most once in this many frames.
+        uint32_t updateInterval = 1;
+
+        // Joints that are deeper than this in the skeleton follow their ancestor at this depth rigidly.
+        uint32_t maxJointDepth = ~0u;
+    };
+
+    struct SkinningStats
+    {
+        uint32_t totalInstances = 0;    // All skinned instances in the scene
+        uint32_t animatedInstances = 0; // Instances with pending animation updates
+        uint32_t skinnedInstances = 0;  // Instances actually processed on the last frame
+        uint32_t computedJoints = 0;    // Joint matrices computed on the last frame
+    };
     
     class Scene
     {
@@ -61,22 +85,35 @@ namespace donut::engine
         std::shared_ptr<DescriptorTableManager> m_DescriptorTable;
         std::shared_ptr<SceneGraph> m_SceneGraph;
         std::shared_ptr<GltfImporter> m_GltfImporter;
+        std::shared_ptr<BakedSceneLoader> m_BakedSceneLoader;
+        std::shared_ptr<MeshSetImporter> m_MeshSetImporter;
         std::vector<SceneImportResult> m_Models;
         bool m_EnableBindlessResources = false;
         bool m_UseResourceDescriptorHeapBindless = false;
+        bool m_KeepOccluderGeometry = false;
         
         nvrhi::BufferHandle m_MaterialBuffer;
         nvrhi::BufferHandle m_GeometryBuffer;
         nvrhi::BufferHandle m_InstanceBuffer;
+        nvrhi::BufferHandle m_JointBuffer;
 
         nvrhi::DeviceHandle m_Device;
         nvrhi::ShaderHandle m_SkinningShader;
         nvrhi::ComputePipelineHandle m_SkinningPipeline;
         nvrhi::BindingLayoutHandle m_SkinningBindingLayout;
 
+        tf::Executor* m_Executor = nullptr;
+
+        std::vector<SkinningLodLevel> m_SkinningLodLevels;
+        SkinningStats m_SkinningStats;
+        dm::float3 m_LodViewOrigin = 0.f;
+        float m_LodViewScale = 0.f;
+        bool m_LodViewOrthographic = false;
+
         bool m_RayTracingSupported = false;
         bool m_SceneTransformsChanged = false;
         bool m_SceneStructureChanged = false;
+        uint32_t m_StructureVersion = 0;
 
         struct Resources; // Hide the implementation to avoid including <material_cb.h> and <bindless.h> here
         std::shared_ptr<Resources> m_Resources;
@@ -86,19 +123,28 @@ namespace donut::engine
             const std::filesystem::path& fileName,
             tf::Executor* executor);
 
+        // Loads a glTF model, a baked scene or a mesh set, depending on the file extension
+        bool LoadModel(
+            const std::filesystem::path& fileName,
+            tf::Executor* executor,
+            SceneImportResult& result);
+
         void LoadModels(
             const Json::Value& modelList, 
             const std::filesystem::path& scenePath, 
             tf::Executor* executor);
 
-        void LoadSceneGraph(const Json::Value& nodeList, const std::shared_ptr<SceneGraphNode>& parent);
-        void LoadAnimations(const Json::Value& nodeList);
+        // Only called when RequiresSceneDocument returns true, see LoadCustomData.
+        virtual void LoadSceneGraph(const Json::Value& nodeList, const std::shared_ptr<SceneGraphNode>& parent);
+        virtual void LoadAnimations(const Json::Value& nodeList);
         
         void UpdateMaterial(const std::shared_ptr<Material>& material);
         void UpdateGeometry(const std::shared_ptr<MeshInfo>& mesh);
         void UpdateInstance(const std::shared_ptr<MeshInstance>& instance);
 
         void UpdateSkinnedMeshes(nvrhi::ICommandList* commandList, uint32_t frameIndex);
+        void UpdateJointLayout();
+        [[nodiscard]] const SkinningLodLevel* SelectSkinningLod(const SkinnedMeshInstance& instance) const;
 
         void WriteMaterialBuffer(nvrhi::ICommandList* commandList) const;
         void WriteGeometryBuffer(nvrhi::ICommandList* commandList) const;
@@ -110,7 +156,14 @@ namespace donut::engine
         virtual nvrhi::BufferHandle CreateInstanceBuffer();
         virtual nvrhi::BufferHandle CreateMaterialConstantBuffer(const std::string& debugName);
 
+        // Called with the top-level members of the scene file before the models are loaded.
+        // By default, the "graph" and "animations" sections are not included: they are loaded directly from
+        // the file with SceneGraphLoader, without building a document tree. Derived scenes that read these
+        // sections in LoadCustomData, or that override the LoadSceneGraph and LoadAnimations functions taking
+        // a document, should override RequiresSceneDocument to return true. Then the whole file is parsed into
+        // a document and loaded through these functions, as in the earlier versions.
         virtual bool LoadCustomData(Json::Value& rootNode, tf::Executor* executor);
+        [[nodiscard]] virtual bool RequiresSceneDocument() const { return false; }
     public:
         virtual ~Scene() = default;
 
@@ -139,10 +192,35 @@ namespace donut::engine
 
         static const SceneLoadingStats& GetLoadingStats();
 
+        // Sets the executor used to parallelize per-frame work in RefreshBuffers, such as skinning.
+        // The executor must outlive the scene or be reset to nullptr before it is destroyed.
+        void SetExecutor(tf::Executor* executor) { m_Executor = executor; }
+
+        // Keeps a CPU copy of the positions and indices of the triangle meshes in MeshInfo::occluderPositions and
+        // occluderIndices when their buffers are created, for CPU occlusion culling. Must be set before loading.
+        void SetKeepOccluderGeometry(bool keep) { m_KeepOccluderGeometry = keep; }
+
+        // Enables update-rate throttling for skinned instances. Levels are sorted from the most detailed one,
+        // and each instance uses the first level whose minScreenSize it reaches, or the last level.
+        // Throttled updates are spread evenly over the frames of the interval. An empty list disables the LOD.
+        void SetSkinningLodLevels(std::vector<SkinningLodLevel> levels) { m_SkinningLodLevels = std::move(levels); }
+
+        // Sets the view used to compute the projected size of skinned instances for the LOD selection.
+        // Should be called every frame before RefreshBuffers when the LOD levels are set.
+        void SetAnimationLodView(const IView& view);
+
+        [[nodiscard]] const SkinningStats& GetSkinningStats() const { return m_SkinningStats; }
+
+        // Incremented by RefreshBuffers when meshes or instances are added or removed, or the scene buffers are
+        // reallocated. Renderers that cache per-instance data can compare it with the value they were built for.
+        [[nodiscard]] uint32_t GetStructureVersion() const { return m_StructureVersion; }
+
         [[nodiscard]] std::shared_ptr<SceneGraph> GetSceneGraph() const { return m_SceneGraph; }
+        [[nodiscard]] const std::shared_ptr<GltfImporter>& GetGltfImporter() const { return m_GltfImporter; }
         [[nodiscard]] nvrhi::IDescriptorTable* GetDescriptorTable() const { return m_DescriptorTable ? m_DescriptorTable->GetDescriptorTable() : nullptr; }
         [[nodiscard]] nvrhi::IBuffer* GetMaterialBuffer() const { return m_MaterialBuffer; }
         [[nodiscard]] nvrhi::IBuffer* GetGeometryBuffer() const { return m_GeometryBuffer; }
         [[nodiscard]] nvrhi::IBuffer* GetInstanceBuffer() const { return m_InstanceBuffer; }
+        [[nodiscard]] nvrhi::IBuffer* GetJointBuffer() const { return m_JointBuffer; }
     };
 }
@@ -118,9 +118,12 @@ namespace donut::engine
 
     public:
         std::vector<SkinnedMeshJoint> joints;
-        nvrhi::BufferHandle jointBuffer;
+        nvrhi::BufferHandle jointBuffer; // Shared by all skinned instances in a Scene
+        uint32_t jointBufferOffset = 0;  // Index of the first joint matrix of this instance in jointBuffer
         nvrhi::BindingSetHandle skinningBindingSet;
         bool skinningInitialized = false;
+        uint32_t lastSkinningFrameIndex = 0; // Frame when the mesh was last skinned, used by the skinning LOD
+        bool skinningSettled = true;         // False when the previous positions still differ from the current ones
 
         explicit SkinnedMeshInstance(std::shared_ptr<SceneTypeFactory> sceneTypeFactory, std::shared_ptr<MeshInfo> prototypeMesh);
 
@@ -424,10 +427,12 @@ namespace donut::engine
         [[nodiscard]] const std::shared_ptr<animation::Sampler>& GetSampler() const { return m_Sampler; }
         [[nodiscard]] AnimationAttribute GetAttribute() const { return m_Attribute; }
         [[nodiscard]] std::shared_ptr<SceneGraphNode> GetTargetNode() const { return m_TargetNode.lock(); }
+        [[nodiscard]] std::shared_ptr<Material> GetTargetMaterial() const { return m_TargetMaterial.lock(); }
         [[nodiscard]] const std::string& GetLeafPropertyName() const { return m_LeafPropertyName; }
         void SetTargetNode(const std::shared_ptr<SceneGraphNode>& node) { m_TargetNode = node; }
         void SetLeafProperyName(const std::string& name) { m_LeafPropertyName = name; }
         bool Apply(float time) const;  // NOLINT(modernize-use-nodiscard)
+        bool ApplyValue(const dm::float4& value) const;  // NOLINT(modernize-use-nodiscard)
     };
 
     class SceneGraphAnimation : public SceneGraphLeaf
@@ -448,6 +453,56 @@ namespace donut::engine
         void AddChannel(const std::shared_ptr<SceneGraphAnimationChannel>& channel);
     };
 
+    // A SceneGraphAnimation prepared for fast playback.
+    // The samplers are converted to CompiledSampler with a keyframe cursor per channel, the target nodes
+    // are resolved once, and the channels animating the same node are grouped so that each node's transform
+    // is written, and its dirty flags propagated, once per Apply. Leaf and material properties still go through SetProperty.
+    // The clip stores raw pointers to the target nodes, so it must be recompiled when any of them is removed from the graph.
+    class CompiledAnimationClip
+    {
+    public:
+        struct NodeTrack
+        {
+            SceneGraphNode* node = nullptr;
+            int translationChannel = -1;
+            int rotationChannel = -1;
+            int scalingChannel = -1;
+        };
+
+    private:
+        std::vector<animation::CompiledSampler> m_Samplers;
+        std::vector<uint32_t> m_Cursors;
+        std::vector<dm::float4> m_Values;
+        std::vector<bool> m_ValueValid;
+        std::vector<NodeTrack> m_NodeTracks;
+        std::vector<std::pair<int, std::shared_ptr<SceneGraphAnimationChannel>>> m_PropertyTracks;
+        float m_Duration = 0.f;
+
+    public:
+        explicit CompiledAnimationClip(const SceneGraphAnimation& animation);
+
+        // Evaluates all channels at the given time and stores the results in the clip, without modifying the graph.
+        void Evaluate(float time);
+
+        // Writes the results of the last Evaluate call into the target nodes and leaves.
+        void ApplyEvaluatedValues() const;
+
+        // Writes the results of the last Evaluate call into the target leaves and materials only.
+        void ApplyEvaluatedProperties() const;
+
+        // A combination of Evaluate and ApplyEvaluatedValues.
+        void Apply(float time);
+
+        // Resets the keyframe cursors, which is only useful to make the next evaluation independent of playback history.
+        void ResetCursors();
+
+        [[nodiscard]] float GetDuration() const { return m_Duration; }
+        [[nodiscard]] size_t GetChannelCount() const { return m_Samplers.size(); }
+        [[nodiscard]] const std::vector<NodeTrack>& GetNodeTracks() const { return m_NodeTracks; }
+        [[nodiscard]] std::optional<dm::float4> GetEvaluatedValue(int channel) const
+            { return m_ValueValid[channel] ? std::optional(m_Values[channel]) : std::nullopt; }
+    };
+
     // A container that tracks unique resources of the same type used by some entity, for example unique meshes used in a scene graph.
     // It works by putting the resource shared pointers into a map and associating a reference count with each resource.
     // When the resource is added and released an equal number of times, its refrence count reaches zero, and it's removed from the container.
@@ -512,6 +567,15 @@ namespace donut::engine
         [[nodiscard]] size_t size() const { return m_Map.size(); }
     };
 
+    // One entry of a batched transform update, see SceneGraph::SetNodeTransforms.
+    struct SceneGraphNodeTransform
+    {
+        SceneGraphNode* node = nullptr;
+        std::optional<dm::double3> translation;
+        std::optional<dm::dquat> rotation;
+        std::optional<dm::double3> scaling;
+    };
+
     template<typename T>
     using SceneResourceCallback = std::function<void(const std::shared_ptr<T>&)>;
     
@@ -578,6 +642,10 @@ namespace donut::engine
         // Parent references with .. are supported.
         // If multiple nodes within one parent have the same name matching that component of the path, only the first node will be considered.
         [[nodiscard]] std::shared_ptr<SceneGraphNode> FindNode(const std::filesystem::path& path, SceneGraphNode* context = nullptr) const;
+
+        // Sets the transforms of multiple nodes of this graph. The result is the same as calling SetTransform on every node,
+        // but the dirty flags are propagated through each common ancestor only once.
+        void SetNodeTransforms(const std::vector<SceneGraphNodeTransform>& transforms);
         
         void Refresh(uint32_t frameIndex);
     };
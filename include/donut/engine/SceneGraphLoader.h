@@ -0,0 +1,80 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/engine/SceneGraph.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Json
+{
+    class Value;
+}
+
+namespace donut::json
+{
+    class Reader;
+}
+
+namespace donut::engine
+{
+    /*
+    SceneGraphLoader builds scene graph nodes and animations from the "graph" and "animations" sections
+    of a scene description file. The sections can be loaded from a jsoncpp document, or directly from
+    the file with json::Reader without building a document; both produce the same nodes and animations.
+
+    Model references in the graph are indices into the models array, which must outlive the loader.
+    */
+    class SceneGraphLoader
+    {
+    public:
+        SceneGraphLoader(
+            std::shared_ptr<SceneGraph> sceneGraph,
+            std::shared_ptr<SceneTypeFactory> sceneTypeFactory,
+            const std::vector<SceneImportResult>& models);
+
+        void LoadSceneGraph(const Json::Value& nodeList, const std::shared_ptr<SceneGraphNode>& parent);
+        void LoadAnimations(const Json::Value& nodeList);
+
+        // Streaming versions of the above, reading the value at the current position of the reader
+        void LoadSceneGraph(json::Reader& reader, const std::shared_ptr<SceneGraphNode>& parent);
+        void LoadAnimations(json::Reader& reader);
+
+    private:
+        std::shared_ptr<SceneGraph> m_SceneGraph;
+        std::shared_ptr<SceneTypeFactory> m_SceneTypeFactory;
+        const std::vector<SceneImportResult>& m_Models;
+
+        void LoadSceneGraphNode(json::Reader& reader, const std::shared_ptr<SceneGraphNode>& parent);
+        void LoadAnimationChannel(json::Reader& reader, const std::shared_ptr<SceneGraphAnimation>& animation, int channelIndex);
+
+        void AddAnimationTarget(
+            const std::shared_ptr<SceneGraphAnimation>& animation,
+            const std::shared_ptr<animation::Sampler>& sampler,
+            AnimationAttribute attribute,
+            const std::string& attributeName,
+            const std::string& targetName,
+            int channelIndex);
+    };
+}
@@ -255,8 +255,13 @@ namespace donut::engine
         int materialID = 0;
         bool dirty = true; // set this to true to make Scene update the material data
 
+        // Hash of the resources that the material binds, used by MaterialBindingCache to detect changes.
+        // Scene updates it for dirty materials; materials used without a Scene should call UpdateBindingHash.
+        size_t bindingHash = 0;
+
         virtual ~Material() = default;
         void FillConstantBuffer(struct MaterialConstants& constants, bool useResourceDescriptorHeapBindless = false) const;
+        void UpdateBindingHash();
         bool SetProperty(const std::string& name, const dm::float4& value);
     };
 
@@ -288,6 +293,14 @@ namespace donut::engine
         std::vector<float> radiusData;
         std::vector<dm::float4> morphTargetData;
 
+        // Vertex and index data that is uploaded directly from a blob, such as a memory-mapped scene file,
+        // instead of the vectors above. Each attribute view is uploaded into its vertex buffer range, which must be set
+        // by the code that fills the views. The views point into dataBlob and are released together with it after upload.
+        std::shared_ptr<const vfs::IBlob> dataBlob;
+        const uint32_t* indexDataView = nullptr;
+        size_t indexCount = 0;
+        std::array<const void*, size_t(VertexAttribute::Count)> vertexDataViews{};
+
         [[nodiscard]] bool hasAttribute(VertexAttribute attr) const { return vertexBufferRanges[int(attr)].byteSize != 0; }
         nvrhi::BufferRange& getVertexBufferRange(VertexAttribute attr) { return vertexBufferRanges[int(attr)]; }
         [[nodiscard]] const nvrhi::BufferRange& getVertexBufferRange(VertexAttribute attr) const { return vertexBufferRanges[int(attr)]; }
@@ -302,6 +315,13 @@ namespace donut::engine
         Count
     };
 
+    // A simplified index range of a geometry that uses the same vertices, see GenerateMeshLods.
+    struct MeshGeometryLod
+    {
+        uint32_t indexOffsetInMesh = 0;
+        uint32_t numIndices = 0;
+    };
+
     struct MeshGeometry
     {
         std::shared_ptr<Material> material;
@@ -314,6 +334,19 @@ namespace donut::engine
 
         MeshGeometryPrimitiveType type = MeshGeometryPrimitiveType::Triangles;
 
+        // Levels of detail 1 and up, level 0 is the range above. All geometries of a mesh have the same number of levels.
+        std::vector<MeshGeometryLod> lods;
+
+        // Index range of a level of detail, levels past the last one return the last one
+        [[nodiscard]] uint32_t GetLodIndexOffset(uint32_t level) const
+        {
+            return (level == 0 || lods.empty()) ? indexOffsetInMesh : lods[std::min<size_t>(level, lods.size()) - 1].indexOffsetInMesh;
+        }
+        [[nodiscard]] uint32_t GetLodNumIndices(uint32_t level) const
+        {
+            return (level == 0 || lods.empty()) ? numIndices : lods[std::min<size_t>(level, lods.size()) - 1].numIndices;
+        }
+
         virtual ~MeshGeometry() = default;
     };
 
@@ -344,6 +377,15 @@ namespace donut::engine
         nvrhi::rt::AccelStructHandle accelStruct; // for use by applications
         bool isSkinPrototype = false;
 
+        // Object-space simplification error of the levels of detail of the geometries, lodErrors[0] is level 1.
+        std::vector<float> lodErrors;
+
+        // CPU copy of the mesh positions and indices for CPU-side algorithms such as occlusion culling, relative to
+        // vertexOffset and indexOffset. The data in buffers is released once it is uploaded, so the copy is made
+        // by Scene::CreateMeshBuffers when SetKeepOccluderGeometry is enabled, or by CopyOccluderGeometry.
+        std::vector<dm::float3> occluderPositions;
+        std::vector<uint32_t> occluderIndices;
+
         virtual ~MeshInfo() = default;
         bool IsCurve() const
         {
@@ -353,6 +395,11 @@ namespace donut::engine
         }
     };
 
+    // Copies the positions and indices of a triangle mesh from its buffer group, either from the vectors or from
+    // the data views, into occluderPositions and occluderIndices. Must be called before the buffers are uploaded.
+    // Returns false when the buffer group has no CPU data for the mesh range.
+    bool CopyOccluderGeometry(MeshInfo& mesh);
+
     struct LightProbe
     {
         std::string name;
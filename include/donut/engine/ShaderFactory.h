@@ -29,7 +29,12 @@
 #include <memory>
 #include <filesystem>
 #include <functional>
+#include <shared_mutex>
 
+namespace tf
+{
+    class Executor;
+}
 
 namespace donut::vfs
 {
@@ -86,14 +91,58 @@ namespace donut::engine
     //      CreateStaticPlatformShaderLibrary(DONUT_MAKE_PLATFORM_SHADER_LIBRARY(g_MyShaderLibrary), defines);
     #define DONUT_MAKE_PLATFORM_SHADER_LIBRARY(basename) DONUT_MAKE_DXIL_SHADER(basename##_dxil), DONUT_MAKE_SPIRV_SHADER(basename##_spirv)
 
+    // Describes a shader to load and create ahead of time with ShaderFactory::PreloadShaders.
+    // If any of the static bytecode arrays are provided, the shader is created like with CreateAutoShader,
+    // otherwise like with CreateShader.
+    struct ShaderPreloadDesc
+    {
+        std::string fileName;
+        std::string entryName = "main";
+        std::vector<ShaderMacro> defines;
+        nvrhi::ShaderDesc desc;
+        StaticShader dxbc;
+        StaticShader dxil;
+        StaticShader spirv;
+    };
+
+    // All ShaderFactory methods are thread-safe.
     class ShaderFactory
     {
     private:
+        // Maps the sorted define set of every permutation in a blob to its bytecode
+        struct PermutationIndex
+        {
+            std::unordered_map<std::string, std::pair<const void*, size_t>> permutations;
+            std::weak_ptr<vfs::IBlob> owner; // The file blob that holds the bytecode, if any
+            bool hasOwner = false;
+        };
+
+        struct PermutationIndexKey
+        {
+            const void* data;
+            size_t size;
+
+            bool operator==(const PermutationIndexKey& other) const { return data == other.data && size == other.size; }
+        };
+
+        struct PermutationIndexKeyHash
+        {
+            size_t operator()(const PermutationIndexKey& key) const { return std::hash<const void*>()(key.data) ^ (key.size * 0x9E3779B97F4A7C15ull); }
+        };
+
         nvrhi::DeviceHandle m_Device;
         std::unordered_map<std::string, std::shared_ptr<vfs::IBlob>> m_BytecodeCache;
+        std::unordered_map<PermutationIndexKey, std::shared_ptr<PermutationIndex>, PermutationIndexKeyHash> m_PermutationIndices;
+        std::shared_mutex m_BytecodeCacheMutex;
+        std::shared_mutex m_PermutationIndexMutex;
 		std::shared_ptr<vfs::IFileSystem> m_fs;
 		std::filesystem::path m_basePath;
 
+        // The owner is the file blob that holds the bytecode, or null for static bytecode,
+        // which must stay valid and unchanged for the lifetime of the factory.
+        std::shared_ptr<PermutationIndex> GetPermutationIndex(const void* blob, size_t blobSize, const std::shared_ptr<vfs::IBlob>& owner);
+        bool FindPermutation(StaticShader shader, const std::shared_ptr<vfs::IBlob>& owner, const std::vector<ShaderMacro>* pDefines, const void** pBytecode, size_t* pSize);
+
     public:
         ShaderFactory(
             nvrhi::DeviceHandle device,
@@ -144,6 +193,11 @@ namespace donut::engine
         // If that fails (e.g. there is no static bytecode), creates a shader library from the filesystem binary file (calling CreateShaderLibrary).
         nvrhi::ShaderLibraryHandle CreateAutoShaderLibrary(const char* fileName, StaticShader dxil, StaticShader spirv, const std::vector<ShaderMacro>* pDefines);
 
+        // Reads the binary files and indexes the permutations of the listed shaders, then creates the shaders.
+        // The work is distributed over the executor's threads when an executor is provided.
+        // Returns the created shaders in the same order as the descriptions, with null entries for failures.
+        std::vector<nvrhi::ShaderHandle> PreloadShaders(const std::vector<ShaderPreloadDesc>& shaders, tf::Executor* executor = nullptr);
+
         // Looks up a shader binary based on a provided hash and the function used to generate it
         std::pair<const void*, size_t> FindShaderFromHash(uint64_t hash, std::function<uint64_t(std::pair<const void*, size_t>, nvrhi::GraphicsAPI)> hashGenerator);
     };
@@ -0,0 +1,69 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <limits>
+#include <vector>
+
+namespace donut::engine
+{
+    // The volume that receives the shadows of one shadow map cascade, used to skip the casters whose shadows
+    // cannot fall on it. The volume is stored in light space, where +Z is the light direction: its projection
+    // on the XY plane is a convex polygon, and it ends at the depth of the farthest receiver.
+    // A caster can only shadow the volume if its bounds, extruded along the light direction, intersect it.
+    class ShadowReceiverVolume
+    {
+    public:
+        // Builds the volume from the corners of the receiver region, such as a view frustum slice, in world space.
+        // worldToLight must be a rotation with light-space +Z along the light direction.
+        // Receivers farther along the light direction than maxReceiverDepth, in light space, are ignored.
+        void Setup(const dm::affine3& worldToLight, const dm::float3* corners, size_t numCorners,
+            float maxReceiverDepth = std::numeric_limits<float>::max());
+
+        // Builds the volume from the intersection of two convex regions in world space, each given by 8 corners in
+        // the order of dm::frustum::Corners: usually the part of the view frustum that receives shadows, and the
+        // light-space box of a cascade. The shaders use a cascade for every receiver inside its box, even outside
+        // the frustum slice the box was fitted to, so the receivers cannot be limited to that slice.
+        void SetupIntersection(const dm::affine3& worldToLight, const dm::float3* receiverCorners, const dm::float3* boundsCorners,
+            float maxReceiverDepth = std::numeric_limits<float>::max());
+
+        // Disables the culling: every caster is accepted.
+        void Reset();
+
+        [[nodiscard]] bool IsValid() const { return m_Hull.size() >= 3; }
+
+        // Returns false if a caster with the given world-space bounds cannot shadow any receiver.
+        [[nodiscard]] bool CanShadowReceivers(const dm::box3& casterBounds) const;
+
+        [[nodiscard]] const dm::affine3& GetWorldToLight() const { return m_WorldToLight; }
+        [[nodiscard]] const std::vector<dm::float2>& GetHull() const { return m_Hull; }
+        [[nodiscard]] float GetMaxDepth() const { return m_MaxDepth; }
+
+    private:
+        dm::affine3 m_WorldToLight = dm::affine3::identity();
+        std::vector<dm::float2> m_Hull; // counter-clockwise
+        dm::box2 m_HullBounds = dm::box2::empty();
+        float m_MaxDepth = 0.f;
+    };
+}
@@ -0,0 +1,357 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace donut::engine
+{
+    struct ShardedCacheStats
+    {
+        size_t size = 0;
+        uint64_t misses = 0; // Values created by GetOrCreate
+        uint64_t evictions = 0;
+    };
+
+    /*
+    ShardedCache is a thread-safe map from keys with precomputed hashes to values.
+    The entries are distributed over a number of shards by their hash, each with its own
+    reader-writer lock, so that lookups from many threads rarely touch the same lock.
+    Cache hits only take a shared lock, do not allocate memory, and only write to the entry
+    when it has not been used since it was last considered for eviction.
+
+    When a capacity is set, inserting into a full shard evicts an entry that has not been used
+    recently. The entries of each shard are kept in an intrusive list in insertion order, and
+    eviction gives a second chance to the entries that were used since they were last at the
+    front of the list (the CLOCK approximation of LRU), so it takes constant amortized time.
+    The capacity is split evenly between the shards.
+
+    GetOrCreate inserts a placeholder for a missing key and creates the value without holding
+    the lock of the shard, so that slow creations don't block the lookups of other keys.
+    Other threads that request the same key wait for that creation instead of starting their own.
+    */
+    template<typename Key, typename Value, size_t ShardCount = 16>
+    class ShardedCache
+    {
+    private:
+        // Creation started by GetOrCreate, shared by the threads that wait for it
+        struct PendingValue
+        {
+            std::mutex mutex;
+            std::condition_variable condition;
+            bool ready = false;
+            Value value;
+
+            Value Wait()
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return ready; });
+                return value;
+            }
+
+            void Publish(const Value& result)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    value = result;
+                    ready = true;
+                }
+                condition.notify_all();
+            }
+        };
+
+        struct Entry
+        {
+            Value value;
+            std::shared_ptr<PendingValue> pending; // Set while the value is being created
+            std::atomic<bool> referenced{ false };
+            const Key* key = nullptr;
+            Entry* prev = nullptr;
+            Entry* next = nullptr;
+        };
+
+        struct Shard
+        {
+            // Aligned to keep the locks of different shards on separate cache lines
+            alignas(64) mutable std::shared_mutex mutex;
+            // Elements of an unordered_map don't move on rehashing, so the list can point at them
+            std::unordered_map<Key, Entry> entries;
+            Entry* head = nullptr; // Next candidate for eviction
+            Entry* tail = nullptr;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+
+            void PushBack(Entry* entry)
+            {
+                entry->prev = tail;
+                entry->next = nullptr;
+                if (tail)
+                    tail->next = entry;
+                else
+                    head = entry;
+                tail = entry;
+            }
+
+            void Unlink(Entry* entry)
+            {
+                if (entry->prev)
+                    entry->prev->next = entry->next;
+                else
+                    head = entry->next;
+                if (entry->next)
+                    entry->next->prev = entry->prev;
+                else
+                    tail = entry->prev;
+                entry->prev = entry->next = nullptr;
+            }
+
+            Entry& Emplace(const Key& key)
+            {
+                auto it = entries.try_emplace(key).first;
+                it->second.key = &it->first;
+                PushBack(&it->second);
+                return it->second;
+            }
+        };
+
+        Shard m_Shards[ShardCount];
+        size_t m_ShardCapacity = 0;
+
+        // Mix the hash so that keys with poor low bits, such as pointers, are still spread over the shards
+        Shard& GetShard(size_t hash) { return m_Shards[((uint64_t(hash) * 0x9E3779B97F4A7C15ull) >> 32) % ShardCount]; }
+
+        // Marks the entry as used. Only writes to the entry if it was not already marked,
+        // so that hits on popular entries from many threads don't bounce its cache line.
+        static void Touch(Entry& entry)
+        {
+            if (!entry.referenced.load(std::memory_order_relaxed))
+                entry.referenced.store(true, std::memory_order_relaxed);
+        }
+
+        void EvictIfFull(Shard& shard)
+        {
+            if (m_ShardCapacity == 0)
+                return;
+
+            while (shard.entries.size() >= m_ShardCapacity && shard.head)
+            {
+                Entry* oldest = shard.head;
+                shard.Unlink(oldest);
+
+                // Used since the last pass: move it to the back of the list and look further
+                if (oldest->referenced.load(std::memory_order_relaxed))
+                {
+                    oldest->referenced.store(false, std::memory_order_relaxed);
+                    shard.PushBack(oldest);
+                    continue;
+                }
+
+                const Key key = *oldest->key;
+                shard.entries.erase(key);
+                ++shard.evictions;
+            }
+        }
+
+    public:
+        // A capacity of 0 means that the cache is not limited.
+        explicit ShardedCache(size_t capacity = 0)
+        {
+            SetCapacity(capacity);
+        }
+
+        void SetCapacity(size_t capacity)
+        {
+            m_ShardCapacity = (capacity + ShardCount - 1) / ShardCount;
+        }
+
+        // Returns the cached value for the key, or a default-constructed value if there is none
+        // or if it is still being created.
+        Value Find(const Key& key, size_t hash)
+        {
+            Shard& shard = GetShard(hash);
+            std::shared_lock<std::shared_mutex> guard(shard.mutex);
+
+            auto it = shard.entries.find(key);
+            if (it == shard.entries.end() || it->second.pending)
+                return Value();
+
+            Touch(it->second);
+            return it->second.value;
+        }
+
+        // Returns the cached value for the key, or creates it with create() and stores it.
+        // The creation runs once per key, without holding the lock of the shard; concurrent requests
+        // for the same key wait for it. The value is not stored if the entry is erased, replaced,
+        // or evicted during the creation, but it is still returned to the waiting threads.
+        template<typename CreateFunc>
+        Value GetOrCreate(const Key& key, size_t hash, CreateFunc&& create)
+        {
+            Shard& shard = GetShard(hash);
+            std::shared_ptr<PendingValue> pending;
+
+            {
+                std::shared_lock<std::shared_mutex> guard(shard.mutex);
+
+                auto it = shard.entries.find(key);
+                if (it != shard.entries.end())
+                {
+                    Touch(it->second);
+                    if (!it->second.pending)
+                        return it->second.value;
+                    pending = it->second.pending;
+                }
+            }
+
+            bool creating = false;
+            if (!pending)
+            {
+                std::lock_guard<std::shared_mutex> guard(shard.mutex);
+
+                // Another thread may have created the entry, or started creating it, while the lock was released
+                auto it = shard.entries.find(key);
+                if (it != shard.entries.end())
+                {
+                    Touch(it->second);
+                    if (!it->second.pending)
+                        return it->second.value;
+                    pending = it->second.pending;
+                }
+                else
+                {
+                    // Insert a placeholder, so that the other requests for the key wait for this creation
+                    ++shard.misses;
+                    EvictIfFull(shard);
+                    pending = std::make_shared<PendingValue>();
+                    shard.Emplace(key).pending = pending;
+                    creating = true;
+                }
+            }
+
+            if (!creating)
+                return pending->Wait();
+
+            Value value = create();
+
+            {
+                std::lock_guard<std::shared_mutex> guard(shard.mutex);
+
+                // Store the value, unless the placeholder was removed or replaced during the creation
+                auto it = shard.entries.find(key);
+                if (it != shard.entries.end() && it->second.pending == pending)
+                {
+                    it->second.value = value;
+                    it->second.pending.reset();
+                }
+            }
+
+            pending->Publish(value);
+            return value;
+        }
+
+        // Stores the value for the key, replacing the existing one.
+        void Insert(const Key& key, size_t hash, const Value& value)
+        {
+            Shard& shard = GetShard(hash);
+            std::lock_guard<std::shared_mutex> guard(shard.mutex);
+
+            auto it = shard.entries.find(key);
+            if (it != shard.entries.end())
+            {
+                it->second.value = value;
+                it->second.pending.reset();
+                Touch(it->second);
+                return;
+            }
+
+            EvictIfFull(shard);
+            shard.Emplace(key).value = value;
+        }
+
+        // Calls func(value) with a reference to the cached value under the exclusive lock of the shard,
+        // creating a default-constructed entry first if there is none. Returns the result of func.
+        // This allows replacing a stale value and reading it back atomically, so func should be cheap.
+        // If the value is still being created by GetOrCreate, func gets a default-constructed value,
+        // and its result replaces the one being created.
+        template<typename UpdateFunc>
+        auto Update(const Key& key, size_t hash, UpdateFunc&& func)
+        {
+            Shard& shard = GetShard(hash);
+            std::lock_guard<std::shared_mutex> guard(shard.mutex);
+
+            auto it = shard.entries.find(key);
+            if (it != shard.entries.end())
+            {
+                Touch(it->second);
+                it->second.pending.reset();
+                return func(it->second.value);
+            }
+
+            ++shard.misses;
+            EvictIfFull(shard);
+            return func(shard.Emplace(key).value);
+        }
+
+        void Erase(const Key& key, size_t hash)
+        {
+            Shard& shard = GetShard(hash);
+            std::lock_guard<std::shared_mutex> guard(shard.mutex);
+
+            auto it = shard.entries.find(key);
+            if (it == shard.entries.end())
+                return;
+
+            shard.Unlink(&it->second);
+            shard.entries.erase(it);
+        }
+
+        void Clear()
+        {
+            for (Shard& shard : m_Shards)
+            {
+                std::lock_guard<std::shared_mutex> guard(shard.mutex);
+                shard.entries.clear();
+                shard.head = shard.tail = nullptr;
+            }
+        }
+
+        [[nodiscard]] ShardedCacheStats GetStats() const
+        {
+            ShardedCacheStats stats;
+            for (const Shard& shard : m_Shards)
+            {
+                std::shared_lock<std::shared_mutex> guard(shard.mutex);
+                stats.size += shard.entries.size();
+                stats.misses += shard.misses;
+                stats.evictions += shard.evictions;
+            }
+            return stats;
+        }
+    };
+}
@@ -0,0 +1,86 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <memory>
+#include <vector>
+
+namespace tf
+{
+    class Executor;
+}
+
+namespace donut::engine
+{
+    class SceneGraphNode;
+    class SkinnedMeshInstance;
+
+    enum class SkinningUpdate : uint8_t
+    {
+        Idle,       // The instance is not animated, and its previous positions are settled
+        Deferred,   // The instance is animated, but it is not scheduled on this frame
+        Scheduled   // The instance is skinned on this frame
+    };
+
+    // Decides whether an instance that is throttled by the skinning LOD to one update every updateInterval frames
+    // is skinned on this frame. The schedule is offset by instanceIndex to spread the updates evenly over the interval.
+    // Animation that happens between the scheduled frames is picked up on the next one, and one extra update
+    // settles the previous positions. Updates the skinning state of the instance when the result is Scheduled.
+    SkinningUpdate ScheduleSkinningUpdate(SkinnedMeshInstance& instance, uint32_t frameIndex, uint32_t instanceIndex,
+        uint32_t updateInterval);
+
+    // Skinning palettes for a set of skinned instances, packed into one array at SkinnedMeshInstance::jointBufferOffset.
+    // The joint nodes are resolved once by SetInstances instead of locking the weak pointers on every frame,
+    // so SetInstances must be called again after any structure change in the scene graph.
+    class SkinningPalette
+    {
+    public:
+        // Packs the joints of the instances, assigns their jointBufferOffset and resolves the skeleton hierarchy
+        // used by the joint LOD.
+        void SetInstances(const std::vector<std::shared_ptr<SkinnedMeshInstance>>& instances);
+
+        // Computes the skinning matrices of the given instances, which must be a subset of the instances
+        // passed to SetInstances. maxJointDepths provides the LOD joint depth for each instance, or is nullptr
+        // to compute all joints. With an executor, the instances are processed in parallel.
+        // Returns the number of joint matrices that were computed.
+        uint32_t Compute(const SkinnedMeshInstance* const* instances, const uint32_t* maxJointDepths, size_t count,
+            tf::Executor* executor = nullptr);
+
+        [[nodiscard]] size_t GetJointCount() const { return m_JointMatrices.size(); }
+        [[nodiscard]] const dm::float4x4* GetJointMatrices() const { return m_JointMatrices.data(); }
+        [[nodiscard]] uint32_t GetJointDepth(size_t joint) const { return m_JointDepths[joint]; }
+
+    private:
+        std::vector<dm::float4x4> m_JointMatrices;
+        std::vector<const SceneGraphNode*> m_JointNodes;
+        std::vector<int> m_JointParents;       // Index of the parent joint within the same instance, or -1
+        std::vector<uint32_t> m_JointDepths;   // Number of ancestor joints within the same instance
+        std::vector<uint32_t> m_ComputedJoints;
+
+        // Computes the skinning matrices for one instance: inverseBindMatrix * jointToWorld * worldToRoot.
+        // Joints deeper than maxJointDepth copy the matrix of their ancestor at that depth.
+        static uint32_t ComputeInstance(const SkinnedMeshInstance& instance, const SceneGraphNode* const* jointNodes,
+            const int* jointParents, const uint32_t* jointDepths, uint32_t maxJointDepth, dm::float4x4* jointMatrices);
+    };
+}
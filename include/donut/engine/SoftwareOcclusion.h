@@ -0,0 +1,88 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <vector>
+
+namespace donut::engine
+{
+    // A low-resolution depth buffer that is rasterized on the CPU from a few large occluders, and then used to
+    // test the bounding boxes of other objects before they are submitted to the GPU.
+    // 
+    // Depths are stored as normalized device depth remapped so that 0 is the near plane and 1 is the far plane,
+    // with both regular and reverse depth projections. Every tile of TileSize x TileSize pixels also keeps the
+    // farthest depth of its pixels, so that most boxes are accepted or rejected without visiting their pixels.
+    // Rasterization uses SSE where available and processes 4 pixels at a time.
+    class SoftwareOcclusionBuffer
+    {
+    public:
+        static constexpr uint32_t TileSize = 8;
+
+        // The width and height are rounded up to multiples of TileSize.
+        explicit SoftwareOcclusionBuffer(uint32_t width = 256, uint32_t height = 128);
+
+        // Clears the buffer and sets the view projection used by the following calls.
+        void Begin(const dm::float4x4& viewProjMatrix, bool reverseDepth);
+
+        // Rasterizes an indexed triangle list, with positions transformed by objectToWorld.
+        // Triangles are not culled by their orientation, and the parts in front of the near plane are clipped.
+        // Returns the number of triangles that were at least partially in front of the camera.
+        uint32_t RasterizeTriangles(const dm::float3* positions, const uint32_t* indices, size_t numIndices, const dm::affine3& objectToWorld);
+
+        // Computes the tile depths after rasterization. Must be called before testing boxes.
+        void End();
+
+        // Returns false if the world-space box is entirely outside of the view or behind the occluders.
+        [[nodiscard]] bool IsBoxVisible(const dm::box3& worldBox) const;
+
+        // Returns the larger of the width and height of the screen rectangle covered by the box, relative to the
+        // buffer size. Boxes that cross the near plane return 1.
+        [[nodiscard]] float GetScreenSize(const dm::box3& worldBox) const;
+
+        [[nodiscard]] uint32_t GetWidth() const { return m_Width; }
+        [[nodiscard]] uint32_t GetHeight() const { return m_Height; }
+        [[nodiscard]] float GetDepth(uint32_t x, uint32_t y) const { return m_Depth[y * m_Width + x]; }
+
+    private:
+        uint32_t m_Width;
+        uint32_t m_Height;
+        uint32_t m_TilesX;
+        uint32_t m_TilesY;
+        std::vector<float> m_Depth;
+        std::vector<float> m_TileMaxDepth;
+        dm::float4x4 m_ViewProjMatrix = dm::float4x4::identity();
+        bool m_ReverseDepth = false;
+
+        // Returns the distance of a clip-space point from the near plane, positive in front of it
+        [[nodiscard]] float NearPlaneDistance(const dm::float4& clip) const { return m_ReverseDepth ? clip.w - clip.z : clip.z; }
+
+        [[nodiscard]] dm::float3 ClipToScreen(const dm::float4& clip) const;
+
+        // Computes the screen rectangle and the nearest depth of a box, returns false if it crosses the near plane.
+        bool ProjectBox(const dm::box3& worldBox, dm::float2& minScreen, dm::float2& maxScreen, float& minDepth) const;
+
+        void RasterizeClippedTriangle(const dm::float4* clip);
+        void RasterizeScreenTriangle(dm::float3 v0, dm::float3 v1, dm::float3 v2);
+    };
+}
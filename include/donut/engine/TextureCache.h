@@ -28,17 +28,16 @@
 #include <nvrhi/nvrhi.h>
 #include <atomic>
 #include <filesystem>
+#include <future>
 #include <unordered_map>
 #include <memory>
 #include <shared_mutex>
 #include <queue>
 
-#ifdef DONUT_WITH_TASKFLOW
 namespace tf
 {
     class Executor;
 }
-#endif
 
 namespace donut::vfs
 {
@@ -48,6 +47,7 @@ namespace donut::vfs
 
 namespace donut::engine
 {
+    class AsyncReadback;
     class CommonRenderPasses;
 
     struct TextureSubresourceData
@@ -245,7 +245,7 @@ namespace donut::engine
 
     // Saves the contents of texture's slice 0 mip level 0 into an image file.
     // The image format is determined from the file's extension.
-    // Supported formats are: BMP, PNG, JPG, TGA.
+    // Supported formats are: BMP, PNG, JPG, TGA, and EXR when Donut is built with tinyexr.
     // Requires that no immediate command list is open at the time this function is called.
     // Creates and destroys temporary resources internally, so should NOT be called often.
     bool SaveTextureToFile(
@@ -255,4 +255,19 @@ namespace donut::engine
         nvrhi::ResourceStates textureState,
         const char* fileName,
         bool saveAlphaChannel = true);
+
+    // Same as SaveTextureToFile, but records the copy into an open command list and returns immediately.
+    // The pixels are delivered by the readback service a few frames later, and the image is then encoded and written
+    // on a worker thread of the executor, or on the thread that calls AsyncReadback::Poll without one.
+    // The returned future becomes ready when the file has been written, or the operation has failed.
+    std::future<bool> SaveTextureToFileAsync(
+        nvrhi::IDevice* device,
+        CommonRenderPasses* pPasses,
+        nvrhi::ICommandList* commandList,
+        nvrhi::ITexture* texture,
+        nvrhi::ResourceStates textureState,
+        AsyncReadback& readback,
+        const char* fileName,
+        bool saveAlphaChannel = true,
+        tf::Executor* executor = nullptr);
 }
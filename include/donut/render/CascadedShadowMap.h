@@ -23,13 +23,21 @@
 #pragma once
 
 #include <donut/engine/SceneGraph.h>
+#include <donut/engine/ShadowCasterCulling.h>
 #include <donut/engine/ShadowMap.h>
 #include <donut/engine/View.h>
 #include <nvrhi/nvrhi.h>
 #include <memory>
 
+namespace donut::engine
+{
+    class FramebufferFactory;
+}
+
 namespace donut::render
 {
+    class IGeometryPass;
+    class ParallelViewRecorder;
     class PlanarShadowMap;
 
     class CascadedShadowMap : public engine::IShadowMap
@@ -38,9 +46,16 @@ namespace donut::render
         nvrhi::TextureHandle m_ShadowMapTexture;
         std::vector<std::shared_ptr<PlanarShadowMap>> m_Cascades;
         std::vector<std::shared_ptr<PlanarShadowMap>> m_PerObjectShadows;
+        std::vector<engine::ShadowReceiverVolume> m_ReceiverVolumes;
         engine::CompositeView m_CompositeView;
+        std::shared_ptr<engine::FramebufferFactory> m_FramebufferFactory;
+        dm::box3 m_SceneBounds = dm::box3::empty();
         int m_NumberOfCascades;
 
+        // Sets up the receiver volume of a cascade after its view, from the 8 corners of the whole view region
+        // that receives shadows, in the order of dm::frustum::Corners.
+        void SetupReceiverVolume(int cascade, const dm::affine3& worldToLight, const dm::float3* receiverCorners, dm::float3 preViewTranslation);
+
     public:
         CascadedShadowMap(
             nvrhi::IDevice* device,
@@ -89,8 +104,30 @@ namespace donut::render
 
         void SetupProxyViews();
 
+        // Sets the world-space bounds of all shadow casters and receivers, usually the global bounding box of the
+        // scene graph root. When the bounds are not empty, the Setup functions fit the light-space depth range of the
+        // cascades to them instead of using lightSpaceZUp and lightSpaceZDown, and the receiver volumes ignore
+        // everything beyond the bounds. Applies to the next Setup call.
+        void SetSceneBounds(const dm::box3& bounds) { m_SceneBounds = bounds; }
+        [[nodiscard]] const dm::box3& GetSceneBounds() const { return m_SceneBounds; }
+
+        // Returns the volume that receives the shadows of a cascade, computed by the last Setup call.
+        // The volume is not valid for cascades set up with SetupProxyViews.
+        [[nodiscard]] const engine::ShadowReceiverVolume& GetReceiverVolume(uint32_t cascade) const { return m_ReceiverVolumes[cascade]; }
+
+        // Returns the index of the cascade that renders into the view, or -1 if the view is not a cascade.
+        [[nodiscard]] int FindCascade(const engine::IView& view) const;
+
         void Clear(nvrhi::ICommandList* commandList);
 
+        // Records the cascades with the recorder, into one or more command lists per cascade.
+        // The recorder should create a ShadowCasterDrawStrategy for this shadow map for every view.
+        // The shadow map must be cleared by a command list that is executed before the recorded ones.
+        void RenderCascades(
+            ParallelViewRecorder& recorder,
+            const std::shared_ptr<engine::SceneGraphNode>& rootNode,
+            IGeometryPass& pass);
+
         void SetLitOutOfBounds(bool litOutOfBounds);
         void SetFalloffDistance(float distance);
 		void SetNumberOfCascadesUnsafe(int cascades);
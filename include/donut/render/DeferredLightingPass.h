@@ -27,6 +27,7 @@
 #include <memory>
 #include <unordered_map>
 #include <donut/engine/BindingCache.h>
+#include <donut/engine/LightClusters.h>
 
 namespace donut::engine
 {
@@ -52,12 +53,16 @@ namespace donut::render
         nvrhi::SamplerHandle m_ShadowSampler;
         nvrhi::SamplerHandle m_ShadowSamplerComparison;
         nvrhi::BufferHandle m_DeferredLightingCB;
+        nvrhi::BufferHandle m_LightBuffer;
+        nvrhi::BufferHandle m_LightClusterBuffer;
+        nvrhi::BufferHandle m_LightIndexBuffer;
         nvrhi::ComputePipelineHandle m_Pso;
 
         nvrhi::BindingLayoutHandle m_BindingLayout;
         engine::BindingCache m_BindingSets;
 
         std::shared_ptr<engine::CommonRenderPasses> m_CommonPasses;
+        engine::LightClusterGrid m_LightClusters;
 
     protected:
 
@@ -101,5 +106,12 @@ namespace donut::render
             dm::float2 randomOffset = dm::float2::zero());
 
         void ResetBindingCache();
+
+        // Controls the assignment of point and spot lights to screen-space clusters.
+        void SetLightClusterSettings(const engine::LightClusterSettings& settings) { m_LightClusters.SetSettings(settings); }
+        [[nodiscard]] const engine::LightClusterSettings& GetLightClusterSettings() const { return m_LightClusters.GetSettings(); }
+
+        // Statistics of the clusters built for the last view rendered.
+        [[nodiscard]] const engine::LightClusterStats& GetLightClusterStats() const { return m_LightClusters.GetStats(); }
     };
 }
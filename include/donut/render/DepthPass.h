@@ -34,6 +34,7 @@ namespace donut::engine
     class CommonRenderPasses;
     class FramebufferFactory;
     class MaterialBindingCache;
+    class PipelineManager;
     class ICompositeView;
     class IView;
 }
@@ -61,6 +62,9 @@ namespace donut::render
         {
         public:
             nvrhi::BindingSetHandle inputBindingSet;
+            nvrhi::BufferHandle instanceIndirectionBuffer;
+            // Keeps the binding set of the current material alive until its draws are recorded
+            nvrhi::BindingSetHandle materialBindingSet;
             PipelineKey keyTemplate;
 
             uint32_t positionOffset = 0;
@@ -75,6 +79,10 @@ namespace donut::render
         struct CreateParameters
         {
             std::shared_ptr<engine::MaterialBindingCache> materialBindings;
+
+            // When provided, pipelines are created through the manager, possibly asynchronously,
+            // and draws are skipped until their pipelines are ready.
+            std::shared_ptr<engine::PipelineManager> pipelineManager;
             int depthBias = 0;
             float depthBiasClamp = 0.f;
             float slopeScaledDepthBias = 0.f;
@@ -106,20 +114,22 @@ namespace donut::render
         bool m_UseInputAssembler = false;
         bool m_TrackLiveness = true;
 
-        std::unordered_map<const engine::BufferGroup*, nvrhi::BindingSetHandle> m_InputBindingSets;
+        InputBindingSetCache m_InputBindingSets;
         
         std::shared_ptr<engine::CommonRenderPasses> m_CommonPasses;
         std::shared_ptr<engine::MaterialBindingCache> m_MaterialBindings;
+        std::shared_ptr<engine::PipelineManager> m_PipelineManager;
+        uint64_t m_PipelineOwner = 0;
 
         virtual nvrhi::ShaderHandle CreateVertexShader(engine::ShaderFactory& shaderFactory, const CreateParameters& params);
         virtual nvrhi::ShaderHandle CreatePixelShader(engine::ShaderFactory& shaderFactory, const CreateParameters& params);
         virtual nvrhi::InputLayoutHandle CreateInputLayout(nvrhi::IShader* vertexShader, const CreateParameters& params);
         virtual nvrhi::BindingLayoutHandle CreateInputBindingLayout();
-        virtual nvrhi::BindingSetHandle CreateInputBindingSet(const engine::BufferGroup* bufferGroup);
+        virtual nvrhi::BindingSetHandle CreateInputBindingSet(const engine::BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection);
         virtual void CreateViewBindings(nvrhi::BindingLayoutHandle& layout, nvrhi::BindingSetHandle& set, const CreateParameters& params);
         virtual std::shared_ptr<engine::MaterialBindingCache> CreateMaterialBindingCache(engine::CommonRenderPasses& commonPasses);
         virtual nvrhi::GraphicsPipelineHandle CreateGraphicsPipeline(PipelineKey key, nvrhi::FramebufferInfo const& framebufferInfo);
-        nvrhi::BindingSetHandle GetOrCreateInputBindingSet(const engine::BufferGroup* bufferGroup);
+        nvrhi::BindingSetHandle GetOrCreateInputBindingSet(const engine::BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection);
 
 
     public:
@@ -127,6 +137,8 @@ namespace donut::render
             nvrhi::IDevice* device,
             std::shared_ptr<engine::CommonRenderPasses> commonPasses);
 
+        ~DepthPass() override;
+
         virtual void Init(
             engine::ShaderFactory& shaderFactory,
             const CreateParameters& params);
@@ -140,6 +152,8 @@ namespace donut::render
         bool SetupMaterial(GeometryPassContext& context, const engine::Material* material, nvrhi::RasterCullMode cullMode, nvrhi::GraphicsState& state) override;
         void SetupInputBuffers(GeometryPassContext& context, const engine::BufferGroup* buffers, nvrhi::GraphicsState& state) override;
         void SetPushConstants(GeometryPassContext& context, nvrhi::ICommandList* commandList, nvrhi::GraphicsState& state, nvrhi::DrawArguments& args) override;
+        [[nodiscard]] bool SupportsInstanceIndirection() const override { return !m_UseInputAssembler; }
+        void SetInstanceIndirection(GeometryPassContext& context, nvrhi::IBuffer* buffer) override;
     };
 
 }
\ No newline at end of file
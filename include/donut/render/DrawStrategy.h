@@ -23,7 +23,12 @@
 #pragma once
 
 #include <donut/engine/SceneGraph.h>
+#include <donut/engine/SoftwareOcclusion.h>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace donut::engine
@@ -34,6 +39,71 @@ namespace donut::engine
 namespace donut::render
 {
     struct DrawItem;
+    class CascadedShadowMap;
+
+    struct LodStats
+    {
+        uint64_t triangles = 0;             // Triangles of the drawn items at their selected levels of detail
+        uint64_t trianglesWithoutLod = 0;   // Triangles of the same items at full detail
+    };
+
+    // Selects the levels of detail of mesh instances (MeshGeometry::lods) from the projected size of their
+    // simplification errors (MeshInfo::lodErrors). An instance uses the coarsest level whose error covers at most
+    // MaxScreenError pixels, but it only switches to a level coarser than the one it had in the previous frame when
+    // the error is also below MaxScreenError * (1 - Hysteresis), so that it doesn't alternate between two levels.
+    // The levels are remembered per view and instance. One selector can be shared by all the strategies and views
+    // of a frame; call BeginFrame once per frame.
+    class LodSelector
+    {
+    public:
+        // View parameters computed once per PrepareForView call
+        struct ViewInfo
+        {
+            const engine::IView* view = nullptr;
+            dm::float3 origin = 0.f;
+            float pixelsPerUnit = 0.f;  // at unit distance for perspective views
+            bool orthographic = false;
+        };
+
+        float MaxScreenError = 1.f;
+        float Hysteresis = 0.25f;
+
+        [[nodiscard]] static ViewInfo GetViewInfo(const engine::IView& view);
+
+        uint32_t SelectLevel(const ViewInfo& view, const engine::MeshInstance& instance);
+
+        // Adds the triangles of a drawn geometry to the statistics
+        void CountTriangles(const engine::MeshGeometry& geometry, uint32_t level);
+
+        // Resets the statistics and forgets the instances that were not drawn in the previous frame
+        void BeginFrame();
+
+        // Returns the statistics accumulated since the last BeginFrame
+        [[nodiscard]] LodStats GetStats() const;
+
+    private:
+        struct Key
+        {
+            const engine::IView* view;
+            const engine::MeshInstance* instance;
+
+            bool operator==(const Key& other) const { return view == other.view && instance == other.instance; }
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const
+            {
+                return std::hash<const void*>()(key.view) ^ (std::hash<const void*>()(key.instance) * 31);
+            }
+        };
+
+        std::mutex m_Mutex;
+        std::unordered_map<Key, uint32_t, KeyHash> m_PreviousLevels;
+        std::unordered_map<Key, uint32_t, KeyHash> m_CurrentLevels;
+        std::atomic<uint64_t> m_Triangles = 0;
+        std::atomic<uint64_t> m_TrianglesWithoutLod = 0;
+    };
 
     class IDrawStrategy
     {
@@ -72,10 +142,14 @@ namespace donut::render
         std::vector<const DrawItem*> m_InstancePtrChunk;
         size_t m_ReadPtr = 0;
         size_t m_ChunkSize = 128;
+        std::shared_ptr<LodSelector> m_LodSelector;
+        LodSelector::ViewInfo m_LodView;
 
         void FillChunk();
 
     public:
+        // Enables the selection of levels of detail for the drawn geometry, or disables it when null.
+        void SetLodSelector(std::shared_ptr<LodSelector> selector) { m_LodSelector = std::move(selector); }
 
         void PrepareForView(
             const std::shared_ptr<engine::SceneGraphNode>& rootNode,
@@ -93,9 +167,13 @@ namespace donut::render
         std::vector<DrawItem> m_InstancesToDraw;
         std::vector<const DrawItem*> m_InstancePtrsToDraw;
         size_t m_ReadPtr = 0;
+        std::shared_ptr<LodSelector> m_LodSelector;
 
     public:
         bool DrawDoubleSidedMaterialsSeparately = true;
+
+        // Enables the selection of levels of detail for the drawn geometry, or disables it when null.
+        void SetLodSelector(std::shared_ptr<LodSelector> selector) { m_LodSelector = std::move(selector); }
         
         void PrepareForView(
             const std::shared_ptr<engine::SceneGraphNode>& rootNode,
@@ -103,4 +181,115 @@ namespace donut::render
 
         const DrawItem* GetNextItem() override;
     };
-}
\ No newline at end of file
+
+    struct OcclusionCullingStats
+    {
+        uint32_t candidates = 0;        // Draw items that passed the frustum test
+        uint32_t culled = 0;            // Candidates rejected by the occlusion test
+        uint32_t occluders = 0;         // Instances rasterized into the occlusion buffer
+        uint32_t occluderTriangles = 0; // Triangles of those instances that were in front of the camera
+        float rasterizeMs = 0.f;        // Time spent selecting and rasterizing the occluders
+        float testMs = 0.f;             // Time spent testing the candidates and selecting the next occluders
+    };
+
+    // Draws opaque and alpha-tested geometry like InstancedOpaqueDrawStrategy, but also rejects the instances that
+    // are hidden behind a few occluders rasterized on the CPU into a SoftwareOcclusionBuffer.
+    // The occluders are the largest instances drawn in the previous PrepareForView call, plus the visible instances
+    // of meshes marked with SetOccluderMesh. Only opaque triangle geometries with CPU index and position data can be
+    // occluders, and skinned instances never are. That data is MeshInfo::occluderPositions and occluderIndices, which
+    // Scene fills when SetKeepOccluderGeometry is enabled, or BufferGroup::indexData and positionData before upload.
+    // Since the occluders are carried over between calls, each view should use its own strategy object.
+    class OcclusionCullingDrawStrategy : public IDrawStrategy
+    {
+    private:
+        struct Occluder
+        {
+            const engine::MeshInstance* instance;
+            float screenSize;
+        };
+
+        engine::SoftwareOcclusionBuffer m_OcclusionBuffer;
+        std::vector<DrawItem> m_InstancesToDraw;
+        std::vector<const DrawItem*> m_InstancePtrsToDraw;
+        std::vector<Occluder> m_Occluders;
+        std::vector<std::weak_ptr<engine::MeshInstance>> m_PreviousOccluders;
+        std::unordered_set<const engine::MeshInfo*> m_OccluderMeshes;
+        OcclusionCullingStats m_Stats;
+        size_t m_ReadPtr = 0;
+        std::shared_ptr<LodSelector> m_LodSelector;
+
+        [[nodiscard]] static bool CanBeOccluder(const engine::MeshInfo& mesh);
+        void LimitOccluders();
+        void RasterizeOccluders(const dm::frustum& viewFrustum);
+        void CullOccludedItems();
+        void SelectNextOccluders();
+
+    public:
+        // Visible instances whose screen size, as returned by SoftwareOcclusionBuffer::GetScreenSize,
+        // is at least this value become occluders for the next view.
+        float OccluderMinScreenSize = 0.15f;
+
+        // Limits the number of instances rasterized per view, the largest ones are used.
+        uint32_t MaxOccluders = 32;
+
+        // When disabled, the strategy only performs frustum culling.
+        bool EnableOcclusionCulling = true;
+
+        explicit OcclusionCullingDrawStrategy(uint32_t bufferWidth = 256, uint32_t bufferHeight = 128);
+
+        // Marks the mesh so that all of its visible instances are used as occluders.
+        void SetOccluderMesh(const engine::MeshInfo* mesh, bool isOccluder);
+
+        // Enables the selection of levels of detail for the drawn geometry, or disables it when null.
+        // The occluders are always rasterized at full detail.
+        void SetLodSelector(std::shared_ptr<LodSelector> selector) { m_LodSelector = std::move(selector); }
+
+        void PrepareForView(
+            const std::shared_ptr<engine::SceneGraphNode>& rootNode,
+            const engine::IView& view) override;
+
+        const DrawItem* GetNextItem() override;
+
+        [[nodiscard]] const OcclusionCullingStats& GetStats() const { return m_Stats; }
+        [[nodiscard]] const engine::SoftwareOcclusionBuffer& GetOcclusionBuffer() const { return m_OcclusionBuffer; }
+    };
+
+    struct ShadowCasterCullingStats
+    {
+        uint32_t candidates = 0;    // Draw items inside the light-space box of the cascade
+        uint32_t culled = 0;        // Candidates skipped because they cannot shadow any receiver of the cascade
+    };
+
+    // Draws the opaque and alpha-tested shadow casters like InstancedOpaqueDrawStrategy, but when the view is a cascade
+    // of the shadow map, it also skips the instances that cannot shadow the receivers of that cascade, as described by
+    // CascadedShadowMap::GetReceiverVolume. Other views only get frustum culling.
+    // The statistics are accumulated per cascade until ResetStats is called.
+    class ShadowCasterDrawStrategy : public IDrawStrategy
+    {
+    private:
+        std::shared_ptr<CascadedShadowMap> m_ShadowMap;
+        std::vector<DrawItem> m_InstancesToDraw;
+        std::vector<const DrawItem*> m_InstancePtrsToDraw;
+        std::vector<ShadowCasterCullingStats> m_Stats;
+        size_t m_ReadPtr = 0;
+        std::shared_ptr<LodSelector> m_LodSelector;
+
+    public:
+        // When disabled, the strategy only performs frustum culling, but still counts the items it would skip.
+        bool EnableReceiverCulling = true;
+
+        explicit ShadowCasterDrawStrategy(std::shared_ptr<CascadedShadowMap> shadowMap);
+
+        // Enables the selection of levels of detail for the drawn geometry, or disables it when null.
+        void SetLodSelector(std::shared_ptr<LodSelector> selector) { m_LodSelector = std::move(selector); }
+
+        void PrepareForView(
+            const std::shared_ptr<engine::SceneGraphNode>& rootNode,
+            const engine::IView& view) override;
+
+        const DrawItem* GetNextItem() override;
+
+        void ResetStats();
+        [[nodiscard]] ShadowCasterCullingStats GetStats(uint32_t cascade) const;
+    };
+}
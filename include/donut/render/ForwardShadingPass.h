@@ -24,6 +24,7 @@
 
 #include <donut/engine/View.h>
 #include <donut/engine/SceneTypes.h>
+#include <donut/engine/LightClusters.h>
 #include <donut/render/GeometryPasses.h>
 #include <memory>
 #include <mutex>
@@ -36,6 +37,7 @@ namespace donut::engine
     class CommonRenderPasses;
     class FramebufferFactory;
     class MaterialBindingCache;
+    class PipelineManager;
     struct Material;
     struct LightProbe;
 }
@@ -104,8 +106,23 @@ namespace donut::render
         public:
             nvrhi::BindingSetHandle shadingBindingSet;
             nvrhi::BindingSetHandle inputBindingSet;
+            nvrhi::BufferHandle instanceIndirectionBuffer;
+            // Keeps the binding set of the current material alive until its draws are recorded
+            nvrhi::BindingSetHandle materialBindingSet;
             ForwardShadingPassPipelineKey keyTemplate;
 
+            // Filled by PrepareLights, the clusters are built for every view in SetupView
+            engine::LightClusterGrid lightClusters;
+            nvrhi::ITexture* shadowMapTexture = nullptr;
+            nvrhi::ITexture* lightProbeDiffuse = nullptr;
+            nvrhi::ITexture* lightProbeSpecular = nullptr;
+            nvrhi::ITexture* lightProbeEnvironmentBrdf = nullptr;
+
+            // Set by PrepareViewSlices and consumed by SetupView: the clusters already built for the view,
+            // and whether the command list of this context uploads them
+            const engine::LightClusterGrid* viewLightClusters = nullptr;
+            bool uploadLightClusters = true;
+
             uint32_t positionOffset = 0;
             uint32_t texCoordOffset = 0;
             uint32_t normalOffset = 0;
@@ -115,6 +132,10 @@ namespace donut::render
         struct CreateParameters
         {
             std::shared_ptr<engine::MaterialBindingCache> materialBindings;
+
+            // When provided, pipelines are created through the manager, possibly asynchronously,
+            // and draws are skipped until their pipelines are ready.
+            std::shared_ptr<engine::PipelineManager> pipelineManager;
             bool singlePassCubemap = false;
             bool trackLiveness = true;
 
@@ -123,6 +144,9 @@ namespace donut::render
             bool useInputAssembler = false;
 
             uint32_t numConstantBufferVersions = 16;
+
+            // Controls the assignment of point and spot lights to screen-space clusters.
+            engine::LightClusterSettings lightClusters;
         };
 
 
@@ -141,6 +165,10 @@ namespace donut::render
         engine::ViewType::Enum m_SupportedViewTypes = engine::ViewType::PLANAR;
         nvrhi::BufferHandle m_ForwardViewCB;
         nvrhi::BufferHandle m_ForwardLightCB;
+        nvrhi::BufferHandle m_LightBuffer;
+        nvrhi::BufferHandle m_LightClusterBuffer;
+        nvrhi::BufferHandle m_LightIndexBuffer;
+        engine::LightClusterSettings m_LightClusterSettings;
         bool m_TrackLiveness = true;
         bool m_IsDX11 = false;
         bool m_UseInputAssembler = false;
@@ -148,10 +176,12 @@ namespace donut::render
 
         std::unordered_map<ForwardShadingPassPipelineKey, nvrhi::GraphicsPipelineHandle> m_Pipelines;
         std::unordered_map<std::pair<nvrhi::ITexture*, nvrhi::ITexture*>, nvrhi::BindingSetHandle> m_ShadingBindingSets;
-        std::unordered_map<const engine::BufferGroup*, nvrhi::BindingSetHandle> m_InputBindingSets;
+        InputBindingSetCache m_InputBindingSets;
         
         std::shared_ptr<engine::CommonRenderPasses> m_CommonPasses;
         std::shared_ptr<engine::MaterialBindingCache> m_MaterialBindings;
+        std::shared_ptr<engine::PipelineManager> m_PipelineManager;
+        uint64_t m_PipelineOwner = 0;
         
         virtual nvrhi::ShaderHandle CreateVertexShader(engine::ShaderFactory& shaderFactory, const CreateParameters& params);
         virtual nvrhi::ShaderHandle CreateGeometryShader(engine::ShaderFactory& shaderFactory, const CreateParameters& params);
@@ -162,22 +192,30 @@ namespace donut::render
         virtual nvrhi::BindingLayoutHandle CreateShadingBindingLayout();
         virtual nvrhi::BindingSetHandle CreateShadingBindingSet(nvrhi::ITexture* shadowMapTexture, nvrhi::ITexture* diffuse, nvrhi::ITexture* specular, nvrhi::ITexture* environmentBrdf);
         virtual nvrhi::BindingLayoutHandle CreateInputBindingLayout();
-        virtual nvrhi::BindingSetHandle CreateInputBindingSet(const engine::BufferGroup* bufferGroup);
+        virtual nvrhi::BindingSetHandle CreateInputBindingSet(const engine::BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection);
         virtual std::shared_ptr<engine::MaterialBindingCache> CreateMaterialBindingCache(engine::CommonRenderPasses& commonPasses);
         virtual nvrhi::GraphicsPipelineHandle CreateGraphicsPipeline(ForwardShadingPassPipelineKey const& key, nvrhi::FramebufferInfo const& framebufferInfo);
-        nvrhi::BindingSetHandle GetOrCreateInputBindingSet(const engine::BufferGroup* bufferGroup);
+        nvrhi::BindingSetHandle GetOrCreateInputBindingSet(const engine::BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection);
+        nvrhi::BindingSetHandle GetOrCreateShadingBindingSet(const Context& context);
 
     public:
         ForwardShadingPass(
             nvrhi::IDevice* device,
             std::shared_ptr<engine::CommonRenderPasses> commonPasses);
 
+        ~ForwardShadingPass() override;
+
         virtual void Init(
             engine::ShaderFactory& shaderFactory,
             const CreateParameters& params);
 
         void ResetBindingCache();
+
+        void SetLightClusterSettings(const engine::LightClusterSettings& settings) { m_LightClusterSettings = settings; }
+        [[nodiscard]] const engine::LightClusterSettings& GetLightClusterSettings() const { return m_LightClusterSettings; }
         
+        // Copies the lights into the light buffer, with no limit on their number. Point and spot lights with
+        // a finite range are assigned to clusters when the context is set up for each view.
         virtual void PrepareLights(
             Context& context,
             nvrhi::ICommandList* commandList,
@@ -193,6 +231,9 @@ namespace donut::render
         bool SetupMaterial(GeometryPassContext& context, const engine::Material* material, nvrhi::RasterCullMode cullMode, nvrhi::GraphicsState& state) override;
         void SetupInputBuffers(GeometryPassContext& context, const engine::BufferGroup* buffers, nvrhi::GraphicsState& state) override;
         void SetPushConstants(GeometryPassContext& context, nvrhi::ICommandList* commandList, nvrhi::GraphicsState& state, nvrhi::DrawArguments& args) override;
+        [[nodiscard]] bool SupportsInstanceIndirection() const override { return !m_UseInputAssembler; }
+        void SetInstanceIndirection(GeometryPassContext& context, nvrhi::IBuffer* buffer) override;
+        void PrepareViewSlices(GeometryPassContext* const* sliceContexts, size_t numSlices, const engine::IView* view) override;
     };
 
 }
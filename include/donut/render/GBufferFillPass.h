@@ -34,6 +34,7 @@ namespace donut::engine
     class CommonRenderPasses;
     class FramebufferFactory;
     class MaterialBindingCache;
+    class PipelineManager;
     struct Material;
 }
 
@@ -60,6 +61,9 @@ namespace donut::render
         {
         public:
             nvrhi::BindingSetHandle inputBindingSet;
+            nvrhi::BufferHandle instanceIndirectionBuffer;
+            // Keeps the binding set of the current material alive until its draws are recorded
+            nvrhi::BindingSetHandle materialBindingSet;
             PipelineKey keyTemplate;
 
             uint32_t positionOffset = 0;
@@ -77,6 +81,10 @@ namespace donut::render
         struct CreateParameters
         {
             std::shared_ptr<engine::MaterialBindingCache> materialBindings;
+
+            // When provided, pipelines are created through the manager, possibly asynchronously,
+            // and draws are skipped until their pipelines are ready.
+            std::shared_ptr<engine::PipelineManager> pipelineManager;
             bool enableSinglePassCubemap = false;
             bool enableDepthWrite = true;
             bool enableMotionVectors = false;
@@ -105,10 +113,12 @@ namespace donut::render
         nvrhi::GraphicsPipelineHandle m_Pipelines[PipelineKey::Count];
         std::mutex m_Mutex;
 
-        std::unordered_map<const engine::BufferGroup*, nvrhi::BindingSetHandle> m_InputBindingSets;
+        InputBindingSetCache m_InputBindingSets;
 
         std::shared_ptr<engine::CommonRenderPasses> m_CommonPasses;
         std::shared_ptr<engine::MaterialBindingCache> m_MaterialBindings;
+        std::shared_ptr<engine::PipelineManager> m_PipelineManager;
+        uint64_t m_PipelineOwner = 0;
 
         bool m_EnableDepthWrite = true;
         bool m_EnableMotionVectors = false;
@@ -121,15 +131,17 @@ namespace donut::render
         virtual nvrhi::ShaderHandle CreatePixelShader(engine::ShaderFactory& shaderFactory, const CreateParameters& params, bool alphaTested);
         virtual nvrhi::InputLayoutHandle CreateInputLayout(nvrhi::IShader* vertexShader, const CreateParameters& params);
         virtual nvrhi::BindingLayoutHandle CreateInputBindingLayout();
-        virtual nvrhi::BindingSetHandle CreateInputBindingSet(const engine::BufferGroup* bufferGroup);
+        virtual nvrhi::BindingSetHandle CreateInputBindingSet(const engine::BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection);
         virtual void CreateViewBindings(nvrhi::BindingLayoutHandle& layout, nvrhi::BindingSetHandle& set, const CreateParameters& params);
         virtual std::shared_ptr<engine::MaterialBindingCache> CreateMaterialBindingCache(engine::CommonRenderPasses& commonPasses);
         virtual nvrhi::GraphicsPipelineHandle CreateGraphicsPipeline(PipelineKey key, nvrhi::FramebufferInfo const& framebufferInfo);
-        nvrhi::BindingSetHandle GetOrCreateInputBindingSet(const engine::BufferGroup* bufferGroup);
+        nvrhi::BindingSetHandle GetOrCreateInputBindingSet(const engine::BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection);
         
     public:
         GBufferFillPass(nvrhi::IDevice* device, std::shared_ptr<engine::CommonRenderPasses> commonPasses);
 
+        ~GBufferFillPass() override;
+
         virtual void Init(
             engine::ShaderFactory& shaderFactory,
             const CreateParameters& params);
@@ -143,6 +155,8 @@ namespace donut::render
         bool SetupMaterial(GeometryPassContext& context, const engine::Material* material, nvrhi::RasterCullMode cullMode, nvrhi::GraphicsState& state) override;
         void SetupInputBuffers(GeometryPassContext& context, const engine::BufferGroup* buffers, nvrhi::GraphicsState& state) override;
         void SetPushConstants(GeometryPassContext& context, nvrhi::ICommandList* commandList, nvrhi::GraphicsState& state, nvrhi::DrawArguments& args) override;
+        [[nodiscard]] bool SupportsInstanceIndirection() const override { return !m_UseInputAssembler; }
+        void SetInstanceIndirection(GeometryPassContext& context, nvrhi::IBuffer* buffer) override;
     };
 
     class MaterialIDPass : public GBufferFillPass
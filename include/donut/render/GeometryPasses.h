@@ -24,6 +24,9 @@
 
 #include <donut/engine/View.h>
 #include <nvrhi/nvrhi.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace donut::engine
 {
@@ -49,6 +52,7 @@ namespace donut::render
         const engine::BufferGroup* buffers;
         float distanceToCamera;
         nvrhi::RasterCullMode cullMode;
+        uint32_t lod = 0; // level of detail of the geometry, see MeshGeometry::lods
     };
 
     class GeometryPassContext
@@ -63,9 +67,107 @@ namespace donut::render
         virtual bool SetupMaterial(GeometryPassContext& context, const engine::Material* material, nvrhi::RasterCullMode cullMode, nvrhi::GraphicsState& state) = 0;
         virtual void SetupInputBuffers(GeometryPassContext& context, const engine::BufferGroup* buffers, nvrhi::GraphicsState& state) = 0;
         virtual void SetPushConstants(GeometryPassContext& context, nvrhi::ICommandList* commandList, nvrhi::GraphicsState& state, nvrhi::DrawArguments& args) = 0;
+
+        // Passes that support instance indirection read the instance index for each draw instance from
+        // buffer[startInstanceLocation + instanceID] instead of using startInstanceLocation + instanceID directly.
+        // SetInstanceIndirection is called before SetupInputBuffers, with nullptr to disable the indirection.
+        [[nodiscard]] virtual bool SupportsInstanceIndirection() const { return false; }
+        virtual void SetInstanceIndirection(GeometryPassContext& context, nvrhi::IBuffer* buffer) { }
+
+        // ParallelViewRecorder may record the draw items of a view in several slices, each with its own context and
+        // command list, executed in order. It calls PrepareViewSlices once per view with the contexts of its slices,
+        // before SetupView is called for any slice of any view, so that the per-view work is done only once.
+        virtual void PrepareViewSlices(GeometryPassContext* const* sliceContexts, size_t numSlices, const engine::IView* view) { }
+
         virtual ~IGeometryPass() = default;
     };
 
+    struct InstancingStats
+    {
+        uint32_t drawItems = 0;              // Items returned by the draw strategies
+        uint32_t drawCallsWithoutGroups = 0; // Draw calls if only the items with consecutive instance indices were merged
+        uint32_t drawCalls = 0;              // Draw calls actually issued
+    };
+
+    // A per-frame list of instance indices in a GPU buffer, used by RenderView to draw all visible instances
+    // of a geometry with one instanced draw, even if their instance indices are not consecutive.
+    // One object can be shared by all views and passes in a frame, and BeginFrame must be called before them.
+    // Grouping changes the order of draws, so it should only be used with order-independent passes,
+    // such as depth, G-buffer or opaque forward shading.
+    class InstanceIndirectionBuffer
+    {
+    private:
+        nvrhi::DeviceHandle m_Device;
+        nvrhi::BufferHandle m_Buffer;
+        uint32_t m_Capacity = 0;
+        uint32_t m_WriteOffset = 0;
+        InstancingStats m_Stats;
+        std::mutex m_Mutex;
+
+    public:
+        explicit InstanceIndirectionBuffer(nvrhi::IDevice* device, uint32_t initialCapacity = 16384);
+
+        // Discards the indices written in the previous frame and resets the statistics.
+        void BeginFrame();
+
+        // Uploads the indices and returns their offset in the buffer returned by GetBuffer.
+        // When the buffer is full, it is replaced by a larger one; the draws recorded earlier keep using the old one.
+        uint32_t Write(nvrhi::ICommandList* commandList, const uint32_t* indices, size_t count, nvrhi::BufferHandle& buffer);
+
+        void AddStats(const InstancingStats& stats);
+
+        [[nodiscard]] InstancingStats GetStats();
+    };
+
+    // Draw items with the same geometry, material, cull mode and level of detail, drawn with one instanced draw.
+    struct InstanceGroup
+    {
+        DrawItem item;
+        std::vector<uint32_t> instances;
+        uint32_t drawCallsWithoutGroups = 0; // Draw calls for these items if only consecutive instances were merged
+    };
+
+    // Collects the draw items of a strategy into instance groups, ordered by their first appearance in the
+    // strategy output. Items without a material are skipped. Used by RenderView with an InstanceIndirectionBuffer.
+    void CollectInstanceGroups(IDrawStrategy& drawStrategy, std::vector<InstanceGroup>& groups, InstancingStats& stats);
+
+    // The input binding sets of a geometry pass, per buffer group and instance indirection buffer (nullptr when the
+    // instances are read directly). Several indirection buffers can be in use at the same time, e.g. one per view
+    // recorded in parallel, and each of them is replaced when it grows, so only the sets that use the
+    // MaxIndirectionBuffers most recently used indirection buffers are kept. The cached sets keep their buffers alive,
+    // so the buffer addresses in the keys cannot be reused by other buffers. Not thread-safe.
+    class InputBindingSetCache
+    {
+    public:
+        static constexpr size_t MaxIndirectionBuffers = 8;
+
+        [[nodiscard]] nvrhi::BindingSetHandle Find(const engine::BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection);
+        void Insert(const engine::BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection, nvrhi::BindingSetHandle bindingSet);
+        void Clear();
+
+        [[nodiscard]] size_t GetSize() const { return m_BindingSets.size(); }
+
+    private:
+        struct Key
+        {
+            const engine::BufferGroup* bufferGroup;
+            nvrhi::IBuffer* instanceIndirection;
+
+            bool operator==(const Key& other) const
+            {
+                return bufferGroup == other.bufferGroup && instanceIndirection == other.instanceIndirection;
+            }
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const;
+        };
+
+        std::unordered_map<Key, nvrhi::BindingSetHandle, KeyHash> m_BindingSets;
+        std::vector<nvrhi::IBuffer*> m_IndirectionBuffers; // most recently used first
+    };
+
     void RenderView(
         nvrhi::ICommandList* commandList, 
         const engine::IView* view, 
@@ -74,7 +176,8 @@ namespace donut::render
         IDrawStrategy& drawStrategy,
         IGeometryPass& pass,
         GeometryPassContext& passContext,
-        bool materialEvents = false);
+        bool materialEvents = false,
+        InstanceIndirectionBuffer* instanceIndirection = nullptr);
 
     void RenderCompositeView(
         nvrhi::ICommandList* commandList,
@@ -86,5 +189,6 @@ namespace donut::render
         IGeometryPass& pass,
         GeometryPassContext& passContext,
         const char* passEvent = nullptr,
-        bool materialEvents = false);
+        bool materialEvents = false,
+        InstanceIndirectionBuffer* instanceIndirection = nullptr);
 }
\ No newline at end of file
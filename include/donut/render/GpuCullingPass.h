@@ -0,0 +1,143 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/render/GeometryPasses.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <vector>
+
+namespace donut::engine
+{
+    class ShaderFactory;
+    class FramebufferFactory;
+    class Scene;
+    class SceneGraphNode;
+    class ICompositeView;
+    class IView;
+    struct MeshInfo;
+    struct MeshGeometry;
+    struct Material;
+    struct BufferGroup;
+}
+
+namespace donut::render
+{
+    // Renders the opaque and alpha-tested geometry of a scene with frustum culling done on the GPU.
+    // 
+    // The pass keeps one indirect draw for every geometry of every mesh, and one culling item for every geometry
+    // of every mesh instance. For each view, a compute shader tests the culling items against the view frustum,
+    // writes the indices of the visible instances into a list that is ordered by draw, and counts them in the
+    // instanceCount fields of the indirect arguments. The draws then read their instances from that list through
+    // the instance indirection path of the geometry passes, so the CPU cost of a view depends on the number of
+    // distinct geometries, not on the number of instances.
+    // 
+    // The draw list is rebuilt when the scene structure version changes. Call ResetDrawList after changing
+    // material domains or the doubleSided flag. Only passes that support instance indirection can be used.
+    class GpuCullingPass
+    {
+    public:
+        struct Stats
+        {
+            uint32_t draws = 0;         // Indirect draws issued per view
+            uint32_t cullingItems = 0;  // Geometry instances tested per view
+        };
+
+    protected:
+        struct DrawGroup
+        {
+            const engine::MeshInfo* mesh = nullptr;
+            const engine::MeshGeometry* geometry = nullptr;
+            const engine::Material* material = nullptr;
+            const engine::BufferGroup* buffers = nullptr;
+            nvrhi::RasterCullMode cullMode = nvrhi::RasterCullMode::Back;
+            uint32_t instanceListOffset = 0;
+            uint32_t numInstances = 0;
+        };
+
+        nvrhi::DeviceHandle m_Device;
+        nvrhi::ShaderHandle m_ComputeShader;
+        nvrhi::ComputePipelineHandle m_Pipeline;
+        nvrhi::BindingLayoutHandle m_BindingLayout;
+        nvrhi::BindingSetHandle m_BindingSet;
+
+        nvrhi::BufferHandle m_ItemBuffer;
+        nvrhi::BufferHandle m_DrawArgumentBuffer;
+        nvrhi::BufferHandle m_InstanceListBuffer;
+        nvrhi::BufferHandle m_SceneInstanceBuffer;
+
+        std::vector<DrawGroup> m_DrawGroups;
+        std::vector<nvrhi::DrawIndexedIndirectArguments> m_InitialDrawArguments;
+        uint32_t m_NumItems = 0;
+        uint32_t m_StructureVersion = 0;
+        bool m_DrawListValid = false;
+
+        virtual nvrhi::ShaderHandle CreateComputeShader(engine::ShaderFactory& shaderFactory);
+
+        void BuildDrawList(nvrhi::ICommandList* commandList, const engine::Scene& scene);
+
+    public:
+        explicit GpuCullingPass(nvrhi::IDevice* device);
+
+        virtual void Init(engine::ShaderFactory& shaderFactory);
+
+        // Rebuilds the draw list if the scene structure has changed since the last call.
+        // Must be called after Scene::RefreshBuffers and before the views are rendered.
+        void PrepareScene(nvrhi::ICommandList* commandList, const engine::Scene& scene);
+
+        // Culls the scene against the view and fills the indirect arguments for the following RenderView call.
+        void Cull(nvrhi::ICommandList* commandList, const engine::IView& view);
+
+        // Issues the indirect draws filled by the last Cull call.
+        void RenderView(
+            nvrhi::ICommandList* commandList,
+            const engine::IView* view,
+            const engine::IView* viewPrev,
+            nvrhi::IFramebuffer* framebuffer,
+            IGeometryPass& pass,
+            GeometryPassContext& passContext,
+            bool materialEvents = false);
+
+        // Culls and renders every child view of the composite view, like RenderCompositeView does with a draw strategy.
+        void RenderCompositeView(
+            nvrhi::ICommandList* commandList,
+            const engine::ICompositeView* compositeView,
+            const engine::ICompositeView* compositeViewPrev,
+            engine::FramebufferFactory& framebufferFactory,
+            IGeometryPass& pass,
+            GeometryPassContext& passContext,
+            const char* passEvent = nullptr,
+            bool materialEvents = false);
+
+        void ResetDrawList() { m_DrawListValid = false; }
+
+        [[nodiscard]] Stats GetStats() const;
+
+        // Converts the view frustum into the planes used by the culling shaders.
+        static void GetFrustumPlanes(const dm::frustum& viewFrustum, dm::float4 planes[6]);
+
+        // CPU version of the visibility test in gpu_culling_cs.hlsl and hzb_culling_cs.hlsl, keep them in sync.
+        // The transform is the instance transform as stored in InstanceData, see affineToColumnMajor.
+        [[nodiscard]] static bool IsBoxInFrustum(const dm::float4 planes[6], const float transform[12], const dm::box3& bounds);
+    };
+}
@@ -0,0 +1,167 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/render/GpuCullingPass.h>
+#include <donut/core/math/math.h>
+#include <array>
+#include <functional>
+#include <unordered_map>
+
+namespace donut::engine
+{
+    class ShaderFactory;
+}
+
+namespace donut::render
+{
+    class MipMapGenPass;
+
+    // Two-phase occlusion culling for planar views, built on the draw list and indirect draws of GpuCullingPass.
+    // 
+    // The first phase draws the culling items that were visible at the end of the previous frame, except those that
+    // are occluded in the hierarchical depth buffer (HZB) built for the previous frame. The HZB is then rebuilt from
+    // the depth buffer that contains these draws, and the second phase tests every item against it, draws the ones
+    // that became visible, and records the visibility for the next frame.
+    // 
+    // The HZB is a power-of-two R32_FLOAT texture slightly smaller than the view, where every texel stores the
+    // farthest depth of the pixels it covers. Its mip levels are reduced with MipMapGenPass.
+    // The visibility history, the HZB and the counters are kept for every view, identified by the address of
+    // the IView object, so the views must persist between frames. Call ReleaseViewHistory when a view is destroyed.
+    class HzbCullingPass : public GpuCullingPass
+    {
+    public:
+        struct PhaseStats
+        {
+            uint32_t tested = 0;            // Culling items considered by the phase
+            uint32_t drawn = 0;             // Items drawn, in the second phase only the ones missed by the first phase
+            uint32_t frustumCulled = 0;
+            uint32_t occlusionCulled = 0;
+        };
+
+        struct OcclusionStats
+        {
+            std::array<PhaseStats, 2> phases;
+            bool valid = false;             // The counters of the first frames are not available yet
+        };
+
+        // The counters are read back this many frames after they are written, to avoid waiting for the GPU.
+        static constexpr uint32_t ReadbackLatency = 3;
+
+    protected:
+        struct ViewHistory
+        {
+            nvrhi::BufferHandle itemBuffer; // The item buffer that the visibility belongs to
+            nvrhi::BufferHandle visibilityBuffer;
+            nvrhi::BindingSetHandle cullingBindingSet;
+
+            nvrhi::TextureHandle hzbTexture;
+            std::unique_ptr<MipMapGenPass> hzbMipMapPass;
+            nvrhi::BindingSetHandle buildBindingSet;
+            nvrhi::ITexture* buildDepthTexture = nullptr;
+            dm::float4x4 hzbViewProjection = dm::float4x4::identity();
+            bool hzbReverseDepth = false;
+            bool hzbValid = false;
+
+            nvrhi::BufferHandle counterBuffer;
+            std::array<nvrhi::BufferHandle, ReadbackLatency> readbackBuffers;
+            uint64_t frameIndex = 0;
+            OcclusionStats occlusionStats;
+
+            ViewHistory();
+            ~ViewHistory();
+        };
+
+        std::shared_ptr<engine::ShaderFactory> m_ShaderFactory;
+
+        nvrhi::ShaderHandle m_BuildShader;
+        nvrhi::ComputePipelineHandle m_BuildPipeline;
+        nvrhi::BindingLayoutHandle m_BuildBindingLayout;
+        nvrhi::BufferHandle m_BuildConstants;
+
+        nvrhi::ShaderHandle m_CullingShader;
+        nvrhi::ComputePipelineHandle m_CullingPipeline;
+        nvrhi::BindingLayoutHandle m_CullingBindingLayout;
+        nvrhi::BufferHandle m_CullingConstants;
+
+        std::unordered_map<const engine::IView*, std::unique_ptr<ViewHistory>> m_ViewHistories;
+
+        virtual nvrhi::ShaderHandle CreateBuildShader(engine::ShaderFactory& shaderFactory);
+        virtual nvrhi::ShaderHandle CreateCullingShader(engine::ShaderFactory& shaderFactory);
+
+        // Returns the history of the view, creating it on first use. When the item buffer has changed since the
+        // visibility was recorded, the visibility is dropped and the next first phase draws everything in the frustum.
+        ViewHistory& GetViewHistory(const engine::IView& view);
+
+        void CreateVisibilityBuffer(nvrhi::ICommandList* commandList, ViewHistory& history);
+        void CreateCounterBuffers(ViewHistory& history);
+        void CullPhase(nvrhi::ICommandList* commandList, const engine::IView& view, ViewHistory& history, uint32_t phase);
+        void ReadCounters(nvrhi::ICommandList* commandList, ViewHistory& history);
+
+    public:
+        HzbCullingPass(nvrhi::IDevice* device, std::shared_ptr<engine::ShaderFactory> shaderFactory);
+        ~HzbCullingPass();
+
+        void Init(engine::ShaderFactory& shaderFactory) override;
+
+        // Builds the HZB of the view from the depth of its viewport in depthTexture, for the next culling phase.
+        // RenderViewTwoPhase calls it between the phases. Calling it again after the whole frame is rendered
+        // gives the next frame's first phase a complete depth buffer to cull against.
+        void BuildHzb(nvrhi::ICommandList* commandList, nvrhi::ITexture* depthTexture, const engine::IView& view);
+
+        // Culls and draws the scene in two phases with an HZB rebuild in between. The depth texture must be
+        // the depth attachment of the framebuffer, or a texture that the pass writes the same depth into.
+        void RenderViewTwoPhase(
+            nvrhi::ICommandList* commandList,
+            const engine::IView* view,
+            const engine::IView* viewPrev,
+            nvrhi::IFramebuffer* framebuffer,
+            nvrhi::ITexture* depthTexture,
+            IGeometryPass& pass,
+            GeometryPassContext& passContext,
+            bool materialEvents = false);
+
+        // Forgets the visibility of the previous frame and the HZB of every view, e.g. after a camera cut.
+        // The next first phase draws everything in the frustum.
+        void ResetHistory();
+
+        // Releases the history and the HZB of a view that is no longer rendered.
+        void ReleaseViewHistory(const engine::IView* view);
+
+        // Returns the counters of the view for the frame rendered ReadbackLatency frames ago.
+        [[nodiscard]] OcclusionStats GetOcclusionStats(const engine::IView& view) const;
+
+        [[nodiscard]] nvrhi::ITexture* GetHzbTexture(const engine::IView& view) const;
+
+        // CPU version of IsBoxOccluded in hzb_culling_cs.hlsl, keep them in sync. The box is in world space, and
+        // loadHzb returns a texel of the given mip level of an HZB that was built with hzbViewProjection.
+        static bool IsBoxOccluded(
+            const dm::float4x4& hzbViewProjection,
+            bool reverseDepth,
+            dm::uint2 hzbSize,
+            uint32_t hzbMipLevels,
+            const dm::float3& center,
+            const dm::float3& extent,
+            const std::function<float(int x, int y, uint32_t mip)>& loadHzb);
+    };
+}
@@ -0,0 +1,150 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/render/GeometryPasses.h>
+#include <donut/render/DrawStrategy.h>
+#include <nvrhi/nvrhi.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace tf
+{
+    class Executor;
+}
+
+namespace donut::render
+{
+    struct ParallelRecordingStats
+    {
+        uint32_t views = 0;         // Child views of the composite view that the pass supports
+        uint32_t tasks = 0;         // Command lists recorded
+        uint32_t threads = 0;       // Largest number of tasks that were recording at the same time, as measured
+        uint32_t drawItems = 0;     // Items returned by the draw strategies for all views
+        float prepareMs = 0.f;      // Wall-clock time spent in the PrepareForView phase
+        float recordingMs = 0.f;    // Wall-clock time spent recording the command lists
+        float taskMsTotal = 0.f;    // Sum of the recording times of all tasks
+    };
+
+    // Records a geometry pass for all child views of a composite view into several command lists in parallel.
+    // Each view gets its own draw strategy, created by the strategy factory on first use and kept across frames,
+    // and the draw items of a view may be split into slices of at most MaxItemsPerTask items. Every slice is
+    // recorded into its own command list, with its own pass context, on a worker of the executor.
+    // The per-view work of the pass is done once per view, see IGeometryPass::PrepareViewSlices.
+    // The command lists returned by GetCommandLists must be executed in order, or with Execute.
+    // The calling thread records slices too, so RenderCompositeView can be called from a task of the executor.
+    //
+    // The pass and the caches it uses must be safe to call from several threads; the passes in donut::render are.
+    // Volatile constant buffers are written once per command list, so the pass must be created with enough
+    // constant buffer versions for the number of lists recorded per frame.
+    // Without DONUT_WITH_TASKFLOW or an executor, the lists are recorded one after another on the calling thread.
+    // See CascadedShadowMap::RenderCascades for an example that records the cascades of a shadow map.
+    class ParallelViewRecorder
+    {
+    public:
+        struct Task
+        {
+            uint32_t viewIndex = 0;
+            size_t firstItem = 0;
+            size_t numItems = 0;
+        };
+
+        typedef std::function<std::shared_ptr<IDrawStrategy>()> StrategyFactory;
+        typedef std::function<std::shared_ptr<GeometryPassContext>()> ContextFactory;
+
+        // Called for each task after its command list is opened, before the views are rendered.
+        // Can be used to upload per-list data, such as ForwardShadingPass::PrepareLights.
+        typedef std::function<void(GeometryPassContext& context, nvrhi::ICommandList* commandList)> ContextCallback;
+
+        // Maximum number of draw items recorded by one task, or 0 to record every view with one task.
+        size_t MaxItemsPerTask = 0;
+
+        // Maximum number of tasks recording at the same time, 1 to record serially on the calling thread.
+        uint32_t MaxThreads = 8;
+
+        ContextCallback PrepareContext;
+
+        ParallelViewRecorder(
+            nvrhi::IDevice* device,
+            tf::Executor* executor,
+            StrategyFactory strategyFactory,
+            ContextFactory contextFactory);
+
+        void RenderCompositeView(
+            const engine::ICompositeView* compositeView,
+            const engine::ICompositeView* compositeViewPrev,
+            engine::FramebufferFactory& framebufferFactory,
+            const std::shared_ptr<engine::SceneGraphNode>& rootNode,
+            IGeometryPass& pass,
+            const char* passEvent = nullptr,
+            bool materialEvents = false,
+            InstanceIndirectionBuffer* instanceIndirection = nullptr);
+
+        // Returns the command lists recorded by the last RenderCompositeView call, in execution order.
+        [[nodiscard]] const std::vector<nvrhi::ICommandList*>& GetCommandLists() const { return m_RecordedLists; }
+
+        // Executes the recorded command lists and returns the value of executeCommandLists.
+        uint64_t Execute(nvrhi::CommandQueue queue = nvrhi::CommandQueue::Graphics);
+
+        [[nodiscard]] const ParallelRecordingStats& GetStats() const { return m_Stats; }
+
+        // Drops the draw strategies created for the views, e.g. when the composite view changes its layout.
+        void ResetStrategies() { m_Strategies.clear(); }
+
+        // Splits the items of every view into tasks of at most maxItemsPerTask items, or one task per view for 0.
+        // Views without items still get a task, because SetupView may have side effects such as clearing.
+        static void SplitIntoTasks(const std::vector<size_t>& viewItemCounts, size_t maxItemsPerTask, std::vector<Task>& tasks);
+
+        // Calls function(index) for all indices in [0, count), on the calling thread and up to maxThreads - 1
+        // workers of the executor. The calling thread only waits for the calls that have already started,
+        // so it may be a worker of the same executor. Returns the largest number of calls that were running at the
+        // same time, which is less than maxThreads when the workers of the executor are busy with other tasks.
+        static uint32_t RunParallel(tf::Executor* executor, uint32_t maxThreads, size_t count, const std::function<void(size_t)>& function);
+
+    private:
+        struct ViewData
+        {
+            const engine::IView* view = nullptr;
+            const engine::IView* viewPrev = nullptr;
+            nvrhi::IFramebuffer* framebuffer = nullptr;
+            std::vector<DrawItem> items;
+            size_t firstTask = 0;
+            size_t numTasks = 0;
+        };
+
+        nvrhi::DeviceHandle m_Device;
+        tf::Executor* m_Executor;
+        StrategyFactory m_StrategyFactory;
+        ContextFactory m_ContextFactory;
+
+        std::vector<std::shared_ptr<IDrawStrategy>> m_Strategies;
+        std::vector<std::shared_ptr<GeometryPassContext>> m_Contexts;
+        std::vector<nvrhi::CommandListHandle> m_CommandLists;
+        std::vector<nvrhi::ICommandList*> m_RecordedLists;
+        std::vector<ViewData> m_Views;
+        std::vector<Task> m_Tasks;
+        std::vector<GeometryPassContext*> m_SliceContexts;
+        ParallelRecordingStats m_Stats;
+    };
+}
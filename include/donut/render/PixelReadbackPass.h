@@ -23,6 +23,9 @@
 #pragma once
 
 #include <donut/core/math/math.h>
+#include <cstring>
+#include <functional>
+#include <future>
 #include <memory>
 #include <map>
 #include <nvrhi/nvrhi.h>
@@ -34,10 +37,22 @@ namespace donut::engine
     class CommonRenderPasses;
     class FramebufferFactory;
     class ICompositeView;
+    class AsyncReadback;
 }
 
 namespace donut::render
 {
+    // The raw value of a pixel captured by PixelReadbackPass::CaptureAsync, to be interpreted according to the format.
+    struct PixelReadbackResult
+    {
+        dm::uint4 bits = 0u;
+        bool valid = false;
+
+        [[nodiscard]] dm::float4 AsFloats() const { dm::float4 value; memcpy(&value, &bits, sizeof(value)); return value; }
+        [[nodiscard]] dm::uint4 AsUInts() const { return bits; }
+        [[nodiscard]] dm::int4 AsInts() const { dm::int4 value; memcpy(&value, &bits, sizeof(value)); return value; }
+    };
+
     class PixelReadbackPass
     {
     private:
@@ -50,6 +65,8 @@ namespace donut::render
         nvrhi::BufferHandle m_IntermediateBuffer;
         nvrhi::BufferHandle m_ReadbackBuffer;
 
+        void Dispatch(nvrhi::ICommandList* commandList, dm::uint2 pixelPosition);
+
     public:
         PixelReadbackPass(
             nvrhi::IDevice* device,
@@ -59,8 +76,17 @@ namespace donut::render
             uint32_t arraySlice = 0,
             uint32_t mipLevel = 0);
 
+        // Copies the pixel into the readback buffer. The Read functions wait for the GPU to finish the copy.
         void Capture(nvrhi::ICommandList* commandList, dm::uint2 pixelPosition);
 
+        // Copies the pixel into a staging buffer of the readback service, which delivers it a few frames later
+        // without stalling. Any number of captures can be pending at the same time.
+        std::future<PixelReadbackResult> CaptureAsync(
+            nvrhi::ICommandList* commandList,
+            dm::uint2 pixelPosition,
+            engine::AsyncReadback& readback,
+            std::function<void(const PixelReadbackResult&)> callback = nullptr);
+
         dm::float4 ReadFloats();
         dm::uint4 ReadUInts();
         dm::int4 ReadInts();
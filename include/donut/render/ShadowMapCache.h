@@ -0,0 +1,181 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/render/DrawStrategy.h>
+#include <donut/render/GeometryPasses.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace donut::engine
+{
+    class FramebufferFactory;
+    class PlanarView;
+}
+
+namespace donut::render
+{
+    class CascadedShadowMap;
+
+    struct ShadowCacheStats
+    {
+        // Cascades rendered in the last frame, by the way their static layer was produced
+        uint32_t hits = 0;              // Reused as is
+        uint32_t scrolls = 0;           // Shifted by whole texels, with only the exposed strips rendered again
+        uint32_t misses = 0;            // Rendered again completely
+        uint32_t dynamicInstances = 0;  // Instances that are rendered every frame
+
+        // Totals since the cache was created or ResetStats was called
+        uint64_t totalHits = 0;
+        uint64_t totalScrolls = 0;
+        uint64_t totalMisses = 0;
+
+        // Fraction of the cascades rendered since the last ResetStats that reused their static layer as is
+        [[nodiscard]] float GetHitRate() const
+        {
+            uint64_t total = totalHits + totalScrolls + totalMisses;
+            return total ? float(totalHits) / float(total) : 0.f;
+        }
+
+        // Same as GetHitRate, but also counting the scrolled cascades as hits
+        [[nodiscard]] float GetReuseRate() const
+        {
+            uint64_t total = totalHits + totalScrolls + totalMisses;
+            return total ? float(totalHits + totalScrolls) / float(total) : 0.f;
+        }
+    };
+
+    // Renders the cascades of a CascadedShadowMap in two layers: the static casters are rendered into a cached copy of
+    // each cascade, which is reused while the cascade projection doesn't change, and the dynamic casters are rendered
+    // on top of it every frame. When a cascade moves by a whole number of texels, which is what
+    // CascadedShadowMap::SetupForPlanarViewStable does when the camera moves, the cached layer is shifted and only
+    // the newly exposed strips are rendered. The depth range of the cascades must not change for that, so the
+    // stable setup should be used with CascadedShadowMap::SetSceneBounds, and the shadow views must use the same
+    // world space in every frame, i.e. a constant preViewTranslation.
+    // Scrolling copies a depth sub-rectangle to an offset, which only Vulkan allows: with other APIs, a cascade that
+    // moved is rendered again completely.
+    //
+    // Instances become dynamic when SceneGraph::Refresh reports a change of their transform, and they stay dynamic
+    // until the scene structure changes or Invalidate is called. Skinned instances are always dynamic.
+    // Changes of materials or mesh data are not tracked and require an Invalidate call.
+    class ShadowMapCache
+    {
+    public:
+        struct CascadeState
+        {
+            bool valid = false;
+            dm::affine3 viewMatrix = dm::affine3::identity();
+            dm::float4x4 projection = dm::float4x4::identity();
+        };
+
+        enum class CascadeReuse
+        {
+            Hit,
+            Scroll,
+            Miss
+        };
+
+        ShadowMapCache(nvrhi::IDevice* device, std::shared_ptr<CascadedShadowMap> shadowMap);
+
+        // Discards the cached layers and forgets the dynamic instances.
+        void Invalidate();
+
+        // Finds the instances that moved in the last SceneGraph::Refresh call, and discards the cached layers
+        // if any of them was static. Must be called once per frame, after the refresh and before Render.
+        // The structure version is compared with the one from the previous call, see Scene::GetStructureVersion.
+        void BeginFrame(const std::shared_ptr<engine::SceneGraphNode>& rootNode, uint32_t structureVersion);
+
+        // Renders all cascades of the shadow map with the pass, which is normally a DepthPass.
+        // The shadow map doesn't need to be cleared before.
+        void Render(
+            nvrhi::ICommandList* commandList,
+            const std::shared_ptr<engine::SceneGraphNode>& rootNode,
+            IGeometryPass& pass,
+            GeometryPassContext& passContext,
+            InstanceIndirectionBuffer* instanceIndirection = nullptr);
+
+        [[nodiscard]] bool IsDynamic(const DrawItem& item) const;
+
+        void ResetStats();
+        [[nodiscard]] const ShadowCacheStats& GetStats() const { return m_Stats; }
+
+        // Draw strategy for the dynamic layer, which can be configured to use LODs or to disable the receiver culling.
+        [[nodiscard]] ShadowCasterDrawStrategy& GetDynamicCasterStrategy() { return m_DynamicStrategy; }
+
+        [[nodiscard]] bool IsScrollingSupported() const { return m_ScrollingSupported; }
+
+        // Decides how a cascade of the given size in texels can reuse the static layer cached with the state.
+        // For Scroll, texelOffset receives the shift of the static content in the new view, in texels.
+        // Without allowScrolling, the cascades that moved are misses.
+        [[nodiscard]] static CascadeReuse ClassifyCascade(const CascadeState& state, const dm::affine3& viewMatrix,
+            const dm::float4x4& projection, dm::int2 size, bool allowScrolling, dm::int2& texelOffset);
+
+        // Returns the region of the shadow map that is copied to or from the static layer for a cascade.
+        // With wholeSubresource, which D3D11 and D3D12 require for depth textures, the region is the entire
+        // array slice, and the cascade viewport must cover all of it.
+        [[nodiscard]] static nvrhi::TextureSlice GetCascadeCopySlice(const nvrhi::Viewport& viewport, uint32_t arraySlice,
+            dm::uint2 textureSize, bool wholeSubresource);
+
+        // Returns true if the value is within a small tolerance of an integer, which is stored in result.
+        [[nodiscard]] static bool IsWholeNumber(float value, int& result);
+
+        // Adds the mesh instances whose transform changed in the last SceneGraph::Refresh call to the set,
+        // and returns true if any of them was not in it yet.
+        static bool FindMovedInstances(engine::SceneGraphNode* rootNode, std::unordered_set<const engine::MeshInstance*>& dynamicInstances);
+
+    private:
+        nvrhi::DeviceHandle m_Device;
+        std::shared_ptr<CascadedShadowMap> m_ShadowMap;
+        std::shared_ptr<engine::FramebufferFactory> m_FramebufferFactory;
+        nvrhi::TextureHandle m_StaticLayers;
+        std::vector<CascadeState> m_Cascades;
+        std::unordered_set<const engine::MeshInstance*> m_DynamicInstances;
+        uint32_t m_StructureVersion = ~0u;
+        InstancedOpaqueDrawStrategy m_StaticStrategy;
+        ShadowCasterDrawStrategy m_DynamicStrategy;
+        std::shared_ptr<engine::PlanarView> m_StripView;
+        ShadowCacheStats m_Stats;
+        bool m_ScrollingSupported = false;
+
+        void RenderLayer(
+            nvrhi::ICommandList* commandList,
+            const engine::IView& view,
+            const std::shared_ptr<engine::SceneGraphNode>& rootNode,
+            IDrawStrategy& strategy,
+            bool dynamicLayer,
+            IGeometryPass& pass,
+            GeometryPassContext& passContext,
+            InstanceIndirectionBuffer* instanceIndirection);
+
+        void RenderStrip(
+            nvrhi::ICommandList* commandList,
+            const engine::PlanarView& cascadeView,
+            int x0, int y0, int x1, int y1,
+            const std::shared_ptr<engine::SceneGraphNode>& rootNode,
+            IGeometryPass& pass,
+            GeometryPassContext& passContext,
+            InstanceIndirectionBuffer* instanceIndirection);
+    };
+}
@@ -27,15 +27,16 @@ using namespace donut::math;
 #endif
 
 #include "light_cb.h"
+#include "light_cluster_cb.h"
 #include "view_cb.h"
 
-#define DEFERRED_MAX_LIGHTS 16
 #define DEFERRED_MAX_SHADOWS 16
 #define DEFERRED_MAX_LIGHT_PROBES 16
 
 struct DeferredLightingConstants
 {
     PlanarViewConstants view;
+    LightClusterConstants lightClusters;
 
     float2      shadowMapTextureSize;
     int         enableAmbientOcclusion;
@@ -54,7 +55,6 @@ struct DeferredLightingConstants
 
     float4      noisePattern[4];
 
-    LightConstants lights[DEFERRED_MAX_LIGHTS];
     ShadowConstants shadows[DEFERRED_MAX_SHADOWS];
     LightProbeConstants lightProbes[DEFERRED_MAX_LIGHT_PROBES];
 };
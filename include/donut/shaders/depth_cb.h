@@ -35,6 +35,7 @@ using namespace donut::math;
 #define DEPTH_BINDING_PUSH_CONSTANTS 1
 #define DEPTH_BINDING_INSTANCE_BUFFER 10
 #define DEPTH_BINDING_VERTEX_BUFFER 11
+#define DEPTH_BINDING_INSTANCE_INDIRECTION_BUFFER 12
 
 #define DEPTH_SPACE_VIEW 2
 #define DEPTH_BINDING_VIEW_CONSTANTS 2
@@ -51,6 +52,7 @@ struct DepthPushConstants
     uint        startVertexLocation;
     uint        positionOffset;
     uint        texCoordOffset;
+    uint        instanceIndirection;
 };
 
 #endif // DEPTH_CB_H
\ No newline at end of file
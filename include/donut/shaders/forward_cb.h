@@ -27,9 +27,9 @@ using namespace donut::math;
 #endif
 
 #include "light_cb.h"
+#include "light_cluster_cb.h"
 #include "view_cb.h"
 
-#define FORWARD_MAX_LIGHTS 16
 #define FORWARD_MAX_SHADOWS 16
 #define FORWARD_MAX_LIGHT_PROBES 16
 
@@ -47,6 +47,7 @@ using namespace donut::math;
 #define FORWARD_BINDING_PUSH_CONSTANTS 1
 #define FORWARD_BINDING_INSTANCE_BUFFER 10
 #define FORWARD_BINDING_VERTEX_BUFFER 11
+#define FORWARD_BINDING_INSTANCE_INDIRECTION_BUFFER 12
 
 #define FORWARD_SPACE_VIEW 2
 #define FORWARD_BINDING_VIEW_CONSTANTS 2
@@ -57,6 +58,9 @@ using namespace donut::math;
 #define FORWARD_BINDING_DIFFUSE_LIGHT_PROBE_TEXTURE 21
 #define FORWARD_BINDING_SPECULAR_LIGHT_PROBE_TEXTURE 22
 #define FORWARD_BINDING_ENVIRONMENT_BRDF_TEXTURE 23
+#define FORWARD_BINDING_LIGHT_BUFFER 24
+#define FORWARD_BINDING_LIGHT_CLUSTER_BUFFER 25
+#define FORWARD_BINDING_LIGHT_INDEX_BUFFER 26
 #define FORWARD_BINDING_MATERIAL_SAMPLER 0
 #define FORWARD_BINDING_SHADOW_MAP_SAMPLER 1
 #define FORWARD_BINDING_LIGHT_PROBE_SAMPLER 2
@@ -66,6 +70,7 @@ using namespace donut::math;
 struct ForwardShadingViewConstants
 {
     PlanarViewConstants view;
+    LightClusterConstants lightClusters;
 };
 
 struct ForwardShadingLightConstants
@@ -79,7 +84,6 @@ struct ForwardShadingLightConstants
     uint        numLights;
     uint        numLightProbes;
 
-    LightConstants lights[FORWARD_MAX_LIGHTS];
     ShadowConstants shadows[FORWARD_MAX_SHADOWS];
     LightProbeConstants lightProbes[FORWARD_MAX_LIGHT_PROBES];
 };
@@ -92,6 +96,7 @@ struct ForwardPushConstants
     uint        texCoordOffset;
     uint        normalOffset;
     uint        tangentOffset;
+    uint        instanceIndirection;
 };
 
 #endif // FORWARD_CB_H
\ No newline at end of file
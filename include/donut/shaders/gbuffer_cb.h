@@ -42,6 +42,7 @@ using namespace donut::math;
 #define GBUFFER_BINDING_PUSH_CONSTANTS 1
 #define GBUFFER_BINDING_INSTANCE_BUFFER 10
 #define GBUFFER_BINDING_VERTEX_BUFFER 11
+#define GBUFFER_BINDING_INSTANCE_INDIRECTION_BUFFER 12
 
 #define GBUFFER_SPACE_VIEW 2
 #define GBUFFER_BINDING_VIEW_CONSTANTS 2
@@ -62,6 +63,7 @@ struct GBufferPushConstants
     uint        texCoordOffset;
     uint        normalOffset;
     uint        tangentOffset;
+    uint        instanceIndirection;
 };
 
 #endif // GBUFFER_CB_H
\ No newline at end of file
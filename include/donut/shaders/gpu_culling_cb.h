@@ -0,0 +1,56 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef GPU_CULLING_CB_H
+#define GPU_CULLING_CB_H
+#ifdef __cplusplus
+using namespace donut::math;
+#endif
+
+#define GPU_CULLING_GROUP_SIZE 64
+
+#define GpuCullingItemFlag_AlwaysVisible 0x01
+
+// One geometry of one mesh instance, tested against the view frustum by the culling shader.
+struct GpuCullingItem
+{
+    uint        instanceIndex;      // index into the scene instance buffer
+    uint        drawIndex;          // index of the indirect draw that renders this geometry
+    uint        instanceListOffset; // first element of the draw's range in the visible instance list
+    uint        flags;
+
+    float3      boundsMin;          // object-space bounds of the geometry
+    float       padding0;
+    float3      boundsMax;
+    float       padding1;
+};
+
+struct GpuCullingConstants
+{
+    float4      frustumPlanes[6];   // normals pointing outside, xyz = normal, w = distance
+    uint        numItems;
+    uint        padding0;
+    uint        padding1;
+    uint        padding2;
+};
+
+#endif // GPU_CULLING_CB_H
@@ -0,0 +1,69 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef HZB_CULLING_CB_H
+#define HZB_CULLING_CB_H
+#ifdef __cplusplus
+using namespace donut::math;
+#endif
+
+#define HZB_BUILD_GROUP_SIZE 8
+
+// Per-phase counters written by the culling shader, HzbCullingCounter_Count of them for each phase
+#define HzbCullingCounter_Tested            0
+#define HzbCullingCounter_Drawn             1
+#define HzbCullingCounter_FrustumCulled     2
+#define HzbCullingCounter_OcclusionCulled   3
+#define HzbCullingCounter_Count             4
+
+// Per-item visibility history
+#define HzbCullingVisibility_Visible            0x01 // visible at the end of the previous frame
+#define HzbCullingVisibility_DrawnFirstPhase    0x02 // drawn by the first phase of the current frame
+
+// The HZB stores depth that grows with the distance from the camera, i.e. 1 - depth for reverse depth views,
+// and every texel contains the farthest depth of the pixels it covers.
+struct HzbBuildConstants
+{
+    float2      sourceOrigin;   // top-left corner of the view's viewport in the depth texture
+    float2      sourceScale;    // depth pixels per HZB texel, between 1 and 2
+    int2        sourceMax;      // last pixel of the viewport in the depth texture
+    uint2       hzbSize;
+    uint        reverseDepth;
+    uint        padding0;
+    uint        padding1;
+    uint        padding2;
+};
+
+struct HzbCullingConstants
+{
+    float4x4    matHzbViewProj; // view projection of the depth that the HZB was built from
+    float4      frustumPlanes[6];
+    float2      hzbSize;
+    uint        hzbMipLevels;
+    uint        hzbReverseDepth;
+    uint        numItems;
+    uint        phase;          // 0 or 1
+    uint        useHzb;
+    uint        padding0;
+};
+
+#endif // HZB_CULLING_CB_H
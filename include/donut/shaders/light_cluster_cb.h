@@ -0,0 +1,47 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef LIGHT_CLUSTER_CB_H
+#define LIGHT_CLUSTER_CB_H
+#ifdef __cplusplus
+using namespace donut::math;
+#endif
+
+// The view is divided into screen tiles of tileSize pixels and into depth slices along the view-space Z axis.
+// Slice 0 covers the depths closer than nearDepth, the following slices are distributed exponentially
+// between nearDepth and farDepth, and the last slice extends to infinity.
+// 
+// Every cluster stores a uint2 with the offset and count of its light indices in the light index buffer,
+// and the indices refer to the light buffer. Lights that are not bound by a range, such as directional
+// lights, are stored at the beginning of the light buffer and apply to every cluster.
+struct LightClusterConstants
+{
+    uint3       gridSize;
+    uint        tileSize;
+
+    float       nearDepth;
+    float       sliceScale;     // slice = log2(depth) * sliceScale + sliceBias, for depths past nearDepth
+    float       sliceBias;
+    uint        numGlobalLights;
+};
+
+#endif // LIGHT_CLUSTER_CB_H
@@ -0,0 +1,41 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef LIGHT_CLUSTERS_HLSLI
+#define LIGHT_CLUSTERS_HLSLI
+
+#include <donut/shaders/light_cluster_cb.h>
+
+// Returns the index of the cluster containing a pixel at the given view-space depth.
+// The pixel position is relative to the view's viewport origin.
+uint GetLightClusterIndex(LightClusterConstants clusters, float2 pixelPosition, float viewDepth)
+{
+    uint2 tile = min(uint2(max(pixelPosition, 0)) / clusters.tileSize, clusters.gridSize.xy - 1);
+
+    uint slice = 0;
+    if (viewDepth >= clusters.nearDepth)
+        slice = min(uint(log2(viewDepth) * clusters.sliceScale + clusters.sliceBias) + 1, clusters.gridSize.z - 1);
+
+    return (slice * clusters.gridSize.y + tile.y) * clusters.gridSize.x + tile.x;
+}
+
+#endif // LIGHT_CLUSTERS_HLSLI
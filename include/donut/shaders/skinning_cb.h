@@ -52,6 +52,7 @@ struct SkinningConstants
     uint outputTangentOffset;
     uint outputTexCoord1Offset;
     uint outputTexCoord2Offset;
+    uint jointOffset;
 };
 
 #endif // SKINNING_CB_H
\ No newline at end of file
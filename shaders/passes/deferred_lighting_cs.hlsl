@@ -26,6 +26,7 @@
 #include <donut/shaders/lighting.hlsli>
 #include <donut/shaders/shadows.hlsli>
 #include <donut/shaders/deferred_lighting_cb.h>
+#include <donut/shaders/light_clusters.hlsli>
 #include <donut/shaders/binding_helpers.hlsli>
 
 cbuffer c_Deferred : register(b0)
@@ -37,6 +38,9 @@ Texture2DArray t_ShadowMapArray : register(t0);
 TextureCubeArray t_DiffuseLightProbe : register(t1);
 TextureCubeArray t_SpecularLightProbe : register(t2);
 Texture2D t_EnvironmentBrdf : register(t3);
+StructuredBuffer<LightConstants> t_Lights : register(t4);
+StructuredBuffer<uint2> t_LightClusters : register(t5);
+StructuredBuffer<uint> t_LightIndices : register(t6);
 
 SamplerState s_ShadowSampler : register(s0);
 SamplerComparisonState s_ShadowSamplerComparison : register(s1);
@@ -87,10 +91,21 @@ void main(int2 i_globalIdx : SV_DispatchThreadID)
     float angle = GetRandom(i_globalIdx.xy + g_Deferred.randomOffset);
     float2 sincos = float2(sin(angle), cos(angle));
 
+    // The global lights are followed by the lights assigned to the cluster of this pixel
+    LightClusterConstants lightClusters = g_Deferred.lightClusters;
+    float viewDepth = mul(float4(surfaceWorldPos, 1), g_Deferred.view.matWorldToView).z;
+    uint cluster = GetLightClusterIndex(lightClusters, float2(i_globalIdx.xy) + 0.5, viewDepth);
+    uint2 clusterLights = t_LightClusters[cluster];
+    uint numLights = lightClusters.numGlobalLights + clusterLights.y;
+
     [loop]
-    for (uint nLight = 0; nLight < g_Deferred.numLights; nLight++)
+    for (uint nLight = 0; nLight < numLights; nLight++)
     {
-        LightConstants light = g_Deferred.lights[nLight];
+        uint lightIndex = (nLight < lightClusters.numGlobalLights)
+            ? nLight
+            : t_LightIndices[clusterLights.x + nLight - lightClusters.numGlobalLights];
+
+        LightConstants light = t_Lights[lightIndex];
 
         float shadow = 1;
 
@@ -53,6 +53,7 @@ ByteAddressBuffer t_Instances : REGISTER_SRV(DEPTH_BINDING_INSTANCE_BUFFER, DEPT
 StructuredBuffer<InstanceData> t_Instances : REGISTER_SRV(DEPTH_BINDING_INSTANCE_BUFFER, DEPTH_SPACE_INPUT);
 #endif
 ByteAddressBuffer t_Vertices : REGISTER_SRV(DEPTH_BINDING_VERTEX_BUFFER, DEPTH_SPACE_INPUT);
+ByteAddressBuffer t_InstanceIndirection : REGISTER_SRV(DEPTH_BINDING_INSTANCE_INDIRECTION_BUFFER, DEPTH_SPACE_INPUT);
 
 DECLARE_PUSH_CONSTANTS(DepthPushConstants, g_Push, DEPTH_BINDING_PUSH_CONSTANTS, DEPTH_SPACE_INPUT);
 
@@ -68,6 +69,9 @@ void buffer_loads(
     i_instance += g_Push.startInstanceLocation;
     i_vertex += g_Push.startVertexLocation;
 
+    if (g_Push.instanceIndirection != 0)
+        i_instance = t_InstanceIndirection.Load(i_instance * 4);
+
 #ifdef TARGET_D3D11
     const InstanceData instance = LoadInstanceData(t_Instances, i_instance * c_SizeOfInstanceData);
 #else
@@ -45,6 +45,7 @@
 #include <donut/shaders/forward_vertex.hlsli>
 #include <donut/shaders/lighting.hlsli>
 #include <donut/shaders/shadows.hlsli>
+#include <donut/shaders/light_clusters.hlsli>
 #include <donut/shaders/binding_helpers.hlsli>
 
 DECLARE_CBUFFER(ForwardShadingViewConstants, g_ForwardView, FORWARD_BINDING_VIEW_CONSTANTS,         FORWARD_SPACE_VIEW);
@@ -54,6 +55,9 @@ Texture2DArray t_ShadowMapArray       : REGISTER_SRV(FORWARD_BINDING_SHADOW_MAP_
 TextureCubeArray t_DiffuseLightProbe  : REGISTER_SRV(FORWARD_BINDING_DIFFUSE_LIGHT_PROBE_TEXTURE,   FORWARD_SPACE_SHADING);
 TextureCubeArray t_SpecularLightProbe : REGISTER_SRV(FORWARD_BINDING_SPECULAR_LIGHT_PROBE_TEXTURE,  FORWARD_SPACE_SHADING);
 Texture2D t_EnvironmentBrdf           : REGISTER_SRV(FORWARD_BINDING_ENVIRONMENT_BRDF_TEXTURE,      FORWARD_SPACE_SHADING);
+StructuredBuffer<LightConstants> t_Lights : REGISTER_SRV(FORWARD_BINDING_LIGHT_BUFFER,              FORWARD_SPACE_SHADING);
+StructuredBuffer<uint2> t_LightClusters : REGISTER_SRV(FORWARD_BINDING_LIGHT_CLUSTER_BUFFER,        FORWARD_SPACE_SHADING);
+StructuredBuffer<uint> t_LightIndices : REGISTER_SRV(FORWARD_BINDING_LIGHT_INDEX_BUFFER,            FORWARD_SPACE_SHADING);
 
 SamplerState s_ShadowSampler          : REGISTER_SAMPLER(FORWARD_BINDING_SHADOW_MAP_SAMPLER,        FORWARD_SPACE_SHADING);
 SamplerState s_LightProbeSampler      : REGISTER_SAMPLER(FORWARD_BINDING_LIGHT_PROBE_SAMPLER,       FORWARD_SPACE_SHADING);
@@ -94,10 +98,21 @@ void main(
     float3 diffuseTerm = 0;
     float3 specularTerm = 0;
 
+    // The global lights are followed by the lights assigned to the cluster of this pixel
+    LightClusterConstants lightClusters = g_ForwardView.lightClusters;
+    float viewDepth = mul(float4(surfaceWorldPos, 1), g_ForwardView.view.matWorldToView).z;
+    uint cluster = GetLightClusterIndex(lightClusters, i_position.xy - g_ForwardView.view.viewportOrigin, viewDepth);
+    uint2 clusterLights = t_LightClusters[cluster];
+    uint numLights = lightClusters.numGlobalLights + clusterLights.y;
+
     [loop]
-    for(uint nLight = 0; nLight < g_ForwardLight.numLights; nLight++)
+    for(uint nLight = 0; nLight < numLights; nLight++)
     {
-        LightConstants light = g_ForwardLight.lights[nLight];
+        uint lightIndex = (nLight < lightClusters.numGlobalLights)
+            ? nLight
+            : t_LightIndices[clusterLights.x + nLight - lightClusters.numGlobalLights];
+
+        LightConstants light = t_Lights[lightIndex];
 
         float2 shadow = 0;
         for (int cascade = 0; cascade < 4; cascade++)
@@ -62,6 +62,7 @@ ByteAddressBuffer t_Instances               : REGISTER_SRV(FORWARD_BINDING_INSTA
 StructuredBuffer<InstanceData> t_Instances  : REGISTER_SRV(FORWARD_BINDING_INSTANCE_BUFFER, FORWARD_SPACE_INPUT);
 #endif
 ByteAddressBuffer t_Vertices                : REGISTER_SRV(FORWARD_BINDING_VERTEX_BUFFER, FORWARD_SPACE_INPUT);
+ByteAddressBuffer t_InstanceIndirection     : REGISTER_SRV(FORWARD_BINDING_INSTANCE_INDIRECTION_BUFFER, FORWARD_SPACE_INPUT);
 
 DECLARE_PUSH_CONSTANTS(ForwardPushConstants, g_Push, FORWARD_BINDING_PUSH_CONSTANTS, FORWARD_SPACE_INPUT);
 
@@ -76,6 +77,9 @@ void buffer_loads(
     i_instance += g_Push.startInstanceLocation;
     i_vertex += g_Push.startVertexLocation;
 
+    if (g_Push.instanceIndirection != 0)
+        i_instance = t_InstanceIndirection.Load(i_instance * 4);
+
 #ifdef TARGET_D3D11
     const InstanceData instance = LoadInstanceData(t_Instances, i_instance * c_SizeOfInstanceData);
 #else
@@ -75,6 +75,7 @@ ByteAddressBuffer t_Instances : REGISTER_SRV(GBUFFER_BINDING_INSTANCE_BUFFER, GB
 StructuredBuffer<InstanceData> t_Instances : REGISTER_SRV(GBUFFER_BINDING_INSTANCE_BUFFER, GBUFFER_SPACE_INPUT);
 #endif
 ByteAddressBuffer t_Vertices : REGISTER_SRV(GBUFFER_BINDING_VERTEX_BUFFER, GBUFFER_SPACE_INPUT);
+ByteAddressBuffer t_InstanceIndirection : REGISTER_SRV(GBUFFER_BINDING_INSTANCE_INDIRECTION_BUFFER, GBUFFER_SPACE_INPUT);
 
 DECLARE_PUSH_CONSTANTS(GBufferPushConstants, g_Push, GBUFFER_BINDING_PUSH_CONSTANTS, GBUFFER_SPACE_INPUT);
 
@@ -87,11 +88,15 @@ void buffer_loads(
     out uint o_instance : INSTANCE
 )
 {
-    o_instance = i_instance;
-
     i_instance += g_Push.startInstanceLocation;
     i_vertex += g_Push.startVertexLocation;
 
+    if (g_Push.instanceIndirection != 0)
+        i_instance = t_InstanceIndirection.Load(i_instance * 4);
+
+    // Output the index of the instance in the scene, not relative to the draw call
+    o_instance = i_instance;
+
 #ifdef TARGET_D3D11
     const InstanceData instance = LoadInstanceData(t_Instances, i_instance * c_SizeOfInstanceData);
 #else
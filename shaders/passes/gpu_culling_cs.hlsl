@@ -0,0 +1,84 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma pack_matrix(row_major)
+
+#include <donut/shaders/bindless.h>
+#include <donut/shaders/binding_helpers.hlsli>
+#include <donut/shaders/gpu_culling_cb.h>
+
+StructuredBuffer<GpuCullingItem> t_Items : register(t0);
+ByteAddressBuffer t_Instances : register(t1);
+
+RWByteAddressBuffer u_DrawArguments : register(u0);
+RWByteAddressBuffer u_InstanceList : register(u1);
+
+DECLARE_PUSH_CONSTANTS(GpuCullingConstants, g_Const, 0, 0);
+
+// Size of the DrawIndexedIndirect arguments and the offset of their instanceCount field
+static const uint c_SizeOfDrawArguments = 20;
+static const uint c_InstanceCountOffset = 4;
+
+// Keep in sync with GpuCullingPass::IsBoxInFrustum
+bool IsBoxInFrustum(float3 center, float3 extent)
+{
+    [unroll]
+    for (uint i = 0; i < 6; i++)
+    {
+        float4 plane = g_Const.frustumPlanes[i];
+        float distance = dot(plane.xyz, center) - dot(abs(plane.xyz), extent) - plane.w;
+        if (distance > 0)
+            return false;
+    }
+
+    return true;
+}
+
+[numthreads(GPU_CULLING_GROUP_SIZE, 1, 1)]
+void main(in uint i_globalIdx : SV_DispatchThreadID)
+{
+    if (i_globalIdx >= g_Const.numItems)
+        return;
+
+    GpuCullingItem item = t_Items[i_globalIdx];
+
+    bool visible = true;
+    if ((item.flags & GpuCullingItemFlag_AlwaysVisible) == 0)
+    {
+        InstanceData instance = LoadInstanceData(t_Instances, item.instanceIndex * c_SizeOfInstanceData);
+
+        // Transform the object-space box into a world-space box that contains it
+        float3 localCenter = (item.boundsMin + item.boundsMax) * 0.5;
+        float3 localExtent = (item.boundsMax - item.boundsMin) * 0.5;
+        float3 center = mul(instance.transform, float4(localCenter, 1.0));
+        float3 extent = mul(abs((float3x3)instance.transform), localExtent);
+
+        visible = IsBoxInFrustum(center, extent);
+    }
+
+    if (!visible)
+        return;
+
+    uint slot;
+    u_DrawArguments.InterlockedAdd(item.drawIndex * c_SizeOfDrawArguments + c_InstanceCountOffset, 1, slot);
+    u_InstanceList.Store((item.instanceListOffset + slot) * 4, item.instanceIndex);
+}
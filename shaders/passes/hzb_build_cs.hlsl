@@ -0,0 +1,60 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma pack_matrix(row_major)
+
+#include <donut/shaders/binding_helpers.hlsli>
+#include <donut/shaders/hzb_culling_cb.h>
+
+Texture2D<float> t_Depth : register(t0);
+VK_IMAGE_FORMAT("r32f") RWTexture2D<float> u_Hzb : register(u0);
+
+cbuffer c_HzbBuild : register(b0)
+{
+    HzbBuildConstants g_Const;
+};
+
+// Fills the first level of the HZB. Its texels cover between 1 and 2 depth pixels in each direction,
+// so every texel reduces all the pixels that it touches to stay conservative.
+[numthreads(HZB_BUILD_GROUP_SIZE, HZB_BUILD_GROUP_SIZE, 1)]
+void main(in uint2 i_globalIdx : SV_DispatchThreadID)
+{
+    if (any(i_globalIdx >= g_Const.hzbSize))
+        return;
+
+    float2 sourceMin = g_Const.sourceOrigin + float2(i_globalIdx) * g_Const.sourceScale;
+    float2 sourceMax = sourceMin + g_Const.sourceScale;
+    int2 first = int2(floor(sourceMin));
+    int2 last = min(int2(ceil(sourceMax)) - 1, g_Const.sourceMax);
+
+    float farthest = 0;
+    for (int y = first.y; y <= last.y; y++)
+    {
+        for (int x = first.x; x <= last.x; x++)
+        {
+            float depth = t_Depth[int2(x, y)];
+            farthest = max(farthest, g_Const.reverseDepth ? 1.0 - depth : depth);
+        }
+    }
+
+    u_Hzb[i_globalIdx] = farthest;
+}
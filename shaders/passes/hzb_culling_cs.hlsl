@@ -0,0 +1,179 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma pack_matrix(row_major)
+
+#include <donut/shaders/bindless.h>
+#include <donut/shaders/binding_helpers.hlsli>
+#include <donut/shaders/gpu_culling_cb.h>
+#include <donut/shaders/hzb_culling_cb.h>
+
+StructuredBuffer<GpuCullingItem> t_Items : register(t0);
+ByteAddressBuffer t_Instances : register(t1);
+Texture2D<float> t_Hzb : register(t2);
+
+RWByteAddressBuffer u_DrawArguments : register(u0);
+RWByteAddressBuffer u_InstanceList : register(u1);
+RWByteAddressBuffer u_Visibility : register(u2);
+RWByteAddressBuffer u_Counters : register(u3);
+
+cbuffer c_HzbCulling : register(b0)
+{
+    HzbCullingConstants g_Const;
+};
+
+// Size of the DrawIndexedIndirect arguments and the offset of their instanceCount field
+static const uint c_SizeOfDrawArguments = 20;
+static const uint c_InstanceCountOffset = 4;
+
+// Keep in sync with GpuCullingPass::IsBoxInFrustum
+bool IsBoxInFrustum(float3 center, float3 extent)
+{
+    [unroll]
+    for (uint i = 0; i < 6; i++)
+    {
+        float4 plane = g_Const.frustumPlanes[i];
+        float distance = dot(plane.xyz, center) - dot(abs(plane.xyz), extent) - plane.w;
+        if (distance > 0)
+            return false;
+    }
+
+    return true;
+}
+
+// Keep in sync with HzbCullingPass::IsBoxOccluded
+bool IsBoxOccluded(float3 center, float3 extent)
+{
+    float2 uvMin = 1e30;
+    float2 uvMax = -1e30;
+    float nearestDepth = 1.0;
+
+    [unroll]
+    for (uint i = 0; i < 8; i++)
+    {
+        float3 corner = center + extent * float3((i & 1) ? 1.0 : -1.0, (i & 2) ? 1.0 : -1.0, (i & 4) ? 1.0 : -1.0);
+        float4 clipPos = mul(float4(corner, 1.0), g_Const.matHzbViewProj);
+
+        // Boxes that cross the near plane cover the whole view
+        if (clipPos.w <= 0)
+            return false;
+
+        float3 ndc = clipPos.xyz / clipPos.w;
+        float depth = g_Const.hzbReverseDepth ? 1.0 - ndc.z : ndc.z;
+        if (depth < 0)
+            return false;
+
+        float2 uv = ndc.xy * float2(0.5, -0.5) + 0.5;
+        uvMin = min(uvMin, uv);
+        uvMax = max(uvMax, uv);
+        nearestDepth = min(nearestDepth, depth);
+    }
+
+    // Outside of the view that the HZB was built for, which happens in the first phase
+    if (any(uvMax < 0.0) || any(uvMin > 1.0))
+        return false;
+
+    float2 rectMin = saturate(uvMin) * g_Const.hzbSize;
+    float2 rectMax = saturate(uvMax) * g_Const.hzbSize;
+    float2 rectSize = rectMax - rectMin;
+
+    // Select the level where the rectangle is at most one texel wide, so that it touches at most 2x2 texels
+    uint mip = uint(ceil(log2(max(max(rectSize.x, rectSize.y), 1.0))));
+    mip = min(mip, g_Const.hzbMipLevels - 1);
+
+    int2 mipSize = max(int2(g_Const.hzbSize) >> mip, 1);
+    int2 texMin = min(int2(rectMin / float(1u << mip)), mipSize - 1);
+    int2 texMax = min(int2(rectMax / float(1u << mip)), mipSize - 1);
+
+    float farthest = max(
+        max(t_Hzb.Load(int3(texMin.x, texMin.y, mip)), t_Hzb.Load(int3(texMax.x, texMin.y, mip))),
+        max(t_Hzb.Load(int3(texMin.x, texMax.y, mip)), t_Hzb.Load(int3(texMax.x, texMax.y, mip))));
+
+    return nearestDepth > farthest;
+}
+
+void IncrementCounter(uint counter)
+{
+    u_Counters.InterlockedAdd((g_Const.phase * HzbCullingCounter_Count + counter) * 4, 1);
+}
+
+[numthreads(GPU_CULLING_GROUP_SIZE, 1, 1)]
+void main(in uint i_globalIdx : SV_DispatchThreadID)
+{
+    if (i_globalIdx >= g_Const.numItems)
+        return;
+
+    uint visibility = u_Visibility.Load(i_globalIdx * 4);
+
+    // The first phase only draws what was visible in the previous frame, the rest is left to the second phase
+    if (g_Const.phase == 0 && (visibility & HzbCullingVisibility_Visible) == 0)
+        return;
+
+    GpuCullingItem item = t_Items[i_globalIdx];
+
+    IncrementCounter(HzbCullingCounter_Tested);
+
+    bool visible = true;
+    if ((item.flags & GpuCullingItemFlag_AlwaysVisible) == 0)
+    {
+        InstanceData instance = LoadInstanceData(t_Instances, item.instanceIndex * c_SizeOfInstanceData);
+
+        // Transform the object-space box into a world-space box that contains it
+        float3 localCenter = (item.boundsMin + item.boundsMax) * 0.5;
+        float3 localExtent = (item.boundsMax - item.boundsMin) * 0.5;
+        float3 center = mul(instance.transform, float4(localCenter, 1.0));
+        float3 extent = mul(abs((float3x3)instance.transform), localExtent);
+
+        if (!IsBoxInFrustum(center, extent))
+        {
+            IncrementCounter(HzbCullingCounter_FrustumCulled);
+            visible = false;
+        }
+        else if (g_Const.useHzb != 0 && IsBoxOccluded(center, extent))
+        {
+            IncrementCounter(HzbCullingCounter_OcclusionCulled);
+            visible = false;
+        }
+    }
+
+    if (g_Const.phase == 0)
+    {
+        // Items rejected here are tested again against the new HZB in the second phase
+        if (!visible)
+            return;
+
+        u_Visibility.Store(i_globalIdx * 4, visibility | HzbCullingVisibility_DrawnFirstPhase);
+    }
+    else
+    {
+        u_Visibility.Store(i_globalIdx * 4, visible ? HzbCullingVisibility_Visible : 0);
+
+        if (!visible || (visibility & HzbCullingVisibility_DrawnFirstPhase) != 0)
+            return;
+    }
+
+    IncrementCounter(HzbCullingCounter_Drawn);
+
+    uint slot;
+    u_DrawArguments.InterlockedAdd(item.drawIndex * c_SizeOfDrawArguments + c_InstanceCountOffset, 1, slot);
+    u_InstanceList.Store((item.instanceListOffset + slot) * 4, item.instanceIndex);
+}
@@ -45,7 +45,6 @@
 #include <donut/shaders/binding_helpers.hlsli>
 
 DECLARE_CBUFFER(GBufferFillConstants, c_GBuffer, GBUFFER_BINDING_VIEW_CONSTANTS, GBUFFER_SPACE_VIEW);
-DECLARE_PUSH_CONSTANTS(GBufferPushConstants, g_Push, GBUFFER_BINDING_PUSH_CONSTANTS, GBUFFER_SPACE_INPUT);
 
 void main(
     in float4 i_position : SV_Position,
@@ -63,6 +62,7 @@ void main(
 #endif
 
     o_output.x = uint(g_Material.materialID);
-    o_output.y = g_Push.startInstanceLocation + i_instance;
+    // The instance index is already offset by startInstanceLocation in the buffer_loads VS, which MaterialIDPass always uses
+    o_output.y = i_instance;
     o_output.zw = 0;
 }
@@ -70,7 +70,7 @@ void main(in uint i_globalIdx : SV_DispatchThreadID)
 	{
 		if (jointWeights[i] > 0)
 		{
-			uint index = jointIndices[i];
+			uint index = g_Const.jointOffset + jointIndices[i];
 			float4x4 currentMatrix;
 			currentMatrix[0] = asfloat(t_JointMatrices.Load4(index * 64 + 0));
 			currentMatrix[1] = asfloat(t_JointMatrices.Load4(index * 64 + 16));
@@ -50,6 +50,8 @@ freely, subject to the following restrictions:
 #include <donut/app/DeviceManager.h>
 #include <donut/core/math/math.h>
 #include <donut/core/log.h>
+#include <donut/core/trace.h>
+#include <donut/engine/GpuProfiler.h>
 #include <nvrhi/utils.h>
 
 #include <cstdio>
@@ -268,7 +270,22 @@ bool DeviceManager::CreateHeadlessDevice(const DeviceCreationParameters& params)
     if (!CreateInstance(m_DeviceParams))
         return false;
 
-    return CreateDevice();
+    if (!CreateDevice())
+        return false;
+
+    CreateGpuProfiler();
+
+    return true;
+}
+
+void DeviceManager::CreateGpuProfiler()
+{
+    if (!m_DeviceParams.enableGpuProfiler)
+        return;
+
+    // Leave room for the frames queued in the swap chain on top of the CPU frames in flight
+    m_GpuProfiler = std::make_shared<engine::GpuProfiler>(GetDevice(), m_DeviceParams.maxFramesInFlight + 1);
+    engine::GpuProfiler::SetCurrent(m_GpuProfiler.get());
 }
 
 bool DeviceManager::CreateWindowDeviceAndSwapChain(const DeviceCreationParameters& params, const char *windowTitle)
@@ -375,6 +392,8 @@ bool DeviceManager::CreateWindowDeviceAndSwapChain(const DeviceCreationParameter
     if (!CreateSwapChain())
         return false;
 
+    CreateGpuProfiler();
+
     glfwShowWindow(m_Window);
     
     if (m_DeviceParams.startMaximized)
@@ -458,6 +477,8 @@ void DeviceManager::DisplayScaleChanged()
 
 void DeviceManager::Animate(double elapsedTime, bool windowIsFocused)
 {
+    DONUT_TRACE_ZONE("DeviceManager::Animate");
+
     for(auto it : m_vRenderPasses)
     {
         if (windowIsFocused || it->ShouldAnimateUnfocused())
@@ -470,6 +491,8 @@ void DeviceManager::Animate(double elapsedTime, bool windowIsFocused)
 
 void DeviceManager::Render()
 {    
+    DONUT_TRACE_ZONE("DeviceManager::Render");
+
     nvrhi::IFramebuffer* framebuffer = m_SwapChainFramebuffers[GetCurrentBackBufferIndex()];
 
     for (auto it : m_vRenderPasses)
@@ -506,6 +529,7 @@ bool DeviceManager::ShouldRenderUnfocused() const
 void DeviceManager::RunMessageLoop()
 {
     m_PreviousFrameTimestamp = glfwGetTime();
+    donut::trace::SetThreadName("Main");
 
 #if DONUT_WITH_AFTERMATH
     bool dumpingCrash = false;
@@ -585,6 +609,9 @@ bool DeviceManager::AnimateRenderPresent()
                     frameIndex--;
                 }
 
+                if (m_GpuProfiler)
+                    m_GpuProfiler->BeginFrame(frameIndex);
+
                 if (m_callbacks.beforeRender) m_callbacks.beforeRender(*this, frameIndex);
                 Render();
                 if (m_callbacks.afterRender) m_callbacks.afterRender(*this, frameIndex);
@@ -593,7 +620,11 @@ bool DeviceManager::AnimateRenderPresent()
                 StreamlineIntegration::Get().PresentStart(*this);
 #endif
                 if (m_callbacks.beforePresent) m_callbacks.beforePresent(*this, frameIndex);
-                bool presentSuccess = Present();
+                bool presentSuccess;
+                {
+                    DONUT_TRACE_ZONE("DeviceManager::Present");
+                    presentSuccess = Present();
+                }
                 if (m_callbacks.afterPresent) m_callbacks.afterPresent(*this, frameIndex);
 #if DONUT_WITH_STREAMLINE
                 StreamlineIntegration::Get().PresentEnd(*this);
@@ -616,11 +647,16 @@ bool DeviceManager::AnimateRenderPresent()
 
     std::this_thread::sleep_for(std::chrono::milliseconds(0));
 
-    GetDevice()->runGarbageCollection();
+    {
+        DONUT_TRACE_ZONE("RunGarbageCollection");
+        GetDevice()->runGarbageCollection();
+    }
 
     UpdateAverageFrameTime(elapsedTime);
     m_PreviousFrameTimestamp = curTime;
 
+    donut::trace::EndFrame(m_FrameIndex);
+
     ++m_FrameIndex;
     return true;
 }
@@ -885,6 +921,13 @@ void DeviceManager::Shutdown()
 
     m_SwapChainFramebuffers.clear();
 
+    if (m_GpuProfiler)
+    {
+        if (engine::GpuProfiler::GetCurrent() == m_GpuProfiler.get())
+            engine::GpuProfiler::SetCurrent(nullptr);
+        m_GpuProfiler = nullptr;
+    }
+
     DestroyDeviceAndSwapChain();
 
     if (m_Window)
@@ -0,0 +1,310 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/app/imgui_profiler.h>
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <unordered_map>
+
+using namespace donut::app;
+using namespace donut;
+
+static float NsToMs(uint64_t ns)
+{
+	return float(double(ns) * 1e-6);
+}
+
+// Stable color per zone name, so that the same zone looks the same across frames.
+static ImU32 GetZoneColor(const char* name)
+{
+	uint32_t hash = 2166136261u;
+	for (const char* c = name; *c; ++c)
+		hash = (hash ^ uint8_t(*c)) * 16777619u;
+
+	const float hue = float(hash % 360) / 360.f;
+	float r, g, b;
+	ImGui::ColorConvertHSVtoRGB(hue, 0.5f, 0.75f, r, g, b);
+	return ImGui::GetColorU32(ImVec4(r, g, b, 1.f));
+}
+
+void ImGui_Profiler::Render(bool* open)
+{
+	ImGui::SetNextWindowSize(ImVec2(900, 500), ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Profiler", open))
+	{
+		ImGui::End();
+		return;
+	}
+
+	bool enabled = trace::IsEnabled();
+	if (ImGui::Checkbox("Enable", &enabled))
+		trace::Enable(enabled);
+
+	ImGui::SameLine();
+	ImGui::Checkbox("Pause", &m_Paused);
+
+	ImGui::SameLine();
+	if (ImGui::Button("Export"))
+	{
+		m_ExportStatus = trace::WriteChromeTrace(m_Options.exportPath)
+			? "Saved " + m_Options.exportPath.generic_string()
+			: "Failed to write " + m_Options.exportPath.generic_string();
+	}
+
+	if (!m_ExportStatus.empty())
+	{
+		ImGui::SameLine();
+		ImGui::TextUnformatted(m_ExportStatus.c_str());
+	}
+
+	if (!m_Paused)
+	{
+		m_Frames = trace::GetFrameHistory();
+		m_SelectedFrame = -1;
+
+		if (engine::GpuProfiler* gpuProfiler = engine::GpuProfiler::GetCurrent())
+			m_GpuFrames = gpuProfiler->GetFrameHistory();
+	}
+
+	if (!engine::GpuProfiler::GetCurrent())
+		m_GpuFrames.clear();
+
+	if (m_Frames.empty())
+	{
+		ImGui::TextUnformatted("No frames recorded.");
+		ImGui::End();
+		return;
+	}
+
+	const trace::TraceStats stats = trace::GetStats();
+	ImGui::Text("Threads: %u, zones: %llu, dropped: %llu", stats.threadCount,
+		(unsigned long long)stats.recordedZones, (unsigned long long)stats.droppedZones);
+
+	// Frame time graph, clicking on it selects a frame and pauses the capture
+	std::vector<float> frameTimes;
+	frameTimes.reserve(m_Frames.size());
+	for (const trace::FrameRecord& frame : m_Frames)
+		frameTimes.push_back(NsToMs(frame.endNs - frame.beginNs));
+
+	ImGui::PlotHistogram("##FrameTimes", frameTimes.data(), int(frameTimes.size()), 0, "Frame time (ms)",
+		0.f, FLT_MAX, ImVec2(ImGui::GetContentRegionAvail().x, 60.f));
+
+	if (ImGui::IsItemClicked())
+	{
+		const float x = (ImGui::GetMousePos().x - ImGui::GetItemRectMin().x) / ImGui::GetItemRectSize().x;
+		m_SelectedFrame = std::clamp(int(x * float(m_Frames.size())), 0, int(m_Frames.size()) - 1);
+		m_Paused = true;
+	}
+
+	const trace::FrameRecord& frame = m_Frames[m_SelectedFrame >= 0 ? size_t(m_SelectedFrame) : m_Frames.size() - 1];
+	ImGui::Text("Frame %llu: %.3f ms", (unsigned long long)frame.frameIndex, NsToMs(frame.endNs - frame.beginNs));
+
+	ImGui::SameLine();
+	ImGui::SetNextItemWidth(150.f);
+	ImGui::SliderFloat("Zoom", &m_Zoom, 1.f, 50.f, "%.1fx", ImGuiSliderFlags_Logarithmic);
+
+	RenderTimeline(frame, trace::GetThreadNames());
+
+	if (!m_GpuFrames.empty() && ImGui::CollapsingHeader("GPU", ImGuiTreeNodeFlags_DefaultOpen))
+		RenderGpuZones(frame.frameIndex);
+
+	if (ImGui::CollapsingHeader("CPU Zones", ImGuiTreeNodeFlags_DefaultOpen))
+		RenderZoneTotals(frame);
+
+	ImGui::End();
+}
+
+void ImGui_Profiler::RenderTimeline(trace::FrameRecord const& frame, std::vector<std::string> const& threadNames)
+{
+	if (frame.endNs <= frame.beginNs)
+		return;
+
+	// Count the rows needed by each thread that has zones in this frame
+	std::vector<uint32_t> threadDepths(threadNames.size(), 0);
+	for (const trace::ZoneRecord& zone : frame.zones)
+	{
+		if (zone.endNs < frame.beginNs)
+			continue;
+
+		if (zone.threadIndex < threadDepths.size())
+			threadDepths[zone.threadIndex] = std::max(threadDepths[zone.threadIndex], zone.depth + 1);
+	}
+
+	float timelineHeight = 0.f;
+	for (uint32_t depth : threadDepths)
+	{
+		if (depth > 0)
+			timelineHeight += float(depth + 1) * m_Options.rowHeight;
+	}
+
+	ImGui::BeginChild("Timeline", ImVec2(0, std::min(timelineHeight + 20.f, 300.f)), true, ImGuiWindowFlags_HorizontalScrollbar);
+
+	const float width = ImGui::GetContentRegionAvail().x * m_Zoom;
+	const ImVec2 origin = ImGui::GetCursorScreenPos();
+	const double nsToPixels = double(width) / double(frame.endNs - frame.beginNs);
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+
+	const trace::ZoneRecord* hoveredZone = nullptr;
+	const ImVec2 mousePos = ImGui::GetMousePos();
+
+	float threadTop = origin.y;
+	for (size_t threadIndex = 0; threadIndex < threadDepths.size(); ++threadIndex)
+	{
+		if (threadDepths[threadIndex] == 0)
+			continue;
+
+		drawList->AddText(ImVec2(origin.x, threadTop), ImGui::GetColorU32(ImGuiCol_Text), threadNames[threadIndex].c_str());
+		const float zonesTop = threadTop + m_Options.rowHeight;
+
+		for (const trace::ZoneRecord& zone : frame.zones)
+		{
+			// Zones on external tracks, such as the GPU, may be collected after their frame has ended
+			if (zone.threadIndex != threadIndex || zone.endNs < frame.beginNs)
+				continue;
+
+			// Zones that started in the previous frame are clipped to the frame start
+			const uint64_t beginNs = std::max(zone.beginNs, frame.beginNs) - frame.beginNs;
+			const uint64_t endNs = std::max(zone.endNs, frame.beginNs) - frame.beginNs;
+
+			const ImVec2 minCorner(origin.x + float(double(beginNs) * nsToPixels), zonesTop + float(zone.depth) * m_Options.rowHeight);
+			const ImVec2 maxCorner(std::max(origin.x + float(double(endNs) * nsToPixels), minCorner.x + 1.f), minCorner.y + m_Options.rowHeight - 1.f);
+
+			drawList->AddRectFilled(minCorner, maxCorner, GetZoneColor(zone.name));
+
+			if (maxCorner.x - minCorner.x > 20.f)
+			{
+				drawList->PushClipRect(minCorner, maxCorner, true);
+				drawList->AddText(ImVec2(minCorner.x + 2.f, minCorner.y + 1.f), IM_COL32_BLACK, zone.name);
+				drawList->PopClipRect();
+			}
+
+			if (mousePos.x >= minCorner.x && mousePos.x < maxCorner.x && mousePos.y >= minCorner.y && mousePos.y < maxCorner.y)
+				hoveredZone = &zone;
+		}
+
+		threadTop = zonesTop + float(threadDepths[threadIndex]) * m_Options.rowHeight;
+	}
+
+	ImGui::Dummy(ImVec2(width, threadTop - origin.y));
+
+	if (hoveredZone && ImGui::IsWindowHovered())
+	{
+		ImGui::BeginTooltip();
+		ImGui::Text("%s: %.3f ms", hoveredZone->name, NsToMs(hoveredZone->endNs - hoveredZone->beginNs));
+		ImGui::EndTooltip();
+	}
+
+	ImGui::EndChild();
+}
+
+void ImGui_Profiler::RenderZoneTotals(trace::FrameRecord const& frame)
+{
+	struct ZoneTotal
+	{
+		const char* name = nullptr;
+		uint64_t totalNs = 0;
+		uint32_t count = 0;
+	};
+
+	// Zone names are literals, but the same literal may have several addresses, so group by the text
+	std::unordered_map<std::string, ZoneTotal> totalsMap;
+	for (const trace::ZoneRecord& zone : frame.zones)
+	{
+		ZoneTotal& total = totalsMap[zone.name];
+		total.name = zone.name;
+		total.totalNs += zone.endNs - zone.beginNs;
+		++total.count;
+	}
+
+	std::vector<ZoneTotal> totals;
+	totals.reserve(totalsMap.size());
+	for (const auto& it : totalsMap)
+		totals.push_back(it.second);
+
+	std::sort(totals.begin(), totals.end(), [](const ZoneTotal& a, const ZoneTotal& b) { return a.totalNs > b.totalNs; });
+
+	if (!ImGui::BeginTable("ZoneTotals", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY))
+		return;
+
+	ImGui::TableSetupScrollFreeze(0, 1);
+	ImGui::TableSetupColumn("Zone");
+	ImGui::TableSetupColumn("Total (ms)");
+	ImGui::TableSetupColumn("Count");
+	ImGui::TableHeadersRow();
+
+	for (const ZoneTotal& total : totals)
+	{
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(total.name);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", NsToMs(total.totalNs));
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", total.count);
+	}
+
+	ImGui::EndTable();
+}
+
+void ImGui_Profiler::RenderGpuZones(uint64_t frameIndex)
+{
+	// GPU results arrive a few frames late, so the selected CPU frame may not be resolved yet
+	const engine::GpuFrameRecord* gpuFrame = &m_GpuFrames.back();
+	for (const engine::GpuFrameRecord& candidate : m_GpuFrames)
+	{
+		if (candidate.frameIndex == frameIndex)
+			gpuFrame = &candidate;
+	}
+
+	ImGui::Text("GPU frame %llu: %.3f ms", (unsigned long long)gpuFrame->frameIndex, gpuFrame->totalMs);
+
+	if (!ImGui::BeginTable("GpuZones", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		return;
+
+	ImGui::TableSetupColumn("Zone");
+	ImGui::TableSetupColumn("Time (ms)");
+	ImGui::TableHeadersRow();
+
+	const float maxTime = std::max(gpuFrame->totalMs, 1e-3f);
+
+	for (const engine::GpuZoneRecord& zone : gpuFrame->zones)
+	{
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Indent(float(zone.depth) * 12.f + 1.f);
+		ImGui::TextUnformatted(zone.name);
+		ImGui::Unindent(float(zone.depth) * 12.f + 1.f);
+		ImGui::TableNextColumn();
+
+		char label[32];
+		snprintf(label, sizeof(label), "%.3f", zone.durationMs);
+		ImGui::PushStyleColor(ImGuiCol_PlotHistogram, GetZoneColor(zone.name));
+		ImGui::ProgressBar(zone.durationMs / maxTime, ImVec2(-1.f, 0.f), label);
+		ImGui::PopStyleColor();
+	}
+
+	ImGui::EndTable();
+}
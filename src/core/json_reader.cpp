@@ -0,0 +1,626 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/core/json_reader.h>
+#include <json/value.h>
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+namespace donut::json
+{
+    Reader::Reader(const char* data, size_t size)
+        : m_Data(data)
+        , m_Size(size)
+    {
+        // Skip the UTF-8 byte order mark
+        if (m_Size >= 3 && memcmp(m_Data, "\xEF\xBB\xBF", 3) == 0)
+            m_Position = 3;
+    }
+
+    bool Reader::SetError(const char* message)
+    {
+        if (m_Error.empty())
+        {
+            m_Error = message;
+            m_ErrorPosition = m_Position;
+        }
+        return false;
+    }
+
+    std::string Reader::GetErrorMessage() const
+    {
+        if (m_Error.empty())
+            return std::string();
+
+        int line = 1;
+        int column = 1;
+        for (size_t i = 0; i < m_ErrorPosition && i < m_Size; ++i)
+        {
+            if (m_Data[i] == '\n')
+            {
+                ++line;
+                column = 1;
+            }
+            else
+                ++column;
+        }
+
+        return "Line " + std::to_string(line) + ", Column " + std::to_string(column) + ": " + m_Error;
+    }
+
+    void Reader::SkipWhitespace()
+    {
+        while (m_Position < m_Size)
+        {
+            const char c = m_Data[m_Position];
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+            {
+                ++m_Position;
+            }
+            else if (c == '/' && m_Position + 1 < m_Size && m_Data[m_Position + 1] == '/')
+            {
+                const void* end = memchr(m_Data + m_Position, '\n', m_Size - m_Position);
+                m_Position = end ? size_t(static_cast<const char*>(end) - m_Data) : m_Size;
+            }
+            else if (c == '/' && m_Position + 1 < m_Size && m_Data[m_Position + 1] == '*')
+            {
+                m_Position += 2;
+                while (m_Position + 1 < m_Size && !(m_Data[m_Position] == '*' && m_Data[m_Position + 1] == '/'))
+                    ++m_Position;
+                m_Position = std::min(m_Position + 2, m_Size);
+            }
+            else
+                break;
+        }
+    }
+
+    bool Reader::Expect(char c)
+    {
+        if (HasError())
+            return false;
+
+        SkipWhitespace();
+        if (m_Position >= m_Size || m_Data[m_Position] != c)
+        {
+            char message[32];
+            snprintf(message, sizeof(message), "Expected '%c'", c);
+            return SetError(message);
+        }
+
+        ++m_Position;
+        return true;
+    }
+
+    Reader::ValueType Reader::Peek()
+    {
+        if (HasError())
+            return ValueType::Invalid;
+
+        SkipWhitespace();
+        if (m_Position >= m_Size)
+            return ValueType::Invalid;
+
+        switch (m_Data[m_Position])
+        {
+        case '{': return ValueType::Object;
+        case '[': return ValueType::Array;
+        case '"': return ValueType::String;
+        case 't':
+        case 'f': return ValueType::Boolean;
+        case 'n': return ValueType::Null;
+        case '-':
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9': return ValueType::Number;
+        default: return ValueType::Invalid;
+        }
+    }
+
+    bool Reader::BeginObject()
+    {
+        if (!Expect('{'))
+            return false;
+
+        m_HasItem.push_back(false);
+        return true;
+    }
+
+    bool Reader::BeginArray()
+    {
+        if (!Expect('['))
+            return false;
+
+        m_HasItem.push_back(false);
+        return true;
+    }
+
+    bool Reader::NextInContainer(char closing)
+    {
+        if (HasError())
+            return false;
+
+        SkipWhitespace();
+        if (m_Position >= m_Size)
+            return SetError("Unexpected end of file");
+
+        if (m_HasItem.empty())
+            return SetError("Not inside an object or array");
+
+        // Items are separated by commas, and a trailing comma is allowed before the closing bracket
+        const bool hasItem = m_HasItem.back();
+        bool hasComma = false;
+        if (hasItem && m_Data[m_Position] == ',')
+        {
+            hasComma = true;
+            ++m_Position;
+            SkipWhitespace();
+            if (m_Position >= m_Size)
+                return SetError("Unexpected end of file");
+        }
+
+        if (m_Data[m_Position] == closing)
+        {
+            ++m_Position;
+            m_HasItem.pop_back();
+            return false;
+        }
+
+        if (hasItem && !hasComma)
+            return SetError(closing == '}' ? "Expected ',' or '}'" : "Expected ',' or ']'");
+
+        m_HasItem.back() = true;
+        return true;
+    }
+
+    bool Reader::NextMember(std::string_view& key)
+    {
+        if (!NextInContainer('}'))
+            return false;
+
+        if (m_Data[m_Position] != '"')
+            return SetError("Expected a member name");
+
+        if (!ParseString(key))
+            return false;
+
+        return Expect(':');
+    }
+
+    bool Reader::NextElement()
+    {
+        return NextInContainer(']');
+    }
+
+    bool Reader::ParseString(std::string_view& value)
+    {
+        // Called with m_Position at the opening quote
+        const size_t begin = ++m_Position;
+
+        size_t position = begin;
+        while (position < m_Size && m_Data[position] != '"' && m_Data[position] != '\\')
+            ++position;
+
+        if (position >= m_Size)
+            return SetError("Unterminated string");
+
+        if (m_Data[position] == '"')
+        {
+            value = std::string_view(m_Data + begin, position - begin);
+            m_Position = position + 1;
+            return true;
+        }
+
+        // Slow path for strings with escape sequences
+        m_Scratch.assign(m_Data + begin, position - begin);
+        m_Position = position;
+
+        while (m_Position < m_Size)
+        {
+            const char c = m_Data[m_Position++];
+            if (c == '"')
+            {
+                value = m_Scratch;
+                return true;
+            }
+
+            if (c != '\\')
+            {
+                m_Scratch.push_back(c);
+                continue;
+            }
+
+            if (m_Position >= m_Size)
+                break;
+
+            const char escape = m_Data[m_Position++];
+            switch (escape)
+            {
+            case '"': m_Scratch.push_back('"'); break;
+            case '\\': m_Scratch.push_back('\\'); break;
+            case '/': m_Scratch.push_back('/'); break;
+            case 'b': m_Scratch.push_back('\b'); break;
+            case 'f': m_Scratch.push_back('\f'); break;
+            case 'n': m_Scratch.push_back('\n'); break;
+            case 'r': m_Scratch.push_back('\r'); break;
+            case 't': m_Scratch.push_back('\t'); break;
+            case 'u': {
+                auto readHex = [this](uint32_t& code)
+                {
+                    if (m_Position + 4 > m_Size)
+                        return false;
+                    auto result = std::from_chars(m_Data + m_Position, m_Data + m_Position + 4, code, 16);
+                    if (result.ptr != m_Data + m_Position + 4)
+                        return false;
+                    m_Position += 4;
+                    return true;
+                };
+
+                uint32_t code = 0;
+                if (!readHex(code))
+                    return SetError("Invalid unicode escape sequence");
+
+                // Combine UTF-16 surrogate pairs
+                if (code >= 0xD800 && code <= 0xDBFF && m_Position + 2 <= m_Size &&
+                    m_Data[m_Position] == '\\' && m_Data[m_Position + 1] == 'u')
+                {
+                    m_Position += 2;
+                    uint32_t low = 0;
+                    if (!readHex(low) || low < 0xDC00 || low > 0xDFFF)
+                        return SetError("Invalid unicode surrogate pair");
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+
+                if (code < 0x80)
+                    m_Scratch.push_back(char(code));
+                else if (code < 0x800)
+                {
+                    m_Scratch.push_back(char(0xC0 | (code >> 6)));
+                    m_Scratch.push_back(char(0x80 | (code & 0x3F)));
+                }
+                else if (code < 0x10000)
+                {
+                    m_Scratch.push_back(char(0xE0 | (code >> 12)));
+                    m_Scratch.push_back(char(0x80 | ((code >> 6) & 0x3F)));
+                    m_Scratch.push_back(char(0x80 | (code & 0x3F)));
+                }
+                else
+                {
+                    m_Scratch.push_back(char(0xF0 | (code >> 18)));
+                    m_Scratch.push_back(char(0x80 | ((code >> 12) & 0x3F)));
+                    m_Scratch.push_back(char(0x80 | ((code >> 6) & 0x3F)));
+                    m_Scratch.push_back(char(0x80 | (code & 0x3F)));
+                }
+                break;
+            }
+            default:
+                return SetError("Invalid escape sequence");
+            }
+        }
+
+        return SetError("Unterminated string");
+    }
+
+    bool Reader::SkipString()
+    {
+        // Called with m_Position at the opening quote
+        ++m_Position;
+        while (m_Position < m_Size)
+        {
+            const void* quote = memchr(m_Data + m_Position, '"', m_Size - m_Position);
+            if (!quote)
+                break;
+
+            const size_t quotePosition = size_t(static_cast<const char*>(quote) - m_Data);
+
+            // The quote is escaped if it's preceded by an odd number of backslashes
+            size_t backslashes = 0;
+            while (quotePosition - backslashes > m_Position && m_Data[quotePosition - backslashes - 1] == '\\')
+                ++backslashes;
+
+            m_Position = quotePosition + 1;
+            if ((backslashes & 1) == 0)
+                return true;
+        }
+
+        m_Position = m_Size;
+        return SetError("Unterminated string");
+    }
+
+    bool Reader::ReadString(std::string_view& value)
+    {
+        if (Peek() != ValueType::String)
+            return SetError("Expected a string");
+
+        return ParseString(value);
+    }
+
+    bool Reader::ScanNumber(std::string_view& token, bool& isInteger)
+    {
+        const size_t begin = m_Position;
+        isInteger = true;
+
+        while (m_Position < m_Size)
+        {
+            const char c = m_Data[m_Position];
+            if ((c >= '0' && c <= '9') || c == '-' || c == '+')
+                ++m_Position;
+            else if (c == '.' || c == 'e' || c == 'E')
+            {
+                isInteger = false;
+                ++m_Position;
+            }
+            else
+                break;
+        }
+
+        token = std::string_view(m_Data + begin, m_Position - begin);
+        return !token.empty();
+    }
+
+    bool Reader::ReadNumber(double& value)
+    {
+        if (Peek() != ValueType::Number)
+            return SetError("Expected a number");
+
+        std::string_view token;
+        bool isInteger = false;
+        if (!ScanNumber(token, isInteger))
+            return SetError("Invalid number");
+
+        auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+        if (result.ec != std::errc() || result.ptr != token.data() + token.size())
+        {
+            // Out of range values are accepted by jsoncpp, so don't fail on them
+            if (result.ec != std::errc::result_out_of_range)
+                return SetError("Invalid number");
+        }
+
+        return true;
+    }
+
+    bool Reader::MatchLiteral(const char* literal)
+    {
+        const size_t length = strlen(literal);
+        if (m_Position + length > m_Size || memcmp(m_Data + m_Position, literal, length) != 0)
+            return false;
+
+        m_Position += length;
+        return true;
+    }
+
+    bool Reader::ReadBool(bool& value)
+    {
+        if (Peek() != ValueType::Boolean)
+            return SetError("Expected a boolean");
+
+        if (MatchLiteral("true"))
+            value = true;
+        else if (MatchLiteral("false"))
+            value = false;
+        else
+            return SetError("Invalid literal");
+
+        return true;
+    }
+
+    bool Reader::ReadNull()
+    {
+        if (Peek() != ValueType::Null || !MatchLiteral("null"))
+            return SetError("Expected null");
+
+        return true;
+    }
+
+    int Reader::ReadNumbers(double* values, int maxCount)
+    {
+        const ValueType type = Peek();
+        if (type == ValueType::Number)
+        {
+            double value = 0.0;
+            if (!ReadNumber(value))
+                return -1;
+            if (maxCount > 0)
+                values[0] = value;
+            return 1;
+        }
+
+        if (type != ValueType::Array)
+        {
+            Skip();
+            return -1;
+        }
+
+        BeginArray();
+        int count = 0;
+        while (NextElement())
+        {
+            if (count < maxCount && Peek() == ValueType::Number)
+                ReadNumber(values[count]);
+            else
+            {
+                if (count < maxCount)
+                    values[count] = 0.0;
+                Skip();
+            }
+            ++count;
+        }
+
+        return HasError() ? -1 : count;
+    }
+
+    bool Reader::Skip()
+    {
+        switch (Peek())
+        {
+        case ValueType::Null:
+            return ReadNull();
+
+        case ValueType::Boolean: {
+            bool value;
+            return ReadBool(value);
+        }
+
+        case ValueType::Number: {
+            std::string_view token;
+            bool isInteger = false;
+            if (!ScanNumber(token, isInteger))
+                return SetError("Invalid number");
+            return true;
+        }
+
+        case ValueType::String:
+            return SkipString();
+
+        case ValueType::Array:
+        case ValueType::Object: {
+            // Scan to the matching bracket without parsing the contents
+            int depth = 0;
+            while (m_Position < m_Size)
+            {
+                const char c = m_Data[m_Position];
+                if (c == '"')
+                {
+                    if (!SkipString())
+                        return false;
+                    continue;
+                }
+
+                if (c == '/' && m_Position + 1 < m_Size && (m_Data[m_Position + 1] == '/' || m_Data[m_Position + 1] == '*'))
+                {
+                    SkipWhitespace();
+                    continue;
+                }
+
+                ++m_Position;
+                if (c == '{' || c == '[')
+                    ++depth;
+                else if (c == '}' || c == ']')
+                {
+                    if (--depth == 0)
+                        return true;
+                }
+            }
+            return SetError("Unexpected end of file");
+        }
+
+        default:
+            return SetError(m_Position >= m_Size ? "Unexpected end of file" : "Unexpected character");
+        }
+    }
+
+    bool Reader::ReadValue(Json::Value& value)
+    {
+        switch (Peek())
+        {
+        case ValueType::Null:
+            value = Json::Value();
+            return ReadNull();
+
+        case ValueType::Boolean: {
+            bool boolean = false;
+            if (!ReadBool(boolean))
+                return false;
+            value = boolean;
+            return true;
+        }
+
+        case ValueType::Number: {
+            std::string_view token;
+            bool isInteger = false;
+            if (!ScanNumber(token, isInteger))
+                return SetError("Invalid number");
+            const char* end = token.data() + token.size();
+
+            if (isInteger)
+            {
+                int64_t integer = 0;
+                if (std::from_chars(token.data(), end, integer).ptr == end)
+                {
+                    value = Json::Value(Json::Int64(integer));
+                    return true;
+                }
+
+                uint64_t unsignedInteger = 0;
+                if (std::from_chars(token.data(), end, unsignedInteger).ptr == end)
+                {
+                    value = Json::Value(Json::UInt64(unsignedInteger));
+                    return true;
+                }
+            }
+
+            double real = 0.0;
+            auto result = std::from_chars(token.data(), end, real);
+            if (result.ptr != end && result.ec != std::errc::result_out_of_range)
+                return SetError("Invalid number");
+
+            value = real;
+            return true;
+        }
+
+        case ValueType::String: {
+            std::string_view string;
+            if (!ParseString(string))
+                return false;
+            value = Json::Value(string.data(), string.data() + string.size());
+            return true;
+        }
+
+        case ValueType::Array: {
+            BeginArray();
+            value = Json::Value(Json::arrayValue);
+            while (NextElement())
+            {
+                if (!ReadValue(value.append(Json::Value())))
+                    return false;
+            }
+            return !HasError();
+        }
+
+        case ValueType::Object: {
+            BeginObject();
+            value = Json::Value(Json::objectValue);
+            std::string_view key;
+            while (NextMember(key))
+            {
+                if (!ReadValue(value[std::string(key)]))
+                    return false;
+            }
+            return !HasError();
+        }
+
+        default:
+            return SetError(m_Position >= m_Size ? "Unexpected end of file" : "Unexpected character");
+        }
+    }
+
+    size_t Reader::GetOffset()
+    {
+        SkipWhitespace();
+        return m_Position;
+    }
+
+    void Reader::SetOffset(size_t offset)
+    {
+        m_Position = std::min(offset, m_Size);
+    }
+}
@@ -21,10 +21,18 @@
 */
 
 #include <donut/core/log.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdarg>
+#include <cstring>
 #include <iterator>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #if _WIN32
 #include <Windows.h>
 #endif
@@ -45,7 +53,27 @@ namespace donut::log
     static bool g_OutputToConsole = true;
 #endif
 
+    static bool g_OutputTimestamps = false;
+
     static std::mutex g_LogMutex;
+
+    static const std::chrono::steady_clock::time_point g_StartTime = std::chrono::steady_clock::now();
+    static std::atomic<uint32_t> g_NextThreadIndex = 0;
+    static thread_local uint32_t t_ThreadIndex = g_NextThreadIndex.fetch_add(1);
+
+    // Time and thread of the message being delivered, set by the async logger's thread
+    // so that the default callback prints the time when the message was logged, not delivered.
+    struct MessageOrigin
+    {
+        double time;
+        uint32_t threadIndex;
+    };
+    static thread_local const MessageOrigin* t_DeliveredMessageOrigin = nullptr;
+
+    static double GetTimeSinceStart()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - g_StartTime).count();
+    }
     
     void DefaultCallback(Severity severity, const char* message)
     {
@@ -62,7 +90,16 @@ namespace donut::log
         }
 
         char buf[g_MessageBufferSize];
-        snprintf(buf, std::size(buf), "%s: %s", severityText, message);
+        if (g_OutputTimestamps)
+        {
+            const MessageOrigin origin = t_DeliveredMessageOrigin
+                ? *t_DeliveredMessageOrigin
+                : MessageOrigin{ GetTimeSinceStart(), t_ThreadIndex };
+
+            snprintf(buf, std::size(buf), "[%10.3f T%u] %s: %s", origin.time, origin.threadIndex, severityText, message);
+        }
+        else
+            snprintf(buf, std::size(buf), "%s: %s", severityText, message);
 
         {
             std::lock_guard<std::mutex> lockGuard(g_LogMutex);
@@ -101,9 +138,310 @@ namespace donut::log
         g_ErrorMessageCaption = (caption) ? caption : "";
     }
 
-    static Callback g_Callback = &DefaultCallback;
+    static std::shared_ptr<const Callback> g_Callback = std::make_shared<const Callback>(&DefaultCallback);
     static Severity g_MinSeverity = Severity::Info;
 
+    // Protects the g_Callback pointer. The callback is called through a copy of the pointer made
+    // under the lock, so that a slow callback doesn't block SetCallback, and a replaced callback
+    // stays alive until the calls that are already running return.
+    static std::mutex g_CallbackMutex;
+
+    static std::shared_ptr<const Callback> LoadCallback()
+    {
+        std::lock_guard<std::mutex> guard(g_CallbackMutex);
+        return g_Callback;
+    }
+
+    static std::atomic<uint32_t> g_MaxRepeats = 0;
+    static std::atomic<float> g_RepeatInterval = 1.f;
+    static std::atomic<uint64_t> g_DroppedMessages = 0;
+
+    // Multi-producer, single-consumer bounded queue of messages with a background delivery thread.
+    // The queue is a ring of records with per-record sequence numbers: producers claim a record
+    // with a CAS on the enqueue position, format the message directly into it, and publish it
+    // by advancing its sequence number. The consumer is the only thread that reads records.
+    class AsyncLogger
+    {
+    public:
+        explicit AsyncLogger(size_t capacity);
+        ~AsyncLogger();
+
+        // Returns false if the queue is full and the message wasn't queued.
+        bool TryEnqueue(Severity severity, const char* fmt, va_list args);
+        void Flush();
+        [[nodiscard]] bool IsLoggerThread() const { return std::this_thread::get_id() == m_Thread.get_id(); }
+
+    private:
+        struct Record
+        {
+            std::atomic<uint64_t> sequence;
+            Severity severity;
+            MessageOrigin origin;
+            char text[g_MessageBufferSize];
+        };
+
+        // Repeats are counted per distinct message and severity, compared by the full text
+        struct RepeatKey
+        {
+            Severity severity;
+            std::string text;
+
+            bool operator==(const RepeatKey& other) const { return severity == other.severity && text == other.text; }
+        };
+
+        struct RepeatKeyHash
+        {
+            size_t operator()(const RepeatKey& key) const { return std::hash<std::string>()(key.text) * 31 + size_t(key.severity); }
+        };
+
+        struct RepeatState
+        {
+            double windowStart = 0.0;
+            uint32_t count = 0;
+            uint32_t suppressed = 0;
+        };
+
+        std::unique_ptr<Record[]> m_Records;
+        uint64_t m_Mask = 0;
+
+        alignas(64) std::atomic<uint64_t> m_EnqueuePosition = 0;
+        alignas(64) uint64_t m_DequeuePosition = 0;
+        std::atomic<uint64_t> m_DeliveredCount = 0;
+
+        std::atomic<bool> m_Stop = false;
+        std::atomic<bool> m_Sleeping = false;
+        std::mutex m_WakeMutex;
+        std::condition_variable m_WakeCondition;
+        std::mutex m_FlushMutex;
+        std::condition_variable m_FlushCondition;
+
+        std::unordered_map<RepeatKey, RepeatState, RepeatKeyHash> m_Repeats;
+        RepeatKey m_LookupKey; // Reused for lookups to avoid allocating a string for every message
+        double m_LastRepeatSweep = 0.0;
+
+        std::thread m_Thread;
+
+        void ThreadProc();
+        bool DeliverPending();
+        void Deliver(Severity severity, const MessageOrigin& origin, const char* text);
+        [[nodiscard]] bool ShouldSuppress(const Record& record);
+        void SweepRepeats(double now, bool force);
+    };
+
+    AsyncLogger::AsyncLogger(size_t capacity)
+    {
+        size_t roundedCapacity = 2;
+        while (roundedCapacity < capacity)
+            roundedCapacity *= 2;
+
+        m_Records = std::make_unique<Record[]>(roundedCapacity);
+        m_Mask = roundedCapacity - 1;
+        for (size_t i = 0; i < roundedCapacity; ++i)
+            m_Records[i].sequence.store(i, std::memory_order_relaxed);
+
+        m_Thread = std::thread(&AsyncLogger::ThreadProc, this);
+    }
+
+    AsyncLogger::~AsyncLogger()
+    {
+        Flush();
+
+        m_Stop.store(true);
+        {
+            std::lock_guard<std::mutex> guard(m_WakeMutex);
+            m_WakeCondition.notify_one();
+        }
+        m_Thread.join();
+    }
+
+    bool AsyncLogger::TryEnqueue(Severity severity, const char* fmt, va_list args)
+    {
+        Record* record = nullptr;
+        uint64_t position = m_EnqueuePosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            record = &m_Records[position & m_Mask];
+            const uint64_t sequence = record->sequence.load(std::memory_order_acquire);
+            const int64_t difference = int64_t(sequence) - int64_t(position);
+
+            if (difference == 0)
+            {
+                if (m_EnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (difference < 0)
+                return false;
+            else
+                position = m_EnqueuePosition.load(std::memory_order_relaxed);
+        }
+
+        record->severity = severity;
+        record->origin.time = GetTimeSinceStart();
+        record->origin.threadIndex = t_ThreadIndex;
+        vsnprintf(record->text, std::size(record->text), fmt, args);
+
+        record->sequence.store(position + 1, std::memory_order_release);
+
+        if (m_Sleeping.load(std::memory_order_relaxed))
+            m_WakeCondition.notify_one();
+
+        return true;
+    }
+
+    void AsyncLogger::Flush()
+    {
+        if (IsLoggerThread())
+            return;
+
+        const uint64_t target = m_EnqueuePosition.load();
+
+        {
+            std::lock_guard<std::mutex> guard(m_WakeMutex);
+            m_WakeCondition.notify_one();
+        }
+
+        std::unique_lock<std::mutex> lock(m_FlushMutex);
+        m_FlushCondition.wait(lock, [this, target]() { return m_DeliveredCount.load() >= target; });
+    }
+
+    void AsyncLogger::ThreadProc()
+    {
+        while (true)
+        {
+            const bool delivered = DeliverPending();
+
+            if (!m_Repeats.empty())
+                SweepRepeats(GetTimeSinceStart(), false);
+
+            if (delivered)
+                continue;
+
+            if (m_Stop.load())
+                break;
+
+            // Producers only notify when they see the sleeping flag, so a wakeup can be missed
+            // if a message arrives right before the flag is set. The timeout bounds that delay.
+            std::unique_lock<std::mutex> lock(m_WakeMutex);
+            m_Sleeping.store(true);
+            m_WakeCondition.wait_for(lock, std::chrono::milliseconds(10), [this]()
+            {
+                const Record& record = m_Records[m_DequeuePosition & m_Mask];
+                return m_Stop.load() || record.sequence.load(std::memory_order_acquire) == m_DequeuePosition + 1;
+            });
+            m_Sleeping.store(false);
+        }
+
+        SweepRepeats(0.0, true);
+    }
+
+    bool AsyncLogger::DeliverPending()
+    {
+        bool delivered = false;
+        while (true)
+        {
+            Record& record = m_Records[m_DequeuePosition & m_Mask];
+            if (record.sequence.load(std::memory_order_acquire) != m_DequeuePosition + 1)
+                break;
+
+            if (!ShouldSuppress(record))
+                Deliver(record.severity, record.origin, record.text);
+
+            record.sequence.store(m_DequeuePosition + m_Mask + 1, std::memory_order_release);
+            ++m_DequeuePosition;
+            m_DeliveredCount.fetch_add(1);
+            delivered = true;
+        }
+
+        if (delivered)
+        {
+            std::lock_guard<std::mutex> guard(m_FlushMutex);
+            m_FlushCondition.notify_all();
+        }
+
+        return delivered;
+    }
+
+    void AsyncLogger::Deliver(Severity severity, const MessageOrigin& origin, const char* text)
+    {
+        const std::shared_ptr<const Callback> callback = LoadCallback();
+
+        t_DeliveredMessageOrigin = &origin;
+        (*callback)(severity, text);
+        t_DeliveredMessageOrigin = nullptr;
+    }
+
+    bool AsyncLogger::ShouldSuppress(const Record& record)
+    {
+        const uint32_t maxRepeats = g_MaxRepeats.load(std::memory_order_relaxed);
+        if (maxRepeats == 0 || record.severity == Severity::Fatal)
+            return false;
+
+        m_LookupKey.severity = record.severity;
+        m_LookupKey.text.assign(record.text);
+        auto it = m_Repeats.find(m_LookupKey);
+        if (it == m_Repeats.end())
+            it = m_Repeats.emplace(m_LookupKey, RepeatState()).first;
+
+        const RepeatKey& key = it->first;
+        RepeatState& state = it->second;
+
+        if (state.count == 0 || record.origin.time - state.windowStart > double(g_RepeatInterval.load(std::memory_order_relaxed)))
+        {
+            if (state.suppressed != 0)
+            {
+                char summary[g_MessageBufferSize];
+                snprintf(summary, std::size(summary), "Suppressed %u repeats of the message: %s",
+                    state.suppressed, key.text.c_str());
+                Deliver(key.severity, record.origin, summary);
+            }
+
+            state.windowStart = record.origin.time;
+            state.count = 0;
+            state.suppressed = 0;
+        }
+
+        ++state.count;
+        if (state.count <= maxRepeats)
+            return false;
+
+        ++state.suppressed;
+        return true;
+    }
+
+    void AsyncLogger::SweepRepeats(double now, bool force)
+    {
+        const double interval = double(g_RepeatInterval.load(std::memory_order_relaxed));
+        if (!force && now - m_LastRepeatSweep < interval)
+            return;
+
+        m_LastRepeatSweep = now;
+
+        for (auto it = m_Repeats.begin(); it != m_Repeats.end(); )
+        {
+            RepeatState& state = it->second;
+            if (!force && now - state.windowStart <= interval)
+            {
+                ++it;
+                continue;
+            }
+
+            if (state.suppressed != 0)
+            {
+                char summary[g_MessageBufferSize];
+                snprintf(summary, std::size(summary), "Suppressed %u repeats of the message: %s",
+                    state.suppressed, it->first.text.c_str());
+                const MessageOrigin origin{ state.windowStart + interval, t_ThreadIndex };
+                Deliver(it->first.severity, origin, summary);
+            }
+
+            it = m_Repeats.erase(it);
+        }
+    }
+
+    // Declared after g_Callback so that the logger thread is stopped before the callback is destroyed at exit.
+    static std::unique_ptr<AsyncLogger> g_AsyncLogger;
+    static std::atomic<AsyncLogger*> g_ActiveAsyncLogger = nullptr;
+
     void SetMinSeverity(Severity severity)
     {
         g_MinSeverity = severity;
@@ -111,17 +449,21 @@ namespace donut::log
 
     void SetCallback(Callback func)
     {
-        g_Callback = func;
+        auto callback = std::make_shared<const Callback>(std::move(func));
+        std::lock_guard<std::mutex> guard(g_CallbackMutex);
+        g_Callback = std::move(callback);
     }
 
 	Callback GetCallback()
 	{
-		return g_Callback;
+		return *LoadCallback();
 	}
 
     void ResetCallback()
     {
-        g_Callback = &DefaultCallback;
+        auto callback = std::make_shared<const Callback>(&DefaultCallback);
+        std::lock_guard<std::mutex> guard(g_CallbackMutex);
+        g_Callback = std::move(callback);
     }
     
     void EnableOutputToMessageBox(bool enable)
@@ -146,18 +488,88 @@ namespace donut::log
         g_OutputToMessageBox = false;
     }
 
+    void EnableAsyncMode(bool enable, size_t queueCapacity)
+    {
+        g_ActiveAsyncLogger.store(nullptr);
+        g_AsyncLogger.reset();
+
+        if (enable)
+        {
+            g_AsyncLogger = std::make_unique<AsyncLogger>(queueCapacity);
+            g_ActiveAsyncLogger.store(g_AsyncLogger.get());
+        }
+    }
+
+    void Flush()
+    {
+        if (AsyncLogger* logger = g_ActiveAsyncLogger.load())
+            logger->Flush();
+    }
+
+    void SetRepeatedMessageLimit(uint32_t maxRepeats, float intervalSeconds)
+    {
+        g_MaxRepeats.store(maxRepeats);
+        g_RepeatInterval.store(intervalSeconds);
+    }
+
+    void EnableTimestamps(bool enable)
+    {
+        g_OutputTimestamps = enable;
+    }
+
+    uint64_t GetDroppedMessageCount()
+    {
+        return g_DroppedMessages.load();
+    }
+
+    static void vmessage(Severity severity, const char* fmt, va_list args)
+    {
+        AsyncLogger* logger = g_ActiveAsyncLogger.load(std::memory_order_acquire);
+
+        // Messages logged from the callback on the logger thread are delivered directly,
+        // because that thread can't wait for space in the queue that it drains.
+        if (logger && severity != Severity::Fatal && !logger->IsLoggerThread())
+        {
+            while (true)
+            {
+                va_list argsCopy;
+                va_copy(argsCopy, args);
+                const bool queued = logger->TryEnqueue(severity, fmt, argsCopy);
+                va_end(argsCopy);
+
+                if (queued)
+                    return;
+
+                if (severity == Severity::Debug || severity == Severity::Info)
+                {
+                    g_DroppedMessages.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+
+                std::this_thread::yield();
+            }
+        }
+
+        char buffer[g_MessageBufferSize];
+        vsnprintf(buffer, std::size(buffer), fmt, args);
+
+        if (logger && severity == Severity::Fatal)
+        {
+            // Make sure that everything logged before the fatal error is delivered before the process terminates.
+            logger->Flush();
+        }
+
+        (*LoadCallback())(severity, buffer);
+    }
+
     void message(Severity severity, const char* fmt...)
     {
         if (static_cast<int>(g_MinSeverity) > static_cast<int>(severity))
             return;
 
-        char buffer[g_MessageBufferSize];
         va_list args;
         va_start(args, fmt);
-        vsnprintf(buffer, std::size(buffer), fmt, args);
-
-        g_Callback(severity, buffer);
-
+        vmessage(severity, fmt, args);
         va_end(args);
     }
 
@@ -166,13 +578,9 @@ namespace donut::log
         if (static_cast<int>(g_MinSeverity) > static_cast<int>(Severity::Debug))
             return;
 
-        char buffer[g_MessageBufferSize];
         va_list args;
         va_start(args, fmt);
-        vsnprintf(buffer, std::size(buffer), fmt, args);
-
-        g_Callback(Severity::Debug, buffer);
-
+        vmessage(Severity::Debug, fmt, args);
         va_end(args);
     }
 
@@ -181,13 +589,9 @@ namespace donut::log
         if (static_cast<int>(g_MinSeverity) > static_cast<int>(Severity::Info))
             return;
 
-        char buffer[g_MessageBufferSize];
         va_list args;
         va_start(args, fmt);
-        vsnprintf(buffer, std::size(buffer), fmt, args);
-
-        g_Callback(Severity::Info, buffer);
-
+        vmessage(Severity::Info, fmt, args);
         va_end(args);
     }
 
@@ -196,13 +600,9 @@ namespace donut::log
         if (static_cast<int>(g_MinSeverity) > static_cast<int>(Severity::Warning))
             return;
 
-        char buffer[g_MessageBufferSize];
         va_list args;
         va_start(args, fmt);
-        vsnprintf(buffer, std::size(buffer), fmt, args);
-
-        g_Callback(Severity::Warning, buffer);
-
+        vmessage(Severity::Warning, fmt, args);
         va_end(args);
     }
 
@@ -211,25 +611,17 @@ namespace donut::log
         if (static_cast<int>(g_MinSeverity) > static_cast<int>(Severity::Error))
             return;
 
-        char buffer[g_MessageBufferSize];
         va_list args;
         va_start(args, fmt);
-        vsnprintf(buffer, std::size(buffer), fmt, args);
-
-        g_Callback(Severity::Error, buffer);
-
+        vmessage(Severity::Error, fmt, args);
         va_end(args);
     }
 
     void fatal(const char* fmt...)
     {
-        char buffer[g_MessageBufferSize];
         va_list args;
         va_start(args, fmt);
-        vsnprintf(buffer, std::size(buffer), fmt, args);
-
-        g_Callback(Severity::Fatal, buffer);
-
+        vmessage(Severity::Fatal, fmt, args);
         va_end(args);
     }
 }
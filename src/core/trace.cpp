@@ -0,0 +1,299 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/core/trace.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace donut::trace
+{
+    std::atomic<bool> g_Enabled = false;
+
+    static constexpr uint64_t c_ThreadBufferSize = 1 << 14;
+
+    // Single-producer, single-consumer ring of completed zones. The owning thread writes records,
+    // and EndFrame reads them under g_Mutex.
+    struct ThreadBuffer
+    {
+        std::unique_ptr<ZoneRecord[]> records = std::make_unique<ZoneRecord[]>(c_ThreadBufferSize);
+        alignas(64) std::atomic<uint64_t> writePosition = 0;
+        alignas(64) std::atomic<uint64_t> readPosition = 0;
+        std::atomic<uint64_t> droppedZones = 0;
+        uint32_t depth = 0; // Only accessed by the owning thread
+        uint32_t index = 0;
+        std::string name;
+    };
+
+    static std::mutex g_Mutex;
+
+    // Buffers are never released, so that the zones recorded by threads that have exited can still be collected.
+    static std::vector<std::unique_ptr<ThreadBuffer>> g_ThreadBuffers;
+    static std::deque<FrameRecord> g_FrameHistory;
+    static uint32_t g_HistoryLength = 120;
+    static uint64_t g_LastFrameEndNs = 0;
+    static uint64_t g_RecordedZones = 0;
+
+    static const std::chrono::steady_clock::time_point g_Epoch = std::chrono::steady_clock::now();
+
+    static ThreadBuffer& GetThreadBuffer()
+    {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer)
+        {
+            std::lock_guard<std::mutex> guard(g_Mutex);
+            auto newBuffer = std::make_unique<ThreadBuffer>();
+            newBuffer->index = uint32_t(g_ThreadBuffers.size());
+            newBuffer->name = "Thread " + std::to_string(newBuffer->index);
+            buffer = newBuffer.get();
+            g_ThreadBuffers.push_back(std::move(newBuffer));
+        }
+        return *buffer;
+    }
+
+    void Enable(bool enable)
+    {
+        g_Enabled.store(enable);
+    }
+
+    void SetHistoryLength(uint32_t frames)
+    {
+        std::lock_guard<std::mutex> guard(g_Mutex);
+        g_HistoryLength = std::max(frames, 1u);
+        while (g_FrameHistory.size() > g_HistoryLength)
+            g_FrameHistory.pop_front();
+    }
+
+    void SetThreadName(const char* name)
+    {
+        ThreadBuffer& buffer = GetThreadBuffer();
+        std::lock_guard<std::mutex> guard(g_Mutex);
+        buffer.name = name ? name : "";
+    }
+
+    uint64_t GetTimeNs()
+    {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_Epoch).count());
+    }
+
+    static void RecordZone(ThreadBuffer& buffer, const char* name, uint64_t beginNs, uint64_t endNs, uint32_t depth)
+    {
+        const uint64_t writePosition = buffer.writePosition.load(std::memory_order_relaxed);
+        if (writePosition - buffer.readPosition.load(std::memory_order_acquire) >= c_ThreadBufferSize)
+        {
+            buffer.droppedZones.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        ZoneRecord& record = buffer.records[writePosition & (c_ThreadBufferSize - 1)];
+        record.name = name;
+        record.beginNs = beginNs;
+        record.endNs = endNs;
+        record.threadIndex = buffer.index;
+        record.depth = depth;
+
+        buffer.writePosition.store(writePosition + 1, std::memory_order_release);
+    }
+
+    void RecordZone(const char* name, uint64_t beginNs, uint64_t endNs, uint32_t depth)
+    {
+        RecordZone(GetThreadBuffer(), name, beginNs, endNs, depth);
+    }
+
+    uint32_t RegisterTrack(const char* name)
+    {
+        std::lock_guard<std::mutex> guard(g_Mutex);
+        auto buffer = std::make_unique<ThreadBuffer>();
+        buffer->index = uint32_t(g_ThreadBuffers.size());
+        buffer->name = name ? name : "";
+        g_ThreadBuffers.push_back(std::move(buffer));
+        return g_ThreadBuffers.back()->index;
+    }
+
+    void RecordTrackZone(uint32_t track, const char* name, uint64_t beginNs, uint64_t endNs, uint32_t depth)
+    {
+        ThreadBuffer* buffer;
+        {
+            std::lock_guard<std::mutex> guard(g_Mutex);
+            if (track >= g_ThreadBuffers.size())
+                return;
+            buffer = g_ThreadBuffers[track].get();
+        }
+        RecordZone(*buffer, name, beginNs, endNs, depth);
+    }
+
+    void ScopedZone::Begin(const char* name)
+    {
+        ThreadBuffer& buffer = GetThreadBuffer();
+        m_Name = name;
+        m_Depth = buffer.depth++;
+        m_BeginNs = GetTimeNs();
+    }
+
+    void ScopedZone::End()
+    {
+        const uint64_t endNs = GetTimeNs();
+        --GetThreadBuffer().depth;
+        RecordZone(m_Name, m_BeginNs, endNs, m_Depth);
+    }
+
+    void EndFrame(uint64_t frameIndex)
+    {
+        const uint64_t now = GetTimeNs();
+
+        std::lock_guard<std::mutex> guard(g_Mutex);
+
+        FrameRecord frame;
+        frame.frameIndex = frameIndex;
+        frame.beginNs = g_LastFrameEndNs;
+        frame.endNs = now;
+        g_LastFrameEndNs = now;
+
+        for (const auto& buffer : g_ThreadBuffers)
+        {
+            const uint64_t writePosition = buffer->writePosition.load(std::memory_order_acquire);
+            const uint64_t readPosition = buffer->readPosition.load(std::memory_order_relaxed);
+
+            for (uint64_t position = readPosition; position < writePosition; ++position)
+                frame.zones.push_back(buffer->records[position & (c_ThreadBufferSize - 1)]);
+
+            buffer->readPosition.store(writePosition, std::memory_order_release);
+        }
+
+        if (frame.zones.empty() && !IsEnabled())
+            return;
+
+        std::sort(frame.zones.begin(), frame.zones.end(), [](const ZoneRecord& a, const ZoneRecord& b)
+        {
+            if (a.threadIndex != b.threadIndex)
+                return a.threadIndex < b.threadIndex;
+            if (a.beginNs != b.beginNs)
+                return a.beginNs < b.beginNs;
+            return a.depth < b.depth;
+        });
+
+        g_RecordedZones += frame.zones.size();
+        g_FrameHistory.push_back(std::move(frame));
+        while (g_FrameHistory.size() > g_HistoryLength)
+            g_FrameHistory.pop_front();
+    }
+
+    std::vector<FrameRecord> GetFrameHistory()
+    {
+        std::lock_guard<std::mutex> guard(g_Mutex);
+        return std::vector<FrameRecord>(g_FrameHistory.begin(), g_FrameHistory.end());
+    }
+
+    std::vector<std::string> GetThreadNames()
+    {
+        std::lock_guard<std::mutex> guard(g_Mutex);
+        std::vector<std::string> names;
+        for (const auto& buffer : g_ThreadBuffers)
+            names.push_back(buffer->name);
+        return names;
+    }
+
+    TraceStats GetStats()
+    {
+        std::lock_guard<std::mutex> guard(g_Mutex);
+        TraceStats stats;
+        stats.recordedZones = g_RecordedZones;
+        stats.threadCount = uint32_t(g_ThreadBuffers.size());
+        for (const auto& buffer : g_ThreadBuffers)
+            stats.droppedZones += buffer->droppedZones.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void ClearHistory()
+    {
+        std::lock_guard<std::mutex> guard(g_Mutex);
+        g_FrameHistory.clear();
+    }
+
+    static void WriteJsonString(std::ofstream& file, const char* text)
+    {
+        file << '"';
+        for (const char* c = text; c && *c; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+                file << '\\';
+            if (uint8_t(*c) >= 0x20)
+                file << *c;
+        }
+        file << '"';
+    }
+
+    static void WriteMicroseconds(std::ofstream& file, uint64_t ns)
+    {
+        file << ns / 1000 << '.' << char('0' + (ns / 100) % 10) << char('0' + (ns / 10) % 10) << char('0' + ns % 10);
+    }
+
+    bool WriteChromeTrace(const std::filesystem::path& fileName)
+    {
+        std::vector<FrameRecord> frames = GetFrameHistory();
+        std::vector<std::string> threadNames = GetThreadNames();
+
+        std::ofstream file(fileName);
+        if (!file.is_open())
+            return false;
+
+        // Frames go to a separate track after the threads because they overlap the zones on the main thread
+        const size_t frameTrack = threadNames.size();
+
+        file << "{\"traceEvents\":[\n";
+
+        for (size_t threadIndex = 0; threadIndex < threadNames.size(); ++threadIndex)
+        {
+            file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadIndex << ",\"args\":{\"name\":";
+            WriteJsonString(file, threadNames[threadIndex].c_str());
+            file << "}},\n";
+        }
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << frameTrack << ",\"args\":{\"name\":\"Frames\"}}";
+
+        for (const FrameRecord& frame : frames)
+        {
+            file << ",\n{\"name\":\"Frame " << frame.frameIndex << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << frameTrack << ",\"ts\":";
+            WriteMicroseconds(file, frame.beginNs);
+            file << ",\"dur\":";
+            WriteMicroseconds(file, frame.endNs - frame.beginNs);
+            file << "}";
+
+            for (const ZoneRecord& zone : frame.zones)
+            {
+                file << ",\n{\"name\":";
+                WriteJsonString(file, zone.name);
+                file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << zone.threadIndex << ",\"ts\":";
+                WriteMicroseconds(file, zone.beginNs);
+                file << ",\"dur\":";
+                WriteMicroseconds(file, zone.endNs - zone.beginNs);
+                file << "}";
+            }
+        }
+
+        file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+        return file.good();
+    }
+}
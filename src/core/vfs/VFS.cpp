@@ -30,10 +30,15 @@
 #include <sstream>
 
 #ifdef WIN32
+#include <Windows.h>
 #include <Shlwapi.h>
 #else
 extern "C" {
 #include <glob.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 }
 #endif // _WIN32
 
@@ -122,6 +127,95 @@ std::shared_ptr<IBlob> NativeFileSystem::readFile(const std::filesystem::path& n
     return std::make_shared<Blob>(data, size);
 }
 
+namespace
+{
+    // Read-only view of an entire file, unmapped when the blob is destroyed.
+    class MappedFileBlob : public IBlob
+    {
+    private:
+        void* m_data = nullptr;
+        size_t m_size = 0;
+#ifdef WIN32
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_mapping = nullptr;
+#endif
+
+    public:
+        bool open(const std::filesystem::path& name)
+        {
+#ifdef WIN32
+            m_file = CreateFileW(name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (m_file == INVALID_HANDLE_VALUE)
+                return false;
+
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0 ||
+                uint64_t(fileSize.QuadPart) > uint64_t(std::numeric_limits<size_t>::max()))
+                return false;
+
+            m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!m_mapping)
+                return false;
+
+            m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+            m_size = size_t(fileSize.QuadPart);
+#else
+            int fd = ::open(name.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+
+            struct stat fileStat;
+            if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0)
+            {
+                close(fd);
+                return false;
+            }
+
+            void* data = mmap(nullptr, size_t(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            
+            // The mapping keeps its own reference to the file
+            close(fd);
+
+            if (data == MAP_FAILED)
+                return false;
+
+            m_data = data;
+            m_size = size_t(fileStat.st_size);
+#endif
+            return m_data != nullptr;
+        }
+
+        ~MappedFileBlob() override
+        {
+#ifdef WIN32
+            if (m_data)
+                UnmapViewOfFile(m_data);
+            if (m_mapping)
+                CloseHandle(m_mapping);
+            if (m_file != INVALID_HANDLE_VALUE)
+                CloseHandle(m_file);
+#else
+            if (m_data)
+                munmap(m_data, m_size);
+#endif
+        }
+
+        [[nodiscard]] const void* data() const override { return m_data; }
+        [[nodiscard]] size_t size() const override { return m_size; }
+    };
+}
+
+std::shared_ptr<IBlob> NativeFileSystem::mapFile(const std::filesystem::path& name)
+{
+    auto blob = std::make_shared<MappedFileBlob>();
+    if (blob->open(name))
+        return blob;
+
+    // Empty files and file systems that don't support mapping
+    return readFile(name);
+}
+
 bool NativeFileSystem::writeFile(const std::filesystem::path& name, const void* data, size_t size)
 {
     // TODO: better error reporting
@@ -272,6 +366,11 @@ std::shared_ptr<IBlob> RelativeFileSystem::readFile(const std::filesystem::path&
     return m_UnderlyingFS->readFile(m_BasePath / name.relative_path());
 }
 
+std::shared_ptr<IBlob> RelativeFileSystem::mapFile(const std::filesystem::path& name)
+{
+    return m_UnderlyingFS->mapFile(m_BasePath / name.relative_path());
+}
+
 bool RelativeFileSystem::writeFile(const std::filesystem::path& name, const void* data, size_t size)
 {
     return m_UnderlyingFS->writeFile(m_BasePath / name.relative_path(), data, size);
@@ -384,6 +483,19 @@ std::shared_ptr<IBlob> RootFileSystem::readFile(const std::filesystem::path& nam
     return nullptr;
 }
 
+std::shared_ptr<IBlob> RootFileSystem::mapFile(const std::filesystem::path& name)
+{
+    std::filesystem::path relativePath;
+    IFileSystem* fs = nullptr;
+
+    if (findMountPoint(name, &relativePath, &fs))
+    {
+        return fs->mapFile(relativePath);
+    }
+
+    return nullptr;
+}
+
 bool RootFileSystem::writeFile(const std::filesystem::path& name, const void* data, size_t size)
 {
     std::filesystem::path relativePath;
@@ -0,0 +1,330 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/AnimationSystem.h>
+#include <donut/core/log.h>
+#include <donut/core/trace.h>
+#include <algorithm>
+#include <unordered_map>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+using namespace donut::math;
+using namespace donut::engine;
+
+AnimationSystem::AnimationSystem(std::shared_ptr<SceneGraph> graph)
+    : m_Graph(std::move(graph))
+{
+}
+
+AnimationSystem::Playback* AnimationSystem::FindPlayback(PlaybackHandle handle)
+{
+    auto it = std::find_if(m_Playbacks.begin(), m_Playbacks.end(),
+        [handle](const Playback& playback) { return playback.handle == handle; });
+
+    return (it != m_Playbacks.end()) ? &*it : nullptr;
+}
+
+const AnimationSystem::Playback* AnimationSystem::FindPlayback(PlaybackHandle handle) const
+{
+    auto it = std::find_if(m_Playbacks.begin(), m_Playbacks.end(),
+        [handle](const Playback& playback) { return playback.handle == handle; });
+
+    return (it != m_Playbacks.end()) ? &*it : nullptr;
+}
+
+AnimationSystem::PlaybackHandle AnimationSystem::Play(const std::shared_ptr<SceneGraphAnimation>& animation, float weight, bool loop)
+{
+    if (!animation)
+        return -1;
+
+    Playback playback;
+    playback.handle = m_NextHandle++;
+    playback.animation = animation;
+    playback.clip = std::make_unique<CompiledAnimationClip>(*animation);
+    playback.weight = weight;
+    playback.loop = loop;
+    m_Playbacks.push_back(std::move(playback));
+
+    m_SlotsDirty = true;
+    return m_Playbacks.back().handle;
+}
+
+void AnimationSystem::Stop(PlaybackHandle playback)
+{
+    auto it = std::find_if(m_Playbacks.begin(), m_Playbacks.end(),
+        [playback](const Playback& item) { return item.handle == playback; });
+
+    if (it != m_Playbacks.end())
+    {
+        // Erase preserves the order of the remaining playbacks, which defines the blending order
+        m_Playbacks.erase(it);
+        m_SlotsDirty = true;
+    }
+}
+
+void AnimationSystem::StopAll()
+{
+    m_Playbacks.clear();
+    m_SlotsDirty = true;
+}
+
+void AnimationSystem::SetWeight(PlaybackHandle playback, float weight)
+{
+    if (Playback* item = FindPlayback(playback))
+        item->weight = weight;
+}
+
+void AnimationSystem::SetSpeed(PlaybackHandle playback, float speed)
+{
+    if (Playback* item = FindPlayback(playback))
+        item->speed = speed;
+}
+
+void AnimationSystem::SetTime(PlaybackHandle playback, float time)
+{
+    if (Playback* item = FindPlayback(playback))
+        item->time = time;
+}
+
+float AnimationSystem::GetTime(PlaybackHandle playback) const
+{
+    const Playback* item = FindPlayback(playback);
+    return item ? item->time : 0.f;
+}
+
+void AnimationSystem::Recompile()
+{
+    for (Playback& playback : m_Playbacks)
+        playback.clip = std::make_unique<CompiledAnimationClip>(*playback.animation);
+
+    m_SlotsDirty = true;
+}
+
+void AnimationSystem::UpdateSlots()
+{
+    // Keep the rest poses of the nodes that were already animated, their current transforms are animated values
+    std::unordered_map<SceneGraphNode*, const NodeSlot*> previousSlots;
+    std::vector<NodeSlot> previousSlotStorage;
+    previousSlotStorage.swap(m_Slots);
+    for (const NodeSlot& slot : previousSlotStorage)
+        previousSlots[slot.node] = &slot;
+
+    std::unordered_map<SceneGraphNode*, uint32_t> slotIndices;
+
+    for (Playback& playback : m_Playbacks)
+    {
+        const auto& nodeTracks = playback.clip->GetNodeTracks();
+        playback.nodeSlots.resize(nodeTracks.size());
+
+        for (size_t track = 0; track < nodeTracks.size(); ++track)
+        {
+            SceneGraphNode* node = nodeTracks[track].node;
+            auto it = slotIndices.find(node);
+            if (it == slotIndices.end())
+            {
+                it = slotIndices.insert(std::make_pair(node, uint32_t(m_Slots.size()))).first;
+
+                NodeSlot& slot = m_Slots.emplace_back();
+                slot.node = node;
+
+                auto previous = previousSlots.find(node);
+                if (previous != previousSlots.end())
+                {
+                    slot.restTranslation = previous->second->restTranslation;
+                    slot.restRotation = previous->second->restRotation;
+                    slot.restScaling = previous->second->restScaling;
+                }
+                else
+                {
+                    slot.restTranslation = node->GetTranslation();
+                    slot.restRotation = node->GetRotation();
+                    slot.restScaling = node->GetScaling();
+                }
+            }
+            playback.nodeSlots[track] = it->second;
+        }
+    }
+
+    m_SlotsDirty = false;
+}
+
+void AnimationSystem::Advance(float elapsedTime)
+{
+    for (Playback& playback : m_Playbacks)
+    {
+        playback.time += elapsedTime * playback.speed;
+
+        const float duration = playback.clip->GetDuration();
+        if (playback.loop && duration > 0.f)
+        {
+            playback.time = fmodf(playback.time, duration);
+            if (playback.time < 0.f)
+                playback.time += duration;
+        }
+    }
+}
+
+void AnimationSystem::Update(tf::Executor* executor)
+{
+    DONUT_TRACE_ZONE("AnimationSystem::Update");
+
+    if (m_SlotsDirty)
+        UpdateSlots();
+
+    m_ActivePlaybacks.clear();
+    for (Playback& playback : m_Playbacks)
+    {
+        if (playback.weight > 0.f)
+            m_ActivePlaybacks.push_back(&playback);
+    }
+
+    if (m_ActivePlaybacks.empty())
+        return;
+
+    // Evaluate the clips. Every clip only writes its own values and cursors, so they can run in parallel.
+    auto evaluateClip = [this](size_t index)
+    {
+        Playback* playback = m_ActivePlaybacks[index];
+        playback->clip->Evaluate(playback->time);
+    };
+
+#ifdef DONUT_WITH_TASKFLOW
+    if (executor && m_ActivePlaybacks.size() > 1)
+    {
+        tf::Taskflow taskflow;
+        taskflow.for_each_index(size_t(0), m_ActivePlaybacks.size(), size_t(1), evaluateClip);
+        executor->run(taskflow).wait();
+    }
+    else
+#endif
+    {
+        for (size_t index = 0; index < m_ActivePlaybacks.size(); ++index)
+            evaluateClip(index);
+    }
+
+    // Blend the results per node, in the playback order
+    for (NodeSlot& slot : m_Slots)
+    {
+        slot.translation = 0.0;
+        slot.rotation = 0.0;
+        slot.scaling = 0.0;
+        slot.translationWeight = 0.0;
+        slot.rotationWeight = 0.0;
+        slot.scalingWeight = 0.0;
+    }
+
+    for (const Playback* playback : m_ActivePlaybacks)
+    {
+        const CompiledAnimationClip& clip = *playback->clip;
+        const auto& nodeTracks = clip.GetNodeTracks();
+        const double weight = double(playback->weight);
+
+        for (size_t track = 0; track < nodeTracks.size(); ++track)
+        {
+            const CompiledAnimationClip::NodeTrack& nodeTrack = nodeTracks[track];
+            NodeSlot& slot = m_Slots[playback->nodeSlots[track]];
+
+            if (nodeTrack.translationChannel >= 0)
+            {
+                if (auto value = clip.GetEvaluatedValue(nodeTrack.translationChannel))
+                {
+                    slot.translation += double3(value->xyz()) * weight;
+                    slot.translationWeight += weight;
+                }
+            }
+
+            if (nodeTrack.rotationChannel >= 0)
+            {
+                if (auto value = clip.GetEvaluatedValue(nodeTrack.rotationChannel))
+                {
+                    // Keep all rotations in the same hemisphere as the first one, so that q and -q don't cancel out
+                    double4 rotation = double4(*value);
+                    if (dot(slot.rotation, rotation) < 0.0)
+                        rotation = -rotation;
+
+                    slot.rotation += rotation * weight;
+                    slot.rotationWeight += weight;
+                }
+            }
+
+            if (nodeTrack.scalingChannel >= 0)
+            {
+                if (auto value = clip.GetEvaluatedValue(nodeTrack.scalingChannel))
+                {
+                    slot.scaling += double3(value->xyz()) * weight;
+                    slot.scalingWeight += weight;
+                }
+            }
+        }
+    }
+
+    m_Transforms.clear();
+    for (const NodeSlot& slot : m_Slots)
+    {
+        SceneGraphNodeTransform transform;
+        transform.node = slot.node;
+
+        if (slot.translationWeight > 0.0)
+        {
+            const double restWeight = std::max(0.0, 1.0 - slot.translationWeight);
+            transform.translation = (slot.translation + slot.restTranslation * restWeight) / (slot.translationWeight + restWeight);
+        }
+
+        if (slot.rotationWeight > 0.0)
+        {
+            const double restWeight = std::max(0.0, 1.0 - slot.rotationWeight);
+            double4 rotation = slot.rotation;
+            if (restWeight > 0.0)
+            {
+                double4 restRotation = slot.restRotation.toXYZW();
+                if (dot(rotation, restRotation) < 0.0)
+                    restRotation = -restRotation;
+                rotation += restRotation * restWeight;
+            }
+
+            double len = length(rotation);
+            if (len == 0.0)
+                log::warning("Rotation quaternion interpolated to zero, ignoring.");
+            else
+                transform.rotation = dquat::fromXYZW(rotation / len);
+        }
+
+        if (slot.scalingWeight > 0.0)
+        {
+            const double restWeight = std::max(0.0, 1.0 - slot.scalingWeight);
+            transform.scaling = (slot.scaling + slot.restScaling * restWeight) / (slot.scalingWeight + restWeight);
+        }
+
+        if (transform.translation.has_value() || transform.rotation.has_value() || transform.scaling.has_value())
+            m_Transforms.push_back(transform);
+    }
+
+    if (!m_Transforms.empty())
+        m_Graph->SetNodeTransforms(m_Transforms);
+
+    // Leaf and material properties are not blended, they are applied in the playback order
+    for (const Playback* playback : m_ActivePlaybacks)
+        playback->clip->ApplyEvaluatedProperties();
+}
@@ -0,0 +1,327 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/AsyncReadback.h>
+#include <donut/core/log.h>
+#include <donut/core/trace.h>
+#include <cassert>
+#include <cstring>
+
+using namespace donut::engine;
+
+AsyncReadback::AsyncReadback(nvrhi::IDevice* device, uint32_t framesInFlight)
+    : m_Device(device)
+{
+    m_Slots.resize(std::max(framesInFlight, 1u));
+    for (FrameSlot& slot : m_Slots)
+        slot.query = m_Device->createEventQuery();
+}
+
+AsyncReadback::~AsyncReadback()
+{
+    // Requests that were never submitted are dropped, which breaks their promises
+    Flush();
+}
+
+void AsyncReadback::BeginFrame(uint32_t frameIndex)
+{
+    DONUT_TRACE_ZONE("AsyncReadback::BeginFrame");
+
+    m_FrameIndex = frameIndex;
+
+    Poll();
+
+    // Staging resources that have not been used by any of the frames in flight are probably not needed anymore
+    const uint32_t numSlots = uint32_t(m_Slots.size());
+    m_StagingBufferCount -= ReleaseUnused(m_FreeBuffers, frameIndex, numSlots);
+    m_StagingTextureCount -= ReleaseUnused(m_FreeTextures, frameIndex, numSlots);
+
+    m_CurrentSlot = GetSlotIndex(frameIndex, numSlots);
+    FrameSlot& slot = m_Slots[m_CurrentSlot];
+
+    SlotReuse reuse = GetSlotReuse(!slot.requests.empty(), slot.submitted);
+    if (reuse == SlotReuse::Free)
+        return;
+
+    if (reuse == SlotReuse::SubmitAndWait)
+    {
+        // EndFrame was not called for the frame that used this slot, but its command lists must have been executed by now
+        m_Device->resetEventQuery(slot.query);
+        m_Device->setEventQuery(slot.query, nvrhi::CommandQueue::Graphics);
+        slot.submitted = true;
+    }
+
+    m_Device->waitEventQuery(slot.query);
+    ++m_Stalls;
+
+    CompleteSlot(slot);
+}
+
+void AsyncReadback::EndFrame(nvrhi::CommandQueue queue)
+{
+    FrameSlot& slot = m_Slots[m_CurrentSlot];
+
+    if (slot.requests.empty() || slot.submitted)
+        return;
+
+    m_Device->resetEventQuery(slot.query);
+    m_Device->setEventQuery(slot.query, queue);
+    slot.submitted = true;
+}
+
+void AsyncReadback::Poll()
+{
+    for (FrameSlot& slot : m_Slots)
+    {
+        if (slot.submitted && m_Device->pollEventQuery(slot.query))
+            CompleteSlot(slot);
+    }
+}
+
+void AsyncReadback::Flush()
+{
+    for (FrameSlot& slot : m_Slots)
+    {
+        if (!slot.submitted)
+            continue;
+
+        m_Device->waitEventQuery(slot.query);
+        CompleteSlot(slot);
+    }
+}
+
+std::future<std::vector<uint8_t>> AsyncReadback::ReadBuffer(
+    nvrhi::ICommandList* commandList,
+    nvrhi::IBuffer* buffer,
+    uint64_t offset,
+    uint64_t size,
+    BufferCallback callback)
+{
+    assert(offset + size <= buffer->getDesc().byteSize);
+
+    auto request = std::make_unique<Request>();
+    request->stagingBuffer = AcquireBuffer(size);
+    request->size = size;
+    request->bufferCallback = std::move(callback);
+
+    commandList->copyBuffer(request->stagingBuffer, 0, buffer, offset, size);
+
+    std::future<std::vector<uint8_t>> future = request->bufferPromise.get_future();
+    m_Slots[m_CurrentSlot].requests.push_back(std::move(request));
+    return future;
+}
+
+std::future<ReadbackImage> AsyncReadback::ReadTexture(
+    nvrhi::ICommandList* commandList,
+    nvrhi::ITexture* texture,
+    const nvrhi::TextureSlice& slice,
+    TextureCallback callback)
+{
+    const nvrhi::TextureDesc& textureDesc = texture->getDesc();
+    nvrhi::TextureSlice resolvedSlice = slice.resolve(textureDesc);
+
+    if (nvrhi::getFormatInfo(textureDesc.format).blockSize != 1)
+    {
+        log::warning("AsyncReadback: can't read back the block-compressed texture '%s'", textureDesc.debugName.c_str());
+
+        ReadbackImage image;
+        image.width = resolvedSlice.width;
+        image.height = resolvedSlice.height;
+        image.format = textureDesc.format;
+
+        if (callback)
+            callback(image);
+
+        std::promise<ReadbackImage> promise;
+        promise.set_value(std::move(image));
+        return promise.get_future();
+    }
+
+    nvrhi::TextureDesc stagingDesc;
+    stagingDesc.width = resolvedSlice.width;
+    stagingDesc.height = resolvedSlice.height;
+    stagingDesc.format = textureDesc.format;
+    stagingDesc.dimension = nvrhi::TextureDimension::Texture2D;
+    stagingDesc.debugName = "AsyncReadback/StagingTexture";
+
+    auto request = std::make_unique<Request>();
+    request->stagingTexture = AcquireTexture(stagingDesc);
+    request->textureCallback = std::move(callback);
+
+    commandList->copyTexture(request->stagingTexture, nvrhi::TextureSlice(), texture, resolvedSlice);
+
+    std::future<ReadbackImage> future = request->texturePromise.get_future();
+    m_Slots[m_CurrentSlot].requests.push_back(std::move(request));
+    return future;
+}
+
+AsyncReadback::SlotReuse AsyncReadback::GetSlotReuse(bool hasRequests, bool submitted)
+{
+    if (!hasRequests)
+        return SlotReuse::Free;
+
+    return submitted ? SlotReuse::Wait : SlotReuse::SubmitAndWait;
+}
+
+int AsyncReadback::FindFreeBuffer(const std::vector<FreeBuffer>& freeBuffers, uint64_t size)
+{
+    // Use the smallest free buffer that is large enough
+    int best = -1;
+    for (size_t index = 0; index < freeBuffers.size(); index++)
+    {
+        uint64_t byteSize = freeBuffers[index].buffer->getDesc().byteSize;
+        if (byteSize >= size && (best < 0 || byteSize < freeBuffers[best].buffer->getDesc().byteSize))
+            best = int(index);
+    }
+
+    return best;
+}
+
+int AsyncReadback::FindFreeTexture(const std::vector<FreeTexture>& freeTextures, const nvrhi::TextureDesc& desc)
+{
+    for (size_t index = 0; index < freeTextures.size(); index++)
+    {
+        const nvrhi::TextureDesc& freeDesc = freeTextures[index].texture->getDesc();
+        if (freeDesc.width == desc.width && freeDesc.height == desc.height && freeDesc.format == desc.format)
+            return int(index);
+    }
+
+    return -1;
+}
+
+nvrhi::BufferHandle AsyncReadback::AcquireBuffer(uint64_t size)
+{
+    int freeIndex = FindFreeBuffer(m_FreeBuffers, size);
+    if (freeIndex >= 0)
+    {
+        nvrhi::BufferHandle buffer = m_FreeBuffers[freeIndex].buffer;
+        m_FreeBuffers.erase(m_FreeBuffers.begin() + freeIndex);
+        return buffer;
+    }
+
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = size;
+    bufferDesc.cpuAccess = nvrhi::CpuAccessMode::Read;
+    bufferDesc.initialState = nvrhi::ResourceStates::CopyDest;
+    bufferDesc.keepInitialState = true;
+    bufferDesc.debugName = "AsyncReadback/StagingBuffer";
+    ++m_StagingBufferCount;
+    return m_Device->createBuffer(bufferDesc);
+}
+
+nvrhi::StagingTextureHandle AsyncReadback::AcquireTexture(const nvrhi::TextureDesc& desc)
+{
+    int freeIndex = FindFreeTexture(m_FreeTextures, desc);
+    if (freeIndex >= 0)
+    {
+        nvrhi::StagingTextureHandle texture = m_FreeTextures[freeIndex].texture;
+        m_FreeTextures.erase(m_FreeTextures.begin() + freeIndex);
+        return texture;
+    }
+
+    ++m_StagingTextureCount;
+    return m_Device->createStagingTexture(desc, nvrhi::CpuAccessMode::Read);
+}
+
+void AsyncReadback::CompleteRequest(Request& request)
+{
+    if (request.stagingBuffer)
+    {
+        std::vector<uint8_t> data;
+
+        const void* mappedData = m_Device->mapBuffer(request.stagingBuffer, nvrhi::CpuAccessMode::Read);
+        if (mappedData)
+        {
+            data.resize(size_t(request.size));
+            memcpy(data.data(), mappedData, data.size());
+            m_Device->unmapBuffer(request.stagingBuffer);
+        }
+        else
+            log::warning("AsyncReadback: failed to map a staging buffer");
+
+        m_FreeBuffers.push_back(FreeBuffer{ request.stagingBuffer, m_FrameIndex });
+
+        if (request.bufferCallback)
+            request.bufferCallback(data);
+
+        request.bufferPromise.set_value(std::move(data));
+    }
+    else if (request.stagingTexture)
+    {
+        const nvrhi::TextureDesc& desc = request.stagingTexture->getDesc();
+
+        ReadbackImage image;
+        image.width = desc.width;
+        image.height = desc.height;
+        image.format = desc.format;
+        image.rowPitch = size_t(desc.width) * nvrhi::getFormatInfo(desc.format).bytesPerBlock;
+
+        size_t mappedRowPitch = 0;
+        const uint8_t* mappedData = static_cast<const uint8_t*>(m_Device->mapStagingTexture(
+            request.stagingTexture, nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &mappedRowPitch));
+
+        if (mappedData)
+        {
+            image.data.resize(image.rowPitch * image.height);
+            for (uint32_t row = 0; row < image.height; row++)
+                memcpy(image.data.data() + row * image.rowPitch, mappedData + row * mappedRowPitch, image.rowPitch);
+
+            m_Device->unmapStagingTexture(request.stagingTexture);
+        }
+        else
+            log::warning("AsyncReadback: failed to map a staging texture");
+
+        m_FreeTextures.push_back(FreeTexture{ request.stagingTexture, m_FrameIndex });
+
+        if (request.textureCallback)
+            request.textureCallback(image);
+
+        request.texturePromise.set_value(std::move(image));
+    }
+
+    ++m_CompletedRequests;
+}
+
+void AsyncReadback::CompleteSlot(FrameSlot& slot)
+{
+    DONUT_TRACE_ZONE("AsyncReadback::CompleteSlot");
+
+    // Move the requests out first, the callbacks may record new ones
+    std::vector<std::unique_ptr<Request>> requests = std::move(slot.requests);
+    slot.requests.clear();
+    slot.submitted = false;
+
+    for (const auto& request : requests)
+        CompleteRequest(*request);
+}
+
+AsyncReadbackStats AsyncReadback::GetStats() const
+{
+    AsyncReadbackStats stats;
+    for (const FrameSlot& slot : m_Slots)
+        stats.pendingRequests += uint32_t(slot.requests.size());
+    stats.completedRequests = m_CompletedRequests;
+    stats.stalls = m_Stalls;
+    stats.stagingBuffers = m_StagingBufferCount;
+    stats.stagingTextures = m_StagingTextureCount;
+    return stats;
+}
@@ -0,0 +1,1151 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/BakedScene.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/SceneTypes.h>
+#include <donut/engine/TextureCache.h>
+#include <donut/core/chunk/chunkFile.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/core/log.h>
+#include <donut/core/trace.h>
+#include <nvrhi/common/misc.h>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <type_traits>
+#include <unordered_map>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+using namespace donut::math;
+using namespace donut::vfs;
+using namespace donut::chunk;
+using namespace donut::engine;
+
+namespace
+{
+    // The chunk types are outside of the range used by the mesh set files, see chunkDescs.h
+    enum BakedChunkType : uint32_t
+    {
+        CHUNKTYPE_BAKED_STRINGS = 0x1000,
+        CHUNKTYPE_BAKED_TEXTURES,
+        CHUNKTYPE_BAKED_MATERIALS,
+        CHUNKTYPE_BAKED_BUFFER_GROUP,
+        CHUNKTYPE_BAKED_MESHES,
+        CHUNKTYPE_BAKED_GEOMETRIES,
+        CHUNKTYPE_BAKED_NODES,
+        CHUNKTYPE_BAKED_ANIMATIONS,
+        CHUNKTYPE_BAKED_CHANNELS,
+        CHUNKTYPE_BAKED_KEYFRAMES,
+    };
+
+    // ChunkFile only aligns the chunk data to 4 bytes, so the records consist of 32-bit fields and are read
+    // in place, except for the nodes which contain doubles and are copied out first.
+    // References to strings and other records are indices, c_Invalid means none.
+    constexpr uint32_t c_Invalid = ~0u;
+
+    // A chunk that contains a count followed by an array of records.
+    template<BakedChunkType Type, uint32_t Version = 0x100>
+    struct ArrayChunkDesc
+    {
+        static constexpr uint32_t const version = Version;
+        static constexpr BakedChunkType const chunktype = Type;
+
+        uint32_t count;
+
+        // records start here
+    };
+
+    struct BakedTexture
+    {
+        uint32_t path; // relative to the baked file
+        uint32_t sRGB;
+    };
+
+    enum BakedTextureSlot : uint32_t
+    {
+        BakedTexture_BaseOrDiffuse,
+        BakedTexture_MetalRoughOrSpecular,
+        BakedTexture_Normal,
+        BakedTexture_Emissive,
+        BakedTexture_Occlusion,
+        BakedTexture_Transmission,
+        BakedTexture_Opacity,
+
+        BakedTexture_Count
+    };
+
+    enum BakedMaterialFlags : uint32_t
+    {
+        BakedMaterial_UseSpecularGloss     = 0x01,
+        BakedMaterial_DoubleSided          = 0x02,
+        BakedMaterial_MetalnessInRedChannel = 0x04,
+        BakedMaterial_SubsurfaceScattering = 0x08,
+        BakedMaterial_Hair                 = 0x10
+    };
+
+    struct BakedMaterial
+    {
+        uint32_t name;
+        uint32_t domain;
+        uint32_t flags;
+        uint32_t enabledTextures; // bit mask of BakedTextureSlot
+        uint32_t textures[BakedTexture_Count];
+        float3 baseOrDiffuseColor;
+        float3 specularColor;
+        float3 emissiveColor;
+        float emissiveIntensity;
+        float metalness;
+        float roughness;
+        float opacity;
+        float alphaCutoff;
+        float transmissionFactor;
+        float normalTextureScale;
+        float occlusionStrength;
+        float2 normalTextureTransformScale;
+        Material::SubsurfaceParams subsurface;
+        Material::HairParams hair;
+    };
+
+    struct BakedBufferRange
+    {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    // Index data followed by the vertex buffer image, in the layout produced by Scene::CreateMeshBuffers
+    struct BakedBufferGroupDesc
+    {
+        static constexpr uint32_t const version = 0x100;
+        static constexpr BakedChunkType const chunktype = CHUNKTYPE_BAKED_BUFFER_GROUP;
+
+        uint32_t indexCount;
+        uint32_t indexDataOffset;  // relative to the chunk data
+        uint32_t vertexDataOffset; // relative to the chunk data
+        uint32_t vertexDataSize;
+        BakedBufferRange ranges[size_t(VertexAttribute::Count)]; // relative to the vertex data
+
+        // data starts here
+    };
+
+    struct BakedMesh
+    {
+        uint32_t name;
+        uint32_t bufferGroup;
+        uint32_t type;
+        uint32_t indexOffset;
+        uint32_t vertexOffset;
+        uint32_t totalIndices;
+        uint32_t totalVertices;
+        uint32_t firstGeometry;
+        uint32_t numGeometries;
+        box3 objectSpaceBounds;
+    };
+
+    struct BakedGeometry
+    {
+        uint32_t material;
+        uint32_t type;
+        uint32_t indexOffsetInMesh;
+        uint32_t vertexOffsetInMesh;
+        uint32_t numIndices;
+        uint32_t numVertices;
+        box3 objectSpaceBounds;
+    };
+
+    enum class BakedLeafType : uint32_t
+    {
+        None,
+        MeshInstance,
+        PerspectiveCamera,
+        OrthographicCamera,
+        DirectionalLight,
+        PointLight,
+        SpotLight,
+        Animation
+    };
+
+    enum BakedLeafFlags : uint32_t
+    {
+        BakedLeaf_HasZFar        = 0x01,
+        BakedLeaf_HasAspectRatio = 0x02
+    };
+
+    // Nodes are stored in depth-first order, so that parents always precede their children.
+    // The transforms are stored in double precision, like SceneGraphNode keeps them.
+    struct BakedNode
+    {
+        uint32_t name;
+        uint32_t parent;
+        BakedLeafType leafType;
+        uint32_t leafIndex; // mesh or animation index
+        uint32_t leafFlags;
+        float3 color;
+
+        // Cameras:      zNear, verticalFov or zFar, zFar or xMag, aspectRatio or yMag
+        // Lights:       irradiance or intensity, angularSize or radius, range, innerAngle, outerAngle
+        float params[5];
+        uint32_t padding; // keeps the doubles 8-byte aligned within the record
+
+        double3 translation;
+        double4 rotation; // xyzw
+        double3 scaling;
+    };
+
+    struct BakedAnimation
+    {
+        uint32_t firstChannel;
+        uint32_t numChannels;
+    };
+
+    struct BakedChannel
+    {
+        uint32_t node;
+        uint32_t attribute;
+        uint32_t mode;
+        uint32_t firstKeyframe;
+        uint32_t numKeyframes;
+    };
+
+    typedef ArrayChunkDesc<CHUNKTYPE_BAKED_STRINGS> StringsDesc;
+    typedef ArrayChunkDesc<CHUNKTYPE_BAKED_TEXTURES> TexturesDesc;
+    typedef ArrayChunkDesc<CHUNKTYPE_BAKED_MATERIALS> MaterialsDesc;
+    typedef ArrayChunkDesc<CHUNKTYPE_BAKED_MESHES> MeshesDesc;
+    typedef ArrayChunkDesc<CHUNKTYPE_BAKED_GEOMETRIES> GeometriesDesc;
+    typedef ArrayChunkDesc<CHUNKTYPE_BAKED_NODES, 0x101> NodesDesc;
+    typedef ArrayChunkDesc<CHUNKTYPE_BAKED_ANIMATIONS> AnimationsDesc;
+    typedef ArrayChunkDesc<CHUNKTYPE_BAKED_CHANNELS> ChannelsDesc;
+    typedef ArrayChunkDesc<CHUNKTYPE_BAKED_KEYFRAMES> KeyframesDesc;
+
+    static_assert(std::is_trivially_copyable_v<BakedMaterial> && sizeof(BakedMaterial) % 4 == 0);
+    static_assert(std::is_trivially_copyable_v<BakedNode> && sizeof(BakedNode) % 8 == 0 && offsetof(BakedNode, translation) % 8 == 0);
+    static_assert(std::is_trivially_copyable_v<animation::Keyframe> && sizeof(animation::Keyframe) % 4 == 0);
+    static_assert(sizeof(BakedBufferGroupDesc) % 4 == 0);
+
+    class BakedSceneWriter
+    {
+    public:
+        ChunkFile cfile;
+
+        uint32_t CacheString(const std::string& str)
+        {
+            auto it = m_StringIndices.find(str);
+            if (it != m_StringIndices.end())
+                return it->second;
+
+            uint32_t index = uint32_t(m_Strings.size());
+            m_StringIndices[str] = index;
+            m_Strings.push_back(str);
+            return index;
+        }
+
+        // Returns zero-initialized chunk storage that lives until the file is serialized
+        uint8_t* AllocateChunk(size_t size)
+        {
+            return m_ChunkData.emplace_back(nvrhi::align(size, size_t(4)), uint8_t(0)).data();
+        }
+
+        template<typename Desc, typename Record>
+        void AddArrayChunk(const std::vector<Record>& records)
+        {
+            static_assert(sizeof(Record) % 4 == 0);
+
+            const size_t size = sizeof(Desc) + records.size() * sizeof(Record);
+            uint8_t* data = AllocateChunk(size);
+            reinterpret_cast<Desc*>(data)->count = uint32_t(records.size());
+            if (!records.empty())
+                memcpy(data + sizeof(Desc), records.data(), records.size() * sizeof(Record));
+
+            cfile.addChunk<Desc>(data, nvrhi::align(size, size_t(4)));
+        }
+
+        void AddStringsChunk()
+        {
+            size_t size = sizeof(StringsDesc) + m_Strings.size() * sizeof(uint32_t);
+            const size_t stringsOffset = size;
+            for (const std::string& str : m_Strings)
+                size += str.size() + 1;
+
+            uint8_t* data = AllocateChunk(size);
+            reinterpret_cast<StringsDesc*>(data)->count = uint32_t(m_Strings.size());
+
+            uint32_t* offsets = reinterpret_cast<uint32_t*>(data + sizeof(StringsDesc));
+            size_t offset = stringsOffset;
+            for (size_t i = 0; i < m_Strings.size(); ++i)
+            {
+                offsets[i] = uint32_t(offset);
+                memcpy(data + offset, m_Strings[i].c_str(), m_Strings[i].size() + 1);
+                offset += m_Strings[i].size() + 1;
+            }
+
+            cfile.addChunk<StringsDesc>(data, nvrhi::align(size, size_t(4)));
+        }
+
+    private:
+        std::unordered_map<std::string, uint32_t> m_StringIndices;
+        std::vector<std::string> m_Strings;
+        std::deque<std::vector<uint8_t>> m_ChunkData;
+    };
+
+    template<typename T>
+    void AppendVertexStream(std::vector<uint8_t>& vertexData, BakedBufferRange& range, const std::vector<T>& stream)
+    {
+        if (stream.empty())
+            return;
+
+        // Same alignment as Scene::CreateMeshBuffers, the padding is uploaded with the range
+        const size_t size = stream.size() * sizeof(T);
+        range.offset = uint32_t(vertexData.size());
+        range.size = uint32_t(nvrhi::align(size, size_t(16)));
+        vertexData.resize(vertexData.size() + range.size, 0);
+        memcpy(vertexData.data() + range.offset, stream.data(), size);
+    }
+}
+
+bool donut::engine::IsBakedSceneFile(const std::filesystem::path& fileName)
+{
+    return fileName.extension() == c_BakedSceneExtension;
+}
+
+bool donut::engine::BakeScene(
+    IFileSystem& fs,
+    const std::filesystem::path& fileName,
+    const SceneImportResult& model)
+{
+    if (!model.rootNode)
+    {
+        log::error("Cannot bake scene '%s': the model is empty.", fileName.generic_string().c_str());
+        return false;
+    }
+
+    BakedSceneWriter writer;
+    const std::filesystem::path basePath = fileName.parent_path();
+
+    std::vector<BakedTexture> textures;
+    std::vector<BakedMaterial> materials;
+    std::vector<BakedMesh> meshes;
+    std::vector<BakedGeometry> geometries;
+    std::vector<BakedNode> nodes;
+    std::vector<BakedAnimation> animations;
+    std::vector<BakedChannel> channels;
+    std::vector<animation::Keyframe> keyframes;
+
+    std::unordered_map<const LoadedTexture*, uint32_t> textureIndices;
+    std::unordered_map<const Material*, uint32_t> materialIndices;
+    std::unordered_map<const BufferGroup*, uint32_t> bufferGroupIndices;
+    std::unordered_map<const MeshInfo*, uint32_t> meshIndices;
+    std::unordered_map<const SceneGraphNode*, uint32_t> nodeIndices;
+    std::vector<std::shared_ptr<SceneGraphAnimation>> animationLeaves;
+    bool incompleteBufferGroups = false;
+    bool unsupportedLeaves = false;
+    bool skinnedMeshes = false;
+
+    auto addTexture = [&](const std::shared_ptr<LoadedTexture>& texture, bool sRGB)
+    {
+        if (!texture)
+            return c_Invalid;
+
+        auto it = textureIndices.find(texture.get());
+        if (it != textureIndices.end())
+            return it->second;
+
+        uint32_t index = c_Invalid;
+        if (!texture->path.empty())
+        {
+            std::filesystem::path path = std::filesystem::path(texture->path).lexically_relative(basePath);
+            if (path.empty())
+                path = texture->path;
+
+            index = uint32_t(textures.size());
+            textures.push_back({ writer.CacheString(path.generic_string()), sRGB ? 1u : 0u });
+        }
+        else
+        {
+            log::warning("Textures embedded in the model cannot be referenced from a baked scene, ignoring one.");
+        }
+
+        textureIndices[texture.get()] = index;
+        return index;
+    };
+
+    auto addMaterial = [&](const std::shared_ptr<Material>& material)
+    {
+        if (!material)
+            return c_Invalid;
+
+        auto it = materialIndices.find(material.get());
+        if (it != materialIndices.end())
+            return it->second;
+
+        BakedMaterial dst{};
+        dst.name = writer.CacheString(material->name);
+        dst.domain = uint32_t(material->domain);
+        dst.flags = (material->useSpecularGlossModel ? BakedMaterial_UseSpecularGloss : 0)
+            | (material->doubleSided ? BakedMaterial_DoubleSided : 0)
+            | (material->metalnessInRedChannel ? BakedMaterial_MetalnessInRedChannel : 0)
+            | (material->enableSubsurfaceScattering ? BakedMaterial_SubsurfaceScattering : 0)
+            | (material->enableHair ? BakedMaterial_Hair : 0);
+
+        // Same color spaces as the glTF importer uses
+        const bool specularIsColor = material->useSpecularGlossModel;
+        dst.textures[BakedTexture_BaseOrDiffuse] = addTexture(material->baseOrDiffuseTexture, true);
+        dst.textures[BakedTexture_MetalRoughOrSpecular] = addTexture(material->metalRoughOrSpecularTexture, specularIsColor);
+        dst.textures[BakedTexture_Normal] = addTexture(material->normalTexture, false);
+        dst.textures[BakedTexture_Emissive] = addTexture(material->emissiveTexture, true);
+        dst.textures[BakedTexture_Occlusion] = addTexture(material->occlusionTexture, false);
+        dst.textures[BakedTexture_Transmission] = addTexture(material->transmissionTexture, false);
+        dst.textures[BakedTexture_Opacity] = addTexture(material->opacityTexture, false);
+
+        const bool enabled[BakedTexture_Count] = {
+            material->enableBaseOrDiffuseTexture,
+            material->enableMetalRoughOrSpecularTexture,
+            material->enableNormalTexture,
+            material->enableEmissiveTexture,
+            material->enableOcclusionTexture,
+            material->enableTransmissionTexture,
+            material->enableOpacityTexture
+        };
+        for (uint32_t slot = 0; slot < BakedTexture_Count; ++slot)
+            dst.enabledTextures |= enabled[slot] ? (1u << slot) : 0u;
+
+        dst.baseOrDiffuseColor = material->baseOrDiffuseColor;
+        dst.specularColor = material->specularColor;
+        dst.emissiveColor = material->emissiveColor;
+        dst.emissiveIntensity = material->emissiveIntensity;
+        dst.metalness = material->metalness;
+        dst.roughness = material->roughness;
+        dst.opacity = material->opacity;
+        dst.alphaCutoff = material->alphaCutoff;
+        dst.transmissionFactor = material->transmissionFactor;
+        dst.normalTextureScale = material->normalTextureScale;
+        dst.occlusionStrength = material->occlusionStrength;
+        dst.normalTextureTransformScale = material->normalTextureTransformScale;
+        dst.subsurface = material->subsurface;
+        dst.hair = material->hair;
+
+        uint32_t index = uint32_t(materials.size());
+        materials.push_back(dst);
+        materialIndices[material.get()] = index;
+        return index;
+    };
+
+    auto addBufferGroup = [&](const std::shared_ptr<BufferGroup>& buffers)
+    {
+        auto it = bufferGroupIndices.find(buffers.get());
+        if (it != bufferGroupIndices.end())
+            return it->second;
+
+        if (buffers->indexData.empty() && buffers->indexBuffer || buffers->positionData.empty() && buffers->vertexBuffer)
+            incompleteBufferGroups = true;
+
+        BakedBufferGroupDesc desc{};
+
+        // Same order of attributes as in Scene::CreateMeshBuffers
+        std::vector<uint8_t> vertexData;
+        AppendVertexStream(vertexData, desc.ranges[size_t(VertexAttribute::Position)], buffers->positionData);
+        AppendVertexStream(vertexData, desc.ranges[size_t(VertexAttribute::Normal)], buffers->normalData);
+        AppendVertexStream(vertexData, desc.ranges[size_t(VertexAttribute::Tangent)], buffers->tangentData);
+        AppendVertexStream(vertexData, desc.ranges[size_t(VertexAttribute::TexCoord1)], buffers->texcoord1Data);
+        AppendVertexStream(vertexData, desc.ranges[size_t(VertexAttribute::TexCoord2)], buffers->texcoord2Data);
+        AppendVertexStream(vertexData, desc.ranges[size_t(VertexAttribute::JointWeights)], buffers->weightData);
+        AppendVertexStream(vertexData, desc.ranges[size_t(VertexAttribute::JointIndices)], buffers->jointData);
+        AppendVertexStream(vertexData, desc.ranges[size_t(VertexAttribute::CurveRadius)], buffers->radiusData);
+
+        const size_t indexDataSize = buffers->indexData.size() * sizeof(uint32_t);
+        desc.indexCount = uint32_t(buffers->indexData.size());
+        desc.indexDataOffset = uint32_t(sizeof(BakedBufferGroupDesc));
+        desc.vertexDataOffset = uint32_t(sizeof(BakedBufferGroupDesc) + indexDataSize);
+        desc.vertexDataSize = uint32_t(vertexData.size());
+
+        const size_t chunkSize = desc.vertexDataOffset + vertexData.size();
+        uint8_t* chunkData = writer.AllocateChunk(chunkSize);
+        memcpy(chunkData, &desc, sizeof(desc));
+        if (indexDataSize)
+            memcpy(chunkData + desc.indexDataOffset, buffers->indexData.data(), indexDataSize);
+        if (!vertexData.empty())
+            memcpy(chunkData + desc.vertexDataOffset, vertexData.data(), vertexData.size());
+
+        writer.cfile.addChunk<BakedBufferGroupDesc>(chunkData, nvrhi::align(chunkSize, size_t(4)));
+
+        uint32_t index = uint32_t(bufferGroupIndices.size());
+        bufferGroupIndices[buffers.get()] = index;
+        return index;
+    };
+
+    auto addMesh = [&](const std::shared_ptr<MeshInfo>& mesh)
+    {
+        if (!mesh || !mesh->buffers)
+            return c_Invalid;
+
+        auto it = meshIndices.find(mesh.get());
+        if (it != meshIndices.end())
+            return it->second;
+
+        BakedMesh dst{};
+        dst.name = writer.CacheString(mesh->name);
+        dst.bufferGroup = addBufferGroup(mesh->buffers);
+        dst.type = uint32_t(mesh->type);
+        dst.indexOffset = mesh->indexOffset;
+        dst.vertexOffset = mesh->vertexOffset;
+        dst.totalIndices = mesh->totalIndices;
+        dst.totalVertices = mesh->totalVertices;
+        dst.firstGeometry = uint32_t(geometries.size());
+        dst.numGeometries = uint32_t(mesh->geometries.size());
+        dst.objectSpaceBounds = mesh->objectSpaceBounds;
+
+        for (const auto& geometry : mesh->geometries)
+        {
+            BakedGeometry& dstGeometry = geometries.emplace_back();
+            dstGeometry.material = addMaterial(geometry->material);
+            dstGeometry.type = uint32_t(geometry->type);
+            dstGeometry.indexOffsetInMesh = geometry->indexOffsetInMesh;
+            dstGeometry.vertexOffsetInMesh = geometry->vertexOffsetInMesh;
+            dstGeometry.numIndices = geometry->numIndices;
+            dstGeometry.numVertices = geometry->numVertices;
+            dstGeometry.objectSpaceBounds = geometry->objectSpaceBounds;
+        }
+
+        uint32_t index = uint32_t(meshes.size());
+        meshes.push_back(dst);
+        meshIndices[mesh.get()] = index;
+        return index;
+    };
+
+    SceneGraphWalker walker(model.rootNode.get());
+    while (walker)
+    {
+        BakedNode dst{};
+        dst.name = writer.CacheString(walker->GetName());
+        auto parent = walker->GetParent() ? nodeIndices.find(walker->GetParent()) : nodeIndices.end();
+        dst.parent = parent != nodeIndices.end() ? parent->second : c_Invalid;
+        dst.leafType = BakedLeafType::None;
+        dst.leafIndex = c_Invalid;
+        dst.translation = walker->GetTranslation();
+        const dquat& rotation = walker->GetRotation();
+        dst.rotation = double4(rotation.x, rotation.y, rotation.z, rotation.w);
+        dst.scaling = walker->GetScaling();
+
+        const auto& leaf = walker->GetLeaf();
+        if (auto skinnedInstance = std::dynamic_pointer_cast<SkinnedMeshInstance>(leaf))
+        {
+            dst.leafType = BakedLeafType::MeshInstance;
+            dst.leafIndex = addMesh(skinnedInstance->GetPrototypeMesh());
+            skinnedMeshes = true;
+        }
+        else if (auto meshInstance = std::dynamic_pointer_cast<MeshInstance>(leaf))
+        {
+            dst.leafType = BakedLeafType::MeshInstance;
+            dst.leafIndex = addMesh(meshInstance->GetMesh());
+        }
+        else if (auto perspectiveCamera = std::dynamic_pointer_cast<PerspectiveCamera>(leaf))
+        {
+            dst.leafType = BakedLeafType::PerspectiveCamera;
+            dst.params[0] = perspectiveCamera->zNear;
+            dst.params[1] = perspectiveCamera->verticalFov;
+            dst.params[2] = perspectiveCamera->zFar.value_or(0.f);
+            dst.params[3] = perspectiveCamera->aspectRatio.value_or(0.f);
+            dst.leafFlags = (perspectiveCamera->zFar.has_value() ? BakedLeaf_HasZFar : 0)
+                | (perspectiveCamera->aspectRatio.has_value() ? BakedLeaf_HasAspectRatio : 0);
+        }
+        else if (auto orthographicCamera = std::dynamic_pointer_cast<OrthographicCamera>(leaf))
+        {
+            dst.leafType = BakedLeafType::OrthographicCamera;
+            dst.params[0] = orthographicCamera->zNear;
+            dst.params[1] = orthographicCamera->zFar;
+            dst.params[2] = orthographicCamera->xMag;
+            dst.params[3] = orthographicCamera->yMag;
+        }
+        else if (auto directionalLight = std::dynamic_pointer_cast<DirectionalLight>(leaf))
+        {
+            dst.leafType = BakedLeafType::DirectionalLight;
+            dst.color = directionalLight->color;
+            dst.params[0] = directionalLight->irradiance;
+            dst.params[1] = directionalLight->angularSize;
+        }
+        else if (auto pointLight = std::dynamic_pointer_cast<PointLight>(leaf))
+        {
+            dst.leafType = BakedLeafType::PointLight;
+            dst.color = pointLight->color;
+            dst.params[0] = pointLight->intensity;
+            dst.params[1] = pointLight->radius;
+            dst.params[2] = pointLight->range;
+        }
+        else if (auto spotLight = std::dynamic_pointer_cast<SpotLight>(leaf))
+        {
+            dst.leafType = BakedLeafType::SpotLight;
+            dst.color = spotLight->color;
+            dst.params[0] = spotLight->intensity;
+            dst.params[1] = spotLight->radius;
+            dst.params[2] = spotLight->range;
+            dst.params[3] = spotLight->innerAngle;
+            dst.params[4] = spotLight->outerAngle;
+        }
+        else if (auto animation = std::dynamic_pointer_cast<SceneGraphAnimation>(leaf))
+        {
+            dst.leafType = BakedLeafType::Animation;
+            dst.leafIndex = uint32_t(animationLeaves.size());
+            animationLeaves.push_back(animation);
+        }
+        else if (leaf && !std::dynamic_pointer_cast<SkinnedMeshReference>(leaf))
+        {
+            unsupportedLeaves = true;
+        }
+
+        nodeIndices[walker.Get()] = uint32_t(nodes.size());
+        nodes.push_back(dst);
+
+        walker.Next(true);
+    }
+
+    for (const auto& animation : animationLeaves)
+    {
+        BakedAnimation& dst = animations.emplace_back();
+        dst.firstChannel = uint32_t(channels.size());
+
+        for (const auto& channel : animation->GetChannels())
+        {
+            auto targetNode = channel->GetTargetNode();
+            auto target = targetNode ? nodeIndices.find(targetNode.get()) : nodeIndices.end();
+            if (target == nodeIndices.end() || channel->GetAttribute() == AnimationAttribute::LeafProperty)
+            {
+                log::warning("Animation '%s' has a channel that doesn't target a node in the baked scene, ignoring.",
+                    animation->GetName().c_str());
+                continue;
+            }
+
+            const auto& sampler = channel->GetSampler();
+            const std::vector<animation::Keyframe> samplerKeyframes = sampler->CopyKeyframes();
+
+            BakedChannel& dstChannel = channels.emplace_back();
+            dstChannel.node = target->second;
+            dstChannel.attribute = uint32_t(channel->GetAttribute());
+            dstChannel.mode = uint32_t(sampler->GetMode());
+            dstChannel.firstKeyframe = uint32_t(keyframes.size());
+            dstChannel.numKeyframes = uint32_t(samplerKeyframes.size());
+            keyframes.insert(keyframes.end(), samplerKeyframes.begin(), samplerKeyframes.end());
+        }
+
+        dst.numChannels = uint32_t(channels.size()) - dst.firstChannel;
+    }
+
+    // The loader rejects meshes that reference more indices or vertices than their buffer group contains
+    if (incompleteBufferGroups)
+    {
+        log::error("Cannot bake scene '%s': some meshes have already been uploaded to the GPU. "
+            "Bake the scene right after importing it.", fileName.generic_string().c_str());
+        return false;
+    }
+
+    if (skinnedMeshes)
+        log::warning("Skinned meshes in '%s' are baked as static meshes in their bind pose.", fileName.generic_string().c_str());
+
+    if (unsupportedLeaves)
+        log::warning("Some nodes in '%s' have leaf types that cannot be baked, ignoring them.", fileName.generic_string().c_str());
+
+    writer.AddArrayChunk<TexturesDesc>(textures);
+    writer.AddArrayChunk<MaterialsDesc>(materials);
+    writer.AddArrayChunk<MeshesDesc>(meshes);
+    writer.AddArrayChunk<GeometriesDesc>(geometries);
+    writer.AddArrayChunk<NodesDesc>(nodes);
+    writer.AddArrayChunk<AnimationsDesc>(animations);
+    writer.AddArrayChunk<ChannelsDesc>(channels);
+    writer.AddArrayChunk<KeyframesDesc>(keyframes);
+    writer.AddStringsChunk();
+
+    auto blob = writer.cfile.serialize();
+    if (!blob)
+        return false;
+
+    if (!fs.writeFile(fileName, blob->data(), blob->size()))
+    {
+        log::error("Couldn't write file '%s'", fileName.generic_string().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+BakedSceneLoader::BakedSceneLoader(std::shared_ptr<IFileSystem> fs, std::shared_ptr<SceneTypeFactory> sceneTypeFactory)
+    : m_fs(std::move(fs))
+    , m_SceneTypeFactory(std::move(sceneTypeFactory))
+{
+}
+
+namespace
+{
+    // Finds the only chunk of an array type and returns its records, or nullptr when it's missing or invalid
+    template<typename Desc, typename Record>
+    const Record* GetArrayChunk(const ChunkFile& cfile, uint32_t& count)
+    {
+        count = 0;
+
+        std::vector<const Chunk*> chunks;
+        cfile.getChunks(Desc::chunktype, chunks);
+        if (chunks.size() != 1 || !cfile.validateChunk<Desc>(chunks[0]))
+            return nullptr;
+
+        const Chunk* chunk = chunks[0];
+        const Desc& desc = *static_cast<const Desc*>(chunk->data);
+        if (chunk->size < sizeof(Desc) + size_t(desc.count) * sizeof(Record))
+        {
+            donut::log::error("Baked scene '%s': chunk type 0x%x is too small", cfile.getFilePath().c_str(), chunk->chunkType);
+            return nullptr;
+        }
+
+        count = desc.count;
+        return reinterpret_cast<const Record*>(static_cast<const uint8_t*>(chunk->data) + sizeof(Desc));
+    }
+
+    // The factory may be customized to create other leaf types, such lights are dropped
+    template<typename Light>
+    std::shared_ptr<Light> CreateLight(SceneTypeFactory& factory, const char* type, const std::string& fileName)
+    {
+        auto light = std::dynamic_pointer_cast<Light>(factory.CreateLeaf(type));
+        if (!light)
+            donut::log::warning("Baked scene '%s': the scene type factory didn't create a %s, ignoring it", fileName.c_str(), type);
+        return light;
+    }
+}
+
+bool BakedSceneLoader::Load(
+    const std::filesystem::path& fileName,
+    TextureCache& textureCache,
+    SceneLoadingStats& stats,
+    tf::Executor* executor,
+    SceneImportResult& result) const
+{
+    DONUT_TRACE_FUNCTION();
+
+    result.rootNode.reset();
+
+    const std::string normalizedFileName = fileName.lexically_normal().generic_string();
+
+    std::shared_ptr<IBlob> blob = m_fs->mapFile(fileName);
+    if (!blob)
+    {
+        log::error("Couldn't read file '%s'", normalizedFileName.c_str());
+        return false;
+    }
+
+    std::shared_ptr<const ChunkFile> cfile = ChunkFile::deserialize(blob, normalizedFileName.c_str());
+    if (!cfile)
+        return false;
+
+    // Strings
+
+    std::vector<const char*> strings;
+    {
+        std::vector<const Chunk*> chunks;
+        cfile->getChunks(StringsDesc::chunktype, chunks);
+        if (chunks.size() != 1 || !cfile->validateChunk<StringsDesc>(chunks[0]))
+        {
+            log::error("Baked scene '%s' has no valid strings table", normalizedFileName.c_str());
+            return false;
+        }
+
+        const Chunk* chunk = chunks[0];
+        const uint8_t* data = static_cast<const uint8_t*>(chunk->data);
+        const uint32_t count = reinterpret_cast<const StringsDesc*>(data)->count;
+        if (chunk->size < sizeof(StringsDesc) + size_t(count) * sizeof(uint32_t))
+        {
+            log::error("Baked scene '%s' has an invalid strings table", normalizedFileName.c_str());
+            return false;
+        }
+
+        const uint32_t* offsets = reinterpret_cast<const uint32_t*>(data + sizeof(StringsDesc));
+        strings.resize(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (offsets[i] >= chunk->size || !memchr(data + offsets[i], 0, chunk->size - offsets[i]))
+            {
+                log::error("Baked scene '%s' has an invalid strings table", normalizedFileName.c_str());
+                return false;
+            }
+            strings[i] = reinterpret_cast<const char*>(data + offsets[i]);
+        }
+    }
+
+    auto getString = [&strings](uint32_t index)
+    {
+        return index < strings.size() ? std::string(strings[index]) : std::string();
+    };
+
+    uint32_t numTextures, numMaterials, numMeshes, numGeometries, numNodes, numAnimations, numChannels, numKeyframes;
+    const BakedTexture* srcTextures = GetArrayChunk<TexturesDesc, BakedTexture>(*cfile, numTextures);
+    const BakedMaterial* srcMaterials = GetArrayChunk<MaterialsDesc, BakedMaterial>(*cfile, numMaterials);
+    const BakedMesh* srcMeshes = GetArrayChunk<MeshesDesc, BakedMesh>(*cfile, numMeshes);
+    const BakedGeometry* srcGeometries = GetArrayChunk<GeometriesDesc, BakedGeometry>(*cfile, numGeometries);
+    const BakedNode* srcNodes = GetArrayChunk<NodesDesc, BakedNode>(*cfile, numNodes);
+    const BakedAnimation* srcAnimations = GetArrayChunk<AnimationsDesc, BakedAnimation>(*cfile, numAnimations);
+    const BakedChannel* srcChannels = GetArrayChunk<ChannelsDesc, BakedChannel>(*cfile, numChannels);
+    const animation::Keyframe* srcKeyframes = GetArrayChunk<KeyframesDesc, animation::Keyframe>(*cfile, numKeyframes);
+
+    if (!srcTextures || !srcMaterials || !srcMeshes || !srcGeometries || !srcNodes || !srcAnimations || !srcChannels || !srcKeyframes || numNodes == 0)
+    {
+        log::error("Baked scene '%s' is incomplete", normalizedFileName.c_str());
+        return false;
+    }
+
+    // Textures
+
+    std::vector<std::shared_ptr<LoadedTexture>> textures(numTextures);
+    const std::filesystem::path basePath = fileName.parent_path();
+    auto getTexture = [&](uint32_t index) -> std::shared_ptr<LoadedTexture>
+    {
+        if (index >= numTextures)
+            return nullptr;
+
+        if (!textures[index])
+        {
+            const BakedTexture& src = srcTextures[index];
+            const std::filesystem::path path = basePath / getString(src.path);
+
+#ifdef DONUT_WITH_TASKFLOW
+            if (executor)
+                textures[index] = textureCache.LoadTextureFromFileAsync(path, src.sRGB != 0, *executor);
+            else
+#endif
+                textures[index] = textureCache.LoadTextureFromFileDeferred(path, src.sRGB != 0);
+        }
+
+        return textures[index];
+    };
+
+    // Materials
+
+    std::vector<std::shared_ptr<Material>> materials(numMaterials);
+    for (uint32_t index = 0; index < numMaterials; ++index)
+    {
+        const BakedMaterial& src = srcMaterials[index];
+        std::shared_ptr<Material> dst = m_SceneTypeFactory->CreateMaterial();
+
+        dst->name = getString(src.name);
+        dst->modelFileName = normalizedFileName;
+        dst->materialIndexInModel = int(index);
+        dst->domain = src.domain < uint32_t(MaterialDomain::Count) ? MaterialDomain(src.domain) : MaterialDomain::Opaque;
+        dst->baseOrDiffuseTexture = getTexture(src.textures[BakedTexture_BaseOrDiffuse]);
+        dst->metalRoughOrSpecularTexture = getTexture(src.textures[BakedTexture_MetalRoughOrSpecular]);
+        dst->normalTexture = getTexture(src.textures[BakedTexture_Normal]);
+        dst->emissiveTexture = getTexture(src.textures[BakedTexture_Emissive]);
+        dst->occlusionTexture = getTexture(src.textures[BakedTexture_Occlusion]);
+        dst->transmissionTexture = getTexture(src.textures[BakedTexture_Transmission]);
+        dst->opacityTexture = getTexture(src.textures[BakedTexture_Opacity]);
+        dst->enableBaseOrDiffuseTexture = (src.enabledTextures & (1u << BakedTexture_BaseOrDiffuse)) != 0;
+        dst->enableMetalRoughOrSpecularTexture = (src.enabledTextures & (1u << BakedTexture_MetalRoughOrSpecular)) != 0;
+        dst->enableNormalTexture = (src.enabledTextures & (1u << BakedTexture_Normal)) != 0;
+        dst->enableEmissiveTexture = (src.enabledTextures & (1u << BakedTexture_Emissive)) != 0;
+        dst->enableOcclusionTexture = (src.enabledTextures & (1u << BakedTexture_Occlusion)) != 0;
+        dst->enableTransmissionTexture = (src.enabledTextures & (1u << BakedTexture_Transmission)) != 0;
+        dst->enableOpacityTexture = (src.enabledTextures & (1u << BakedTexture_Opacity)) != 0;
+        dst->baseOrDiffuseColor = src.baseOrDiffuseColor;
+        dst->specularColor = src.specularColor;
+        dst->emissiveColor = src.emissiveColor;
+        dst->emissiveIntensity = src.emissiveIntensity;
+        dst->metalness = src.metalness;
+        dst->roughness = src.roughness;
+        dst->opacity = src.opacity;
+        dst->alphaCutoff = src.alphaCutoff;
+        dst->transmissionFactor = src.transmissionFactor;
+        dst->normalTextureScale = src.normalTextureScale;
+        dst->occlusionStrength = src.occlusionStrength;
+        dst->normalTextureTransformScale = src.normalTextureTransformScale;
+        dst->useSpecularGlossModel = (src.flags & BakedMaterial_UseSpecularGloss) != 0;
+        dst->doubleSided = (src.flags & BakedMaterial_DoubleSided) != 0;
+        dst->metalnessInRedChannel = (src.flags & BakedMaterial_MetalnessInRedChannel) != 0;
+        dst->enableSubsurfaceScattering = (src.flags & BakedMaterial_SubsurfaceScattering) != 0;
+        dst->enableHair = (src.flags & BakedMaterial_Hair) != 0;
+        dst->subsurface = src.subsurface;
+        dst->hair = src.hair;
+
+        materials[index] = dst;
+    }
+
+    // Buffer groups, pointing into the mapped file
+
+    std::vector<std::shared_ptr<BufferGroup>> bufferGroups;
+    std::vector<size_t> bufferGroupVertexCounts;
+    {
+        std::vector<const Chunk*> chunks;
+        cfile->getChunks(BakedBufferGroupDesc::chunktype, chunks);
+
+        for (const Chunk* chunk : chunks)
+        {
+            if (!cfile->validateChunk<BakedBufferGroupDesc>(chunk) || chunk->size < sizeof(BakedBufferGroupDesc))
+                return false;
+
+            const uint8_t* chunkData = static_cast<const uint8_t*>(chunk->data);
+            const BakedBufferGroupDesc& desc = *reinterpret_cast<const BakedBufferGroupDesc*>(chunkData);
+
+            if (size_t(desc.indexDataOffset) + size_t(desc.indexCount) * sizeof(uint32_t) > chunk->size ||
+                size_t(desc.vertexDataOffset) + size_t(desc.vertexDataSize) > chunk->size)
+            {
+                log::error("Baked scene '%s': invalid buffer group", normalizedFileName.c_str());
+                return false;
+            }
+
+            auto buffers = std::make_shared<BufferGroup>();
+            buffers->dataBlob = blob;
+            buffers->indexDataView = desc.indexCount ? reinterpret_cast<const uint32_t*>(chunkData + desc.indexDataOffset) : nullptr;
+            buffers->indexCount = desc.indexCount;
+
+            for (size_t attr = 0; attr < size_t(VertexAttribute::Count); ++attr)
+            {
+                const BakedBufferRange& range = desc.ranges[attr];
+                if (range.size == 0)
+                    continue;
+
+                if (size_t(range.offset) + range.size > desc.vertexDataSize)
+                {
+                    log::error("Baked scene '%s': invalid vertex buffer range", normalizedFileName.c_str());
+                    return false;
+                }
+
+                buffers->vertexBufferRanges[attr] = nvrhi::BufferRange(range.offset, range.size);
+                buffers->vertexDataViews[attr] = chunkData + desc.vertexDataOffset + range.offset;
+            }
+
+            bufferGroups.push_back(buffers);
+            bufferGroupVertexCounts.push_back(desc.ranges[size_t(VertexAttribute::Position)].size / sizeof(float3));
+        }
+    }
+
+    // Meshes
+
+    std::shared_ptr<Material> emptyMaterial;
+    std::vector<std::shared_ptr<MeshInfo>> meshes(numMeshes);
+    for (uint32_t index = 0; index < numMeshes; ++index)
+    {
+        const BakedMesh& src = srcMeshes[index];
+        if (src.bufferGroup >= bufferGroups.size() || size_t(src.firstGeometry) + src.numGeometries > numGeometries ||
+            size_t(src.indexOffset) + src.totalIndices > bufferGroups[src.bufferGroup]->indexCount ||
+            size_t(src.vertexOffset) + src.totalVertices > bufferGroupVertexCounts[src.bufferGroup])
+        {
+            log::error("Baked scene '%s': invalid mesh %u", normalizedFileName.c_str(), index);
+            return false;
+        }
+
+        std::shared_ptr<MeshInfo> dst = m_SceneTypeFactory->CreateMesh();
+        dst->name = getString(src.name);
+        dst->type = src.type < uint32_t(MeshType::Count) ? MeshType(src.type) : MeshType::Triangles;
+        dst->buffers = bufferGroups[src.bufferGroup];
+        dst->indexOffset = src.indexOffset;
+        dst->vertexOffset = src.vertexOffset;
+        dst->totalIndices = src.totalIndices;
+        dst->totalVertices = src.totalVertices;
+        dst->objectSpaceBounds = src.objectSpaceBounds;
+
+        for (uint32_t geometryIndex = 0; geometryIndex < src.numGeometries; ++geometryIndex)
+        {
+            const BakedGeometry& srcGeometry = srcGeometries[src.firstGeometry + geometryIndex];
+            if (size_t(srcGeometry.indexOffsetInMesh) + srcGeometry.numIndices > src.totalIndices ||
+                size_t(srcGeometry.vertexOffsetInMesh) + srcGeometry.numVertices > src.totalVertices)
+            {
+                log::error("Baked scene '%s': invalid geometry %u of mesh %u", normalizedFileName.c_str(), geometryIndex, index);
+                return false;
+            }
+
+            std::shared_ptr<MeshGeometry> geometry = m_SceneTypeFactory->CreateMeshGeometry();
+
+            if (srcGeometry.material < numMaterials)
+            {
+                geometry->material = materials[srcGeometry.material];
+            }
+            else
+            {
+                if (!emptyMaterial)
+                {
+                    emptyMaterial = std::make_shared<Material>();
+                    emptyMaterial->name = "(empty)";
+                }
+                geometry->material = emptyMaterial;
+            }
+
+            geometry->type = srcGeometry.type < uint32_t(MeshGeometryPrimitiveType::Count)
+                ? MeshGeometryPrimitiveType(srcGeometry.type) : MeshGeometryPrimitiveType::Triangles;
+            geometry->indexOffsetInMesh = srcGeometry.indexOffsetInMesh;
+            geometry->vertexOffsetInMesh = srcGeometry.vertexOffsetInMesh;
+            geometry->numIndices = srcGeometry.numIndices;
+            geometry->numVertices = srcGeometry.numVertices;
+            geometry->objectSpaceBounds = srcGeometry.objectSpaceBounds;
+
+            dst->geometries.push_back(geometry);
+        }
+
+        meshes[index] = dst;
+    }
+
+    // Nodes
+
+    std::shared_ptr<SceneGraph> graph = std::make_shared<SceneGraph>();
+    std::vector<std::shared_ptr<SceneGraphNode>> nodes(numNodes);
+    std::vector<std::shared_ptr<SceneGraphNode>> animationNodes(numAnimations);
+
+    for (uint32_t index = 0; index < numNodes; ++index)
+    {
+        // The records are only 4-byte aligned in the mapped file
+        BakedNode src;
+        memcpy(&src, reinterpret_cast<const uint8_t*>(srcNodes) + size_t(index) * sizeof(BakedNode), sizeof(BakedNode));
+
+        auto dst = std::make_shared<SceneGraphNode>();
+        nodes[index] = dst;
+
+        dst->SetName(getString(src.name));
+
+        const dquat rotation = dquat::fromXYZW(src.rotation);
+        dst->SetTransform(&src.translation, &rotation, &src.scaling);
+
+        if (index > 0)
+        {
+            if (src.parent >= index)
+            {
+                log::error("Baked scene '%s': invalid parent of node %u", normalizedFileName.c_str(), index);
+                return false;
+            }
+
+            graph->Attach(nodes[src.parent], dst);
+        }
+
+        switch (src.leafType)
+        {
+        case BakedLeafType::MeshInstance:
+            if (src.leafIndex < numMeshes)
+                dst->SetLeaf(m_SceneTypeFactory->CreateMeshInstance(meshes[src.leafIndex]));
+            break;
+
+        case BakedLeafType::PerspectiveCamera: {
+            auto camera = std::make_shared<PerspectiveCamera>();
+            camera->zNear = src.params[0];
+            camera->verticalFov = src.params[1];
+            if (src.leafFlags & BakedLeaf_HasZFar)
+                camera->zFar = src.params[2];
+            if (src.leafFlags & BakedLeaf_HasAspectRatio)
+                camera->aspectRatio = src.params[3];
+            dst->SetLeaf(camera);
+            break;
+        }
+
+        case BakedLeafType::OrthographicCamera: {
+            auto camera = std::make_shared<OrthographicCamera>();
+            camera->zNear = src.params[0];
+            camera->zFar = src.params[1];
+            camera->xMag = src.params[2];
+            camera->yMag = src.params[3];
+            dst->SetLeaf(camera);
+            break;
+        }
+
+        case BakedLeafType::DirectionalLight: {
+            auto light = CreateLight<DirectionalLight>(*m_SceneTypeFactory, "DirectionalLight", normalizedFileName);
+            if (!light)
+                break;
+            light->color = src.color;
+            light->irradiance = src.params[0];
+            light->angularSize = src.params[1];
+            dst->SetLeaf(light);
+            break;
+        }
+
+        case BakedLeafType::PointLight: {
+            auto light = CreateLight<PointLight>(*m_SceneTypeFactory, "PointLight", normalizedFileName);
+            if (!light)
+                break;
+            light->color = src.color;
+            light->intensity = src.params[0];
+            light->radius = src.params[1];
+            light->range = src.params[2];
+            dst->SetLeaf(light);
+            break;
+        }
+
+        case BakedLeafType::SpotLight: {
+            auto light = CreateLight<SpotLight>(*m_SceneTypeFactory, "SpotLight", normalizedFileName);
+            if (!light)
+                break;
+            light->color = src.color;
+            light->intensity = src.params[0];
+            light->radius = src.params[1];
+            light->range = src.params[2];
+            light->innerAngle = src.params[3];
+            light->outerAngle = src.params[4];
+            dst->SetLeaf(light);
+            break;
+        }
+
+        case BakedLeafType::Animation:
+            if (src.leafIndex < numAnimations)
+                animationNodes[src.leafIndex] = dst;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // Animations
+
+    for (uint32_t index = 0; index < numAnimations; ++index)
+    {
+        const BakedAnimation& src = srcAnimations[index];
+        if (size_t(src.firstChannel) + src.numChannels > numChannels)
+        {
+            log::error("Baked scene '%s': invalid animation %u", normalizedFileName.c_str(), index);
+            return false;
+        }
+
+        if (!animationNodes[index])
+            continue;
+
+        auto dst = std::make_shared<SceneGraphAnimation>();
+
+        for (uint32_t channelIndex = src.firstChannel; channelIndex < src.firstChannel + src.numChannels; ++channelIndex)
+        {
+            // The baker only writes node transform channels
+            const BakedChannel& srcChannel = srcChannels[channelIndex];
+            if (srcChannel.node >= numNodes || size_t(srcChannel.firstKeyframe) + srcChannel.numKeyframes > numKeyframes ||
+                srcChannel.mode > uint32_t(animation::InterpolationMode::HermiteSpline) ||
+                srcChannel.attribute < uint32_t(AnimationAttribute::Scaling) ||
+                srcChannel.attribute > uint32_t(AnimationAttribute::Translation))
+            {
+                log::error("Baked scene '%s': invalid channel %u", normalizedFileName.c_str(), channelIndex);
+                return false;
+            }
+
+            auto sampler = std::make_shared<animation::Sampler>();
+            sampler->SetInterpolationMode(animation::InterpolationMode(srcChannel.mode));
+            sampler->GetKeyframes().assign(srcKeyframes + srcChannel.firstKeyframe,
+                srcKeyframes + srcChannel.firstKeyframe + srcChannel.numKeyframes);
+
+            dst->AddChannel(std::make_shared<SceneGraphAnimationChannel>(sampler, nodes[srcChannel.node],
+                AnimationAttribute(srcChannel.attribute)));
+        }
+
+        if (!dst->GetChannels().empty())
+            animationNodes[index]->SetLeaf(dst);
+    }
+
+    result.rootNode = nodes[0];
+
+    return true;
+}
@@ -24,20 +24,18 @@
 
 using namespace donut::engine;
 
-nvrhi::BindingSetHandle BindingCache::GetCachedBindingSet(const nvrhi::BindingSetDesc& desc, nvrhi::IBindingLayout* layout)
+static size_t GetBindingSetHash(const nvrhi::BindingSetDesc& desc, nvrhi::IBindingLayout* layout)
 {
     size_t hash = 0;
     nvrhi::hash_combine(hash, desc);
     nvrhi::hash_combine(hash, layout);
+    return hash;
+}
 
-    m_Mutex.lock_shared();
-
-    nvrhi::BindingSetHandle result = nullptr;
-    auto it = m_BindingSets.find(hash);
-    if (it != m_BindingSets.end())
-        result = it->second;
-
-    m_Mutex.unlock_shared();
+nvrhi::BindingSetHandle BindingCache::GetCachedBindingSet(const nvrhi::BindingSetDesc& desc, nvrhi::IBindingLayout* layout)
+{
+    const size_t hash = GetBindingSetHash(desc, layout);
+    nvrhi::BindingSetHandle result = m_BindingSets.Find(hash, hash);
 
     if (result)
     {
@@ -50,34 +48,15 @@ nvrhi::BindingSetHandle BindingCache::GetCachedBindingSet(const nvrhi::BindingSe
 
 nvrhi::BindingSetHandle BindingCache::GetOrCreateBindingSet(const nvrhi::BindingSetDesc& desc, nvrhi::IBindingLayout* layout)
 {
-    size_t hash = 0;
-    nvrhi::hash_combine(hash, desc);
-    nvrhi::hash_combine(hash, layout);
-
-    m_Mutex.lock_shared();
-
-    nvrhi::BindingSetHandle result;
-    auto it = m_BindingSets.find(hash);
-    if (it != m_BindingSets.end())
-        result = it->second;
-    
-    m_Mutex.unlock_shared();
-
-    if (!result)
+    const size_t hash = GetBindingSetHash(desc, layout);
+    nvrhi::BindingSetHandle result = m_BindingSets.GetOrCreate(hash, hash, [this, &desc, layout]()
     {
-        m_Mutex.lock();
-
-        nvrhi::BindingSetHandle& entry = m_BindingSets[hash];
-        if (!entry)
-        {
-            result = m_Device->createBindingSet(desc, layout);
-            entry = result;
-        }
-        else
-            result = entry;
+        return m_Device->createBindingSet(desc, layout);
+    });
 
-        m_Mutex.unlock();
-    }
+    // Don't keep failed creations, so that they are retried on the next call
+    if (!result)
+        m_BindingSets.Erase(hash, hash);
 
     if (result)
     {
@@ -90,7 +69,5 @@ nvrhi::BindingSetHandle BindingCache::GetOrCreateBindingSet(const nvrhi::Binding
 
 void BindingCache::Clear()
 {
-    m_Mutex.lock();
-    m_BindingSets.clear();
-    m_Mutex.unlock();
+    m_BindingSets.Clear();
 }
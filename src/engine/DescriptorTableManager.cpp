@@ -21,6 +21,11 @@
 */
 
 #include <donut/engine/DescriptorTableManager.h>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 donut::engine::DescriptorHandle::DescriptorHandle()
     : m_DescriptorIndex(-1)
@@ -57,59 +62,160 @@ donut::engine::DescriptorIndex donut::engine::DescriptorHandle::GetIndexInHeap()
     return -1;
 }
 
+static uint32_t CountTrailingZeros(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return uint32_t(index);
+#else
+    return uint32_t(__builtin_ctzll(value));
+#endif
+}
+
+donut::engine::DescriptorIndex donut::engine::DescriptorSlotAllocator::Allocate()
+{
+    // Slots past the capacity are never allocated, so finding one means that all slots are taken.
+    for (size_t word = m_SearchStart; word < m_Words.size(); word++)
+    {
+        if (m_Words[word] == ~0ull)
+            continue;
+
+        const uint32_t index = uint32_t(word * 64) + CountTrailingZeros(~m_Words[word]);
+        if (index >= m_Capacity)
+            break;
+
+        m_Words[word] |= 1ull << (index % 64);
+        m_SearchStart = (m_Words[word] == ~0ull) ? word + 1 : word;
+        ++m_AllocatedCount;
+        return DescriptorIndex(index);
+    }
+
+    m_SearchStart = m_Words.size();
+    return -1;
+}
+
+bool donut::engine::DescriptorSlotAllocator::Release(DescriptorIndex index)
+{
+    if (!IsAllocated(index))
+        return false;
+
+    m_Words[index / 64] &= ~(1ull << (index % 64));
+    m_SearchStart = std::min(m_SearchStart, size_t(index / 64));
+    --m_AllocatedCount;
+    return true;
+}
+
+void donut::engine::DescriptorSlotAllocator::Grow(uint32_t capacity)
+{
+    if (capacity <= m_Capacity)
+        return;
+
+    // The last word may have been skipped as full when it only had free slots past the old capacity
+    m_SearchStart = std::min(m_SearchStart, size_t(m_Capacity / 64));
+    m_Capacity = capacity;
+    m_Words.resize((capacity + 63) / 64);
+}
+
+bool donut::engine::DescriptorSlotAllocator::IsAllocated(DescriptorIndex index) const
+{
+    if (index < 0 || uint32_t(index) >= m_Capacity)
+        return false;
+
+    return (m_Words[index / 64] & (1ull << (index % 64))) != 0;
+}
+
 donut::engine::DescriptorTableManager::DescriptorTableManager(nvrhi::IDevice* device, nvrhi::IBindingLayout* layout)
     : m_Device(device)
 {
     m_DescriptorTable = m_Device->createDescriptorTable(layout);
 
     size_t capacity = m_DescriptorTable->getCapacity();
-    m_AllocatedDescriptors.resize(capacity);
+    m_Slots.Grow(uint32_t(capacity));
+    m_PendingDescriptors.resize((capacity + 63) / 64);
     m_Descriptors.resize(capacity);
     memset(m_Descriptors.data(), 0, sizeof(nvrhi::BindingSetItem) * capacity);
+    m_Stats.capacity = uint32_t(capacity);
+}
+
+void donut::engine::DescriptorTableManager::Resize(uint32_t newCapacity)
+{
+    const uint32_t capacity = uint32_t(m_Descriptors.size());
+
+    m_Device->resizeDescriptorTable(m_DescriptorTable, newCapacity);
+    m_Slots.Grow(newCapacity);
+    m_PendingDescriptors.resize((newCapacity + 63) / 64);
+    m_Descriptors.resize(newCapacity);
+
+    // zero-fill the new descriptors
+    memset(&m_Descriptors[capacity], 0, sizeof(nvrhi::BindingSetItem) * (newCapacity - capacity));
+
+    m_Stats.capacity = newCapacity;
+    ++m_Stats.resizes;
+}
+
+void donut::engine::DescriptorTableManager::WriteDescriptor(uint32_t index)
+{
+    if (!m_DeferredWrites)
+    {
+        m_Device->writeDescriptorTable(m_DescriptorTable, m_Descriptors[index]);
+        ++m_Stats.descriptorWrites;
+        return;
+    }
+
+    uint64_t& pendingWord = m_PendingDescriptors[index / 64];
+    const uint64_t bit = 1ull << (index % 64);
+    if ((pendingWord & bit) == 0)
+    {
+        pendingWord |= bit;
+        m_PendingWrites.push_back(index);
+    }
+}
+
+void donut::engine::DescriptorTableManager::FlushInternal()
+{
+    for (uint32_t index : m_PendingWrites)
+    {
+        // Slots may have changed several times since the last flush, write their current contents
+        m_Device->writeDescriptorTable(m_DescriptorTable, m_Descriptors[index]);
+        m_PendingDescriptors[index / 64] &= ~(1ull << (index % 64));
+    }
+
+    m_Stats.descriptorWrites += m_PendingWrites.size();
+    m_PendingWrites.clear();
 }
 
 donut::engine::DescriptorIndex donut::engine::DescriptorTableManager::CreateDescriptor(nvrhi::BindingSetItem item)
 {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
     const auto& found = m_DescriptorIndexMap.find(item);
     if (found != m_DescriptorIndexMap.end())
-        return found->second;
-
-    uint32_t capacity = m_DescriptorTable->getCapacity();
-    bool foundFreeSlot = false;
-    uint32_t index = 0;
-    for (index = m_SearchStart; index < capacity; index++)
     {
-        if (!m_AllocatedDescriptors[index])
-        {
-            foundFreeSlot = true;
-            break;
-        }
+        ++m_Stats.reusedDescriptors;
+        return found->second;
     }
 
-    if (!foundFreeSlot)
+    DescriptorIndex index = m_Slots.Allocate();
+    if (index < 0)
     {
-        uint32_t newCapacity = std::max(64u, capacity * 2); // handle the initial case when capacity == 0
-        m_Device->resizeDescriptorTable(m_DescriptorTable, newCapacity);
-        m_AllocatedDescriptors.resize(newCapacity);
-        m_Descriptors.resize(newCapacity);
-
-        // zero-fill the new descriptors
-        memset(&m_Descriptors[capacity], 0, sizeof(nvrhi::BindingSetItem) * (newCapacity - capacity));
-        
-        index = capacity;
-        capacity = newCapacity;
+        const uint32_t capacity = m_Slots.GetCapacity();
+        Resize(std::max(64u, capacity * 2)); // handle the initial case when capacity == 0
+        index = m_Slots.Allocate();
     }
 
     item.slot = index;
-    m_SearchStart = index + 1;
-    m_AllocatedDescriptors[index] = true;
     m_Descriptors[index] = item;
     m_DescriptorIndexMap[item] = index;
-    m_Device->writeDescriptorTable(m_DescriptorTable, item);
+    WriteDescriptor(index);
 
     if (item.resourceHandle)
         item.resourceHandle->AddRef();
 
+    ++m_Stats.allocations;
+    ++m_Stats.allocatedDescriptors;
+    m_Stats.peakAllocatedDescriptors = std::max(m_Stats.peakAllocatedDescriptors, m_Stats.allocatedDescriptors);
+
     return index;
 }
 
@@ -121,6 +227,8 @@ donut::engine::DescriptorHandle donut::engine::DescriptorTableManager::CreateDes
 
 nvrhi::BindingSetItem donut::engine::DescriptorTableManager::GetDescriptor(DescriptorIndex index)
 {
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
     if (size_t(index) >= m_Descriptors.size())
         return nvrhi::BindingSetItem::None(0);
 
@@ -129,22 +237,58 @@ nvrhi::BindingSetItem donut::engine::DescriptorTableManager::GetDescriptor(Descr
 
 void donut::engine::DescriptorTableManager::ReleaseDescriptor(DescriptorIndex index)
 {
-    nvrhi::BindingSetItem& descriptor = m_Descriptors[index];
+    std::lock_guard<std::mutex> guard(m_Mutex);
 
-    if (descriptor.resourceHandle)
-        descriptor.resourceHandle->Release();
+    // Ignore the slots that are already free, such as a second release of the same slot
+    if (!m_Slots.Release(index))
+        return;
+
+    nvrhi::BindingSetItem& descriptor = m_Descriptors[index];
 
     // Erase the existing descriptor from the index map to prevent its "reuse" later
-    const auto indexMapEntry = m_DescriptorIndexMap.find(m_Descriptors[index]);
+    const auto indexMapEntry = m_DescriptorIndexMap.find(descriptor);
     if (indexMapEntry != m_DescriptorIndexMap.end())
         m_DescriptorIndexMap.erase(indexMapEntry);
 
+    nvrhi::IResource* resource = descriptor.resourceHandle;
     descriptor = nvrhi::BindingSetItem::None(index);
 
+    // Clear the slot in the table even with deferred writes before the resource may be destroyed.
+    // A pending write for this slot, if any, will write the same null descriptor.
     m_Device->writeDescriptorTable(m_DescriptorTable, descriptor);
+    ++m_Stats.descriptorWrites;
+
+    if (resource)
+        resource->Release();
+
+    ++m_Stats.releases;
+    --m_Stats.allocatedDescriptors;
+}
+
+void donut::engine::DescriptorTableManager::SetDeferredWrites(bool enable)
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    if (m_DeferredWrites && !enable)
+        FlushInternal();
+
+    m_DeferredWrites = enable;
+}
+
+void donut::engine::DescriptorTableManager::Flush()
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
+
+    FlushInternal();
+}
+
+donut::engine::DescriptorTableStats donut::engine::DescriptorTableManager::GetStats() const
+{
+    std::lock_guard<std::mutex> guard(m_Mutex);
 
-    m_AllocatedDescriptors[index] = false;
-    m_SearchStart = std::min(m_SearchStart, index);
+    DescriptorTableStats stats = m_Stats;
+    stats.pendingWrites = uint32_t(m_PendingWrites.size());
+    return stats;
 }
 
 donut::engine::DescriptorTableManager::~DescriptorTableManager()
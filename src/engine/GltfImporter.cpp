@@ -1661,6 +1661,12 @@ bool GltfImporter::Load(
         }
     }
 
+    if (m_LodGeneration.has_value())
+    {
+        for (const auto& mesh : meshes)
+            GenerateMeshLods(*mesh, *m_LodGeneration);
+    }
+
     std::unordered_map<const cgltf_camera*, std::shared_ptr<SceneCamera>> cameraMap;
     for (size_t camera_idx = 0; camera_idx < objects->cameras_count; camera_idx++)
     {
@@ -1989,7 +1995,12 @@ bool GltfImporter::Load(
             }
 
             if (!dstSampler->GetKeyframes().empty())
-                animationSamplers[srcSampler] = dstSampler;
+            {
+                if (m_AnimationCompression.has_value())
+                    animationSamplers[srcSampler] = animation::CompressSampler(dstSampler, *m_AnimationCompression);
+                else
+                    animationSamplers[srcSampler] = dstSampler;
+            }
             else
                 log::warning("Animation channel imported with no keyframes, ignoring.");
         }
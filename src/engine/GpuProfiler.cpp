@@ -0,0 +1,201 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/GpuProfiler.h>
+#include <donut/core/trace.h>
+#include <string>
+#include <unordered_set>
+
+using namespace donut::engine;
+
+static std::atomic<GpuProfiler*> g_CurrentProfiler = nullptr;
+
+// Nesting level of the zones recorded by the current thread
+static thread_local uint32_t t_ZoneDepth = 0;
+
+GpuProfiler::GpuProfiler(nvrhi::IDevice* device, uint32_t framesInFlight, uint32_t maxZonesPerFrame)
+    : m_Device(device)
+    , m_MaxZonesPerFrame(maxZonesPerFrame)
+{
+    m_Supported = m_Device->queryFeatureSupport(nvrhi::Feature::TimerQueries);
+
+    // One more pool than there are frames in flight, so that the pool being reused belongs to a frame
+    // that the GPU has finished by the time the CPU starts recording the next one.
+    for (uint32_t i = 0; i <= framesInFlight; ++i)
+    {
+        auto pool = std::make_unique<FramePool>();
+        pool->zones.resize(maxZonesPerFrame);
+        m_Pools.push_back(std::move(pool));
+    }
+
+    m_TraceTrack = trace::RegisterTrack("GPU");
+}
+
+void GpuProfiler::SetCurrent(GpuProfiler* profiler)
+{
+    g_CurrentProfiler.store(profiler);
+}
+
+GpuProfiler* GpuProfiler::GetCurrent()
+{
+    return g_CurrentProfiler.load(std::memory_order_relaxed);
+}
+
+// Zone names may be built at runtime, such as pass events, but the records and the trace keep only pointers,
+// so the names are stored in a set that lives until the process exits.
+static const char* InternName(const char* name)
+{
+    static std::mutex mutex;
+    static std::unordered_set<std::string> names;
+
+    std::lock_guard<std::mutex> guard(mutex);
+    return names.insert(name ? name : "").first->c_str();
+}
+
+void GpuProfiler::BeginFrame(uint64_t frameIndex)
+{
+    m_CurrentPoolIndex = (m_CurrentPoolIndex + 1) % uint32_t(m_Pools.size());
+    FramePool& pool = *m_Pools[m_CurrentPoolIndex];
+
+    ResolvePool(pool);
+
+    pool.zoneCount.store(0);
+    pool.frameIndex = frameIndex;
+    pool.pending = true;
+    m_CurrentPool = &pool;
+}
+
+uint32_t GpuProfiler::BeginZone(nvrhi::ICommandList* commandList, const char* name)
+{
+    if (!IsEnabled() || !m_CurrentPool)
+        return ~0u;
+
+    const uint32_t index = m_CurrentPool->zoneCount.fetch_add(1);
+    if (index >= m_MaxZonesPerFrame)
+    {
+        m_DroppedZones.fetch_add(1, std::memory_order_relaxed);
+        return ~0u;
+    }
+
+    Zone& zone = m_CurrentPool->zones[index];
+    if (!zone.query)
+        zone.query = m_Device->createTimerQuery();
+
+    zone.name = InternName(name);
+    zone.depth = t_ZoneDepth++;
+    zone.cpuBeginNs = trace::GetTimeNs();
+
+    commandList->beginTimerQuery(zone.query);
+
+    return index;
+}
+
+void GpuProfiler::EndZone(nvrhi::ICommandList* commandList, uint32_t zone)
+{
+    if (zone == ~0u || !m_CurrentPool)
+        return;
+
+    --t_ZoneDepth;
+    commandList->endTimerQuery(m_CurrentPool->zones[zone].query);
+}
+
+void GpuProfiler::ResolvePool(FramePool& pool)
+{
+    if (!pool.pending)
+        return;
+
+    pool.pending = false;
+
+    const uint32_t zoneCount = std::min(pool.zoneCount.load(), m_MaxZonesPerFrame);
+    if (zoneCount == 0)
+        return;
+
+    GpuFrameRecord frame;
+    frame.frameIndex = pool.frameIndex;
+    frame.zones.reserve(zoneCount);
+
+    bool stalled = false;
+    for (uint32_t index = 0; index < zoneCount; ++index)
+    {
+        Zone& zone = pool.zones[index];
+
+        // getTimerQueryTime waits for the results if they are not available yet,
+        // which only happens when the GPU is more frames behind than the pools cover.
+        if (!m_Device->pollTimerQuery(zone.query))
+            stalled = true;
+
+        GpuZoneRecord record;
+        record.name = zone.name;
+        record.depth = zone.depth;
+        record.durationMs = m_Device->getTimerQueryTime(zone.query) * 1e3f;
+        record.cpuBeginNs = zone.cpuBeginNs;
+        m_Device->resetTimerQuery(zone.query);
+
+        if (record.depth == 0)
+            frame.totalMs += record.durationMs;
+
+        frame.zones.push_back(record);
+    }
+
+    if (trace::IsEnabled())
+    {
+        // Timer queries only measure durations, so lay the zones out one after another on each level,
+        // starting no earlier than they were recorded and keeping the children within their parents.
+        std::vector<uint64_t> levelCursors;
+        for (const GpuZoneRecord& zone : frame.zones)
+        {
+            if (levelCursors.size() < zone.depth + 2)
+                levelCursors.resize(zone.depth + 2, 0);
+
+            const uint64_t beginNs = std::max(zone.cpuBeginNs, levelCursors[zone.depth]);
+            const uint64_t endNs = beginNs + uint64_t(double(zone.durationMs) * 1e6);
+            levelCursors[zone.depth] = endNs;
+            levelCursors[zone.depth + 1] = beginNs;
+
+            trace::RecordTrackZone(m_TraceTrack, zone.name, beginNs, endNs, zone.depth);
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(m_HistoryMutex);
+
+    ++m_Stats.resolvedFrames;
+    if (stalled)
+        ++m_Stats.stalledFrames;
+
+    m_History.push_back(std::move(frame));
+    while (m_History.size() > m_HistoryLength)
+        m_History.pop_front();
+}
+
+std::vector<GpuFrameRecord> GpuProfiler::GetFrameHistory() const
+{
+    std::lock_guard<std::mutex> guard(m_HistoryMutex);
+    return std::vector<GpuFrameRecord>(m_History.begin(), m_History.end());
+}
+
+GpuProfilerStats GpuProfiler::GetStats() const
+{
+    std::lock_guard<std::mutex> guard(m_HistoryMutex);
+    GpuProfilerStats stats = m_Stats;
+    stats.droppedZones = m_DroppedZones.load(std::memory_order_relaxed);
+    return stats;
+}
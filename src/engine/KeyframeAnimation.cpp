@@ -38,6 +38,7 @@ this software is released into the Public Domain.
 #include <donut/core/json.h>
 #include <donut/core/log.h>
 #include <json/value.h>
+#include <algorithm>
 #include <cassert>
 
 using namespace donut::math;
@@ -45,19 +46,20 @@ using namespace donut::engine;
 using namespace donut::engine::animation;
 
 float4 donut::engine::animation::Interpolate(const InterpolationMode mode,
-    const Keyframe& a, const Keyframe& b, const Keyframe& c, const Keyframe& d, const float t, const float dt)
+    const float4& a, const float4& b, const float4& c, const float4& d,
+    const float4& bOutTangent, const float4& cInTangent, const float t, const float dt)
 {
     switch (mode)
     {
     case InterpolationMode::Step:
-        return b.value;
+        return b;
 
     case InterpolationMode::Linear:
-        return lerp(b.value, c.value, t);
+        return lerp(b, c, t);
 
     case InterpolationMode::Slerp: {
-        quat qb = quat::fromXYZW(b.value);
-        quat qc = quat::fromXYZW(c.value);
+        quat qb = quat::fromXYZW(b);
+        quat qc = quat::fromXYZW(c);
         quat qr = slerp(qb, qc, t);
         return float4(qr.x, qr.y, qr.z, qr.w);
     }
@@ -65,28 +67,34 @@ float4 donut::engine::animation::Interpolate(const InterpolationMode mode,
     case InterpolationMode::CatmullRomSpline: {
         // https://en.wikipedia.org/wiki/Cubic_Hermite_spline#Interpolation_on_the_unit_interval_with_matched_derivatives_at_endpoints
         // a = p[n-1], b = p[n], c = p[n+1], d = p[n+2]
-        float4 i = -a.value + 3.f * b.value - 3.f * c.value + d.value;
-        float4 j = 2.f * a.value - 5.f * b.value + 4.f * c.value - d.value;
-        float4 k = -a.value + c.value;
-        return 0.5f * ((i * t + j) * t + k) * t + b.value;
+        float4 i = -a + 3.f * b - 3.f * c + d;
+        float4 j = 2.f * a - 5.f * b + 4.f * c - d;
+        float4 k = -a + c;
+        return 0.5f * ((i * t + j) * t + k) * t + b;
     }
 
     case InterpolationMode::HermiteSpline: {
         // https://github.com/KhronosGroup/glTF/tree/master/specification/2.0#appendix-c-spline-interpolation
         const float t2 = t * t;
         const float t3 = t2 * t;
-        return (2.f * t3 - 3.f * t2 + 1.f) * b.value
-             + (t3 - 2.f * t2 + t) * b.outTangent * dt
-             + (-2.f * t3 + 3.f * t2) * c.value
-             + (t3 - t2) * c.inTangent * dt;
+        return (2.f * t3 - 3.f * t2 + 1.f) * b
+             + (t3 - 2.f * t2 + t) * bOutTangent * dt
+             + (-2.f * t3 + 3.f * t2) * c
+             + (t3 - t2) * cInTangent * dt;
     }
 
     default:
         assert(!"Unknown interpolation mode");
-        return b.value;
+        return b;
     }
 }
 
+float4 donut::engine::animation::Interpolate(const InterpolationMode mode,
+    const Keyframe& a, const Keyframe& b, const Keyframe& c, const Keyframe& d, const float t, const float dt)
+{
+    return Interpolate(mode, a.value, b.value, c.value, d.value, b.outTangent, c.inTangent, t, dt);
+}
+
 std::optional<dm::float4> Sampler::Evaluate(float time, bool extrapolateLastValues) const
 {
     const size_t count = m_Keyframes.size();
@@ -152,9 +160,97 @@ std::optional<dm::float4> Sampler::Evaluate(float time, bool extrapolateLastValu
     return std::optional(y);
 }
 
+CompiledSampler::CompiledSampler(const Sampler& sampler)
+    : m_Mode(sampler.GetMode())
+{
+    const std::vector<Keyframe> keyframes = sampler.CopyKeyframes();
+
+    m_Times.reserve(keyframes.size());
+    m_Values.reserve(keyframes.size());
+    for (const Keyframe& keyframe : keyframes)
+    {
+        m_Times.push_back(keyframe.time);
+        m_Values.push_back(keyframe.value);
+    }
+
+    if (m_Mode == InterpolationMode::HermiteSpline)
+    {
+        m_InTangents.reserve(keyframes.size());
+        m_OutTangents.reserve(keyframes.size());
+        for (const Keyframe& keyframe : keyframes)
+        {
+            m_InTangents.push_back(keyframe.inTangent);
+            m_OutTangents.push_back(keyframe.outTangent);
+        }
+    }
+}
+
+uint32_t CompiledSampler::FindKeyframePair(float time, uint32_t cursor) const
+{
+    // Find the pair of keyframes (b, c) so that (b.time <= time < c.time), same as Sampler::Evaluate.
+    // The caller guarantees that time is within (first.time, last.time).
+    const uint32_t lastPair = uint32_t(m_Times.size() - 2);
+    uint32_t pair = std::min(cursor, lastPair);
+
+    // Playback usually moves forward by less than a keyframe per call, so try a few linear steps first.
+    constexpr int maxLinearSteps = 4;
+    if (m_Times[pair] <= time)
+    {
+        for (int step = 0; step < maxLinearSteps; ++step)
+        {
+            if (time < m_Times[pair + 1])
+                return pair;
+            ++pair;
+        }
+    }
+
+    // Fall back to binary search over the whole array for seeks and large time steps.
+    auto it = std::upper_bound(m_Times.begin(), m_Times.end(), time);
+    return uint32_t(it - m_Times.begin()) - 1;
+}
+
+std::optional<dm::float4> CompiledSampler::Evaluate(float time, uint32_t& cursor, bool extrapolateLastValues) const
+{
+    const size_t count = m_Times.size();
+
+    if (count == 0)
+        return std::optional<float4>();
+
+    if (time <= m_Times[0])
+    {
+        cursor = 0;
+        return std::optional(m_Values[0]);
+    }
+
+    if (count == 1 || time >= m_Times[count - 1])
+    {
+        if (extrapolateLastValues)
+            return std::optional(m_Values[count - 1]);
+        else
+            return std::optional<float4>();
+    }
+
+    const uint32_t offset = FindKeyframePair(time, cursor);
+    cursor = offset;
+
+    const float4& b = m_Values[offset];
+    const float4& c = m_Values[offset + 1];
+    const float4& a = (offset > 0) ? m_Values[offset - 1] : b;
+    const float4& d = (offset < count - 2) ? m_Values[offset + 2] : c;
+
+    const float tb = m_Times[offset];
+    const float dt = m_Times[offset + 1] - tb;
+    const float u = (time - tb) / dt;
+
+    if (m_Mode == InterpolationMode::HermiteSpline)
+        return std::optional(Interpolate(m_Mode, a, b, c, d, m_OutTangents[offset], m_InTangents[offset + 1], u, dt));
+
+    return std::optional(Interpolate(m_Mode, a, b, c, d, b, c, u, dt));
+}
+
 void Sampler::AddKeyframe(const Keyframe keyframe)
 {
-    m_Keyframes.push_back(keyframe);
+    GetKeyframes().push_back(keyframe);
 }
 
 float Sampler::GetStartTime() const
@@ -220,6 +316,322 @@ void Sampler::Load(Json::Value& node)
     }
 }
 
+static bool IsCompressibleMode(InterpolationMode mode)
+{
+    return mode == InterpolationMode::Step || mode == InterpolationMode::Linear || mode == InterpolationMode::Slerp;
+}
+
+static float ValueError(InterpolationMode mode, const float4& a, const float4& b)
+{
+    float4 diff = abs(a - b);
+
+    // q and -q represent the same rotation
+    if (mode == InterpolationMode::Slerp)
+        diff = min(diff, abs(a + b));
+
+    return max(max(diff.x, diff.y), max(diff.z, diff.w));
+}
+
+static size_t ReduceKeyframeArray(std::vector<Keyframe>& keyframes, InterpolationMode mode, float tolerance)
+{
+    const size_t count = keyframes.size();
+    if (count <= 2)
+        return 0;
+
+    // Greedy reduction: skip a keyframe if the segment from the last kept keyframe to the next one
+    // reproduces all original keyframes in between within tolerance. For piecewise linear curves,
+    // the largest difference is always at one of the original keyframes, so this bounds the error everywhere.
+    std::vector<Keyframe> result;
+    result.reserve(count);
+    result.push_back(keyframes[0]);
+    size_t lastKept = 0;
+
+    for (size_t candidate = 1; candidate < count - 1; ++candidate)
+    {
+        const Keyframe& a = keyframes[lastKept];
+        const Keyframe& c = keyframes[candidate + 1];
+        const float dt = c.time - a.time;
+
+        bool canSkip = dt > 0.f;
+        for (size_t test = lastKept + 1; canSkip && test <= candidate; ++test)
+        {
+            const Keyframe& b = keyframes[test];
+            const float u = (b.time - a.time) / dt;
+            const float4 value = Interpolate(mode, a.value, a.value, c.value, c.value, a.outTangent, c.inTangent, u, dt);
+            canSkip = ValueError(mode, value, b.value) <= tolerance;
+        }
+
+        if (!canSkip)
+        {
+            result.push_back(keyframes[candidate]);
+            lastKept = candidate;
+        }
+    }
+
+    result.push_back(keyframes[count - 1]);
+
+    const size_t removed = count - result.size();
+    keyframes = std::move(result);
+    return removed;
+}
+
+size_t donut::engine::animation::ReduceKeyframes(Sampler& sampler, const CompressionSettings& settings)
+{
+    const InterpolationMode mode = sampler.GetMode();
+    if (!IsCompressibleMode(mode))
+        return 0;
+
+    const float tolerance = (mode == InterpolationMode::Slerp) ? settings.rotationTolerance : settings.valueTolerance;
+    return ReduceKeyframeArray(sampler.GetKeyframes(), mode, tolerance);
+}
+
+// Smallest-three quaternion encoding: the largest component is dropped and reconstructed from the unit length,
+// the other three are stored as 15-bit fractions of [-1/sqrt(2), 1/sqrt(2)], and the index of the dropped component
+// is stored in the top bits of the first two words.
+static constexpr float c_SmallestThreeRange = 0.70710678f;
+static constexpr float c_SmallestThreeScale = 32767.f;
+
+// The stored components are off by at most half of the quantization step. The largest component is at least 1/2,
+// and its reconstruction from the unit length amplifies the error of the others by at most 3x.
+static constexpr float c_SmallestThreeError = 3.f * c_SmallestThreeRange / c_SmallestThreeScale;
+
+static void EncodeQuaternion(float4 q, uint16_t* words)
+{
+    q = normalize(q);
+
+    int largest = 0;
+    for (int i = 1; i < 4; ++i)
+    {
+        if (fabsf(q[i]) > fabsf(q[largest]))
+            largest = i;
+    }
+
+    if (q[largest] < 0.f)
+        q = -q;
+
+    int word = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+
+        float normalized = clamp(q[i] / (2.f * c_SmallestThreeRange) + 0.5f, 0.f, 1.f);
+        words[word++] = uint16_t(roundf(normalized * c_SmallestThreeScale));
+    }
+
+    words[0] |= uint16_t((largest & 1) << 15);
+    words[1] |= uint16_t((largest >> 1) << 15);
+}
+
+static float4 DecodeQuaternion(const uint16_t* words)
+{
+    const int largest = (words[0] >> 15) | ((words[1] >> 15) << 1);
+
+    float4 q;
+    float sumOfSquares = 0.f;
+    int word = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+
+        float normalized = float(words[word++] & 0x7fff) / c_SmallestThreeScale;
+        q[i] = (normalized - 0.5f) * (2.f * c_SmallestThreeRange);
+        sumOfSquares += q[i] * q[i];
+    }
+
+    q[largest] = sqrtf(std::max(0.f, 1.f - sumOfSquares));
+    return q;
+}
+
+CompressedSampler::CompressedSampler(const Sampler& sampler, const CompressionSettings& settings)
+{
+    m_Mode = sampler.GetMode();
+    assert(IsCompressibleMode(m_Mode));
+
+    std::vector<Keyframe> keyframes = sampler.CopyKeyframes();
+    const float tolerance = (m_Mode == InterpolationMode::Slerp) ? settings.rotationTolerance : settings.valueTolerance;
+
+    // Find the value range of every component. The reduced keyframes are a subset of the original ones,
+    // so the quantization step and its error are known before the reduction.
+    float4 rangeMax = keyframes.empty() ? float4(0.f) : keyframes[0].value;
+    m_RangeMin = rangeMax;
+    for (const Keyframe& keyframe : keyframes)
+    {
+        m_RangeMin = min(m_RangeMin, keyframe.value);
+        rangeMax = max(rangeMax, keyframe.value);
+    }
+
+    float quantizationError = 0.f;
+    if (m_Mode == InterpolationMode::Slerp)
+        quantizationError = c_SmallestThreeError;
+    else
+    {
+        for (int component = 0; component < 4; ++component)
+            quantizationError = std::max(quantizationError, (rangeMax[component] - m_RangeMin[component]) / 65535.f * 0.5f);
+    }
+
+    // Interpolation between quantized keyframes is off by at most the error of the keyframes,
+    // so the rest of the tolerance is left for the key reduction.
+    m_Quantized = settings.quantize && quantizationError <= tolerance;
+    ReduceKeyframeArray(keyframes, m_Mode, m_Quantized ? tolerance - quantizationError : tolerance);
+
+    m_Times.reserve(keyframes.size());
+    for (const Keyframe& keyframe : keyframes)
+        m_Times.push_back(keyframe.time);
+
+    if (!m_Quantized)
+    {
+        m_Values.reserve(keyframes.size());
+        for (const Keyframe& keyframe : keyframes)
+            m_Values.push_back(keyframe.value);
+        return;
+    }
+
+    if (m_Mode == InterpolationMode::Slerp)
+    {
+        m_QuantizedValues.resize(keyframes.size() * 3);
+        for (size_t index = 0; index < keyframes.size(); ++index)
+            EncodeQuaternion(keyframes[index].value, m_QuantizedValues.data() + index * 3);
+        return;
+    }
+
+    // Only store the components that change
+    for (int component = 0; component < 4; ++component)
+    {
+        const float range = rangeMax[component] - m_RangeMin[component];
+        if (range > 0.f)
+        {
+            m_ComponentMask |= 1u << component;
+            ++m_ComponentCount;
+            m_RangeScale[component] = range / 65535.f;
+        }
+    }
+
+    m_QuantizedValues.reserve(keyframes.size() * m_ComponentCount);
+    for (const Keyframe& keyframe : keyframes)
+    {
+        for (int component = 0; component < 4; ++component)
+        {
+            if ((m_ComponentMask & (1u << component)) == 0)
+                continue;
+
+            const float normalized = (keyframe.value[component] - m_RangeMin[component]) / m_RangeScale[component];
+            m_QuantizedValues.push_back(uint16_t(clamp(roundf(normalized), 0.f, 65535.f)));
+        }
+    }
+}
+
+float4 CompressedSampler::DecodeValue(size_t index) const
+{
+    if (!m_Quantized)
+        return m_Values[index];
+
+    if (m_Mode == InterpolationMode::Slerp)
+        return DecodeQuaternion(m_QuantizedValues.data() + index * 3);
+
+    float4 value = m_RangeMin;
+    const uint16_t* words = m_QuantizedValues.data() + index * m_ComponentCount;
+    for (int component = 0; component < 4; ++component)
+    {
+        if (m_ComponentMask & (1u << component))
+            value[component] += float(*words++) * m_RangeScale[component];
+    }
+    return value;
+}
+
+std::optional<dm::float4> CompressedSampler::Evaluate(float time, bool extrapolateLastValues) const
+{
+    if (!IsCompressed())
+        return Sampler::Evaluate(time, extrapolateLastValues);
+
+    const size_t count = m_Times.size();
+
+    if (count == 0)
+        return std::optional<float4>();
+
+    if (time <= m_Times[0])
+        return std::optional(DecodeValue(0));
+
+    if (count == 1 || time >= m_Times[count - 1])
+    {
+        if (extrapolateLastValues)
+            return std::optional(DecodeValue(count - 1));
+        else
+            return std::optional<float4>();
+    }
+
+    // Find the pair of keyframes (b, c) so that (b.time <= time < c.time), same as Sampler::Evaluate.
+    const size_t offset = size_t(std::upper_bound(m_Times.begin(), m_Times.end(), time) - m_Times.begin()) - 1;
+
+    // The compressible modes only use the (b, c) keyframes.
+    const float4 b = DecodeValue(offset);
+    const float4 c = (m_Mode == InterpolationMode::Step) ? b : DecodeValue(offset + 1);
+
+    const float dt = m_Times[offset + 1] - m_Times[offset];
+    const float u = (time - m_Times[offset]) / dt;
+
+    return std::optional(Interpolate(m_Mode, b, b, c, c, b, c, u, dt));
+}
+
+float CompressedSampler::GetStartTime() const
+{
+    return IsCompressed() ? m_Times.front() : Sampler::GetStartTime();
+}
+
+float CompressedSampler::GetEndTime() const
+{
+    return IsCompressed() ? m_Times.back() : Sampler::GetEndTime();
+}
+
+size_t CompressedSampler::GetDataSize() const
+{
+    return m_Times.size() * sizeof(float)
+        + m_QuantizedValues.size() * sizeof(uint16_t)
+        + m_Values.size() * sizeof(float4)
+        + Sampler::GetDataSize();
+}
+
+size_t CompressedSampler::GetKeyframeCount() const
+{
+    return IsCompressed() ? m_Times.size() : Sampler::GetKeyframeCount();
+}
+
+std::vector<Keyframe> CompressedSampler::CopyKeyframes() const
+{
+    if (!IsCompressed())
+        return Sampler::CopyKeyframes();
+
+    std::vector<Keyframe> keyframes;
+    keyframes.resize(m_Times.size());
+    for (size_t index = 0; index < m_Times.size(); ++index)
+    {
+        keyframes[index].time = m_Times[index];
+        keyframes[index].value = DecodeValue(index);
+    }
+    return keyframes;
+}
+
+std::vector<Keyframe>& CompressedSampler::GetKeyframes()
+{
+    if (IsCompressed())
+    {
+        m_Keyframes = CopyKeyframes();
+        std::vector<float>().swap(m_Times);
+        std::vector<uint16_t>().swap(m_QuantizedValues);
+        std::vector<float4>().swap(m_Values);
+    }
+    return m_Keyframes;
+}
+
+std::shared_ptr<Sampler> donut::engine::animation::CompressSampler(const std::shared_ptr<Sampler>& sampler, const CompressionSettings& settings)
+{
+    if (!sampler || !IsCompressibleMode(sampler->GetMode()))
+        return sampler;
+
+    return std::make_shared<CompressedSampler>(*sampler, settings);
+}
+
 std::optional<dm::float4> Sequence::Evaluate(const std::string& name, float time, bool extrapolateLastValues)
 {
     std::shared_ptr<Sampler> track = GetTrack(name);
@@ -0,0 +1,352 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/LightClusters.h>
+#include <donut/engine/View.h>
+#include <donut/core/log.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace donut::math;
+#include <donut/shaders/light_cb.h>
+#include <donut/shaders/light_cluster_cb.h>
+
+using namespace donut::engine;
+
+LightClusterGrid::LightClusterGrid(const LightClusterSettings& settings)
+{
+    SetSettings(settings);
+}
+
+void LightClusterGrid::SetSettings(const LightClusterSettings& settings)
+{
+    m_Settings = settings;
+    m_Settings.tileSize = std::max(m_Settings.tileSize, 1u);
+    m_Settings.numSlices = std::max(m_Settings.numSlices, 2u);
+    m_Settings.nearDepth = std::max(m_Settings.nearDepth, 1e-3f);
+    m_Settings.farDepth = std::max(m_Settings.farDepth, m_Settings.nearDepth * 2.f);
+    m_Settings.maxLightsPerCluster = std::max(m_Settings.maxLightsPerCluster, 1u);
+}
+
+bool LightClusterGrid::IsLocalLight(const LightConstants& light)
+{
+    return (light.lightType == LightType_Point || light.lightType == LightType_Spot)
+        && light.angularSizeOrInvRange > 0.f;
+}
+
+uint32_t LightClusterGrid::PartitionLights(std::vector<LightConstants>& lights) const
+{
+    if (!m_Settings.enableClustering)
+        return uint32_t(lights.size());
+
+    auto firstLocal = std::stable_partition(lights.begin(), lights.end(),
+        [](const LightConstants& light) { return !IsLocalLight(light); });
+
+    return uint32_t(firstLocal - lights.begin());
+}
+
+void LightClusterGrid::SetLights(const LightConstants* lights, uint32_t numLights, uint32_t numGlobalLights)
+{
+    m_NumGlobalLights = numGlobalLights;
+    m_Lights.clear();
+
+    for (uint32_t index = numGlobalLights; index < numLights; index++)
+    {
+        const LightConstants& light = lights[index];
+        assert(IsLocalLight(light));
+
+        LocalLight& local = m_Lights.emplace_back();
+        local.position = light.position;
+        local.range = 1.f / light.angularSizeOrInvRange;
+        local.index = index;
+
+        // Point lights and wide spot lights are bound by their range sphere only
+        if (light.lightType == LightType_Spot && light.outerAngle < dm::PI_f * 0.5f)
+        {
+            local.direction = normalize(light.direction);
+            local.cosAngle = cosf(light.outerAngle);
+            local.sinAngle = sinf(light.outerAngle);
+        }
+    }
+}
+
+float LightClusterGrid::GetSliceDepth(uint32_t slice) const
+{
+    if (slice == 0)
+        return 0.f;
+
+    // Inverse of the mapping in GetClusterIndex: slice k starts where log2(depth) * scale + bias == k - 1
+    return std::exp2((float(slice - 1) - m_SliceBias) / m_SliceScale);
+}
+
+void LightClusterGrid::BuildSingleCluster()
+{
+    m_GridSize = uint3(1u);
+    m_SliceScale = 0.f;
+    m_SliceBias = 0.f;
+
+    m_LightIndices.clear();
+    for (const LocalLight& light : m_Lights)
+        m_LightIndices.push_back(light.index);
+
+    m_ClusterRanges.assign(1, uint2(0u, uint32_t(m_LightIndices.size())));
+
+    m_Stats.numClusters = 1;
+    m_Stats.numLightIndices = uint32_t(m_LightIndices.size());
+    m_Stats.maxLightsInCluster = m_Stats.numLightIndices;
+}
+
+void LightClusterGrid::Build(const IView& view)
+{
+    m_Stats = LightClusterStats();
+    m_Stats.numGlobalLights = m_NumGlobalLights;
+    m_Stats.numLocalLights = uint32_t(m_Lights.size());
+
+    if (m_Lights.empty() || view.IsCubemapView())
+    {
+        BuildSingleCluster();
+        return;
+    }
+
+    const nvrhi::Rect viewExtent = view.GetViewExtent();
+    const uint32_t tileSize = m_Settings.tileSize;
+    m_GridSize.x = uint32_t(std::max(div_ceil(viewExtent.width(), int(tileSize)), 1));
+    m_GridSize.y = uint32_t(std::max(div_ceil(viewExtent.height(), int(tileSize)), 1));
+    m_GridSize.z = m_Settings.numSlices;
+
+    m_SliceScale = float(m_GridSize.z - 1) / std::log2(m_Settings.farDepth / m_Settings.nearDepth);
+    m_SliceBias = -std::log2(m_Settings.nearDepth) * m_SliceScale;
+
+    // The tile corners in view space are linear functions of the depth, for both perspective and orthographic
+    // projections. Find them by unprojecting two points of every corner ray.
+    const uint32_t cornersX = m_GridSize.x + 1;
+    const uint32_t cornersY = m_GridSize.y + 1;
+    std::vector<float3> cornerOrigins(cornersX * cornersY);
+    std::vector<float3> cornerSlopes(cornersX * cornersY);
+    float nearPlaneDepth = 0.f;
+    {
+        const float4x4 invProjection = view.GetInverseProjectionMatrix(true);
+        const float nearClipDepth = view.IsReverseDepth() ? 1.f : 0.f;
+        const float width = float(viewExtent.width());
+        const float height = float(viewExtent.height());
+
+        for (uint32_t y = 0; y < cornersY; y++)
+        {
+            for (uint32_t x = 0; x < cornersX; x++)
+            {
+                float2 clip;
+                clip.x = std::min(float(x * tileSize) / width, 1.f) * 2.f - 1.f;
+                clip.y = 1.f - std::min(float(y * tileSize) / height, 1.f) * 2.f;
+
+                float4 a = float4(clip, nearClipDepth, 1.f) * invProjection;
+                float4 b = float4(clip, 0.5f, 1.f) * invProjection;
+                float3 pa = a.xyz() / a.w;
+                float3 pb = b.xyz() / b.w;
+
+                // Position at depth z is origin + slope * z
+                float3 slope = (pb - pa) / (pb.z - pa.z);
+                cornerSlopes[y * cornersX + x] = slope;
+                cornerOrigins[y * cornersX + x] = pa - slope * pa.z;
+                nearPlaneDepth = std::min(nearPlaneDepth, pa.z);
+            }
+        }
+    }
+
+    // Transform the lights into view space and drop the ones that are entirely behind the near plane
+    const affine3 viewMatrix = view.GetViewMatrix();
+    float maxLightDepth = 0.f;
+    m_ViewLights.clear();
+    for (const LocalLight& light : m_Lights)
+    {
+        LocalLight viewLight = light;
+        viewLight.position = viewMatrix.transformPoint(light.position);
+        viewLight.direction = viewMatrix.transformVector(light.direction);
+
+        if (viewLight.position.z + viewLight.range <= nearPlaneDepth)
+            continue;
+
+        maxLightDepth = std::max(maxLightDepth, viewLight.position.z + viewLight.range);
+        m_ViewLights.push_back(viewLight);
+    }
+
+    // Compute the cluster bounds; the last slice only needs to reach the farthest light
+    const uint32_t numClusters = m_GridSize.x * m_GridSize.y * m_GridSize.z;
+    m_ClusterBounds.resize(numClusters);
+    for (uint32_t slice = 0; slice < m_GridSize.z; slice++)
+    {
+        // Orthographic projections may have the near plane behind the view origin
+        float zMin = (slice == 0) ? nearPlaneDepth : GetSliceDepth(slice);
+        float zMax = (slice + 1 < m_GridSize.z) ? GetSliceDepth(slice + 1) : std::max(maxLightDepth, zMin);
+
+        for (uint32_t y = 0; y < m_GridSize.y; y++)
+        {
+            for (uint32_t x = 0; x < m_GridSize.x; x++)
+            {
+                float3 points[8];
+                int numPoints = 0;
+                for (uint32_t corner = 0; corner < 4; corner++)
+                {
+                    uint32_t cornerIndex = (y + (corner >> 1)) * cornersX + x + (corner & 1);
+                    points[numPoints++] = cornerOrigins[cornerIndex] + cornerSlopes[cornerIndex] * zMin;
+                    points[numPoints++] = cornerOrigins[cornerIndex] + cornerSlopes[cornerIndex] * zMax;
+                }
+
+                m_ClusterBounds[(slice * m_GridSize.y + y) * m_GridSize.x + x] = box3(numPoints, points);
+            }
+        }
+    }
+
+    // Test every light against the clusters in the slices that its range overlaps,
+    // and collect the (cluster, light) pairs in the light order
+    std::vector<uint2> pairs;
+    std::vector<uint32_t> clusterCounts(numClusters, 0);
+    for (uint32_t lightIndex = 0; lightIndex < uint32_t(m_ViewLights.size()); lightIndex++)
+    {
+        const LocalLight& light = m_ViewLights[lightIndex];
+        const float rangeSq = light.range * light.range;
+
+        uint32_t firstSlice = GetClusterIndex(float2(0.f), light.position.z - light.range) / (m_GridSize.x * m_GridSize.y);
+        uint32_t lastSlice = GetClusterIndex(float2(0.f), light.position.z + light.range) / (m_GridSize.x * m_GridSize.y);
+
+        for (uint32_t slice = firstSlice; slice <= lastSlice; slice++)
+        {
+            for (uint32_t tile = 0; tile < m_GridSize.x * m_GridSize.y; tile++)
+            {
+                uint32_t cluster = slice * m_GridSize.x * m_GridSize.y + tile;
+                const box3& bounds = m_ClusterBounds[cluster];
+
+                float3 closest = bounds.clamp(light.position);
+                if (lengthSquared(closest - light.position) > rangeSq)
+                    continue;
+
+                if (light.cosAngle > 0.f)
+                {
+                    // Cone against the bounding sphere of the cluster
+                    float3 center = bounds.center();
+                    float radius = length(bounds.diagonal()) * 0.5f;
+                    float3 v = center - light.position;
+                    float vLengthSq = lengthSquared(v);
+                    float vAlongAxis = dot(v, light.direction);
+                    float distanceToCone = light.cosAngle * sqrtf(std::max(vLengthSq - vAlongAxis * vAlongAxis, 0.f))
+                        - vAlongAxis * light.sinAngle;
+
+                    if (distanceToCone > radius || vAlongAxis < -radius)
+                        continue;
+                }
+
+                pairs.push_back(uint2(cluster, light.index));
+                ++clusterCounts[cluster];
+            }
+        }
+    }
+
+    // Counting sort of the pairs into per-cluster ranges
+    const uint32_t maxLights = m_Settings.maxLightsPerCluster;
+    m_ClusterRanges.resize(numClusters);
+    uint32_t offset = 0;
+    for (uint32_t cluster = 0; cluster < numClusters; cluster++)
+    {
+        uint32_t count = clusterCounts[cluster];
+        m_Stats.maxLightsInCluster = std::max(m_Stats.maxLightsInCluster, count);
+        if (count > maxLights)
+        {
+            ++m_Stats.overflowedClusters;
+            count = maxLights;
+        }
+
+        m_ClusterRanges[cluster] = uint2(offset, 0u);
+        offset += count;
+    }
+
+    m_LightIndices.resize(offset);
+    for (const uint2& pair : pairs)
+    {
+        uint2& range = m_ClusterRanges[pair.x];
+        if (range.y < maxLights)
+        {
+            m_LightIndices[range.x + range.y] = pair.y;
+            ++range.y;
+        }
+    }
+
+    m_Stats.numClusters = numClusters;
+    m_Stats.numLightIndices = offset;
+
+    // Warn once when the clusters start overflowing, and again after a build without overflow
+    if (m_Stats.overflowedClusters > 0 && !m_OverflowReported)
+    {
+        log::warning("LightClusterGrid: %u clusters have more than %u lights (up to %u), the extra lights are ignored. "
+            "Increase LightClusterSettings::maxLightsPerCluster to avoid missing lights.",
+            m_Stats.overflowedClusters, maxLights, m_Stats.maxLightsInCluster);
+    }
+    m_OverflowReported = m_Stats.overflowedClusters > 0;
+}
+
+void LightClusterGrid::FillConstants(LightClusterConstants& constants) const
+{
+    constants.gridSize = m_GridSize;
+    constants.tileSize = m_GridSize.x * m_GridSize.y > 1 ? m_Settings.tileSize : ~0u;
+    constants.nearDepth = m_GridSize.z > 1 ? m_Settings.nearDepth : FLT_MAX;
+    constants.sliceScale = m_SliceScale;
+    constants.sliceBias = m_SliceBias;
+    constants.numGlobalLights = m_NumGlobalLights;
+}
+
+uint32_t LightClusterGrid::GetClusterIndex(float2 pixelPosition, float viewDepth) const
+{
+    if (m_GridSize.z <= 1 && m_GridSize.x * m_GridSize.y <= 1)
+        return 0;
+
+    uint32_t tileX = std::min(uint32_t(std::max(pixelPosition.x, 0.f)) / m_Settings.tileSize, m_GridSize.x - 1);
+    uint32_t tileY = std::min(uint32_t(std::max(pixelPosition.y, 0.f)) / m_Settings.tileSize, m_GridSize.y - 1);
+
+    uint32_t slice = 0;
+    if (viewDepth >= m_Settings.nearDepth)
+    {
+        float sliceFloat = std::log2(viewDepth) * m_SliceScale + m_SliceBias;
+        slice = std::min(uint32_t(std::max(sliceFloat, 0.f)) + 1, m_GridSize.z - 1);
+    }
+
+    return (slice * m_GridSize.y + tileY) * m_GridSize.x + tileX;
+}
+
+bool donut::engine::EnsureLightBufferCapacity(nvrhi::IDevice* device, nvrhi::BufferHandle& buffer, size_t numElements, size_t elementSize, const char* debugName)
+{
+    numElements = std::max<size_t>(numElements, 1);
+
+    if (buffer && buffer->getDesc().byteSize >= numElements * elementSize)
+        return false;
+
+    if (buffer)
+        numElements = std::max(numElements, size_t(buffer->getDesc().byteSize / elementSize) * 2);
+
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = numElements * elementSize;
+    bufferDesc.structStride = uint32_t(elementSize);
+    bufferDesc.debugName = debugName;
+    bufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    bufferDesc.keepInitialState = true;
+    buffer = device->createBuffer(bufferDesc);
+
+    return true;
+}
@@ -161,6 +161,26 @@ namespace donut::engine
         constants.padding1 = uint3(0, 0, 0);
     }
 
+    void Material::UpdateBindingHash()
+    {
+        auto hashTexture = [](size_t& hash, const std::shared_ptr<LoadedTexture>& texture)
+        {
+            nvrhi::hash_combine(hash, texture ? texture->texture.Get() : nullptr);
+        };
+
+        size_t hash = 0;
+        hashTexture(hash, baseOrDiffuseTexture);
+        hashTexture(hash, metalRoughOrSpecularTexture);
+        hashTexture(hash, normalTexture);
+        hashTexture(hash, emissiveTexture);
+        hashTexture(hash, occlusionTexture);
+        hashTexture(hash, transmissionTexture);
+        hashTexture(hash, opacityTexture);
+        nvrhi::hash_combine(hash, materialConstants.Get());
+
+        bindingHash = hash;
+    }
+
     bool Material::SetProperty(const std::string& name, const dm::float4& value)
     {
 #define FLOAT3_PROPERTY(pname) if (name == #pname) { pname = value.xyz(); dirty = true; return true; }
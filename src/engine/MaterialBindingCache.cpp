@@ -84,25 +84,32 @@ nvrhi::IBindingLayout* donut::engine::MaterialBindingCache::GetLayout() const
     return m_BindingLayout;
 }
 
-nvrhi::IBindingSet* donut::engine::MaterialBindingCache::GetMaterialBindingSet(const Material* material)
+nvrhi::BindingSetHandle donut::engine::MaterialBindingCache::GetMaterialBindingSet(const Material* material)
 {
-    std::lock_guard<std::mutex> lockGuard(m_Mutex);
+    const size_t hash = std::hash<const Material*>()(material);
 
-    nvrhi::BindingSetHandle& bindingSet = m_BindingSets[material];
+    // The entry is copied with a reference to the binding set, which keeps it alive if it gets evicted
+    MaterialBindingSet entry = m_BindingSets.Find(material, hash);
+    if (entry.bindingSet && entry.materialHash == material->bindingHash)
+        return entry.bindingSet;
 
-    if (bindingSet)
-        return bindingSet;
+    // Missing or stale binding set: create it without holding the shard lock, then store it unless another
+    // thread has stored one for the same material state in the meantime
+    MaterialBindingSet created;
+    created.bindingSet = CreateMaterialBindingSet(material);
+    created.materialHash = material->bindingHash;
 
-    bindingSet = CreateMaterialBindingSet(material);
-
-    return bindingSet;
+    return m_BindingSets.Update(material, hash, [&created](MaterialBindingSet& cached)
+    {
+        if (!cached.bindingSet || cached.materialHash != created.materialHash)
+            cached = created;
+        return cached.bindingSet;
+    });
 }
 
 void donut::engine::MaterialBindingCache::Clear()
 {
-    std::lock_guard<std::mutex> lockGuard(m_Mutex);
-
-    m_BindingSets.clear();
+    m_BindingSets.Clear();
 }
 
 nvrhi::BindingSetItem MaterialBindingCache::GetTextureBindingSetItem(uint32_t slot, const std::shared_ptr<LoadedTexture>& texture) const
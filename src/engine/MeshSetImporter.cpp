@@ -0,0 +1,429 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/MeshSetImporter.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/SceneTypes.h>
+#include <donut/core/chunk/chunk.h>
+#include <donut/core/math/math.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/core/log.h>
+#include <donut/core/trace.h>
+#include <nvrhi/common/misc.h>
+#include <unordered_map>
+
+using namespace donut::math;
+using namespace donut::vfs;
+using namespace donut::engine;
+
+namespace
+{
+    constexpr uint32_t c_InvalidId = ~0u;
+
+    // Same transform composition as SceneGraphNode::UpdateLocalTransform
+    affine3 GetLocalTransform(const SceneGraphNode& node)
+    {
+        daffine3 transform = scaling(node.GetScaling());
+        transform *= node.GetRotation().toAffine();
+        transform *= translation(node.GetTranslation());
+        return affine3(transform);
+    }
+}
+
+bool donut::engine::IsMeshSetFile(const std::filesystem::path& fileName)
+{
+    return fileName.extension() == c_MeshSetExtension;
+}
+
+bool donut::engine::ExportMeshSet(
+    IFileSystem& fs,
+    const std::filesystem::path& fileName,
+    const SceneImportResult& model)
+{
+    if (!model.rootNode)
+    {
+        log::error("Cannot export mesh set '%s': the model is empty.", fileName.generic_string().c_str());
+        return false;
+    }
+
+    std::vector<chunk::MeshNode> nodes;
+    std::vector<chunk::MeshInfo> meshInfos;
+    std::vector<chunk::MeshInstance> instances;
+    std::vector<SceneGraphNode*> graphNodes;
+    std::vector<std::shared_ptr<MeshInfo>> nodeMeshes;
+
+    std::unordered_map<const SceneGraphNode*, uint32_t> nodeIndices;
+    std::unordered_map<const MeshInfo*, std::pair<uint32_t, uint32_t>> meshInfoRanges; // first, count
+    std::unordered_map<const Material*, uint32_t> materialIds;
+    std::shared_ptr<BufferGroup> buffers;
+    bool skippedMeshes = false;
+
+    auto addMesh = [&](const std::shared_ptr<MeshInfo>& mesh) -> std::pair<uint32_t, uint32_t>
+    {
+        auto it = meshInfoRanges.find(mesh.get());
+        if (it != meshInfoRanges.end())
+            return it->second;
+
+        std::pair<uint32_t, uint32_t> range(uint32_t(meshInfos.size()), 0);
+
+        if (mesh->type != MeshType::Triangles || !mesh->buffers || (buffers && mesh->buffers != buffers))
+        {
+            skippedMeshes = true;
+            meshInfoRanges[mesh.get()] = range;
+            return range;
+        }
+
+        buffers = mesh->buffers;
+
+        for (const auto& geometry : mesh->geometries)
+        {
+            chunk::MeshInfo& info = meshInfos.emplace_back();
+            memset(&info, 0, sizeof(info));
+            info.name = mesh->name.c_str();
+            info.materialName = geometry->material ? geometry->material->name.c_str() : nullptr;
+            info.materialId = c_InvalidId;
+            if (geometry->material)
+            {
+                auto [material, inserted] = materialIds.try_emplace(geometry->material.get(), uint32_t(materialIds.size()));
+                info.materialId = material->second;
+            }
+            info.bbox = geometry->objectSpaceBounds;
+            info.firstVertex = mesh->vertexOffset + geometry->vertexOffsetInMesh;
+            info.numVertices = geometry->numVertices;
+            info.firstIndex = mesh->indexOffset + geometry->indexOffsetInMesh;
+            info.numIndices = geometry->numIndices;
+        }
+
+        range.second = uint32_t(mesh->geometries.size());
+        meshInfoRanges[mesh.get()] = range;
+        return range;
+    };
+
+    // Nodes in depth-first order, with their world transforms
+
+    for (SceneGraphWalker walker(model.rootNode.get()); walker; walker.Next(true))
+    {
+        const uint32_t nodeIndex = uint32_t(nodes.size());
+        auto parent = walker->GetParent() ? nodeIndices.find(walker->GetParent()) : nodeIndices.end();
+
+        chunk::MeshNode& node = nodes.emplace_back();
+        memset(&node, 0, sizeof(node));
+        node.name = walker->GetName().c_str();
+        node.parentId = parent != nodeIndices.end() ? parent->second : c_InvalidId;
+        node.siblingId = c_InvalidId;
+        node.instanceId = c_InvalidId;
+        node.transform = GetLocalTransform(*walker.Get());
+        node.ctm = parent != nodeIndices.end() ? node.transform * nodes[parent->second].ctm : node.transform;
+        node.bbox = box3::empty();
+
+        std::shared_ptr<MeshInfo> mesh;
+        const auto& leaf = walker->GetLeaf();
+        if (auto skinnedInstance = std::dynamic_pointer_cast<SkinnedMeshInstance>(leaf))
+            mesh = skinnedInstance->GetPrototypeMesh();
+        else if (auto meshInstance = std::dynamic_pointer_cast<MeshInstance>(leaf))
+            mesh = meshInstance->GetMesh();
+
+        nodeIndices[walker.Get()] = nodeIndex;
+        graphNodes.push_back(walker.Get());
+        nodeMeshes.push_back(mesh);
+    }
+
+    for (uint32_t nodeIndex = 0; nodeIndex < uint32_t(graphNodes.size()); ++nodeIndex)
+    {
+        const SceneGraphNode* graphNode = graphNodes[nodeIndex];
+        for (size_t child = 0; child + 1 < graphNode->GetNumChildren(); ++child)
+            nodes[nodeIndices[graphNode->GetChild(child)]].siblingId = nodeIndices[graphNode->GetChild(child + 1)];
+
+        if (!nodeMeshes[nodeIndex])
+            continue;
+
+        // One chunk instance per geometry of the mesh, all referencing the same node
+        auto [firstInfo, numInfos] = addMesh(nodeMeshes[nodeIndex]);
+        chunk::MeshNode& node = nodes[nodeIndex];
+        for (uint32_t info = firstInfo; info < firstInfo + numInfos; ++info)
+        {
+            if (node.instanceId == c_InvalidId)
+                node.instanceId = uint32_t(instances.size());
+
+            chunk::MeshInstance& instance = instances.emplace_back();
+            memset(&instance, 0, sizeof(instance));
+            instance.name = node.name;
+            instance.minfoId = info;
+            instance.nodeId = nodeIndex;
+            instance.transform = node.ctm;
+            instance.bbox = meshInfos[info].bbox * node.ctm;
+            instance.center = instance.bbox.center();
+
+            node.bbox |= instance.bbox;
+        }
+    }
+
+    // Children are stored after their parents, so the bounds can be accumulated in reverse order
+    for (size_t nodeIndex = nodes.size(); nodeIndex-- > 1; )
+    {
+        chunk::MeshNode& node = nodes[nodeIndex];
+        node.center = node.bbox.isempty() ? node.ctm.m_translation : node.bbox.center();
+        if (node.parentId != c_InvalidId)
+            nodes[node.parentId].bbox |= node.bbox;
+    }
+    nodes[0].center = nodes[0].bbox.isempty() ? nodes[0].ctm.m_translation : nodes[0].bbox.center();
+
+    if (skippedMeshes)
+    {
+        log::warning("Some meshes in '%s' are not triangle meshes or use separate buffers, they are not exported.",
+            fileName.generic_string().c_str());
+    }
+
+    if (!buffers || buffers->indexData.empty() || buffers->positionData.empty())
+    {
+        log::error("Cannot export mesh set '%s': the model has no meshes with vertex data on the CPU. "
+            "Export the model right after importing it.", fileName.generic_string().c_str());
+        return false;
+    }
+
+    const std::string name = fileName.stem().generic_string();
+
+    chunk::MeshSet mset;
+    mset.type = chunk::MeshSetBase::MESH;
+    mset.name = name.c_str();
+    mset.nverts = uint32_t(buffers->positionData.size());
+    mset.streams.position = buffers->positionData.data();
+    if (buffers->normalData.size() == mset.nverts)
+        mset.streams.normal = buffers->normalData.data();
+    if (buffers->tangentData.size() == mset.nverts)
+        mset.streams.tangent = buffers->tangentData.data();
+    if (buffers->texcoord1Data.size() == mset.nverts)
+        mset.streams.texcoord0 = buffers->texcoord1Data.data();
+    if (buffers->texcoord2Data.size() == mset.nverts)
+        mset.streams.texcoord1 = buffers->texcoord2Data.data();
+    mset.indices = buffers->indexData.data();
+    mset.nindices = uint32_t(buffers->indexData.size());
+    mset.meshInfos = meshInfos.data();
+    mset.nmeshInfos = uint32_t(meshInfos.size());
+    mset.instances = instances.data();
+    mset.ninstances = uint32_t(instances.size());
+    mset.nodes = nodes.data();
+    mset.nnodes = uint32_t(nodes.size());
+    mset.rootId = 0;
+    mset.bbox = nodes[0].bbox;
+
+    auto blob = chunk::serialize(mset);
+    if (!blob)
+        return false;
+
+    if (!fs.writeFile(fileName, blob->data(), blob->size()))
+    {
+        log::error("Couldn't write file '%s'", fileName.generic_string().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+MeshSetImporter::MeshSetImporter(std::shared_ptr<IFileSystem> fs, std::shared_ptr<SceneTypeFactory> sceneTypeFactory)
+    : m_fs(std::move(fs))
+    , m_SceneTypeFactory(std::move(sceneTypeFactory))
+{
+}
+
+bool MeshSetImporter::Load(
+    const std::filesystem::path& fileName,
+    TextureCache& textureCache,
+    SceneLoadingStats& stats,
+    tf::Executor* executor,
+    SceneImportResult& result) const
+{
+    DONUT_TRACE_FUNCTION();
+
+    result.rootNode.reset();
+
+    const std::string normalizedFileName = fileName.lexically_normal().generic_string();
+
+    // The chunk reader resolves the string references in place, so the blob must be writable and cannot be
+    // a read-only file mapping. The streams are still used directly from this blob.
+    std::shared_ptr<IBlob> blob = m_fs->readFile(fileName);
+    if (!blob)
+    {
+        log::error("Couldn't read file '%s'", normalizedFileName.c_str());
+        return false;
+    }
+
+    std::shared_ptr<const chunk::MeshSetBase> msetBase = chunk::deserialize(blob, normalizedFileName.c_str());
+    if (!msetBase)
+        return false;
+
+    if (msetBase->type != chunk::MeshSetBase::MESH)
+    {
+        log::error("Mesh set '%s' contains meshlets, which are not supported by the scene", normalizedFileName.c_str());
+        return false;
+    }
+
+    const chunk::MeshSet& mset = static_cast<const chunk::MeshSet&>(*msetBase);
+
+    // Buffers, pointing into the file blob
+
+    auto buffers = std::make_shared<BufferGroup>();
+    buffers->dataBlob = mset.blob;
+    buffers->indexDataView = mset.indices;
+    buffers->indexCount = mset.nindices;
+
+    uint64_t vertexBufferSize = 0;
+    auto addStream = [&buffers, &vertexBufferSize](VertexAttribute attr, const void* data, size_t size)
+    {
+        if (!data)
+            return;
+
+        // Keep the ranges aligned like Scene::CreateMeshBuffers does
+        buffers->getVertexBufferRange(attr) = nvrhi::BufferRange(vertexBufferSize, size);
+        buffers->vertexDataViews[size_t(attr)] = data;
+        vertexBufferSize += nvrhi::align(size, size_t(16));
+    };
+
+    addStream(VertexAttribute::Position, mset.streams.position, mset.nverts * sizeof(float3));
+    addStream(VertexAttribute::Normal, mset.streams.normal, mset.nverts * sizeof(uint32_t));
+    addStream(VertexAttribute::Tangent, mset.streams.tangent, mset.nverts * sizeof(uint32_t));
+    addStream(VertexAttribute::TexCoord1, mset.streams.texcoord0, mset.nverts * sizeof(float2));
+    addStream(VertexAttribute::TexCoord2, mset.streams.texcoord1, mset.nverts * sizeof(float2));
+
+    // Materials and meshes
+
+    std::unordered_map<uint32_t, std::shared_ptr<Material>> materials;
+    std::vector<std::shared_ptr<MeshInfo>> meshes(mset.nmeshInfos);
+
+    for (uint32_t index = 0; index < mset.nmeshInfos; ++index)
+    {
+        const chunk::MeshInfo& src = mset.meshInfos[index];
+        if (uint64_t(src.firstVertex) + src.numVertices > mset.nverts ||
+            uint64_t(src.firstIndex) + src.numIndices > mset.nindices)
+        {
+            log::error("Mesh set '%s': mesh info %u is out of bounds", normalizedFileName.c_str(), index);
+            return false;
+        }
+
+        std::shared_ptr<Material>& material = materials[src.materialId];
+        if (!material)
+        {
+            material = m_SceneTypeFactory->CreateMaterial();
+            material->name = src.materialName ? src.materialName : "(empty)";
+            material->modelFileName = normalizedFileName;
+            material->materialIndexInModel = int(src.materialId);
+        }
+
+        auto geometry = m_SceneTypeFactory->CreateMeshGeometry();
+        geometry->material = material;
+        geometry->numIndices = src.numIndices;
+        geometry->numVertices = src.numVertices;
+        geometry->objectSpaceBounds = src.bbox;
+
+        auto mesh = m_SceneTypeFactory->CreateMesh();
+        mesh->name = src.name ? src.name : "";
+        mesh->buffers = buffers;
+        mesh->indexOffset = src.firstIndex;
+        mesh->vertexOffset = src.firstVertex;
+        mesh->totalIndices = src.numIndices;
+        mesh->totalVertices = src.numVertices;
+        mesh->objectSpaceBounds = src.bbox;
+        mesh->geometries.push_back(geometry);
+
+        meshes[index] = mesh;
+    }
+
+    // Nodes
+
+    std::shared_ptr<SceneGraph> graph = std::make_shared<SceneGraph>();
+    std::vector<std::shared_ptr<SceneGraphNode>> nodes(mset.nnodes);
+
+    auto setNodeTransform = [](SceneGraphNode& node, const affine3& transform)
+    {
+        float3 translation, scaling;
+        quat rotation;
+        decomposeAffine(transform, &translation, &rotation, &scaling);
+
+        const double3 dtranslation = double3(translation);
+        const dquat drotation = dquat(rotation);
+        const double3 dscaling = double3(scaling);
+        node.SetTransform(&dtranslation, &drotation, &dscaling);
+    };
+
+    for (uint32_t index = 0; index < mset.nnodes; ++index)
+    {
+        const chunk::MeshNode& src = mset.nodes[index];
+        auto node = std::make_shared<SceneGraphNode>();
+        nodes[index] = node;
+
+        if (src.name)
+            node->SetName(src.name);
+        setNodeTransform(*node, src.transform);
+    }
+
+    std::shared_ptr<SceneGraphNode> root;
+    for (uint32_t index = 0; index < mset.nnodes; ++index)
+    {
+        const uint32_t parent = mset.nodes[index].parentId;
+        if (parent < mset.nnodes && parent != index)
+            graph->Attach(nodes[parent], nodes[index]);
+        else if (index == mset.rootId)
+            root = nodes[index];
+    }
+
+    if (!root)
+    {
+        root = std::make_shared<SceneGraphNode>();
+        root->SetName(mset.name ? mset.name : fileName.stem().generic_string());
+        for (uint32_t index = 0; index < mset.nnodes; ++index)
+        {
+            if (mset.nodes[index].parentId >= mset.nnodes)
+                graph->Attach(root, nodes[index]);
+        }
+    }
+
+    // Instances: the first one of a node becomes its leaf, others go into child nodes
+
+    for (uint32_t index = 0; index < mset.ninstances; ++index)
+    {
+        const chunk::MeshInstance& src = mset.instances[index];
+        if (src.minfoId >= mset.nmeshInfos)
+            continue;
+
+        std::shared_ptr<SceneGraphNode> node = src.nodeId < mset.nnodes ? nodes[src.nodeId] : nullptr;
+        if (!node || node->GetLeaf())
+        {
+            auto parent = node ? node : root;
+            const bool hasNode = node != nullptr;
+            node = std::make_shared<SceneGraphNode>();
+            if (src.name)
+                node->SetName(src.name);
+
+            // Instances without a node carry their own world transform
+            if (!hasNode)
+                setNodeTransform(*node, src.transform);
+
+            graph->Attach(parent, node);
+        }
+
+        node->SetLeaf(m_SceneTypeFactory->CreateMeshInstance(meshes[src.minfoId]));
+    }
+
+    result.rootNode = root;
+
+    return true;
+}
@@ -0,0 +1,464 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/MeshSimplifier.h>
+#include <donut/engine/SceneTypes.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+
+using namespace donut::math;
+using namespace donut::engine;
+
+namespace
+{
+    // Symmetric 4x4 matrix that evaluates the sum of squared distances to a set of planes
+    struct Quadric
+    {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+        double a11 = 0, a12 = 0, a13 = 0;
+        double a22 = 0, a23 = 0;
+        double a33 = 0;
+
+        static Quadric FromPlane(double a, double b, double c, double d)
+        {
+            Quadric q;
+            q.a00 = a * a; q.a01 = a * b; q.a02 = a * c; q.a03 = a * d;
+            q.a11 = b * b; q.a12 = b * c; q.a13 = b * d;
+            q.a22 = c * c; q.a23 = c * d;
+            q.a33 = d * d;
+            return q;
+        }
+
+        void operator+=(const Quadric& q)
+        {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+            a11 += q.a11; a12 += q.a12; a13 += q.a13;
+            a22 += q.a22; a23 += q.a23;
+            a33 += q.a33;
+        }
+
+        [[nodiscard]] double Evaluate(const float3& p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            return a00 * x * x + 2.0 * (a01 * x * y + a02 * x * z + a03 * x)
+                 + a11 * y * y + 2.0 * (a12 * y * z + a13 * y)
+                 + a22 * z * z + 2.0 * a23 * z
+                 + a33;
+        }
+    };
+
+    struct Collapse
+    {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    class Simplifier
+    {
+    public:
+        Simplifier(const float3* positions, size_t numVertices, const uint32_t* indices, size_t numIndices)
+            : m_Positions(positions)
+            , m_Quadrics(numVertices)
+            , m_VertexTriangles(numVertices)
+            , m_Locked(numVertices, false)
+            , m_Removed(numVertices, false)
+        {
+            size_t numTriangles = numIndices / 3;
+            m_Triangles.reserve(numTriangles * 3);
+
+            for (size_t triangle = 0; triangle < numTriangles; triangle++)
+            {
+                uint32_t a = indices[triangle * 3 + 0];
+                uint32_t b = indices[triangle * 3 + 1];
+                uint32_t c = indices[triangle * 3 + 2];
+
+                // Triangles that are already degenerate are dropped
+                if (a == b || b == c || a == c)
+                    continue;
+
+                uint32_t index = uint32_t(m_Triangles.size() / 3);
+                m_Triangles.push_back(a);
+                m_Triangles.push_back(b);
+                m_Triangles.push_back(c);
+                m_VertexTriangles[a].push_back(index);
+                m_VertexTriangles[b].push_back(index);
+                m_VertexTriangles[c].push_back(index);
+
+                float3 normal = cross(positions[b] - positions[a], positions[c] - positions[a]);
+                float normalLength = length(normal);
+                if (normalLength > 0.f)
+                {
+                    normal /= normalLength;
+                    Quadric q = Quadric::FromPlane(normal.x, normal.y, normal.z, -dot(normal, positions[a]));
+                    m_Quadrics[a] += q;
+                    m_Quadrics[b] += q;
+                    m_Quadrics[c] += q;
+                }
+            }
+
+            m_TriangleRemoved.resize(m_Triangles.size() / 3, false);
+            m_RemainingIndices = m_Triangles.size();
+
+            LockSeamsAndBorders(numVertices);
+        }
+
+        void Run(size_t targetNumIndices, double maxCost)
+        {
+            std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+            auto pushEdge = [this, &queue](uint32_t a, uint32_t b)
+            {
+                if (!m_Locked[a])
+                    queue.push({ GetCost(a, b), a, b });
+                if (!m_Locked[b])
+                    queue.push({ GetCost(b, a), b, a });
+            };
+
+            for (size_t i = 0; i < m_Triangles.size(); i += 3)
+            {
+                pushEdge(m_Triangles[i + 0], m_Triangles[i + 1]);
+                pushEdge(m_Triangles[i + 1], m_Triangles[i + 2]);
+                pushEdge(m_Triangles[i + 2], m_Triangles[i + 0]);
+            }
+
+            while (m_RemainingIndices > targetNumIndices && !queue.empty())
+            {
+                Collapse collapse = queue.top();
+                queue.pop();
+
+                if (m_Removed[collapse.from] || m_Removed[collapse.to])
+                    continue;
+
+                // The quadrics only grow, so an outdated entry can only have a cost that is too low
+                double cost = GetCost(collapse.from, collapse.to);
+                if (cost > collapse.cost)
+                {
+                    queue.push({ cost, collapse.from, collapse.to });
+                    continue;
+                }
+
+                if (cost > maxCost)
+                    break;
+
+                if (!IsCollapseValid(collapse.from, collapse.to))
+                    continue;
+
+                PerformCollapse(collapse.from, collapse.to);
+                m_MaxCost = std::max(m_MaxCost, cost);
+
+                for (uint32_t triangle : m_VertexTriangles[collapse.to])
+                {
+                    const uint32_t* corners = &m_Triangles[triangle * 3];
+                    for (int corner = 0; corner < 3; corner++)
+                    {
+                        if (corners[corner] != collapse.to)
+                            pushEdge(collapse.to, corners[corner]);
+                    }
+                }
+            }
+        }
+
+        [[nodiscard]] std::vector<uint32_t> GetIndices() const
+        {
+            std::vector<uint32_t> result;
+            result.reserve(m_RemainingIndices);
+
+            for (size_t triangle = 0; triangle < m_TriangleRemoved.size(); triangle++)
+            {
+                if (!m_TriangleRemoved[triangle])
+                    result.insert(result.end(), m_Triangles.begin() + triangle * 3, m_Triangles.begin() + triangle * 3 + 3);
+            }
+
+            return result;
+        }
+
+        [[nodiscard]] size_t GetRemainingIndices() const { return m_RemainingIndices; }
+        [[nodiscard]] float GetError() const { return float(std::sqrt(m_MaxCost)); }
+
+    private:
+        const float3* m_Positions;
+        std::vector<uint32_t> m_Triangles;
+        std::vector<bool> m_TriangleRemoved;
+        std::vector<Quadric> m_Quadrics;
+        std::vector<std::vector<uint32_t>> m_VertexTriangles; // may contain removed triangles
+        std::vector<bool> m_Locked;
+        std::vector<bool> m_Removed;
+        size_t m_RemainingIndices = 0;
+        double m_MaxCost = 0.0;
+
+        [[nodiscard]] double GetCost(uint32_t from, uint32_t to) const
+        {
+            const float3& p = m_Positions[to];
+            return std::max(0.0, m_Quadrics[from].Evaluate(p) + m_Quadrics[to].Evaluate(p));
+        }
+
+        void LockSeamsAndBorders(size_t numVertices)
+        {
+            // Vertices that share a position with other vertices are on an attribute seam
+            std::vector<uint32_t> order(numVertices);
+            std::iota(order.begin(), order.end(), 0u);
+            auto lessPosition = [this](uint32_t a, uint32_t b)
+            {
+                const float3& pa = m_Positions[a];
+                const float3& pb = m_Positions[b];
+                if (pa.x != pb.x) return pa.x < pb.x;
+                if (pa.y != pb.y) return pa.y < pb.y;
+                return pa.z < pb.z;
+            };
+            std::sort(order.begin(), order.end(), lessPosition);
+
+            for (size_t i = 1; i < order.size(); i++)
+            {
+                if (all(m_Positions[order[i - 1]] == m_Positions[order[i]]))
+                {
+                    m_Locked[order[i - 1]] = true;
+                    m_Locked[order[i]] = true;
+                }
+            }
+
+            // Edges that don't have exactly two triangles are on a border or non-manifold
+            std::unordered_map<uint64_t, uint32_t> edgeTriangles;
+            edgeTriangles.reserve(m_Triangles.size());
+            for (size_t i = 0; i < m_Triangles.size(); i += 3)
+            {
+                for (int edge = 0; edge < 3; edge++)
+                {
+                    uint32_t a = m_Triangles[i + edge];
+                    uint32_t b = m_Triangles[i + (edge + 1) % 3];
+                    ++edgeTriangles[(uint64_t(std::min(a, b)) << 32) | std::max(a, b)];
+                }
+            }
+
+            for (const auto& [edge, count] : edgeTriangles)
+            {
+                if (count != 2)
+                {
+                    m_Locked[uint32_t(edge >> 32)] = true;
+                    m_Locked[uint32_t(edge)] = true;
+                }
+            }
+        }
+
+        void GetNeighbors(uint32_t vertex, std::vector<uint32_t>& neighbors) const
+        {
+            neighbors.clear();
+            for (uint32_t triangle : m_VertexTriangles[vertex])
+            {
+                if (m_TriangleRemoved[triangle])
+                    continue;
+
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    uint32_t other = m_Triangles[triangle * 3 + corner];
+                    if (other != vertex)
+                        neighbors.push_back(other);
+                }
+            }
+            std::sort(neighbors.begin(), neighbors.end());
+            neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        }
+
+        [[nodiscard]] bool IsCollapseValid(uint32_t from, uint32_t to)
+        {
+            // The vertices that are connected to both ends must be the opposite corners of the triangles on the edge,
+            // otherwise the collapse pinches the surface
+            GetNeighbors(from, m_FromNeighbors);
+            GetNeighbors(to, m_ToNeighbors);
+
+            if (!std::binary_search(m_FromNeighbors.begin(), m_FromNeighbors.end(), to))
+                return false;
+
+            size_t commonNeighbors = 0;
+            for (uint32_t vertex : m_FromNeighbors)
+            {
+                if (std::binary_search(m_ToNeighbors.begin(), m_ToNeighbors.end(), vertex))
+                    ++commonNeighbors;
+            }
+
+            size_t edgeTriangles = 0;
+            const float3& target = m_Positions[to];
+            for (uint32_t triangle : m_VertexTriangles[from])
+            {
+                if (m_TriangleRemoved[triangle])
+                    continue;
+
+                const uint32_t* corners = &m_Triangles[triangle * 3];
+                if (corners[0] == to || corners[1] == to || corners[2] == to)
+                {
+                    ++edgeTriangles;
+                    continue;
+                }
+
+                // The remaining triangles must not flip or become degenerate
+                float3 p[3];
+                float3 q[3];
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    p[corner] = m_Positions[corners[corner]];
+                    q[corner] = (corners[corner] == from) ? target : p[corner];
+                }
+
+                float3 normalBefore = cross(p[1] - p[0], p[2] - p[0]);
+                float3 normalAfter = cross(q[1] - q[0], q[2] - q[0]);
+                if (dot(normalBefore, normalAfter) <= 0.f)
+                    return false;
+            }
+
+            return commonNeighbors <= edgeTriangles;
+        }
+
+        void PerformCollapse(uint32_t from, uint32_t to)
+        {
+            for (uint32_t triangle : m_VertexTriangles[from])
+            {
+                if (m_TriangleRemoved[triangle])
+                    continue;
+
+                uint32_t* corners = &m_Triangles[triangle * 3];
+                if (corners[0] == to || corners[1] == to || corners[2] == to)
+                {
+                    m_TriangleRemoved[triangle] = true;
+                    m_RemainingIndices -= 3;
+                    continue;
+                }
+
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    if (corners[corner] == from)
+                        corners[corner] = to;
+                }
+                m_VertexTriangles[to].push_back(triangle);
+            }
+
+            m_VertexTriangles[from].clear();
+            m_Removed[from] = true;
+            m_Quadrics[to] += m_Quadrics[from];
+
+            auto& toTriangles = m_VertexTriangles[to];
+            toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(),
+                [this](uint32_t triangle) { return m_TriangleRemoved[triangle]; }), toTriangles.end());
+        }
+
+        std::vector<uint32_t> m_FromNeighbors;
+        std::vector<uint32_t> m_ToNeighbors;
+    };
+}
+
+std::vector<uint32_t> donut::engine::SimplifyMesh(
+    const float3* positions,
+    size_t numVertices,
+    const uint32_t* indices,
+    size_t numIndices,
+    size_t targetNumIndices,
+    float maxError,
+    float* resultError)
+{
+    if (resultError)
+        *resultError = 0.f;
+
+    for (size_t i = 0; i < numIndices; i++)
+    {
+        if (indices[i] >= numVertices)
+            return std::vector<uint32_t>(indices, indices + numIndices);
+    }
+
+    Simplifier simplifier(positions, numVertices, indices, numIndices);
+    simplifier.Run(targetNumIndices, double(maxError) * double(maxError));
+
+    if (resultError)
+        *resultError = simplifier.GetError();
+
+    return simplifier.GetIndices();
+}
+
+uint32_t donut::engine::GenerateMeshLods(MeshInfo& mesh, const MeshLodSettings& settings)
+{
+    mesh.lodErrors.clear();
+    for (const auto& geometry : mesh.geometries)
+        geometry->lods.clear();
+
+    if (!mesh.buffers || mesh.type != MeshType::Triangles || mesh.isMorphTargetAnimationMesh)
+        return 0;
+
+    std::vector<uint32_t>& indexData = mesh.buffers->indexData;
+    const std::vector<float3>& positionData = mesh.buffers->positionData;
+    if (indexData.empty() || positionData.empty())
+        return 0;
+
+    const float maxError = length(mesh.objectSpaceBounds.diagonal()) * settings.maxRelativeError;
+    std::vector<MeshGeometryLod> levelRanges(mesh.geometries.size());
+
+    for (uint32_t level = 1; level <= settings.numLevels; level++)
+    {
+        const float ratio = std::pow(settings.triangleRatio, float(level));
+        float levelError = mesh.lodErrors.empty() ? 0.f : mesh.lodErrors.back();
+        bool reduced = false;
+
+        for (size_t geometryIndex = 0; geometryIndex < mesh.geometries.size(); geometryIndex++)
+        {
+            const MeshGeometry& geometry = *mesh.geometries[geometryIndex];
+
+            MeshGeometryLod& range = levelRanges[geometryIndex];
+            range.indexOffsetInMesh = geometry.GetLodIndexOffset(level - 1);
+            range.numIndices = geometry.GetLodNumIndices(level - 1);
+
+            size_t firstIndex = size_t(mesh.indexOffset) + geometry.indexOffsetInMesh;
+            size_t firstVertex = size_t(mesh.vertexOffset) + geometry.vertexOffsetInMesh;
+            if (geometry.type != MeshGeometryPrimitiveType::Triangles ||
+                firstIndex + geometry.numIndices > indexData.size() ||
+                firstVertex + geometry.numVertices > positionData.size())
+                continue;
+
+            // Every level is simplified from the original geometry, so that its error is measured against it
+            size_t targetNumIndices = size_t(float(geometry.numIndices / 3) * ratio) * 3;
+            float error = 0.f;
+            std::vector<uint32_t> lodIndices = SimplifyMesh(positionData.data() + firstVertex, geometry.numVertices,
+                indexData.data() + firstIndex, geometry.numIndices, targetNumIndices, maxError, &error);
+
+            if (lodIndices.empty() || lodIndices.size() >= range.numIndices)
+                continue;
+
+            range.indexOffsetInMesh = uint32_t(indexData.size() - mesh.indexOffset);
+            range.numIndices = uint32_t(lodIndices.size());
+            indexData.insert(indexData.end(), lodIndices.begin(), lodIndices.end());
+
+            levelError = std::max(levelError, error);
+            reduced = true;
+        }
+
+        if (!reduced)
+            break;
+
+        for (size_t geometryIndex = 0; geometryIndex < mesh.geometries.size(); geometryIndex++)
+            mesh.geometries[geometryIndex]->lods.push_back(levelRanges[geometryIndex]);
+
+        mesh.lodErrors.push_back(levelError);
+    }
+
+    return uint32_t(mesh.lodErrors.size());
+}
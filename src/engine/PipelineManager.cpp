@@ -0,0 +1,223 @@
+/*
+* Copyright (c) 2014-2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/PipelineManager.h>
+#include <donut/core/log.h>
+#include <donut/core/trace.h>
+#include <algorithm>
+#include <chrono>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+using namespace donut::engine;
+
+static double GetTimeMs()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PipelineManager::PipelineManager(tf::Executor* executor)
+    : m_Executor(executor)
+{
+}
+
+PipelineManager::~PipelineManager()
+{
+    WaitForPendingPipelines();
+}
+
+size_t PipelineManager::EntryKeyHash::operator()(const EntryKey& entryKey) const
+{
+    size_t hash = 0;
+    nvrhi::hash_combine(hash, entryKey.owner);
+    nvrhi::hash_combine(hash, entryKey.key);
+    for (nvrhi::Format format : entryKey.framebufferInfo.colorFormats)
+        nvrhi::hash_combine(hash, format);
+    nvrhi::hash_combine(hash, entryKey.framebufferInfo.depthFormat);
+    nvrhi::hash_combine(hash, entryKey.framebufferInfo.sampleCount);
+    nvrhi::hash_combine(hash, entryKey.framebufferInfo.sampleQuality);
+    return hash;
+}
+
+uint64_t PipelineManager::RegisterOwner()
+{
+    return m_NextOwner.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PipelineManager::ReleaseOwner(uint64_t owner)
+{
+    WaitForPendingPipelines();
+
+    std::lock_guard<std::shared_mutex> guard(m_EntriesMutex);
+    for (auto it = m_Entries.begin(); it != m_Entries.end(); )
+    {
+        if (it->first.owner == owner)
+            it = m_Entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+void PipelineManager::CreatePipeline(const std::shared_ptr<Entry>& entry, const CreateGraphicsPipelineFunc& createFunc, double requestTime)
+{
+    DONUT_TRACE_ZONE("PipelineManager::CreatePipeline");
+
+    const double startTime = GetTimeMs();
+    nvrhi::GraphicsPipelineHandle pipeline = createFunc();
+    const double endTime = GetTimeMs();
+
+    entry->pipeline = pipeline;
+    entry->failed = !pipeline;
+    entry->ready.store(true, std::memory_order_release);
+
+    // The requests for a failed pipeline return null until Clear is called, e.g. after the shaders are reloaded
+    if (!pipeline)
+        log::error("PipelineManager: failed to create a graphics pipeline (key 0x%zx)", entry->key);
+
+    std::lock_guard<std::mutex> guard(m_StatsMutex);
+    if (pipeline)
+        ++m_Stats.createdPipelines;
+    else
+        ++m_Stats.failedPipelines;
+    m_Stats.totalCreationTimeMs += endTime - startTime;
+    m_Stats.maxCreationTimeMs = std::max(m_Stats.maxCreationTimeMs, endTime - startTime);
+    m_Stats.maxLatencyMs = std::max(m_Stats.maxLatencyMs, endTime - requestTime);
+}
+
+nvrhi::GraphicsPipelineHandle PipelineManager::GetGraphicsPipeline(uint64_t owner, size_t key, const nvrhi::FramebufferInfo& framebufferInfo,
+    const CreateGraphicsPipelineFunc& createFunc)
+{
+    m_Requests.fetch_add(1, std::memory_order_relaxed);
+
+    EntryKey entryKey;
+    entryKey.owner = owner;
+    entryKey.key = key;
+    entryKey.framebufferInfo = framebufferInfo;
+
+    std::shared_ptr<Entry> entry;
+    {
+        std::shared_lock<std::shared_mutex> guard(m_EntriesMutex);
+
+        auto it = m_Entries.find(entryKey);
+        if (it != m_Entries.end())
+            entry = it->second;
+    }
+
+    if (entry)
+    {
+        if (entry->ready.load(std::memory_order_acquire))
+        {
+            m_ReadyHits.fetch_add(1, std::memory_order_relaxed);
+            return entry->pipeline;
+        }
+
+        std::lock_guard<std::mutex> guard(m_StatsMutex);
+        ++m_Stats.pendingHits;
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::shared_mutex> guard(m_EntriesMutex);
+
+        // Another thread may have requested the same pipeline in the meantime
+        auto inserted = m_Entries.try_emplace(entryKey, nullptr);
+        if (!inserted.second)
+        {
+            entry = inserted.first->second;
+            if (entry->ready.load(std::memory_order_acquire))
+            {
+                m_ReadyHits.fetch_add(1, std::memory_order_relaxed);
+                return entry->pipeline;
+            }
+
+            std::lock_guard<std::mutex> statsGuard(m_StatsMutex);
+            ++m_Stats.pendingHits;
+            return nullptr;
+        }
+
+        entry = std::make_shared<Entry>();
+        entry->key = key;
+        inserted.first->second = entry;
+    }
+
+    const double requestTime = GetTimeMs();
+
+#ifdef DONUT_WITH_TASKFLOW
+    if (m_Executor)
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_PendingMutex);
+            ++m_PendingCount;
+        }
+
+        m_Executor->silent_async([this, entry, createFunc, requestTime]()
+        {
+            CreatePipeline(entry, createFunc, requestTime);
+
+            std::lock_guard<std::mutex> guard(m_PendingMutex);
+            --m_PendingCount;
+            m_PendingCondition.notify_all();
+        });
+
+        return nullptr;
+    }
+#endif
+
+    CreatePipeline(entry, createFunc, requestTime);
+
+    return entry->pipeline;
+}
+
+void PipelineManager::WaitForPendingPipelines()
+{
+    std::unique_lock<std::mutex> lock(m_PendingMutex);
+    m_PendingCondition.wait(lock, [this]() { return m_PendingCount == 0; });
+}
+
+void PipelineManager::Clear()
+{
+    WaitForPendingPipelines();
+
+    std::lock_guard<std::shared_mutex> guard(m_EntriesMutex);
+    m_Entries.clear();
+}
+
+PipelineManagerStats PipelineManager::GetStats() const
+{
+    PipelineManagerStats stats;
+    {
+        std::lock_guard<std::mutex> guard(m_StatsMutex);
+        stats = m_Stats;
+    }
+
+    stats.requests = m_Requests.load(std::memory_order_relaxed);
+    stats.readyHits = m_ReadyHits.load(std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> guard(m_PendingMutex);
+        stats.pendingPipelines = m_PendingCount;
+    }
+
+    return stats;
+}
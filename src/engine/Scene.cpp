@@ -35,12 +35,21 @@ this software is released into the Public Domain.
 */
 
 #include <donut/engine/Scene.h>
+#include <donut/engine/BakedScene.h>
 #include <donut/engine/GltfImporter.h>
+#include <donut/engine/MeshSetImporter.h>
+#include <donut/engine/SceneGraphLoader.h>
+#include <donut/engine/SkinningPalette.h>
+#include <donut/engine/View.h>
 #include <donut/core/json.h>
+#include <donut/core/json_reader.h>
 #include <donut/core/log.h>
+#include <donut/core/trace.h>
 #include <donut/core/string_utils.h>
+#include <donut/core/vfs/VFS.h>
 #include <nvrhi/common/misc.h>
 #include <json/value.h>
+#include <unordered_map>
 
 #include "donut/engine/ShaderFactory.h"
 
@@ -81,6 +90,12 @@ struct Scene::Resources
     std::vector<MaterialConstants> materialData;
     std::vector<GeometryData> geometryData;
     std::vector<InstanceData> instanceData;
+
+    SkinningPalette skinningPalette;
+    std::vector<SkinnedMeshInstance*> updatedSkinnedInstances;
+    std::vector<SkinnedMeshInstance*> allSkinnedInstances;
+    std::vector<uint32_t> updatedJointDepths; // LOD joint depth for each entry in updatedSkinnedInstances
+    bool jointLayoutChanged = false;
 };
 
 Scene::Scene(
@@ -102,6 +117,8 @@ Scene::Scene(
         m_SceneTypeFactory = std::make_shared<SceneTypeFactory>();
 
     m_GltfImporter = std::make_shared<GltfImporter>(m_fs, m_SceneTypeFactory);
+    m_BakedSceneLoader = std::make_shared<BakedSceneLoader>(m_fs, m_SceneTypeFactory);
+    m_MeshSetImporter = std::make_shared<MeshSetImporter>(m_fs, m_SceneTypeFactory);
 
     m_EnableBindlessResources = !!m_DescriptorTable;
     m_RayTracingSupported = m_Device->queryFeatureSupport(nvrhi::Feature::RayTracingAccelStruct);
@@ -150,7 +167,7 @@ bool Scene::LoadWithExecutor(const std::filesystem::path& sceneFileName, tf::Exe
     
     m_SceneGraph = std::make_shared<SceneGraph>();
 
-    if (sceneFileName.extension() == ".gltf" || sceneFileName.extension() == ".glb")
+    if (sceneFileName.extension() == ".gltf" || sceneFileName.extension() == ".glb" || IsBakedSceneFile(sceneFileName) || IsMeshSetFile(sceneFileName))
     {
         ++g_LoadingStats.ObjectsTotal;
         m_Models.resize(1);
@@ -175,22 +192,95 @@ bool Scene::LoadWithExecutor(const std::filesystem::path& sceneFileName, tf::Exe
 
         std::filesystem::path scenePath = sceneFileName.parent_path();
 
-        Json::Value documentRoot;
-        if (!json::LoadFromFile(*m_fs, sceneFileName, documentRoot))
+        std::shared_ptr<IBlob> data = m_fs->readFile(sceneFileName);
+        if (!data)
+        {
+            log::error("Couldn't read file %s", sceneFileName.generic_string().c_str());
+            return false;
+        }
+
+        json::Reader reader(static_cast<const char*>(data->data()), data->size());
+
+        if (reader.Peek() != json::Reader::ValueType::Object)
+        {
+            log::error("Unrecognized structure of the scene description file.");
             return false;
+        }
 
-        if (documentRoot.isObject())
+        if (RequiresSceneDocument())
         {
+            Json::Value documentRoot;
+            if (!reader.ReadValue(documentRoot))
+            {
+                log::error("Couldn't parse JSON file %s:\n%s", sceneFileName.generic_string().c_str(), reader.GetErrorMessage().c_str());
+                return false;
+            }
+
             if (!LoadCustomData(documentRoot, executor))
                 return false;
 
             LoadModels(documentRoot["models"], scenePath, executor);
             LoadSceneGraph(documentRoot["graph"], rootNode);
             LoadAnimations(documentRoot["animations"]);
+            return true;
         }
-        else
+
+        // The graph and animations are usually the bulk of the file, so they are not parsed into a document.
+        // Find them first and load them after the models, regardless of the order of sections in the file.
+        Json::Value documentRoot(Json::objectValue);
+        size_t graphOffset = 0;
+        size_t animationsOffset = 0;
+        bool hasGraph = false;
+        bool hasAnimations = false;
+
+        reader.BeginObject();
+        std::string_view key;
+        while (reader.NextMember(key))
         {
-            log::error("Unrecognized structure of the scene description file.");
+            if (key == "graph")
+            {
+                graphOffset = reader.GetOffset();
+                hasGraph = true;
+                reader.Skip();
+            }
+            else if (key == "animations")
+            {
+                animationsOffset = reader.GetOffset();
+                hasAnimations = true;
+                reader.Skip();
+            }
+            else
+                reader.ReadValue(documentRoot[std::string(key)]);
+        }
+
+        if (reader.HasError())
+        {
+            log::error("Couldn't parse JSON file %s:\n%s", sceneFileName.generic_string().c_str(), reader.GetErrorMessage().c_str());
+            return false;
+        }
+
+        if (!LoadCustomData(documentRoot, executor))
+            return false;
+
+        LoadModels(documentRoot["models"], scenePath, executor);
+
+        SceneGraphLoader loader(m_SceneGraph, m_SceneTypeFactory, m_Models);
+
+        if (hasGraph)
+        {
+            reader.SetOffset(graphOffset);
+            loader.LoadSceneGraph(reader, rootNode);
+        }
+
+        if (hasAnimations)
+        {
+            reader.SetOffset(animationsOffset);
+            loader.LoadAnimations(reader);
+        }
+
+        if (reader.HasError())
+        {
+            log::error("Couldn't parse JSON file %s:\n%s", sceneFileName.generic_string().c_str(), reader.GetErrorMessage().c_str());
             return false;
         }
     }
@@ -209,7 +299,7 @@ void Scene::LoadModelAsync(
         executor->async([this, index, executor, fileName]()
             {
                 SceneImportResult result;
-                m_GltfImporter->Load(fileName, *m_TextureCache, g_LoadingStats, executor, result);
+                LoadModel(fileName, executor, result);
                 ++g_LoadingStats.ObjectsLoaded;
                 m_Models[index] = result;
             });
@@ -218,12 +308,26 @@ void Scene::LoadModelAsync(
 #endif // DONUT_WITH_TASKFLOW
     {
         SceneImportResult result;
-        m_GltfImporter->Load(fileName, *m_TextureCache, g_LoadingStats, executor, result);
+        LoadModel(fileName, executor, result);
         ++g_LoadingStats.ObjectsLoaded;
         m_Models[index] = result;
     }
 }
 
+bool Scene::LoadModel(
+    const std::filesystem::path& fileName,
+    tf::Executor* executor,
+    SceneImportResult& result)
+{
+    if (IsBakedSceneFile(fileName))
+        return m_BakedSceneLoader->Load(fileName, *m_TextureCache, g_LoadingStats, executor, result);
+
+    if (IsMeshSetFile(fileName))
+        return m_MeshSetImporter->Load(fileName, *m_TextureCache, g_LoadingStats, executor, result);
+
+    return m_GltfImporter->Load(fileName, *m_TextureCache, g_LoadingStats, executor, result);
+}
+
 void Scene::LoadModels(
     const Json::Value& modelList,
     const std::filesystem::path& scenePath,
@@ -255,341 +359,12 @@ void Scene::LoadModels(
 
 void Scene::LoadSceneGraph(const Json::Value& nodeList, const std::shared_ptr<SceneGraphNode>& parent)
 {
-    for (const auto& src : nodeList)
-    {
-        if (!src.isObject())
-        {
-            log::warning("Non-object node in the scene graph definition.");
-            continue;
-        }
-
-        std::string nodeName;
-        const auto& name = src["name"];
-        if (name.isString())
-        {
-            nodeName = name.asString();
-        }
-
-        std::shared_ptr<SceneGraphNode> customParent = parent;
-        const auto& parentNode = src["parent"];
-        if (parentNode.isString())
-        {
-            customParent = m_SceneGraph->FindNode(parentNode.asString());
-            if (!customParent)
-            {
-                log::warning("Custom parent '%s' specified for node '%s' not found, skipping the node.",
-                    parentNode.asCString(), nodeName.c_str());
-                continue;
-            }
-        }
-        else if (!parentNode.isNull())
-        {
-            log::warning("Custom parent specification for node '%s' is not a string, ignoring.",
-                nodeName.c_str());
-        }
-
-        std::shared_ptr<SceneGraphNode> dst;
-
-        const auto& modelNode = src["model"];
-        if (!modelNode.isNull())
-        {
-            if (!modelNode.isIntegral())
-            {
-                log::warning("Model references in the scene graph must be indices into the model array.");
-                continue;
-            }
-
-            int modelIndex = modelNode.asInt();
-            if (modelIndex < 0 || modelIndex >= int(m_Models.size()))
-            {
-                log::warning("Referenced model %d is not defined in the model array.", modelIndex);
-                continue;
-            }
-
-            const auto& loadedModel = m_Models[modelIndex];
-            if (!loadedModel.rootNode)
-            {
-                continue;
-            }
-
-            dst = loadedModel.rootNode;
-        }
-        else
-        {
-            dst = std::make_shared<SceneGraphNode>();
-        }
-
-        dst = m_SceneGraph->Attach(customParent, dst);
-
-        dst->SetName(nodeName);
-        
-        const auto& translation = src["translation"];
-        if (!translation.isNull())
-        {
-            double3 value = double3::zero();
-            translation >> value;
-            dst->SetTranslation(value);
-        }
-
-        const auto& rotation = src["rotation"];
-        if (!rotation.isNull())
-        {
-            double4 value = double4(0.0, 0.0, 0.0, 1.0);
-            rotation >> value;
-            dst->SetRotation(dm::dquat::fromXYZW(value));
-        }
-        else
-        {
-            const auto& euler = src["euler"];
-            if (!euler.isNull())
-            {
-                double3 value = double3::zero();
-                euler >> value;
-                dst->SetRotation(rotationQuat(value));
-            }
-        }
-
-        const auto& scaling = src["scaling"];
-        if (!scaling.isNull())
-        {
-            double3 value = double3(1.0);
-            scaling >> value;
-            dst->SetScaling(value);
-        }
-
-        const auto& children = src["children"];
-        if (!children.isNull())
-        {
-            LoadSceneGraph(children, dst);
-        }
-
-        const auto& leafTypeNode = src["type"];
-        if (leafTypeNode.isString())
-        {
-            auto leaf = m_SceneTypeFactory->CreateLeaf(leafTypeNode.asString());
-            if (leaf)
-            {
-                dst->SetLeaf(leaf);
-                leaf->Load(src);
-            }
-            else
-            {
-                log::warning("Unknown leaf type '%s' for node '%s', skipping.",
-                    leafTypeNode.asCString(), dst->GetName().c_str());
-            }
-        }
-        else if (!leafTypeNode.isNull())
-        {
-            log::warning("Leaf type specification for node '%s' is not a string, skipping.",
-                dst->GetName().c_str());
-        }
-    }
-}
-
-static dm::float4 ReadUpToFloat4(const Json::Value& node)
-{
-    if (node.isNumeric())
-        return dm::float4(node.asFloat());
-
-    if (node.isArray())
-    {
-        float4 result = float4::zero();
-        for (int i = 0; i < std::min(4, int(node.size())); i++)
-        {
-            result[i] = node[i].asFloat();
-        }
-        return result;
-    }
-
-    return float4::zero();
+    SceneGraphLoader(m_SceneGraph, m_SceneTypeFactory, m_Models).LoadSceneGraph(nodeList, parent);
 }
 
 void Scene::LoadAnimations(const Json::Value& nodeList)
 {
-    std::shared_ptr<SceneGraphNode> animationContainer;
-
-    for (const auto& animationNode : nodeList)
-    {
-        const auto& animation = std::make_shared<SceneGraphAnimation>();
-
-        const auto& sceneAnimationNode = std::make_shared<SceneGraphNode>();
-        sceneAnimationNode->SetLeaf(animation);
-
-        const auto& nameNode = animationNode["name"];
-        if (nameNode.isString())
-        {
-            animation->SetName(nameNode.asString());
-        }
-
-        const auto& channelsNode = animationNode["channels"];
-        if (channelsNode.isArray())
-        {
-            int channelIndex = -1;
-            for (const auto& channelSrc : channelsNode)
-            {
-                // Increment the index in the beginning because there are 'continue' statements below
-                ++channelIndex;
-
-                const auto& sampler = std::make_shared<animation::Sampler>();
-
-                const auto& modeNode = channelSrc["mode"];
-                if (modeNode.isString())
-                {
-                    if (modeNode.asString() == "step")
-                        sampler->SetInterpolationMode(animation::InterpolationMode::Step);
-                    else if (modeNode.asString() == "linear")
-                        sampler->SetInterpolationMode(animation::InterpolationMode::Linear);
-                    else if (modeNode.asString() == "slerp")
-                        sampler->SetInterpolationMode(animation::InterpolationMode::Slerp);
-                    else if (modeNode.asString() == "hermite")
-                        sampler->SetInterpolationMode(animation::InterpolationMode::HermiteSpline);
-                    else if (modeNode.asString() == "catmull-rom")
-                        sampler->SetInterpolationMode(animation::InterpolationMode::CatmullRomSpline);
-                    else
-                        log::warning("Unknown interpolation mode '%s' specified for animation '%s' channel %d. "
-                            "Valid interpolation modes are: step, linear, hermite, catmull-rom.",
-                            modeNode.asCString(), animation->GetName().c_str(), channelIndex);
-                }
-                else
-                {
-                    sampler->SetInterpolationMode(animation::InterpolationMode::Step);
-                    log::warning("Interpolation mode is not specified for animation '%s' channel %d, using step.",
-                        animation->GetName().c_str(), channelIndex);
-                }
-
-                const auto& attributeNode = channelSrc["attribute"];
-                AnimationAttribute attribute = AnimationAttribute::Undefined;
-                if (attributeNode.isString() && !attributeNode.asString().empty())
-                {
-                    if (attributeNode.asString() == "translation")
-                        attribute = AnimationAttribute::Translation;
-                    else if (attributeNode.asString() == "rotation")
-                        attribute = AnimationAttribute::Rotation;
-                    else if (attributeNode.asString() == "scaling")
-                        attribute = AnimationAttribute::Scaling;
-                    else
-                        attribute = AnimationAttribute::LeafProperty;
-                }
-                else
-                {
-                    log::warning("Attribute is not specified for animation '%s' channel %d, ignoring.",
-                        animation->GetName().c_str(), channelIndex);
-                    continue;
-                }
-
-                int keyframeIndex = -1;
-                for (const auto& dataPoint : channelSrc["data"])
-                {
-                    ++keyframeIndex;
-
-                    const auto& timeNode = dataPoint["time"];
-                    if (!timeNode.isNumeric())
-                    {
-                        log::warning("Invalid keyframe %d in animation '%s' channel %d: time is not specified or is not numeric.",
-                            keyframeIndex, animation->GetName().c_str(), channelIndex);
-                        continue;
-                    }
-
-                    animation::Keyframe keyframe;
-                    keyframe.time = timeNode.asFloat();
-                    keyframe.value = ReadUpToFloat4(dataPoint["value"]);
-                    keyframe.inTangent = ReadUpToFloat4(dataPoint["inTangent"]);
-                    keyframe.outTangent = ReadUpToFloat4(dataPoint["outTangent"]);
-
-                    sampler->AddKeyframe(keyframe);
-                }
-
-                auto processTargetNode = [this, &animation, &sampler, attribute, &attributeNode, channelIndex](const Json::Value& targetNode)
-                {
-                    if (targetNode.isString())
-                    {
-                        std::string targetName = targetNode.asString();
-                        if (donut::string_utils::starts_with(targetName, "material:"))
-                        {
-                            targetName = targetName.substr(9);
-
-                            std::shared_ptr<Material> material;
-                            for (const auto& it : m_SceneGraph->GetMaterials())
-                            {
-                                if (it->name == targetName)
-                                {
-                                    material = it;
-                                    break;
-                                }
-                            }
-
-                            if (material)
-                            {
-                                const auto& channel = std::make_shared<SceneGraphAnimationChannel>(sampler, material);
-                                channel->SetLeafProperyName(attributeNode.asString());
-                                animation->AddChannel(channel);
-                            }
-                            else
-                            {
-                                log::warning("Target material '%s' specified for animation '%s' channel %d not found, ignoring.",
-                                    std::string(targetName).c_str(), animation->GetName().c_str(), channelIndex);
-                            }
-                        }
-                        else
-                        {
-                            const auto& target = m_SceneGraph->FindNode(targetNode.asString());
-                            if (target)
-                            {
-                                const auto& channel = std::make_shared<SceneGraphAnimationChannel>(sampler, target, attribute);
-                                if (attribute == AnimationAttribute::LeafProperty)
-                                    channel->SetLeafProperyName(attributeNode.asString());
-                                animation->AddChannel(channel);
-                            }
-                            else
-                            {
-                                log::warning("Target node '%s' specified for animation '%s' channel %d not found, ignoring.",
-                                    targetNode.asCString(), animation->GetName().c_str(), channelIndex);
-                            }
-                        }
-                    }
-                    else if (!targetNode.isNull())
-                    {
-                        log::warning("Target node specification for animation '%s' channel %d is not a string, ignoring.",
-                            animation->GetName().c_str(), channelIndex);
-                    }
-                };
-
-                const auto& targetNode = channelSrc["target"];
-                if (!targetNode.isNull())
-                {
-                    processTargetNode(targetNode);
-                }
-                else
-                {
-                    const auto& targetsNode = channelSrc["targets"];
-                    if (targetsNode.isArray())
-                    {
-                        for (const auto& targetArrayItem : targetsNode)
-                        {
-                            processTargetNode(targetArrayItem);
-                        }
-                    }
-                }
-            }
-        }
-
-        if (!animation->GetChannels().empty())
-        {
-            if (!animationContainer)
-            {
-                animationContainer = std::make_shared<SceneGraphNode>();
-                animationContainer->SetName("Animations");
-                m_SceneGraph->Attach(m_SceneGraph->GetRootNode(), animationContainer);
-            }
-            
-            m_SceneGraph->Attach(animationContainer, sceneAnimationNode);
-        }
-        else
-        {
-            log::warning("Animation '%s' processed with no valid channels, ignoring.",
-                animation->GetName().c_str());
-        }
-    }
+    SceneGraphLoader(m_SceneGraph, m_SceneTypeFactory, m_Models).LoadAnimations(nodeList);
 }
 
 bool Scene::LoadCustomData(Json::Value& rootNode, tf::Executor* executor)
@@ -612,6 +387,8 @@ void Scene::FinishedLoading(uint32_t frameIndex)
 
 void Scene::RefreshSceneGraph(uint32_t frameIndex)
 {
+    DONUT_TRACE_ZONE("Scene::RefreshSceneGraph");
+
     m_SceneStructureChanged = m_SceneGraph->HasPendingStructureChanges();
     m_SceneTransformsChanged = m_SceneGraph->HasPendingTransformChanges();
     m_SceneGraph->Refresh(frameIndex);
@@ -619,6 +396,8 @@ void Scene::RefreshSceneGraph(uint32_t frameIndex)
 
 void Scene::RefreshBuffers(nvrhi::ICommandList* commandList, uint32_t frameIndex)
 {
+    DONUT_TRACE_ZONE("Scene::RefreshBuffers");
+
     bool materialsChanged = false;
 
     if (m_SceneStructureChanged)
@@ -666,6 +445,7 @@ void Scene::RefreshBuffers(nvrhi::ICommandList* commandList, uint32_t frameIndex
                 &m_Resources->materialData[material->materialID],
                 sizeof(MaterialConstants));
 
+            material->UpdateBindingHash();
             material->dirty = false;
             materialsChanged = true;
         }
@@ -695,6 +475,8 @@ void Scene::RefreshBuffers(nvrhi::ICommandList* commandList, uint32_t frameIndex
 
     if (m_SceneStructureChanged || arraysAllocated)
     {
+        ++m_StructureVersion;
+
         for (const auto& mesh : m_SceneGraph->GetMeshes())
         {
             mesh->buffers->instanceBuffer = m_InstanceBuffer;
@@ -723,43 +505,174 @@ void Scene::RefreshBuffers(nvrhi::ICommandList* commandList, uint32_t frameIndex
     }
 
     UpdateSkinnedMeshes(commandList, frameIndex);
+
+    // Write the descriptors created for new buffers, and by the loaders if deferred writes are enabled
+    if (m_DescriptorTable)
+        m_DescriptorTable->Flush();
 }
 
-void Scene::UpdateSkinnedMeshes(nvrhi::ICommandList* commandList, uint32_t frameIndex)
+void Scene::UpdateJointLayout()
 {
-    bool skinningMarkerPlaced = false;
+    // Any change to the joint nodes is a structure change, which brings us back here before the palette is computed again
+    auto& palette = m_Resources->skinningPalette;
+    palette.SetInstances(m_SceneGraph->GetSkinnedMeshInstances());
+    m_Resources->jointLayoutChanged = true;
+
+    if (palette.GetJointCount() == 0)
+        return;
+
+    const size_t allocationGranularity = 1024;
+    const size_t requiredSize = nvrhi::align(palette.GetJointCount(), allocationGranularity) * sizeof(float4x4);
+
+    if (!m_JointBuffer || m_JointBuffer->getDesc().byteSize < requiredSize)
+    {
+        nvrhi::BufferDesc jointBufferDesc;
+        jointBufferDesc.debugName = "JointBuffer";
+        jointBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+        jointBufferDesc.keepInitialState = true;
+        jointBufferDesc.canHaveRawViews = true;
+        jointBufferDesc.byteSize = requiredSize;
+        m_JointBuffer = m_Device->createBuffer(jointBufferDesc);
+    }
 
-    std::vector<dm::float4x4> jointMatrices;
     for (const auto& skinnedInstance : m_SceneGraph->GetSkinnedMeshInstances())
+    {
+        if (skinnedInstance->jointBuffer != m_JointBuffer)
+        {
+            skinnedInstance->jointBuffer = m_JointBuffer;
+            skinnedInstance->skinningBindingSet = nullptr;
+        }
+    }
+}
+
+void Scene::SetAnimationLodView(const IView& view)
+{
+    m_LodViewOrigin = view.GetViewOrigin();
+    m_LodViewScale = view.GetProjectionMatrix(false)[1][1] * 0.5f;
+    m_LodViewOrthographic = view.IsOrthographicProjection();
+}
+
+const SkinningLodLevel* Scene::SelectSkinningLod(const SkinnedMeshInstance& instance) const
+{
+    if (m_SkinningLodLevels.empty())
+        return nullptr;
+
+    const box3& bounds = instance.GetNode()->GetGlobalBoundingBox();
+    if (bounds.isempty() || m_LodViewScale == 0.f)
+        return &m_SkinningLodLevels[0];
+
+    const float radius = length(bounds.diagonal()) * 0.5f;
+    const float distance = length(bounds.center() - m_LodViewOrigin);
+    float screenSize;
+    if (m_LodViewOrthographic)
+        screenSize = radius * m_LodViewScale;
+    else
+        screenSize = (distance > radius) ? radius * m_LodViewScale / distance : 1.f;
+
+    for (const SkinningLodLevel& level : m_SkinningLodLevels)
+    {
+        if (screenSize >= level.minScreenSize)
+            return &level;
+    }
+
+    return &m_SkinningLodLevels.back();
+}
+
+void Scene::UpdateSkinnedMeshes(nvrhi::ICommandList* commandList, uint32_t frameIndex)
+{
+    DONUT_TRACE_ZONE("Scene::UpdateSkinnedMeshes");
+
+    const auto& skinnedInstances = m_SceneGraph->GetSkinnedMeshInstances();
+    auto& updatedInstances = m_Resources->updatedSkinnedInstances;
+    auto& instanceJointDepths = m_Resources->updatedJointDepths;
+    updatedInstances.clear();
+    instanceJointDepths.clear();
+
+    m_SkinningStats = SkinningStats();
+    m_SkinningStats.totalInstances = uint32_t(skinnedInstances.size());
+
+    if (m_SkinningLodLevels.empty())
     {
         // Only process the groups that were updated on this or previous frame.
         // Previous frame updates should be processed to copy the current positions to the previous buffer.
-        if (skinnedInstance->GetLastUpdateFrameIndex() + 1 < frameIndex)
-            continue;
-
-        if (!skinningMarkerPlaced)
+        for (const auto& skinnedInstance : skinnedInstances)
         {
-            commandList->beginMarker("Skinning");
-            skinningMarkerPlaced = true;
+            if (skinnedInstance->GetLastUpdateFrameIndex() + 1 >= frameIndex)
+            {
+                updatedInstances.push_back(skinnedInstance.get());
+                instanceJointDepths.push_back(~0u);
+            }
         }
+        m_SkinningStats.animatedInstances = uint32_t(updatedInstances.size());
+    }
+    else
+    {
+        // With the LOD, an instance may skip several animated frames, see ScheduleSkinningUpdate.
+        uint32_t instanceIndex = 0;
+        for (const auto& skinnedInstance : skinnedInstances)
+        {
+            SkinnedMeshInstance* instance = skinnedInstance.get();
+            const SkinningLodLevel* level = SelectSkinningLod(*instance);
+            const SkinningUpdate update = ScheduleSkinningUpdate(*instance, frameIndex, instanceIndex++, level->updateInterval);
 
-        const auto& groupName = skinnedInstance->GetName();
-        if (!groupName.empty())
-            commandList->beginMarker(groupName.c_str());
+            if (update == SkinningUpdate::Idle)
+                continue;
 
-        jointMatrices.resize(skinnedInstance->joints.size());
-        dm::daffine3 worldToRoot = inverse(skinnedInstance->GetNode()->GetLocalToWorldTransform());
+            ++m_SkinningStats.animatedInstances;
 
-        for (size_t i = 0; i < skinnedInstance->joints.size(); i++)
-        {
-            auto jointNode = skinnedInstance->joints[i].node.lock();
+            if (update == SkinningUpdate::Deferred)
+                continue;
 
-            dm::float4x4 jointMatrix = dm::affineToHomogeneous(dm::affine3(jointNode->GetLocalToWorldTransform() * worldToRoot));
-            jointMatrix = skinnedInstance->joints[i].inverseBindMatrix * jointMatrix;
-            jointMatrices[i] = jointMatrix;
+            updatedInstances.push_back(instance);
+            instanceJointDepths.push_back(level->maxJointDepth);
         }
+    }
+
+    m_SkinningStats.skinnedInstances = uint32_t(updatedInstances.size());
+
+    // When the joint layout has changed, recompute all palettes at full detail because the offsets may have moved.
+    const bool fullUpdate = m_Resources->jointLayoutChanged;
+    auto& paletteInstances = fullUpdate ? m_Resources->allSkinnedInstances : updatedInstances;
+    if (fullUpdate)
+    {
+        paletteInstances.clear();
+        for (const auto& skinnedInstance : skinnedInstances)
+            paletteInstances.push_back(skinnedInstance.get());
+        m_Resources->jointLayoutChanged = false;
+    }
+
+    if (paletteInstances.empty())
+        return;
+
+    auto& palette = m_Resources->skinningPalette;
+    m_SkinningStats.computedJoints = palette.Compute(paletteInstances.data(),
+        fullUpdate ? nullptr : instanceJointDepths.data(), paletteInstances.size(), m_Executor);
+
+    // Upload the range of the joint buffer that covers all updated palettes with a single copy.
+    uint32_t firstJoint = ~0u;
+    uint32_t lastJoint = 0;
+    for (const SkinnedMeshInstance* skinnedInstance : paletteInstances)
+    {
+        firstJoint = std::min(firstJoint, skinnedInstance->jointBufferOffset);
+        lastJoint = std::max(lastJoint, skinnedInstance->jointBufferOffset + uint32_t(skinnedInstance->joints.size()));
+    }
+
+    if (firstJoint < lastJoint)
+    {
+        commandList->writeBuffer(m_JointBuffer, palette.GetJointMatrices() + firstJoint,
+            (lastJoint - firstJoint) * sizeof(float4x4), firstJoint * sizeof(float4x4));
+    }
 
-        commandList->writeBuffer(skinnedInstance->jointBuffer, jointMatrices.data(), jointMatrices.size() * sizeof(float4x4));
+    if (updatedInstances.empty())
+        return;
+
+    commandList->beginMarker("Skinning");
+
+    for (SkinnedMeshInstance* skinnedInstance : updatedInstances)
+    {
+        const auto& groupName = skinnedInstance->GetName();
+        if (!groupName.empty())
+            commandList->beginMarker(groupName.c_str());
 
         nvrhi::ComputeState state;
         state.pipeline = m_SkinningPipeline;
@@ -772,6 +685,7 @@ void Scene::UpdateSkinnedMeshes(nvrhi::ICommandList* commandList, uint32_t frame
 
         SkinningConstants constants{};
         constants.numVertices = skinnedInstance->GetPrototypeMesh()->totalVertices;
+        constants.jointOffset = skinnedInstance->jointBufferOffset;
 
         constants.flags = 0;
         if (prototypeBuffers->hasAttribute(VertexAttribute::Normal)) constants.flags |= SkinningFlag_Normals;
@@ -802,10 +716,7 @@ void Scene::UpdateSkinnedMeshes(nvrhi::ICommandList* commandList, uint32_t frame
             commandList->endMarker();
     }
 
-    if (skinningMarkerPlaced)
-    {
-        commandList->endMarker();
-    }
+    commandList->endMarker();
 }
 
 void Scene::Refresh(nvrhi::ICommandList* commandList, uint32_t frameIndex)
@@ -838,6 +749,16 @@ inline void AppendBufferRange(nvrhi::BufferRange& range, size_t size, uint64_t&
 
 void Scene::CreateMeshBuffers(nvrhi::ICommandList* commandList)
 {
+    // Copy before any upload, the meshes that share a buffer group lose its CPU data when the first one is uploaded
+    if (m_KeepOccluderGeometry)
+    {
+        for (const auto& mesh : m_SceneGraph->GetMeshes())
+        {
+            if (mesh->buffers && !mesh->buffers->indexBuffer && !mesh->skinPrototype && mesh->occluderIndices.empty())
+                CopyOccluderGeometry(*mesh);
+        }
+    }
+
     for (const auto& mesh : m_SceneGraph->GetMeshes())
     {
         auto buffers = mesh->buffers;
@@ -845,11 +766,14 @@ void Scene::CreateMeshBuffers(nvrhi::ICommandList* commandList)
         if (!buffers)
             continue;
 
-        if (!buffers->indexData.empty() && !buffers->indexBuffer)
+        const uint32_t* indexData = buffers->indexData.empty() ? buffers->indexDataView : buffers->indexData.data();
+        const size_t indexCount = buffers->indexData.empty() ? buffers->indexCount : buffers->indexData.size();
+
+        if (indexData && indexCount && !buffers->indexBuffer)
         {
             nvrhi::BufferDesc bufferDesc;
             bufferDesc.isIndexBuffer = true;
-            bufferDesc.byteSize = buffers->indexData.size() * sizeof(uint32_t);
+            bufferDesc.byteSize = indexCount * sizeof(uint32_t);
             bufferDesc.debugName = "IndexBuffer";
             bufferDesc.canHaveTypedViews = true;
             bufferDesc.canHaveRawViews = true;
@@ -866,8 +790,9 @@ void Scene::CreateMeshBuffers(nvrhi::ICommandList* commandList)
 
             commandList->beginTrackingBufferState(buffers->indexBuffer, nvrhi::ResourceStates::Common);
 
-            commandList->writeBuffer(buffers->indexBuffer, buffers->indexData.data(), buffers->indexData.size() * sizeof(uint32_t));
+            commandList->writeBuffer(buffers->indexBuffer, indexData, indexCount * sizeof(uint32_t));
             std::vector<uint32_t>().swap(buffers->indexData);
+            buffers->indexDataView = nullptr;
 
             nvrhi::ResourceStates state = nvrhi::ResourceStates::IndexBuffer | nvrhi::ResourceStates::ShaderResource;
 
@@ -888,49 +813,61 @@ void Scene::CreateMeshBuffers(nvrhi::ICommandList* commandList)
             bufferDesc.canHaveRawViews = true;
             bufferDesc.isAccelStructBuildInput = m_RayTracingSupported;
 
-            if (!buffers->positionData.empty())
+            // Views provide their own ranges, usually packed in the source file the same way as below
+            bool hasDataViews = false;
+            for (size_t attr = 0; attr < buffers->vertexDataViews.size(); ++attr)
+            {
+                if (buffers->vertexDataViews[attr])
+                {
+                    const nvrhi::BufferRange& range = buffers->vertexBufferRanges[attr];
+                    bufferDesc.byteSize = std::max(bufferDesc.byteSize, range.byteOffset + range.byteSize);
+                    hasDataViews = true;
+                }
+            }
+
+            if (!hasDataViews && !buffers->positionData.empty())
             {
                 AppendBufferRange(buffers->getVertexBufferRange(VertexAttribute::Position), 
                     buffers->positionData.size() * sizeof(buffers->positionData[0]), bufferDesc.byteSize);
             }
 
-            if (!buffers->normalData.empty())
+            if (!hasDataViews && !buffers->normalData.empty())
             {
                 AppendBufferRange(buffers->getVertexBufferRange(VertexAttribute::Normal),
                     buffers->normalData.size() * sizeof(buffers->normalData[0]), bufferDesc.byteSize);
             }
 
-            if (!buffers->tangentData.empty())
+            if (!hasDataViews && !buffers->tangentData.empty())
             {
                 AppendBufferRange(buffers->getVertexBufferRange(VertexAttribute::Tangent),
                     buffers->tangentData.size() * sizeof(buffers->tangentData[0]), bufferDesc.byteSize);
             }
 
-            if (!buffers->texcoord1Data.empty())
+            if (!hasDataViews && !buffers->texcoord1Data.empty())
             {
                 AppendBufferRange(buffers->getVertexBufferRange(VertexAttribute::TexCoord1),
                     buffers->texcoord1Data.size() * sizeof(buffers->texcoord1Data[0]), bufferDesc.byteSize);
             }
 
-            if (!buffers->texcoord2Data.empty())
+            if (!hasDataViews && !buffers->texcoord2Data.empty())
             {
                 AppendBufferRange(buffers->getVertexBufferRange(VertexAttribute::TexCoord2),
                     buffers->texcoord2Data.size() * sizeof(buffers->texcoord2Data[0]), bufferDesc.byteSize);
             }
 
-            if (!buffers->weightData.empty())
+            if (!hasDataViews && !buffers->weightData.empty())
             {
                 AppendBufferRange(buffers->getVertexBufferRange(VertexAttribute::JointWeights),
                     buffers->weightData.size() * sizeof(buffers->weightData[0]), bufferDesc.byteSize);
             }
 
-            if (!buffers->jointData.empty())
+            if (!hasDataViews && !buffers->jointData.empty())
             {
                 AppendBufferRange(buffers->getVertexBufferRange(VertexAttribute::JointIndices),
                     buffers->jointData.size() * sizeof(buffers->jointData[0]), bufferDesc.byteSize);
             }
 
-            if (!buffers->radiusData.empty())
+            if (!hasDataViews && !buffers->radiusData.empty())
             {
                 AppendBufferRange(buffers->getVertexBufferRange(VertexAttribute::CurveRadius),
                     buffers->radiusData.size() * sizeof(buffers->radiusData[0]), bufferDesc.byteSize);
@@ -950,6 +887,16 @@ void Scene::CreateMeshBuffers(nvrhi::ICommandList* commandList)
 
             commandList->beginTrackingBufferState(buffers->vertexBuffer, nvrhi::ResourceStates::Common);
 
+            for (size_t attr = 0; attr < buffers->vertexDataViews.size(); ++attr)
+            {
+                if (buffers->vertexDataViews[attr])
+                {
+                    const nvrhi::BufferRange& range = buffers->vertexBufferRanges[attr];
+                    commandList->writeBuffer(buffers->vertexBuffer, buffers->vertexDataViews[attr], range.byteSize, range.byteOffset);
+                    buffers->vertexDataViews[attr] = nullptr;
+                }
+            }
+
             if (!buffers->positionData.empty())
             {
                 const auto& range = buffers->getVertexBufferRange(VertexAttribute::Position);
@@ -1014,8 +961,13 @@ void Scene::CreateMeshBuffers(nvrhi::ICommandList* commandList)
             commandList->setPermanentBufferState(buffers->vertexBuffer, state);
             commandList->commitBarriers();
         }
+
+        if (!buffers->indexDataView && buffers->dataBlob)
+            buffers->dataBlob.reset();
     }
 
+    UpdateJointLayout();
+
     for (const auto& skinnedInstance : m_SceneGraph->GetSkinnedMeshInstances())
     {
         const auto& skinnedMesh = skinnedInstance->GetMesh();
@@ -1085,17 +1037,6 @@ void Scene::CreateMeshBuffers(nvrhi::ICommandList* commandList)
             }
         }
 
-        if (!skinnedInstance->jointBuffer)
-        {
-            nvrhi::BufferDesc jointBufferDesc;
-            jointBufferDesc.debugName = "JointBuffer";
-            jointBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-            jointBufferDesc.keepInitialState = true;
-            jointBufferDesc.canHaveRawViews = true;
-            jointBufferDesc.byteSize = sizeof(dm::float4x4) * skinnedInstance->joints.size();
-            skinnedInstance->jointBuffer = m_Device->createBuffer(jointBufferDesc);
-        }
-
         if (!skinnedInstance->skinningBindingSet)
         {
             const auto& prototypeBuffers = skinnedInstance->GetPrototypeMesh()->buffers;
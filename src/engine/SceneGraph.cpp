@@ -22,8 +22,10 @@
 
 #include <donut/engine/SceneGraph.h>
 #include <donut/core/log.h>
+#include <donut/core/trace.h>
 #include <donut/core/json.h>
 #include <sstream>
+#include <unordered_set>
 
 using namespace donut::engine;
 
@@ -59,6 +61,7 @@ SkinnedMeshInstance::SkinnedMeshInstance(std::shared_ptr<SceneTypeFactory> scene
     skinnedMesh->indexOffset = m_PrototypeMesh->indexOffset;
     skinnedMesh->totalVertices = m_PrototypeMesh->totalVertices;
     skinnedMesh->totalIndices = m_PrototypeMesh->totalIndices;
+    skinnedMesh->lodErrors = m_PrototypeMesh->lodErrors;
     skinnedMesh->geometries.reserve(m_PrototypeMesh->geometries.size());
     
     for (const auto& geometry : m_PrototypeMesh->geometries)
@@ -395,6 +398,15 @@ int SceneGraphWalker::Up()
 }
 
 bool SceneGraphAnimationChannel::Apply(float time) const
+{
+    auto valueOption = m_Sampler->Evaluate(time, true);
+    if (!valueOption.has_value())
+        return false;
+
+    return ApplyValue(valueOption.value());
+}
+
+bool SceneGraphAnimationChannel::ApplyValue(const dm::float4& value) const
 {
     auto node = m_TargetNode.lock();
     auto material = m_TargetMaterial.lock();
@@ -402,12 +414,6 @@ bool SceneGraphAnimationChannel::Apply(float time) const
         (!material && !node && m_Attribute == AnimationAttribute::LeafProperty))
         return false;
 
-    auto valueOption = m_Sampler->Evaluate(time, true);
-    if (!valueOption.has_value())
-        return false;
-
-    auto value = valueOption.value();
-
     switch(m_Attribute)
     {
     case AnimationAttribute::Scaling:
@@ -517,6 +523,129 @@ bool SceneGraphAnimation::IsVald() const
     return true;
 }
 
+CompiledAnimationClip::CompiledAnimationClip(const SceneGraphAnimation& animation)
+    : m_Duration(animation.GetDuration())
+{
+    std::unordered_map<SceneGraphNode*, size_t> nodeTrackIndices;
+
+    for (const auto& channel : animation.GetChannels())
+    {
+        const int channelIndex = int(m_Samplers.size());
+        m_Samplers.emplace_back(*channel->GetSampler());
+
+        const AnimationAttribute attribute = channel->GetAttribute();
+        if (attribute == AnimationAttribute::LeafProperty)
+        {
+            m_PropertyTracks.push_back(std::make_pair(channelIndex, channel));
+            continue;
+        }
+
+        SceneGraphNode* node = channel->GetTargetNode().get();
+        if (!node)
+            continue;
+
+        auto it = nodeTrackIndices.find(node);
+        if (it == nodeTrackIndices.end())
+        {
+            it = nodeTrackIndices.insert(std::make_pair(node, m_NodeTracks.size())).first;
+            m_NodeTracks.push_back(NodeTrack());
+            m_NodeTracks.back().node = node;
+        }
+
+        // When multiple channels animate the same attribute, the last one wins, same as with SceneGraphAnimation::Apply
+        NodeTrack& track = m_NodeTracks[it->second];
+        switch (attribute)
+        {
+        case AnimationAttribute::Translation: track.translationChannel = channelIndex; break;
+        case AnimationAttribute::Rotation: track.rotationChannel = channelIndex; break;
+        case AnimationAttribute::Scaling: track.scalingChannel = channelIndex; break;
+        default:
+            log::warning("Unsupported animation target (%d), ignoring.", uint32_t(attribute));
+            break;
+        }
+    }
+
+    m_Cursors.resize(m_Samplers.size(), 0);
+    m_Values.resize(m_Samplers.size(), dm::float4::zero());
+    m_ValueValid.resize(m_Samplers.size(), false);
+}
+
+void CompiledAnimationClip::Evaluate(float time)
+{
+    for (size_t channel = 0; channel < m_Samplers.size(); ++channel)
+    {
+        auto value = m_Samplers[channel].Evaluate(time, m_Cursors[channel], true);
+        m_ValueValid[channel] = value.has_value();
+        if (value.has_value())
+            m_Values[channel] = value.value();
+    }
+}
+
+void CompiledAnimationClip::ApplyEvaluatedValues() const
+{
+    for (const NodeTrack& track : m_NodeTracks)
+    {
+        dm::double3 translation, scaling;
+        dm::dquat rotation;
+        const dm::double3* pTranslation = nullptr;
+        const dm::dquat* pRotation = nullptr;
+        const dm::double3* pScaling = nullptr;
+
+        if (track.translationChannel >= 0 && m_ValueValid[track.translationChannel])
+        {
+            translation = dm::double3(m_Values[track.translationChannel].xyz());
+            pTranslation = &translation;
+        }
+
+        if (track.rotationChannel >= 0 && m_ValueValid[track.rotationChannel])
+        {
+            dm::float4 value = m_Values[track.rotationChannel];
+            float len = length(value);
+            if (len == 0.f)
+            {
+                log::warning("Rotation quaternion interpolated to zero, ignoring.");
+            }
+            else
+            {
+                value /= len;
+                rotation = dm::dquat::fromXYZW(dm::double4(value));
+                pRotation = &rotation;
+            }
+        }
+
+        if (track.scalingChannel >= 0 && m_ValueValid[track.scalingChannel])
+        {
+            scaling = dm::double3(m_Values[track.scalingChannel].xyz());
+            pScaling = &scaling;
+        }
+
+        if (pTranslation || pRotation || pScaling)
+            track.node->SetTransform(pTranslation, pRotation, pScaling);
+    }
+
+    ApplyEvaluatedProperties();
+}
+
+void CompiledAnimationClip::ApplyEvaluatedProperties() const
+{
+    for (const auto& [channelIndex, channel] : m_PropertyTracks)
+    {
+        if (m_ValueValid[channelIndex])
+            channel->ApplyValue(m_Values[channelIndex]);
+    }
+}
+
+void CompiledAnimationClip::Apply(float time)
+{
+    Evaluate(time);
+    ApplyEvaluatedValues();
+}
+
+void CompiledAnimationClip::ResetCursors()
+{
+    std::fill(m_Cursors.begin(), m_Cursors.end(), 0);
+}
+
 void SceneGraph::RegisterLeaf(const std::shared_ptr<SceneGraphLeaf>& leaf)
 {
     if (!leaf)
@@ -956,8 +1085,37 @@ std::shared_ptr<SceneGraphNode> SceneGraph::FindNode(const std::filesystem::path
     return current->shared_from_this();
 }
 
+void SceneGraph::SetNodeTransforms(const std::vector<SceneGraphNodeTransform>& transforms)
+{
+    std::unordered_set<SceneGraphNode*> propagatedNodes;
+
+    for (const auto& transform : transforms)
+    {
+        SceneGraphNode* node = transform.node;
+        assert(node && node->m_Graph.lock().get() == this);
+
+        if (transform.scaling.has_value()) node->m_Scaling = *transform.scaling;
+        if (transform.rotation.has_value()) node->m_Rotation = *transform.rotation;
+        if (transform.translation.has_value()) node->m_Translation = *transform.translation;
+
+        node->m_Dirty |= SceneGraphNode::DirtyFlags::LocalTransform;
+        node->m_HasLocalTransform = true;
+
+        // Same as PropagateDirtyFlags, but stop at the first node that was already reached by this batch:
+        // its ancestors have been flagged already.
+        for (SceneGraphNode* current = node; current; current = current->m_Parent)
+        {
+            current->m_Dirty |= SceneGraphNode::DirtyFlags::SubgraphTransforms;
+            if (!propagatedNodes.insert(current).second)
+                break;
+        }
+    }
+}
+
 void SceneGraph::Refresh(uint32_t frameIndex)
 {
+    DONUT_TRACE_ZONE("SceneGraph::Refresh");
+
     struct StackItem
     {
         bool supergraphTransformUpdated = false;
@@ -1271,11 +1429,11 @@ void donut::engine::PrintSceneGraph(const std::shared_ptr<SceneGraphNode>& root)
                         ss << "Unknown Attribute";
                     }
                     ss << "): ";
-                    auto keyframes = channel->GetSampler()->GetKeyframes();
-                    ss << keyframes.size() << " keyframes";
-                    if (!keyframes.empty())
+                    const auto& sampler = channel->GetSampler();
+                    ss << sampler->GetKeyframeCount() << " keyframes";
+                    if (sampler->GetKeyframeCount() != 0)
                     {
-                        ss << ", " << keyframes[0].time << "s - " << keyframes[keyframes.size() - 1].time << "s";
+                        ss << ", " << sampler->GetStartTime() << "s - " << sampler->GetEndTime() << "s";
                     }
 
                     log::info("%s", ss.str().c_str());
@@ -0,0 +1,905 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/SceneGraphLoader.h>
+#include <donut/core/json.h>
+#include <donut/core/json_reader.h>
+#include <donut/core/log.h>
+#include <donut/core/string_utils.h>
+#include <json/value.h>
+#include <cmath>
+#include <optional>
+
+using namespace donut::math;
+using namespace donut::engine;
+
+SceneGraphLoader::SceneGraphLoader(
+    std::shared_ptr<SceneGraph> sceneGraph,
+    std::shared_ptr<SceneTypeFactory> sceneTypeFactory,
+    const std::vector<SceneImportResult>& models)
+    : m_SceneGraph(std::move(sceneGraph))
+    , m_SceneTypeFactory(std::move(sceneTypeFactory))
+    , m_Models(models)
+{
+}
+
+void SceneGraphLoader::LoadSceneGraph(const Json::Value& nodeList, const std::shared_ptr<SceneGraphNode>& parent)
+{
+    for (const auto& src : nodeList)
+    {
+        if (!src.isObject())
+        {
+            log::warning("Non-object node in the scene graph definition.");
+            continue;
+        }
+
+        std::string nodeName;
+        const auto& name = src["name"];
+        if (name.isString())
+        {
+            nodeName = name.asString();
+        }
+
+        std::shared_ptr<SceneGraphNode> customParent = parent;
+        const auto& parentNode = src["parent"];
+        if (parentNode.isString())
+        {
+            customParent = m_SceneGraph->FindNode(parentNode.asString());
+            if (!customParent)
+            {
+                log::warning("Custom parent '%s' specified for node '%s' not found, skipping the node.",
+                    parentNode.asCString(), nodeName.c_str());
+                continue;
+            }
+        }
+        else if (!parentNode.isNull())
+        {
+            log::warning("Custom parent specification for node '%s' is not a string, ignoring.",
+                nodeName.c_str());
+        }
+
+        std::shared_ptr<SceneGraphNode> dst;
+
+        const auto& modelNode = src["model"];
+        if (!modelNode.isNull())
+        {
+            if (!modelNode.isIntegral())
+            {
+                log::warning("Model references in the scene graph must be indices into the model array.");
+                continue;
+            }
+
+            int modelIndex = modelNode.asInt();
+            if (modelIndex < 0 || modelIndex >= int(m_Models.size()))
+            {
+                log::warning("Referenced model %d is not defined in the model array.", modelIndex);
+                continue;
+            }
+
+            const auto& loadedModel = m_Models[modelIndex];
+            if (!loadedModel.rootNode)
+            {
+                continue;
+            }
+
+            dst = loadedModel.rootNode;
+        }
+        else
+        {
+            dst = std::make_shared<SceneGraphNode>();
+        }
+
+        dst = m_SceneGraph->Attach(customParent, dst);
+
+        dst->SetName(nodeName);
+        
+        const auto& translation = src["translation"];
+        if (!translation.isNull())
+        {
+            double3 value = double3::zero();
+            translation >> value;
+            dst->SetTranslation(value);
+        }
+
+        const auto& rotation = src["rotation"];
+        if (!rotation.isNull())
+        {
+            double4 value = double4(0.0, 0.0, 0.0, 1.0);
+            rotation >> value;
+            dst->SetRotation(dm::dquat::fromXYZW(value));
+        }
+        else
+        {
+            const auto& euler = src["euler"];
+            if (!euler.isNull())
+            {
+                double3 value = double3::zero();
+                euler >> value;
+                dst->SetRotation(rotationQuat(value));
+            }
+        }
+
+        const auto& scaling = src["scaling"];
+        if (!scaling.isNull())
+        {
+            double3 value = double3(1.0);
+            scaling >> value;
+            dst->SetScaling(value);
+        }
+
+        const auto& children = src["children"];
+        if (!children.isNull())
+        {
+            LoadSceneGraph(children, dst);
+        }
+
+        const auto& leafTypeNode = src["type"];
+        if (leafTypeNode.isString())
+        {
+            auto leaf = m_SceneTypeFactory->CreateLeaf(leafTypeNode.asString());
+            if (leaf)
+            {
+                dst->SetLeaf(leaf);
+                leaf->Load(src);
+            }
+            else
+            {
+                log::warning("Unknown leaf type '%s' for node '%s', skipping.",
+                    leafTypeNode.asCString(), dst->GetName().c_str());
+            }
+        }
+        else if (!leafTypeNode.isNull())
+        {
+            log::warning("Leaf type specification for node '%s' is not a string, skipping.",
+                dst->GetName().c_str());
+        }
+    }
+}
+
+static dm::float4 ReadUpToFloat4(const Json::Value& node)
+{
+    if (node.isNumeric())
+        return dm::float4(node.asFloat());
+
+    if (node.isArray())
+    {
+        float4 result = float4::zero();
+        for (int i = 0; i < std::min(4, int(node.size())); i++)
+        {
+            result[i] = node[i].asFloat();
+        }
+        return result;
+    }
+
+    return float4::zero();
+}
+
+static void SetInterpolationMode(animation::Sampler& sampler, const char* mode, const std::string& animationName, int channelIndex)
+{
+    if (!mode)
+    {
+        sampler.SetInterpolationMode(animation::InterpolationMode::Step);
+        donut::log::warning("Interpolation mode is not specified for animation '%s' channel %d, using step.",
+            animationName.c_str(), channelIndex);
+        return;
+    }
+
+    const std::string_view modeName = mode;
+    if (modeName == "step")
+        sampler.SetInterpolationMode(animation::InterpolationMode::Step);
+    else if (modeName == "linear")
+        sampler.SetInterpolationMode(animation::InterpolationMode::Linear);
+    else if (modeName == "slerp")
+        sampler.SetInterpolationMode(animation::InterpolationMode::Slerp);
+    else if (modeName == "hermite")
+        sampler.SetInterpolationMode(animation::InterpolationMode::HermiteSpline);
+    else if (modeName == "catmull-rom")
+        sampler.SetInterpolationMode(animation::InterpolationMode::CatmullRomSpline);
+    else
+        donut::log::warning("Unknown interpolation mode '%s' specified for animation '%s' channel %d. "
+            "Valid interpolation modes are: step, linear, hermite, catmull-rom.",
+            mode, animationName.c_str(), channelIndex);
+}
+
+static AnimationAttribute ParseAnimationAttribute(const std::string& attributeName)
+{
+    if (attributeName == "translation")
+        return AnimationAttribute::Translation;
+    if (attributeName == "rotation")
+        return AnimationAttribute::Rotation;
+    if (attributeName == "scaling")
+        return AnimationAttribute::Scaling;
+    return AnimationAttribute::LeafProperty;
+}
+
+void SceneGraphLoader::AddAnimationTarget(
+    const std::shared_ptr<SceneGraphAnimation>& animation,
+    const std::shared_ptr<animation::Sampler>& sampler,
+    AnimationAttribute attribute,
+    const std::string& attributeName,
+    const std::string& targetName,
+    int channelIndex)
+{
+    if (donut::string_utils::starts_with(targetName, "material:"))
+    {
+        const std::string materialName = targetName.substr(9);
+
+        std::shared_ptr<Material> material;
+        for (const auto& it : m_SceneGraph->GetMaterials())
+        {
+            if (it->name == materialName)
+            {
+                material = it;
+                break;
+            }
+        }
+
+        if (material)
+        {
+            const auto& channel = std::make_shared<SceneGraphAnimationChannel>(sampler, material);
+            channel->SetLeafProperyName(attributeName);
+            animation->AddChannel(channel);
+        }
+        else
+        {
+            log::warning("Target material '%s' specified for animation '%s' channel %d not found, ignoring.",
+                materialName.c_str(), animation->GetName().c_str(), channelIndex);
+        }
+    }
+    else
+    {
+        const auto& target = m_SceneGraph->FindNode(targetName);
+        if (target)
+        {
+            const auto& channel = std::make_shared<SceneGraphAnimationChannel>(sampler, target, attribute);
+            if (attribute == AnimationAttribute::LeafProperty)
+                channel->SetLeafProperyName(attributeName);
+            animation->AddChannel(channel);
+        }
+        else
+        {
+            log::warning("Target node '%s' specified for animation '%s' channel %d not found, ignoring.",
+                targetName.c_str(), animation->GetName().c_str(), channelIndex);
+        }
+    }
+}
+
+void SceneGraphLoader::LoadAnimations(const Json::Value& nodeList)
+{
+    std::shared_ptr<SceneGraphNode> animationContainer;
+
+    for (const auto& animationNode : nodeList)
+    {
+        const auto& animation = std::make_shared<SceneGraphAnimation>();
+
+        const auto& sceneAnimationNode = std::make_shared<SceneGraphNode>();
+        sceneAnimationNode->SetLeaf(animation);
+
+        const auto& nameNode = animationNode["name"];
+        if (nameNode.isString())
+        {
+            animation->SetName(nameNode.asString());
+        }
+
+        const auto& channelsNode = animationNode["channels"];
+        if (channelsNode.isArray())
+        {
+            int channelIndex = -1;
+            for (const auto& channelSrc : channelsNode)
+            {
+                // Increment the index in the beginning because there are 'continue' statements below
+                ++channelIndex;
+
+                const auto& sampler = std::make_shared<animation::Sampler>();
+
+                const auto& modeNode = channelSrc["mode"];
+                SetInterpolationMode(*sampler, modeNode.isString() ? modeNode.asCString() : nullptr,
+                    animation->GetName(), channelIndex);
+
+                const auto& attributeNode = channelSrc["attribute"];
+                AnimationAttribute attribute = AnimationAttribute::Undefined;
+                if (attributeNode.isString() && !attributeNode.asString().empty())
+                {
+                    attribute = ParseAnimationAttribute(attributeNode.asString());
+                }
+                else
+                {
+                    log::warning("Attribute is not specified for animation '%s' channel %d, ignoring.",
+                        animation->GetName().c_str(), channelIndex);
+                    continue;
+                }
+
+                int keyframeIndex = -1;
+                for (const auto& dataPoint : channelSrc["data"])
+                {
+                    ++keyframeIndex;
+
+                    const auto& timeNode = dataPoint["time"];
+                    if (!timeNode.isNumeric())
+                    {
+                        log::warning("Invalid keyframe %d in animation '%s' channel %d: time is not specified or is not numeric.",
+                            keyframeIndex, animation->GetName().c_str(), channelIndex);
+                        continue;
+                    }
+
+                    animation::Keyframe keyframe;
+                    keyframe.time = timeNode.asFloat();
+                    keyframe.value = ReadUpToFloat4(dataPoint["value"]);
+                    keyframe.inTangent = ReadUpToFloat4(dataPoint["inTangent"]);
+                    keyframe.outTangent = ReadUpToFloat4(dataPoint["outTangent"]);
+
+                    sampler->AddKeyframe(keyframe);
+                }
+
+                auto processTargetNode = [this, &animation, &sampler, attribute, &attributeNode, channelIndex](const Json::Value& targetNode)
+                {
+                    if (targetNode.isString())
+                    {
+                        AddAnimationTarget(animation, sampler, attribute, attributeNode.asString(), targetNode.asString(), channelIndex);
+                    }
+                    else if (!targetNode.isNull())
+                    {
+                        log::warning("Target node specification for animation '%s' channel %d is not a string, ignoring.",
+                            animation->GetName().c_str(), channelIndex);
+                    }
+                };
+
+                const auto& targetNode = channelSrc["target"];
+                if (!targetNode.isNull())
+                {
+                    processTargetNode(targetNode);
+                }
+                else
+                {
+                    const auto& targetsNode = channelSrc["targets"];
+                    if (targetsNode.isArray())
+                    {
+                        for (const auto& targetArrayItem : targetsNode)
+                        {
+                            processTargetNode(targetArrayItem);
+                        }
+                    }
+                }
+            }
+        }
+
+        if (!animation->GetChannels().empty())
+        {
+            if (!animationContainer)
+            {
+                animationContainer = std::make_shared<SceneGraphNode>();
+                animationContainer->SetName("Animations");
+                m_SceneGraph->Attach(m_SceneGraph->GetRootNode(), animationContainer);
+            }
+            
+            m_SceneGraph->Attach(animationContainer, sceneAnimationNode);
+        }
+        else
+        {
+            log::warning("Animation '%s' processed with no valid channels, ignoring.",
+                animation->GetName().c_str());
+        }
+    }
+}
+
+// Reads a vector in the same way as the json::Read functions: either an array of exactly the right size,
+// or a single number that is used for all components. Other values leave the destination unchanged.
+template<int N>
+static void ReadVector(donut::json::Reader& reader, dm::vector<double, N>& value)
+{
+    const bool isScalar = reader.Peek() == donut::json::Reader::ValueType::Number;
+
+    double components[N];
+    const int count = reader.ReadNumbers(components, N);
+
+    if (isScalar && count == 1)
+        value = dm::vector<double, N>(components[0]);
+    else if (!isScalar && count == N)
+    {
+        for (int i = 0; i < N; i++)
+            value[i] = components[i];
+    }
+}
+
+// Streaming version of ReadUpToFloat4
+static dm::float4 ReadUpToFloat4(donut::json::Reader& reader)
+{
+    const donut::json::Reader::ValueType type = reader.Peek();
+    double components[4] = { 0.0, 0.0, 0.0, 0.0 };
+    const int count = reader.ReadNumbers(components, 4);
+
+    if (type == donut::json::Reader::ValueType::Number && count == 1)
+        return dm::float4(float(components[0]));
+
+    if (type == donut::json::Reader::ValueType::Array)
+        return dm::float4(float(components[0]), float(components[1]), float(components[2]), float(components[3]));
+
+    return float4::zero();
+}
+
+void SceneGraphLoader::LoadSceneGraph(json::Reader& reader, const std::shared_ptr<SceneGraphNode>& parent)
+{
+    if (reader.Peek() != json::Reader::ValueType::Array)
+    {
+        if (reader.Peek() != json::Reader::ValueType::Null)
+            log::warning("The scene graph definition is not an array, ignoring.");
+
+        reader.Skip();
+        return;
+    }
+
+    reader.BeginArray();
+    while (reader.NextElement())
+    {
+        if (reader.Peek() != json::Reader::ValueType::Object)
+        {
+            log::warning("Non-object node in the scene graph definition.");
+            reader.Skip();
+            continue;
+        }
+
+        LoadSceneGraphNode(reader, parent);
+    }
+}
+
+void SceneGraphLoader::LoadSceneGraphNode(json::Reader& reader, const std::shared_ptr<SceneGraphNode>& parent)
+{
+    // The node is created from "model" and attached according to "parent", which may come after "children"
+    // in the file, so the members are collected first and the children are loaded at the end.
+    struct MemberLocation
+    {
+        std::string key;
+        size_t offset;
+    };
+    std::vector<MemberLocation> members;
+
+    std::string nodeName;
+    std::string parentName;
+    std::string leafType;
+    bool hasParent = false;
+    bool invalidParent = false;
+    bool hasLeafType = false;
+    bool invalidLeafType = false;
+    bool hasModel = false;
+    bool invalidModel = false;
+    int modelIndex = -1;
+    std::optional<double3> translation;
+    std::optional<double4> rotation;
+    std::optional<double3> euler;
+    std::optional<double3> scaling;
+    std::optional<size_t> childrenOffset;
+
+    reader.BeginObject();
+    std::string_view key;
+    while (reader.NextMember(key))
+    {
+        const size_t offset = reader.GetOffset();
+        const json::Reader::ValueType type = reader.Peek();
+        members.push_back({ std::string(key), offset });
+        const std::string& name = members.back().key;
+
+        if (name == "name" && type == json::Reader::ValueType::String)
+        {
+            std::string_view value;
+            reader.ReadString(value);
+            nodeName = value;
+        }
+        else if (name == "parent" && type != json::Reader::ValueType::Null)
+        {
+            hasParent = type == json::Reader::ValueType::String;
+            invalidParent = !hasParent;
+
+            std::string_view value;
+            if (hasParent)
+            {
+                reader.ReadString(value);
+                parentName = value;
+            }
+            else
+                reader.Skip();
+        }
+        else if (name == "model" && type != json::Reader::ValueType::Null)
+        {
+            hasModel = true;
+            double value = 0.0;
+            invalidModel = type != json::Reader::ValueType::Number || !reader.ReadNumber(value) || value != std::floor(value);
+            if (type != json::Reader::ValueType::Number)
+                reader.Skip();
+            modelIndex = invalidModel ? -1 : int(value);
+        }
+        else if (name == "translation" && type != json::Reader::ValueType::Null)
+        {
+            translation = double3::zero();
+            ReadVector(reader, *translation);
+        }
+        else if (name == "rotation" && type != json::Reader::ValueType::Null)
+        {
+            rotation = double4(0.0, 0.0, 0.0, 1.0);
+            ReadVector(reader, *rotation);
+        }
+        else if (name == "euler" && type != json::Reader::ValueType::Null)
+        {
+            euler = double3::zero();
+            ReadVector(reader, *euler);
+        }
+        else if (name == "scaling" && type != json::Reader::ValueType::Null)
+        {
+            scaling = double3(1.0);
+            ReadVector(reader, *scaling);
+        }
+        else if (name == "children" && type != json::Reader::ValueType::Null)
+        {
+            childrenOffset = offset;
+            members.pop_back();
+            reader.Skip();
+        }
+        else if (name == "type" && type != json::Reader::ValueType::Null)
+        {
+            hasLeafType = type == json::Reader::ValueType::String;
+            invalidLeafType = !hasLeafType;
+
+            std::string_view value;
+            if (hasLeafType)
+            {
+                reader.ReadString(value);
+                leafType = value;
+            }
+            else
+                reader.Skip();
+        }
+        else
+            reader.Skip();
+    }
+
+    if (reader.HasError())
+        return;
+
+    const size_t endOffset = reader.GetOffset();
+
+    std::shared_ptr<SceneGraphNode> customParent = parent;
+    if (hasParent)
+    {
+        customParent = m_SceneGraph->FindNode(parentName);
+        if (!customParent)
+        {
+            log::warning("Custom parent '%s' specified for node '%s' not found, skipping the node.",
+                parentName.c_str(), nodeName.c_str());
+            return;
+        }
+    }
+    else if (invalidParent)
+    {
+        log::warning("Custom parent specification for node '%s' is not a string, ignoring.",
+            nodeName.c_str());
+    }
+
+    std::shared_ptr<SceneGraphNode> dst;
+
+    if (hasModel)
+    {
+        if (invalidModel)
+        {
+            log::warning("Model references in the scene graph must be indices into the model array.");
+            return;
+        }
+
+        if (modelIndex < 0 || modelIndex >= int(m_Models.size()))
+        {
+            log::warning("Referenced model %d is not defined in the model array.", modelIndex);
+            return;
+        }
+
+        const auto& loadedModel = m_Models[modelIndex];
+        if (!loadedModel.rootNode)
+        {
+            return;
+        }
+
+        dst = loadedModel.rootNode;
+    }
+    else
+    {
+        dst = std::make_shared<SceneGraphNode>();
+    }
+
+    dst = m_SceneGraph->Attach(customParent, dst);
+
+    dst->SetName(nodeName);
+
+    if (translation.has_value())
+        dst->SetTranslation(*translation);
+
+    if (rotation.has_value())
+        dst->SetRotation(dm::dquat::fromXYZW(*rotation));
+    else if (euler.has_value())
+        dst->SetRotation(rotationQuat(*euler));
+
+    if (scaling.has_value())
+        dst->SetScaling(*scaling);
+
+    if (childrenOffset.has_value())
+    {
+        reader.SetOffset(*childrenOffset);
+        LoadSceneGraph(reader, dst);
+    }
+
+    if (hasLeafType)
+    {
+        auto leaf = m_SceneTypeFactory->CreateLeaf(leafType);
+        if (leaf)
+        {
+            // Leaves are loaded from a document tree, but there are few of them, so build a small one for the node
+            Json::Value src(Json::objectValue);
+            for (const MemberLocation& member : members)
+            {
+                reader.SetOffset(member.offset);
+                reader.ReadValue(src[member.key]);
+            }
+
+            dst->SetLeaf(leaf);
+            leaf->Load(src);
+        }
+        else
+        {
+            log::warning("Unknown leaf type '%s' for node '%s', skipping.",
+                leafType.c_str(), dst->GetName().c_str());
+        }
+    }
+    else if (invalidLeafType)
+    {
+        log::warning("Leaf type specification for node '%s' is not a string, skipping.",
+            dst->GetName().c_str());
+    }
+
+    reader.SetOffset(endOffset);
+}
+
+void SceneGraphLoader::LoadAnimations(json::Reader& reader)
+{
+    if (reader.Peek() != json::Reader::ValueType::Array)
+    {
+        reader.Skip();
+        return;
+    }
+
+    std::shared_ptr<SceneGraphNode> animationContainer;
+
+    reader.BeginArray();
+    while (reader.NextElement())
+    {
+        if (reader.Peek() != json::Reader::ValueType::Object)
+        {
+            reader.Skip();
+            continue;
+        }
+
+        const auto& animation = std::make_shared<SceneGraphAnimation>();
+
+        const auto& sceneAnimationNode = std::make_shared<SceneGraphNode>();
+        sceneAnimationNode->SetLeaf(animation);
+
+        int channelIndex = -1;
+
+        reader.BeginObject();
+        std::string_view key;
+        while (reader.NextMember(key))
+        {
+            if (key == "name" && reader.Peek() == json::Reader::ValueType::String)
+            {
+                std::string_view name;
+                reader.ReadString(name);
+                animation->SetName(std::string(name));
+            }
+            else if (key == "channels" && reader.Peek() == json::Reader::ValueType::Array)
+            {
+                reader.BeginArray();
+                while (reader.NextElement())
+                {
+                    ++channelIndex;
+
+                    if (reader.Peek() == json::Reader::ValueType::Object)
+                        LoadAnimationChannel(reader, animation, channelIndex);
+                    else
+                        reader.Skip();
+                }
+            }
+            else
+                reader.Skip();
+        }
+
+        if (reader.HasError())
+            return;
+
+        if (!animation->GetChannels().empty())
+        {
+            if (!animationContainer)
+            {
+                animationContainer = std::make_shared<SceneGraphNode>();
+                animationContainer->SetName("Animations");
+                m_SceneGraph->Attach(m_SceneGraph->GetRootNode(), animationContainer);
+            }
+            
+            m_SceneGraph->Attach(animationContainer, sceneAnimationNode);
+        }
+        else
+        {
+            log::warning("Animation '%s' processed with no valid channels, ignoring.",
+                animation->GetName().c_str());
+        }
+    }
+}
+
+void SceneGraphLoader::LoadAnimationChannel(json::Reader& reader, const std::shared_ptr<SceneGraphAnimation>& animation, int channelIndex)
+{
+    const auto& sampler = std::make_shared<animation::Sampler>();
+
+    std::optional<std::string> mode;
+    std::string attributeName;
+    std::optional<std::string> target;
+    bool invalidTarget = false;
+    std::vector<std::string> targets;
+    std::vector<bool> invalidTargets;
+
+    reader.BeginObject();
+    std::string_view key;
+    while (reader.NextMember(key))
+    {
+        const json::Reader::ValueType type = reader.Peek();
+
+        if (key == "mode" && type == json::Reader::ValueType::String)
+        {
+            std::string_view value;
+            reader.ReadString(value);
+            mode = std::string(value);
+        }
+        else if (key == "attribute" && type == json::Reader::ValueType::String)
+        {
+            std::string_view value;
+            reader.ReadString(value);
+            attributeName = value;
+        }
+        else if (key == "target" && type != json::Reader::ValueType::Null)
+        {
+            invalidTarget = type != json::Reader::ValueType::String;
+
+            std::string_view value;
+            if (!invalidTarget && reader.ReadString(value))
+                target = std::string(value);
+            else
+            {
+                target = std::string();
+                reader.Skip();
+            }
+        }
+        else if (key == "targets" && type == json::Reader::ValueType::Array)
+        {
+            reader.BeginArray();
+            while (reader.NextElement())
+            {
+                const json::Reader::ValueType targetType = reader.Peek();
+                if (targetType == json::Reader::ValueType::Null)
+                {
+                    reader.Skip();
+                    continue;
+                }
+
+                std::string_view value;
+                if (targetType == json::Reader::ValueType::String && reader.ReadString(value))
+                    targets.emplace_back(value);
+                else
+                {
+                    targets.emplace_back();
+                    reader.Skip();
+                }
+                invalidTargets.push_back(targetType != json::Reader::ValueType::String);
+            }
+        }
+        else if (key == "data" && type == json::Reader::ValueType::Array)
+        {
+            int keyframeIndex = -1;
+
+            reader.BeginArray();
+            while (reader.NextElement())
+            {
+                ++keyframeIndex;
+
+                if (reader.Peek() != json::Reader::ValueType::Object)
+                {
+                    reader.Skip();
+                    continue;
+                }
+
+                animation::Keyframe keyframe;
+                bool hasTime = false;
+
+                reader.BeginObject();
+                std::string_view keyframeKey;
+                while (reader.NextMember(keyframeKey))
+                {
+                    if (keyframeKey == "time" && reader.Peek() == json::Reader::ValueType::Number)
+                    {
+                        double time = 0.0;
+                        reader.ReadNumber(time);
+                        keyframe.time = float(time);
+                        hasTime = true;
+                    }
+                    else if (keyframeKey == "value")
+                        keyframe.value = ReadUpToFloat4(reader);
+                    else if (keyframeKey == "inTangent")
+                        keyframe.inTangent = ReadUpToFloat4(reader);
+                    else if (keyframeKey == "outTangent")
+                        keyframe.outTangent = ReadUpToFloat4(reader);
+                    else
+                        reader.Skip();
+                }
+
+                if (!hasTime)
+                {
+                    log::warning("Invalid keyframe %d in animation '%s' channel %d: time is not specified or is not numeric.",
+                        keyframeIndex, animation->GetName().c_str(), channelIndex);
+                    continue;
+                }
+
+                sampler->AddKeyframe(keyframe);
+            }
+        }
+        else
+            reader.Skip();
+    }
+
+    if (reader.HasError())
+        return;
+
+    SetInterpolationMode(*sampler, mode.has_value() ? mode->c_str() : nullptr, animation->GetName(), channelIndex);
+
+    if (attributeName.empty())
+    {
+        log::warning("Attribute is not specified for animation '%s' channel %d, ignoring.",
+            animation->GetName().c_str(), channelIndex);
+        return;
+    }
+
+    const AnimationAttribute attribute = ParseAnimationAttribute(attributeName);
+
+    auto processTarget = [&](const std::string& targetName, bool invalid)
+    {
+        if (invalid)
+        {
+            log::warning("Target node specification for animation '%s' channel %d is not a string, ignoring.",
+                animation->GetName().c_str(), channelIndex);
+            return;
+        }
+
+        AddAnimationTarget(animation, sampler, attribute, attributeName, targetName, channelIndex);
+    };
+
+    if (target.has_value())
+    {
+        processTarget(*target, invalidTarget);
+    }
+    else
+    {
+        for (size_t i = 0; i < targets.size(); ++i)
+            processTarget(targets[i], invalidTargets[i]);
+    }
+}
+
@@ -376,6 +376,34 @@ const char* donut::engine::MaterialDomainToString(MaterialDomain domain)
     }
 }
 
+bool donut::engine::CopyOccluderGeometry(MeshInfo& mesh)
+{
+    if (mesh.type != MeshType::Triangles || !mesh.buffers)
+        return false;
+
+    const BufferGroup& buffers = *mesh.buffers;
+
+    const uint32_t* indexData = buffers.indexData.empty() ? buffers.indexDataView : buffers.indexData.data();
+    const size_t indexCount = buffers.indexData.empty() ? buffers.indexCount : buffers.indexData.size();
+
+    const float3* positionData = buffers.positionData.data();
+    size_t positionCount = buffers.positionData.size();
+    if (buffers.positionData.empty() && buffers.vertexDataViews[size_t(VertexAttribute::Position)])
+    {
+        positionData = static_cast<const float3*>(buffers.vertexDataViews[size_t(VertexAttribute::Position)]);
+        positionCount = buffers.getVertexBufferRange(VertexAttribute::Position).byteSize / sizeof(float3);
+    }
+
+    if (!indexData || !positionData ||
+        size_t(mesh.indexOffset) + mesh.totalIndices > indexCount ||
+        size_t(mesh.vertexOffset) + mesh.totalVertices > positionCount)
+        return false;
+
+    mesh.occluderIndices.assign(indexData + mesh.indexOffset, indexData + mesh.indexOffset + mesh.totalIndices);
+    mesh.occluderPositions.assign(positionData + mesh.vertexOffset, positionData + mesh.vertexOffset + mesh.totalVertices);
+    return true;
+}
+
 bool LightProbe::IsActive() const
 {
     if (!enabled)
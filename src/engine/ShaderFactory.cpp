@@ -28,6 +28,13 @@
 #if DONUT_WITH_AFTERMATH
 #include <donut/app/AftermathCrashDump.h>
 #endif
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
 
 using namespace std;
 using namespace donut::vfs;
@@ -56,7 +63,11 @@ ShaderFactory::~ShaderFactory()
 
 void ShaderFactory::ClearCache()
 {
+    std::lock_guard<std::shared_mutex> bytecodeGuard(m_BytecodeCacheMutex);
+    std::lock_guard<std::shared_mutex> indexGuard(m_PermutationIndexMutex);
+
 	m_BytecodeCache.clear();
+    m_PermutationIndices.clear();
 }
 
 std::shared_ptr<IBlob> ShaderFactory::GetBytecode(const char* fileName, const char* entryName)
@@ -79,12 +90,18 @@ std::shared_ptr<IBlob> ShaderFactory::GetBytecode(const char* fileName, const ch
 
     std::filesystem::path shaderFilePath = m_basePath / (adjustedName + ".bin");
 
-    std::shared_ptr<IBlob>& data = m_BytecodeCache[shaderFilePath.generic_string()];
+    const std::string cacheKey = shaderFilePath.generic_string();
+
+    {
+        std::shared_lock<std::shared_mutex> guard(m_BytecodeCacheMutex);
 
-    if (data)
-        return data;
+        auto it = m_BytecodeCache.find(cacheKey);
+        if (it != m_BytecodeCache.end())
+            return it->second;
+    }
 
-    data = m_fs->readFile(shaderFilePath);
+    // Read the file without holding the lock, so that other threads can load different shaders meanwhile
+    std::shared_ptr<IBlob> data = m_fs->readFile(shaderFilePath);
 
     if (!data)
     {
@@ -92,7 +109,166 @@ std::shared_ptr<IBlob> ShaderFactory::GetBytecode(const char* fileName, const ch
         return nullptr;
     }
 
-    return data;
+    std::lock_guard<std::shared_mutex> guard(m_BytecodeCacheMutex);
+
+    // If another thread has loaded the same file in the meantime, use its copy
+    auto inserted = m_BytecodeCache.try_emplace(cacheKey, data);
+    return inserted.first->second;
+}
+
+// Builds a permutation key that does not depend on the order of the defines
+static std::string MakePermutationKey(std::vector<std::pair<std::string, std::string>>& defines)
+{
+    std::sort(defines.begin(), defines.end());
+
+    std::string key;
+    for (const auto& [name, value] : defines)
+    {
+        if (!key.empty())
+            key += ' ';
+        key += name;
+        key += '=';
+        key += value;
+    }
+    return key;
+}
+
+// Walks the permutation table of a ShaderMake blob once. The layout matches ShaderMake's ShaderBlob.cpp:
+// the "NVSP" signature, followed by a { permutationSize, dataSize } header, the permutation string
+// and the bytecode for every permutation. Returns false for blobs without the signature or with a truncated table.
+static bool ParsePermutationBlob(const void* blob, size_t blobSize,
+    std::vector<std::pair<std::string, std::pair<const void*, size_t>>>& permutations)
+{
+    static const char c_BlobSignature[] = { 'N', 'V', 'S', 'P' };
+
+    struct BlobEntry
+    {
+        uint32_t permutationSize;
+        uint32_t dataSize;
+    };
+
+    const char* current = static_cast<const char*>(blob);
+    const char* end = current + blobSize;
+
+    if (blobSize < sizeof(c_BlobSignature) || memcmp(current, c_BlobSignature, sizeof(c_BlobSignature)) != 0)
+        return false;
+
+    current += sizeof(c_BlobSignature);
+
+    while (current < end)
+    {
+        if (size_t(end - current) < sizeof(BlobEntry))
+            return false;
+
+        BlobEntry entry;
+        memcpy(&entry, current, sizeof(BlobEntry));
+        current += sizeof(BlobEntry);
+
+        if (size_t(end - current) < size_t(entry.permutationSize) + size_t(entry.dataSize))
+            return false;
+
+        std::string permutation(current, entry.permutationSize);
+        current += entry.permutationSize;
+
+        permutations.push_back(std::make_pair(std::move(permutation), std::make_pair(static_cast<const void*>(current), size_t(entry.dataSize))));
+        current += entry.dataSize;
+    }
+
+    return true;
+}
+
+std::shared_ptr<ShaderFactory::PermutationIndex> ShaderFactory::GetPermutationIndex(const void* blob, size_t blobSize, const std::shared_ptr<IBlob>& owner)
+{
+    const PermutationIndexKey indexKey{ blob, blobSize };
+
+    // An index is only valid for the blob it was built from. Blobs loaded from files are identified
+    // by their owner, so that a new blob allocated at the address of a released one is indexed again.
+    auto isCurrent = [&owner](const PermutationIndex& index)
+    {
+        return index.owner.lock() == owner && index.hasOwner == (owner != nullptr);
+    };
+
+    {
+        std::shared_lock<std::shared_mutex> guard(m_PermutationIndexMutex);
+
+        auto it = m_PermutationIndices.find(indexKey);
+        if (it != m_PermutationIndices.end() && isCurrent(*it->second))
+            return it->second;
+    }
+
+    // Blobs with a single permutation, or that fail to parse, get an empty index
+    // and go through FindPermutationInBlob, which also reports the errors.
+    auto index = std::make_shared<PermutationIndex>();
+    index->owner = owner;
+    index->hasOwner = owner != nullptr;
+
+    std::vector<std::pair<std::string, std::pair<const void*, size_t>>> permutations;
+    if (ParsePermutationBlob(blob, blobSize, permutations) && permutations.size() > 1)
+    {
+        std::vector<std::pair<std::string, std::string>> defines;
+
+        for (const auto& [permutation, bytecode] : permutations)
+        {
+            defines.clear();
+            for (const std::string& define : donut::string_utils::split(permutation, " "))
+            {
+                std::vector<std::string> keyValue = donut::string_utils::split(define, "=");
+                if (keyValue.size() == 2)
+                    defines.push_back(std::make_pair(keyValue[0], keyValue[1]));
+            }
+
+            index->permutations[MakePermutationKey(defines)] = bytecode;
+        }
+    }
+
+    std::lock_guard<std::shared_mutex> guard(m_PermutationIndexMutex);
+
+    std::shared_ptr<PermutationIndex>& cached = m_PermutationIndices[indexKey];
+    if (!cached || !isCurrent(*cached))
+        cached = index;
+    return cached;
+}
+
+bool ShaderFactory::FindPermutation(StaticShader shader, const std::shared_ptr<IBlob>& owner, const std::vector<ShaderMacro>* pDefines, const void** pBytecode, size_t* pSize)
+{
+    std::shared_ptr<PermutationIndex> index = GetPermutationIndex(shader.pBytecode, shader.size, owner);
+
+    if (!index->permutations.empty())
+    {
+        std::vector<std::pair<std::string, std::string>> defines;
+        if (pDefines)
+        {
+            for (const ShaderMacro& define : *pDefines)
+                defines.push_back(std::make_pair(define.name, define.definition));
+        }
+
+        auto it = index->permutations.find(MakePermutationKey(defines));
+        if (it != index->permutations.end())
+        {
+            *pBytecode = it->second.first;
+            *pSize = it->second.second;
+            return true;
+        }
+    }
+
+    // Single-permutation blobs and permutations that are not in the index go through the blob search,
+    // which also produces the error message.
+    vector<ShaderMake::ShaderConstant> constants;
+    if (pDefines)
+    {
+        for (const ShaderMacro& define : *pDefines)
+            constants.push_back(ShaderMake::ShaderConstant{ define.name.c_str(), define.definition.c_str() });
+    }
+
+    if (!ShaderMake::FindPermutationInBlob(shader.pBytecode, shader.size, constants.data(), uint32_t(constants.size()), pBytecode, pSize))
+    {
+        const std::string message = ShaderMake::FormatShaderNotFoundMessage(shader.pBytecode, shader.size, constants.data(), uint32_t(constants.size()));
+        log::error("%s", message.c_str());
+
+        return false;
+    }
+
+    return true;
 }
 
 nvrhi::ShaderHandle ShaderFactory::CreateShader(const char* fileName, const char* entryName, const vector<ShaderMacro>* pDefines, const nvrhi::ShaderDesc& desc)
@@ -107,7 +283,12 @@ nvrhi::ShaderHandle ShaderFactory::CreateShader(const char* fileName, const char
     if (descCopy.debugName.empty())
         descCopy.debugName = fileName;
 
-    return CreateStaticShader(StaticShader{ byteCode->data(), byteCode->size() }, pDefines, descCopy);
+    const void* permutationBytecode = nullptr;
+    size_t permutationSize = 0;
+    if (!FindPermutation(StaticShader{ byteCode->data(), byteCode->size() }, byteCode, pDefines, &permutationBytecode, &permutationSize))
+        return nullptr;
+
+    return m_Device->createShader(descCopy, permutationBytecode, permutationSize);
 }
 
 nvrhi::ShaderHandle ShaderFactory::CreateShader(const char* fileName, const char* entryName, const vector<ShaderMacro>* pDefines, nvrhi::ShaderType shaderType)
@@ -122,7 +303,12 @@ nvrhi::ShaderLibraryHandle ShaderFactory::CreateShaderLibrary(const char* fileNa
     if (!byteCode)
         return nullptr;
 
-    return CreateStaticShaderLibrary(StaticShader{ byteCode->data(), byteCode->size() }, pDefines);
+    const void* permutationBytecode = nullptr;
+    size_t permutationSize = 0;
+    if (!FindPermutation(StaticShader{ byteCode->data(), byteCode->size() }, byteCode, pDefines, &permutationBytecode, &permutationSize))
+        return nullptr;
+
+    return m_Device->createShaderLibrary(permutationBytecode, permutationSize);
 }
 
 nvrhi::ShaderHandle ShaderFactory::CreateStaticShader(StaticShader shader, const std::vector<ShaderMacro>* pDefines, const nvrhi::ShaderDesc& desc)
@@ -130,22 +316,10 @@ nvrhi::ShaderHandle ShaderFactory::CreateStaticShader(StaticShader shader, const
     if (!shader.pBytecode || !shader.size)
         return nullptr;
 
-    vector<ShaderMake::ShaderConstant> constants;
-    if (pDefines)
-    {
-        for (const ShaderMacro& define : *pDefines)
-            constants.push_back(ShaderMake::ShaderConstant{ define.name.c_str(), define.definition.c_str() });
-    }
-
     const void* permutationBytecode = nullptr;
     size_t permutationSize = 0;
-    if (!ShaderMake::FindPermutationInBlob(shader.pBytecode, shader.size, constants.data(), uint32_t(constants.size()), &permutationBytecode, &permutationSize))
-    {
-        const std::string message = ShaderMake::FormatShaderNotFoundMessage(shader.pBytecode, shader.size, constants.data(), uint32_t(constants.size()));
-        log::error("%s", message.c_str());
-        
+    if (!FindPermutation(shader, nullptr, pDefines, &permutationBytecode, &permutationSize))
         return nullptr;
-    }
 
     return m_Device->createShader(desc, permutationBytecode, permutationSize);
 }
@@ -184,22 +358,10 @@ nvrhi::ShaderLibraryHandle ShaderFactory::CreateStaticShaderLibrary(StaticShader
     if (!shader.pBytecode || !shader.size)
         return nullptr;
 
-    vector<ShaderMake::ShaderConstant> constants;
-    if (pDefines)
-    {
-        for (const ShaderMacro& define : *pDefines)
-            constants.push_back(ShaderMake::ShaderConstant{ define.name.c_str(), define.definition.c_str() });
-    }
-    
     const void* permutationBytecode = nullptr;
     size_t permutationSize = 0;
-    if (!ShaderMake::FindPermutationInBlob(shader.pBytecode, shader.size, constants.data(), uint32_t(constants.size()), &permutationBytecode, &permutationSize))
-    {
-        const std::string message = ShaderMake::FormatShaderNotFoundMessage(shader.pBytecode, shader.size, constants.data(), uint32_t(constants.size()));
-        log::error("%s", message.c_str());
-
+    if (!FindPermutation(shader, nullptr, pDefines, &permutationBytecode, &permutationSize))
         return nullptr;
-    }
 
     return m_Device->createShaderLibrary(permutationBytecode, permutationSize);
 }
@@ -250,8 +412,47 @@ nvrhi::ShaderLibraryHandle ShaderFactory::CreateAutoShaderLibrary(const char* fi
     return CreateShaderLibrary(fileName, pDefines);
 }
 
+std::vector<nvrhi::ShaderHandle> ShaderFactory::PreloadShaders(const std::vector<ShaderPreloadDesc>& shaders, tf::Executor* executor)
+{
+    std::vector<nvrhi::ShaderHandle> results(shaders.size());
+
+    auto preloadShader = [this, &shaders, &results](size_t index)
+    {
+        const ShaderPreloadDesc& shader = shaders[index];
+        const std::vector<ShaderMacro>* pDefines = shader.defines.empty() ? nullptr : &shader.defines;
+
+        if (shader.dxbc.pBytecode || shader.dxil.pBytecode || shader.spirv.pBytecode)
+        {
+            results[index] = CreateAutoShader(shader.fileName.c_str(), shader.entryName.c_str(),
+                shader.dxbc, shader.dxil, shader.spirv, pDefines, shader.desc);
+        }
+        else
+        {
+            results[index] = CreateShader(shader.fileName.c_str(), shader.entryName.c_str(), pDefines, shader.desc);
+        }
+    };
+
+#ifdef DONUT_WITH_TASKFLOW
+    if (executor && shaders.size() > 1)
+    {
+        tf::Taskflow taskflow;
+        taskflow.for_each_index(size_t(0), shaders.size(), size_t(1), preloadShader);
+        executor->run(taskflow).wait();
+    }
+    else
+#endif
+    {
+        for (size_t index = 0; index < shaders.size(); index++)
+            preloadShader(index);
+    }
+
+    return results;
+}
+
 std::pair<const void*, size_t> donut::engine::ShaderFactory::FindShaderFromHash(uint64_t hash, std::function<uint64_t(std::pair<const void*, size_t>, nvrhi::GraphicsAPI)> hashGenerator)
 {
+    std::shared_lock<std::shared_mutex> guard(m_BytecodeCacheMutex);
+
     for (auto& entry : m_BytecodeCache)
     {
         const void* shaderBytes = entry.second->data();
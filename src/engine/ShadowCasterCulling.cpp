@@ -0,0 +1,242 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/ShadowCasterCulling.h>
+#include <algorithm>
+
+using namespace donut::math;
+using namespace donut::engine;
+
+namespace
+{
+    // Positive if the points a, b, c make a counter-clockwise turn
+    float Cross(const float2& a, const float2& b, const float2& c)
+    {
+        return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    }
+
+    // A convex volume with 8 corners in the order of frustum::Corners, such as a frustum or a box
+    struct Hexahedron
+    {
+        const float3* corners;
+        plane planes[6]; // normals pointing outside
+
+        explicit Hexahedron(const float3* _corners)
+            : corners(_corners)
+        {
+            float3 center = 0.f;
+            for (uint32_t i = 0; i < frustum::numCorners; i++)
+                center += corners[i];
+            center *= 1.f / float(frustum::numCorners);
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const int u = 1 << ((axis + 1) % 3);
+                const int v = 1 << ((axis + 2) % 3);
+
+                for (int side = 0; side < 2; side++)
+                {
+                    const int face = side << axis;
+                    float3 faceCenter = (corners[face] + corners[face | u] + corners[face | v] + corners[face | u | v]) * 0.25f;
+                    float3 normal = cross(corners[face | u | v] - corners[face], corners[face | v] - corners[face | u]);
+                    if (dot(normal, faceCenter - center) < 0.f)
+                        normal = -normal;
+
+                    // Degenerate faces accept every point
+                    float normalLength = length(normal);
+                    normal = (normalLength > 0.f) ? normal / normalLength : float3(0.f);
+                    planes[axis * 2 + side] = plane(normal, dot(normal, faceCenter));
+                }
+            }
+        }
+
+        [[nodiscard]] bool Contains(const float3& point, float epsilon) const
+        {
+            for (const plane& p : planes)
+            {
+                if (dot(p.normal, point) > p.distance + epsilon)
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    // Adds the corners of a that are inside b, and the points where the edges of a cross the faces of b
+    void AddIntersectionPoints(const Hexahedron& a, const Hexahedron& b, float epsilon, std::vector<float3>& points)
+    {
+        for (uint32_t i = 0; i < frustum::numCorners; i++)
+        {
+            if (b.Contains(a.corners[i], epsilon))
+                points.push_back(a.corners[i]);
+
+            for (uint32_t bit = 1; bit < frustum::numCorners; bit <<= 1)
+            {
+                if (i & bit)
+                    continue;
+
+                const float3& start = a.corners[i];
+                const float3 edge = a.corners[i | bit] - start;
+
+                for (const plane& p : b.planes)
+                {
+                    float denominator = dot(p.normal, edge);
+                    if (denominator == 0.f)
+                        continue;
+
+                    float t = (p.distance - dot(p.normal, start)) / denominator;
+                    if (t < 0.f || t > 1.f)
+                        continue;
+
+                    float3 point = start + edge * t;
+                    if (a.Contains(point, epsilon) && b.Contains(point, epsilon))
+                        points.push_back(point);
+                }
+            }
+        }
+    }
+}
+
+void ShadowReceiverVolume::Setup(const affine3& worldToLight, const float3* corners, size_t numCorners, float maxReceiverDepth)
+{
+    m_WorldToLight = worldToLight;
+    m_Hull.clear();
+    m_HullBounds = box2::empty();
+    m_MaxDepth = -std::numeric_limits<float>::max();
+
+    std::vector<float2> points;
+    points.reserve(numCorners);
+    for (size_t i = 0; i < numCorners; i++)
+    {
+        float3 lightSpace = worldToLight.transformPoint(corners[i]);
+        points.push_back(lightSpace.xy());
+        m_MaxDepth = std::max(m_MaxDepth, lightSpace.z);
+    }
+
+    m_MaxDepth = std::min(m_MaxDepth, maxReceiverDepth);
+
+    // Andrew's monotone chain
+    std::sort(points.begin(), points.end(), [](const float2& a, const float2& b)
+    {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+
+    if (points.size() < 3)
+        return;
+
+    std::vector<float2> hull(points.size() * 2);
+    size_t count = 0;
+
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        while (count >= 2 && Cross(hull[count - 2], hull[count - 1], points[i]) <= 0.f)
+            --count;
+        hull[count++] = points[i];
+    }
+
+    for (size_t i = points.size() - 1, lowerCount = count + 1; i > 0; i--)
+    {
+        while (count >= lowerCount && Cross(hull[count - 2], hull[count - 1], points[i - 1]) <= 0.f)
+            --count;
+        hull[count++] = points[i - 1];
+    }
+
+    // The last point is the same as the first one
+    hull.resize(count - 1);
+
+    if (hull.size() < 3)
+        return;
+
+    m_Hull = std::move(hull);
+    for (const float2& point : m_Hull)
+        m_HullBounds |= point;
+}
+
+void ShadowReceiverVolume::SetupIntersection(const affine3& worldToLight, const float3* receiverCorners, const float3* boundsCorners, float maxReceiverDepth)
+{
+    Hexahedron receivers(receiverCorners);
+    Hexahedron bounds(boundsCorners);
+
+    // The vertices of the intersection of two convex volumes are the corners of either volume that are inside the other,
+    // and the points where the edges of either volume cross the faces of the other.
+    // Keep the points that are slightly outside because of rounding: a larger volume only accepts more casters.
+    float size = std::max(length(receiverCorners[frustum::numCorners - 1] - receiverCorners[0]),
+        length(boundsCorners[frustum::numCorners - 1] - boundsCorners[0]));
+    float epsilon = size * 1e-5f;
+
+    std::vector<float3> points;
+    AddIntersectionPoints(receivers, bounds, epsilon, points);
+    AddIntersectionPoints(bounds, receivers, epsilon, points);
+
+    Setup(worldToLight, points.data(), points.size(), maxReceiverDepth);
+}
+
+void ShadowReceiverVolume::Reset()
+{
+    m_Hull.clear();
+    m_HullBounds = box2::empty();
+}
+
+bool ShadowReceiverVolume::CanShadowReceivers(const box3& casterBounds) const
+{
+    if (!IsValid())
+        return true;
+
+    box3 lightBounds = casterBounds * m_WorldToLight;
+
+    // Casters that are entirely behind the receivers, as seen from the light
+    if (lightBounds.m_mins.z > m_MaxDepth)
+        return false;
+
+    // Separating axis test between the extruded caster rectangle and the receiver polygon:
+    // first the axes of the rectangle, then the edge normals of the polygon
+    box2 rect = box2(lightBounds.m_mins.xy(), lightBounds.m_maxs.xy());
+    if (!rect.intersects(m_HullBounds))
+        return false;
+
+    const float2 rectCorners[4] = {
+        rect.m_mins,
+        float2(rect.m_maxs.x, rect.m_mins.y),
+        rect.m_maxs,
+        float2(rect.m_mins.x, rect.m_maxs.y)
+    };
+
+    for (size_t i = 0; i < m_Hull.size(); i++)
+    {
+        const float2& a = m_Hull[i];
+        const float2& b = m_Hull[(i + 1) % m_Hull.size()];
+
+        bool allOutside = true;
+        for (const float2& corner : rectCorners)
+        {
+            if (Cross(a, b, corner) >= 0.f)
+            {
+                allOutside = false;
+                break;
+            }
+        }
+
+        if (allOutside)
+            return false;
+    }
+
+    return true;
+}
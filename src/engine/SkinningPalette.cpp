@@ -0,0 +1,219 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/SkinningPalette.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/core/trace.h>
+#include <algorithm>
+#include <unordered_map>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define DONUT_SKINNING_SSE 1
+#else
+#define DONUT_SKINNING_SSE 0
+#endif
+
+using namespace donut::math;
+using namespace donut::engine;
+
+// Computes a * b for row-major 4x4 matrices, using SSE where available.
+static void MultiplyMatrices(const float4x4& a, const float4x4& b, float4x4& result)
+{
+#if DONUT_SKINNING_SSE
+    const __m128 b0 = _mm_loadu_ps(b.m_data + 0);
+    const __m128 b1 = _mm_loadu_ps(b.m_data + 4);
+    const __m128 b2 = _mm_loadu_ps(b.m_data + 8);
+    const __m128 b3 = _mm_loadu_ps(b.m_data + 12);
+
+    for (int row = 0; row < 4; row++)
+    {
+        const float* a_row = a.m_data + row * 4;
+        __m128 r = _mm_mul_ps(_mm_set1_ps(a_row[0]), b0);
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a_row[1]), b1));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a_row[2]), b2));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a_row[3]), b3));
+        _mm_storeu_ps(result.m_data + row * 4, r);
+    }
+#else
+    result = a * b;
+#endif
+}
+
+// The root translation is subtracted in double precision, which makes the remaining math safe to do
+// in floats even for instances that are far away from the origin.
+uint32_t SkinningPalette::ComputeInstance(const SkinnedMeshInstance& instance, const SceneGraphNode* const* jointNodes,
+    const int* jointParents, const uint32_t* jointDepths, uint32_t maxJointDepth, float4x4* jointMatrices)
+{
+    const dm::daffine3& rootTransform = instance.GetNode()->GetLocalToWorldTransform();
+    const float4x4 worldToRootLinear = affineToHomogeneous(affine3(float3x3(inverse(rootTransform.m_linear)), float3::zero()));
+
+    uint32_t computedJoints = 0;
+    for (size_t i = 0; i < instance.joints.size(); i++)
+    {
+        if (jointDepths[i] > maxJointDepth)
+            continue;
+
+        const SceneGraphNode* jointNode = jointNodes[i];
+        if (!jointNode)
+        {
+            jointMatrices[i] = float4x4::identity();
+            continue;
+        }
+
+        const float3 jointTranslation = float3(jointNode->GetLocalToWorldTransform().m_translation - rootTransform.m_translation);
+        const float4x4 jointToRootOrigin = affineToHomogeneous(affine3(jointNode->GetLocalToWorldTransformFloat().m_linear, jointTranslation));
+
+        float4x4 jointToRoot;
+        MultiplyMatrices(jointToRootOrigin, worldToRootLinear, jointToRoot);
+        MultiplyMatrices(instance.joints[i].inverseBindMatrix, jointToRoot, jointMatrices[i]);
+        ++computedJoints;
+    }
+
+    // A joint that keeps its bind pose relative to an ancestor has the same skinning matrix as that ancestor,
+    // so the joints below the LOD depth simply copy the matrix of their ancestor at that depth.
+    for (size_t i = 0; i < instance.joints.size(); i++)
+    {
+        if (jointDepths[i] <= maxJointDepth)
+            continue;
+
+        int ancestor = jointParents[i];
+        while (jointDepths[ancestor] > maxJointDepth)
+            ancestor = jointParents[ancestor];
+
+        jointMatrices[i] = jointMatrices[ancestor];
+    }
+
+    return computedJoints;
+}
+
+void SkinningPalette::SetInstances(const std::vector<std::shared_ptr<SkinnedMeshInstance>>& instances)
+{
+    m_JointNodes.clear();
+    m_JointParents.clear();
+    m_JointDepths.clear();
+    std::unordered_map<const SceneGraphNode*, int> jointIndices;
+
+    for (const auto& skinnedInstance : instances)
+    {
+        skinnedInstance->jointBufferOffset = uint32_t(m_JointNodes.size());
+
+        for (const auto& joint : skinnedInstance->joints)
+            m_JointNodes.push_back(joint.node.lock().get());
+
+        // Find the skeleton hierarchy for the joint LOD
+        const SceneGraphNode* const* instanceJoints = m_JointNodes.data() + skinnedInstance->jointBufferOffset;
+        const int jointCount = int(skinnedInstance->joints.size());
+
+        jointIndices.clear();
+        for (int i = 0; i < jointCount; i++)
+        {
+            if (instanceJoints[i])
+                jointIndices[instanceJoints[i]] = i;
+        }
+
+        for (int i = 0; i < jointCount; i++)
+        {
+            int parent = -1;
+            for (const SceneGraphNode* node = instanceJoints[i] ? instanceJoints[i]->GetParent() : nullptr; node; node = node->GetParent())
+            {
+                auto it = jointIndices.find(node);
+                if (it != jointIndices.end())
+                {
+                    parent = it->second;
+                    break;
+                }
+            }
+            m_JointParents.push_back(parent);
+        }
+
+        // Joints may be listed in any order, so resolve the depths by walking up the parents
+        const int* instanceParents = m_JointParents.data() + skinnedInstance->jointBufferOffset;
+        for (int i = 0; i < jointCount; i++)
+        {
+            uint32_t depth = 0;
+            for (int parent = instanceParents[i]; parent >= 0 && depth <= uint32_t(jointCount); parent = instanceParents[parent])
+                ++depth;
+            m_JointDepths.push_back(depth);
+        }
+    }
+
+    m_JointMatrices.resize(m_JointNodes.size());
+}
+
+uint32_t SkinningPalette::Compute(const SkinnedMeshInstance* const* instances, const uint32_t* maxJointDepths, size_t count,
+    tf::Executor* executor)
+{
+    DONUT_TRACE_ZONE("SkinningPalette::Compute");
+
+    m_ComputedJoints.resize(count);
+
+    // Every instance writes its own range of the palette, so the instances can be processed in any order
+    auto computeInstance = [this, instances, maxJointDepths](size_t index)
+    {
+        const SkinnedMeshInstance* skinnedInstance = instances[index];
+        const uint32_t offset = skinnedInstance->jointBufferOffset;
+        const uint32_t maxJointDepth = maxJointDepths ? maxJointDepths[index] : ~0u;
+        m_ComputedJoints[index] = ComputeInstance(*skinnedInstance, m_JointNodes.data() + offset,
+            m_JointParents.data() + offset, m_JointDepths.data() + offset, maxJointDepth, m_JointMatrices.data() + offset);
+    };
+
+#ifdef DONUT_WITH_TASKFLOW
+    if (executor && count > 1)
+    {
+        tf::Taskflow taskflow;
+        taskflow.for_each_index(size_t(0), count, size_t(1), computeInstance);
+        executor->run(taskflow).wait();
+    }
+    else
+#endif
+    {
+        for (size_t index = 0; index < count; index++)
+            computeInstance(index);
+    }
+
+    uint32_t computedJoints = 0;
+    for (size_t index = 0; index < count; index++)
+        computedJoints += m_ComputedJoints[index];
+
+    return computedJoints;
+}
+
+SkinningUpdate donut::engine::ScheduleSkinningUpdate(SkinnedMeshInstance& instance, uint32_t frameIndex, uint32_t instanceIndex,
+    uint32_t updateInterval)
+{
+    const bool animated = !instance.skinningInitialized || instance.GetLastUpdateFrameIndex() > instance.lastSkinningFrameIndex;
+    if (!animated && instance.skinningSettled)
+        return SkinningUpdate::Idle;
+
+    const uint32_t interval = std::max(updateInterval, 1u);
+    if (instance.skinningInitialized && (frameIndex + instanceIndex) % interval != 0)
+        return SkinningUpdate::Deferred;
+
+    instance.lastSkinningFrameIndex = frameIndex;
+    instance.skinningSettled = !animated;
+    return SkinningUpdate::Scheduled;
+}
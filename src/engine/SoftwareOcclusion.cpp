@@ -0,0 +1,328 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/SoftwareOcclusion.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define DONUT_OCCLUSION_SSE 1
+#else
+#define DONUT_OCCLUSION_SSE 0
+#endif
+
+using namespace donut::math;
+using namespace donut::engine;
+
+SoftwareOcclusionBuffer::SoftwareOcclusionBuffer(uint32_t width, uint32_t height)
+    : m_Width(std::max((width + TileSize - 1) / TileSize, 1u) * TileSize)
+    , m_Height(std::max((height + TileSize - 1) / TileSize, 1u) * TileSize)
+{
+    m_TilesX = m_Width / TileSize;
+    m_TilesY = m_Height / TileSize;
+    m_Depth.resize(m_Width * m_Height, 1.f);
+    m_TileMaxDepth.resize(m_TilesX * m_TilesY, 1.f);
+}
+
+void SoftwareOcclusionBuffer::Begin(const float4x4& viewProjMatrix, bool reverseDepth)
+{
+    m_ViewProjMatrix = viewProjMatrix;
+    m_ReverseDepth = reverseDepth;
+
+    std::fill(m_Depth.begin(), m_Depth.end(), 1.f);
+    std::fill(m_TileMaxDepth.begin(), m_TileMaxDepth.end(), 1.f);
+}
+
+float3 SoftwareOcclusionBuffer::ClipToScreen(const float4& clip) const
+{
+    float invW = 1.f / clip.w;
+    float depth = clip.z * invW;
+    if (m_ReverseDepth)
+        depth = 1.f - depth;
+
+    return float3(
+        (clip.x * invW * 0.5f + 0.5f) * float(m_Width),
+        (0.5f - clip.y * invW * 0.5f) * float(m_Height),
+        depth);
+}
+
+uint32_t SoftwareOcclusionBuffer::RasterizeTriangles(const float3* positions, const uint32_t* indices, size_t numIndices, const affine3& objectToWorld)
+{
+    const float4x4 objectToClip = affineToHomogeneous(objectToWorld) * m_ViewProjMatrix;
+
+    uint32_t rasterizedTriangles = 0;
+    for (size_t i = 0; i + 2 < numIndices; i += 3)
+    {
+        float4 clip[3];
+        for (int vertex = 0; vertex < 3; vertex++)
+            clip[vertex] = float4(positions[indices[i + vertex]], 1.f) * objectToClip;
+
+        if (NearPlaneDistance(clip[0]) < 0.f && NearPlaneDistance(clip[1]) < 0.f && NearPlaneDistance(clip[2]) < 0.f)
+            continue;
+
+        RasterizeClippedTriangle(clip);
+        ++rasterizedTriangles;
+    }
+
+    return rasterizedTriangles;
+}
+
+void SoftwareOcclusionBuffer::RasterizeClippedTriangle(const float4* clip)
+{
+    // Clip the triangle against the near plane, which produces at most 4 vertices
+    float4 polygon[4];
+    int numVertices = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        const float4& a = clip[i];
+        const float4& b = clip[(i + 1) % 3];
+        float distanceA = NearPlaneDistance(a);
+        float distanceB = NearPlaneDistance(b);
+
+        if (distanceA >= 0.f)
+            polygon[numVertices++] = a;
+
+        if ((distanceA >= 0.f) != (distanceB >= 0.f))
+        {
+            float t = distanceA / (distanceA - distanceB);
+            polygon[numVertices++] = a + (b - a) * t;
+        }
+    }
+
+    if (numVertices < 3)
+        return;
+
+    float3 screen[4];
+    for (int i = 0; i < numVertices; i++)
+    {
+        if (polygon[i].w <= 1e-6f)
+            return;
+
+        screen[i] = ClipToScreen(polygon[i]);
+    }
+
+    RasterizeScreenTriangle(screen[0], screen[1], screen[2]);
+    if (numVertices == 4)
+        RasterizeScreenTriangle(screen[0], screen[2], screen[3]);
+}
+
+void SoftwareOcclusionBuffer::RasterizeScreenTriangle(float3 v0, float3 v1, float3 v2)
+{
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (std::abs(area) < 1e-6f)
+        return;
+
+    if (area < 0.f)
+    {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    int minX = std::max(0, int(std::floor(std::min(v0.x, std::min(v1.x, v2.x)))));
+    int maxX = std::min(int(m_Width) - 1, int(std::ceil(std::max(v0.x, std::max(v1.x, v2.x)))));
+    int minY = std::max(0, int(std::floor(std::min(v0.y, std::min(v1.y, v2.y)))));
+    int maxY = std::min(int(m_Height) - 1, int(std::ceil(std::max(v0.y, std::max(v1.y, v2.y)))));
+
+    if (minX > maxX || minY > maxY)
+        return;
+
+    // Start the rows at a multiple of 4 pixels, the width is a multiple of 4 so the last group stays inside the row
+    minX &= ~3;
+
+    // Edge functions: w0 is the weight of v0 and is zero on the edge v1-v2, etc.
+    // Their derivatives along X and Y are constant over the triangle, and so is the derivative of depth.
+    float invArea = 1.f / area;
+    float w0dx = -(v2.y - v1.y), w0dy = v2.x - v1.x;
+    float w1dx = -(v0.y - v2.y), w1dy = v0.x - v2.x;
+    float w2dx = -(v1.y - v0.y), w2dy = v1.x - v0.x;
+    float zdx = (w0dx * v0.z + w1dx * v1.z + w2dx * v2.z) * invArea;
+    float zdy = (w0dy * v0.z + w1dy * v1.z + w2dy * v2.z) * invArea;
+
+    float px = float(minX) + 0.5f;
+    float py = float(minY) + 0.5f;
+    float w0Row = (v2.x - v1.x) * (py - v1.y) - (v2.y - v1.y) * (px - v1.x);
+    float w1Row = (v0.x - v2.x) * (py - v2.y) - (v0.y - v2.y) * (px - v2.x);
+    float w2Row = (v1.x - v0.x) * (py - v0.y) - (v1.y - v0.y) * (px - v0.x);
+    float zRow = (w0Row * v0.z + w1Row * v1.z + w2Row * v2.z) * invArea;
+
+#if DONUT_OCCLUSION_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 lanes = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+    const __m128 w0Lanes = _mm_mul_ps(lanes, _mm_set1_ps(w0dx));
+    const __m128 w1Lanes = _mm_mul_ps(lanes, _mm_set1_ps(w1dx));
+    const __m128 w2Lanes = _mm_mul_ps(lanes, _mm_set1_ps(w2dx));
+    const __m128 zLanes = _mm_mul_ps(lanes, _mm_set1_ps(zdx));
+    const __m128 w0Step = _mm_set1_ps(w0dx * 4.f);
+    const __m128 w1Step = _mm_set1_ps(w1dx * 4.f);
+    const __m128 w2Step = _mm_set1_ps(w2dx * 4.f);
+    const __m128 zStep = _mm_set1_ps(zdx * 4.f);
+#endif
+
+    for (int y = minY; y <= maxY; y++)
+    {
+        float* row = m_Depth.data() + size_t(y) * m_Width;
+
+#if DONUT_OCCLUSION_SSE
+        __m128 w0 = _mm_add_ps(_mm_set1_ps(w0Row), w0Lanes);
+        __m128 w1 = _mm_add_ps(_mm_set1_ps(w1Row), w1Lanes);
+        __m128 w2 = _mm_add_ps(_mm_set1_ps(w2Row), w2Lanes);
+        __m128 z = _mm_add_ps(_mm_set1_ps(zRow), zLanes);
+
+        for (int x = minX; x <= maxX; x += 4)
+        {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+            if (_mm_movemask_ps(inside))
+            {
+                __m128 depth = _mm_min_ps(_mm_max_ps(z, zero), one);
+                __m128 stored = _mm_loadu_ps(row + x);
+                __m128 result = _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(stored, depth)), _mm_andnot_ps(inside, stored));
+                _mm_storeu_ps(row + x, result);
+            }
+
+            w0 = _mm_add_ps(w0, w0Step);
+            w1 = _mm_add_ps(w1, w1Step);
+            w2 = _mm_add_ps(w2, w2Step);
+            z = _mm_add_ps(z, zStep);
+        }
+#else
+        float w0 = w0Row, w1 = w1Row, w2 = w2Row, z = zRow;
+        for (int x = minX; x <= maxX; x++)
+        {
+            if (w0 >= 0.f && w1 >= 0.f && w2 >= 0.f)
+                row[x] = std::min(row[x], clamp(z, 0.f, 1.f));
+
+            w0 += w0dx;
+            w1 += w1dx;
+            w2 += w2dx;
+            z += zdx;
+        }
+#endif
+
+        w0Row += w0dy;
+        w1Row += w1dy;
+        w2Row += w2dy;
+        zRow += zdy;
+    }
+}
+
+void SoftwareOcclusionBuffer::End()
+{
+    for (uint32_t tileY = 0; tileY < m_TilesY; tileY++)
+    {
+        for (uint32_t tileX = 0; tileX < m_TilesX; tileX++)
+        {
+            float maxDepth = 0.f;
+            for (uint32_t y = 0; y < TileSize; y++)
+            {
+                const float* row = m_Depth.data() + size_t(tileY * TileSize + y) * m_Width + tileX * TileSize;
+                for (uint32_t x = 0; x < TileSize; x++)
+                    maxDepth = std::max(maxDepth, row[x]);
+            }
+
+            m_TileMaxDepth[tileY * m_TilesX + tileX] = maxDepth;
+        }
+    }
+}
+
+bool SoftwareOcclusionBuffer::ProjectBox(const box3& worldBox, float2& minScreen, float2& maxScreen, float& minDepth) const
+{
+    minScreen = float2(std::numeric_limits<float>::max());
+    maxScreen = float2(-std::numeric_limits<float>::max());
+    minDepth = std::numeric_limits<float>::max();
+
+    for (int corner = 0; corner < box3::numCorners; corner++)
+    {
+        float4 clip = float4(worldBox.getCorner(corner), 1.f) * m_ViewProjMatrix;
+        if (NearPlaneDistance(clip) < 0.f || clip.w <= 1e-6f)
+            return false;
+
+        float3 screen = ClipToScreen(clip);
+        minScreen = min(minScreen, screen.xy());
+        maxScreen = max(maxScreen, screen.xy());
+        minDepth = std::min(minDepth, screen.z);
+    }
+
+    return true;
+}
+
+bool SoftwareOcclusionBuffer::IsBoxVisible(const box3& worldBox) const
+{
+    float2 minScreen, maxScreen;
+    float minDepth;
+    if (!ProjectBox(worldBox, minScreen, maxScreen, minDepth))
+        return true;
+
+    // A pixel is covered by an occluder when its center is, so the occluder may only cover a part of the pixels
+    // on its edges. Testing one more pixel around the box keeps those partially covered pixels from hiding it.
+    int minX = std::max(0, int(std::floor(minScreen.x)) - 1);
+    int maxX = std::min(int(m_Width) - 1, int(std::floor(maxScreen.x)) + 1);
+    int minY = std::max(0, int(std::floor(minScreen.y)) - 1);
+    int maxY = std::min(int(m_Height) - 1, int(std::floor(maxScreen.y)) + 1);
+
+    if (minX > maxX || minY > maxY)
+        return false;
+
+    for (int tileY = minY / int(TileSize); tileY <= maxY / int(TileSize); tileY++)
+    {
+        for (int tileX = minX / int(TileSize); tileX <= maxX / int(TileSize); tileX++)
+        {
+            // All pixels of the tile are nearer than the box
+            if (m_TileMaxDepth[tileY * m_TilesX + tileX] < minDepth)
+                continue;
+
+            int tileMinX = tileX * int(TileSize);
+            int tileMinY = tileY * int(TileSize);
+            int tileMaxX = tileMinX + int(TileSize) - 1;
+            int tileMaxY = tileMinY + int(TileSize) - 1;
+
+            // The box covers the whole tile, including its farthest pixel
+            if (minX <= tileMinX && maxX >= tileMaxX && minY <= tileMinY && maxY >= tileMaxY)
+                return true;
+
+            for (int y = std::max(minY, tileMinY); y <= std::min(maxY, tileMaxY); y++)
+            {
+                const float* row = m_Depth.data() + size_t(y) * m_Width;
+                for (int x = std::max(minX, tileMinX); x <= std::min(maxX, tileMaxX); x++)
+                {
+                    if (row[x] >= minDepth)
+                        return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+float SoftwareOcclusionBuffer::GetScreenSize(const box3& worldBox) const
+{
+    float2 minScreen, maxScreen;
+    float minDepth;
+    if (!ProjectBox(worldBox, minScreen, maxScreen, minDepth))
+        return 1.f;
+
+    return std::max((maxScreen.x - minScreen.x) / float(m_Width), (maxScreen.y - minScreen.y) / float(m_Height));
+}
@@ -47,11 +47,13 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <donut/engine/TextureCache.h>
 
+#include <donut/engine/AsyncReadback.h>
 #include <donut/engine/CommonRenderPasses.h>
 #include <donut/engine/ConsoleObjects.h>
 #include <donut/engine/DDSFile.h>
 #include <donut/core/vfs/VFS.h>
 #include <donut/core/log.h>
+#include <donut/core/trace.h>
 
 #ifdef DONUT_WITH_TASKFLOW
 #include <taskflow/taskflow.hpp>
@@ -685,6 +687,8 @@ std::shared_ptr<TextureData> TextureCache::GetLoadedTexture(std::filesystem::pat
 
 bool TextureCache::ProcessRenderingThreadCommands(CommonRenderPasses& passes, float timeLimitMilliseconds)
 {
+    DONUT_TRACE_ZONE("TextureCache::ProcessRenderingThreadCommands");
+
     using namespace std::chrono;
 
     time_point<high_resolution_clock> startTime = high_resolution_clock::now();
@@ -750,156 +754,292 @@ void TextureCache::SetMaxTextureSize(uint32_t size)
 
 namespace donut::engine
 {
-    bool SaveTextureToFile(
-        nvrhi::IDevice* device,
-        CommonRenderPasses* pPasses,
-        nvrhi::ITexture* texture,
-        nvrhi::ResourceStates textureState,
-        const char* fileName,
-        bool saveAlphaChannel)
+    enum class ImageFileFormat
+    {
+        Unknown,
+        BMP,
+        PNG,
+        JPG,
+        TGA,
+        EXR
+    };
+
+    static ImageFileFormat GetImageFileFormat(const char* fileName)
     {
-        if (!fileName)
-            return false;
-
         // Find the file's extension
         char const* ext = strrchr(fileName, '.');
 
         if (!ext)
-            return false; // No extension fond in the file name
+            return ImageFileFormat::Unknown; // No extension fond in the file name
 
         // Determine the image format from the extension
-        enum { BMP, PNG, JPG, TGA } destFormat;
         if (strcasecmp(ext, ".bmp") == 0)
-            destFormat = BMP;
-        else if (strcasecmp(ext, ".png") == 0)
-            destFormat = PNG;
-        else if (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0)
-            destFormat = JPG;
-        else if (strcasecmp(ext, ".tga") == 0)
-            destFormat = TGA;
-        else
-            return false; // Unknown file type
-        
-        if (destFormat == JPG)
-            saveAlphaChannel = false;
+            return ImageFileFormat::BMP;
+        if (strcasecmp(ext, ".png") == 0)
+            return ImageFileFormat::PNG;
+        if (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0)
+            return ImageFileFormat::JPG;
+        if (strcasecmp(ext, ".tga") == 0)
+            return ImageFileFormat::TGA;
+        if (strcasecmp(ext, ".exr") == 0)
+            return ImageFileFormat::EXR;
+
+        return ImageFileFormat::Unknown; // Unknown file type
+    }
 
+    // Records the commands that convert the texture into the format that is read back for the image file:
+    // RGBA32_FLOAT for EXR files, RGBA8 for the others. Returns the texture to read back.
+    static nvrhi::TextureHandle ConvertTextureForSaving(
+        nvrhi::IDevice* device,
+        CommonRenderPasses* pPasses,
+        nvrhi::ICommandList* commandList,
+        nvrhi::ITexture* texture,
+        ImageFileFormat destFormat)
+    {
         nvrhi::TextureDesc desc = texture->getDesc();
-        nvrhi::TextureHandle tempTexture;
-        nvrhi::FramebufferHandle tempFramebuffer;
 
-        nvrhi::CommandListHandle commandList = device->createCommandList();
-        commandList->open();
-
-        if (textureState != nvrhi::ResourceStates::Unknown)
+        // If the source texture format is not RGBA8, create a temporary texture and blit into it to convert
+        if (destFormat == ImageFileFormat::EXR)
         {
-            commandList->beginTrackingTextureState(texture, nvrhi::TextureSubresourceSet(0, 1, 0, 1), textureState);
-        }
+            if (desc.format == nvrhi::Format::RGBA32_FLOAT)
+                return texture;
 
-        // If the source texture format is not RGBA8, create a temporary texture and blit into it to convert
-        switch (desc.format)
+            desc.format = nvrhi::Format::RGBA32_FLOAT;
+        }
+        else
         {
-        case nvrhi::Format::RGBA8_UNORM:
-        case nvrhi::Format::SRGBA8_UNORM:
-            tempTexture = texture;
-            break;
-        default:
+            if (desc.format == nvrhi::Format::RGBA8_UNORM || desc.format == nvrhi::Format::SRGBA8_UNORM)
+                return texture;
+
             desc.format = nvrhi::Format::SRGBA8_UNORM;
-            desc.isRenderTarget = true;
-            desc.initialState = nvrhi::ResourceStates::RenderTarget;
-            desc.keepInitialState = true;
-
-            tempTexture = device->createTexture(desc);
-            tempFramebuffer = device->createFramebuffer(nvrhi::FramebufferDesc().addColorAttachment(tempTexture));
-            
-            pPasses->BlitTexture(commandList, tempFramebuffer, texture);
         }
 
-        // Create a staging texture to access the data from the CPU, copy the data into it
-        nvrhi::StagingTextureHandle stagingTexture = device->createStagingTexture(desc, nvrhi::CpuAccessMode::Read);
-        commandList->copyTexture(stagingTexture, nvrhi::TextureSlice(), tempTexture, nvrhi::TextureSlice());
-
-        if (textureState != nvrhi::ResourceStates::Unknown)
-        {
-            commandList->setTextureState(texture, nvrhi::TextureSubresourceSet(0, 1, 0, 1), textureState);
-            commandList->commitBarriers();
-        }
+        desc.isRenderTarget = true;
+        desc.initialState = nvrhi::ResourceStates::RenderTarget;
+        desc.keepInitialState = true;
 
-        commandList->close();
-        device->executeCommandList(commandList);
+        nvrhi::TextureHandle tempTexture = device->createTexture(desc);
+        nvrhi::FramebufferHandle tempFramebuffer = device->createFramebuffer(nvrhi::FramebufferDesc().addColorAttachment(tempTexture));
 
-        // Map the staging texture
-        size_t rowPitch = 0;
-        uint8_t const* pData = static_cast<uint8_t const*>(device->mapStagingTexture(
-            stagingTexture, nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &rowPitch));
+        pPasses->BlitTexture(commandList, tempFramebuffer, texture);
 
-        if (!pData)
-            return false;
+        return tempTexture;
+    }
 
-        uint8_t* newData = nullptr;
+    // Writes an image from 4-channel pixels, RGBA8 or RGBA32_FLOAT for EXR files, dropping the alpha channel if requested.
+    static bool WriteImageFile(
+        const char* fileName,
+        ImageFileFormat destFormat,
+        uint32_t width,
+        uint32_t height,
+        uint8_t const* pData,
+        size_t rowPitch,
+        bool saveAlphaChannel)
+    {
         int channels = saveAlphaChannel ? 4 : 3;
+        size_t channelSize = (destFormat == ImageFileFormat::EXR) ? sizeof(float) : 1;
+        size_t pixelSize = channels * channelSize;
 
-        // If the mapped data is not laid out in a densely packed format with the right number of channels,
-        // create a temporary buffer and move the data into the right layout for stb_image.
-        if (rowPitch != desc.width * channels)
+        // If the data is not laid out in a densely packed format with the right number of channels,
+        // move it into the right layout for stb_image and tinyexr.
+        std::vector<uint8_t> newData;
+        if (rowPitch != width * pixelSize)
         {
-            newData = new uint8_t[desc.width * desc.height * channels];
+            newData.resize(width * height * pixelSize);
 
-            for (uint32_t row = 0; row < desc.height; ++row)
+            for (uint32_t row = 0; row < height; ++row)
             {
-                uint8_t* dstRow = newData + row * desc.width * channels;
+                uint8_t* dstRow = newData.data() + row * width * pixelSize;
                 uint8_t const* srcRow = pData + row * rowPitch;
 
                 if (channels == 4)
                 {
                     // Simple row copy
-                    memcpy(dstRow, srcRow, desc.width * channels);
+                    memcpy(dstRow, srcRow, width * pixelSize);
                 }
                 else
                 {
                     // Convert 4 channels to 3
-                    for (uint32_t col = 0; col < desc.width; ++col)
+                    for (uint32_t col = 0; col < width; ++col)
                     {
-                        dstRow[0] = srcRow[0];
-                        dstRow[1] = srcRow[1];
-                        dstRow[2] = srcRow[2];
-                        dstRow += 3;
-                        srcRow += 4;
+                        memcpy(dstRow, srcRow, pixelSize);
+                        dstRow += pixelSize;
+                        srcRow += 4 * channelSize;
                     }
                 }
             }
 
-            pData = newData;
+            pData = newData.data();
         }
 
         // Write the output image
         bool writeSuccess = false;
         switch(destFormat)
         {
-            case BMP: 
-                writeSuccess = stbi_write_bmp(fileName, int(desc.width), int(desc.height), channels, pData) != 0;
+            case ImageFileFormat::BMP: 
+                writeSuccess = stbi_write_bmp(fileName, int(width), int(height), channels, pData) != 0;
                 break;
-            case PNG: 
-                writeSuccess = stbi_write_png(fileName, int(desc.width), int(desc.height), channels, pData, desc.width * channels) != 0;
+            case ImageFileFormat::PNG: 
+                writeSuccess = stbi_write_png(fileName, int(width), int(height), channels, pData, int(width) * channels) != 0;
                 break;
-            case JPG: 
-                writeSuccess = stbi_write_jpg(fileName, int(desc.width), int(desc.height), channels, pData, /* quality = */ 99) != 0;
+            case ImageFileFormat::JPG: 
+                writeSuccess = stbi_write_jpg(fileName, int(width), int(height), channels, pData, /* quality = */ 99) != 0;
                 break;
-            case TGA: 
-                writeSuccess = stbi_write_tga(fileName, int(desc.width), int(desc.height), channels, pData) != 0;
+            case ImageFileFormat::TGA: 
+                writeSuccess = stbi_write_tga(fileName, int(width), int(height), channels, pData) != 0;
+                break;
+            case ImageFileFormat::EXR: {
+#ifdef DONUT_WITH_TINYEXR
+                char const* err = nullptr;
+                writeSuccess = SaveEXR(reinterpret_cast<float const*>(pData), int(width), int(height), channels,
+                    /* save_as_fp16 = */ 1, fileName, &err) == TINYEXR_SUCCESS;
+
+                if (err)
+                {
+                    log::warning("Couldn't save EXR image '%s': %s", fileName, err);
+                    FreeEXRErrorMessage(err);
+                }
+#else
+                log::warning("Couldn't save '%s': Donut is built without EXR support", fileName);
+#endif
+                break;
+            }
+            default:
                 break;
         }
+
+        return writeSuccess;
+    }
+
+    bool SaveTextureToFile(
+        nvrhi::IDevice* device,
+        CommonRenderPasses* pPasses,
+        nvrhi::ITexture* texture,
+        nvrhi::ResourceStates textureState,
+        const char* fileName,
+        bool saveAlphaChannel)
+    {
+        if (!fileName)
+            return false;
+
+        ImageFileFormat destFormat = GetImageFileFormat(fileName);
+        if (destFormat == ImageFileFormat::Unknown)
+            return false;
         
-        if (newData)
+        if (destFormat == ImageFileFormat::JPG)
+            saveAlphaChannel = false;
+
+        nvrhi::CommandListHandle commandList = device->createCommandList();
+        commandList->open();
+
+        if (textureState != nvrhi::ResourceStates::Unknown)
         {
-            delete[] newData;
-            newData = nullptr;
+            commandList->beginTrackingTextureState(texture, nvrhi::TextureSubresourceSet(0, 1, 0, 1), textureState);
         }
 
+        nvrhi::TextureHandle tempTexture = ConvertTextureForSaving(device, pPasses, commandList, texture, destFormat);
+        nvrhi::TextureDesc desc = tempTexture->getDesc();
+
+        // Create a staging texture to access the data from the CPU, copy the data into it
+        nvrhi::StagingTextureHandle stagingTexture = device->createStagingTexture(desc, nvrhi::CpuAccessMode::Read);
+        commandList->copyTexture(stagingTexture, nvrhi::TextureSlice(), tempTexture, nvrhi::TextureSlice());
+
+        if (textureState != nvrhi::ResourceStates::Unknown)
+        {
+            commandList->setTextureState(texture, nvrhi::TextureSubresourceSet(0, 1, 0, 1), textureState);
+            commandList->commitBarriers();
+        }
+
+        commandList->close();
+        device->executeCommandList(commandList);
+
+        // Map the staging texture
+        size_t rowPitch = 0;
+        uint8_t const* pData = static_cast<uint8_t const*>(device->mapStagingTexture(
+            stagingTexture, nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &rowPitch));
+
+        if (!pData)
+            return false;
+
+        bool writeSuccess = WriteImageFile(fileName, destFormat, desc.width, desc.height, pData, rowPitch, saveAlphaChannel);
+
         device->unmapStagingTexture(stagingTexture);
 
         return writeSuccess;
     }
 
+    std::future<bool> SaveTextureToFileAsync(
+        nvrhi::IDevice* device,
+        CommonRenderPasses* pPasses,
+        nvrhi::ICommandList* commandList,
+        nvrhi::ITexture* texture,
+        nvrhi::ResourceStates textureState,
+        AsyncReadback& readback,
+        const char* fileName,
+        bool saveAlphaChannel,
+        tf::Executor* executor)
+    {
+        auto promise = std::make_shared<std::promise<bool>>();
+        std::future<bool> future = promise->get_future();
+
+        ImageFileFormat destFormat = fileName ? GetImageFileFormat(fileName) : ImageFileFormat::Unknown;
+        if (destFormat == ImageFileFormat::Unknown)
+        {
+            promise->set_value(false);
+            return future;
+        }
+
+        if (destFormat == ImageFileFormat::JPG)
+            saveAlphaChannel = false;
+
+        if (textureState != nvrhi::ResourceStates::Unknown)
+        {
+            commandList->beginTrackingTextureState(texture, nvrhi::TextureSubresourceSet(0, 1, 0, 1), textureState);
+        }
+
+        nvrhi::TextureHandle tempTexture = ConvertTextureForSaving(device, pPasses, commandList, texture, destFormat);
+
+        // The temporary texture is kept alive by the callback until the copy is complete
+        readback.ReadTexture(commandList, tempTexture, nvrhi::TextureSlice(),
+            [promise, tempTexture, fileName = std::string(fileName), destFormat, saveAlphaChannel, executor](ReadbackImage& image)
+            {
+                if (image.data.empty())
+                {
+                    promise->set_value(false);
+                    return;
+                }
+
+                // Take the pixels once: the task is copied by std::function and by the executor
+                auto pixels = std::make_shared<ReadbackImage>(std::move(image));
+
+                auto writeImage = [promise, fileName, destFormat, saveAlphaChannel, pixels]()
+                {
+                    DONUT_TRACE_ZONE("SaveTextureToFileAsync");
+
+                    promise->set_value(WriteImageFile(fileName.c_str(), destFormat, pixels->width, pixels->height,
+                        pixels->data.data(), pixels->rowPitch, saveAlphaChannel));
+                };
+
+#ifdef DONUT_WITH_TASKFLOW
+                if (executor)
+                {
+                    executor->silent_async(writeImage);
+                    return;
+                }
+#endif
+
+                writeImage();
+            });
+
+        if (textureState != nvrhi::ResourceStates::Unknown)
+        {
+            commandList->setTextureState(texture, nvrhi::TextureSubresourceSet(0, 1, 0, 1), textureState);
+            commandList->commitBarriers();
+        }
+
+        return future;
+    }
+
     bool TextureCache::IsTextureLoaded(const std::shared_ptr<LoadedTexture>& _texture)
     {
         TextureData* texture = static_cast<TextureData*>(_texture.get());
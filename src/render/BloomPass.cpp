@@ -25,6 +25,7 @@
 #include <donut/engine/ShaderFactory.h>
 #include <donut/engine/CommonRenderPasses.h>
 #include <donut/engine/View.h>
+#include <donut/engine/GpuProfiler.h>
 #include <utility>
 
 #if DONUT_WITH_STATIC_SHADERS
@@ -169,6 +170,7 @@ void BloomPass::Render(
     float effectiveSigma = clamp(sigmaInPixels * 0.25f, 1.f, 100.f);
 
     commandList->beginMarker("Bloom");
+    ScopedGpuZone gpuZone(commandList, "Bloom");
 
     nvrhi::DrawArguments fullscreenquadargs;
     fullscreenquadargs.instanceCount = 1;
@@ -23,12 +23,34 @@
 #include <donut/render/CascadedShadowMap.h>
 #include <donut/render/DepthPass.h>
 #include <donut/render/DrawStrategy.h>
+#include <donut/render/ParallelViewRecorder.h>
 #include <donut/render/PlanarShadowMap.h>
+#include <donut/engine/FramebufferFactory.h>
 
 using namespace donut::math;
 using namespace donut::engine;
 using namespace donut::render;
 
+namespace
+{
+    // Returns the rotation from world space into the light space used by the shadow views, where +Z is the light direction
+    affine3 GetWorldToLightRotation(const DirectionalLight& light)
+    {
+        daffine3 lightToWorld = light.GetNode()->GetLocalToWorldTransform();
+        lightToWorld.m_translation = dm::double3(0.0);
+        lightToWorld = dm::scaling(dm::double3(1.0, 1.0, -1.0)) * lightToWorld;
+        return affine3(inverse(lightToWorld));
+    }
+
+    // Sets the light-space depth range of a cascade to [zNear, zFar], with a small margin,
+    // keeping the X and Y position of the center.
+    void SetCascadeDepthRange(float zNear, float zFar, float3& centerView, float3& halfShadowBoxSize)
+    {
+        centerView.z = (zNear + zFar) * 0.5f;
+        halfShadowBoxSize.z = std::max((zFar - zNear) * 0.5f, 1e-3f) * 1.01f;
+    }
+}
+
 CascadedShadowMap::CascadedShadowMap(
     nvrhi::IDevice* device, 
     int resolution, 
@@ -57,12 +79,16 @@ CascadedShadowMap::CascadedShadowMap(
 	desc.isUAV = isUAV;
     m_ShadowMapTexture = device->createTexture(desc);
 
+    m_FramebufferFactory = std::make_shared<FramebufferFactory>(device);
+    m_FramebufferFactory->DepthTarget = m_ShadowMapTexture;
+
     nvrhi::Viewport cascadeViewport = nvrhi::Viewport(float(resolution), float(resolution));
 
     for (int cascade = 0; cascade < numCascades; cascade++)
     {
         std::shared_ptr<PlanarShadowMap> planarShadowMap = std::make_shared<PlanarShadowMap>(device, m_ShadowMapTexture, cascade, cascadeViewport);
         m_Cascades.push_back(planarShadowMap);
+        m_ReceiverVolumes.emplace_back();
 
         m_CompositeView.AddView(planarShadowMap->GetPlanarView());
     }
@@ -113,18 +139,22 @@ bool CascadedShadowMap::SetupForPlanarView(const DirectionalLight& light, frustu
     daffine3 viewToWorld = light.GetNode()->GetLocalToWorldTransform();
     viewToWorld = dm::scaling(dm::double3(1.0, 1.0, -1.0)) * viewToWorld;
     affine3 worldToView = affine3(inverse(viewToWorld));
+    affine3 worldToLight = GetWorldToLightRotation(light);
     bool viewModified = false;
 
+    box3 sceneViewBounds = m_SceneBounds.isempty() ? box3::empty() : m_SceneBounds.translate(preViewTranslation) * worldToView;
+
     for (int cascade = m_NumberOfCascades - 1; cascade >= 0; cascade--)
     {
         if (cascade == 0)
             near = 0.f;
 
+        std::array<float3, frustum::numCorners> cascadeCorners;
         std::array<float3, frustum::numCorners> cascadeViewCorners;
         for (uint32_t i = 0; i < frustum::numCorners; i++)
         {
-            float3 corner = lerp(corners[i & 3], corners[(i & 3) + 4], (i & 4) ? far : near);
-            cascadeViewCorners[i] = worldToView.transformPoint(corner);
+            cascadeCorners[i] = lerp(corners[i & 3], corners[(i & 3) + 4], (i & 4) ? far : near);
+            cascadeViewCorners[i] = worldToView.transformPoint(cascadeCorners[i]);
         }
 
         box3 cascadeViewBounds = box3(frustum::numCorners, cascadeViewCorners.data());
@@ -134,14 +164,29 @@ bool CascadedShadowMap::SetupForPlanarView(const DirectionalLight& light, frustu
         halfShadowBoxSize.xy() = std::max(halfShadowBoxSize.x, halfShadowBoxSize.y);
         float fadeRange = halfShadowBoxSize.x * 0.1f;
 
-        float zDown = std::max(halfShadowBoxSize.z, lightSpaceZDown);
-        float zUp = std::max(halfShadowBoxSize.z, lightSpaceZUp);
-        cascadeCenter += dm::float3(light.GetDirection()) * (zDown - zUp) * 0.5f;
-        halfShadowBoxSize.z = (zDown + zUp) * 0.5f;
+        if (!sceneViewBounds.isempty())
+        {
+            // Casters can be anywhere between the top of the scene, as seen from the light, and the farthest receiver
+            float zNear = sceneViewBounds.m_mins.z;
+            float zFar = std::max(std::min(cascadeViewBounds.m_maxs.z, sceneViewBounds.m_maxs.z), zNear);
+
+            float3 centerView = cascadeViewBounds.center();
+            SetCascadeDepthRange(zNear, zFar, centerView, halfShadowBoxSize);
+            cascadeCenter = dm::float3(viewToWorld.transformPoint(dm::double3(centerView)));
+        }
+        else
+        {
+            float zDown = std::max(halfShadowBoxSize.z, lightSpaceZDown);
+            float zUp = std::max(halfShadowBoxSize.z, lightSpaceZUp);
+            cascadeCenter += dm::float3(light.GetDirection()) * (zDown - zUp) * 0.5f;
+            halfShadowBoxSize.z = (zDown + zUp) * 0.5f;
+        }
 
         if (m_Cascades[cascade]->SetupDynamicDirectionalLightView(light, cascadeCenter, halfShadowBoxSize, preViewTranslation, fadeRange))
             viewModified = true;
 
+        SetupReceiverVolume(cascade, worldToLight, corners.data(), preViewTranslation);
+
         far = near;
         near = far / exponent;
     }
@@ -173,16 +218,22 @@ bool CascadedShadowMap::SetupForPlanarViewStable(const DirectionalLight& light,
     }
 
     std::array<float3, frustum::numCorners> corners;
+    std::array<float3, frustum::numCorners> worldCorners;
     for (uint32_t i = 0; i < frustum::numCorners; i++)
     {
         corners[i] = projectionFrustum.getCorner(i);
+        worldCorners[i] = inverseViewMatrix.transformPoint(corners[i]);
     }
 
     float far = 1.f;
     float near = far / exponent;
     
+    affine3 worldToLight = GetWorldToLightRotation(light);
+    affine3 lightToWorld = inverse(worldToLight);
     bool viewModified = false;
 
+    box3 sceneLightBounds = m_SceneBounds.isempty() ? box3::empty() : m_SceneBounds.translate(preViewTranslation) * worldToLight;
+
     for (int cascade = m_NumberOfCascades - 1; cascade >= 0; cascade--)
     {
         if (cascade == 0)
@@ -210,14 +261,27 @@ bool CascadedShadowMap::SetupForPlanarViewStable(const DirectionalLight& light,
         float3 halfShadowBoxSize = sphereRadius;
         float fadeRange = sphereRadius * 0.1f;
 
-        float zDown = std::max(sphereRadius, lightSpaceZDown);
-        float zUp = std::max(sphereRadius, lightSpaceZUp);
-        cascadeCenter += dm::float3(light.GetDirection()) * (zDown - zUp) * 0.5f;
-        halfShadowBoxSize.z = (zDown + zUp) * 0.5f;
+        if (!sceneLightBounds.isempty())
+        {
+            // Use the whole depth range of the scene instead of stopping at the receivers,
+            // so that the range doesn't change when the camera moves or turns
+            float3 centerLight = worldToLight.transformPoint(cascadeCenter);
+            SetCascadeDepthRange(sceneLightBounds.m_mins.z, sceneLightBounds.m_maxs.z, centerLight, halfShadowBoxSize);
+            cascadeCenter = lightToWorld.transformPoint(centerLight);
+        }
+        else
+        {
+            float zDown = std::max(sphereRadius, lightSpaceZDown);
+            float zUp = std::max(sphereRadius, lightSpaceZUp);
+            cascadeCenter += dm::float3(light.GetDirection()) * (zDown - zUp) * 0.5f;
+            halfShadowBoxSize.z = (zDown + zUp) * 0.5f;
+        }
 
         if (m_Cascades[cascade]->SetupDynamicDirectionalLightView(light, cascadeCenter, halfShadowBoxSize, preViewTranslation, fadeRange))
             viewModified = true;
 
+        SetupReceiverVolume(cascade, worldToLight, worldCorners.data(), preViewTranslation);
+
         far = near;
         near = far / exponent;
     }
@@ -244,18 +308,28 @@ bool CascadedShadowMap::SetupForCubemapView(const DirectionalLight& light, float
 
     float far = maxShadowDistance;
 
+    std::array<float3, box3::numCorners> receiverCorners;
+    for (uint32_t i = 0; i < box3::numCorners; i++)
+    {
+        receiverCorners[i] = center + corners[i] * maxShadowDistance;
+    }
+
     daffine3 viewToWorld = light.GetNode()->GetLocalToWorldTransform();
     viewToWorld = dm::scaling(dm::double3(1.0, 1.0, -1.0)) * viewToWorld;
     affine3 worldToView = affine3(inverse(viewToWorld));
+    affine3 worldToLight = GetWorldToLightRotation(light);
     bool viewModified = false;
 
+    box3 sceneViewBounds = m_SceneBounds.isempty() ? box3::empty() : m_SceneBounds * worldToView;
+
     for (int cascade = m_NumberOfCascades - 1; cascade >= 0; cascade--)
     {
+        std::array<float3, box3::numCorners> cascadeCorners;
         std::array<float3, box3::numCorners> cascadeViewCorners;
         for (uint32_t i = 0; i < box3::numCorners; i++)
         {
-            float3 corner = center + corners[i] * far;
-            cascadeViewCorners[i] = worldToView.transformPoint(corner);
+            cascadeCorners[i] = center + corners[i] * far;
+            cascadeViewCorners[i] = worldToView.transformPoint(cascadeCorners[i]);
         }
 
         box3 cascadeViewBounds = box3(box3::numCorners, cascadeViewCorners.data());
@@ -265,13 +339,27 @@ bool CascadedShadowMap::SetupForCubemapView(const DirectionalLight& light, float
         halfShadowBoxSize.xy() = std::max(halfShadowBoxSize.x, halfShadowBoxSize.y);
         float fadeRange = halfShadowBoxSize.x * 0.1f;
 
-        float zDown = std::max(halfShadowBoxSize.z, lightSpaceZDown);
-        float zUp = std::max(halfShadowBoxSize.z, lightSpaceZUp);
-        cascadeCenter += dm::float3(light.GetDirection()) * (zDown - zUp) * 0.5f;
-        halfShadowBoxSize.z = (zDown + zUp) * 0.5f;
+        if (!sceneViewBounds.isempty())
+        {
+            float zNear = sceneViewBounds.m_mins.z;
+            float zFar = std::max(std::min(cascadeViewBounds.m_maxs.z, sceneViewBounds.m_maxs.z), zNear);
+
+            float3 centerView = cascadeViewBounds.center();
+            SetCascadeDepthRange(zNear, zFar, centerView, halfShadowBoxSize);
+            cascadeCenter = float3(viewToWorld.transformPoint(double3(centerView)));
+        }
+        else
+        {
+            float zDown = std::max(halfShadowBoxSize.z, lightSpaceZDown);
+            float zUp = std::max(halfShadowBoxSize.z, lightSpaceZUp);
+            cascadeCenter += dm::float3(light.GetDirection()) * (zDown - zUp) * 0.5f;
+            halfShadowBoxSize.z = (zDown + zUp) * 0.5f;
+        }
 
         if (m_Cascades[cascade]->SetupDynamicDirectionalLightView(light, cascadeCenter, halfShadowBoxSize, fadeRange))
             viewModified = true;
+
+        SetupReceiverVolume(cascade, worldToLight, receiverCorners.data(), 0.f);
         
         far = far / exponent;
     }
@@ -284,6 +372,28 @@ bool CascadedShadowMap::SetupPerObjectShadow(const DirectionalLight& light, uint
     return m_PerObjectShadows[object]->SetupWholeSceneDirectionalLightView(light, objectBounds);
 }
 
+void CascadedShadowMap::SetupReceiverVolume(int cascade, const affine3& worldToLight, const float3* receiverCorners, float3 preViewTranslation)
+{
+    // Every receiver inside the box of the cascade samples it, so the volume is the part of the shadowed view region
+    // that is inside the box. Both are in the translated world space of the view, the receiver volumes use the world
+    // space of the scene.
+    frustum cascadeFrustum = m_Cascades[cascade]->GetPlanarView()->GetViewFrustum();
+
+    std::array<float3, frustum::numCorners> worldReceiverCorners;
+    std::array<float3, frustum::numCorners> worldBoxCorners;
+    for (uint32_t i = 0; i < frustum::numCorners; i++)
+    {
+        worldReceiverCorners[i] = receiverCorners[i] - preViewTranslation;
+        worldBoxCorners[i] = cascadeFrustum.getCorner(int(i)) - preViewTranslation;
+    }
+
+    float maxReceiverDepth = std::numeric_limits<float>::max();
+    if (!m_SceneBounds.isempty())
+        maxReceiverDepth = (m_SceneBounds * worldToLight).m_maxs.z;
+
+    m_ReceiverVolumes[cascade].SetupIntersection(worldToLight, worldReceiverCorners.data(), worldBoxCorners.data(), maxReceiverDepth);
+}
+
 void CascadedShadowMap::SetupProxyViews()
 {
     for (auto cascade : m_Cascades)
@@ -291,6 +401,11 @@ void CascadedShadowMap::SetupProxyViews()
         cascade->SetupProxyView();
     }
 
+    for (auto& volume : m_ReceiverVolumes)
+    {
+        volume.Reset();
+    }
+
     for (auto object : m_PerObjectShadows)
     {
         object->SetupProxyView();
@@ -313,6 +428,17 @@ void CascadedShadowMap::SetFalloffDistance(float distance)
     }
 }
 
+int CascadedShadowMap::FindCascade(const IView& view) const
+{
+    for (int cascade = 0; cascade < m_NumberOfCascades; cascade++)
+    {
+        if (m_Cascades[cascade]->GetPlanarView().get() == &view)
+            return cascade;
+    }
+
+    return -1;
+}
+
 dm::float4x4 CascadedShadowMap::GetWorldToUvzwMatrix() const
 {
     assert(false);
@@ -409,3 +535,11 @@ void CascadedShadowMap::Clear(nvrhi::ICommandList* commandList)
 
     commandList->clearDepthStencilTexture(m_ShadowMapTexture, nvrhi::AllSubresources, true, 1.f, depthFormatInfo.hasStencil, 0);
 }
+
+void CascadedShadowMap::RenderCascades(
+    ParallelViewRecorder& recorder,
+    const std::shared_ptr<SceneGraphNode>& rootNode,
+    IGeometryPass& pass)
+{
+    recorder.RenderCompositeView(&m_CompositeView, nullptr, *m_FramebufferFactory, rootNode, pass, "CascadedShadowMap");
+}
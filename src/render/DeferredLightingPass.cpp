@@ -29,6 +29,7 @@
 #include <donut/engine/SceneTypes.h>
 #include <donut/engine/CommonRenderPasses.h>
 #include <donut/engine/View.h>
+#include <donut/engine/GpuProfiler.h>
 #include <donut/core/log.h>
 #include <utility>
 
@@ -85,6 +86,10 @@ void DeferredLightingPass::Init(const std::shared_ptr<engine::ShaderFactory>& sh
     constantBufferDesc.isVolatile = true;
     constantBufferDesc.maxVersions = c_MaxRenderPassConstantBufferVersions;
     m_DeferredLightingCB = m_Device->createBuffer(constantBufferDesc);
+
+    EnsureLightBufferCapacity(m_Device, m_LightBuffer, 16, sizeof(LightConstants), "DeferredLights");
+    EnsureLightBufferCapacity(m_Device, m_LightClusterBuffer, 1024, sizeof(uint2), "DeferredLightClusters");
+    EnsureLightBufferCapacity(m_Device, m_LightIndexBuffer, 4096, sizeof(uint), "DeferredLightIndices");
     
     {
         nvrhi::BindingLayoutDesc layoutDesc;
@@ -95,6 +100,9 @@ void DeferredLightingPass::Init(const std::shared_ptr<engine::ShaderFactory>& sh
             nvrhi::BindingLayoutItem::Texture_SRV(1),
             nvrhi::BindingLayoutItem::Texture_SRV(2),
             nvrhi::BindingLayoutItem::Texture_SRV(3),
+            nvrhi::BindingLayoutItem::StructuredBuffer_SRV(4),
+            nvrhi::BindingLayoutItem::StructuredBuffer_SRV(5),
+            nvrhi::BindingLayoutItem::StructuredBuffer_SRV(6),
             nvrhi::BindingLayoutItem::Texture_SRV(8),
             nvrhi::BindingLayoutItem::Texture_SRV(9),
             nvrhi::BindingLayoutItem::Texture_SRV(10),
@@ -139,6 +147,7 @@ void DeferredLightingPass::Render(
     assert(inputs.output);
 
     commandList->beginMarker("DeferredLighting");
+    ScopedGpuZone gpuZone(commandList, "DeferredLighting");
 
     DeferredLightingConstants deferredConstants = {};
     deferredConstants.randomOffset = randomOffset;
@@ -154,6 +163,7 @@ void DeferredLightingPass::Render(
 
     nvrhi::ITexture* shadowMapTexture = nullptr;
 
+    std::vector<LightConstants> lights;
     int numShadows = 0;
 
     if (inputs.lights)
@@ -177,14 +187,7 @@ void DeferredLightingPass::Render(
                 }
             }
 
-            if (deferredConstants.numLights >= DEFERRED_MAX_LIGHTS)
-            {
-                log::warning("Maximum number of active lights (%d) exceeded in DeferredLightingPass",
-                    DEFERRED_MAX_LIGHTS);
-                break;
-            }
-
-            LightConstants& lightConstants = deferredConstants.lights[deferredConstants.numLights];
+            LightConstants& lightConstants = lights.emplace_back();
             light->FillLightConstants(lightConstants);
 
             if (light->shadowMap)
@@ -209,11 +212,18 @@ void DeferredLightingPass::Render(
                     }
                 }
             }
-
-            ++deferredConstants.numLights;
         }
     }
 
+    uint32_t numGlobalLights = m_LightClusters.PartitionLights(lights);
+    m_LightClusters.SetLights(lights.data(), uint32_t(lights.size()), numGlobalLights);
+    deferredConstants.numLights = uint32_t(lights.size());
+
+    if (EnsureLightBufferCapacity(m_Device, m_LightBuffer, lights.size(), sizeof(LightConstants), "DeferredLights"))
+        m_BindingSets.Clear();
+    if (!lights.empty())
+        commandList->writeBuffer(m_LightBuffer, lights.data(), lights.size() * sizeof(LightConstants));
+
     nvrhi::ITexture* lightProbeDiffuse = nullptr;
     nvrhi::ITexture* lightProbeSpecular = nullptr;
     nvrhi::ITexture* lightProbeEnvironmentBrdf = nullptr;
@@ -260,6 +270,14 @@ void DeferredLightingPass::Render(
         const IView* view = compositeView.GetChildView(ViewType::PLANAR, viewIndex);
         auto viewSubresources = view->GetSubresources();
 
+        m_LightClusters.Build(*view);
+        const std::vector<uint2>& clusterRanges = m_LightClusters.GetClusterRanges();
+        const std::vector<uint32_t>& lightIndices = m_LightClusters.GetLightIndices();
+        bool reallocated = EnsureLightBufferCapacity(m_Device, m_LightClusterBuffer, clusterRanges.size(), sizeof(uint2), "DeferredLightClusters");
+        reallocated |= EnsureLightBufferCapacity(m_Device, m_LightIndexBuffer, lightIndices.size(), sizeof(uint), "DeferredLightIndices");
+        if (reallocated)
+            m_BindingSets.Clear();
+
         nvrhi::BindingSetDesc bindingSetDesc;
         bindingSetDesc.bindings = {
             nvrhi::BindingSetItem::ConstantBuffer(0, m_DeferredLightingCB),
@@ -267,6 +285,9 @@ void DeferredLightingPass::Render(
             nvrhi::BindingSetItem::Texture_SRV(1, lightProbeDiffuse ? lightProbeDiffuse : m_CommonPasses->m_BlackCubeMapArray.Get()),
             nvrhi::BindingSetItem::Texture_SRV(2, lightProbeSpecular ? lightProbeSpecular : m_CommonPasses->m_BlackCubeMapArray.Get()),
             nvrhi::BindingSetItem::Texture_SRV(3, lightProbeEnvironmentBrdf ? lightProbeEnvironmentBrdf : m_CommonPasses->m_BlackTexture.Get()),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(4, m_LightBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(5, m_LightClusterBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(6, m_LightIndexBuffer),
             nvrhi::BindingSetItem::Texture_SRV(8, inputs.depth, nvrhi::Format::UNKNOWN, viewSubresources),
             nvrhi::BindingSetItem::Texture_SRV(9, inputs.gbufferDiffuse, nvrhi::Format::UNKNOWN, viewSubresources),
             nvrhi::BindingSetItem::Texture_SRV(10, inputs.gbufferSpecular, nvrhi::Format::UNKNOWN, viewSubresources),
@@ -286,7 +307,11 @@ void DeferredLightingPass::Render(
         nvrhi::BindingSetHandle bindingSet = m_BindingSets.GetOrCreateBindingSet(bindingSetDesc, m_BindingLayout);
     
         view->FillPlanarViewConstants(deferredConstants.view);
+        m_LightClusters.FillConstants(deferredConstants.lightClusters);
         commandList->writeBuffer(m_DeferredLightingCB, &deferredConstants, sizeof(deferredConstants));
+        commandList->writeBuffer(m_LightClusterBuffer, clusterRanges.data(), clusterRanges.size() * sizeof(uint2));
+        if (!lightIndices.empty())
+            commandList->writeBuffer(m_LightIndexBuffer, lightIndices.data(), lightIndices.size() * sizeof(uint));
 
         nvrhi::ComputeState state;
         state.pipeline = m_Pso;
@@ -27,6 +27,7 @@
 #include <donut/engine/CommonRenderPasses.h>
 #include <donut/engine/View.h>
 #include <donut/engine/MaterialBindingCache.h>
+#include <donut/engine/PipelineManager.h>
 #include <nvrhi/utils.h>
 #include <utility>
 
@@ -64,6 +65,13 @@ DepthPass::DepthPass(
     m_IsDX11 = m_Device->getGraphicsAPI() == nvrhi::GraphicsAPI::D3D11;
 }
 
+DepthPass::~DepthPass()
+{
+    // Pipelines that are still being created reference this pass
+    if (m_PipelineManager)
+        m_PipelineManager->ReleaseOwner(m_PipelineOwner);
+}
+
 void DepthPass::Init(ShaderFactory& shaderFactory, const CreateParameters& params)
 {
     m_UseInputAssembler = params.useInputAssembler;
@@ -78,6 +86,10 @@ void DepthPass::Init(ShaderFactory& shaderFactory, const CreateParameters& param
     else
         m_MaterialBindings = CreateMaterialBindingCache(*m_CommonPasses);
 
+    m_PipelineManager = params.pipelineManager;
+    if (m_PipelineManager)
+        m_PipelineOwner = m_PipelineManager->RegisterOwner();
+
     m_DepthCB = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(sizeof(DepthPassConstants),
         "DepthPassConstants", params.numConstantBufferVersions));
 
@@ -91,7 +103,7 @@ void DepthPass::Init(ShaderFactory& shaderFactory, const CreateParameters& param
 void DepthPass::ResetBindingCache()
 {
     m_MaterialBindings->Clear();
-    m_InputBindingSets.clear();
+    m_InputBindingSets.Clear();
 }
 
 nvrhi::ShaderHandle DepthPass::CreateVertexShader(ShaderFactory& shaderFactory, const CreateParameters& params)
@@ -212,34 +224,39 @@ nvrhi::BindingLayoutHandle DepthPass::CreateInputBindingLayout()
             ? nvrhi::BindingLayoutItem::RawBuffer_SRV(DEPTH_BINDING_INSTANCE_BUFFER)
             : nvrhi::BindingLayoutItem::StructuredBuffer_SRV(DEPTH_BINDING_INSTANCE_BUFFER))
         .addItem(nvrhi::BindingLayoutItem::RawBuffer_SRV(DEPTH_BINDING_VERTEX_BUFFER))
+        .addItem(nvrhi::BindingLayoutItem::RawBuffer_SRV(DEPTH_BINDING_INSTANCE_INDIRECTION_BUFFER))
         .addItem(nvrhi::BindingLayoutItem::PushConstants(DEPTH_BINDING_PUSH_CONSTANTS, sizeof(DepthPushConstants)));
         
     return m_Device->createBindingLayout(bindingLayoutDesc);
 }
 
-nvrhi::BindingSetHandle DepthPass::CreateInputBindingSet(const BufferGroup* bufferGroup)
+nvrhi::BindingSetHandle DepthPass::CreateInputBindingSet(const BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection)
 {
+    // The instance buffer is bound in place of the indirection buffer when it's not used, it is never read in that case
     auto bindingSetDesc = nvrhi::BindingSetDesc()
         .addItem(m_IsDX11
             ? nvrhi::BindingSetItem::RawBuffer_SRV(DEPTH_BINDING_INSTANCE_BUFFER, bufferGroup->instanceBuffer)
             : nvrhi::BindingSetItem::StructuredBuffer_SRV(DEPTH_BINDING_INSTANCE_BUFFER, bufferGroup->instanceBuffer))
         .addItem(nvrhi::BindingSetItem::RawBuffer_SRV(DEPTH_BINDING_VERTEX_BUFFER, bufferGroup->vertexBuffer))
+        .addItem(nvrhi::BindingSetItem::RawBuffer_SRV(DEPTH_BINDING_INSTANCE_INDIRECTION_BUFFER,
+            instanceIndirection ? instanceIndirection : bufferGroup->instanceBuffer.Get()))
         .addItem(nvrhi::BindingSetItem::PushConstants(DEPTH_BINDING_PUSH_CONSTANTS, sizeof(DepthPushConstants)));
 
     return m_Device->createBindingSet(bindingSetDesc, m_InputBindingLayout);
 }
 
-nvrhi::BindingSetHandle DepthPass::GetOrCreateInputBindingSet(const BufferGroup* bufferGroup)
+nvrhi::BindingSetHandle DepthPass::GetOrCreateInputBindingSet(const BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection)
 {
-    auto it = m_InputBindingSets.find(bufferGroup);
-    if (it == m_InputBindingSets.end())
+    std::lock_guard<std::mutex> lockGuard(m_Mutex);
+
+    nvrhi::BindingSetHandle bindingSet = m_InputBindingSets.Find(bufferGroup, instanceIndirection);
+    if (!bindingSet)
     {
-        auto bindingSet = CreateInputBindingSet(bufferGroup);
-        m_InputBindingSets[bufferGroup] = bindingSet;
-        return bindingSet;
+        bindingSet = CreateInputBindingSet(bufferGroup, instanceIndirection);
+        m_InputBindingSets.Insert(bufferGroup, instanceIndirection, bindingSet);
     }
 
-    return it->second;
+    return bindingSet;
 }
 
 void DepthPass::SetPushConstants(
@@ -258,6 +275,7 @@ void DepthPass::SetPushConstants(
     constants.startVertexLocation = args.startVertexLocation;
     constants.positionOffset = context.positionOffset;
     constants.texCoordOffset = context.texCoordOffset;
+    constants.instanceIndirection = context.instanceIndirectionBuffer ? 1 : 0;
 
     commandList->setPushConstants(&constants, sizeof(constants));
 
@@ -299,12 +317,12 @@ bool DepthPass::SetupMaterial(GeometryPassContext& abstractContext, const engine
         
     if (material->domain == MaterialDomain::AlphaTested && (hasBaseOrDiffuseTexture || hasOpacityTexture))
     {
-        nvrhi::IBindingSet* materialBindingSet = m_MaterialBindings->GetMaterialBindingSet(material);
+        context.materialBindingSet = m_MaterialBindings->GetMaterialBindingSet(material);
 
-        if (!materialBindingSet)
+        if (!context.materialBindingSet)
             return false;
         
-        state.bindings = { m_ViewBindingSet, materialBindingSet };
+        state.bindings = { m_ViewBindingSet, context.materialBindingSet };
         key.bits.alphaTested = true;
     }
     else if (material->domain == MaterialDomain::Opaque)
@@ -321,17 +339,42 @@ bool DepthPass::SetupMaterial(GeometryPassContext& abstractContext, const engine
         state.bindings.push_back(context.inputBindingSet);
 
     nvrhi::FramebufferInfo const& framebufferInfo = state.framebuffer->getFramebufferInfo();
-    nvrhi::GraphicsPipelineHandle& pipeline = m_Pipelines[key.value];
+    nvrhi::GraphicsPipelineHandle pipeline;
+    {
+        std::lock_guard<std::mutex> lockGuard(m_Mutex);
+        pipeline = m_Pipelines[key.value];
+    }
+
+    // The pass may be used with several framebuffer formats, the cached pipeline must match the current one
+    if (pipeline && pipeline->getFramebufferInfo() != framebufferInfo)
+        pipeline = nullptr;
 
-    if (!pipeline)
+    if (!pipeline && m_PipelineManager)
+    {
+        // The pipeline may be created in the background, skip the draws with this material until it's ready
+        nvrhi::GraphicsPipelineHandle readyPipeline = m_PipelineManager->GetGraphicsPipeline(m_PipelineOwner,
+            size_t(key.value), framebufferInfo,
+            [this, key, framebufferInfo]() { return CreateGraphicsPipeline(key, framebufferInfo); });
+
+        if (!readyPipeline)
+            return false;
+
+        std::lock_guard<std::mutex> lockGuard(m_Mutex);
+        m_Pipelines[key.value] = readyPipeline;
+        pipeline = readyPipeline;
+    }
+    else if (!pipeline)
     {
         std::lock_guard<std::mutex> lockGuard(m_Mutex);
 
-        if (!pipeline)
-            pipeline = CreateGraphicsPipeline(key, framebufferInfo);
+        nvrhi::GraphicsPipelineHandle& cachedPipeline = m_Pipelines[key.value];
+        if (!cachedPipeline || cachedPipeline->getFramebufferInfo() != framebufferInfo)
+            cachedPipeline = CreateGraphicsPipeline(key, framebufferInfo);
 
-        if (!pipeline)
+        if (!cachedPipeline)
             return false;
+
+        pipeline = cachedPipeline;
     }
 
     assert(pipeline->getFramebufferInfo() == framebufferInfo);
@@ -356,8 +399,15 @@ void DepthPass::SetupInputBuffers(GeometryPassContext& abstractContext, const en
     }
     else
     {
-        context.inputBindingSet = GetOrCreateInputBindingSet(buffers);
+        context.inputBindingSet = GetOrCreateInputBindingSet(buffers, context.instanceIndirectionBuffer);
         context.positionOffset = uint32_t(buffers->getVertexBufferRange(VertexAttribute::Position).byteOffset);
         context.texCoordOffset = uint32_t(buffers->getVertexBufferRange(VertexAttribute::TexCoord1).byteOffset);
     }
 }
+
+void DepthPass::SetInstanceIndirection(GeometryPassContext& abstractContext, nvrhi::IBuffer* buffer)
+{
+    auto& context = static_cast<Context&>(abstractContext);
+
+    context.instanceIndirectionBuffer = m_UseInputAssembler ? nullptr : buffer;
+}
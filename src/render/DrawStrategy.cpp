@@ -22,8 +22,11 @@
 
 #include <donut/render/DrawStrategy.h>
 #include <donut/render/GeometryPasses.h>
+#include <donut/render/CascadedShadowMap.h>
 #include <donut/engine/SceneGraph.h>
 #include <donut/engine/View.h>
+#include <donut/core/trace.h>
+#include <chrono>
 
 using namespace donut::math;
 using namespace donut::engine;
@@ -47,6 +50,95 @@ void PassthroughDrawStrategy::SetData(const DrawItem* data, size_t count)
     m_Count = count;
 }
 
+LodSelector::ViewInfo LodSelector::GetViewInfo(const IView& view)
+{
+    ViewInfo info;
+    info.view = &view;
+    info.origin = view.GetViewOrigin();
+    info.pixelsPerUnit = view.GetProjectionMatrix(false)[1][1] * 0.5f * float(view.GetViewExtent().height());
+    info.orthographic = view.IsOrthographicProjection();
+    return info;
+}
+
+uint32_t LodSelector::SelectLevel(const ViewInfo& view, const MeshInstance& instance)
+{
+    const MeshInfo& mesh = *instance.GetMesh();
+    const SceneGraphNode* node = instance.GetNode();
+    if (mesh.lodErrors.empty() || !node || view.pixelsPerUnit <= 0.f)
+        return 0;
+
+    // The object-space errors grow with the largest scale of the instance transform
+    const affine3& transform = node->GetLocalToWorldTransformFloat();
+    float scale = std::max(length(transform.m_linear.row0), std::max(length(transform.m_linear.row1), length(transform.m_linear.row2)));
+    float pixelsPerObjectUnit = view.pixelsPerUnit * scale;
+
+    bool insideBounds = false;
+    if (!view.orthographic)
+    {
+        const box3& bounds = node->GetGlobalBoundingBox();
+        float distance = length(bounds.center() - view.origin) - length(bounds.diagonal()) * 0.5f;
+        if (distance > 0.f)
+            pixelsPerObjectUnit /= distance;
+        else
+            insideBounds = true;
+    }
+
+    Key key = { view.view, &instance };
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // Another strategy has already selected the level for this view, e.g. for other materials of the mesh
+    auto current = m_CurrentLevels.find(key);
+    if (current != m_CurrentLevels.end())
+        return current->second;
+
+    auto previous = m_PreviousLevels.find(key);
+    uint32_t previousLevel = (previous != m_PreviousLevels.end()) ? previous->second : ~0u;
+
+    uint32_t level = 0;
+    if (!insideBounds)
+    {
+        for (uint32_t index = 0; index < uint32_t(mesh.lodErrors.size()); index++)
+        {
+            float threshold = MaxScreenError;
+            if (previousLevel != ~0u && index + 1 > previousLevel)
+                threshold *= 1.f - Hysteresis;
+
+            if (mesh.lodErrors[index] * pixelsPerObjectUnit > threshold)
+                break;
+
+            level = index + 1;
+        }
+    }
+
+    m_CurrentLevels[key] = level;
+    return level;
+}
+
+void LodSelector::CountTriangles(const MeshGeometry& geometry, uint32_t level)
+{
+    m_Triangles += geometry.GetLodNumIndices(level) / 3;
+    m_TrianglesWithoutLod += geometry.numIndices / 3;
+}
+
+void LodSelector::BeginFrame()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    std::swap(m_PreviousLevels, m_CurrentLevels);
+    m_CurrentLevels.clear();
+    m_Triangles = 0;
+    m_TrianglesWithoutLod = 0;
+}
+
+LodStats LodSelector::GetStats() const
+{
+    LodStats stats;
+    stats.triangles = m_Triangles;
+    stats.trianglesWithoutLod = m_TrianglesWithoutLod;
+    return stats;
+}
+
 static int CompareDrawItemsOpaque(const DrawItem* a, const DrawItem* b)
 {
     if (a->material != b->material)
@@ -63,6 +155,8 @@ static int CompareDrawItemsOpaque(const DrawItem* a, const DrawItem* b)
 
 void InstancedOpaqueDrawStrategy::FillChunk()
 {
+    DONUT_TRACE_ZONE("InstancedOpaqueDrawStrategy::FillChunk");
+
     m_InstanceChunk.resize(m_ChunkSize);
 
     DrawItem* writePtr = m_InstanceChunk.data();
@@ -85,6 +179,7 @@ void InstancedOpaqueDrawStrategy::FillChunk()
                 if (meshInstance)
                 {
                     const engine::MeshInfo* mesh = meshInstance->GetMesh().get();
+                    uint32_t lod = m_LodSelector ? m_LodSelector->SelectLevel(m_LodView, *meshInstance) : 0;
 
                     size_t requiredChunkSize = itemCount + mesh->geometries.size();
                     if (m_InstanceChunk.size() < requiredChunkSize)
@@ -114,6 +209,10 @@ void InstancedOpaqueDrawStrategy::FillChunk()
                         item.buffers = item.mesh->buffers.get();
                         item.cullMode = (item.material->doubleSided) ? nvrhi::RasterCullMode::None : nvrhi::RasterCullMode::Back;
                         item.distanceToCamera = 0; // don't care
+                        item.lod = lod;
+
+                        if (m_LodSelector)
+                            m_LodSelector->CountTriangles(*item.geometry, lod);
                         
                         ++writePtr;
                         ++itemCount;
@@ -143,8 +242,12 @@ void InstancedOpaqueDrawStrategy::FillChunk()
 
 void donut::render::InstancedOpaqueDrawStrategy::PrepareForView(const std::shared_ptr<engine::SceneGraphNode>& rootNode, const engine::IView& view)
 {
+    DONUT_TRACE_ZONE("InstancedOpaqueDrawStrategy::PrepareForView");
+
     m_Walker = SceneGraphWalker(rootNode.get());
     m_ViewFrustum = view.GetViewFrustum();
+    if (m_LodSelector)
+        m_LodView = LodSelector::GetViewInfo(view);
     m_InstanceChunk.clear();
     m_ReadPtr = 0;
 }
@@ -171,6 +274,8 @@ static int CompareDrawItemsTransparent(const DrawItem* a, const DrawItem* b)
 
 void TransparentDrawStrategy::PrepareForView(const std::shared_ptr<engine::SceneGraphNode>& rootNode, const IView& view)
 {
+    DONUT_TRACE_ZONE("TransparentDrawStrategy::PrepareForView");
+
     m_ReadPtr = 0;
 
     m_InstancesToDraw.clear();
@@ -178,6 +283,9 @@ void TransparentDrawStrategy::PrepareForView(const std::shared_ptr<engine::Scene
 
     float3 viewOrigin = view.GetViewOrigin();
     auto viewFrustum = view.GetViewFrustum();
+    LodSelector::ViewInfo lodView;
+    if (m_LodSelector)
+        lodView = LodSelector::GetViewInfo(view);
 
     SceneGraphWalker walker(rootNode.get());
     while (walker)
@@ -197,6 +305,8 @@ void TransparentDrawStrategy::PrepareForView(const std::shared_ptr<engine::Scene
                 if (meshInstance)
                 {
                     const engine::MeshInfo* mesh = meshInstance->GetMesh().get();
+                    uint32_t lod = m_LodSelector ? m_LodSelector->SelectLevel(lodView, *meshInstance) : 0;
+
                     for (const auto& geometry : mesh->geometries)
                     {
                         const auto& material = geometry->material;
@@ -222,6 +332,11 @@ void TransparentDrawStrategy::PrepareForView(const std::shared_ptr<engine::Scene
                         item.material = geometry->material.get();
                         item.buffers = mesh->buffers.get();
                         item.distanceToCamera = length(geometryGlobalBoundingBox.center() - viewOrigin);
+                        item.lod = lod;
+
+                        if (m_LodSelector)
+                            m_LodSelector->CountTriangles(*item.geometry, lod);
+
                         if (material->doubleSided)
                         {
                             if (DrawDoubleSidedMaterialsSeparately)
@@ -277,3 +392,454 @@ const DrawItem* TransparentDrawStrategy::GetNextItem()
 
     return m_InstancePtrsToDraw[m_ReadPtr++];
 }
+
+
+OcclusionCullingDrawStrategy::OcclusionCullingDrawStrategy(uint32_t bufferWidth, uint32_t bufferHeight)
+    : m_OcclusionBuffer(bufferWidth, bufferHeight)
+{
+}
+
+void OcclusionCullingDrawStrategy::SetOccluderMesh(const engine::MeshInfo* mesh, bool isOccluder)
+{
+    if (isOccluder)
+        m_OccluderMeshes.insert(mesh);
+    else
+        m_OccluderMeshes.erase(mesh);
+}
+
+namespace
+{
+// CPU positions and indices of a mesh, relative to its vertexOffset and indexOffset
+struct OccluderGeometry
+{
+    const float3* positions = nullptr;
+    size_t numVertices = 0;
+    const uint32_t* indices = nullptr;
+    size_t numIndices = 0;
+};
+
+OccluderGeometry GetOccluderGeometry(const MeshInfo& mesh)
+{
+    OccluderGeometry result;
+
+    if (!mesh.occluderIndices.empty() && !mesh.occluderPositions.empty())
+    {
+        result.positions = mesh.occluderPositions.data();
+        result.numVertices = mesh.occluderPositions.size();
+        result.indices = mesh.occluderIndices.data();
+        result.numIndices = mesh.occluderIndices.size();
+    }
+    else if (mesh.buffers
+        && mesh.buffers->indexData.size() > mesh.indexOffset
+        && mesh.buffers->positionData.size() > mesh.vertexOffset)
+    {
+        // Meshes that were not uploaded through Scene::CreateMeshBuffers still have their data in the buffer group
+        result.positions = mesh.buffers->positionData.data() + mesh.vertexOffset;
+        result.numVertices = mesh.buffers->positionData.size() - mesh.vertexOffset;
+        result.indices = mesh.buffers->indexData.data() + mesh.indexOffset;
+        result.numIndices = mesh.buffers->indexData.size() - mesh.indexOffset;
+    }
+
+    return result;
+}
+}
+
+bool OcclusionCullingDrawStrategy::CanBeOccluder(const engine::MeshInfo& mesh)
+{
+    // Skinned meshes have no CPU copy of their animated positions
+    return mesh.type == MeshType::Triangles
+        && !mesh.skinPrototype
+        && GetOccluderGeometry(mesh).numIndices != 0;
+}
+
+void OcclusionCullingDrawStrategy::LimitOccluders()
+{
+    if (m_Occluders.size() <= MaxOccluders)
+        return;
+
+    std::partial_sort(m_Occluders.begin(), m_Occluders.begin() + MaxOccluders, m_Occluders.end(),
+        [](const Occluder& a, const Occluder& b) { return a.screenSize > b.screenSize; });
+
+    m_Occluders.resize(MaxOccluders);
+}
+
+void OcclusionCullingDrawStrategy::RasterizeOccluders(const dm::frustum& viewFrustum)
+{
+    DONUT_TRACE_ZONE("OcclusionCullingDrawStrategy::RasterizeOccluders");
+
+    // m_Occluders already contains the visible instances of the marked meshes, add the ones from the previous view
+    for (const auto& weakInstance : m_PreviousOccluders)
+    {
+        std::shared_ptr<MeshInstance> instance = weakInstance.lock();
+        if (!instance || !instance->GetNode())
+            continue;
+
+        if (!viewFrustum.intersectsWith(instance->GetNode()->GetGlobalBoundingBox()))
+            continue;
+
+        m_Occluders.push_back({ instance.get(), 0.f });
+    }
+
+    std::sort(m_Occluders.begin(), m_Occluders.end(),
+        [](const Occluder& a, const Occluder& b) { return a.instance < b.instance; });
+    m_Occluders.erase(std::unique(m_Occluders.begin(), m_Occluders.end(),
+        [](const Occluder& a, const Occluder& b) { return a.instance == b.instance; }), m_Occluders.end());
+
+    for (Occluder& occluder : m_Occluders)
+        occluder.screenSize = m_OcclusionBuffer.GetScreenSize(occluder.instance->GetNode()->GetGlobalBoundingBox());
+
+    LimitOccluders();
+
+    for (const Occluder& occluder : m_Occluders)
+    {
+        const MeshInfo& mesh = *occluder.instance->GetMesh();
+        const OccluderGeometry occluderGeometry = GetOccluderGeometry(mesh);
+        const affine3& objectToWorld = occluder.instance->GetNode()->GetLocalToWorldTransformFloat();
+
+        for (const auto& geometry : mesh.geometries)
+        {
+            // Alpha-tested and blended geometries have holes that the rasterizer doesn't know about
+            if (geometry->material->domain != MaterialDomain::Opaque || geometry->type != MeshGeometryPrimitiveType::Triangles)
+                continue;
+
+            size_t firstIndex = geometry->indexOffsetInMesh;
+            size_t firstVertex = geometry->vertexOffsetInMesh;
+            if (firstIndex + geometry->numIndices > occluderGeometry.numIndices ||
+                firstVertex + geometry->numVertices > occluderGeometry.numVertices)
+                continue;
+
+            m_Stats.occluderTriangles += m_OcclusionBuffer.RasterizeTriangles(occluderGeometry.positions + firstVertex,
+                occluderGeometry.indices + firstIndex, geometry->numIndices, objectToWorld);
+        }
+
+        ++m_Stats.occluders;
+    }
+
+    m_OcclusionBuffer.End();
+}
+
+void OcclusionCullingDrawStrategy::CullOccludedItems()
+{
+    DONUT_TRACE_ZONE("OcclusionCullingDrawStrategy::CullOccludedItems");
+
+    if (m_Stats.occluderTriangles == 0)
+        return;
+
+    // The items of each instance are adjacent, test the instance bounds once and then the geometry bounds
+    const MeshInstance* lastInstance = nullptr;
+    bool instanceVisible = false;
+    size_t itemCount = 0;
+
+    for (const DrawItem& item : m_InstancesToDraw)
+    {
+        const SceneGraphNode* node = item.instance->GetNode();
+
+        if (item.instance != lastInstance)
+        {
+            lastInstance = item.instance;
+            instanceVisible = m_OcclusionBuffer.IsBoxVisible(node->GetGlobalBoundingBox());
+        }
+
+        bool itemVisible = instanceVisible;
+        if (itemVisible && item.mesh->geometries.size() > 1 && !item.mesh->skinPrototype)
+        {
+            dm::box3 geometryGlobalBoundingBox = item.geometry->objectSpaceBounds * node->GetLocalToWorldTransformFloat();
+            itemVisible = m_OcclusionBuffer.IsBoxVisible(geometryGlobalBoundingBox);
+        }
+
+        if (itemVisible)
+            m_InstancesToDraw[itemCount++] = item;
+        else
+            ++m_Stats.culled;
+    }
+
+    m_InstancesToDraw.resize(itemCount);
+}
+
+void OcclusionCullingDrawStrategy::SelectNextOccluders()
+{
+    m_Occluders.clear();
+
+    const MeshInstance* lastInstance = nullptr;
+    for (const DrawItem& item : m_InstancesToDraw)
+    {
+        if (item.instance == lastInstance)
+            continue;
+
+        lastInstance = item.instance;
+
+        if (!CanBeOccluder(*item.mesh))
+            continue;
+
+        float screenSize = m_OcclusionBuffer.GetScreenSize(item.instance->GetNode()->GetGlobalBoundingBox());
+        if (screenSize >= OccluderMinScreenSize)
+            m_Occluders.push_back({ item.instance, screenSize });
+    }
+
+    LimitOccluders();
+
+    m_PreviousOccluders.clear();
+    for (const Occluder& occluder : m_Occluders)
+        m_PreviousOccluders.push_back(std::static_pointer_cast<MeshInstance>(occluder.instance->GetNode()->GetLeaf()));
+
+    m_Occluders.clear();
+}
+
+void OcclusionCullingDrawStrategy::PrepareForView(const std::shared_ptr<engine::SceneGraphNode>& rootNode, const engine::IView& view)
+{
+    DONUT_TRACE_ZONE("OcclusionCullingDrawStrategy::PrepareForView");
+
+    m_ReadPtr = 0;
+    m_InstancesToDraw.clear();
+    m_InstancePtrsToDraw.clear();
+    m_Occluders.clear();
+    m_Stats = OcclusionCullingStats();
+
+    auto viewFrustum = view.GetViewFrustum();
+    LodSelector::ViewInfo lodView;
+    if (m_LodSelector)
+        lodView = LodSelector::GetViewInfo(view);
+
+    SceneGraphWalker walker(rootNode.get());
+    while (walker)
+    {
+        auto relevantContentFlags = SceneContentFlags::OpaqueMeshes | SceneContentFlags::AlphaTestedMeshes;
+        bool subgraphContentRelevant = (walker->GetSubgraphContentFlags() & relevantContentFlags) != 0;
+        bool nodeContentsRelevant = (walker->GetLeafContentFlags() & relevantContentFlags) != 0;
+
+        bool nodeVisible = false;
+        if (subgraphContentRelevant)
+        {
+            nodeVisible = viewFrustum.intersectsWith(walker->GetGlobalBoundingBox());
+
+            if (nodeVisible && nodeContentsRelevant)
+            {
+                auto meshInstance = dynamic_cast<MeshInstance*>(walker->GetLeaf().get());
+                if (meshInstance)
+                {
+                    const engine::MeshInfo* mesh = meshInstance->GetMesh().get();
+
+                    if (EnableOcclusionCulling && m_OccluderMeshes.find(mesh) != m_OccluderMeshes.end() && CanBeOccluder(*mesh))
+                        m_Occluders.push_back({ meshInstance, 0.f });
+
+                    uint32_t lod = m_LodSelector ? m_LodSelector->SelectLevel(lodView, *meshInstance) : 0;
+
+                    for (const auto& geometry : mesh->geometries)
+                    {
+                        auto domain = geometry->material->domain;
+                        if (domain != MaterialDomain::Opaque && domain != MaterialDomain::AlphaTested)
+                            continue;
+
+                        if (mesh->geometries.size() > 1 && !mesh->skinPrototype)
+                        {
+                            dm::box3 geometryGlobalBoundingBox = geometry->objectSpaceBounds * walker->GetLocalToWorldTransformFloat();
+                            if (!viewFrustum.intersectsWith(geometryGlobalBoundingBox))
+                                continue;
+                        }
+
+                        DrawItem item{};
+                        item.instance = meshInstance;
+                        item.mesh = mesh;
+                        item.geometry = geometry.get();
+                        item.material = geometry->material.get();
+                        item.buffers = mesh->buffers.get();
+                        item.cullMode = (item.material->doubleSided) ? nvrhi::RasterCullMode::None : nvrhi::RasterCullMode::Back;
+                        item.distanceToCamera = 0; // don't care
+                        item.lod = lod;
+                        m_InstancesToDraw.push_back(item);
+                    }
+                }
+            }
+        }
+
+        walker.Next(nodeVisible);
+    }
+
+    m_Stats.candidates = uint32_t(m_InstancesToDraw.size());
+
+    if (EnableOcclusionCulling)
+    {
+        using clock = std::chrono::steady_clock;
+        auto startTime = clock::now();
+
+        m_OcclusionBuffer.Begin(view.GetViewProjectionMatrix(), view.IsReverseDepth());
+        RasterizeOccluders(viewFrustum);
+
+        auto rasterizedTime = clock::now();
+
+        CullOccludedItems();
+        SelectNextOccluders();
+
+        auto endTime = clock::now();
+        m_Stats.rasterizeMs = std::chrono::duration<float, std::milli>(rasterizedTime - startTime).count();
+        m_Stats.testMs = std::chrono::duration<float, std::milli>(endTime - rasterizedTime).count();
+    }
+    else
+    {
+        m_PreviousOccluders.clear();
+    }
+
+    if (m_LodSelector)
+    {
+        for (const DrawItem& item : m_InstancesToDraw)
+            m_LodSelector->CountTriangles(*item.geometry, item.lod);
+    }
+
+    if (m_InstancesToDraw.empty())
+        return;
+
+    m_InstancePtrsToDraw.resize(m_InstancesToDraw.size());
+
+    for (size_t i = 0; i < m_InstancesToDraw.size(); i++)
+    {
+        m_InstancePtrsToDraw[i] = &m_InstancesToDraw[i];
+    }
+
+    if (m_InstancePtrsToDraw.size() > 1)
+    {
+        std::sort(m_InstancePtrsToDraw.data(), m_InstancePtrsToDraw.data() + m_InstancePtrsToDraw.size(), CompareDrawItemsOpaque);
+    }
+}
+
+const DrawItem* OcclusionCullingDrawStrategy::GetNextItem()
+{
+    if (m_ReadPtr >= m_InstancePtrsToDraw.size())
+        return nullptr;
+
+    return m_InstancePtrsToDraw[m_ReadPtr++];
+}
+
+ShadowCasterDrawStrategy::ShadowCasterDrawStrategy(std::shared_ptr<CascadedShadowMap> shadowMap)
+    : m_ShadowMap(std::move(shadowMap))
+{
+}
+
+void ShadowCasterDrawStrategy::PrepareForView(const std::shared_ptr<engine::SceneGraphNode>& rootNode, const engine::IView& view)
+{
+    DONUT_TRACE_ZONE("ShadowCasterDrawStrategy::PrepareForView");
+
+    m_ReadPtr = 0;
+    m_InstancesToDraw.clear();
+    m_InstancePtrsToDraw.clear();
+
+    auto viewFrustum = view.GetViewFrustum();
+    LodSelector::ViewInfo lodView;
+    if (m_LodSelector)
+        lodView = LodSelector::GetViewInfo(view);
+
+    int cascade = m_ShadowMap ? m_ShadowMap->FindCascade(view) : -1;
+    const ShadowReceiverVolume* receivers = (cascade >= 0) ? &m_ShadowMap->GetReceiverVolume(uint32_t(cascade)) : nullptr;
+
+    ShadowCasterCullingStats stats;
+
+    SceneGraphWalker walker(rootNode.get());
+    while (walker)
+    {
+        auto relevantContentFlags = SceneContentFlags::OpaqueMeshes | SceneContentFlags::AlphaTestedMeshes;
+        bool subgraphContentRelevant = (walker->GetSubgraphContentFlags() & relevantContentFlags) != 0;
+        bool nodeContentsRelevant = (walker->GetLeafContentFlags() & relevantContentFlags) != 0;
+
+        bool nodeVisible = false;
+        if (subgraphContentRelevant)
+        {
+            nodeVisible = viewFrustum.intersectsWith(walker->GetGlobalBoundingBox());
+
+            if (nodeVisible && nodeContentsRelevant)
+            {
+                auto meshInstance = dynamic_cast<MeshInstance*>(walker->GetLeaf().get());
+                if (meshInstance)
+                {
+                    const engine::MeshInfo* mesh = meshInstance->GetMesh().get();
+
+                    // The extruded bounds of the instance are tested once, but the statistics count draw items
+                    bool castsOnReceivers = !receivers || receivers->CanShadowReceivers(walker->GetGlobalBoundingBox());
+                    uint32_t lod = (m_LodSelector && castsOnReceivers) ? m_LodSelector->SelectLevel(lodView, *meshInstance) : 0;
+
+                    for (const auto& geometry : mesh->geometries)
+                    {
+                        auto domain = geometry->material->domain;
+                        if (domain != MaterialDomain::Opaque && domain != MaterialDomain::AlphaTested)
+                            continue;
+
+                        if (mesh->geometries.size() > 1 && !mesh->skinPrototype)
+                        {
+                            dm::box3 geometryGlobalBoundingBox = geometry->objectSpaceBounds * walker->GetLocalToWorldTransformFloat();
+                            if (!viewFrustum.intersectsWith(geometryGlobalBoundingBox))
+                                continue;
+                        }
+
+                        ++stats.candidates;
+
+                        if (!castsOnReceivers)
+                        {
+                            ++stats.culled;
+                            if (EnableReceiverCulling)
+                                continue;
+                        }
+
+                        DrawItem item{};
+                        item.instance = meshInstance;
+                        item.mesh = mesh;
+                        item.geometry = geometry.get();
+                        item.material = geometry->material.get();
+                        item.buffers = mesh->buffers.get();
+                        item.cullMode = (item.material->doubleSided) ? nvrhi::RasterCullMode::None : nvrhi::RasterCullMode::Back;
+                        item.distanceToCamera = 0; // don't care
+                        item.lod = lod;
+                        m_InstancesToDraw.push_back(item);
+
+                        if (m_LodSelector)
+                            m_LodSelector->CountTriangles(*item.geometry, lod);
+                    }
+                }
+            }
+        }
+
+        walker.Next(nodeVisible);
+    }
+
+    if (cascade >= 0)
+    {
+        if (m_Stats.size() <= size_t(cascade))
+            m_Stats.resize(cascade + 1);
+
+        m_Stats[cascade].candidates += stats.candidates;
+        m_Stats[cascade].culled += stats.culled;
+    }
+
+    if (m_InstancesToDraw.empty())
+        return;
+
+    m_InstancePtrsToDraw.resize(m_InstancesToDraw.size());
+
+    for (size_t i = 0; i < m_InstancesToDraw.size(); i++)
+    {
+        m_InstancePtrsToDraw[i] = &m_InstancesToDraw[i];
+    }
+
+    if (m_InstancePtrsToDraw.size() > 1)
+    {
+        std::sort(m_InstancePtrsToDraw.data(), m_InstancePtrsToDraw.data() + m_InstancePtrsToDraw.size(), CompareDrawItemsOpaque);
+    }
+}
+
+const DrawItem* ShadowCasterDrawStrategy::GetNextItem()
+{
+    if (m_ReadPtr >= m_InstancePtrsToDraw.size())
+        return nullptr;
+
+    return m_InstancePtrsToDraw[m_ReadPtr++];
+}
+
+void ShadowCasterDrawStrategy::ResetStats()
+{
+    m_Stats.clear();
+}
+
+ShadowCasterCullingStats ShadowCasterDrawStrategy::GetStats(uint32_t cascade) const
+{
+    if (cascade < m_Stats.size())
+        return m_Stats[cascade];
+
+    return ShadowCasterCullingStats();
+}
@@ -25,6 +25,7 @@
 #include <donut/engine/ShaderFactory.h>
 #include <donut/engine/CommonRenderPasses.h>
 #include <donut/engine/View.h>
+#include <donut/engine/GpuProfiler.h>
 #include <donut/core/math/math.h>
 
 #if DONUT_WITH_STATIC_SHADERS
@@ -117,6 +118,7 @@ void EnvironmentMapPass::Render(
     const ICompositeView& compositeView)
 {
     commandList->beginMarker("Environment Map");
+    ScopedGpuZone gpuZone(commandList, "Environment Map");
 
     for (uint viewIndex = 0; viewIndex < compositeView.GetNumChildViews(ViewType::PLANAR); viewIndex++)
     {
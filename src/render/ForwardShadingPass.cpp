@@ -28,6 +28,7 @@
 #include <donut/engine/SceneTypes.h>
 #include <donut/engine/CommonRenderPasses.h>
 #include <donut/engine/MaterialBindingCache.h>
+#include <donut/engine/PipelineManager.h>
 #include <donut/core/log.h>
 #include <nvrhi/utils.h>
 #include <utility>
@@ -69,9 +70,17 @@ ForwardShadingPass::ForwardShadingPass(
     m_IsDX11 = m_Device->getGraphicsAPI() == nvrhi::GraphicsAPI::D3D11;
 }
 
+ForwardShadingPass::~ForwardShadingPass()
+{
+    // Pipelines that are still being created reference this pass
+    if (m_PipelineManager)
+        m_PipelineManager->ReleaseOwner(m_PipelineOwner);
+}
+
 void ForwardShadingPass::Init(ShaderFactory& shaderFactory, const CreateParameters& params)
 {
     m_UseInputAssembler = params.useInputAssembler;
+    m_LightClusterSettings = params.lightClusters;
 
     m_SupportedViewTypes = ViewType::PLANAR;
     if (params.singlePassCubemap)
@@ -88,6 +97,10 @@ void ForwardShadingPass::Init(ShaderFactory& shaderFactory, const CreateParamete
     else
         m_MaterialBindings = CreateMaterialBindingCache(*m_CommonPasses);
 
+    m_PipelineManager = params.pipelineManager;
+    if (m_PipelineManager)
+        m_PipelineOwner = m_PipelineManager->RegisterOwner();
+
     auto samplerDesc = nvrhi::SamplerDesc()
         .setAllAddressModes(nvrhi::SamplerAddressMode::Border)
         .setBorderColor(1.0f);
@@ -96,6 +109,10 @@ void ForwardShadingPass::Init(ShaderFactory& shaderFactory, const CreateParamete
     m_ForwardViewCB = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(sizeof(ForwardShadingViewConstants), "ForwardShadingViewConstants", params.numConstantBufferVersions));
     m_ForwardLightCB = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(sizeof(ForwardShadingLightConstants), "ForwardShadingLightConstants", params.numConstantBufferVersions));
 
+    EnsureLightBufferCapacity(m_Device, m_LightBuffer, 16, sizeof(LightConstants), "ForwardLights");
+    EnsureLightBufferCapacity(m_Device, m_LightClusterBuffer, 1024, sizeof(uint2), "ForwardLightClusters");
+    EnsureLightBufferCapacity(m_Device, m_LightIndexBuffer, 4096, sizeof(uint), "ForwardLightIndices");
+
     m_ViewBindingLayout = CreateViewBindingLayout();
     m_ViewBindingSet = CreateViewBindingSet();
     m_ShadingBindingLayout = CreateShadingBindingLayout();
@@ -106,7 +123,7 @@ void ForwardShadingPass::ResetBindingCache()
 {
     m_MaterialBindings->Clear();
     m_ShadingBindingSets.clear();
-    m_InputBindingSets.clear();
+    m_InputBindingSets.Clear();
 }
 
 nvrhi::ShaderHandle ForwardShadingPass::CreateVertexShader(ShaderFactory& shaderFactory, const CreateParameters& params)
@@ -201,6 +218,9 @@ nvrhi::BindingLayoutHandle ForwardShadingPass::CreateShadingBindingLayout()
         .addItem(nvrhi::BindingLayoutItem::Texture_SRV(FORWARD_BINDING_DIFFUSE_LIGHT_PROBE_TEXTURE))
         .addItem(nvrhi::BindingLayoutItem::Texture_SRV(FORWARD_BINDING_SPECULAR_LIGHT_PROBE_TEXTURE))
         .addItem(nvrhi::BindingLayoutItem::Texture_SRV(FORWARD_BINDING_ENVIRONMENT_BRDF_TEXTURE))
+        .addItem(nvrhi::BindingLayoutItem::StructuredBuffer_SRV(FORWARD_BINDING_LIGHT_BUFFER))
+        .addItem(nvrhi::BindingLayoutItem::StructuredBuffer_SRV(FORWARD_BINDING_LIGHT_CLUSTER_BUFFER))
+        .addItem(nvrhi::BindingLayoutItem::StructuredBuffer_SRV(FORWARD_BINDING_LIGHT_INDEX_BUFFER))
         .addItem(nvrhi::BindingLayoutItem::Sampler(FORWARD_BINDING_MATERIAL_SAMPLER))
         .addItem(nvrhi::BindingLayoutItem::Sampler(FORWARD_BINDING_SHADOW_MAP_SAMPLER))
         .addItem(nvrhi::BindingLayoutItem::Sampler(FORWARD_BINDING_LIGHT_PROBE_SAMPLER))
@@ -223,6 +243,9 @@ nvrhi::BindingSetHandle ForwardShadingPass::CreateShadingBindingSet(nvrhi::IText
             specular ? specular : m_CommonPasses->m_BlackCubeMapArray.Get()))
         .addItem(nvrhi::BindingSetItem::Texture_SRV(FORWARD_BINDING_ENVIRONMENT_BRDF_TEXTURE,
             environmentBrdf ? environmentBrdf : m_CommonPasses->m_BlackTexture.Get()))
+        .addItem(nvrhi::BindingSetItem::StructuredBuffer_SRV(FORWARD_BINDING_LIGHT_BUFFER, m_LightBuffer))
+        .addItem(nvrhi::BindingSetItem::StructuredBuffer_SRV(FORWARD_BINDING_LIGHT_CLUSTER_BUFFER, m_LightClusterBuffer))
+        .addItem(nvrhi::BindingSetItem::StructuredBuffer_SRV(FORWARD_BINDING_LIGHT_INDEX_BUFFER, m_LightIndexBuffer))
         .addItem(nvrhi::BindingSetItem::Sampler(FORWARD_BINDING_MATERIAL_SAMPLER,
             m_CommonPasses->m_AnisotropicWrapSampler))
         .addItem(nvrhi::BindingSetItem::Sampler(FORWARD_BINDING_SHADOW_MAP_SAMPLER,
@@ -235,6 +258,19 @@ nvrhi::BindingSetHandle ForwardShadingPass::CreateShadingBindingSet(nvrhi::IText
     return m_Device->createBindingSet(bindingSetDesc, m_ShadingBindingLayout);
 }
 
+nvrhi::BindingSetHandle ForwardShadingPass::GetOrCreateShadingBindingSet(const Context& context)
+{
+    nvrhi::BindingSetHandle& shadingBindings = m_ShadingBindingSets[std::make_pair(context.shadowMapTexture, context.lightProbeDiffuse)];
+
+    if (!shadingBindings)
+    {
+        shadingBindings = CreateShadingBindingSet(context.shadowMapTexture, context.lightProbeDiffuse,
+            context.lightProbeSpecular, context.lightProbeEnvironmentBrdf);
+    }
+
+    return shadingBindings;
+}
+
 
 nvrhi::GraphicsPipelineHandle ForwardShadingPass::CreateGraphicsPipeline(ForwardShadingPassPipelineKey const& key,
     nvrhi::FramebufferInfo const& framebufferInfo)
@@ -334,16 +370,76 @@ void ForwardShadingPass::SetupView(
     const IView* viewPrev)
 {
     auto& context = static_cast<Context&>(abstractContext);
-    
+
+    const LightClusterGrid* lightClusters = context.viewLightClusters;
+    const bool uploadLightClusters = !lightClusters || context.uploadLightClusters;
+    context.viewLightClusters = nullptr;
+    context.uploadLightClusters = true;
+
+    if (!lightClusters)
+    {
+        context.lightClusters.Build(*view);
+        lightClusters = &context.lightClusters;
+    }
+
     ForwardShadingViewConstants viewConstants = {};
     view->FillPlanarViewConstants(viewConstants.view);
+    lightClusters->FillConstants(viewConstants.lightClusters);
     commandList->writeBuffer(m_ForwardViewCB, &viewConstants, sizeof(viewConstants));
 
+    const std::vector<uint2>& clusterRanges = lightClusters->GetClusterRanges();
+    const std::vector<uint32_t>& lightIndices = lightClusters->GetLightIndices();
+
+    {
+        std::lock_guard<std::mutex> lockGuard(m_Mutex);
+
+        bool reallocated = EnsureLightBufferCapacity(m_Device, m_LightClusterBuffer, clusterRanges.size(), sizeof(uint2), "ForwardLightClusters");
+        reallocated |= EnsureLightBufferCapacity(m_Device, m_LightIndexBuffer, lightIndices.size(), sizeof(uint), "ForwardLightIndices");
+        if (reallocated)
+            m_ShadingBindingSets.clear();
+
+        context.shadingBindingSet = GetOrCreateShadingBindingSet(context);
+    }
+
+    // The other slices of the view read the clusters uploaded by the first one
+    if (uploadLightClusters)
+    {
+        commandList->writeBuffer(m_LightClusterBuffer, clusterRanges.data(), clusterRanges.size() * sizeof(uint2));
+        if (!lightIndices.empty())
+            commandList->writeBuffer(m_LightIndexBuffer, lightIndices.data(), lightIndices.size() * sizeof(uint));
+    }
+
     context.keyTemplate.frontCounterClockwise = view->IsMirrored();
     context.keyTemplate.reverseDepth = view->IsReverseDepth();
     context.keyTemplate.shadingRateState = view->GetVariableRateShadingState();
 }
 
+void ForwardShadingPass::PrepareViewSlices(GeometryPassContext* const* sliceContexts, size_t numSlices, const IView* view)
+{
+    if (numSlices == 0)
+        return;
+
+    auto& firstContext = static_cast<Context&>(*sliceContexts[0]);
+    firstContext.lightClusters.Build(*view);
+
+    // Grow the buffers before any slice creates its binding set, they must not be replaced while the slices are recorded
+    {
+        std::lock_guard<std::mutex> lockGuard(m_Mutex);
+
+        bool reallocated = EnsureLightBufferCapacity(m_Device, m_LightClusterBuffer, firstContext.lightClusters.GetClusterRanges().size(), sizeof(uint2), "ForwardLightClusters");
+        reallocated |= EnsureLightBufferCapacity(m_Device, m_LightIndexBuffer, firstContext.lightClusters.GetLightIndices().size(), sizeof(uint), "ForwardLightIndices");
+        if (reallocated)
+            m_ShadingBindingSets.clear();
+    }
+
+    for (size_t slice = 0; slice < numSlices; slice++)
+    {
+        auto& context = static_cast<Context&>(*sliceContexts[slice]);
+        context.viewLightClusters = &firstContext.lightClusters;
+        context.uploadLightClusters = (slice == 0);
+    }
+}
+
 void ForwardShadingPass::PrepareLights(
     Context& context,
     nvrhi::ICommandList* commandList,
@@ -389,33 +485,25 @@ void ForwardShadingPass::PrepareLights(
         }
     }
 
-    {
-        std::lock_guard<std::mutex> lockGuard(m_Mutex);
-
-        nvrhi::BindingSetHandle& shadingBindings = m_ShadingBindingSets[std::make_pair(shadowMapTexture, lightProbeDiffuse)];
-
-        if (!shadingBindings)
-        {
-            shadingBindings = CreateShadingBindingSet(shadowMapTexture, lightProbeDiffuse, lightProbeSpecular, lightProbeEnvironmentBrdf);
-        }
-
-        context.shadingBindingSet = shadingBindings;
-    }
-
+    context.shadowMapTexture = shadowMapTexture;
+    context.lightProbeDiffuse = lightProbeDiffuse;
+    context.lightProbeSpecular = lightProbeSpecular;
+    context.lightProbeEnvironmentBrdf = lightProbeEnvironmentBrdf;
 
     ForwardShadingLightConstants constants = {};
 
     constants.shadowMapTextureSize = float2(shadowMapTextureSize);
     constants.shadowMapTextureSizeInv = 1.f / constants.shadowMapTextureSize;
 
+    std::vector<LightConstants> lightConstants;
+    lightConstants.reserve(lights.size());
+
     int numShadows = 0;
 
-    for (int nLight = 0; nLight < std::min(static_cast<int>(lights.size()), FORWARD_MAX_LIGHTS); nLight++)
+    for (const auto& light : lights)
     {
-        const auto& light = lights[nLight];
-
-        LightConstants& lightConstants = constants.lights[constants.numLights];
-        light->FillLightConstants(lightConstants);
+        LightConstants& constantsForLight = lightConstants.emplace_back();
+        light->FillLightConstants(constantsForLight);
 
         if (light->shadowMap)
         {
@@ -424,7 +512,7 @@ void ForwardShadingPass::PrepareLights(
                 if (numShadows < FORWARD_MAX_SHADOWS)
                 {
                     light->shadowMap->GetCascade(cascade)->FillShadowConstants(constants.shadows[numShadows]);
-                    lightConstants.shadowCascades[cascade] = numShadows;
+                    constantsForLight.shadowCascades[cascade] = numShadows;
                     ++numShadows;
                 }
             }
@@ -434,15 +522,28 @@ void ForwardShadingPass::PrepareLights(
                 if (numShadows < FORWARD_MAX_SHADOWS)
                 {
                     light->shadowMap->GetPerObjectShadow(perObjectShadow)->FillShadowConstants(constants.shadows[numShadows]);
-                    lightConstants.perObjectShadows[perObjectShadow] = numShadows;
+                    constantsForLight.perObjectShadows[perObjectShadow] = numShadows;
                     ++numShadows;
                 }
             }
         }
+    }
+
+    context.lightClusters.SetSettings(m_LightClusterSettings);
+    uint32_t numGlobalLights = context.lightClusters.PartitionLights(lightConstants);
+    context.lightClusters.SetLights(lightConstants.data(), uint32_t(lightConstants.size()), numGlobalLights);
+    constants.numLights = uint32_t(lightConstants.size());
+
+    {
+        std::lock_guard<std::mutex> lockGuard(m_Mutex);
 
-        ++constants.numLights;
+        if (EnsureLightBufferCapacity(m_Device, m_LightBuffer, lightConstants.size(), sizeof(LightConstants), "ForwardLights"))
+            m_ShadingBindingSets.clear();
     }
 
+    if (!lightConstants.empty())
+        commandList->writeBuffer(m_LightBuffer, lightConstants.data(), lightConstants.size() * sizeof(LightConstants));
+
     constants.ambientColorTop = float4(ambientColorTop, 0.f);
     constants.ambientColorBottom = float4(ambientColorBottom, 0.f);
 
@@ -473,9 +574,9 @@ bool ForwardShadingPass::SetupMaterial(GeometryPassContext& abstractContext, con
 {
     auto& context = static_cast<Context&>(abstractContext);
 
-    nvrhi::IBindingSet* materialBindingSet = m_MaterialBindings->GetMaterialBindingSet(material);
+    context.materialBindingSet = m_MaterialBindings->GetMaterialBindingSet(material);
 
-    if (!materialBindingSet)
+    if (!context.materialBindingSet)
         return false;
 
     if (material->domain >= MaterialDomain::Count || cullMode > nvrhi::RasterCullMode::None)
@@ -488,23 +589,53 @@ bool ForwardShadingPass::SetupMaterial(GeometryPassContext& abstractContext, con
     key.cullMode = cullMode;
     key.domain = material->domain;
 
-    nvrhi::GraphicsPipelineHandle& pipeline = m_Pipelines[key];
+    // Passes may be used by several threads recording command lists in parallel, see ParallelViewRecorder
+    nvrhi::GraphicsPipelineHandle pipeline;
+    {
+        std::lock_guard<std::mutex> lockGuard(m_Mutex);
+        auto it = m_Pipelines.find(key);
+        if (it != m_Pipelines.end())
+            pipeline = it->second;
+    }
+
+    // The pass may be used with several framebuffer formats, the cached pipeline must match the current one
+    const nvrhi::FramebufferInfo& framebufferInfo = state.framebuffer->getFramebufferInfo();
+    if (pipeline && pipeline->getFramebufferInfo() != framebufferInfo)
+        pipeline = nullptr;
 
-    if (!pipeline)
+    if (!pipeline && m_PipelineManager)
+    {
+        // The pipeline may be created in the background, skip the draws with this material until it's ready
+        nvrhi::GraphicsPipelineHandle readyPipeline = m_PipelineManager->GetGraphicsPipeline(m_PipelineOwner,
+            std::hash<ForwardShadingPassPipelineKey>()(key), framebufferInfo,
+            [this, key, framebufferInfo]() { return CreateGraphicsPipeline(key, framebufferInfo); });
+
+        if (!readyPipeline)
+            return false;
+
+        std::lock_guard<std::mutex> lockGuard(m_Mutex);
+        m_Pipelines[key] = readyPipeline;
+        pipeline = readyPipeline;
+    }
+    else if (!pipeline)
     {
         std::lock_guard<std::mutex> lockGuard(m_Mutex);
 
-        if (!pipeline)
-            pipeline = CreateGraphicsPipeline(key, state.framebuffer->getFramebufferInfo());
+        // Another thread may have created the pipeline since the lookup above
+        nvrhi::GraphicsPipelineHandle& cachedPipeline = m_Pipelines[key];
+        if (!cachedPipeline || cachedPipeline->getFramebufferInfo() != framebufferInfo)
+            cachedPipeline = CreateGraphicsPipeline(key, framebufferInfo);
 
-        if (!pipeline)
+        if (!cachedPipeline)
             return false;
+
+        pipeline = cachedPipeline;
     }
 
-    assert(pipeline->getFramebufferInfo() == state.framebuffer->getFramebufferInfo());
+    assert(pipeline->getFramebufferInfo() == framebufferInfo);
 
     state.pipeline = pipeline;
-    state.bindings = { materialBindingSet, m_ViewBindingSet, context.shadingBindingSet };
+    state.bindings = { context.materialBindingSet, m_ViewBindingSet, context.shadingBindingSet };
     
     if (!m_UseInputAssembler)
         state.bindings.push_back(context.inputBindingSet);
@@ -531,7 +662,7 @@ void ForwardShadingPass::SetupInputBuffers(GeometryPassContext& abstractContext,
     }
     else
     {
-        context.inputBindingSet = GetOrCreateInputBindingSet(buffers);
+        context.inputBindingSet = GetOrCreateInputBindingSet(buffers, context.instanceIndirectionBuffer);
         context.positionOffset = uint32_t(buffers->getVertexBufferRange(VertexAttribute::Position).byteOffset);
         context.texCoordOffset = uint32_t(buffers->getVertexBufferRange(VertexAttribute::TexCoord1).byteOffset);
         context.normalOffset = uint32_t(buffers->getVertexBufferRange(VertexAttribute::Normal).byteOffset);
@@ -539,6 +670,13 @@ void ForwardShadingPass::SetupInputBuffers(GeometryPassContext& abstractContext,
     }
 }
 
+void ForwardShadingPass::SetInstanceIndirection(GeometryPassContext& abstractContext, nvrhi::IBuffer* buffer)
+{
+    auto& context = static_cast<Context&>(abstractContext);
+
+    context.instanceIndirectionBuffer = m_UseInputAssembler ? nullptr : buffer;
+}
+
 nvrhi::BindingLayoutHandle ForwardShadingPass::CreateInputBindingLayout()
 {
     if (m_UseInputAssembler)
@@ -551,34 +689,39 @@ nvrhi::BindingLayoutHandle ForwardShadingPass::CreateInputBindingLayout()
             ? nvrhi::BindingLayoutItem::RawBuffer_SRV(FORWARD_BINDING_INSTANCE_BUFFER)
             : nvrhi::BindingLayoutItem::StructuredBuffer_SRV(FORWARD_BINDING_INSTANCE_BUFFER))
         .addItem(nvrhi::BindingLayoutItem::RawBuffer_SRV(FORWARD_BINDING_VERTEX_BUFFER))
+        .addItem(nvrhi::BindingLayoutItem::RawBuffer_SRV(FORWARD_BINDING_INSTANCE_INDIRECTION_BUFFER))
         .addItem(nvrhi::BindingLayoutItem::PushConstants(FORWARD_BINDING_PUSH_CONSTANTS, sizeof(ForwardPushConstants)));
         
     return m_Device->createBindingLayout(bindingLayoutDesc);
 }
 
-nvrhi::BindingSetHandle ForwardShadingPass::CreateInputBindingSet(const BufferGroup* bufferGroup)
+nvrhi::BindingSetHandle ForwardShadingPass::CreateInputBindingSet(const BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection)
 {
+    // The instance buffer is bound in place of the indirection buffer when it's not used, it is never read in that case
     auto bindingSetDesc = nvrhi::BindingSetDesc()
         .addItem(m_IsDX11
             ? nvrhi::BindingSetItem::RawBuffer_SRV(FORWARD_BINDING_INSTANCE_BUFFER, bufferGroup->instanceBuffer)
             : nvrhi::BindingSetItem::StructuredBuffer_SRV(FORWARD_BINDING_INSTANCE_BUFFER, bufferGroup->instanceBuffer))
         .addItem(nvrhi::BindingSetItem::RawBuffer_SRV(FORWARD_BINDING_VERTEX_BUFFER, bufferGroup->vertexBuffer))
+        .addItem(nvrhi::BindingSetItem::RawBuffer_SRV(FORWARD_BINDING_INSTANCE_INDIRECTION_BUFFER,
+            instanceIndirection ? instanceIndirection : bufferGroup->instanceBuffer.Get()))
         .addItem(nvrhi::BindingSetItem::PushConstants(FORWARD_BINDING_PUSH_CONSTANTS, sizeof(ForwardPushConstants)));
 
     return m_Device->createBindingSet(bindingSetDesc, m_InputBindingLayout);
 }
 
-nvrhi::BindingSetHandle ForwardShadingPass::GetOrCreateInputBindingSet(const BufferGroup* bufferGroup)
+nvrhi::BindingSetHandle ForwardShadingPass::GetOrCreateInputBindingSet(const BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection)
 {
-    auto it = m_InputBindingSets.find(bufferGroup);
-    if (it == m_InputBindingSets.end())
+    std::lock_guard<std::mutex> lockGuard(m_Mutex);
+
+    nvrhi::BindingSetHandle bindingSet = m_InputBindingSets.Find(bufferGroup, instanceIndirection);
+    if (!bindingSet)
     {
-        auto bindingSet = CreateInputBindingSet(bufferGroup);
-        m_InputBindingSets[bufferGroup] = bindingSet;
-        return bindingSet;
+        bindingSet = CreateInputBindingSet(bufferGroup, instanceIndirection);
+        m_InputBindingSets.Insert(bufferGroup, instanceIndirection, bindingSet);
     }
 
-    return it->second;
+    return bindingSet;
 }
 
 void ForwardShadingPass::SetPushConstants(
@@ -599,6 +742,7 @@ void ForwardShadingPass::SetPushConstants(
     constants.texCoordOffset = context.texCoordOffset;
     constants.normalOffset = context.normalOffset;
     constants.tangentOffset = context.tangentOffset;
+    constants.instanceIndirection = context.instanceIndirectionBuffer ? 1 : 0;
 
     commandList->setPushConstants(&constants, sizeof(constants));
 
@@ -28,6 +28,7 @@
 #include <donut/engine/SceneTypes.h>
 #include <donut/engine/CommonRenderPasses.h>
 #include <donut/engine/MaterialBindingCache.h>
+#include <donut/engine/PipelineManager.h>
 #include <donut/core/log.h>
 #include <nvrhi/utils.h>
 #include <utility>
@@ -69,6 +70,13 @@ GBufferFillPass::GBufferFillPass(nvrhi::IDevice* device, std::shared_ptr<CommonR
     m_IsDX11 = m_Device->getGraphicsAPI() == nvrhi::GraphicsAPI::D3D11;
 }
 
+GBufferFillPass::~GBufferFillPass()
+{
+    // Pipelines that are still being created reference this pass
+    if (m_PipelineManager)
+        m_PipelineManager->ReleaseOwner(m_PipelineOwner);
+}
+
 void GBufferFillPass::Init(ShaderFactory& shaderFactory, const CreateParameters& params)
 {
     m_EnableMotionVectors = params.enableMotionVectors;
@@ -89,6 +97,10 @@ void GBufferFillPass::Init(ShaderFactory& shaderFactory, const CreateParameters&
     else
         m_MaterialBindings = CreateMaterialBindingCache(*m_CommonPasses);
 
+    m_PipelineManager = params.pipelineManager;
+    if (m_PipelineManager)
+        m_PipelineOwner = m_PipelineManager->RegisterOwner();
+
     m_GBufferCB = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(sizeof(GBufferFillConstants),
         "GBufferFillConstants", params.numConstantBufferVersions));
 
@@ -103,7 +115,7 @@ void GBufferFillPass::Init(ShaderFactory& shaderFactory, const CreateParameters&
 void GBufferFillPass::ResetBindingCache()
 {
     m_MaterialBindings->Clear();
-    m_InputBindingSets.clear();
+    m_InputBindingSets.Clear();
 }
 
 nvrhi::ShaderHandle GBufferFillPass::CreateVertexShader(ShaderFactory& shaderFactory, const CreateParameters& params)
@@ -323,29 +335,54 @@ bool GBufferFillPass::SetupMaterial(GeometryPassContext& abstractContext, const
         return false;
     }
 
-    nvrhi::IBindingSet* materialBindingSet = m_MaterialBindings->GetMaterialBindingSet(material);
+    context.materialBindingSet = m_MaterialBindings->GetMaterialBindingSet(material);
 
-    if (!materialBindingSet)
+    if (!context.materialBindingSet)
         return false;
 
     nvrhi::FramebufferInfo const& framebufferInfo = state.framebuffer->getFramebufferInfo();
-    nvrhi::GraphicsPipelineHandle& pipeline = m_Pipelines[key.value];
+    nvrhi::GraphicsPipelineHandle pipeline;
+    {
+        std::lock_guard<std::mutex> lockGuard(m_Mutex);
+        pipeline = m_Pipelines[key.value];
+    }
+
+    // The pass may be used with several framebuffer formats, the cached pipeline must match the current one
+    if (pipeline && pipeline->getFramebufferInfo() != framebufferInfo)
+        pipeline = nullptr;
 
-    if (!pipeline)
+    if (!pipeline && m_PipelineManager)
+    {
+        // The pipeline may be created in the background, skip the draws with this material until it's ready
+        nvrhi::GraphicsPipelineHandle readyPipeline = m_PipelineManager->GetGraphicsPipeline(m_PipelineOwner,
+            size_t(key.value), framebufferInfo,
+            [this, key, framebufferInfo]() { return CreateGraphicsPipeline(key, framebufferInfo); });
+
+        if (!readyPipeline)
+            return false;
+
+        std::lock_guard<std::mutex> lockGuard(m_Mutex);
+        m_Pipelines[key.value] = readyPipeline;
+        pipeline = readyPipeline;
+    }
+    else if (!pipeline)
     {
         std::lock_guard<std::mutex> lockGuard(m_Mutex);
 
-        if (!pipeline)
-            pipeline = CreateGraphicsPipeline(key, framebufferInfo);
+        nvrhi::GraphicsPipelineHandle& cachedPipeline = m_Pipelines[key.value];
+        if (!cachedPipeline || cachedPipeline->getFramebufferInfo() != framebufferInfo)
+            cachedPipeline = CreateGraphicsPipeline(key, framebufferInfo);
 
-        if (!pipeline)
+        if (!cachedPipeline)
             return false;
+
+        pipeline = cachedPipeline;
     }
 
     assert(pipeline->getFramebufferInfo() == framebufferInfo);
 
     state.pipeline = pipeline;
-    state.bindings = { materialBindingSet, m_ViewBindings };
+    state.bindings = { context.materialBindingSet, m_ViewBindings };
     
     if (!m_UseInputAssembler)
         state.bindings.push_back(context.inputBindingSet);
@@ -372,7 +409,7 @@ void GBufferFillPass::SetupInputBuffers(GeometryPassContext& abstractContext, co
     }
     else
     {
-        context.inputBindingSet = GetOrCreateInputBindingSet(buffers);
+        context.inputBindingSet = GetOrCreateInputBindingSet(buffers, context.instanceIndirectionBuffer);
         context.positionOffset = uint32_t(buffers->getVertexBufferRange(VertexAttribute::Position).byteOffset);
         context.prevPositionOffset = uint32_t(buffers->getVertexBufferRange(VertexAttribute::PrevPosition).byteOffset);
         context.texCoordOffset = uint32_t(buffers->getVertexBufferRange(VertexAttribute::TexCoord1).byteOffset);
@@ -381,6 +418,13 @@ void GBufferFillPass::SetupInputBuffers(GeometryPassContext& abstractContext, co
     }
 }
 
+void GBufferFillPass::SetInstanceIndirection(GeometryPassContext& abstractContext, nvrhi::IBuffer* buffer)
+{
+    auto& context = static_cast<Context&>(abstractContext);
+
+    context.instanceIndirectionBuffer = m_UseInputAssembler ? nullptr : buffer;
+}
+
 nvrhi::BindingLayoutHandle GBufferFillPass::CreateInputBindingLayout()
 {
     if (m_UseInputAssembler)
@@ -393,34 +437,39 @@ nvrhi::BindingLayoutHandle GBufferFillPass::CreateInputBindingLayout()
             ? nvrhi::BindingLayoutItem::RawBuffer_SRV(GBUFFER_BINDING_INSTANCE_BUFFER)
             : nvrhi::BindingLayoutItem::StructuredBuffer_SRV(GBUFFER_BINDING_INSTANCE_BUFFER))
         .addItem(nvrhi::BindingLayoutItem::RawBuffer_SRV(GBUFFER_BINDING_VERTEX_BUFFER))
+        .addItem(nvrhi::BindingLayoutItem::RawBuffer_SRV(GBUFFER_BINDING_INSTANCE_INDIRECTION_BUFFER))
         .addItem(nvrhi::BindingLayoutItem::PushConstants(GBUFFER_BINDING_PUSH_CONSTANTS, sizeof(GBufferPushConstants)));
         
     return m_Device->createBindingLayout(bindingLayoutDesc);
 }
 
-nvrhi::BindingSetHandle GBufferFillPass::CreateInputBindingSet(const BufferGroup* bufferGroup)
+nvrhi::BindingSetHandle GBufferFillPass::CreateInputBindingSet(const BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection)
 {
+    // The instance buffer is bound in place of the indirection buffer when it's not used, it is never read in that case
     auto bindingSetDesc = nvrhi::BindingSetDesc()
         .addItem(m_IsDX11
             ? nvrhi::BindingSetItem::RawBuffer_SRV(GBUFFER_BINDING_INSTANCE_BUFFER, bufferGroup->instanceBuffer)
             : nvrhi::BindingSetItem::StructuredBuffer_SRV(GBUFFER_BINDING_INSTANCE_BUFFER, bufferGroup->instanceBuffer))
         .addItem(nvrhi::BindingSetItem::RawBuffer_SRV(GBUFFER_BINDING_VERTEX_BUFFER, bufferGroup->vertexBuffer))
+        .addItem(nvrhi::BindingSetItem::RawBuffer_SRV(GBUFFER_BINDING_INSTANCE_INDIRECTION_BUFFER,
+            instanceIndirection ? instanceIndirection : bufferGroup->instanceBuffer.Get()))
         .addItem(nvrhi::BindingSetItem::PushConstants(GBUFFER_BINDING_PUSH_CONSTANTS, sizeof(GBufferPushConstants)));
 
     return m_Device->createBindingSet(bindingSetDesc, m_InputBindingLayout);
 }
 
-nvrhi::BindingSetHandle GBufferFillPass::GetOrCreateInputBindingSet(const BufferGroup* bufferGroup)
+nvrhi::BindingSetHandle GBufferFillPass::GetOrCreateInputBindingSet(const BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection)
 {
-    auto it = m_InputBindingSets.find(bufferGroup);
-    if (it == m_InputBindingSets.end())
+    std::lock_guard<std::mutex> lockGuard(m_Mutex);
+
+    nvrhi::BindingSetHandle bindingSet = m_InputBindingSets.Find(bufferGroup, instanceIndirection);
+    if (!bindingSet)
     {
-        auto bindingSet = CreateInputBindingSet(bufferGroup);
-        m_InputBindingSets[bufferGroup] = bindingSet;
-        return bindingSet;
+        bindingSet = CreateInputBindingSet(bufferGroup, instanceIndirection);
+        m_InputBindingSets.Insert(bufferGroup, instanceIndirection, bindingSet);
     }
 
-    return it->second;
+    return bindingSet;
 }
 
 void GBufferFillPass::SetPushConstants(
@@ -442,6 +491,7 @@ void GBufferFillPass::SetPushConstants(
     constants.texCoordOffset = context.texCoordOffset;
     constants.normalOffset = context.normalOffset;
     constants.tangentOffset = context.tangentOffset;
+    constants.instanceIndirection = context.instanceIndirectionBuffer ? 1 : 0;
 
     commandList->setPushConstants(&constants, sizeof(constants));
 
@@ -23,12 +23,318 @@
 #include <donut/render/GeometryPasses.h>
 #include <donut/engine/SceneGraph.h>
 #include <donut/engine/FramebufferFactory.h>
+#include <donut/engine/GpuProfiler.h>
 #include <donut/render/DrawStrategy.h>
+#include <donut/core/trace.h>
+#include <algorithm>
+#include <unordered_map>
 
 using namespace donut::math;
 using namespace donut::engine;
 using namespace donut::render;
 
+InstanceIndirectionBuffer::InstanceIndirectionBuffer(nvrhi::IDevice* device, uint32_t initialCapacity)
+    : m_Device(device)
+    , m_Capacity(std::max(initialCapacity, 1u))
+{
+}
+
+void InstanceIndirectionBuffer::BeginFrame()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_WriteOffset = 0;
+    m_Stats = InstancingStats();
+}
+
+uint32_t InstanceIndirectionBuffer::Write(nvrhi::ICommandList* commandList, const uint32_t* indices, size_t count, nvrhi::BufferHandle& buffer)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (!m_Buffer || m_WriteOffset + count > m_Capacity)
+    {
+        // Start over in a new buffer that fits everything written in this frame so far, so that the next frame
+        // does not need to grow it again. The draws that use the old buffer keep it alive through their binding sets.
+        while (m_Capacity < m_WriteOffset + count)
+            m_Capacity *= 2;
+
+        nvrhi::BufferDesc bufferDesc;
+        bufferDesc.byteSize = sizeof(uint32_t) * m_Capacity;
+        bufferDesc.debugName = "InstanceIndirection";
+        bufferDesc.canHaveRawViews = true;
+        bufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+        bufferDesc.keepInitialState = true;
+        m_Buffer = m_Device->createBuffer(bufferDesc);
+        m_WriteOffset = 0;
+    }
+
+    uint32_t offset = m_WriteOffset;
+    commandList->writeBuffer(m_Buffer, indices, sizeof(uint32_t) * count, sizeof(uint32_t) * offset);
+    m_WriteOffset += uint32_t(count);
+
+    buffer = m_Buffer;
+    return offset;
+}
+
+void InstanceIndirectionBuffer::AddStats(const InstancingStats& stats)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_Stats.drawItems += stats.drawItems;
+    m_Stats.drawCallsWithoutGroups += stats.drawCallsWithoutGroups;
+    m_Stats.drawCalls += stats.drawCalls;
+}
+
+InstancingStats InstanceIndirectionBuffer::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    return m_Stats;
+}
+
+void InputBindingSetCache::Clear()
+{
+    m_BindingSets.clear();
+    m_IndirectionBuffers.clear();
+}
+
+size_t InputBindingSetCache::KeyHash::operator()(const Key& key) const
+{
+    size_t hash = 0;
+    nvrhi::hash_combine(hash, key.bufferGroup);
+    nvrhi::hash_combine(hash, key.instanceIndirection);
+    return hash;
+}
+
+nvrhi::BindingSetHandle InputBindingSetCache::Find(const BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection)
+{
+    auto it = m_BindingSets.find(Key{ bufferGroup, instanceIndirection });
+    if (it == m_BindingSets.end())
+        return nullptr;
+
+    if (instanceIndirection && m_IndirectionBuffers.front() != instanceIndirection)
+    {
+        auto bufferIt = std::find(m_IndirectionBuffers.begin(), m_IndirectionBuffers.end(), instanceIndirection);
+        std::rotate(m_IndirectionBuffers.begin(), bufferIt, bufferIt + 1);
+    }
+
+    return it->second;
+}
+
+void InputBindingSetCache::Insert(const BufferGroup* bufferGroup, nvrhi::IBuffer* instanceIndirection, nvrhi::BindingSetHandle bindingSet)
+{
+    if (instanceIndirection)
+    {
+        auto bufferIt = std::find(m_IndirectionBuffers.begin(), m_IndirectionBuffers.end(), instanceIndirection);
+        if (bufferIt != m_IndirectionBuffers.end())
+        {
+            std::rotate(m_IndirectionBuffers.begin(), bufferIt, bufferIt + 1);
+        }
+        else
+        {
+            m_IndirectionBuffers.insert(m_IndirectionBuffers.begin(), instanceIndirection);
+
+            if (m_IndirectionBuffers.size() > MaxIndirectionBuffers)
+            {
+                // Release the sets of the least recently used buffer, which is usually one that has been replaced
+                nvrhi::IBuffer* evicted = m_IndirectionBuffers.back();
+                m_IndirectionBuffers.pop_back();
+
+                for (auto it = m_BindingSets.begin(); it != m_BindingSets.end(); )
+                {
+                    if (it->first.instanceIndirection == evicted)
+                        it = m_BindingSets.erase(it);
+                    else
+                        ++it;
+                }
+            }
+        }
+    }
+
+    m_BindingSets[Key{ bufferGroup, instanceIndirection }] = std::move(bindingSet);
+}
+
+namespace
+{
+    struct InstanceGroupKey
+    {
+        const MeshGeometry* geometry;
+        const Material* material;
+        nvrhi::RasterCullMode cullMode;
+        uint32_t lod;
+
+        bool operator==(const InstanceGroupKey& other) const
+        {
+            return geometry == other.geometry && material == other.material && cullMode == other.cullMode && lod == other.lod;
+        }
+    };
+
+    struct InstanceGroupKeyHash
+    {
+        size_t operator()(const InstanceGroupKey& key) const
+        {
+            size_t hash = 0;
+            nvrhi::hash_combine(hash, key.geometry);
+            nvrhi::hash_combine(hash, key.material);
+            nvrhi::hash_combine(hash, key.cullMode);
+            nvrhi::hash_combine(hash, key.lod);
+            return hash;
+        }
+    };
+
+    // Draws each instance group with one instanced draw call that reads the instance indices from the indirection buffer.
+    void RenderViewWithInstanceGroups(
+        nvrhi::ICommandList* commandList,
+        IDrawStrategy& drawStrategy,
+        IGeometryPass& pass,
+        GeometryPassContext& passContext,
+        bool materialEvents,
+        InstanceIndirectionBuffer& instanceIndirection,
+        nvrhi::GraphicsState& graphicsState)
+    {
+        std::vector<InstanceGroup> groups;
+        InstancingStats stats;
+        CollectInstanceGroups(drawStrategy, groups, stats);
+
+        if (groups.empty())
+        {
+            instanceIndirection.AddStats(stats);
+            return;
+        }
+
+        std::vector<uint32_t> indices;
+        indices.reserve(stats.drawItems);
+        for (const InstanceGroup& group : groups)
+            indices.insert(indices.end(), group.instances.begin(), group.instances.end());
+
+        nvrhi::BufferHandle indirectionBuffer;
+        uint32_t indirectionOffset = instanceIndirection.Write(commandList, indices.data(), indices.size(), indirectionBuffer);
+
+        pass.SetInstanceIndirection(passContext, indirectionBuffer);
+
+        const Material* lastMaterial = nullptr;
+        const BufferGroup* lastBuffers = nullptr;
+        nvrhi::RasterCullMode lastCullMode = nvrhi::RasterCullMode::Back;
+        const Material* eventMaterial = nullptr;
+        bool drawMaterial = true;
+        bool stateValid = false;
+        uint32_t groupOffset = indirectionOffset;
+
+        for (const InstanceGroup& group : groups)
+        {
+            const DrawItem& item = group.item;
+            uint32_t startInstance = groupOffset;
+            groupOffset += uint32_t(group.instances.size());
+
+            if (item.buffers != lastBuffers)
+            {
+                pass.SetupInputBuffers(passContext, item.buffers, graphicsState);
+
+                lastBuffers = item.buffers;
+                stateValid = false;
+            }
+
+            if (item.material != lastMaterial || item.cullMode != lastCullMode)
+            {
+                drawMaterial = pass.SetupMaterial(passContext, item.material, item.cullMode, graphicsState);
+
+                lastMaterial = item.material;
+                lastCullMode = item.cullMode;
+                stateValid = false;
+            }
+
+            if (!drawMaterial)
+                continue;
+
+            if (!stateValid)
+            {
+                commandList->setGraphicsState(graphicsState);
+                stateValid = true;
+            }
+
+            if (materialEvents && item.material != eventMaterial)
+            {
+                if (eventMaterial)
+                    commandList->endMarker();
+
+                if (item.material->name.empty())
+                {
+                    eventMaterial = nullptr;
+                }
+                else
+                {
+                    commandList->beginMarker(item.material->name.c_str());
+                    eventMaterial = item.material;
+                }
+            }
+
+            nvrhi::DrawArguments args;
+            args.vertexCount = item.geometry->GetLodNumIndices(item.lod);
+            args.instanceCount = uint32_t(group.instances.size());
+            args.startVertexLocation = item.mesh->vertexOffset + item.geometry->vertexOffsetInMesh;
+            args.startIndexLocation = item.mesh->indexOffset + item.geometry->GetLodIndexOffset(item.lod);
+            args.startInstanceLocation = startInstance;
+
+            pass.SetPushConstants(passContext, commandList, graphicsState, args);
+
+            commandList->drawIndexed(args);
+
+            ++stats.drawCalls;
+            stats.drawCallsWithoutGroups += group.drawCallsWithoutGroups;
+        }
+
+        if (materialEvents && eventMaterial)
+            commandList->endMarker();
+
+        instanceIndirection.AddStats(stats);
+    }
+}
+
+void donut::render::CollectInstanceGroups(IDrawStrategy& drawStrategy, std::vector<InstanceGroup>& groups, InstancingStats& stats)
+{
+    std::unordered_map<InstanceGroupKey, size_t, InstanceGroupKeyHash> groupMap;
+
+    // Simulate the merging done by RenderView without groups, for the statistics
+    const Material* lastMaterial = nullptr;
+    const BufferGroup* lastBuffers = nullptr;
+    nvrhi::RasterCullMode lastCullMode = nvrhi::RasterCullMode::Back;
+    uint32_t lastStartIndex = 0;
+    uint32_t nextInstance = ~0u;
+
+    while (const DrawItem* item = drawStrategy.GetNextItem())
+    {
+        if (item->material == nullptr)
+            continue;
+
+        InstanceGroupKey key = { item->geometry, item->material, item->cullMode, item->lod };
+        auto [it, inserted] = groupMap.try_emplace(key, groups.size());
+        if (inserted)
+        {
+            InstanceGroup& group = groups.emplace_back();
+            group.item = *item;
+        }
+
+        InstanceGroup& group = groups[it->second];
+        uint32_t instanceIndex = uint32_t(item->instance->GetInstanceIndex());
+        group.instances.push_back(instanceIndex);
+
+        uint32_t startIndex = item->mesh->indexOffset + item->geometry->GetLodIndexOffset(item->lod);
+        if (item->material != lastMaterial || item->buffers != lastBuffers || item->cullMode != lastCullMode ||
+            startIndex != lastStartIndex || instanceIndex != nextInstance)
+        {
+            ++group.drawCallsWithoutGroups;
+        }
+
+        lastMaterial = item->material;
+        lastBuffers = item->buffers;
+        lastCullMode = item->cullMode;
+        lastStartIndex = startIndex;
+        nextInstance = instanceIndex + 1;
+
+        ++stats.drawItems;
+    }
+}
+
 void donut::render::RenderView(
     nvrhi::ICommandList* commandList, 
     const IView* view, 
@@ -37,8 +343,11 @@ void donut::render::RenderView(
     IDrawStrategy& drawStrategy,
     IGeometryPass& pass,
     GeometryPassContext& passContext,
-    bool materialEvents)
+    bool materialEvents,
+    InstanceIndirectionBuffer* instanceIndirection)
 {
+    DONUT_TRACE_ZONE("RenderView");
+
     pass.SetupView(passContext, commandList, view, viewPrev);
 
     const Material* lastMaterial = nullptr;
@@ -55,10 +364,20 @@ void donut::render::RenderView(
     graphicsState.viewport = view->GetViewportState();
     graphicsState.shadingRateState = view->GetVariableRateShadingState();
 
+    if (instanceIndirection && pass.SupportsInstanceIndirection())
+    {
+        RenderViewWithInstanceGroups(commandList, drawStrategy, pass, passContext, materialEvents, *instanceIndirection, graphicsState);
+        return;
+    }
+
+    pass.SetInstanceIndirection(passContext, nullptr);
+
+    InstancingStats stats;
+
     nvrhi::DrawArguments currentDraw;
     currentDraw.instanceCount = 0;
 
-    auto flushDraw = [commandList, materialEvents, &graphicsState, &currentDraw, &eventMaterial, &pass, &passContext](const Material* material)
+    auto flushDraw = [commandList, materialEvents, &graphicsState, &currentDraw, &eventMaterial, &pass, &passContext, &stats](const Material* material)
     {
         if (currentDraw.instanceCount == 0)
             return;
@@ -83,6 +402,7 @@ void donut::render::RenderView(
 
         commandList->drawIndexed(currentDraw);
         currentDraw.instanceCount = 0;
+        ++stats.drawCalls;
     };
     
     while (const DrawItem* item = drawStrategy.GetNextItem())
@@ -90,6 +410,7 @@ void donut::render::RenderView(
         if (item->material == nullptr)
             continue;
 
+        ++stats.drawItems;
 
         bool newBuffers = item->buffers != lastBuffers;
         bool newMaterial = item->material != lastMaterial || item->cullMode != lastCullMode;
@@ -125,10 +446,10 @@ void donut::render::RenderView(
             }
 
             nvrhi::DrawArguments args;
-            args.vertexCount = item->geometry->numIndices;
+            args.vertexCount = item->geometry->GetLodNumIndices(item->lod);
             args.instanceCount = 1;
             args.startVertexLocation = item->mesh->vertexOffset + item->geometry->vertexOffsetInMesh;
-            args.startIndexLocation = item->mesh->indexOffset + item->geometry->indexOffsetInMesh;
+            args.startIndexLocation = item->mesh->indexOffset + item->geometry->GetLodIndexOffset(item->lod);
             args.startInstanceLocation = item->instance->GetInstanceIndex();
 
             if (currentDraw.instanceCount > 0 && 
@@ -150,6 +471,12 @@ void donut::render::RenderView(
 
     if (materialEvents && eventMaterial)
         commandList->endMarker();
+
+    if (instanceIndirection)
+    {
+        stats.drawCallsWithoutGroups = stats.drawCalls;
+        instanceIndirection->AddStats(stats);
+    }
 }
 
 void donut::render::RenderCompositeView(
@@ -162,10 +489,14 @@ void donut::render::RenderCompositeView(
     IGeometryPass& pass,
     GeometryPassContext& passContext,
     const char* passEvent, 
-    bool materialEvents)
+    bool materialEvents,
+    InstanceIndirectionBuffer* instanceIndirection)
 {
+    DONUT_TRACE_ZONE("RenderCompositeView");
+
     if (passEvent)
         commandList->beginMarker(passEvent);
+    ScopedGpuZone gpuZone(commandList, passEvent);
 
     ViewType::Enum supportedViewTypes = pass.GetSupportedViewTypes();
 
@@ -186,7 +517,7 @@ void donut::render::RenderCompositeView(
 
         nvrhi::IFramebuffer* framebuffer = framebufferFactory.GetFramebuffer(*view);
 
-        RenderView(commandList, view, viewPrev, framebuffer, drawStrategy, pass, passContext, materialEvents);
+        RenderView(commandList, view, viewPrev, framebuffer, drawStrategy, pass, passContext, materialEvents, instanceIndirection);
     }
 
     if (passEvent)
@@ -0,0 +1,428 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/render/GpuCullingPass.h>
+#include <donut/engine/FramebufferFactory.h>
+#include <donut/engine/GpuProfiler.h>
+#include <donut/engine/Scene.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+#include <donut/core/trace.h>
+#include <algorithm>
+#include <unordered_map>
+
+#if DONUT_WITH_STATIC_SHADERS
+#if DONUT_WITH_DX11
+#include "compiled_shaders/passes/gpu_culling_cs.dxbc.h"
+#endif
+#if DONUT_WITH_DX12
+#include "compiled_shaders/passes/gpu_culling_cs.dxil.h"
+#endif
+#if DONUT_WITH_VULKAN
+#include "compiled_shaders/passes/gpu_culling_cs.spirv.h"
+#endif
+#endif
+
+using namespace donut::math;
+#include <donut/shaders/gpu_culling_cb.h>
+
+using namespace donut::engine;
+using namespace donut::render;
+
+GpuCullingPass::GpuCullingPass(nvrhi::IDevice* device)
+    : m_Device(device)
+{
+}
+
+void GpuCullingPass::Init(ShaderFactory& shaderFactory)
+{
+    m_ComputeShader = CreateComputeShader(shaderFactory);
+
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(GpuCullingConstants)),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
+        nvrhi::BindingLayoutItem::RawBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::RawBuffer_UAV(0),
+        nvrhi::BindingLayoutItem::RawBuffer_UAV(1)
+    };
+    m_BindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.CS = m_ComputeShader;
+    pipelineDesc.bindingLayouts = { m_BindingLayout };
+    m_Pipeline = m_Device->createComputePipeline(pipelineDesc);
+}
+
+nvrhi::ShaderHandle GpuCullingPass::CreateComputeShader(ShaderFactory& shaderFactory)
+{
+    return shaderFactory.CreateAutoShader("donut/passes/gpu_culling_cs.hlsl", "main", DONUT_MAKE_PLATFORM_SHADER(g_gpu_culling_cs), nullptr, nvrhi::ShaderType::Compute);
+}
+
+void GpuCullingPass::BuildDrawList(nvrhi::ICommandList* commandList, const Scene& scene)
+{
+    DONUT_TRACE_ZONE("GpuCullingPass::BuildDrawList");
+
+    m_DrawGroups.clear();
+    m_InitialDrawArguments.clear();
+    m_NumItems = 0;
+    m_BindingSet = nullptr;
+    m_SceneInstanceBuffer = scene.GetInstanceBuffer();
+    m_StructureVersion = scene.GetStructureVersion();
+    m_DrawListValid = true;
+
+    const auto& meshInstances = scene.GetSceneGraph()->GetMeshInstances();
+
+    auto isRelevant = [](const MeshGeometry& geometry)
+    {
+        auto domain = geometry.material->domain;
+        return domain == MaterialDomain::Opaque || domain == MaterialDomain::AlphaTested;
+    };
+
+    // Count the instances of every geometry
+    std::unordered_map<const MeshGeometry*, uint32_t> groupIndices;
+    for (const auto& instance : meshInstances)
+    {
+        const MeshInfo* mesh = instance->GetMesh().get();
+        for (const auto& geometry : mesh->geometries)
+        {
+            if (!isRelevant(*geometry))
+                continue;
+
+            auto [it, inserted] = groupIndices.try_emplace(geometry.get(), uint32_t(m_DrawGroups.size()));
+            if (inserted)
+            {
+                DrawGroup& group = m_DrawGroups.emplace_back();
+                group.mesh = mesh;
+                group.geometry = geometry.get();
+                group.material = geometry->material.get();
+                group.buffers = mesh->buffers.get();
+                group.cullMode = group.material->doubleSided ? nvrhi::RasterCullMode::None : nvrhi::RasterCullMode::Back;
+            }
+
+            ++m_DrawGroups[it->second].numInstances;
+            ++m_NumItems;
+        }
+    }
+
+    if (m_NumItems == 0)
+        return;
+
+    // Order the draws to minimize the state changes, like InstancedOpaqueDrawStrategy does
+    std::sort(m_DrawGroups.begin(), m_DrawGroups.end(), [](const DrawGroup& a, const DrawGroup& b)
+    {
+        if (a.material != b.material)
+            return a.material < b.material;
+        if (a.buffers != b.buffers)
+            return a.buffers < b.buffers;
+        if (a.mesh != b.mesh)
+            return a.mesh < b.mesh;
+        return a.geometry < b.geometry;
+    });
+
+    uint32_t instanceListOffset = 0;
+    m_InitialDrawArguments.resize(m_DrawGroups.size());
+    for (uint32_t drawIndex = 0; drawIndex < uint32_t(m_DrawGroups.size()); drawIndex++)
+    {
+        DrawGroup& group = m_DrawGroups[drawIndex];
+        group.instanceListOffset = instanceListOffset;
+        instanceListOffset += group.numInstances;
+        groupIndices[group.geometry] = drawIndex;
+
+        // The vertex and instance offsets are passed to the vertex shader through push constants
+        nvrhi::DrawIndexedIndirectArguments& args = m_InitialDrawArguments[drawIndex];
+        args.indexCount = group.geometry->numIndices;
+        args.instanceCount = 0;
+        args.startIndexLocation = group.mesh->indexOffset + group.geometry->indexOffsetInMesh;
+        args.baseVertexLocation = 0;
+        args.startInstanceLocation = 0;
+    }
+
+    std::vector<GpuCullingItem> items;
+    items.reserve(m_NumItems);
+    for (const auto& instance : meshInstances)
+    {
+        const MeshInfo* mesh = instance->GetMesh().get();
+        for (const auto& geometry : mesh->geometries)
+        {
+            if (!isRelevant(*geometry))
+                continue;
+
+            uint32_t drawIndex = groupIndices[geometry.get()];
+
+            GpuCullingItem& item = items.emplace_back();
+            item.instanceIndex = uint32_t(instance->GetInstanceIndex());
+            item.drawIndex = drawIndex;
+            item.instanceListOffset = m_DrawGroups[drawIndex].instanceListOffset;
+            item.boundsMin = geometry->objectSpaceBounds.m_mins;
+            item.boundsMax = geometry->objectSpaceBounds.m_maxs;
+            item.padding0 = 0.f;
+            item.padding1 = 0.f;
+
+            // Skinned geometry moves outside of its bind pose bounds, leave it to the scene graph culling
+            item.flags = mesh->skinPrototype ? GpuCullingItemFlag_AlwaysVisible : 0;
+        }
+    }
+
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = sizeof(GpuCullingItem) * items.size();
+    bufferDesc.structStride = sizeof(GpuCullingItem);
+    bufferDesc.debugName = "GpuCullingItems";
+    bufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    bufferDesc.keepInitialState = true;
+    m_ItemBuffer = m_Device->createBuffer(bufferDesc);
+
+    bufferDesc = nvrhi::BufferDesc();
+    bufferDesc.byteSize = sizeof(nvrhi::DrawIndexedIndirectArguments) * m_InitialDrawArguments.size();
+    bufferDesc.debugName = "GpuCullingDrawArguments";
+    bufferDesc.isDrawIndirectArgs = true;
+    bufferDesc.canHaveUAVs = true;
+    bufferDesc.canHaveRawViews = true;
+    bufferDesc.initialState = nvrhi::ResourceStates::IndirectArgument;
+    bufferDesc.keepInitialState = true;
+    m_DrawArgumentBuffer = m_Device->createBuffer(bufferDesc);
+
+    bufferDesc = nvrhi::BufferDesc();
+    bufferDesc.byteSize = sizeof(uint32_t) * m_NumItems;
+    bufferDesc.debugName = "GpuCullingInstanceList";
+    bufferDesc.canHaveUAVs = true;
+    bufferDesc.canHaveRawViews = true;
+    bufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    bufferDesc.keepInitialState = true;
+    m_InstanceListBuffer = m_Device->createBuffer(bufferDesc);
+
+    commandList->writeBuffer(m_ItemBuffer, items.data(), sizeof(GpuCullingItem) * items.size());
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::PushConstants(0, sizeof(GpuCullingConstants)),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(0, m_ItemBuffer),
+        nvrhi::BindingSetItem::RawBuffer_SRV(1, m_SceneInstanceBuffer),
+        nvrhi::BindingSetItem::RawBuffer_UAV(0, m_DrawArgumentBuffer),
+        nvrhi::BindingSetItem::RawBuffer_UAV(1, m_InstanceListBuffer)
+    };
+    m_BindingSet = m_Device->createBindingSet(bindingSetDesc, m_BindingLayout);
+}
+
+void GpuCullingPass::GetFrustumPlanes(const frustum& viewFrustum, float4 planes[6])
+{
+    static_assert(frustum::PLANES_COUNT == 6);
+
+    for (int i = 0; i < frustum::PLANES_COUNT; i++)
+        planes[i] = float4(viewFrustum.planes[i].normal, viewFrustum.planes[i].distance);
+}
+
+bool GpuCullingPass::IsBoxInFrustum(const float4 planes[6], const float transform[12], const box3& bounds)
+{
+    // Transform the object-space box into a world-space box that contains it, the transform rows are xyz + translation
+    const float3 localCenter = (bounds.m_mins + bounds.m_maxs) * 0.5f;
+    const float3 localExtent = (bounds.m_maxs - bounds.m_mins) * 0.5f;
+    float3 center, extent;
+    for (int row = 0; row < 3; row++)
+    {
+        const float3 axis(transform[row * 4], transform[row * 4 + 1], transform[row * 4 + 2]);
+        center[row] = dot(axis, localCenter) + transform[row * 4 + 3];
+        extent[row] = dot(abs(axis), localExtent);
+    }
+
+    for (int i = 0; i < 6; i++)
+    {
+        const float3 normal = planes[i].xyz();
+        const float distance = dot(normal, center) - dot(abs(normal), extent) - planes[i].w;
+        if (distance > 0.f)
+            return false;
+    }
+
+    return true;
+}
+
+void GpuCullingPass::PrepareScene(nvrhi::ICommandList* commandList, const Scene& scene)
+{
+    if (!m_DrawListValid || scene.GetStructureVersion() != m_StructureVersion || scene.GetInstanceBuffer() != m_SceneInstanceBuffer)
+        BuildDrawList(commandList, scene);
+}
+
+void GpuCullingPass::Cull(nvrhi::ICommandList* commandList, const IView& view)
+{
+    if (m_NumItems == 0)
+        return;
+
+    // Reset the instance counts left by the previous view
+    commandList->writeBuffer(m_DrawArgumentBuffer, m_InitialDrawArguments.data(),
+        sizeof(nvrhi::DrawIndexedIndirectArguments) * m_InitialDrawArguments.size());
+
+    GpuCullingConstants constants = {};
+    GetFrustumPlanes(view.GetViewFrustum(), constants.frustumPlanes);
+    constants.numItems = m_NumItems;
+
+    nvrhi::ComputeState state;
+    state.pipeline = m_Pipeline;
+    state.bindings = { m_BindingSet };
+    commandList->setComputeState(state);
+    commandList->setPushConstants(&constants, sizeof(constants));
+    commandList->dispatch(div_ceil(m_NumItems, GPU_CULLING_GROUP_SIZE));
+}
+
+void GpuCullingPass::RenderView(
+    nvrhi::ICommandList* commandList,
+    const IView* view,
+    const IView* viewPrev,
+    nvrhi::IFramebuffer* framebuffer,
+    IGeometryPass& pass,
+    GeometryPassContext& passContext,
+    bool materialEvents)
+{
+    DONUT_TRACE_ZONE("GpuCullingPass::RenderView");
+
+    assert(pass.SupportsInstanceIndirection());
+
+    if (m_DrawGroups.empty())
+        return;
+
+    pass.SetupView(passContext, commandList, view, viewPrev);
+    pass.SetInstanceIndirection(passContext, m_InstanceListBuffer);
+
+    nvrhi::GraphicsState graphicsState;
+    graphicsState.framebuffer = framebuffer;
+    graphicsState.viewport = view->GetViewportState();
+    graphicsState.shadingRateState = view->GetVariableRateShadingState();
+    graphicsState.indirectParams = m_DrawArgumentBuffer;
+
+    const Material* lastMaterial = nullptr;
+    const BufferGroup* lastBuffers = nullptr;
+    nvrhi::RasterCullMode lastCullMode = nvrhi::RasterCullMode::Back;
+    const Material* eventMaterial = nullptr;
+    bool drawMaterial = true;
+    bool stateValid = false;
+
+    for (uint32_t drawIndex = 0; drawIndex < uint32_t(m_DrawGroups.size()); drawIndex++)
+    {
+        const DrawGroup& group = m_DrawGroups[drawIndex];
+
+        if (group.buffers != lastBuffers)
+        {
+            pass.SetupInputBuffers(passContext, group.buffers, graphicsState);
+
+            lastBuffers = group.buffers;
+            stateValid = false;
+        }
+
+        if (group.material != lastMaterial || group.cullMode != lastCullMode)
+        {
+            drawMaterial = pass.SetupMaterial(passContext, group.material, group.cullMode, graphicsState);
+
+            lastMaterial = group.material;
+            lastCullMode = group.cullMode;
+            stateValid = false;
+        }
+
+        if (!drawMaterial)
+            continue;
+
+        if (!stateValid)
+        {
+            commandList->setGraphicsState(graphicsState);
+            stateValid = true;
+        }
+
+        if (materialEvents && group.material != eventMaterial)
+        {
+            if (eventMaterial)
+                commandList->endMarker();
+
+            if (group.material->name.empty())
+            {
+                eventMaterial = nullptr;
+            }
+            else
+            {
+                commandList->beginMarker(group.material->name.c_str());
+                eventMaterial = group.material;
+            }
+        }
+
+        // Only the push constants are used from these arguments, the counts come from the indirect buffer
+        nvrhi::DrawArguments args;
+        args.vertexCount = group.geometry->numIndices;
+        args.startVertexLocation = group.mesh->vertexOffset + group.geometry->vertexOffsetInMesh;
+        args.startIndexLocation = group.mesh->indexOffset + group.geometry->indexOffsetInMesh;
+        args.startInstanceLocation = group.instanceListOffset;
+        pass.SetPushConstants(passContext, commandList, graphicsState, args);
+
+        commandList->drawIndexedIndirect(drawIndex * uint32_t(sizeof(nvrhi::DrawIndexedIndirectArguments)));
+    }
+
+    if (materialEvents && eventMaterial)
+        commandList->endMarker();
+}
+
+void GpuCullingPass::RenderCompositeView(
+    nvrhi::ICommandList* commandList,
+    const ICompositeView* compositeView,
+    const ICompositeView* compositeViewPrev,
+    FramebufferFactory& framebufferFactory,
+    IGeometryPass& pass,
+    GeometryPassContext& passContext,
+    const char* passEvent,
+    bool materialEvents)
+{
+    DONUT_TRACE_ZONE("GpuCullingPass::RenderCompositeView");
+
+    if (passEvent)
+        commandList->beginMarker(passEvent);
+    ScopedGpuZone gpuZone(commandList, passEvent);
+
+    ViewType::Enum supportedViewTypes = pass.GetSupportedViewTypes();
+
+    if (compositeViewPrev)
+    {
+        // the views must have the same topology
+        assert(compositeView->GetNumChildViews(supportedViewTypes) == compositeViewPrev->GetNumChildViews(supportedViewTypes));
+    }
+
+    for (uint viewIndex = 0; viewIndex < compositeView->GetNumChildViews(supportedViewTypes); viewIndex++)
+    {
+        const IView* view = compositeView->GetChildView(supportedViewTypes, viewIndex);
+        const IView* viewPrev = compositeViewPrev ? compositeViewPrev->GetChildView(supportedViewTypes, viewIndex) : nullptr;
+
+        assert(view != nullptr);
+
+        Cull(commandList, *view);
+
+        nvrhi::IFramebuffer* framebuffer = framebufferFactory.GetFramebuffer(*view);
+
+        RenderView(commandList, view, viewPrev, framebuffer, pass, passContext, materialEvents);
+    }
+
+    if (passEvent)
+        commandList->endMarker();
+}
+
+GpuCullingPass::Stats GpuCullingPass::GetStats() const
+{
+    Stats stats;
+    stats.draws = uint32_t(m_DrawGroups.size());
+    stats.cullingItems = m_NumItems;
+    return stats;
+}
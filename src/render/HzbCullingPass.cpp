@@ -0,0 +1,444 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/render/HzbCullingPass.h>
+#include <donut/render/MipMapGenPass.h>
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+#include <donut/core/trace.h>
+#include <nvrhi/utils.h>
+#include <cmath>
+
+#if DONUT_WITH_STATIC_SHADERS
+#if DONUT_WITH_DX11
+#include "compiled_shaders/passes/hzb_build_cs.dxbc.h"
+#include "compiled_shaders/passes/hzb_culling_cs.dxbc.h"
+#endif
+#if DONUT_WITH_DX12
+#include "compiled_shaders/passes/hzb_build_cs.dxil.h"
+#include "compiled_shaders/passes/hzb_culling_cs.dxil.h"
+#endif
+#if DONUT_WITH_VULKAN
+#include "compiled_shaders/passes/hzb_build_cs.spirv.h"
+#include "compiled_shaders/passes/hzb_culling_cs.spirv.h"
+#endif
+#endif
+
+using namespace donut::math;
+#include <donut/shaders/gpu_culling_cb.h>
+#include <donut/shaders/hzb_culling_cb.h>
+
+using namespace donut::engine;
+using namespace donut::render;
+
+static constexpr uint32_t c_NumCounters = HzbCullingCounter_Count * 2;
+
+HzbCullingPass::HzbCullingPass(nvrhi::IDevice* device, std::shared_ptr<ShaderFactory> shaderFactory)
+    : GpuCullingPass(device)
+    , m_ShaderFactory(std::move(shaderFactory))
+{
+}
+
+HzbCullingPass::~HzbCullingPass() = default;
+
+HzbCullingPass::ViewHistory::ViewHistory() = default;
+
+HzbCullingPass::ViewHistory::~ViewHistory() = default;
+
+void HzbCullingPass::Init(ShaderFactory& shaderFactory)
+{
+    GpuCullingPass::Init(shaderFactory);
+
+    m_BuildShader = CreateBuildShader(shaderFactory);
+    m_CullingShader = CreateCullingShader(shaderFactory);
+
+    m_BuildConstants = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(sizeof(HzbBuildConstants), "HzbBuildConstants", 4));
+    m_CullingConstants = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(sizeof(HzbCullingConstants), "HzbCullingConstants", 8));
+
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::Texture_UAV(0)
+    };
+    m_BuildBindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
+        nvrhi::BindingLayoutItem::RawBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_SRV(2),
+        nvrhi::BindingLayoutItem::RawBuffer_UAV(0),
+        nvrhi::BindingLayoutItem::RawBuffer_UAV(1),
+        nvrhi::BindingLayoutItem::RawBuffer_UAV(2),
+        nvrhi::BindingLayoutItem::RawBuffer_UAV(3)
+    };
+    m_CullingBindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.CS = m_BuildShader;
+    pipelineDesc.bindingLayouts = { m_BuildBindingLayout };
+    m_BuildPipeline = m_Device->createComputePipeline(pipelineDesc);
+
+    pipelineDesc.CS = m_CullingShader;
+    pipelineDesc.bindingLayouts = { m_CullingBindingLayout };
+    m_CullingPipeline = m_Device->createComputePipeline(pipelineDesc);
+}
+
+nvrhi::ShaderHandle HzbCullingPass::CreateBuildShader(ShaderFactory& shaderFactory)
+{
+    return shaderFactory.CreateAutoShader("donut/passes/hzb_build_cs.hlsl", "main", DONUT_MAKE_PLATFORM_SHADER(g_hzb_build_cs), nullptr, nvrhi::ShaderType::Compute);
+}
+
+nvrhi::ShaderHandle HzbCullingPass::CreateCullingShader(ShaderFactory& shaderFactory)
+{
+    return shaderFactory.CreateAutoShader("donut/passes/hzb_culling_cs.hlsl", "main", DONUT_MAKE_PLATFORM_SHADER(g_hzb_culling_cs), nullptr, nvrhi::ShaderType::Compute);
+}
+
+HzbCullingPass::ViewHistory& HzbCullingPass::GetViewHistory(const IView& view)
+{
+    std::unique_ptr<ViewHistory>& history = m_ViewHistories[&view];
+    if (!history)
+        history = std::make_unique<ViewHistory>();
+
+    if (history->itemBuffer != m_ItemBuffer)
+    {
+        history->itemBuffer = m_ItemBuffer;
+        history->visibilityBuffer = nullptr;
+        history->cullingBindingSet = nullptr;
+    }
+
+    return *history;
+}
+
+void HzbCullingPass::CreateVisibilityBuffer(nvrhi::ICommandList* commandList, ViewHistory& history)
+{
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = sizeof(uint32_t) * m_NumItems;
+    bufferDesc.debugName = "HzbCullingVisibility";
+    bufferDesc.canHaveUAVs = true;
+    bufferDesc.canHaveRawViews = true;
+    bufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    bufferDesc.keepInitialState = true;
+    history.visibilityBuffer = m_Device->createBuffer(bufferDesc);
+    history.cullingBindingSet = nullptr;
+
+    // Without a history, the first phase draws everything that is in the frustum
+    std::vector<uint32_t> visibility(m_NumItems, HzbCullingVisibility_Visible);
+    commandList->writeBuffer(history.visibilityBuffer, visibility.data(), visibility.size() * sizeof(uint32_t));
+}
+
+void HzbCullingPass::CreateCounterBuffers(ViewHistory& history)
+{
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = sizeof(uint32_t) * c_NumCounters;
+    bufferDesc.debugName = "HzbCullingCounters";
+    bufferDesc.canHaveUAVs = true;
+    bufferDesc.canHaveRawViews = true;
+    bufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    bufferDesc.keepInitialState = true;
+    history.counterBuffer = m_Device->createBuffer(bufferDesc);
+    history.cullingBindingSet = nullptr;
+
+    bufferDesc = nvrhi::BufferDesc();
+    bufferDesc.byteSize = sizeof(uint32_t) * c_NumCounters;
+    bufferDesc.debugName = "HzbCullingCountersReadback";
+    bufferDesc.cpuAccess = nvrhi::CpuAccessMode::Read;
+    bufferDesc.initialState = nvrhi::ResourceStates::CopyDest;
+    bufferDesc.keepInitialState = true;
+    for (auto& buffer : history.readbackBuffers)
+        buffer = m_Device->createBuffer(bufferDesc);
+}
+
+void HzbCullingPass::BuildHzb(nvrhi::ICommandList* commandList, nvrhi::ITexture* depthTexture, const IView& view)
+{
+    DONUT_TRACE_ZONE("HzbCullingPass::BuildHzb");
+
+    nvrhi::Rect viewExtent = view.GetViewExtent();
+    int viewWidth = viewExtent.width();
+    int viewHeight = viewExtent.height();
+    if (viewWidth < 2 || viewHeight < 2)
+        return;
+
+    ViewHistory& history = GetViewHistory(view);
+
+    // The largest power-of-two size that fits into the viewport, so that every texel covers at least one pixel
+    uint32_t hzbWidth = 1u << uint32_t(std::floor(std::log2(float(viewWidth))));
+    uint32_t hzbHeight = 1u << uint32_t(std::floor(std::log2(float(viewHeight))));
+
+    if (!history.hzbTexture || history.hzbTexture->getDesc().width != hzbWidth || history.hzbTexture->getDesc().height != hzbHeight)
+    {
+        nvrhi::TextureDesc textureDesc;
+        textureDesc.width = hzbWidth;
+        textureDesc.height = hzbHeight;
+        textureDesc.mipLevels = uint32_t(std::floor(std::log2(float(std::max(hzbWidth, hzbHeight))))) + 1;
+        textureDesc.format = nvrhi::Format::R32_FLOAT;
+        textureDesc.dimension = nvrhi::TextureDimension::Texture2D;
+        textureDesc.isUAV = true;
+        textureDesc.debugName = "HzbCullingHzb";
+        textureDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+        textureDesc.keepInitialState = true;
+        history.hzbTexture = m_Device->createTexture(textureDesc);
+
+        history.hzbMipMapPass = std::make_unique<MipMapGenPass>(m_Device, m_ShaderFactory, history.hzbTexture, MipMapGenPass::MODE_MAX);
+        history.buildBindingSet = nullptr;
+        history.cullingBindingSet = nullptr;
+    }
+
+    if (!history.buildBindingSet || history.buildDepthTexture != depthTexture)
+    {
+        nvrhi::BindingSetDesc bindingSetDesc;
+        bindingSetDesc.bindings = {
+            nvrhi::BindingSetItem::ConstantBuffer(0, m_BuildConstants),
+            nvrhi::BindingSetItem::Texture_SRV(0, depthTexture),
+            nvrhi::BindingSetItem::Texture_UAV(0, history.hzbTexture, nvrhi::Format::UNKNOWN, nvrhi::TextureSubresourceSet(0, 1, 0, 1))
+        };
+        history.buildBindingSet = m_Device->createBindingSet(bindingSetDesc, m_BuildBindingLayout);
+        history.buildDepthTexture = depthTexture;
+    }
+
+    HzbBuildConstants constants = {};
+    constants.sourceOrigin = float2(float(viewExtent.minX), float(viewExtent.minY));
+    constants.sourceScale = float2(float(viewWidth) / float(hzbWidth), float(viewHeight) / float(hzbHeight));
+    constants.sourceMax = int2(viewExtent.maxX - 1, viewExtent.maxY - 1);
+    constants.hzbSize = uint2(hzbWidth, hzbHeight);
+    constants.reverseDepth = view.IsReverseDepth() ? 1 : 0;
+    commandList->writeBuffer(m_BuildConstants, &constants, sizeof(constants));
+
+    nvrhi::ComputeState state;
+    state.pipeline = m_BuildPipeline;
+    state.bindings = { history.buildBindingSet };
+    commandList->setComputeState(state);
+    commandList->dispatch(div_ceil(hzbWidth, HZB_BUILD_GROUP_SIZE), div_ceil(hzbHeight, HZB_BUILD_GROUP_SIZE));
+
+    history.hzbMipMapPass->Dispatch(commandList);
+
+    history.hzbViewProjection = view.GetViewProjectionMatrix();
+    history.hzbReverseDepth = view.IsReverseDepth();
+    history.hzbValid = true;
+}
+
+void HzbCullingPass::CullPhase(nvrhi::ICommandList* commandList, const IView& view, ViewHistory& history, uint32_t phase)
+{
+    if (!history.cullingBindingSet)
+    {
+        // Until the first HZB is built, bind any texture that fits the layout, the culling shader doesn't read it
+        nvrhi::ITexture* hzbTexture = history.hzbTexture ? history.hzbTexture.Get() : history.buildDepthTexture;
+
+        nvrhi::BindingSetDesc bindingSetDesc;
+        bindingSetDesc.bindings = {
+            nvrhi::BindingSetItem::ConstantBuffer(0, m_CullingConstants),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(0, m_ItemBuffer),
+            nvrhi::BindingSetItem::RawBuffer_SRV(1, m_SceneInstanceBuffer),
+            nvrhi::BindingSetItem::Texture_SRV(2, hzbTexture),
+            nvrhi::BindingSetItem::RawBuffer_UAV(0, m_DrawArgumentBuffer),
+            nvrhi::BindingSetItem::RawBuffer_UAV(1, m_InstanceListBuffer),
+            nvrhi::BindingSetItem::RawBuffer_UAV(2, history.visibilityBuffer),
+            nvrhi::BindingSetItem::RawBuffer_UAV(3, history.counterBuffer)
+        };
+        history.cullingBindingSet = m_Device->createBindingSet(bindingSetDesc, m_CullingBindingLayout);
+    }
+
+    // Reset the instance counts left by the previous phase
+    commandList->writeBuffer(m_DrawArgumentBuffer, m_InitialDrawArguments.data(),
+        sizeof(nvrhi::DrawIndexedIndirectArguments) * m_InitialDrawArguments.size());
+
+    HzbCullingConstants constants = {};
+    GetFrustumPlanes(view.GetViewFrustum(), constants.frustumPlanes);
+    constants.matHzbViewProj = history.hzbViewProjection;
+    constants.numItems = m_NumItems;
+    constants.phase = phase;
+    constants.useHzb = (history.hzbValid && history.hzbTexture) ? 1 : 0;
+    if (history.hzbTexture)
+    {
+        const nvrhi::TextureDesc& hzbDesc = history.hzbTexture->getDesc();
+        constants.hzbSize = float2(float(hzbDesc.width), float(hzbDesc.height));
+        constants.hzbMipLevels = hzbDesc.mipLevels;
+        constants.hzbReverseDepth = history.hzbReverseDepth ? 1 : 0;
+    }
+    commandList->writeBuffer(m_CullingConstants, &constants, sizeof(constants));
+
+    nvrhi::ComputeState state;
+    state.pipeline = m_CullingPipeline;
+    state.bindings = { history.cullingBindingSet };
+    commandList->setComputeState(state);
+    commandList->dispatch(div_ceil(m_NumItems, GPU_CULLING_GROUP_SIZE));
+}
+
+void HzbCullingPass::ReadCounters(nvrhi::ICommandList* commandList, ViewHistory& history)
+{
+    nvrhi::IBuffer* readbackBuffer = history.readbackBuffers[history.frameIndex % ReadbackLatency];
+
+    // This buffer was written ReadbackLatency frames ago, which the GPU should have finished by now
+    if (history.frameIndex >= ReadbackLatency)
+    {
+        const uint32_t* counters = static_cast<const uint32_t*>(m_Device->mapBuffer(readbackBuffer, nvrhi::CpuAccessMode::Read));
+        if (counters)
+        {
+            for (uint32_t phase = 0; phase < 2; phase++)
+            {
+                const uint32_t* phaseCounters = counters + phase * HzbCullingCounter_Count;
+                PhaseStats& stats = history.occlusionStats.phases[phase];
+                stats.tested = phaseCounters[HzbCullingCounter_Tested];
+                stats.drawn = phaseCounters[HzbCullingCounter_Drawn];
+                stats.frustumCulled = phaseCounters[HzbCullingCounter_FrustumCulled];
+                stats.occlusionCulled = phaseCounters[HzbCullingCounter_OcclusionCulled];
+            }
+            history.occlusionStats.valid = true;
+            m_Device->unmapBuffer(readbackBuffer);
+        }
+    }
+
+    commandList->copyBuffer(readbackBuffer, 0, history.counterBuffer, 0, sizeof(uint32_t) * c_NumCounters);
+    ++history.frameIndex;
+}
+
+void HzbCullingPass::RenderViewTwoPhase(
+    nvrhi::ICommandList* commandList,
+    const IView* view,
+    const IView* viewPrev,
+    nvrhi::IFramebuffer* framebuffer,
+    nvrhi::ITexture* depthTexture,
+    IGeometryPass& pass,
+    GeometryPassContext& passContext,
+    bool materialEvents)
+{
+    DONUT_TRACE_ZONE("HzbCullingPass::RenderViewTwoPhase");
+
+    if (m_NumItems == 0)
+        return;
+
+    ViewHistory& history = GetViewHistory(*view);
+
+    if (!history.visibilityBuffer)
+        CreateVisibilityBuffer(commandList, history);
+
+    if (!history.counterBuffer)
+        CreateCounterBuffers(history);
+
+    if (!history.buildDepthTexture)
+        history.buildDepthTexture = depthTexture;
+
+    const uint32_t zeroCounters[c_NumCounters] = {};
+    commandList->writeBuffer(history.counterBuffer, zeroCounters, sizeof(zeroCounters));
+
+    commandList->beginMarker("Occlusion Culling Phase 1");
+    CullPhase(commandList, *view, history, 0);
+    RenderView(commandList, view, viewPrev, framebuffer, pass, passContext, materialEvents);
+    commandList->endMarker();
+
+    bool hzbWasMissing = !history.hzbTexture;
+    BuildHzb(commandList, depthTexture, *view);
+    if (hzbWasMissing)
+        history.cullingBindingSet = nullptr; // replace the placeholder texture
+
+    commandList->beginMarker("Occlusion Culling Phase 2");
+    CullPhase(commandList, *view, history, 1);
+    RenderView(commandList, view, viewPrev, framebuffer, pass, passContext, materialEvents);
+    commandList->endMarker();
+
+    ReadCounters(commandList, history);
+}
+
+void HzbCullingPass::ResetHistory()
+{
+    for (auto& [view, history] : m_ViewHistories)
+    {
+        history->itemBuffer = nullptr;
+        history->hzbValid = false;
+    }
+}
+
+void HzbCullingPass::ReleaseViewHistory(const IView* view)
+{
+    m_ViewHistories.erase(view);
+}
+
+HzbCullingPass::OcclusionStats HzbCullingPass::GetOcclusionStats(const IView& view) const
+{
+    auto it = m_ViewHistories.find(&view);
+    return it != m_ViewHistories.end() ? it->second->occlusionStats : OcclusionStats();
+}
+
+nvrhi::ITexture* HzbCullingPass::GetHzbTexture(const IView& view) const
+{
+    auto it = m_ViewHistories.find(&view);
+    return it != m_ViewHistories.end() ? it->second->hzbTexture.Get() : nullptr;
+}
+
+bool HzbCullingPass::IsBoxOccluded(
+    const float4x4& hzbViewProjection,
+    bool reverseDepth,
+    uint2 hzbSize,
+    uint32_t hzbMipLevels,
+    const float3& center,
+    const float3& extent,
+    const std::function<float(int x, int y, uint32_t mip)>& loadHzb)
+{
+    float2 uvMin = 1e30f;
+    float2 uvMax = -1e30f;
+    float nearestDepth = 1.f;
+
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        float3 corner = center + extent * float3((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f, (i & 4) ? 1.f : -1.f);
+        float4 clipPos = float4(corner, 1.f) * hzbViewProjection;
+
+        // Boxes that cross the near plane cover the whole view
+        if (clipPos.w <= 0.f)
+            return false;
+
+        float3 ndc = clipPos.xyz() / clipPos.w;
+        float depth = reverseDepth ? 1.f - ndc.z : ndc.z;
+        if (depth < 0.f)
+            return false;
+
+        float2 uv = ndc.xy() * float2(0.5f, -0.5f) + 0.5f;
+        uvMin = min(uvMin, uv);
+        uvMax = max(uvMax, uv);
+        nearestDepth = std::min(nearestDepth, depth);
+    }
+
+    // Outside of the view that the HZB was built for, which happens in the first phase
+    if (any(uvMax < 0.f) || any(uvMin > 1.f))
+        return false;
+
+    float2 size = float2(hzbSize);
+    float2 rectMin = saturate(uvMin) * size;
+    float2 rectMax = saturate(uvMax) * size;
+    float2 rectSize = rectMax - rectMin;
+
+    // Select the level where the rectangle is at most one texel wide, so that it touches at most 2x2 texels
+    uint32_t mip = uint32_t(std::ceil(std::log2(std::max(std::max(rectSize.x, rectSize.y), 1.f))));
+    mip = std::min(mip, hzbMipLevels - 1);
+
+    int2 mipSize = int2(std::max(int(hzbSize.x >> mip), 1), std::max(int(hzbSize.y >> mip), 1));
+    int2 texMin = min(int2(rectMin / float(1u << mip)), mipSize - 1);
+    int2 texMax = min(int2(rectMax / float(1u << mip)), mipSize - 1);
+
+    float farthest = std::max(
+        std::max(loadHzb(texMin.x, texMin.y, mip), loadHzb(texMax.x, texMin.y, mip)),
+        std::max(loadHzb(texMin.x, texMax.y, mip), loadHzb(texMax.x, texMax.y, mip)));
+
+    return nearestDepth > farthest;
+}
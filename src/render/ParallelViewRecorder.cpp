@@ -0,0 +1,323 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/render/ParallelViewRecorder.h>
+#include <donut/engine/FramebufferFactory.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/core/log.h>
+#include <donut/core/trace.h>
+#include <atomic>
+#include <chrono>
+#include <cassert>
+#include <thread>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+using namespace donut::engine;
+using namespace donut::render;
+
+namespace
+{
+    float MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Shared by the threads of a RunParallel call, and kept alive by the helper tasks that start after it returns
+    struct ParallelLoop
+    {
+        std::atomic<size_t> nextIndex = 0;
+        std::atomic<size_t> finished = 0;
+        std::atomic<uint32_t> running = 0;
+        std::atomic<uint32_t> peakRunning = 0;
+        size_t count = 0;
+        const std::function<void(size_t)>* function = nullptr;
+
+        // Each thread pulls the next index from the shared counter, so that the slow calls do not hold up the others
+        void Run()
+        {
+            for (size_t index = nextIndex++; index < count; index = nextIndex++)
+            {
+                uint32_t current = ++running;
+                uint32_t peak = peakRunning.load();
+                while (current > peak && !peakRunning.compare_exchange_weak(peak, current))
+                    ;
+
+                (*function)(index);
+
+                --running;
+                ++finished;
+            }
+        }
+    };
+}
+
+ParallelViewRecorder::ParallelViewRecorder(
+    nvrhi::IDevice* device,
+    tf::Executor* executor,
+    StrategyFactory strategyFactory,
+    ContextFactory contextFactory)
+    : m_Device(device)
+    , m_Executor(executor)
+    , m_StrategyFactory(std::move(strategyFactory))
+    , m_ContextFactory(std::move(contextFactory))
+{
+    assert(m_StrategyFactory);
+    assert(m_ContextFactory);
+}
+
+uint32_t ParallelViewRecorder::RunParallel(tf::Executor* executor, uint32_t maxThreads, size_t count, const std::function<void(size_t)>& function)
+{
+    if (count == 0)
+        return 0;
+
+    uint32_t threads = uint32_t(std::min<size_t>(std::max(maxThreads, 1u), count));
+
+#ifdef DONUT_WITH_TASKFLOW
+    if (executor && threads > 1)
+    {
+        // The bundled taskflow has no corun, and waiting for a taskflow would block the calling thread, which
+        // deadlocks when it is a worker of the same executor and the others are busy. Instead, the calling thread
+        // runs the loop too and then only waits for the calls already started by the helpers; the helpers that
+        // start later find no indices left.
+        auto loop = std::make_shared<ParallelLoop>();
+        loop->count = count;
+        loop->function = &function;
+
+        for (uint32_t helper = 1; helper < threads; helper++)
+            executor->silent_async([loop]() { loop->Run(); });
+
+        loop->Run();
+
+        while (loop->finished.load() < count)
+            std::this_thread::yield();
+
+        return loop->peakRunning.load();
+    }
+#endif
+
+    for (size_t index = 0; index < count; index++)
+        function(index);
+
+    return 1;
+}
+
+void ParallelViewRecorder::SplitIntoTasks(const std::vector<size_t>& viewItemCounts, size_t maxItemsPerTask, std::vector<Task>& tasks)
+{
+    tasks.clear();
+
+    for (uint32_t viewIndex = 0; viewIndex < uint32_t(viewItemCounts.size()); viewIndex++)
+    {
+        size_t numItems = viewItemCounts[viewIndex];
+        size_t sliceSize = (maxItemsPerTask > 0) ? maxItemsPerTask : std::max<size_t>(numItems, 1);
+        size_t firstItem = 0;
+        do
+        {
+            Task& task = tasks.emplace_back();
+            task.viewIndex = viewIndex;
+            task.firstItem = firstItem;
+            task.numItems = std::min(sliceSize, numItems - firstItem);
+            firstItem += task.numItems;
+        } while (firstItem < numItems);
+    }
+}
+
+void ParallelViewRecorder::RenderCompositeView(
+    const ICompositeView* compositeView,
+    const ICompositeView* compositeViewPrev,
+    FramebufferFactory& framebufferFactory,
+    const std::shared_ptr<SceneGraphNode>& rootNode,
+    IGeometryPass& pass,
+    const char* passEvent,
+    bool materialEvents,
+    InstanceIndirectionBuffer* instanceIndirection)
+{
+    DONUT_TRACE_ZONE("ParallelViewRecorder::RenderCompositeView");
+
+    m_Stats = ParallelRecordingStats();
+    m_RecordedLists.clear();
+    m_Tasks.clear();
+
+    ViewType::Enum supportedViewTypes = pass.GetSupportedViewTypes();
+    uint32_t numViews = compositeView->GetNumChildViews(supportedViewTypes);
+
+    if (compositeViewPrev)
+    {
+        // the views must have the same topology
+        assert(numViews == compositeViewPrev->GetNumChildViews(supportedViewTypes));
+    }
+
+    // The framebuffer factory is not thread-safe, so resolve the framebuffers here
+    m_Views.resize(numViews);
+    for (uint32_t viewIndex = 0; viewIndex < numViews; viewIndex++)
+    {
+        ViewData& viewData = m_Views[viewIndex];
+        viewData.view = compositeView->GetChildView(supportedViewTypes, viewIndex);
+        viewData.viewPrev = compositeViewPrev ? compositeViewPrev->GetChildView(supportedViewTypes, viewIndex) : nullptr;
+        viewData.framebuffer = framebufferFactory.GetFramebuffer(*viewData.view);
+        viewData.items.clear();
+        viewData.firstTask = 0;
+        viewData.numTasks = 0;
+
+        assert(viewData.view != nullptr);
+    }
+
+    while (m_Strategies.size() < numViews)
+        m_Strategies.push_back(m_StrategyFactory());
+
+    m_Stats.views = numViews;
+
+    // Phase 1: run the draw strategies for all views and copy their output, so that it can be split into slices
+
+    auto prepareStart = std::chrono::steady_clock::now();
+
+    RunParallel(m_Executor, MaxThreads, numViews, [this, &rootNode](size_t viewIndex)
+    {
+        DONUT_TRACE_ZONE("PrepareForView");
+
+        ViewData& viewData = m_Views[viewIndex];
+        IDrawStrategy& strategy = *m_Strategies[viewIndex];
+
+        strategy.PrepareForView(rootNode, *viewData.view);
+
+        while (const DrawItem* item = strategy.GetNextItem())
+            viewData.items.push_back(*item);
+    });
+
+    m_Stats.prepareMs = MillisecondsSince(prepareStart);
+
+    std::vector<size_t> viewItemCounts(numViews);
+    for (uint32_t viewIndex = 0; viewIndex < numViews; viewIndex++)
+    {
+        viewItemCounts[viewIndex] = m_Views[viewIndex].items.size();
+        m_Stats.drawItems += uint32_t(viewItemCounts[viewIndex]);
+    }
+
+    SplitIntoTasks(viewItemCounts, MaxItemsPerTask, m_Tasks);
+
+    // The tasks of a view are adjacent
+    for (size_t taskIndex = 0; taskIndex < m_Tasks.size(); taskIndex++)
+    {
+        ViewData& viewData = m_Views[m_Tasks[taskIndex].viewIndex];
+        if (viewData.numTasks == 0)
+            viewData.firstTask = taskIndex;
+        ++viewData.numTasks;
+    }
+
+    // Phase 2: record the slices into separate command lists
+
+    while (m_CommandLists.size() < m_Tasks.size())
+    {
+        nvrhi::CommandListParameters params;
+        params.enableImmediateExecution = false;
+        nvrhi::CommandListHandle commandList = m_Device->createCommandList(params);
+        if (!commandList)
+        {
+            log::error("ParallelViewRecorder: failed to create a command list");
+            return;
+        }
+        m_CommandLists.push_back(commandList);
+    }
+
+    while (m_Contexts.size() < m_Tasks.size())
+        m_Contexts.push_back(m_ContextFactory());
+
+    std::atomic<uint64_t> taskMicroseconds = 0;
+
+    auto recordingStart = std::chrono::steady_clock::now();
+
+    RunParallel(m_Executor, MaxThreads, m_Tasks.size(), [this, passEvent, &taskMicroseconds](size_t taskIndex)
+    {
+        DONUT_TRACE_ZONE("PrepareViewTask");
+
+        auto taskStart = std::chrono::steady_clock::now();
+
+        nvrhi::ICommandList* commandList = m_CommandLists[taskIndex];
+
+        commandList->open();
+
+        if (passEvent)
+            commandList->beginMarker(passEvent);
+
+        if (PrepareContext)
+            PrepareContext(*m_Contexts[taskIndex], commandList);
+
+        taskMicroseconds += uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - taskStart).count());
+    });
+
+    // The per-view work of the pass, such as building light clusters, is done once for all slices of the view
+    m_SliceContexts.resize(m_Tasks.size());
+    for (size_t taskIndex = 0; taskIndex < m_Tasks.size(); taskIndex++)
+        m_SliceContexts[taskIndex] = m_Contexts[taskIndex].get();
+
+    RunParallel(m_Executor, MaxThreads, numViews, [this, &pass](size_t viewIndex)
+    {
+        DONUT_TRACE_ZONE("PrepareViewSlices");
+
+        const ViewData& viewData = m_Views[viewIndex];
+        pass.PrepareViewSlices(m_SliceContexts.data() + viewData.firstTask, viewData.numTasks, viewData.view);
+    });
+
+    m_Stats.threads = RunParallel(m_Executor, MaxThreads, m_Tasks.size(), [this, &pass, passEvent, materialEvents, instanceIndirection, &taskMicroseconds](size_t taskIndex)
+    {
+        DONUT_TRACE_ZONE("RecordViewTask");
+
+        auto taskStart = std::chrono::steady_clock::now();
+
+        const Task& task = m_Tasks[taskIndex];
+        const ViewData& viewData = m_Views[task.viewIndex];
+        nvrhi::ICommandList* commandList = m_CommandLists[taskIndex];
+        GeometryPassContext& context = *m_Contexts[taskIndex];
+
+        PassthroughDrawStrategy strategy;
+        strategy.SetData(viewData.items.data() + task.firstItem, task.numItems);
+
+        RenderView(commandList, viewData.view, viewData.viewPrev, viewData.framebuffer, strategy, pass, context,
+            materialEvents, instanceIndirection);
+
+        if (passEvent)
+            commandList->endMarker();
+
+        commandList->close();
+
+        taskMicroseconds += uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - taskStart).count());
+    });
+
+    m_Stats.recordingMs = MillisecondsSince(recordingStart);
+    m_Stats.taskMsTotal = float(taskMicroseconds.load()) * 1e-3f;
+    m_Stats.tasks = uint32_t(m_Tasks.size());
+
+    for (size_t taskIndex = 0; taskIndex < m_Tasks.size(); taskIndex++)
+        m_RecordedLists.push_back(m_CommandLists[taskIndex]);
+}
+
+uint64_t ParallelViewRecorder::Execute(nvrhi::CommandQueue queue)
+{
+    if (m_RecordedLists.empty())
+        return 0;
+
+    return m_Device->executeCommandLists(m_RecordedLists.data(), m_RecordedLists.size(), queue);
+}
@@ -23,6 +23,7 @@
 #include <donut/render/PixelReadbackPass.h>
 #include <donut/engine/ShaderFactory.h>
 #include <donut/engine/CommonRenderPasses.h>
+#include <donut/engine/AsyncReadback.h>
 
 #if DONUT_WITH_STATIC_SHADERS
 #if DONUT_WITH_DX11
@@ -114,7 +115,7 @@ PixelReadbackPass::PixelReadbackPass(
 }
 
 
-void PixelReadbackPass::Capture(nvrhi::ICommandList* commandList, dm::uint2 pixelPosition)
+void PixelReadbackPass::Dispatch(nvrhi::ICommandList* commandList, dm::uint2 pixelPosition)
 {
     PixelReadbackConstants constants = {};
     constants.pixelPosition = dm::int2(pixelPosition);
@@ -125,10 +126,46 @@ void PixelReadbackPass::Capture(nvrhi::ICommandList* commandList, dm::uint2 pixe
     state.bindings = { m_BindingSet };
     commandList->setComputeState(state);
     commandList->dispatch(1, 1, 1);
+}
+
+void PixelReadbackPass::Capture(nvrhi::ICommandList* commandList, dm::uint2 pixelPosition)
+{
+    Dispatch(commandList, pixelPosition);
 
     commandList->copyBuffer(m_ReadbackBuffer, 0, m_IntermediateBuffer, 0, m_ReadbackBuffer->getDesc().byteSize);
 }
 
+std::future<PixelReadbackResult> PixelReadbackPass::CaptureAsync(
+    nvrhi::ICommandList* commandList,
+    dm::uint2 pixelPosition,
+    AsyncReadback& readback,
+    std::function<void(const PixelReadbackResult&)> callback)
+{
+    Dispatch(commandList, pixelPosition);
+
+    auto promise = std::make_shared<std::promise<PixelReadbackResult>>();
+    std::future<PixelReadbackResult> future = promise->get_future();
+
+    // The intermediate buffer can be reused by the next capture as soon as the copy is recorded
+    readback.ReadBuffer(commandList, m_IntermediateBuffer, 0, sizeof(uint4),
+        [promise, callback = std::move(callback)](const std::vector<uint8_t>& data)
+        {
+            PixelReadbackResult result;
+            if (data.size() >= sizeof(result.bits))
+            {
+                memcpy(&result.bits, data.data(), sizeof(result.bits));
+                result.valid = true;
+            }
+
+            if (callback)
+                callback(result);
+
+            promise->set_value(result);
+        });
+
+    return future;
+}
+
 dm::float4 PixelReadbackPass::ReadFloats()
 {
     void* pData = m_Device->mapBuffer(m_ReadbackBuffer, nvrhi::CpuAccessMode::Read);
@@ -0,0 +1,376 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/render/ShadowMapCache.h>
+#include <donut/render/CascadedShadowMap.h>
+#include <donut/engine/FramebufferFactory.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/View.h>
+#include <donut/core/trace.h>
+#include <cassert>
+
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+namespace
+{
+    // Passes through the items of another strategy that belong to one of the layers of the cache
+    class LayerDrawStrategy : public IDrawStrategy
+    {
+    private:
+        IDrawStrategy& m_Strategy;
+        const ShadowMapCache& m_Cache;
+        bool m_DynamicLayer;
+
+    public:
+        LayerDrawStrategy(IDrawStrategy& strategy, const ShadowMapCache& cache, bool dynamicLayer)
+            : m_Strategy(strategy)
+            , m_Cache(cache)
+            , m_DynamicLayer(dynamicLayer)
+        { }
+
+        void PrepareForView(const std::shared_ptr<SceneGraphNode>& rootNode, const IView& view) override
+        {
+            m_Strategy.PrepareForView(rootNode, view);
+        }
+
+        const DrawItem* GetNextItem() override
+        {
+            while (const DrawItem* item = m_Strategy.GetNextItem())
+            {
+                if (m_Cache.IsDynamic(*item) == m_DynamicLayer)
+                    return item;
+            }
+
+            return nullptr;
+        }
+    };
+}
+
+ShadowMapCache::ShadowMapCache(nvrhi::IDevice* device, std::shared_ptr<CascadedShadowMap> shadowMap)
+    : m_Device(device)
+    , m_ShadowMap(std::move(shadowMap))
+    , m_DynamicStrategy(m_ShadowMap)
+{
+    nvrhi::TextureDesc desc = m_ShadowMap->GetTexture()->getDesc();
+    desc.debugName = "ShadowMapStaticLayers";
+    desc.isRenderTarget = false;
+    desc.isUAV = false;
+    desc.useClearValue = false;
+    desc.initialState = nvrhi::ResourceStates::CopySource;
+    desc.keepInitialState = true;
+    m_StaticLayers = device->createTexture(desc);
+
+    m_FramebufferFactory = std::make_shared<FramebufferFactory>(device);
+    m_FramebufferFactory->DepthTarget = m_ShadowMap->GetTexture();
+
+    m_StripView = std::make_shared<PlanarView>();
+
+    // D3D11 and D3D12 can only copy whole subresources of depth textures
+    m_ScrollingSupported = device->getGraphicsAPI() == nvrhi::GraphicsAPI::VULKAN;
+}
+
+nvrhi::TextureSlice ShadowMapCache::GetCascadeCopySlice(const nvrhi::Viewport& viewport, uint32_t arraySlice,
+    uint2 textureSize, bool wholeSubresource)
+{
+    if (wholeSubresource)
+    {
+        assert(viewport.minX == 0.f && viewport.minY == 0.f);
+        assert(uint32_t(viewport.width()) == textureSize.x && uint32_t(viewport.height()) == textureSize.y);
+
+        return nvrhi::TextureSlice().setArraySlice(arraySlice);
+    }
+
+    return nvrhi::TextureSlice()
+        .setOrigin(uint32_t(viewport.minX), uint32_t(viewport.minY))
+        .setWidth(uint32_t(viewport.width()))
+        .setHeight(uint32_t(viewport.height()))
+        .setDepth(1)
+        .setArraySlice(arraySlice);
+}
+
+bool ShadowMapCache::IsWholeNumber(float value, int& result)
+{
+    float rounded = std::round(value);
+    result = int(rounded);
+    return std::abs(value - rounded) < 0.01f;
+}
+
+ShadowMapCache::CascadeReuse ShadowMapCache::ClassifyCascade(const CascadeState& state, const affine3& viewMatrix,
+    const float4x4& projection, int2 size, bool allowScrolling, int2& texelOffset)
+{
+    texelOffset = 0;
+
+    // A cascade can reuse its static layer if only the position of the light-space box has changed, by a whole
+    // number of texels and without changing the depth mapping. Static content then appears shifted in the
+    // new view by the difference of the view translations.
+    if (!state.valid || any(state.projection != projection) || any(state.viewMatrix.m_linear != viewMatrix.m_linear))
+        return CascadeReuse::Miss;
+
+    float3 delta = viewMatrix.m_translation - state.viewMatrix.m_translation;
+    float2 texelSize = float2(2.f / (projection[0][0] * float(size.x)), 2.f / (projection[1][1] * float(size.y)));
+
+    int2 offset = 0;
+    bool scrollable = IsWholeNumber(delta.x / texelSize.x, offset.x)
+        && IsWholeNumber(-delta.y / texelSize.y, offset.y)
+        && std::abs(delta.z * projection[2][2]) < 1e-5f
+        && std::abs(offset.x) < size.x
+        && std::abs(offset.y) < size.y;
+
+    if (!scrollable)
+        return CascadeReuse::Miss;
+
+    // Moved by less than the tolerance
+    if (offset.x == 0 && offset.y == 0)
+        return CascadeReuse::Hit;
+
+    if (!allowScrolling)
+        return CascadeReuse::Miss;
+
+    texelOffset = offset;
+    return CascadeReuse::Scroll;
+}
+
+bool ShadowMapCache::FindMovedInstances(SceneGraphNode* rootNode, std::unordered_set<const MeshInstance*>& dynamicInstances)
+{
+    bool newInstanceMoved = false;
+
+    // SceneGraph::Refresh leaves the PrevTransform flag on the nodes whose transform changed,
+    // and SubgraphPrevTransforms on their ancestors
+    SceneGraphWalker walker(rootNode);
+    while (walker)
+    {
+        SceneGraphNode::DirtyFlags flags = walker->GetDirtyFlags();
+        bool transformChanged = (flags & SceneGraphNode::DirtyFlags::PrevTransform) != 0;
+        bool subgraphChanged = (flags & (SceneGraphNode::DirtyFlags::PrevTransform | SceneGraphNode::DirtyFlags::SubgraphPrevTransforms)) != 0;
+
+        if (transformChanged)
+        {
+            auto meshInstance = dynamic_cast<MeshInstance*>(walker->GetLeaf().get());
+            if (meshInstance && dynamicInstances.insert(meshInstance).second)
+                newInstanceMoved = true;
+        }
+
+        walker.Next(subgraphChanged);
+    }
+
+    return newInstanceMoved;
+}
+
+void ShadowMapCache::Invalidate()
+{
+    for (CascadeState& state : m_Cascades)
+        state.valid = false;
+
+    m_DynamicInstances.clear();
+}
+
+void ShadowMapCache::BeginFrame(const std::shared_ptr<SceneGraphNode>& rootNode, uint32_t structureVersion)
+{
+    DONUT_TRACE_ZONE("ShadowMapCache::BeginFrame");
+
+    if (structureVersion != m_StructureVersion)
+    {
+        // New instances are not in the static layers, and the dynamic set may refer to deleted ones.
+        // The transform flags are also set on all nodes when they are added, so they are ignored in this frame.
+        m_StructureVersion = structureVersion;
+        Invalidate();
+        return;
+    }
+
+    if (FindMovedInstances(rootNode.get(), m_DynamicInstances))
+    {
+        for (CascadeState& state : m_Cascades)
+            state.valid = false;
+    }
+}
+
+bool ShadowMapCache::IsDynamic(const DrawItem& item) const
+{
+    return item.mesh->skinPrototype || m_DynamicInstances.find(item.instance) != m_DynamicInstances.end();
+}
+
+void ShadowMapCache::RenderLayer(
+    nvrhi::ICommandList* commandList,
+    const IView& view,
+    const std::shared_ptr<SceneGraphNode>& rootNode,
+    IDrawStrategy& strategy,
+    bool dynamicLayer,
+    IGeometryPass& pass,
+    GeometryPassContext& passContext,
+    InstanceIndirectionBuffer* instanceIndirection)
+{
+    LayerDrawStrategy layerStrategy(strategy, *this, dynamicLayer);
+    layerStrategy.PrepareForView(rootNode, view);
+
+    nvrhi::IFramebuffer* framebuffer = m_FramebufferFactory->GetFramebuffer(view);
+
+    RenderView(commandList, &view, nullptr, framebuffer, layerStrategy, pass, passContext, false, instanceIndirection);
+}
+
+void ShadowMapCache::RenderStrip(
+    nvrhi::ICommandList* commandList,
+    const PlanarView& cascadeView,
+    int x0, int y0, int x1, int y1,
+    const std::shared_ptr<SceneGraphNode>& rootNode,
+    IGeometryPass& pass,
+    GeometryPassContext& passContext,
+    InstanceIndirectionBuffer* instanceIndirection)
+{
+    const nvrhi::Viewport& viewport = cascadeView.GetViewport();
+    float width = viewport.width();
+    float height = viewport.height();
+
+    // Map the clip-space rectangle of the strip to the whole clip space of the strip view.
+    // The depth mapping is unchanged, so that the strip matches the rest of the cached layer.
+    float left = -1.f + 2.f * float(x0) / width;
+    float right = -1.f + 2.f * float(x1) / width;
+    float top = 1.f - 2.f * float(y0) / height;
+    float bottom = 1.f - 2.f * float(y1) / height;
+
+    float4x4 clipRemap = float4x4(
+        2.f / (right - left), 0.f, 0.f, 0.f,
+        0.f, 2.f / (top - bottom), 0.f, 0.f,
+        0.f, 0.f, 1.f, 0.f,
+        -(right + left) / (right - left), -(top + bottom) / (top - bottom), 0.f, 1.f);
+
+    m_StripView->SetViewport(nvrhi::Viewport(
+        viewport.minX + float(x0), viewport.minX + float(x1),
+        viewport.minY + float(y0), viewport.minY + float(y1),
+        viewport.minZ, viewport.maxZ));
+    m_StripView->SetMatrices(cascadeView.GetViewMatrix(), cascadeView.GetProjectionMatrix(false) * clipRemap);
+    m_StripView->SetArraySlice(int(cascadeView.GetSubresources().baseArraySlice));
+    m_StripView->UpdateCache();
+
+    RenderLayer(commandList, *m_StripView, rootNode, m_StaticStrategy, false, pass, passContext, instanceIndirection);
+}
+
+void ShadowMapCache::Render(
+    nvrhi::ICommandList* commandList,
+    const std::shared_ptr<SceneGraphNode>& rootNode,
+    IGeometryPass& pass,
+    GeometryPassContext& passContext,
+    InstanceIndirectionBuffer* instanceIndirection)
+{
+    DONUT_TRACE_ZONE("ShadowMapCache::Render");
+
+    commandList->beginMarker("ShadowMapCache");
+
+    m_Stats.hits = 0;
+    m_Stats.scrolls = 0;
+    m_Stats.misses = 0;
+    m_Stats.dynamicInstances = uint32_t(m_DynamicInstances.size());
+
+    nvrhi::ITexture* shadowTexture = m_ShadowMap->GetTexture();
+    const nvrhi::TextureDesc& shadowDesc = shadowTexture->getDesc();
+    const nvrhi::FormatInfo& depthFormatInfo = nvrhi::getFormatInfo(shadowDesc.format);
+    const uint2 shadowSize = uint2(shadowDesc.width, shadowDesc.height);
+
+    uint32_t numCascades = m_ShadowMap->GetNumberOfCascades();
+    if (m_Cascades.size() < numCascades)
+        m_Cascades.resize(numCascades);
+
+    for (uint32_t cascade = 0; cascade < numCascades; cascade++)
+    {
+        std::shared_ptr<PlanarView> view = m_ShadowMap->GetCascadeView(cascade);
+        CascadeState& state = m_Cascades[cascade];
+
+        const nvrhi::Viewport& viewport = view->GetViewport();
+        int width = int(viewport.width());
+        int height = int(viewport.height());
+        uint32_t arraySlice = view->GetSubresources().baseArraySlice;
+
+        // Partial copies of depth textures are only used where scrolling is, i.e. on Vulkan
+        nvrhi::TextureSlice cascadeSlice = GetCascadeCopySlice(viewport, arraySlice, shadowSize, !m_ScrollingSupported);
+
+        int2 texelOffset = 0;
+        CascadeReuse reuse = ClassifyCascade(state, view->GetViewMatrix(), view->GetProjectionMatrix(false),
+            int2(width, height), m_ScrollingSupported, texelOffset);
+
+        if (reuse == CascadeReuse::Hit)
+        {
+            commandList->copyTexture(shadowTexture, cascadeSlice, m_StaticLayers, cascadeSlice);
+
+            ++m_Stats.hits;
+            ++m_Stats.totalHits;
+        }
+        else
+        {
+            commandList->clearDepthStencilTexture(shadowTexture, view->GetSubresources(), true, 1.f, depthFormatInfo.hasStencil, 0);
+
+            if (reuse == CascadeReuse::Scroll)
+            {
+                // Copy the part of the old layer that is still inside the cascade to its new position
+                nvrhi::TextureSlice srcSlice = cascadeSlice;
+                srcSlice.x += uint32_t(std::max(-texelOffset.x, 0));
+                srcSlice.y += uint32_t(std::max(-texelOffset.y, 0));
+                srcSlice.width = uint32_t(width - std::abs(texelOffset.x));
+                srcSlice.height = uint32_t(height - std::abs(texelOffset.y));
+
+                nvrhi::TextureSlice dstSlice = srcSlice;
+                dstSlice.x = cascadeSlice.x + uint32_t(std::max(texelOffset.x, 0));
+                dstSlice.y = cascadeSlice.y + uint32_t(std::max(texelOffset.y, 0));
+
+                commandList->copyTexture(shadowTexture, dstSlice, m_StaticLayers, srcSlice);
+
+                // Render the strips that were outside of the old layer
+                if (texelOffset.x > 0)
+                    RenderStrip(commandList, *view, 0, 0, texelOffset.x, height, rootNode, pass, passContext, instanceIndirection);
+                else if (texelOffset.x < 0)
+                    RenderStrip(commandList, *view, width + texelOffset.x, 0, width, height, rootNode, pass, passContext, instanceIndirection);
+
+                if (texelOffset.y > 0)
+                    RenderStrip(commandList, *view, 0, 0, width, texelOffset.y, rootNode, pass, passContext, instanceIndirection);
+                else if (texelOffset.y < 0)
+                    RenderStrip(commandList, *view, 0, height + texelOffset.y, width, height, rootNode, pass, passContext, instanceIndirection);
+
+                ++m_Stats.scrolls;
+                ++m_Stats.totalScrolls;
+            }
+            else
+            {
+                RenderLayer(commandList, *view, rootNode, m_StaticStrategy, false, pass, passContext, instanceIndirection);
+
+                ++m_Stats.misses;
+                ++m_Stats.totalMisses;
+            }
+
+            commandList->copyTexture(m_StaticLayers, cascadeSlice, shadowTexture, cascadeSlice);
+
+            state.valid = true;
+            state.viewMatrix = view->GetViewMatrix();
+            state.projection = view->GetProjectionMatrix(false);
+        }
+
+        RenderLayer(commandList, *view, rootNode, m_DynamicStrategy, true, pass, passContext, instanceIndirection);
+    }
+
+    commandList->endMarker();
+}
+
+void ShadowMapCache::ResetStats()
+{
+    m_Stats.totalHits = 0;
+    m_Stats.totalScrolls = 0;
+    m_Stats.totalMisses = 0;
+}
@@ -27,6 +27,7 @@
 #include <donut/engine/ShadowMap.h>
 #include <donut/engine/CommonRenderPasses.h>
 #include <donut/engine/View.h>
+#include <donut/engine/GpuProfiler.h>
 
 #if DONUT_WITH_STATIC_SHADERS
 #if DONUT_WITH_DX11
@@ -108,6 +109,7 @@ void SkyPass::Render(
     const SkyParameters& params) const
 {
     commandList->beginMarker("Sky");
+    ScopedGpuZone gpuZone(commandList, "Sky");
 
     for (uint viewIndex = 0; viewIndex < compositeView.GetNumChildViews(ViewType::PLANAR); viewIndex++)
     {
@@ -25,6 +25,7 @@
 #include <donut/engine/ShaderFactory.h>
 #include <donut/engine/CommonRenderPasses.h>
 #include <donut/engine/View.h>
+#include <donut/engine/GpuProfiler.h>
 
 #if DONUT_WITH_STATIC_SHADERS
 #if DONUT_WITH_DX11
@@ -211,6 +212,7 @@ void TemporalAntiAliasingPass::RenderMotionVectors(
     assert(m_MotionVectorsPso);
 
     commandList->beginMarker("MotionVectors");
+    ScopedGpuZone gpuZone(commandList, "MotionVectors");
 
     for (uint viewIndex = 0; viewIndex < compositeView.GetNumChildViews(ViewType::PLANAR); viewIndex++)
     {
@@ -258,6 +260,7 @@ void TemporalAntiAliasingPass::TemporalResolve(
     assert(compositeViewInput.GetNumChildViews(ViewType::PLANAR) == compositeViewOutput.GetNumChildViews(ViewType::PLANAR));
     
     commandList->beginMarker("TemporalAA");
+    ScopedGpuZone gpuZone(commandList, "TemporalAA");
 
     for (uint viewIndex = 0; viewIndex < compositeViewInput.GetNumChildViews(ViewType::PLANAR); viewIndex++)
     {
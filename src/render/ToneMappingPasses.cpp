@@ -24,6 +24,7 @@
 #include <donut/engine/ShaderFactory.h>
 #include <donut/engine/CommonRenderPasses.h>
 #include <donut/engine/View.h>
+#include <donut/engine/GpuProfiler.h>
 #include <sstream>
 #include <assert.h>
 #include <donut/engine/FramebufferFactory.h>
@@ -254,6 +255,7 @@ void ToneMappingPass::SimpleRender(
     ::ITexture* sourceTexture)
 {
     commandList->beginMarker("ToneMapping");
+    ScopedGpuZone gpuZone(commandList, "ToneMapping");
     ResetHistogram(commandList);
     AddFrameToHistogram(commandList, compositeView, sourceTexture);
     ComputeExposure(commandList, params);
@@ -0,0 +1,66 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+// Helpers for the tests of the engine and render modules, which test the CPU side of the passes without a device.
+
+#include <donut/engine/View.h>
+#include <donut/core/math/math.h>
+#include <nvrhi/nvrhi.h>
+
+// Creates a view at the origin, looking along +Z, that covers a width x height viewport.
+// The projection is reverse infinite when zFar is 0, and a regular D3D projection otherwise.
+inline donut::engine::PlanarView makeView(uint32_t width, uint32_t height, float verticalFov, float zFar = 0.f)
+{
+	const float aspectRatio = float(width) / float(height);
+	const float zNear = 0.1f;
+
+	donut::engine::PlanarView view;
+	view.SetViewport(nvrhi::Viewport(float(width), float(height)));
+	view.SetMatrices(donut::math::affine3::identity(), zFar > 0.f
+		? donut::math::perspProjD3DStyle(verticalFov, aspectRatio, zNear, zFar)
+		: donut::math::perspProjD3DStyleReverse(verticalFov, aspectRatio, zNear));
+	view.UpdateCache();
+	return view;
+}
+
+// Minimal nvrhi objects for the code that only tracks them and never touches the GPU
+
+class TestBuffer : public nvrhi::RefCounter<nvrhi::IBuffer>
+{
+public:
+	explicit TestBuffer(uint64_t byteSize = 0) { m_Desc.byteSize = byteSize; }
+
+	const nvrhi::BufferDesc& getDesc() const override { return m_Desc; }
+	nvrhi::GpuVirtualAddress getGpuVirtualAddress() const override { return 0; }
+
+private:
+	nvrhi::BufferDesc m_Desc;
+};
+
+class TestBindingSet : public nvrhi::RefCounter<nvrhi::IBindingSet>
+{
+public:
+	const nvrhi::BindingSetDesc* getDesc() const override { return nullptr; }
+	nvrhi::IBindingLayout* getLayout() const override { return nullptr; }
+};
@@ -0,0 +1,307 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include <donut/core/json_reader.h>
+
+#include <donut/tests/utils.h>
+#include <json/reader.h>
+#include <json/value.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <sstream>
+
+using namespace donut;
+
+// Counts the heap usage of the parsers to compare their peak memory
+
+static std::atomic<size_t> g_AllocatedBytes = 0;
+static std::atomic<size_t> g_PeakAllocatedBytes = 0;
+
+void* operator new(size_t size)
+{
+	size_t* block = static_cast<size_t*>(malloc(size + sizeof(size_t) * 2));
+	if (!block)
+		throw std::bad_alloc();
+	block[0] = size;
+	const size_t allocated = g_AllocatedBytes.fetch_add(size) + size;
+	size_t peak = g_PeakAllocatedBytes.load();
+	while (allocated > peak && !g_PeakAllocatedBytes.compare_exchange_weak(peak, allocated))
+		;
+	return block + 2;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (!ptr)
+		return;
+	size_t* block = static_cast<size_t*>(ptr) - 2;
+	g_AllocatedBytes.fetch_sub(block[0]);
+	free(block);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+static void ResetPeakMemory()
+{
+	g_PeakAllocatedBytes = g_AllocatedBytes.load();
+}
+
+static bool ParseDocument(const std::string& text, Json::Value& root)
+{
+	Json::CharReaderBuilder builder;
+	std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+	std::string errors;
+	return reader->parse(text.data(), text.data() + text.size(), &root, &errors);
+}
+
+void test_json_reader_values()
+{
+	const std::string text = "\xEF\xBB\xBF"
+		"{\n"
+		"  // line comment\n"
+		"  \"name\": \"plain\",\n"
+		"  \"escaped\": \"tab\\tquote\\\"unicode\\u00e9\\ud83d\\ude00\",\n"
+		"  /* block\n comment */\n"
+		"  \"numbers\": [ 0, -1, 2.5, 1e3, -0.125E-2, 4294967296, ],\n"
+		"  \"flags\": [ true, false, null ],\n"
+		"  \"nested\": { \"empty\": {}, \"list\": [[], [1, [2]]] },\n"
+		"}\n";
+
+	Json::Value expected;
+	CHECK(ParseDocument(text, expected));
+
+	json::Reader reader(text.data(), text.size());
+	Json::Value actual;
+	CHECK(reader.ReadValue(actual));
+	CHECK(!reader.HasError());
+	CHECK(actual == expected);
+	CHECK(actual["numbers"][5].isIntegral());
+	CHECK(actual["numbers"][5].asInt64() == 4294967296ll);
+}
+
+void test_json_reader_streaming()
+{
+	const std::string text = R"({ "skip": { "a": [1, "}", { "b": "]" }] }, "vec": [1, 2, 3, 4], "scalar": 7, "str": "x", "arr": ["a", "b"] })";
+
+	json::Reader reader(text.data(), text.size());
+	CHECK(reader.Peek() == json::Reader::ValueType::Object);
+	CHECK(reader.BeginObject());
+
+	size_t scalarOffset = 0;
+	int members = 0;
+	std::string_view key;
+	while (reader.NextMember(key))
+	{
+		++members;
+		if (key == "vec")
+		{
+			double values[3] = {};
+			CHECK(reader.ReadNumbers(values, 3) == 4);
+			CHECK(values[0] == 1.0 && values[1] == 2.0 && values[2] == 3.0);
+		}
+		else if (key == "scalar")
+		{
+			scalarOffset = reader.GetOffset();
+			double values[3] = {};
+			CHECK(reader.ReadNumbers(values, 3) == 1);
+			CHECK(values[0] == 7.0);
+		}
+		else if (key == "str")
+		{
+			double values[3] = {};
+			CHECK(reader.ReadNumbers(values, 3) == -1);
+		}
+		else if (key == "arr")
+		{
+			CHECK(reader.BeginArray());
+			int elements = 0;
+			while (reader.NextElement())
+			{
+				std::string_view value;
+				CHECK(reader.ReadString(value));
+				++elements;
+			}
+			CHECK(elements == 2);
+		}
+		else
+			CHECK(reader.Skip());
+	}
+	CHECK(members == 5);
+	CHECK(!reader.HasError());
+
+	reader.SetOffset(scalarOffset);
+	double value = 0.0;
+	CHECK(reader.ReadNumber(value));
+	CHECK(value == 7.0);
+}
+
+void test_json_reader_errors()
+{
+	const std::string text = "{\n  \"a\": [1, 2,\n  \"b\": }";
+
+	json::Reader reader(text.data(), text.size());
+	Json::Value value;
+	CHECK(!reader.ReadValue(value));
+	CHECK(reader.HasError());
+	CHECK(reader.GetErrorMessage().find("Line 3") != std::string::npos);
+
+	// Errors are sticky
+	CHECK(!reader.Skip());
+
+	// Missing or misplaced commas are rejected, trailing commas are accepted
+	const char* invalid[] = { "[1 2]", "{\"a\": 1 \"b\": 2}", "[,1]", "{,\"a\": 1}", "[1,,2]", "[1e]", "-" };
+	for (const char* invalidText : invalid)
+	{
+		json::Reader invalidReader(invalidText, strlen(invalidText));
+		CHECK(!invalidReader.ReadValue(value));
+		CHECK(invalidReader.HasError());
+	}
+
+	const char* valid[] = { "[1, 2,]", "{\"a\": 1, \"b\": [],}", "[]", "{}" };
+	for (const char* validText : valid)
+	{
+		json::Reader validReader(validText, strlen(validText));
+		CHECK(validReader.ReadValue(value));
+		CHECK(!validReader.HasError());
+	}
+}
+
+static std::string GenerateScene(int nodeCount, int keyframeCount)
+{
+	std::stringstream ss;
+	ss << "{\n\"models\": [\"a.gltf\", \"b.gltf\"],\n\"graph\": [\n";
+	for (int i = 0; i < nodeCount; i++)
+	{
+		ss << "{ \"name\": \"Node" << i << "\", \"model\": " << (i & 1)
+			<< ", \"translation\": [" << i * 0.5 << ", 1.25, -" << i << "]"
+			<< ", \"rotation\": [0, 0.7071, 0, 0.7071], \"scaling\": 2"
+			<< ", \"children\": [{ \"name\": \"Light" << i << "\", \"type\": \"PointLight\", \"color\": [1, 0.9, 0.8], \"radius\": 0.1 }] },\n";
+	}
+	ss << "],\n\"animations\": [{ \"name\": \"Anim\", \"channels\": [{ \"target\": \"Node0\", \"attribute\": \"translation\", \"mode\": \"linear\", \"data\": [\n";
+	for (int i = 0; i < keyframeCount; i++)
+		ss << "{ \"time\": " << i * 0.033 << ", \"value\": [" << i << ", 0.5, " << -i << "] },\n";
+	ss << "] }] }]\n}\n";
+	return ss.str();
+}
+
+// Walks the generated scene the same way as SceneGraphLoader does
+static double WalkScene(json::Reader& reader)
+{
+	double checksum = 0.0;
+
+	auto walk = [&](auto& self) -> void
+	{
+		switch (reader.Peek())
+		{
+		case json::Reader::ValueType::Object: {
+			reader.BeginObject();
+			std::string_view key;
+			while (reader.NextMember(key))
+			{
+				double values[4];
+				if (key == "translation" || key == "rotation" || key == "value" || key == "time" || key == "scaling")
+					checksum += reader.ReadNumbers(values, 4) > 0 ? values[0] : 0.0;
+				else
+					self(self);
+			}
+			break;
+		}
+		case json::Reader::ValueType::Array:
+			reader.BeginArray();
+			while (reader.NextElement())
+				self(self);
+			break;
+		case json::Reader::ValueType::String: {
+			std::string_view value;
+			reader.ReadString(value);
+			checksum += double(value.size());
+			break;
+		}
+		default:
+			reader.Skip();
+		}
+	};
+
+	walk(walk);
+	return checksum;
+}
+
+void test_json_reader_benchmark()
+{
+	const std::string text = GenerateScene(20000, 20000);
+
+	using clock = std::chrono::high_resolution_clock;
+
+	ResetPeakMemory();
+	size_t baseline = g_AllocatedBytes;
+	auto start = clock::now();
+	{
+		Json::Value root;
+		CHECK(ParseDocument(text, root));
+		CHECK(root["graph"].size() == 20000);
+	}
+	const double documentTime = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	const size_t documentMemory = g_PeakAllocatedBytes - baseline;
+
+	ResetPeakMemory();
+	baseline = g_AllocatedBytes;
+	start = clock::now();
+	{
+		json::Reader reader(text.data(), text.size());
+		WalkScene(reader);
+		CHECK(!reader.HasError());
+	}
+	const double readerTime = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	const size_t readerMemory = g_PeakAllocatedBytes - baseline;
+
+	printf("Scene JSON of %.1f MB:\n", double(text.size()) / (1024.0 * 1024.0));
+	printf("  jsoncpp document: %8.2f ms, peak heap %8.2f MB\n", documentTime, double(documentMemory) / (1024.0 * 1024.0));
+	printf("  json::Reader:     %8.2f ms, peak heap %8.2f MB\n", readerTime, double(readerMemory) / (1024.0 * 1024.0));
+
+	// The streaming reader only allocates for escaped strings
+	CHECK(readerMemory < documentMemory / 100);
+}
+
+int main(int, char** argv)
+{
+	try
+	{
+		test_json_reader_values();
+		test_json_reader_streaming();
+		test_json_reader_errors();
+		test_json_reader_benchmark();
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,205 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include <donut/core/log.h>
+
+#include <donut/tests/utils.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace donut;
+
+void test_async_log_ordering()
+{
+	std::vector<std::string> messages;
+	log::SetCallback([&messages](log::Severity, const char* message) { messages.push_back(message); });
+	log::EnableAsyncMode(true, 64);
+
+	constexpr int threadCount = 4;
+	constexpr int messagesPerThread = 1000;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadCount; ++t)
+	{
+		threads.emplace_back([t]()
+		{
+			for (int i = 0; i < messagesPerThread; ++i)
+				log::warning("%d %d", t, i);
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	log::Flush();
+
+	// Warnings are never dropped, and messages from one thread are delivered in order
+	CHECK(messages.size() == threadCount * messagesPerThread);
+
+	std::vector<int> next(threadCount, 0);
+	for (const std::string& message : messages)
+	{
+		int t = -1, i = -1;
+		CHECK(sscanf(message.c_str(), "%d %d", &t, &i) == 2);
+		CHECK(t >= 0 && t < threadCount);
+		CHECK(i == next[t]);
+		++next[t];
+	}
+
+	log::EnableAsyncMode(false);
+	log::ResetCallback();
+}
+
+void test_async_log_repeat_limit()
+{
+	std::vector<std::string> messages;
+	log::SetCallback([&messages](log::Severity, const char* message) { messages.push_back(message); });
+	log::SetRepeatedMessageLimit(3, 100.f);
+	log::EnableAsyncMode(true);
+
+	for (int i = 0; i < 10; ++i)
+		log::warning("Texture not found");
+	log::warning("Another message");
+
+	// Disabling the async mode flushes the suppressed message summaries
+	log::EnableAsyncMode(false);
+	log::SetRepeatedMessageLimit(0);
+	log::ResetCallback();
+
+	CHECK(messages.size() == 5);
+	CHECK(messages[0] == "Texture not found");
+	CHECK(messages[2] == "Texture not found");
+	CHECK(messages[3] == "Another message");
+	CHECK(messages[4] == "Suppressed 7 repeats of the message: Texture not found");
+}
+
+void test_async_log_repeat_severity()
+{
+	std::vector<std::pair<log::Severity, std::string>> messages;
+	log::SetCallback([&messages](log::Severity severity, const char* message) { messages.push_back({ severity, message }); });
+	log::SetRepeatedMessageLimit(1, 100.f);
+	log::EnableAsyncMode(true);
+
+	// The same text with different severities is limited separately
+	for (int i = 0; i < 3; ++i)
+	{
+		log::warning("Shader compilation failed");
+		log::error("Shader compilation failed");
+	}
+
+	log::EnableAsyncMode(false);
+	log::SetRepeatedMessageLimit(0);
+	log::ResetCallback();
+
+	CHECK(messages.size() == 4);
+	CHECK(messages[0].first == log::Severity::Warning);
+	CHECK(messages[1].first == log::Severity::Error);
+	int warningSummaries = 0, errorSummaries = 0;
+	for (size_t i = 2; i < messages.size(); ++i)
+	{
+		CHECK(messages[i].second == "Suppressed 2 repeats of the message: Shader compilation failed");
+		if (messages[i].first == log::Severity::Warning)
+			++warningSummaries;
+		if (messages[i].first == log::Severity::Error)
+			++errorSummaries;
+	}
+	CHECK(warningSummaries == 1);
+	CHECK(errorSummaries == 1);
+}
+
+// The callback runs without holding the lock that SetCallback takes, so another thread
+// can replace the callback while a slow callback is running.
+void test_async_log_replace_callback()
+{
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool entered = false;
+	bool replaced = false;
+	bool releasedByReplacement = false;
+
+	log::SetCallback([&](log::Severity, const char*)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		entered = true;
+		condition.notify_all();
+		releasedByReplacement = condition.wait_for(lock, std::chrono::seconds(10), [&replaced]() { return replaced; });
+	});
+	log::EnableAsyncMode(true);
+
+	log::warning("Slow message");
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [&entered]() { return entered; });
+	}
+
+	std::vector<std::string> messages;
+	log::SetCallback([&messages](log::Severity, const char* message) { messages.push_back(message); });
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		replaced = true;
+	}
+	condition.notify_all();
+
+	log::warning("Fast message");
+	log::EnableAsyncMode(false);
+	log::ResetCallback();
+
+	CHECK(releasedByReplacement);
+	CHECK(messages.size() == 1);
+	CHECK(messages[0] == "Fast message");
+}
+
+void test_sync_log()
+{
+	std::vector<std::string> messages;
+	log::SetCallback([&messages](log::Severity, const char* message) { messages.push_back(message); });
+
+	log::info("Value %d", 42);
+	log::debug("Hidden by the default severity");
+
+	CHECK(messages.size() == 1);
+	CHECK(messages[0] == "Value 42");
+
+	log::ResetCallback();
+}
+
+int main(int, char** argv)
+{
+	try
+	{
+		test_sync_log();
+		test_async_log_ordering();
+		test_async_log_repeat_limit();
+		test_async_log_repeat_severity();
+		test_async_log_replace_callback();
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
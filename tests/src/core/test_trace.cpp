@@ -0,0 +1,106 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include <donut/core/trace.h>
+
+#include <donut/tests/utils.h>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+using namespace donut;
+
+void test_trace_zones()
+{
+	trace::ClearHistory();
+	trace::Enable(true);
+	trace::SetThreadName("Main");
+
+	{
+		DONUT_TRACE_ZONE("Outer");
+		{
+			DONUT_TRACE_ZONE("Inner");
+		}
+		std::thread worker([]()
+		{
+			DONUT_TRACE_ZONE("Worker");
+		});
+		worker.join();
+	}
+	trace::EndFrame(1);
+
+	trace::Enable(false);
+	{
+		DONUT_TRACE_ZONE("Disabled");
+	}
+	trace::EndFrame(2);
+
+	std::vector<trace::FrameRecord> frames = trace::GetFrameHistory();
+	CHECK(frames.size() == 1);
+	CHECK(frames[0].frameIndex == 1);
+	CHECK(frames[0].zones.size() == 3);
+
+	const trace::ZoneRecord& outer = frames[0].zones[0];
+	const trace::ZoneRecord& inner = frames[0].zones[1];
+	const trace::ZoneRecord& worker = frames[0].zones[2];
+	CHECK(std::string(outer.name) == "Outer" && outer.depth == 0);
+	CHECK(std::string(inner.name) == "Inner" && inner.depth == 1);
+	CHECK(inner.beginNs >= outer.beginNs && inner.endNs <= outer.endNs);
+	CHECK(std::string(worker.name) == "Worker" && worker.depth == 0);
+	CHECK(worker.threadIndex != outer.threadIndex);
+
+	std::vector<std::string> threadNames = trace::GetThreadNames();
+	CHECK(threadNames[outer.threadIndex] == "Main");
+}
+
+void test_trace_chrome_export()
+{
+	const std::filesystem::path fileName = std::filesystem::temp_directory_path() / "donut_test_trace.json";
+	CHECK(trace::WriteChromeTrace(fileName));
+
+	std::ifstream file(fileName);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	file.close();
+	std::filesystem::remove(fileName);
+
+	const std::string text = contents.str();
+	CHECK(text.find("\"traceEvents\"") != std::string::npos);
+	CHECK(text.find("{\"name\":\"Inner\",\"ph\":\"X\"") != std::string::npos);
+	CHECK(text.find("\"args\":{\"name\":\"Main\"}") != std::string::npos);
+}
+
+int main(int, char** argv)
+{
+	try
+	{
+		test_trace_zones();
+		test_trace_chrome_export();
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
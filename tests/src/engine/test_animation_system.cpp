@@ -0,0 +1,230 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/AnimationSystem.h>
+#include <donut/engine/KeyframeAnimation.h>
+#include <donut/tests/utils.h>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+#include <cmath>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+static const int c_NodeCount = 4;
+
+struct AnimatedScene
+{
+	std::shared_ptr<SceneGraph> graph;
+	std::vector<std::shared_ptr<SceneGraphNode>> nodes;
+	std::vector<std::shared_ptr<SceneGraphAnimation>> animations;
+};
+
+static std::shared_ptr<animation::Sampler> makeSampler(animation::InterpolationMode mode, float duration, float phase)
+{
+	auto sampler = std::make_shared<animation::Sampler>();
+	sampler->SetInterpolationMode(mode);
+
+	for (int i = 0; i <= 10; ++i)
+	{
+		const float time = duration * float(i) / 10.f;
+		const float angle = time * 1.3f + phase;
+
+		animation::Keyframe keyframe;
+		keyframe.time = time;
+		if (mode == animation::InterpolationMode::Slerp)
+			keyframe.value = float4(normalize(float3(sinf(angle), 1.f, cosf(angle))) * sinf(angle * 0.5f), cosf(angle * 0.5f));
+		else
+			keyframe.value = float4(sinf(angle) + phase, cosf(angle) * 2.f, angle, 0.f);
+
+		sampler->AddKeyframe(keyframe);
+	}
+
+	return sampler;
+}
+
+static std::shared_ptr<SceneGraphAnimation> makeAnimation(const AnimatedScene& scene, float duration, float phase,
+	std::initializer_list<std::pair<int, AnimationAttribute>> channels)
+{
+	auto animation = std::make_shared<SceneGraphAnimation>();
+	for (const auto& [node, attribute] : channels)
+	{
+		const auto mode = (attribute == AnimationAttribute::Rotation)
+			? animation::InterpolationMode::Slerp
+			: animation::InterpolationMode::Linear;
+
+		animation->AddChannel(std::make_shared<SceneGraphAnimationChannel>(
+			makeSampler(mode, duration, phase + float(node)), scene.nodes[node], attribute));
+	}
+	return animation;
+}
+
+// Builds a graph with several nodes, and clips that animate overlapping sets of nodes and attributes
+static AnimatedScene createScene()
+{
+	AnimatedScene scene;
+	scene.graph = std::make_shared<SceneGraph>();
+	auto root = std::make_shared<SceneGraphNode>();
+	scene.graph->SetRootNode(root);
+
+	for (int i = 0; i < c_NodeCount; ++i)
+	{
+		auto node = std::make_shared<SceneGraphNode>();
+		node->SetTranslation(double3(double(i), 1.0, -2.0));
+		node->SetScaling(double3(1.0 + 0.5 * i));
+		scene.graph->Attach(root, node);
+		scene.nodes.push_back(node);
+	}
+
+	scene.animations.push_back(makeAnimation(scene, 2.f, 0.f, {
+		{ 0, AnimationAttribute::Translation }, { 0, AnimationAttribute::Rotation },
+		{ 1, AnimationAttribute::Translation }, { 1, AnimationAttribute::Rotation } }));
+	scene.animations.push_back(makeAnimation(scene, 3.f, 0.7f, {
+		{ 1, AnimationAttribute::Translation }, { 2, AnimationAttribute::Scaling } }));
+	scene.animations.push_back(makeAnimation(scene, 1.5f, 1.9f, {
+		{ 0, AnimationAttribute::Rotation }, { 3, AnimationAttribute::Rotation }, { 3, AnimationAttribute::Scaling } }));
+
+	return scene;
+}
+
+static bool sameTransforms(const AnimatedScene& a, const AnimatedScene& b)
+{
+	for (int i = 0; i < c_NodeCount; ++i)
+	{
+		const SceneGraphNode& nodeA = *a.nodes[i];
+		const SceneGraphNode& nodeB = *b.nodes[i];
+		if (any(nodeA.GetTranslation() != nodeB.GetTranslation()) ||
+			any(nodeA.GetRotation().toXYZW() != nodeB.GetRotation().toXYZW()) ||
+			any(nodeA.GetScaling() != nodeB.GetScaling()))
+			return false;
+	}
+	return true;
+}
+
+// Parallel evaluation produces exactly the same transforms as the serial one, for any number of threads
+void test_animation_system_parallel()
+{
+#ifdef DONUT_WITH_TASKFLOW
+	const float weights[] = { 0.7f, 0.6f, 0.5f };
+
+	for (size_t threads : { 1, 2, 4, 8 })
+	{
+		AnimatedScene parallelScene = createScene();
+		AnimationSystem parallelSystem(parallelScene.graph);
+		for (size_t i = 0; i < parallelScene.animations.size(); ++i)
+			parallelSystem.Play(parallelScene.animations[i], weights[i]);
+
+		AnimatedScene referenceScene = createScene();
+		AnimationSystem referenceSystem(referenceScene.graph);
+		for (size_t i = 0; i < referenceScene.animations.size(); ++i)
+			referenceSystem.Play(referenceScene.animations[i], weights[i]);
+
+		tf::Executor executor(threads);
+		for (int frame = 0; frame < 100; ++frame)
+		{
+			referenceSystem.Advance(0.037f);
+			referenceSystem.Update();
+			parallelSystem.Advance(0.037f);
+			parallelSystem.Update(&executor);
+			CHECK(sameTransforms(referenceScene, parallelScene));
+		}
+	}
+#endif
+}
+
+// With a single clip per node and a weight of 1, the result matches SceneGraphAnimation::Apply
+void test_animation_system_apply()
+{
+	AnimatedScene systemScene = createScene();
+	AnimationSystem system(systemScene.graph);
+	AnimationSystem::PlaybackHandle clip = system.Play(systemScene.animations[0], 1.f, false);
+
+	AnimatedScene applyScene = createScene();
+
+	for (float time = 0.f; time < 2.f; time += 0.1f)
+	{
+		system.SetTime(clip, time);
+		system.Update();
+		applyScene.animations[0]->Apply(time);
+
+		for (int i = 0; i < 2; ++i)
+		{
+			CHECK(length(systemScene.nodes[i]->GetTranslation() - applyScene.nodes[i]->GetTranslation()) < 1e-6);
+			CHECK(length(systemScene.nodes[i]->GetRotation().toXYZW() - applyScene.nodes[i]->GetRotation().toXYZW()) < 1e-6);
+		}
+	}
+}
+
+// A total weight below 1 blends with the rest pose, and larger total weights are normalized
+void test_animation_system_weights()
+{
+	AnimatedScene scene = createScene();
+	const double3 restTranslation = scene.nodes[1]->GetTranslation();
+	const double3 restScaling = scene.nodes[2]->GetScaling();
+
+	AnimationSystem system(scene.graph);
+	AnimationSystem::PlaybackHandle clip = system.Play(scene.animations[1], 0.5f, false);
+	system.SetTime(clip, 1.f);
+	system.Update();
+
+	const float4 translationValue = scene.animations[1]->GetChannels()[0]->GetSampler()->Evaluate(1.f, true).value();
+	const float4 scalingValue = scene.animations[1]->GetChannels()[1]->GetSampler()->Evaluate(1.f, true).value();
+	const double3 expectedTranslation = (double3(translationValue.xyz()) + restTranslation) * 0.5;
+	const double3 expectedScaling = (double3(scalingValue.xyz()) + restScaling) * 0.5;
+	CHECK(length(scene.nodes[1]->GetTranslation() - expectedTranslation) < 1e-6);
+	CHECK(length(scene.nodes[2]->GetScaling() - expectedScaling) < 1e-6);
+
+	// The rest pose is kept when more clips start, even though the nodes have been animated since
+	AnimationSystem::PlaybackHandle otherClip = system.Play(scene.animations[0], 0.25f, false);
+	system.Update();
+
+	const float4 otherValue = scene.animations[0]->GetChannels()[2]->GetSampler()->Evaluate(0.f, true).value();
+	const double3 blendedTranslation = double3(translationValue.xyz()) * 0.5 + double3(otherValue.xyz()) * 0.25 + restTranslation * 0.25;
+	CHECK(length(scene.nodes[1]->GetTranslation() - blendedTranslation) < 1e-6);
+
+	// Weights above 1 in total are normalized
+	system.SetWeight(clip, 3.f);
+	system.SetWeight(otherClip, 1.f);
+	system.Update();
+	const double3 normalizedTranslation = (double3(translationValue.xyz()) * 3.0 + double3(otherValue.xyz())) / 4.0;
+	CHECK(length(scene.nodes[1]->GetTranslation() - normalizedTranslation) < 1e-6);
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_animation_system_parallel();
+		test_animation_system_apply();
+		test_animation_system_weights();
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,193 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/AsyncReadback.h>
+#include <donut/tests/engine_utils.h>
+#include <donut/tests/utils.h>
+
+using namespace donut;
+using namespace donut::engine;
+
+using SlotReuse = AsyncReadback::SlotReuse;
+
+class TestStagingTexture : public nvrhi::RefCounter<nvrhi::IStagingTexture>
+{
+public:
+	TestStagingTexture(uint32_t width, uint32_t height, nvrhi::Format format)
+	{
+		m_Desc.width = width;
+		m_Desc.height = height;
+		m_Desc.format = format;
+	}
+
+	const nvrhi::TextureDesc& getDesc() const override { return m_Desc; }
+
+private:
+	nvrhi::TextureDesc m_Desc;
+};
+
+void test_slots()
+{
+	// Three frames in flight: frame 3 records into the slot of frame 0
+	CHECK(AsyncReadback::GetSlotIndex(0, 3) == 0);
+	CHECK(AsyncReadback::GetSlotIndex(2, 3) == 2);
+	CHECK(AsyncReadback::GetSlotIndex(3, 3) == 0);
+	CHECK(AsyncReadback::GetSlotIndex(7, 1) == 0);
+
+	// The slot was delivered by Poll, or never used
+	CHECK(AsyncReadback::GetSlotReuse(false, false) == SlotReuse::Free);
+
+	// The GPU is still working on the frame that used the slot: stall
+	CHECK(AsyncReadback::GetSlotReuse(true, true) == SlotReuse::Wait);
+
+	// EndFrame was skipped for that frame
+	CHECK(AsyncReadback::GetSlotReuse(true, false) == SlotReuse::SubmitAndWait);
+}
+
+void test_stalls()
+{
+	// Simulate the frames of a GPU that finishes each frame `latency` frames after it was submitted,
+	// with one request per frame and Poll delivering the finished frames at the start of each frame
+	auto countStalls = [](uint32_t numSlots, uint32_t latency)
+	{
+		struct Slot
+		{
+			bool hasRequests = false;
+			bool submitted = false;
+			uint32_t frame = 0;
+		};
+
+		std::vector<Slot> slots(numSlots);
+		uint32_t stalls = 0;
+
+		for (uint32_t frame = 0; frame < 100; frame++)
+		{
+			for (Slot& slot : slots)
+			{
+				if (slot.submitted && slot.frame + latency <= frame)
+					slot = Slot();
+			}
+
+			Slot& slot = slots[AsyncReadback::GetSlotIndex(frame, numSlots)];
+			if (AsyncReadback::GetSlotReuse(slot.hasRequests, slot.submitted) != SlotReuse::Free)
+			{
+				++stalls;
+				slot = Slot();
+			}
+
+			slot.hasRequests = true;
+			slot.submitted = true;
+			slot.frame = frame;
+		}
+
+		return stalls;
+	};
+
+	// A GPU that finishes each frame up to three frames later never stalls with three slots, but with fewer slots,
+	// every frame waits once the ring is full
+	CHECK(countStalls(3, 2) == 0);
+	CHECK(countStalls(3, 3) == 0);
+	CHECK(countStalls(2, 3) == 98);
+	CHECK(countStalls(1, 1) == 0);
+	CHECK(countStalls(1, 2) == 99);
+}
+
+void test_buffer_pool()
+{
+	std::vector<AsyncReadback::FreeBuffer> buffers;
+	CHECK(AsyncReadback::FindFreeBuffer(buffers, 16) == -1);
+
+	for (uint64_t byteSize : { 256, 64, 1024, 64 })
+		buffers.push_back({ nvrhi::BufferHandle::Create(new TestBuffer(byteSize)), 0 });
+
+	// The smallest buffer that fits, the first one of equal size
+	CHECK(AsyncReadback::FindFreeBuffer(buffers, 16) == 1);
+	CHECK(AsyncReadback::FindFreeBuffer(buffers, 64) == 1);
+	CHECK(AsyncReadback::FindFreeBuffer(buffers, 65) == 0);
+	CHECK(AsyncReadback::FindFreeBuffer(buffers, 1000) == 2);
+	CHECK(AsyncReadback::FindFreeBuffer(buffers, 1025) == -1);
+}
+
+void test_texture_pool()
+{
+	std::vector<AsyncReadback::FreeTexture> textures;
+	nvrhi::TextureDesc desc;
+	desc.width = 128;
+	desc.height = 64;
+	desc.format = nvrhi::Format::RGBA8_UNORM;
+	CHECK(AsyncReadback::FindFreeTexture(textures, desc) == -1);
+
+	textures.push_back({ nvrhi::StagingTextureHandle::Create(new TestStagingTexture(64, 128, nvrhi::Format::RGBA8_UNORM)), 0 });
+	textures.push_back({ nvrhi::StagingTextureHandle::Create(new TestStagingTexture(128, 64, nvrhi::Format::R32_FLOAT)), 0 });
+	textures.push_back({ nvrhi::StagingTextureHandle::Create(new TestStagingTexture(256, 256, nvrhi::Format::RGBA8_UNORM)), 0 });
+	CHECK(AsyncReadback::FindFreeTexture(textures, desc) == -1);
+
+	// Only an exact match is reused, larger textures are not
+	textures.push_back({ nvrhi::StagingTextureHandle::Create(new TestStagingTexture(128, 64, nvrhi::Format::RGBA8_UNORM)), 0 });
+	CHECK(AsyncReadback::FindFreeTexture(textures, desc) == 3);
+
+	desc.format = nvrhi::Format::R32_FLOAT;
+	CHECK(AsyncReadback::FindFreeTexture(textures, desc) == 1);
+}
+
+void test_release_unused()
+{
+	// Three frames in flight: resources last used 4 or more frames ago are released
+	std::vector<AsyncReadback::FreeTexture> textures;
+	for (uint32_t lastUsedFrame : { 10, 6, 7, 9 })
+		textures.push_back({ nvrhi::StagingTextureHandle::Create(new TestStagingTexture(64, 64, nvrhi::Format::RGBA8_UNORM)), lastUsedFrame });
+
+	CHECK(AsyncReadback::ReleaseUnused(textures, 10, 3) == 1);
+	CHECK(textures.size() == 3);
+	CHECK(textures[0].lastUsedFrame == 10);
+	CHECK(textures[1].lastUsedFrame == 7);
+	CHECK(textures[2].lastUsedFrame == 9);
+
+	CHECK(AsyncReadback::ReleaseUnused(textures, 10, 3) == 0);
+	CHECK(AsyncReadback::ReleaseUnused(textures, 13, 3) == 2);
+	CHECK(textures.size() == 1);
+
+	// The frame index may wrap around
+	std::vector<AsyncReadback::FreeBuffer> buffers;
+	buffers.push_back({ nvrhi::BufferHandle::Create(new TestBuffer(64)), 0xfffffffe });
+	CHECK(AsyncReadback::ReleaseUnused(buffers, 1, 3) == 0);
+	CHECK(AsyncReadback::ReleaseUnused(buffers, 2, 3) == 1);
+	CHECK(buffers.empty());
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_slots();
+		test_stalls();
+		test_buffer_pool();
+		test_texture_pool();
+		test_release_unused();
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
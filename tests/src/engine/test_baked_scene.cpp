@@ -0,0 +1,410 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/BakedScene.h>
+#include <donut/engine/GltfImporter.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/SceneTypes.h>
+#include <donut/engine/TextureCache.h>
+#include <donut/core/chunk/chunkFile.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/tests/utils.h>
+
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+// Writes a glTF file with a single grid mesh of (size x size) quads, a camera and a light
+static void writeGridModel(vfs::IFileSystem& fs, const std::filesystem::path& fileName, int size)
+{
+	const int verticesPerRow = size + 1;
+	const int vertexCount = verticesPerRow * verticesPerRow;
+	const int indexCount = size * size * 6;
+
+	std::vector<float3> positions;
+	std::vector<float3> normals;
+	std::vector<float2> texcoords;
+	std::vector<uint32_t> indices;
+
+	for (int y = 0; y < verticesPerRow; ++y)
+	{
+		for (int x = 0; x < verticesPerRow; ++x)
+		{
+			float2 uv = float2(float(x), float(y)) / float(size);
+			positions.push_back(float3(uv.x, 0.f, uv.y));
+			normals.push_back(normalize(float3(uv.x - 0.5f, 1.f, uv.y - 0.5f)));
+			texcoords.push_back(uv);
+		}
+	}
+
+	for (int y = 0; y < size; ++y)
+	{
+		for (int x = 0; x < size; ++x)
+		{
+			uint32_t i = uint32_t(y * verticesPerRow + x);
+			indices.insert(indices.end(), { i, i + verticesPerRow, i + 1, i + 1, i + verticesPerRow, i + verticesPerRow + 1 });
+		}
+	}
+
+	const size_t positionsSize = positions.size() * sizeof(float3);
+	const size_t normalsSize = normals.size() * sizeof(float3);
+	const size_t texcoordsSize = texcoords.size() * sizeof(float2);
+	const size_t indicesSize = indices.size() * sizeof(uint32_t);
+
+	std::vector<uint8_t> buffer;
+	auto append = [&buffer](const void* data, size_t size)
+	{
+		buffer.insert(buffer.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+	};
+	append(positions.data(), positionsSize);
+	append(normals.data(), normalsSize);
+	append(texcoords.data(), texcoordsSize);
+	append(indices.data(), indicesSize);
+
+	const std::filesystem::path bufferName = fileName.stem().string() + ".bin";
+	CHECK(fs.writeFile(fileName.parent_path() / bufferName, buffer.data(), buffer.size()));
+
+	std::stringstream ss;
+	ss << R"({ "asset": { "version": "2.0" }, "scene": 0, "scenes": [ { "nodes": [ 0, 1, 2 ] } ],)";
+	ss << R"("nodes": [ { "name": "Grid", "mesh": 0, "translation": [ 1, 2, 3 ] },)";
+	ss << R"({ "name": "Camera", "camera": 0, "rotation": [ 0, 0.7071068, 0, 0.7071068 ] },)";
+	ss << R"({ "name": "Sun", "extensions": { "KHR_lights_punctual": { "light": 0 } } } ],)";
+	ss << R"("extensionsUsed": [ "KHR_lights_punctual" ],)";
+	ss << R"("extensions": { "KHR_lights_punctual": { "lights": [ { "type": "directional", "color": [ 1, 0.5, 0.25 ], "intensity": 3 } ] } },)";
+	ss << R"("cameras": [ { "type": "perspective", "perspective": { "yfov": 0.8, "znear": 0.1 } } ],)";
+	ss << R"("materials": [ { "name": "Ground", "pbrMetallicRoughness": { "baseColorFactor": [ 0.5, 0.6, 0.7, 1 ], "roughnessFactor": 0.3 } } ],)";
+	ss << R"("meshes": [ { "name": "Grid", "primitives": [ { "attributes": { "POSITION": 0, "NORMAL": 1, "TEXCOORD_0": 2 }, "indices": 3, "material": 0 } ] } ],)";
+	ss << R"("buffers": [ { "uri": ")" << bufferName.generic_string() << R"(", "byteLength": )" << buffer.size() << " } ],";
+	ss << R"("bufferViews": [)";
+	ss << R"({ "buffer": 0, "byteOffset": 0, "byteLength": )" << positionsSize << " },";
+	ss << R"({ "buffer": 0, "byteOffset": )" << positionsSize << R"(, "byteLength": )" << normalsSize << " },";
+	ss << R"({ "buffer": 0, "byteOffset": )" << positionsSize + normalsSize << R"(, "byteLength": )" << texcoordsSize << " },";
+	ss << R"({ "buffer": 0, "byteOffset": )" << positionsSize + normalsSize + texcoordsSize << R"(, "byteLength": )" << indicesSize << " } ],";
+	ss << R"("accessors": [)";
+	ss << R"({ "bufferView": 0, "componentType": 5126, "count": )" << vertexCount << R"(, "type": "VEC3", "min": [ 0, 0, 0 ], "max": [ 1, 0, 1 ] },)";
+	ss << R"({ "bufferView": 1, "componentType": 5126, "count": )" << vertexCount << R"(, "type": "VEC3" },)";
+	ss << R"({ "bufferView": 2, "componentType": 5126, "count": )" << vertexCount << R"(, "type": "VEC2" },)";
+	ss << R"({ "bufferView": 3, "componentType": 5125, "count": )" << indexCount << R"(, "type": "SCALAR" } ] })";
+
+	const std::string json = ss.str();
+	CHECK(fs.writeFile(fileName, json.data(), json.size()));
+}
+
+static std::shared_ptr<MeshInfo> findMesh(const std::shared_ptr<SceneGraphNode>& root)
+{
+	for (SceneGraphWalker walker(root.get()); walker; walker.Next(true))
+	{
+		if (auto meshInstance = std::dynamic_pointer_cast<MeshInstance>(walker->GetLeaf()))
+			return meshInstance->GetMesh();
+	}
+	return nullptr;
+}
+
+template<typename T>
+static bool compareStream(const std::vector<T>& expected, const void* data, const nvrhi::BufferRange& range)
+{
+	if (expected.empty() || !data || range.byteSize < expected.size() * sizeof(T))
+		return false;
+
+	return memcmp(expected.data(), data, expected.size() * sizeof(T)) == 0;
+}
+
+void test_baked_scene()
+{
+	auto fs = std::make_shared<vfs::NativeFileSystem>();
+	auto sceneTypeFactory = std::make_shared<SceneTypeFactory>();
+	TextureCache textureCache(nullptr, fs, nullptr);
+	SceneLoadingStats stats;
+
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "donut_test_baked_scene";
+	std::filesystem::create_directories(directory);
+	const std::filesystem::path gltfFileName = directory / "grid.gltf";
+	const std::filesystem::path bakedFileName = directory / (std::string("grid") + c_BakedSceneExtension);
+
+	writeGridModel(*fs, gltfFileName, 512);
+
+	CHECK(!IsBakedSceneFile(gltfFileName));
+	CHECK(IsBakedSceneFile(bakedFileName));
+
+	using clock = std::chrono::high_resolution_clock;
+
+	GltfImporter importer(fs, sceneTypeFactory);
+	SceneImportResult gltfResult;
+	auto gltfStart = clock::now();
+	CHECK(importer.Load(gltfFileName, textureCache, stats, nullptr, gltfResult));
+	auto gltfEnd = clock::now();
+
+	CHECK(BakeScene(*fs, bakedFileName, gltfResult));
+
+	BakedSceneLoader loader(fs, sceneTypeFactory);
+	SceneImportResult bakedResult;
+	auto bakedStart = clock::now();
+	CHECK(loader.Load(bakedFileName, textureCache, stats, nullptr, bakedResult));
+	auto bakedEnd = clock::now();
+
+	// The mesh data is referenced from the mapped file in the GPU layout, not copied into the vectors
+	auto gltfMesh = findMesh(gltfResult.rootNode);
+	auto bakedMesh = findMesh(bakedResult.rootNode);
+	CHECK(gltfMesh && bakedMesh);
+	CHECK(bakedMesh->totalIndices == gltfMesh->totalIndices);
+	CHECK(bakedMesh->totalVertices == gltfMesh->totalVertices);
+	CHECK(bakedMesh->geometries.size() == 1);
+	CHECK(bakedMesh->geometries[0]->material->name == "Ground");
+	CHECK(all(bakedMesh->geometries[0]->material->baseOrDiffuseColor == float3(0.5f, 0.6f, 0.7f)));
+
+	const BufferGroup& gltfBuffers = *gltfMesh->buffers;
+	const BufferGroup& bakedBuffers = *bakedMesh->buffers;
+	CHECK(bakedBuffers.indexData.empty() && bakedBuffers.positionData.empty());
+	CHECK(bakedBuffers.dataBlob != nullptr);
+	CHECK(bakedBuffers.indexCount == gltfBuffers.indexData.size());
+	CHECK(memcmp(bakedBuffers.indexDataView, gltfBuffers.indexData.data(), gltfBuffers.indexData.size() * sizeof(uint32_t)) == 0);
+	CHECK(compareStream(gltfBuffers.positionData,
+		bakedBuffers.vertexDataViews[size_t(VertexAttribute::Position)], bakedBuffers.getVertexBufferRange(VertexAttribute::Position)));
+	CHECK(compareStream(gltfBuffers.normalData,
+		bakedBuffers.vertexDataViews[size_t(VertexAttribute::Normal)], bakedBuffers.getVertexBufferRange(VertexAttribute::Normal)));
+	CHECK(compareStream(gltfBuffers.texcoord1Data,
+		bakedBuffers.vertexDataViews[size_t(VertexAttribute::TexCoord1)], bakedBuffers.getVertexBufferRange(VertexAttribute::TexCoord1)));
+
+	// Nodes, in the same order as the importer produced them
+	std::vector<std::shared_ptr<SceneGraphLeaf>> gltfLeaves, bakedLeaves;
+	std::vector<std::string> gltfNames, bakedNames;
+	std::vector<double3> gltfTranslations, bakedTranslations;
+	for (SceneGraphWalker walker(gltfResult.rootNode.get()); walker; walker.Next(true))
+	{
+		gltfNames.push_back(walker->GetName());
+		gltfTranslations.push_back(walker->GetTranslation());
+		gltfLeaves.push_back(walker->GetLeaf());
+	}
+	for (SceneGraphWalker walker(bakedResult.rootNode.get()); walker; walker.Next(true))
+	{
+		bakedNames.push_back(walker->GetName());
+		bakedTranslations.push_back(walker->GetTranslation());
+		bakedLeaves.push_back(walker->GetLeaf());
+	}
+	CHECK(gltfNames == bakedNames);
+	CHECK(gltfTranslations.size() == bakedTranslations.size());
+	for (size_t i = 0; i < gltfTranslations.size(); ++i)
+		CHECK(all(gltfTranslations[i] == bakedTranslations[i]));
+
+	bool foundCamera = false, foundLight = false;
+	for (const auto& leaf : bakedLeaves)
+	{
+		if (auto camera = std::dynamic_pointer_cast<PerspectiveCamera>(leaf))
+		{
+			CHECK(camera->verticalFov == 0.8f && camera->zNear == 0.1f && !camera->zFar.has_value());
+			foundCamera = true;
+		}
+		if (auto light = std::dynamic_pointer_cast<DirectionalLight>(leaf))
+		{
+			CHECK(all(light->color == float3(1.f, 0.5f, 0.25f)) && light->irradiance == 3.f);
+			foundLight = true;
+		}
+	}
+	CHECK(foundCamera && foundLight);
+
+	printf("glTF import: %.1f ms, baked scene load: %.1f ms\n",
+		std::chrono::duration<double, std::milli>(gltfEnd - gltfStart).count(),
+		std::chrono::duration<double, std::milli>(bakedEnd - bakedStart).count());
+
+	bakedResult.rootNode.reset();
+	bakedMesh.reset();
+	std::filesystem::remove_all(directory);
+}
+
+// Builds a model with a quad, a light and an animation without going through an importer
+static SceneImportResult makeQuadModel(SceneTypeFactory& factory)
+{
+	auto buffers = std::make_shared<BufferGroup>();
+	buffers->indexData = { 0, 1, 2, 2, 1, 3 };
+	buffers->positionData = { float3(0.f, 0.f, 0.f), float3(1.f, 0.f, 0.f), float3(0.f, 1.f, 0.f), float3(1.f, 1.f, 0.f) };
+
+	auto geometry = factory.CreateMeshGeometry();
+	geometry->material = factory.CreateMaterial();
+	geometry->material->name = "Quad";
+	geometry->numIndices = 6;
+	geometry->numVertices = 4;
+
+	auto mesh = factory.CreateMesh();
+	mesh->name = "Quad";
+	mesh->buffers = buffers;
+	mesh->totalIndices = 6;
+	mesh->totalVertices = 4;
+	mesh->geometries.push_back(geometry);
+
+	auto graph = std::make_shared<SceneGraph>();
+	auto root = std::make_shared<SceneGraphNode>();
+	root->SetName("Root");
+	graph->SetRootNode(root);
+
+	// A translation that is not representable in single precision
+	auto quadNode = graph->Attach(root, std::make_shared<SceneGraphNode>());
+	quadNode->SetName("Quad");
+	quadNode->SetTranslation(double3(1.0e8 + 0.125, -2.0e7 - 0.0625, 3.0));
+	quadNode->SetLeaf(factory.CreateMeshInstance(mesh));
+
+	auto sunNode = graph->Attach(root, std::make_shared<SceneGraphNode>());
+	sunNode->SetName("Sun");
+	sunNode->SetLeaf(factory.CreateLeaf("DirectionalLight"));
+
+	auto sampler = std::make_shared<animation::Sampler>();
+	sampler->SetInterpolationMode(animation::InterpolationMode::Linear);
+	sampler->AddKeyframe({ 0.f, float4(0.f) });
+	sampler->AddKeyframe({ 1.f, float4(1.f, 2.f, 3.f, 0.f) });
+
+	auto animation = std::make_shared<SceneGraphAnimation>();
+	animation->AddChannel(std::make_shared<SceneGraphAnimationChannel>(sampler, quadNode, AnimationAttribute::Translation));
+	auto animationNode = graph->Attach(root, std::make_shared<SceneGraphNode>());
+	animationNode->SetName("Move");
+	animationNode->SetLeaf(animation);
+
+	SceneImportResult result;
+	result.rootNode = root;
+	return result;
+}
+
+static std::shared_ptr<SceneGraphNode> findNode(const std::shared_ptr<SceneGraphNode>& root, const std::string& name)
+{
+	for (SceneGraphWalker walker(root.get()); walker; walker.Next(true))
+	{
+		if (walker->GetName() == name)
+			return walker->shared_from_this();
+	}
+	return nullptr;
+}
+
+// Creates the lights as point lights, so that they don't match the leaf types stored in the file
+class MismatchedLightFactory : public SceneTypeFactory
+{
+public:
+	std::shared_ptr<SceneGraphLeaf> CreateLeaf(const std::string& type) override
+	{
+		return SceneTypeFactory::CreateLeaf(type == "DirectionalLight" ? "PointLight" : type);
+	}
+};
+
+void test_baked_scene_invalid()
+{
+	auto fs = std::make_shared<vfs::NativeFileSystem>();
+	auto sceneTypeFactory = std::make_shared<SceneTypeFactory>();
+	TextureCache textureCache(nullptr, fs, nullptr);
+	SceneLoadingStats stats;
+	BakedSceneLoader loader(fs, sceneTypeFactory);
+
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "donut_test_baked_scene_invalid";
+	std::filesystem::create_directories(directory);
+	const std::filesystem::path fileName = directory / (std::string("quad") + c_BakedSceneExtension);
+	const std::filesystem::path patchedFileName = directory / (std::string("patched") + c_BakedSceneExtension);
+
+	// Not a chunk file
+	const char garbage[] = "this is not a chunk file";
+	CHECK(fs->writeFile(patchedFileName, garbage, sizeof(garbage)));
+	SceneImportResult result;
+	CHECK(!loader.Load(patchedFileName, textureCache, stats, nullptr, result));
+	CHECK(!result.rootNode);
+
+	// The valid file round-trips the double precision transforms, the light and the animation
+	CHECK(BakeScene(*fs, fileName, makeQuadModel(*sceneTypeFactory)));
+	CHECK(loader.Load(fileName, textureCache, stats, nullptr, result));
+	auto quadNode = findNode(result.rootNode, "Quad");
+	CHECK(quadNode && all(quadNode->GetTranslation() == double3(1.0e8 + 0.125, -2.0e7 - 0.0625, 3.0)));
+	auto sunNode = findNode(result.rootNode, "Sun");
+	CHECK(sunNode && std::dynamic_pointer_cast<DirectionalLight>(sunNode->GetLeaf()));
+	auto animationNode = findNode(result.rootNode, "Move");
+	CHECK(animationNode && std::dynamic_pointer_cast<SceneGraphAnimation>(animationNode->GetLeaf()));
+
+	// Lights that the factory doesn't create with the expected type are dropped
+	BakedSceneLoader mismatchedLoader(fs, std::make_shared<MismatchedLightFactory>());
+	CHECK(mismatchedLoader.Load(fileName, textureCache, stats, nullptr, result));
+	sunNode = findNode(result.rootNode, "Sun");
+	CHECK(sunNode && !sunNode->GetLeaf());
+
+	std::shared_ptr<vfs::IBlob> blob = fs->readFile(fileName);
+	CHECK(blob);
+	const std::vector<uint8_t> original(static_cast<const uint8_t*>(blob->data()), static_cast<const uint8_t*>(blob->data()) + blob->size());
+
+	// Overwrites a field of the first record of an array chunk, see the record layouts in BakedScene.cpp
+	auto loadPatched = [&](uint32_t chunkType, size_t fieldOffset, uint32_t value)
+	{
+		auto cfile = chunk::ChunkFile::deserialize(blob, fileName.generic_string().c_str());
+		CHECK(cfile);
+		std::vector<const chunk::Chunk*> chunks;
+		cfile->getChunks(chunkType, chunks);
+		CHECK(chunks.size() == 1);
+
+		// Skip the record count
+		const size_t offset = static_cast<const uint8_t*>(chunks[0]->data) - static_cast<const uint8_t*>(blob->data()) + sizeof(uint32_t) + fieldOffset;
+		std::vector<uint8_t> patched = original;
+		memcpy(patched.data() + offset, &value, sizeof(value));
+		CHECK(fs->writeFile(patchedFileName, patched.data(), patched.size()));
+
+		SceneImportResult patchedResult;
+		const bool loaded = loader.Load(patchedFileName, textureCache, stats, nullptr, patchedResult);
+		CHECK(loaded == bool(patchedResult.rootNode));
+		return loaded;
+	};
+
+	constexpr uint32_t meshesChunk = 0x1004;
+	constexpr uint32_t geometriesChunk = 0x1005;
+	constexpr uint32_t channelsChunk = 0x1008;
+
+	// BakedMesh: name, bufferGroup, type, indexOffset, vertexOffset, totalIndices, totalVertices
+	CHECK(loadPatched(meshesChunk, 20, 6));
+	CHECK(!loadPatched(meshesChunk, 12, 1));
+	CHECK(!loadPatched(meshesChunk, 16, 1));
+	CHECK(!loadPatched(meshesChunk, 20, 7));
+	CHECK(!loadPatched(meshesChunk, 24, 5));
+
+	// BakedGeometry: material, type, indexOffsetInMesh, vertexOffsetInMesh, numIndices, numVertices
+	CHECK(!loadPatched(geometriesChunk, 8, 1));
+	CHECK(!loadPatched(geometriesChunk, 16, 7));
+	CHECK(!loadPatched(geometriesChunk, 20, 5));
+
+	// BakedChannel: node, attribute, mode
+	CHECK(loadPatched(channelsChunk, 8, uint32_t(animation::InterpolationMode::HermiteSpline)));
+	CHECK(!loadPatched(channelsChunk, 8, uint32_t(animation::InterpolationMode::HermiteSpline) + 1));
+	CHECK(!loadPatched(channelsChunk, 4, uint32_t(AnimationAttribute::Undefined)));
+	CHECK(!loadPatched(channelsChunk, 4, uint32_t(AnimationAttribute::LeafProperty)));
+	CHECK(!loadPatched(channelsChunk, 4, 0x100));
+	CHECK(!loadPatched(channelsChunk, 0, 100));
+
+	result.rootNode.reset();
+	std::filesystem::remove_all(directory);
+}
+
+int main(int, char** argv)
+{
+	try
+	{
+		test_baked_scene();
+		test_baked_scene_invalid();
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
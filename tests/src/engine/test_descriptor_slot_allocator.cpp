@@ -0,0 +1,138 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/DescriptorTableManager.h>
+#include <donut/tests/utils.h>
+
+#include <set>
+
+using namespace donut;
+using namespace donut::engine;
+
+void test_slot_allocation_order()
+{
+	DescriptorSlotAllocator allocator;
+	CHECK(allocator.Allocate() == -1);
+
+	allocator.Grow(130);
+	CHECK(allocator.GetCapacity() == 130);
+
+	// Slots are allocated in order across the word boundaries
+	for (DescriptorIndex index = 0; index < 130; ++index)
+		CHECK(allocator.Allocate() == index);
+
+	CHECK(allocator.GetAllocatedCount() == 130);
+
+	// Slots past the capacity in the last word are never returned
+	CHECK(allocator.Allocate() == -1);
+
+	// The lowest released slot is reused first
+	CHECK(allocator.Release(100));
+	CHECK(allocator.Release(5));
+	CHECK(allocator.Release(64));
+	CHECK(allocator.GetAllocatedCount() == 127);
+	CHECK(allocator.Allocate() == 5);
+	CHECK(allocator.Allocate() == 64);
+	CHECK(allocator.Allocate() == 100);
+	CHECK(allocator.Allocate() == -1);
+
+	// Growing makes the new slots available, including the rest of the last word
+	allocator.Grow(200);
+	CHECK(allocator.Allocate() == 130);
+	allocator.Grow(150);
+	CHECK(allocator.GetCapacity() == 200);
+}
+
+void test_slot_release()
+{
+	DescriptorSlotAllocator allocator;
+	allocator.Grow(64);
+
+	CHECK(allocator.Allocate() == 0);
+	CHECK(allocator.Allocate() == 1);
+	CHECK(allocator.IsAllocated(1));
+
+	// Releasing a slot twice, a free slot or an out-of-range slot has no effect
+	CHECK(allocator.Release(1));
+	CHECK(!allocator.IsAllocated(1));
+	CHECK(!allocator.Release(1));
+	CHECK(!allocator.Release(2));
+	CHECK(!allocator.Release(-1));
+	CHECK(!allocator.Release(64));
+	CHECK(!allocator.Release(1000));
+	CHECK(allocator.GetAllocatedCount() == 1);
+
+	CHECK(allocator.Release(0));
+	CHECK(allocator.GetAllocatedCount() == 0);
+	CHECK(!allocator.Release(0));
+	CHECK(allocator.GetAllocatedCount() == 0);
+}
+
+// Random allocations and releases always return the lowest free slot
+void test_slot_allocation_random()
+{
+	DescriptorSlotAllocator allocator;
+	allocator.Grow(300);
+
+	std::set<DescriptorIndex> freeSlots;
+	for (DescriptorIndex index = 0; index < 300; ++index)
+		freeSlots.insert(index);
+
+	uint32_t state = 12345;
+	for (int step = 0; step < 10000; ++step)
+	{
+		state = state * 1664525u + 1013904223u;
+		const DescriptorIndex slot = DescriptorIndex((state >> 8) % 300);
+
+		if ((state >> 4) & 1)
+		{
+			const DescriptorIndex expected = freeSlots.empty() ? -1 : *freeSlots.begin();
+			CHECK(allocator.Allocate() == expected);
+			if (expected >= 0)
+				freeSlots.erase(expected);
+		}
+		else
+		{
+			const bool allocated = freeSlots.count(slot) == 0;
+			CHECK(allocator.Release(slot) == allocated);
+			freeSlots.insert(slot);
+		}
+
+		CHECK(allocator.GetAllocatedCount() == 300 - freeSlots.size());
+	}
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_slot_allocation_order();
+		test_slot_release();
+		test_slot_allocation_random();
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
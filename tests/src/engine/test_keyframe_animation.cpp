@@ -0,0 +1,239 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/KeyframeAnimation.h>
+#include <donut/tests/utils.h>
+
+#include <cstdlib>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+static animation::Sampler makeSampler(animation::InterpolationMode mode, int keyframeCount)
+{
+	animation::Sampler sampler;
+	sampler.SetInterpolationMode(mode);
+
+	float time = 0.f;
+	for (int i = 0; i < keyframeCount; ++i)
+	{
+		animation::Keyframe keyframe;
+		keyframe.time = time;
+		keyframe.value = float4(sinf(time), cosf(time * 0.5f), time, 1.f);
+		if (mode == animation::InterpolationMode::Slerp)
+			keyframe.value = normalize(keyframe.value);
+		keyframe.inTangent = float4(cosf(time), 0.f, 1.f, 0.f);
+		keyframe.outTangent = float4(cosf(time), 0.f, 1.f, 0.f);
+		sampler.AddKeyframe(keyframe);
+
+		// Uneven spacing to make the keyframe search non-trivial
+		time += 0.1f + 0.05f * float(i % 3);
+	}
+
+	return sampler;
+}
+
+static bool sameResult(const std::optional<float4>& a, const std::optional<float4>& b)
+{
+	if (a.has_value() != b.has_value())
+		return false;
+
+	return !a.has_value() || all(a.value() == b.value());
+}
+
+void test_compiled_sampler()
+{
+	const animation::InterpolationMode modes[] = {
+		animation::InterpolationMode::Step,
+		animation::InterpolationMode::Linear,
+		animation::InterpolationMode::Slerp,
+		animation::InterpolationMode::CatmullRomSpline,
+		animation::InterpolationMode::HermiteSpline
+	};
+
+	for (animation::InterpolationMode mode : modes)
+	{
+		animation::Sampler sampler = makeSampler(mode, 50);
+		animation::CompiledSampler compiled(sampler);
+		CHECK(compiled.GetKeyframeCount() == 50);
+		CHECK(compiled.GetStartTime() == sampler.GetStartTime());
+		CHECK(compiled.GetEndTime() == sampler.GetEndTime());
+
+		// Sequential playback, including the time before the first and after the last keyframe
+		uint32_t cursor = 0;
+		for (float time = -0.5f; time < sampler.GetEndTime() + 0.5f; time += 0.01f)
+		{
+			CHECK(sameResult(compiled.Evaluate(time, cursor, true), sampler.Evaluate(time, true)));
+			CHECK(sameResult(compiled.Evaluate(time, cursor, false), sampler.Evaluate(time, false)));
+		}
+
+		// Reverse playback and random seeks, which cannot use the forward steps from the cursor
+		for (float time = sampler.GetEndTime(); time > 0.f; time -= 0.03f)
+			CHECK(sameResult(compiled.Evaluate(time, cursor, true), sampler.Evaluate(time, true)));
+
+		std::srand(1);
+		for (int i = 0; i < 1000; ++i)
+		{
+			float time = sampler.GetEndTime() * float(std::rand()) / float(RAND_MAX);
+			CHECK(sameResult(compiled.Evaluate(time, cursor, true), sampler.Evaluate(time, true)));
+		}
+	}
+
+	// Degenerate samplers
+	animation::CompiledSampler empty;
+	uint32_t cursor = 0;
+	CHECK(!empty.Evaluate(1.f, cursor, true).has_value());
+
+	animation::CompiledSampler single(makeSampler(animation::InterpolationMode::Linear, 1));
+	CHECK(single.Evaluate(1.f, cursor, true).has_value());
+	CHECK(!single.Evaluate(1.f, cursor, false).has_value());
+}
+
+// Simulates a baked mocap track: one key per frame at 30 fps
+static animation::Sampler makeBakedSampler(animation::InterpolationMode mode, int keyframeCount)
+{
+	animation::Sampler sampler;
+	sampler.SetInterpolationMode(mode);
+
+	for (int i = 0; i < keyframeCount; ++i)
+	{
+		animation::Keyframe keyframe;
+		keyframe.time = float(i) / 30.f;
+
+		// Alternate between smooth motion and holds, which is where key reduction pays off
+		float t = ((i / 60) % 2) ? float(i / 60 * 60) / 30.f : keyframe.time;
+
+		if (mode == animation::InterpolationMode::Slerp)
+		{
+			float3 axis = normalize(float3(sinf(t), 1.f, cosf(t * 0.3f)));
+			float angle = t * 0.7f;
+			keyframe.value = float4(axis * sinf(angle * 0.5f), cosf(angle * 0.5f));
+		}
+		else
+		{
+			keyframe.value = float4(sinf(t) * 2.f, t * 0.5f, 1.f, 0.f);
+		}
+
+		sampler.AddKeyframe(keyframe);
+	}
+
+	return sampler;
+}
+
+static float maxError(const animation::Sampler& reference, const animation::Sampler& compressed, bool rotation)
+{
+	float result = 0.f;
+	for (float time = reference.GetStartTime(); time < reference.GetEndTime(); time += 0.01f)
+	{
+		float4 a = reference.Evaluate(time, true).value();
+		float4 b = compressed.Evaluate(time, true).value();
+		float4 diff = abs(a - b);
+		if (rotation)
+			diff = min(diff, abs(a + b));
+		result = std::max(result, std::max(std::max(diff.x, diff.y), std::max(diff.z, diff.w)));
+	}
+	return result;
+}
+
+void test_animation_compression()
+{
+	animation::CompressionSettings settings;
+	settings.valueTolerance = 1e-3f;
+	settings.rotationTolerance = 1e-4f;
+
+	auto translation = std::make_shared<animation::Sampler>(makeBakedSampler(animation::InterpolationMode::Linear, 3000));
+	auto rotation = std::make_shared<animation::Sampler>(makeBakedSampler(animation::InterpolationMode::Slerp, 3000));
+
+	auto compressedTranslation = animation::CompressSampler(translation, settings);
+	auto compressedRotation = animation::CompressSampler(rotation, settings);
+	CHECK(dynamic_cast<animation::CompressedSampler*>(compressedTranslation.get()) != nullptr);
+	CHECK(dynamic_cast<animation::CompressedSampler*>(compressedRotation.get()) != nullptr);
+
+	CHECK(compressedTranslation->GetStartTime() == translation->GetStartTime());
+	CHECK(compressedTranslation->GetEndTime() == translation->GetEndTime());
+
+	// Error: the tolerance covers both the key reduction and the quantization
+	CHECK(maxError(*translation, *compressedTranslation, false) <= settings.valueTolerance);
+	CHECK(maxError(*rotation, *compressedRotation, true) <= settings.rotationTolerance);
+
+	// Memory: at least 8x smaller than the uncompressed keyframes
+	CHECK(compressedTranslation->GetDataSize() * 8 < translation->GetDataSize());
+	CHECK(compressedRotation->GetDataSize() * 8 < rotation->GetDataSize());
+
+	// Constant tracks keep only the first and last keys and no per-key values
+	animation::Sampler constant;
+	constant.SetInterpolationMode(animation::InterpolationMode::Linear);
+	for (int i = 0; i < 100; ++i)
+		constant.AddKeyframe(animation::Keyframe{ float(i), float4(1.f, 2.f, 3.f, 0.f) });
+	animation::CompressedSampler compressedConstant(constant, settings);
+	CHECK(compressedConstant.GetKeyframeCount() == 2);
+	CHECK(all(compressedConstant.Evaluate(50.f, true).value() == float4(1.f, 2.f, 3.f, 0.f)));
+
+	// A tolerance below the quantization step keeps the values in floats
+	animation::CompressionSettings strictSettings;
+	strictSettings.valueTolerance = 1e-6f;
+	animation::CompressedSampler strictTranslation(*translation, strictSettings);
+	CHECK(maxError(*translation, strictTranslation, false) <= strictSettings.valueTolerance);
+	CHECK(strictTranslation.GetDataSize() > compressedTranslation->GetDataSize());
+
+	// The keyframe accessors work through the base class
+	const animation::Sampler& compressedBase = *compressedTranslation;
+	const std::vector<animation::Keyframe> keyframes = compressedBase.CopyKeyframes();
+	CHECK(compressedBase.GetKeyframeCount() == keyframes.size());
+	CHECK(keyframes.size() > 2 && keyframes.size() < translation->GetKeyframeCount());
+	CHECK(keyframes.front().time == translation->GetStartTime());
+	CHECK(keyframes.back().time == translation->GetEndTime());
+
+	// Adding a keyframe converts the sampler to the uncompressed form without changing the existing keyframes
+	const float4 midValue = compressedTranslation->Evaluate(1.f, true).value();
+	compressedTranslation->AddKeyframe(animation::Keyframe{ translation->GetEndTime() + 1.f, float4(5.f) });
+	CHECK(compressedTranslation->GetKeyframeCount() == keyframes.size() + 1);
+	CHECK(compressedTranslation->GetEndTime() == translation->GetEndTime() + 1.f);
+	CHECK(all(compressedTranslation->Evaluate(1.f, true).value() == midValue));
+	CHECK(compressedTranslation->GetDataSize() == (keyframes.size() + 1) * sizeof(animation::Keyframe));
+
+	// Splines are not compressed
+	auto spline = std::make_shared<animation::Sampler>(makeSampler(animation::InterpolationMode::HermiteSpline, 10));
+	CHECK(animation::CompressSampler(spline, settings) == spline);
+
+	// Compiled samplers can be built from compressed ones
+	animation::CompiledSampler compiled(*compressedRotation);
+	uint32_t cursor = 0;
+	for (float time = 0.f; time < rotation->GetEndTime(); time += 0.05f)
+		CHECK(sameResult(compiled.Evaluate(time, cursor, true), compressedRotation->Evaluate(time, true)));
+}
+
+int main(int, char** argv)
+{
+	try
+	{
+		test_compiled_sampler();
+		test_animation_compression();
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
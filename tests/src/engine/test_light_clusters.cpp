@@ -0,0 +1,276 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/LightClusters.h>
+#include <donut/engine/View.h>
+#include <donut/core/log.h>
+#include <donut/tests/engine_utils.h>
+#include <donut/tests/utils.h>
+#include <random>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+#include <donut/shaders/light_cb.h>
+#include <donut/shaders/light_cluster_cb.h>
+
+static const uint32_t c_Width = 1280;
+static const uint32_t c_Height = 720;
+static const float c_VerticalFov = radians(60.f);
+
+// Reconstructs the view-space position of a pixel center at the given depth
+static float3 getViewPosition(float2 pixel, float depth)
+{
+	float tanHalfFov = tanf(c_VerticalFov * 0.5f);
+	float aspect = float(c_Width) / float(c_Height);
+	float clipX = pixel.x / float(c_Width) * 2.f - 1.f;
+	float clipY = 1.f - pixel.y / float(c_Height) * 2.f;
+	return float3(clipX * tanHalfFov * aspect * depth, clipY * tanHalfFov * depth, depth);
+}
+
+static LightConstants makePointLight(float3 position, float range)
+{
+	LightConstants light{};
+	light.lightType = LightType_Point;
+	light.position = position;
+	light.angularSizeOrInvRange = 1.f / range;
+	return light;
+}
+
+static LightConstants makeSpotLight(float3 position, float3 direction, float range, float outerAngle)
+{
+	LightConstants light = makePointLight(position, range);
+	light.lightType = LightType_Spot;
+	light.direction = normalize(direction);
+	light.outerAngle = outerAngle;
+	return light;
+}
+
+static LightConstants makeDirectionalLight()
+{
+	LightConstants light{};
+	light.lightType = LightType_Directional;
+	light.direction = float3(0.f, -1.f, 0.f);
+	return light;
+}
+
+// The same test as ShadeSurface in lighting.hlsli
+static bool isLit(const LightConstants& light, float3 position)
+{
+	float3 lightToSurface = position - light.position;
+	float distance = length(lightToSurface);
+	if (distance * light.angularSizeOrInvRange >= 1.f)
+		return false;
+
+	if (light.lightType == LightType_Spot && distance > 0.f)
+	{
+		float angle = acosf(clamp(dot(lightToSurface / distance, light.direction), -1.f, 1.f));
+		if (angle >= light.outerAngle)
+			return false;
+	}
+
+	return true;
+}
+
+static bool clusterContains(const LightClusterGrid& grid, uint32_t cluster, uint32_t lightIndex)
+{
+	const uint2 range = grid.GetClusterRanges()[cluster];
+	for (uint32_t i = 0; i < range.y; i++)
+	{
+		if (grid.GetLightIndices()[range.x + i] == lightIndex)
+			return true;
+	}
+	return false;
+}
+
+void test_partition()
+{
+	std::vector<LightConstants> lights = {
+		makePointLight(float3(0.f, 0.f, 10.f), 5.f),
+		makeDirectionalLight(),
+		makePointLight(float3(0.f, 0.f, 10.f), 0.f), // infinite range
+		makeSpotLight(float3(0.f, 0.f, 10.f), float3(0.f, 0.f, 1.f), 5.f, radians(30.f))
+	};
+	lights[2].angularSizeOrInvRange = 0.f;
+
+	LightClusterGrid grid;
+	uint32_t numGlobalLights = grid.PartitionLights(lights);
+	CHECK(numGlobalLights == 2);
+	CHECK(lights[0].lightType == LightType_Directional);
+	CHECK(lights[1].lightType == LightType_Point && lights[1].angularSizeOrInvRange == 0.f);
+	CHECK(lights[2].lightType == LightType_Point && lights[2].angularSizeOrInvRange > 0.f);
+	CHECK(lights[3].lightType == LightType_Spot);
+
+	// Without clustering, every light is global and the grid is a single empty cluster
+	LightClusterSettings settings;
+	settings.enableClustering = false;
+	grid.SetSettings(settings);
+	numGlobalLights = grid.PartitionLights(lights);
+	CHECK(numGlobalLights == 4);
+
+	grid.SetLights(lights.data(), uint32_t(lights.size()), numGlobalLights);
+	grid.Build(makeView(c_Width, c_Height, c_VerticalFov));
+	CHECK(all(grid.GetGridSize() == uint3(1u)));
+	CHECK(grid.GetLightIndices().empty());
+	CHECK(grid.GetClusterIndex(float2(600.f, 300.f), 50.f) == 0);
+
+	LightClusterConstants constants{};
+	grid.FillConstants(constants);
+	CHECK(constants.numGlobalLights == 4);
+}
+
+void test_conservative_binning()
+{
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+	std::vector<LightConstants> lights;
+	lights.push_back(makeDirectionalLight());
+	for (int i = 0; i < 300; i++)
+	{
+		float depth = 0.5f + unit(rng) * 150.f;
+		float3 position = getViewPosition(float2(unit(rng) * c_Width, unit(rng) * c_Height), depth);
+		position.x += (unit(rng) - 0.5f) * 20.f; // some lights are outside of the frustum
+		float range = 0.5f + unit(rng) * 8.f;
+
+		if (i % 3 == 0)
+		{
+			float3 direction = float3(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f);
+			lights.push_back(makeSpotLight(position, direction, range, radians(10.f + unit(rng) * 50.f)));
+		}
+		else
+			lights.push_back(makePointLight(position, range));
+	}
+
+	// A light behind the camera that does not reach the view
+	lights.push_back(makePointLight(float3(0.f, 0.f, -10.f), 5.f));
+
+	LightClusterGrid grid;
+	uint32_t numGlobalLights = grid.PartitionLights(lights);
+	CHECK(numGlobalLights == 1);
+
+	grid.SetLights(lights.data(), uint32_t(lights.size()), numGlobalLights);
+	grid.Build(makeView(c_Width, c_Height, c_VerticalFov));
+
+	const LightClusterStats& stats = grid.GetStats();
+	CHECK(all(grid.GetGridSize() == uint3(20u, 12u, 24u)));
+	CHECK(stats.numClusters == 20 * 12 * 24);
+	CHECK(stats.numLocalLights == 301);
+	CHECK(stats.overflowedClusters == 0);
+	CHECK(grid.GetClusterRanges().size() == stats.numClusters);
+	CHECK(grid.GetLightIndices().size() == stats.numLightIndices);
+
+	// Clustering must cut the per-pixel light count well below the total
+	CHECK(float(stats.numLightIndices) / float(stats.numClusters) < 10.f);
+
+	uint32_t behindLight = uint32_t(lights.size()) - 1;
+	for (uint32_t index : grid.GetLightIndices())
+	{
+		CHECK(index >= numGlobalLights && index < uint32_t(lights.size()));
+		CHECK(index != behindLight);
+	}
+
+	// Every surface point that a light reaches must find that light in its cluster
+	uint32_t litSamples = 0;
+	for (int sample = 0; sample < 20000; sample++)
+	{
+		float2 pixel = float2(unit(rng) * c_Width, unit(rng) * c_Height);
+		float depth = 0.2f + unit(rng) * unit(rng) * 200.f;
+		float3 position = getViewPosition(pixel, depth);
+		uint32_t cluster = grid.GetClusterIndex(pixel, depth);
+		CHECK(cluster < stats.numClusters);
+
+		for (uint32_t lightIndex = numGlobalLights; lightIndex < uint32_t(lights.size()); lightIndex++)
+		{
+			if (isLit(lights[lightIndex], position))
+			{
+				CHECK(clusterContains(grid, cluster, lightIndex));
+				++litSamples;
+			}
+		}
+	}
+	CHECK(litSamples > 100);
+}
+
+void test_overflow()
+{
+	std::vector<LightConstants> lights;
+	for (int i = 0; i < 10; i++)
+		lights.push_back(makePointLight(float3(0.f, 0.f, 10.f), 2.f));
+
+	const PlanarView view = makeView(c_Width, c_Height, c_VerticalFov);
+
+	LightClusterSettings settings;
+	settings.maxLightsPerCluster = 4;
+	LightClusterGrid grid(settings);
+	grid.SetLights(lights.data(), uint32_t(lights.size()), grid.PartitionLights(lights));
+	grid.Build(view);
+
+	const LightClusterStats& stats = grid.GetStats();
+	CHECK(stats.overflowedClusters > 0);
+	CHECK(stats.maxLightsInCluster == 10);
+
+	uint32_t cluster = grid.GetClusterIndex(float2(c_Width * 0.5f, c_Height * 0.5f), 10.f);
+	CHECK(grid.GetClusterRanges()[cluster].y == 4);
+
+	// The first lights are kept
+	for (uint32_t index = 0; index < 4; index++)
+		CHECK(clusterContains(grid, cluster, index));
+
+	// The overflow is reported once, and again after a build without overflow
+	int warnings = 0;
+	log::SetCallback([&warnings](log::Severity severity, const char*)
+	{
+		if (severity == log::Severity::Warning)
+			++warnings;
+	});
+
+	grid.Build(view);
+	CHECK(warnings == 0);
+
+	grid.SetLights(lights.data(), 1, 0);
+	grid.Build(view);
+	CHECK(grid.GetStats().overflowedClusters == 0);
+
+	grid.SetLights(lights.data(), uint32_t(lights.size()), 0);
+	grid.Build(view);
+	grid.Build(view);
+	log::ResetCallback();
+	CHECK(warnings == 1);
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_partition();
+		test_conservative_binning();
+		test_overflow();
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
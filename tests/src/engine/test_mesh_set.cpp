@@ -0,0 +1,218 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/MeshSetImporter.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/SceneTypes.h>
+#include <donut/engine/TextureCache.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/tests/utils.h>
+
+#include <cmath>
+#include <cstring>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+// Builds a model with two meshes in one buffer group: a quad, and a mesh with two triangle geometries.
+static SceneImportResult createModel(const std::shared_ptr<SceneGraph>& graph)
+{
+	auto buffers = std::make_shared<BufferGroup>();
+
+	for (int i = 0; i < 10; ++i)
+	{
+		buffers->positionData.push_back(float3(float(i), float(i % 3), -float(i)));
+		buffers->normalData.push_back(vectorToSnorm8(float3(0.f, 1.f, 0.f)));
+		buffers->tangentData.push_back(vectorToSnorm8(float4(1.f, 0.f, 0.f, -1.f)));
+		buffers->texcoord1Data.push_back(float2(float(i) * 0.1f, 0.5f));
+	}
+	buffers->indexData = { 0, 1, 2, 0, 2, 3, 0, 1, 2, 0, 1, 2 };
+
+	auto red = std::make_shared<Material>();
+	red->name = "Red";
+	auto blue = std::make_shared<Material>();
+	blue->name = "Blue";
+
+	auto quad = std::make_shared<MeshInfo>();
+	quad->name = "Quad";
+	quad->buffers = buffers;
+	quad->indexOffset = 0;
+	quad->vertexOffset = 0;
+	quad->totalIndices = 6;
+	quad->totalVertices = 4;
+	quad->objectSpaceBounds = box3(float3(0.f), float3(3.f, 2.f, 0.f));
+	auto quadGeometry = std::make_shared<MeshGeometry>();
+	quadGeometry->material = red;
+	quadGeometry->numIndices = 6;
+	quadGeometry->numVertices = 4;
+	quadGeometry->objectSpaceBounds = quad->objectSpaceBounds;
+	quad->geometries.push_back(quadGeometry);
+
+	auto pair = std::make_shared<MeshInfo>();
+	pair->name = "Pair";
+	pair->buffers = buffers;
+	pair->indexOffset = 6;
+	pair->vertexOffset = 4;
+	pair->totalIndices = 6;
+	pair->totalVertices = 6;
+	pair->objectSpaceBounds = box3(float3(4.f, 0.f, -9.f), float3(9.f, 2.f, -4.f));
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		auto geometry = std::make_shared<MeshGeometry>();
+		geometry->material = i == 0 ? red : blue;
+		geometry->indexOffsetInMesh = i * 3;
+		geometry->vertexOffsetInMesh = i * 3;
+		geometry->numIndices = 3;
+		geometry->numVertices = 3;
+		geometry->objectSpaceBounds = pair->objectSpaceBounds;
+		pair->geometries.push_back(geometry);
+	}
+
+	auto root = std::make_shared<SceneGraphNode>();
+	root->SetName("Root");
+
+	auto quadNode = std::make_shared<SceneGraphNode>();
+	quadNode->SetName("QuadNode");
+	quadNode->SetTranslation(double3(1.0, 2.0, 3.0));
+	quadNode->SetLeaf(std::make_shared<MeshInstance>(quad));
+	graph->Attach(root, quadNode);
+
+	auto group = std::make_shared<SceneGraphNode>();
+	group->SetName("Group");
+	group->SetScaling(double3(2.0));
+	graph->Attach(root, group);
+
+	auto pairNode = std::make_shared<SceneGraphNode>();
+	pairNode->SetName("PairNode");
+	pairNode->SetRotation(dquat(std::cos(0.25), 0.0, std::sin(0.25), 0.0));
+	pairNode->SetLeaf(std::make_shared<MeshInstance>(pair));
+	graph->Attach(group, pairNode);
+
+	SceneImportResult result;
+	result.rootNode = root;
+	return result;
+}
+
+template<typename T>
+static bool compareView(const BufferGroup& buffers, VertexAttribute attr, const std::vector<T>& expected)
+{
+	const void* view = buffers.vertexDataViews[size_t(attr)];
+	const nvrhi::BufferRange& range = buffers.getVertexBufferRange(attr);
+	return view && range.byteSize == expected.size() * sizeof(T) && memcmp(view, expected.data(), range.byteSize) == 0;
+}
+
+void test_mesh_set_roundtrip()
+{
+	auto fs = std::make_shared<vfs::NativeFileSystem>();
+	auto graph = std::make_shared<SceneGraph>();
+	SceneImportResult model = createModel(graph);
+	const BufferGroup& sourceBuffers = *std::dynamic_pointer_cast<MeshInstance>(
+		model.rootNode->GetChild(0)->GetLeaf())->GetMesh()->buffers;
+
+	const std::filesystem::path fileName = std::filesystem::temp_directory_path() / (std::string("donut_test_mesh_set") + c_MeshSetExtension);
+	CHECK(IsMeshSetFile(fileName));
+	CHECK(ExportMeshSet(*fs, fileName, model));
+
+	TextureCache textureCache(nullptr, fs, nullptr);
+	SceneLoadingStats stats;
+	MeshSetImporter importer(fs, std::make_shared<SceneTypeFactory>());
+	SceneImportResult result;
+	CHECK(importer.Load(fileName, textureCache, stats, nullptr, result));
+	CHECK(result.rootNode && result.rootNode->GetName() == "Root");
+
+	// Same hierarchy and transforms; the second geometry of the pair becomes a separate instance under PairNode
+	std::vector<std::string> names;
+	std::vector<std::shared_ptr<MeshInfo>> meshes;
+	for (SceneGraphWalker walker(result.rootNode.get()); walker; walker.Next(true))
+	{
+		names.push_back(walker->GetName());
+		if (auto instance = std::dynamic_pointer_cast<MeshInstance>(walker->GetLeaf()))
+			meshes.push_back(instance->GetMesh());
+
+		if (walker->GetName() == "QuadNode")
+			CHECK(all(abs(walker->GetTranslation() - double3(1.0, 2.0, 3.0)) < 1e-6));
+		if (walker->GetName() == "Group")
+			CHECK(all(abs(walker->GetScaling() - double3(2.0)) < 1e-6));
+	}
+	CHECK((names == std::vector<std::string>{ "Root", "QuadNode", "Group", "PairNode", "PairNode" }));
+	CHECK(meshes.size() == 3);
+
+	CHECK(meshes[0]->name == "Quad" && meshes[0]->totalIndices == 6 && meshes[0]->vertexOffset == 0);
+	CHECK(meshes[1]->name == "Pair" && meshes[1]->indexOffset == 6 && meshes[1]->vertexOffset == 4);
+	CHECK(meshes[2]->name == "Pair" && meshes[2]->indexOffset == 9 && meshes[2]->vertexOffset == 7);
+	CHECK(meshes[0]->geometries[0]->material->name == "Red");
+	CHECK(meshes[1]->geometries[0]->material == meshes[0]->geometries[0]->material);
+	CHECK(meshes[2]->geometries[0]->material->name == "Blue");
+
+	// All meshes share one buffer group that references the file data without copies
+	const BufferGroup& buffers = *meshes[0]->buffers;
+	CHECK(meshes[1]->buffers.get() == &buffers && meshes[2]->buffers.get() == &buffers);
+	CHECK(buffers.dataBlob != nullptr);
+	CHECK(buffers.indexData.empty() && buffers.positionData.empty());
+	CHECK(buffers.indexCount == sourceBuffers.indexData.size());
+	CHECK(memcmp(buffers.indexDataView, sourceBuffers.indexData.data(), buffers.indexCount * sizeof(uint32_t)) == 0);
+	CHECK(compareView(buffers, VertexAttribute::Position, sourceBuffers.positionData));
+	CHECK(compareView(buffers, VertexAttribute::Normal, sourceBuffers.normalData));
+	CHECK(compareView(buffers, VertexAttribute::Tangent, sourceBuffers.tangentData));
+	CHECK(compareView(buffers, VertexAttribute::TexCoord1, sourceBuffers.texcoord1Data));
+	CHECK(!buffers.hasAttribute(VertexAttribute::TexCoord2));
+
+	std::filesystem::remove(fileName);
+}
+
+void test_mesh_set_invalid()
+{
+	auto fs = std::make_shared<vfs::NativeFileSystem>();
+	const std::filesystem::path fileName = std::filesystem::temp_directory_path() / (std::string("donut_test_invalid") + c_MeshSetExtension);
+	const char garbage[] = "this is not a chunk file";
+	CHECK(fs->writeFile(fileName, garbage, sizeof(garbage)));
+
+	TextureCache textureCache(nullptr, fs, nullptr);
+	SceneLoadingStats stats;
+	MeshSetImporter importer(fs, std::make_shared<SceneTypeFactory>());
+	SceneImportResult result;
+	CHECK(!importer.Load(fileName, textureCache, stats, nullptr, result));
+	CHECK(!result.rootNode);
+
+	// Models without CPU vertex data cannot be exported
+	SceneImportResult empty;
+	empty.rootNode = std::make_shared<SceneGraphNode>();
+	CHECK(!ExportMeshSet(*fs, fileName, empty));
+
+	std::filesystem::remove(fileName);
+}
+
+int main(int, char** argv)
+{
+	try
+	{
+		test_mesh_set_roundtrip();
+		test_mesh_set_invalid();
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,179 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/MeshSimplifier.h>
+#include <donut/tests/utils.h>
+#include <cmath>
+#include <set>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+// Builds a grid of (size + 1) x (size + 1) vertices in the XY plane, with Z from the height function
+template<typename HeightFunc>
+static void makeGrid(int size, HeightFunc height, std::vector<float3>& positions, std::vector<uint32_t>& indices)
+{
+	positions.clear();
+	indices.clear();
+
+	for (int y = 0; y <= size; y++)
+	{
+		for (int x = 0; x <= size; x++)
+		{
+			float fx = float(x) / float(size);
+			float fy = float(y) / float(size);
+			positions.push_back(float3(fx, fy, height(fx, fy)));
+		}
+	}
+
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			uint32_t i00 = uint32_t(y * (size + 1) + x);
+			uint32_t i10 = i00 + 1;
+			uint32_t i01 = i00 + uint32_t(size + 1);
+			uint32_t i11 = i01 + 1;
+			indices.insert(indices.end(), { i00, i10, i11, i00, i11, i01 });
+		}
+	}
+}
+
+static float3 triangleNormal(const std::vector<float3>& positions, const uint32_t* triangle)
+{
+	return cross(positions[triangle[1]] - positions[triangle[0]], positions[triangle[2]] - positions[triangle[0]]);
+}
+
+void test_flat_grid()
+{
+	std::vector<float3> positions;
+	std::vector<uint32_t> indices;
+	makeGrid(16, [](float, float) { return 0.f; }, positions, indices);
+
+	float error = -1.f;
+	std::vector<uint32_t> result = SimplifyMesh(positions.data(), positions.size(), indices.data(), indices.size(), 0, 0.01f, &error);
+
+	// Only the border vertices are locked, and the interior of a plane collapses without error
+	CHECK(result.size() % 3 == 0);
+	CHECK(result.size() < indices.size() / 4);
+	CHECK(error >= 0.f && error < 1e-4f);
+
+	float area = 0.f;
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		CHECK(result[i] < positions.size() && result[i + 1] < positions.size() && result[i + 2] < positions.size());
+
+		float3 normal = triangleNormal(positions, &result[i]);
+		CHECK(normal.z > 0.f);
+		area += normal.z * 0.5f;
+	}
+
+	// The simplified mesh still covers the whole grid
+	CHECK(fabsf(area - 1.f) < 1e-4f);
+
+	// All the border vertices are still used
+	std::set<uint32_t> used(result.begin(), result.end());
+	for (uint32_t i = 0; i < positions.size(); i++)
+	{
+		const float3& p = positions[i];
+		if (p.x == 0.f || p.x == 1.f || p.y == 0.f || p.y == 1.f)
+			CHECK(used.count(i) == 1);
+	}
+}
+
+void test_error_limit()
+{
+	std::vector<float3> positions;
+	std::vector<uint32_t> indices;
+	makeGrid(24, [](float x, float y) { return 0.1f * sinf(x * 6.f) * cosf(y * 6.f); }, positions, indices);
+
+	float smallError = 0.f;
+	std::vector<uint32_t> fine = SimplifyMesh(positions.data(), positions.size(), indices.data(), indices.size(), 0, 0.001f, &smallError);
+
+	float largeError = 0.f;
+	std::vector<uint32_t> coarse = SimplifyMesh(positions.data(), positions.size(), indices.data(), indices.size(), 0, 0.05f, &largeError);
+
+	CHECK(smallError <= 0.001f);
+	CHECK(largeError <= 0.05f);
+	CHECK(coarse.size() < fine.size());
+	CHECK(fine.size() < indices.size());
+
+	// The target size is respected when the error allows it
+	size_t target = indices.size() / 2;
+	std::vector<uint32_t> half = SimplifyMesh(positions.data(), positions.size(), indices.data(), indices.size(), target, 1.f);
+	CHECK(half.size() <= target);
+	CHECK(half.size() >= target - 6);
+}
+
+void test_seams()
+{
+	// Two flat grids side by side that share the positions of the middle column, like a texture seam
+	std::vector<float3> positions;
+	std::vector<uint32_t> indices;
+	makeGrid(8, [](float, float) { return 0.f; }, positions, indices);
+
+	std::vector<float3> allPositions = positions;
+	std::vector<uint32_t> allIndices = indices;
+	uint32_t offset = uint32_t(positions.size());
+	for (const float3& p : positions)
+		allPositions.push_back(float3(p.x + 1.f, p.y, p.z));
+	for (uint32_t index : indices)
+		allIndices.push_back(index + offset);
+
+	std::vector<uint32_t> result = SimplifyMesh(allPositions.data(), allPositions.size(), allIndices.data(), allIndices.size(), 0, 0.01f);
+	CHECK(result.size() < allIndices.size());
+
+	std::set<uint32_t> used(result.begin(), result.end());
+	for (uint32_t i = 0; i < allPositions.size(); i++)
+	{
+		if (allPositions[i].x == 1.f)
+			CHECK(used.count(i) == 1);
+	}
+}
+
+void test_invalid_input()
+{
+	const float3 positions[] = { float3(0.f), float3(1.f, 0.f, 0.f), float3(0.f, 1.f, 0.f) };
+	const uint32_t indices[] = { 0, 1, 5 };
+
+	std::vector<uint32_t> result = SimplifyMesh(positions, 3, indices, 3, 0, 1.f);
+	CHECK(result.size() == 3);
+	CHECK(result[2] == 5);
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_flat_grid();
+		test_error_limit();
+		test_seams();
+		test_invalid_input();
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
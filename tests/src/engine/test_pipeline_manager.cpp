@@ -0,0 +1,230 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/PipelineManager.h>
+#include <donut/tests/utils.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+using namespace donut;
+using namespace donut::engine;
+
+// The manager only passes the pipelines through, so the tests don't need a device
+class TestPipeline : public nvrhi::RefCounter<nvrhi::IGraphicsPipeline>
+{
+public:
+	const nvrhi::GraphicsPipelineDesc& getDesc() const override { return m_Desc; }
+	const nvrhi::FramebufferInfo& getFramebufferInfo() const override { return m_FramebufferInfo; }
+
+private:
+	nvrhi::GraphicsPipelineDesc m_Desc;
+	nvrhi::FramebufferInfo m_FramebufferInfo;
+};
+
+static nvrhi::GraphicsPipelineHandle CreateTestPipeline()
+{
+	return nvrhi::GraphicsPipelineHandle::Create(new TestPipeline());
+}
+
+static nvrhi::FramebufferInfo CreateFramebufferInfo(nvrhi::Format colorFormat)
+{
+	nvrhi::FramebufferInfo framebufferInfo;
+	framebufferInfo.colorFormats.push_back(colorFormat);
+	framebufferInfo.depthFormat = nvrhi::Format::D32;
+	return framebufferInfo;
+}
+
+void test_pipeline_manager_sync()
+{
+	PipelineManager manager;
+	const uint64_t owner = manager.RegisterOwner();
+	const nvrhi::FramebufferInfo framebufferInfo = CreateFramebufferInfo(nvrhi::Format::RGBA8_UNORM);
+
+	int creations = 0;
+	auto create = [&creations]() { ++creations; return CreateTestPipeline(); };
+
+	// Without an executor, the pipeline is created by the first request
+	nvrhi::GraphicsPipelineHandle first = manager.GetGraphicsPipeline(owner, 1, framebufferInfo, create);
+	CHECK(first);
+	CHECK(manager.GetGraphicsPipeline(owner, 1, framebufferInfo, create) == first);
+	CHECK(manager.GetGraphicsPipeline(owner, 2, framebufferInfo, create) != first);
+	CHECK(creations == 2);
+
+	PipelineManagerStats stats = manager.GetStats();
+	CHECK(stats.requests == 3);
+	CHECK(stats.readyHits == 1);
+	CHECK(stats.pendingHits == 0);
+	CHECK(stats.createdPipelines == 2);
+	CHECK(stats.failedPipelines == 0);
+	CHECK(stats.pendingPipelines == 0);
+
+	// Clear releases the pipelines, so they are created again
+	manager.Clear();
+	CHECK(manager.GetGraphicsPipeline(owner, 1, framebufferInfo, create));
+	CHECK(creations == 3);
+}
+
+void test_pipeline_manager_failure()
+{
+	PipelineManager manager;
+	const uint64_t owner = manager.RegisterOwner();
+	const nvrhi::FramebufferInfo framebufferInfo = CreateFramebufferInfo(nvrhi::Format::RGBA8_UNORM);
+
+	int attempts = 0;
+	auto fail = [&attempts]() { ++attempts; return nvrhi::GraphicsPipelineHandle(); };
+
+	// A failed creation is counted and not retried on every request
+	CHECK(!manager.GetGraphicsPipeline(owner, 1, framebufferInfo, fail));
+	CHECK(!manager.GetGraphicsPipeline(owner, 1, framebufferInfo, fail));
+	CHECK(attempts == 1);
+	CHECK(manager.GetStats().failedPipelines == 1);
+
+	// After Clear, the pipeline is requested again
+	manager.Clear();
+	CHECK(manager.GetGraphicsPipeline(owner, 1, framebufferInfo, []() { return CreateTestPipeline(); }));
+	CHECK(manager.GetStats().createdPipelines == 1);
+}
+
+void test_pipeline_manager_owners()
+{
+	PipelineManager manager;
+	const uint64_t firstOwner = manager.RegisterOwner();
+	const uint64_t secondOwner = manager.RegisterOwner();
+	CHECK(firstOwner != secondOwner);
+
+	const nvrhi::FramebufferInfo colorInfo = CreateFramebufferInfo(nvrhi::Format::RGBA8_UNORM);
+	const nvrhi::FramebufferInfo hdrInfo = CreateFramebufferInfo(nvrhi::Format::RGBA16_FLOAT);
+
+	int creations = 0;
+	auto create = [&creations]() { ++creations; return CreateTestPipeline(); };
+
+	// The same key from different owners or for different framebuffers refers to different pipelines
+	nvrhi::GraphicsPipelineHandle first = manager.GetGraphicsPipeline(firstOwner, 1, colorInfo, create);
+	nvrhi::GraphicsPipelineHandle second = manager.GetGraphicsPipeline(secondOwner, 1, colorInfo, create);
+	nvrhi::GraphicsPipelineHandle hdr = manager.GetGraphicsPipeline(firstOwner, 1, hdrInfo, create);
+	CHECK(first != second);
+	CHECK(first != hdr);
+	CHECK(creations == 3);
+	CHECK(manager.GetGraphicsPipeline(firstOwner, 1, colorInfo, create) == first);
+
+	// Releasing an owner removes only its pipelines
+	manager.ReleaseOwner(firstOwner);
+	CHECK(manager.GetGraphicsPipeline(secondOwner, 1, colorInfo, create) == second);
+	CHECK(creations == 3);
+	CHECK(manager.GetGraphicsPipeline(firstOwner, 1, colorInfo, create) != first);
+	CHECK(creations == 4);
+}
+
+#ifdef DONUT_WITH_TASKFLOW
+void test_pipeline_manager_async()
+{
+	tf::Executor executor(2);
+	PipelineManager manager(&executor);
+	const uint64_t owner = manager.RegisterOwner();
+	const nvrhi::FramebufferInfo framebufferInfo = CreateFramebufferInfo(nvrhi::Format::RGBA8_UNORM);
+
+	// Hold the creation until the main thread has checked the pending state
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool release = false;
+	std::atomic<int> creations{ 0 };
+
+	auto create = [&]()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [&release]() { return release; });
+		++creations;
+		return CreateTestPipeline();
+	};
+
+	CHECK(!manager.GetGraphicsPipeline(owner, 1, framebufferInfo, create));
+	CHECK(!manager.GetGraphicsPipeline(owner, 1, framebufferInfo, create));
+	CHECK(manager.GetStats().pendingPipelines == 1);
+	CHECK(manager.GetStats().pendingHits == 1);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		release = true;
+	}
+	condition.notify_all();
+	manager.WaitForPendingPipelines();
+
+	CHECK(creations == 1);
+	CHECK(manager.GetStats().pendingPipelines == 0);
+	CHECK(manager.GetGraphicsPipeline(owner, 1, framebufferInfo, create));
+
+	// Concurrent requests for the same keys start one creation per key.
+	// The results are checked on the main thread, because CHECK throws.
+	const int threadCount = 4;
+	const size_t keyCount = 16;
+	std::atomic<int> concurrentCreations{ 0 };
+	auto createCounted = [&concurrentCreations]() { ++concurrentCreations; return CreateTestPipeline(); };
+
+	std::vector<std::thread> threads;
+	for (int thread = 0; thread < threadCount; ++thread)
+	{
+		threads.emplace_back([&manager, &createCounted, owner, &framebufferInfo, keyCount]()
+		{
+			for (size_t key = 100; key < 100 + keyCount; ++key)
+				manager.GetGraphicsPipeline(owner, key, framebufferInfo, createCounted);
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	manager.WaitForPendingPipelines();
+	CHECK(concurrentCreations == int(keyCount));
+	for (size_t key = 100; key < 100 + keyCount; ++key)
+		CHECK(manager.GetGraphicsPipeline(owner, key, framebufferInfo, createCounted));
+
+	PipelineManagerStats stats = manager.GetStats();
+	CHECK(stats.createdPipelines == 1 + keyCount);
+	CHECK(stats.requests == stats.readyHits + stats.pendingHits + stats.createdPipelines);
+}
+#endif
+
+int main(int, char**)
+{
+	try
+	{
+		test_pipeline_manager_sync();
+		test_pipeline_manager_failure();
+		test_pipeline_manager_owners();
+#ifdef DONUT_WITH_TASKFLOW
+		test_pipeline_manager_async();
+#endif
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,379 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/SceneGraphLoader.h>
+#include <donut/engine/KeyframeAnimation.h>
+#include <donut/core/json_reader.h>
+#include <donut/core/log.h>
+#include <donut/tests/utils.h>
+#include <json/reader.h>
+#include <json/value.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <typeinfo>
+
+using namespace donut;
+using namespace donut::engine;
+
+// Counts the heap usage of the loaders to compare their peak memory
+
+static std::atomic<size_t> g_AllocatedBytes = 0;
+static std::atomic<size_t> g_PeakAllocatedBytes = 0;
+
+void* operator new(size_t size)
+{
+	size_t* block = static_cast<size_t*>(malloc(size + sizeof(size_t) * 2));
+	if (!block)
+		throw std::bad_alloc();
+	block[0] = size;
+	const size_t allocated = g_AllocatedBytes.fetch_add(size) + size;
+	size_t peak = g_PeakAllocatedBytes.load();
+	while (allocated > peak && !g_PeakAllocatedBytes.compare_exchange_weak(peak, allocated))
+		;
+	return block + 2;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (!ptr)
+		return;
+	size_t* block = static_cast<size_t*>(ptr) - 2;
+	g_AllocatedBytes.fetch_sub(block[0]);
+	free(block);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+static void ResetPeakMemory()
+{
+	g_PeakAllocatedBytes = g_AllocatedBytes.load();
+}
+
+static bool ParseDocument(const std::string& text, Json::Value& root)
+{
+	Json::CharReaderBuilder builder;
+	std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+	std::string errors;
+	return reader->parse(text.data(), text.data() + text.size(), &root, &errors);
+}
+
+struct LoadedScene
+{
+	std::shared_ptr<SceneGraph> graph;
+	std::vector<SceneImportResult> models;
+	int warnings = 0;
+};
+
+static void InitScene(LoadedScene& scene, int modelCount)
+{
+	scene.graph = std::make_shared<SceneGraph>();
+	auto root = std::make_shared<SceneGraphNode>();
+	root->SetName("SceneRoot");
+	scene.graph->SetRootNode(root);
+
+	for (int i = 0; i < modelCount; i++)
+	{
+		auto model = std::make_shared<SceneGraphNode>();
+		model->SetName("Model" + std::to_string(i));
+		scene.models.push_back({ model });
+	}
+}
+
+// Loads the graph and animations from a document, like Scene does when RequiresSceneDocument returns true
+static void LoadWithDocument(const Json::Value& document, LoadedScene& scene)
+{
+	SceneGraphLoader loader(scene.graph, std::make_shared<SceneTypeFactory>(), scene.models);
+	loader.LoadSceneGraph(document["graph"], scene.graph->GetRootNode());
+	loader.LoadAnimations(document["animations"]);
+}
+
+// Finds the sections and loads them with the streaming reader, like Scene::LoadWithExecutor does by default
+static bool LoadWithReader(const std::string& text, LoadedScene& scene)
+{
+	json::Reader reader(text.data(), text.size());
+
+	Json::Value documentRoot(Json::objectValue);
+	size_t graphOffset = 0;
+	size_t animationsOffset = 0;
+	bool hasGraph = false;
+	bool hasAnimations = false;
+
+	reader.BeginObject();
+	std::string_view key;
+	while (reader.NextMember(key))
+	{
+		if (key == "graph")
+		{
+			graphOffset = reader.GetOffset();
+			hasGraph = true;
+			reader.Skip();
+		}
+		else if (key == "animations")
+		{
+			animationsOffset = reader.GetOffset();
+			hasAnimations = true;
+			reader.Skip();
+		}
+		else
+			reader.ReadValue(documentRoot[std::string(key)]);
+	}
+
+	SceneGraphLoader loader(scene.graph, std::make_shared<SceneTypeFactory>(), scene.models);
+
+	if (hasGraph)
+	{
+		reader.SetOffset(graphOffset);
+		loader.LoadSceneGraph(reader, scene.graph->GetRootNode());
+	}
+
+	if (hasAnimations)
+	{
+		reader.SetOffset(animationsOffset);
+		loader.LoadAnimations(reader);
+	}
+
+	return !reader.HasError();
+}
+
+static void CompareLeaves(const SceneGraphLeaf* a, const SceneGraphLeaf* b)
+{
+	CHECK(!a == !b);
+	if (!a)
+		return;
+
+	CHECK(typeid(*a) == typeid(*b));
+
+	if (auto light = dynamic_cast<const Light*>(a))
+		CHECK(all(light->color == static_cast<const Light*>(b)->color));
+
+	if (auto point = dynamic_cast<const PointLight*>(a))
+	{
+		CHECK(point->intensity == static_cast<const PointLight*>(b)->intensity);
+		CHECK(point->radius == static_cast<const PointLight*>(b)->radius);
+	}
+
+	if (auto spot = dynamic_cast<const SpotLight*>(a))
+	{
+		CHECK(spot->innerAngle == static_cast<const SpotLight*>(b)->innerAngle);
+		CHECK(spot->outerAngle == static_cast<const SpotLight*>(b)->outerAngle);
+	}
+
+	if (auto camera = dynamic_cast<const PerspectiveCamera*>(a))
+	{
+		CHECK(camera->zNear == static_cast<const PerspectiveCamera*>(b)->zNear);
+		CHECK(camera->verticalFov == static_cast<const PerspectiveCamera*>(b)->verticalFov);
+	}
+
+	if (auto animation = dynamic_cast<const SceneGraphAnimation*>(a))
+	{
+		auto other = static_cast<const SceneGraphAnimation*>(b);
+		CHECK(animation->GetName() == other->GetName());
+		CHECK(animation->GetChannels().size() == other->GetChannels().size());
+
+		for (size_t i = 0; i < animation->GetChannels().size(); i++)
+		{
+			const auto& channel = animation->GetChannels()[i];
+			const auto& otherChannel = other->GetChannels()[i];
+			CHECK(channel->GetAttribute() == otherChannel->GetAttribute());
+			CHECK(channel->GetLeafPropertyName() == otherChannel->GetLeafPropertyName());
+			CHECK(channel->GetTargetNode() && otherChannel->GetTargetNode());
+			CHECK(channel->GetTargetNode()->GetPath() == otherChannel->GetTargetNode()->GetPath());
+			CHECK(channel->GetSampler()->GetMode() == otherChannel->GetSampler()->GetMode());
+
+			const std::vector<animation::Keyframe> keyframes = channel->GetSampler()->CopyKeyframes();
+			const std::vector<animation::Keyframe> otherKeyframes = otherChannel->GetSampler()->CopyKeyframes();
+			CHECK(keyframes.size() == otherKeyframes.size());
+			for (size_t k = 0; k < keyframes.size(); k++)
+			{
+				CHECK(keyframes[k].time == otherKeyframes[k].time);
+				CHECK(all(keyframes[k].value == otherKeyframes[k].value));
+				CHECK(all(keyframes[k].inTangent == otherKeyframes[k].inTangent));
+				CHECK(all(keyframes[k].outTangent == otherKeyframes[k].outTangent));
+			}
+		}
+	}
+}
+
+static void CompareNodes(const SceneGraphNode* a, const SceneGraphNode* b)
+{
+	CHECK(a->GetName() == b->GetName());
+	CHECK(all(a->GetTranslation() == b->GetTranslation()));
+	CHECK(all(a->GetScaling() == b->GetScaling()));
+	CHECK(a->GetRotation().w == b->GetRotation().w && a->GetRotation().x == b->GetRotation().x
+		&& a->GetRotation().y == b->GetRotation().y && a->GetRotation().z == b->GetRotation().z);
+	CompareLeaves(a->GetLeaf().get(), b->GetLeaf().get());
+
+	CHECK(a->GetNumChildren() == b->GetNumChildren());
+	for (size_t i = 0; i < a->GetNumChildren(); i++)
+		CompareNodes(a->GetChild(i), b->GetChild(i));
+}
+
+void test_scene_graph_loader_parity()
+{
+	// Covers member orders, vector forms, custom parents, model references, leaves, animation targets,
+	// and the invalid inputs that are skipped with a warning
+	const std::string text = R"({
+		"models": ["a.gltf", "b.gltf"],
+		"animations": [
+			{ "name": "Move", "channels": [
+				{ "target": "/Car", "attribute": "translation", "mode": "linear",
+				  "data": [ { "time": 0, "value": [0, 1, 2] }, { "value": 5, "time": 1.5 }, { "value": 1 } ] },
+				{ "targets": ["/Lamp", null, 3], "attribute": "intensity", "mode": "catmull-rom",
+				  "data": [ { "time": 0, "value": 1 }, { "time": 1, "value": [2, 3], "inTangent": 0.5, "outTangent": [1, 2, 3, 4, 5] } ] },
+				{ "target": "/Car", "mode": "step", "data": [] },
+				{ "target": "/Missing", "attribute": "rotation", "mode": "slerp", "data": [ { "time": 0, "value": [0, 0, 0, 1] } ] }
+			] },
+			{ "name": "Empty", "channels": [] }
+		],
+		"graph": [
+			{ "children": [ { "name": "Wheel", "translation": 1 } ], "name": "Car", "model": 0,
+			  "translation": [1, 2, 3], "rotation": [0, 0.7071067811865476, 0, 0.7071067811865476], "scaling": 2 },
+			{ "name": "Lamp", "type": "PointLight", "color": [1, 0.5, 0.25], "intensity": 10, "radius": 0.5, "euler": [0.1, 0.2, 0.3] },
+			{ "name": "Spot", "parent": "/Car", "type": "SpotLight", "innerAngle": 20, "outerAngle": 40, "scaling": [1, 2] },
+			{ "name": "Camera", "type": "PerspectiveCamera", "zNear": 0.1, "verticalFov": 1.2, "rotation": 1 },
+			{ "name": "Sun", "type": "DirectionalLight", "irradiance": 3, "angularSize": 0.5 },
+			{ "name": "Orphan", "parent": "/Nobody" },
+			{ "name": "BadModel", "model": 1.5 },
+			{ "name": "MissingModel", "model": 7 },
+			{ "name": "Second", "model": 1, "children": [] },
+			{ "name": "Unknown", "type": "Teapot" },
+			{ "name": "BadType", "type": 1 },
+			"not an object"
+		]
+	})";
+
+	Json::Value document;
+	CHECK(ParseDocument(text, document));
+
+	LoadedScene documentScene;
+	LoadedScene streamingScene;
+	InitScene(documentScene, 2);
+	InitScene(streamingScene, 2);
+
+	int* warnings = &documentScene.warnings;
+	log::SetCallback([&warnings](log::Severity severity, const char*) { if (severity == log::Severity::Warning) ++*warnings; });
+
+	LoadWithDocument(document, documentScene);
+	warnings = &streamingScene.warnings;
+	const bool streamingResult = LoadWithReader(text, streamingScene);
+
+	log::ResetCallback();
+
+	CHECK(streamingResult);
+	CHECK(documentScene.warnings > 0);
+	CHECK(documentScene.warnings == streamingScene.warnings);
+
+	CompareNodes(documentScene.graph->GetRootNode().get(), streamingScene.graph->GetRootNode().get());
+
+	// Spot-check the result itself, so that the test does not pass if both paths lose the same data
+	auto car = streamingScene.graph->FindNode("/Car");
+	CHECK(car);
+	CHECK(car->GetNumChildren() == 2); // Wheel, Spot
+	CHECK(all(car->GetTranslation() == dm::double3(1.0, 2.0, 3.0)));
+	CHECK(all(car->GetScaling() == dm::double3(2.0)));
+
+	auto animations = streamingScene.graph->FindNode("/Animations");
+	CHECK(animations && animations->GetNumChildren() == 1);
+	auto move = std::dynamic_pointer_cast<SceneGraphAnimation>(animations->GetChild(0)->GetLeaf());
+	CHECK(move && move->GetChannels().size() == 2);
+	CHECK(move->GetChannels()[0]->GetSampler()->GetKeyframeCount() == 2);
+}
+
+static std::string GenerateScene(int nodeCount, int keyframeCount)
+{
+	std::stringstream ss;
+	ss << "{\n\"graph\": [\n";
+	for (int i = 0; i < nodeCount; i++)
+	{
+		ss << "{ \"name\": \"Node" << i << "\""
+			<< ", \"translation\": [" << i * 0.5 << ", 1.25, -" << i << "]"
+			<< ", \"rotation\": [0, 0.7071, 0, 0.7071], \"scaling\": 2"
+			<< ", \"children\": [{ \"name\": \"Light" << i << "\", \"type\": \"PointLight\", \"color\": [1, 0.9, 0.8], \"radius\": 0.1 }] },\n";
+	}
+	ss << "],\n\"animations\": [{ \"name\": \"Anim\", \"channels\": [{ \"target\": \"/Node0\", \"attribute\": \"translation\", \"mode\": \"linear\", \"data\": [\n";
+	for (int i = 0; i < keyframeCount; i++)
+		ss << "{ \"time\": " << i * 0.033 << ", \"value\": [" << i << ", 0.5, " << -i << "] },\n";
+	ss << "] }] }]\n}\n";
+	return ss.str();
+}
+
+// Compares the time and peak heap usage of loading the graph and animations of a scene file on both paths
+void test_scene_graph_loader_benchmark()
+{
+	const int nodeCount = 5000;
+	const std::string text = GenerateScene(nodeCount, 20000);
+
+	using clock = std::chrono::high_resolution_clock;
+
+	LoadedScene documentScene;
+	InitScene(documentScene, 0);
+	ResetPeakMemory();
+	size_t baseline = g_AllocatedBytes;
+	auto start = clock::now();
+	{
+		Json::Value document;
+		CHECK(ParseDocument(text, document));
+		LoadWithDocument(document, documentScene);
+	}
+	const double documentTime = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	const size_t documentMemory = g_PeakAllocatedBytes - baseline;
+
+	LoadedScene streamingScene;
+	InitScene(streamingScene, 0);
+	ResetPeakMemory();
+	baseline = g_AllocatedBytes;
+	start = clock::now();
+	CHECK(LoadWithReader(text, streamingScene));
+	const double streamingTime = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	const size_t streamingMemory = g_PeakAllocatedBytes - baseline;
+
+	CHECK(streamingScene.graph->GetRootNode()->GetNumChildren() == size_t(nodeCount) + 1);
+	CompareNodes(documentScene.graph->GetRootNode().get(), streamingScene.graph->GetRootNode().get());
+
+	printf("Loading the graph and animations of a %.1f MB scene file:\n", double(text.size()) / (1024.0 * 1024.0));
+	printf("  jsoncpp document: %8.2f ms, peak heap %8.2f MB\n", documentTime, double(documentMemory) / (1024.0 * 1024.0));
+	printf("  json::Reader:     %8.2f ms, peak heap %8.2f MB\n", streamingTime, double(streamingMemory) / (1024.0 * 1024.0));
+
+	// Both paths allocate the nodes and keyframes, but only the document path holds the whole file as a tree
+	CHECK(streamingMemory < documentMemory);
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_scene_graph_loader_parity();
+		test_scene_graph_loader_benchmark();
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,203 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/ShadowCasterCulling.h>
+#include <donut/tests/utils.h>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+// The light points straight down (-Y in world space), so light-space Z is -Y.
+// Light-space X and Y are the world X and Z axes.
+static affine3 makeWorldToLight()
+{
+	return affine3(
+		1.f, 0.f, 0.f,
+		0.f, 0.f, -1.f,
+		0.f, 1.f, 0.f,
+		0.f, 0.f, 0.f);
+}
+
+// Receivers are a 10x10 patch of ground around the origin, from Y = 0 to Y = 1
+static ShadowReceiverVolume makeGroundPatch()
+{
+	box3 patch = box3(float3(-5.f, 0.f, -5.f), float3(5.f, 1.f, 5.f));
+	float3 corners[box3::numCorners];
+	for (uint32_t i = 0; i < box3::numCorners; i++)
+		corners[i] = patch.getCorner(i);
+
+	ShadowReceiverVolume volume;
+	volume.Setup(makeWorldToLight(), corners, box3::numCorners);
+	return volume;
+}
+
+void test_hull()
+{
+	ShadowReceiverVolume volume = makeGroundPatch();
+	CHECK(volume.IsValid());
+	CHECK(volume.GetHull().size() == 4);
+	CHECK(volume.GetMaxDepth() == 0.f);
+
+	ShadowReceiverVolume empty;
+	CHECK(!empty.IsValid());
+	CHECK(empty.CanShadowReceivers(box3(float3(100.f), float3(101.f))));
+}
+
+void test_casters()
+{
+	ShadowReceiverVolume volume = makeGroundPatch();
+
+	// Directly above the patch, high up: the shadow falls on the patch
+	CHECK(volume.CanShadowReceivers(box3(float3(-1.f, 50.f, -1.f), float3(1.f, 51.f, 1.f))));
+
+	// Overlapping the patch
+	CHECK(volume.CanShadowReceivers(box3(float3(4.f, 0.5f, 4.f), float3(6.f, 2.f, 6.f))));
+
+	// Beside the patch: the shadow falls outside of it
+	CHECK(!volume.CanShadowReceivers(box3(float3(6.f, 2.f, -1.f), float3(8.f, 3.f, 1.f))));
+
+	// Below the receivers
+	CHECK(!volume.CanShadowReceivers(box3(float3(-1.f, -3.f, -1.f), float3(1.f, -1.f, 1.f))));
+}
+
+void test_diagonal_edges()
+{
+	// A triangle of receivers, to exercise the separating axes of the hull edges
+	float3 corners[] = {
+		float3(0.f, 0.f, 0.f),
+		float3(10.f, 0.f, 0.f),
+		float3(0.f, 0.f, 10.f)
+	};
+
+	ShadowReceiverVolume volume;
+	volume.Setup(makeWorldToLight(), corners, 3);
+	CHECK(volume.GetHull().size() == 3);
+
+	// Inside the bounding rectangle of the triangle, but beyond its hypotenuse
+	CHECK(!volume.CanShadowReceivers(box3(float3(7.f, 1.f, 7.f), float3(9.f, 2.f, 9.f))));
+
+	// Touching the hypotenuse
+	CHECK(volume.CanShadowReceivers(box3(float3(4.f, 1.f, 4.f), float3(6.f, 2.f, 6.f))));
+
+	// Receivers limited to a depth that is above the caster
+	volume.Setup(makeWorldToLight(), corners, 3, -5.f);
+	CHECK(!volume.CanShadowReceivers(box3(float3(1.f, 1.f, 1.f), float3(2.f, 2.f, 2.f))));
+	CHECK(volume.CanShadowReceivers(box3(float3(1.f, 5.f, 1.f), float3(2.f, 6.f, 2.f))));
+}
+
+// A camera at the origin looking diagonally between +X and +Z, with a 90 degree field of view in both directions
+static void makeViewCorners(float nearDistance, float farDistance, float3* corners)
+{
+	const float3 forward = normalize(float3(1.f, 0.f, 1.f));
+	const float3 right = normalize(float3(1.f, 0.f, -1.f));
+	const float3 up = float3(0.f, 1.f, 0.f);
+
+	for (uint32_t i = 0; i < frustum::numCorners; i++)
+	{
+		float distance = (i & frustum::C_FAR) ? farDistance : nearDistance;
+		float x = (i & frustum::C_RIGHT) ? distance : -distance;
+		float y = (i & frustum::C_TOP) ? distance : -distance;
+		corners[i] = forward * distance + right * x + up * y;
+	}
+}
+
+void test_intersection()
+{
+	// Receivers entirely inside the bounds keep their own hull
+	box3 patch = box3(float3(-5.f, 0.f, -5.f), float3(5.f, 1.f, 5.f));
+	box3 bounds = box3(float3(-100.f), float3(100.f));
+	float3 patchCorners[box3::numCorners];
+	float3 boundsCorners[box3::numCorners];
+	for (uint32_t i = 0; i < box3::numCorners; i++)
+	{
+		patchCorners[i] = patch.getCorner(i);
+		boundsCorners[i] = bounds.getCorner(i);
+	}
+
+	ShadowReceiverVolume volume;
+	volume.SetupIntersection(makeWorldToLight(), patchCorners, boundsCorners);
+	CHECK(volume.GetHull().size() == 4);
+	CHECK(volume.GetMaxDepth() == 0.f);
+
+	// The bounds cut the receivers
+	bounds = box3(float3(0.f, -100.f, -100.f), float3(2.f, 100.f, 100.f));
+	for (uint32_t i = 0; i < box3::numCorners; i++)
+		boundsCorners[i] = bounds.getCorner(i);
+
+	volume.SetupIntersection(makeWorldToLight(), patchCorners, boundsCorners);
+	CHECK(volume.CanShadowReceivers(box3(float3(0.5f, 5.f, -1.f), float3(1.5f, 6.f, 1.f))));
+	CHECK(!volume.CanShadowReceivers(box3(float3(-3.f, 5.f, -1.f), float3(-1.f, 6.f, 1.f))));
+	CHECK(!volume.CanShadowReceivers(box3(float3(3.f, 5.f, -1.f), float3(4.f, 6.f, 1.f))));
+}
+
+void test_cascade_box_receivers()
+{
+	// The view receives shadows up to 100 units, and the first cascade is fitted to the slice that ends at 10 units
+	float3 viewCorners[frustum::numCorners];
+	float3 sliceCorners[frustum::numCorners];
+	makeViewCorners(1.f, 100.f, viewCorners);
+	makeViewCorners(1.f, 10.f, sliceCorners);
+
+	// The box of the cascade is aligned with the light, which points down
+	box3 cascadeBox = box3(frustum::numCorners, sliceCorners);
+	float3 boxCorners[box3::numCorners];
+	for (uint32_t i = 0; i < box3::numCorners; i++)
+		boxCorners[i] = cascadeBox.getCorner(i);
+
+	// The ground at (10, 0, 10) is visible and inside the box, but about 14 units away, outside the slice.
+	// The shaders use the first cascade there, so a caster above it must be drawn into that cascade.
+	const box3 caster = box3(float3(9.5f, 12.f, 9.5f), float3(10.5f, 13.f, 10.5f));
+	CHECK(cascadeBox.contains(float3(10.f, 0.f, 10.f)));
+
+	ShadowReceiverVolume sliceVolume;
+	sliceVolume.Setup(makeWorldToLight(), sliceCorners, frustum::numCorners);
+	CHECK(!sliceVolume.CanShadowReceivers(caster));
+
+	ShadowReceiverVolume volume;
+	volume.SetupIntersection(makeWorldToLight(), viewCorners, boxCorners);
+	CHECK(volume.CanShadowReceivers(caster));
+
+	// Casters above visible ground outside the box use other cascades
+	CHECK(!volume.CanShadowReceivers(box3(float3(19.5f, 12.f, 19.5f), float3(20.5f, 13.f, 20.5f))));
+
+	// Casters above the box but closer than the near plane only shadow invisible ground
+	CHECK(!volume.CanShadowReceivers(box3(float3(0.1f, 12.f, 0.1f), float3(0.3f, 13.f, 0.3f))));
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_hull();
+		test_casters();
+		test_diagonal_edges();
+		test_intersection();
+		test_cascade_box_receivers();
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
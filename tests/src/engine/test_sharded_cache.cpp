@@ -0,0 +1,285 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/ShardedCache.h>
+#include <donut/tests/utils.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace donut;
+using namespace donut::engine;
+
+typedef std::shared_ptr<int> CachedValue;
+
+void test_sharded_cache()
+{
+	ShardedCache<size_t, CachedValue> cache;
+
+	int creations = 0;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (size_t key = 0; key < 100; ++key)
+		{
+			CachedValue value = cache.GetOrCreate(key, key, [&creations, key]() { ++creations; return std::make_shared<int>(int(key)); });
+			CHECK(value && *value == int(key));
+		}
+	}
+	CHECK(creations == 100);
+	CHECK(cache.Find(42, 42) && *cache.Find(42, 42) == 42);
+	CHECK(!cache.Find(1000, 1000));
+
+	cache.Insert(42, 42, std::make_shared<int>(-1));
+	CHECK(*cache.Find(42, 42) == -1);
+
+	cache.Erase(42, 42);
+	CHECK(!cache.Find(42, 42));
+
+	ShardedCacheStats stats = cache.GetStats();
+	CHECK(stats.size == 99);
+	CHECK(stats.evictions == 0);
+
+	cache.Clear();
+	CHECK(cache.GetStats().size == 0);
+}
+
+void test_sharded_cache_eviction()
+{
+	// A single shard makes the eviction order predictable
+	ShardedCache<size_t, CachedValue, 1> cache(4);
+
+	for (size_t key = 0; key < 4; ++key)
+		cache.Insert(key, key, std::make_shared<int>(int(key)));
+
+	// Use key 0 so that key 1 becomes the least recently used one
+	CHECK(cache.Find(0, 0));
+
+	cache.Insert(4, 4, std::make_shared<int>(4));
+
+	ShardedCacheStats stats = cache.GetStats();
+	CHECK(stats.size == 4);
+	CHECK(stats.evictions == 1);
+	CHECK(cache.Find(0, 0));
+	CHECK(!cache.Find(1, 1));
+	CHECK(cache.Find(4, 4));
+
+	// Keys 0 and 4 were used after the last eviction pass, so keys 2 and 3 go first
+	cache.Insert(5, 5, std::make_shared<int>(5));
+	cache.Insert(6, 6, std::make_shared<int>(6));
+	CHECK(cache.GetStats().evictions == 3);
+	CHECK(!cache.Find(2, 2));
+	CHECK(!cache.Find(3, 3));
+	CHECK(cache.Find(0, 0));
+	CHECK(cache.Find(4, 4));
+
+	// Erased entries leave the eviction list
+	cache.Erase(0, 0);
+	cache.Erase(5, 5);
+	cache.Insert(7, 7, std::make_shared<int>(7));
+	cache.Insert(8, 8, std::make_shared<int>(8));
+	CHECK(cache.GetStats().size == 4);
+	CHECK(cache.GetStats().evictions == 3);
+
+	// Many insertions keep the size at the capacity
+	for (size_t key = 100; key < 1100; ++key)
+		cache.Insert(key, key, std::make_shared<int>(int(key)));
+	CHECK(cache.GetStats().size == 4);
+	CHECK(cache.Find(1099, 1099));
+}
+
+void test_sharded_cache_update()
+{
+	ShardedCache<size_t, CachedValue> cache;
+
+	// Update creates a missing entry and returns what the function returns
+	int value = cache.Update(1, 1, [](CachedValue& cached)
+	{
+		if (!cached)
+			cached = std::make_shared<int>(10);
+		return *cached;
+	});
+	CHECK(value == 10);
+	CHECK(cache.GetStats().misses == 1);
+
+	// An existing entry is passed in and can be replaced
+	value = cache.Update(1, 1, [](CachedValue& cached)
+	{
+		CHECK(cached && *cached == 10);
+		cached = std::make_shared<int>(11);
+		return *cached;
+	});
+	CHECK(value == 11);
+	CHECK(*cache.Find(1, 1) == 11);
+	CHECK(cache.GetStats().misses == 1);
+}
+
+void test_sharded_cache_slow_creation()
+{
+	// A single shard, so that both keys share the lock
+	ShardedCache<size_t, CachedValue, 1> cache;
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool started = false;
+	bool release = false;
+	std::atomic<int> creations{ 0 };
+
+	auto createSlow = [&]()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		++creations;
+		started = true;
+		condition.notify_all();
+		condition.wait(lock, [&release]() { return release; });
+		return std::make_shared<int>(1);
+	};
+
+	CachedValue creatorResult, waiterResult;
+	std::thread creator([&]() { creatorResult = cache.GetOrCreate(1, 1, createSlow); });
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [&started]() { return started; });
+	}
+
+	// The shard is not locked during the creation, and the pending value is not visible yet
+	CachedValue other = cache.GetOrCreate(2, 2, []() { return std::make_shared<int>(2); });
+	CHECK(other && *other == 2);
+	CHECK(!cache.Find(1, 1));
+
+	// A second request for the same key waits for the first creation instead of starting another one
+	std::thread waiter([&]() { waiterResult = cache.GetOrCreate(1, 1, createSlow); });
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		release = true;
+	}
+	condition.notify_all();
+	creator.join();
+	waiter.join();
+
+	CHECK(creations == 1);
+	CHECK(creatorResult && *creatorResult == 1);
+	CHECK(waiterResult == creatorResult);
+	CHECK(cache.Find(1, 1) == creatorResult);
+	CHECK(cache.GetStats().misses == 2);
+}
+
+// Simulates parallel command list recording: every thread looks up the same working set of cached objects
+// many times. Compares the sharded cache against a map protected by a single mutex, like the caches used before.
+// The lookup results are checked on the main thread, because CHECK throws and must not escape a worker thread.
+template<typename LookupFunc>
+static double runLookupThreads(int threadCount, int lookupsPerThread, size_t keyCount, LookupFunc lookup)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::atomic<int> failedLookups{ 0 };
+	std::vector<std::thread> threads;
+	for (int thread = 0; thread < threadCount; ++thread)
+	{
+		threads.emplace_back([thread, lookupsPerThread, keyCount, &lookup, &failedLookups]()
+		{
+			int failures = 0;
+			size_t key = size_t(thread) * 7919;
+			for (int i = 0; i < lookupsPerThread; ++i)
+			{
+				key = (key * 1103515245 + 12345) % keyCount;
+				if (!lookup(key))
+					++failures;
+			}
+			failedLookups += failures;
+		});
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	CHECK(failedLookups == 0);
+
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void test_sharded_cache_contention()
+{
+	const int threadCount = std::max(4, int(std::thread::hardware_concurrency()));
+	const int lookupsPerThread = 200000;
+	const size_t keyCount = 1024;
+
+	std::unordered_map<size_t, CachedValue> lockedMap;
+	std::mutex mutex;
+	ShardedCache<size_t, CachedValue> cache;
+
+	for (size_t key = 0; key < keyCount; ++key)
+	{
+		lockedMap[key] = std::make_shared<int>(int(key));
+		cache.Insert(key, key, lockedMap[key]);
+	}
+
+	double lockedTime = runLookupThreads(threadCount, lookupsPerThread, keyCount, [&lockedMap, &mutex](size_t key)
+	{
+		CachedValue value;
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			auto it = lockedMap.find(key);
+			if (it != lockedMap.end())
+				value = it->second;
+		}
+		return value != nullptr;
+	});
+
+	double shardedTime = runLookupThreads(threadCount, lookupsPerThread, keyCount, [&cache](size_t key)
+	{
+		return cache.Find(key, key) != nullptr;
+	});
+
+	ShardedCacheStats stats = cache.GetStats();
+	CHECK(stats.size == keyCount);
+	CHECK(stats.misses == 0);
+
+	printf("%d threads x %d lookups: single mutex %.1f ms, sharded %.1f ms\n",
+		threadCount, lookupsPerThread, lockedTime, shardedTime);
+}
+
+int main(int, char** argv)
+{
+	try
+	{
+		test_sharded_cache();
+		test_sharded_cache_eviction();
+		test_sharded_cache_update();
+		test_sharded_cache_slow_creation();
+		test_sharded_cache_contention();
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
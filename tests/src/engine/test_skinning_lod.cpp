@@ -0,0 +1,182 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/SkinningPalette.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/SceneTypes.h>
+#include <donut/tests/utils.h>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+static const uint32_t c_InstanceCount = 12;
+static const uint32_t c_UpdateInterval = 4;
+
+struct SkinnedScene
+{
+	std::shared_ptr<SceneGraph> graph;
+	std::vector<std::shared_ptr<SceneGraphNode>> joints;
+};
+
+// Builds a scene with several skinned instances that have one joint each
+static SkinnedScene createScene()
+{
+	SkinnedScene scene;
+	scene.graph = std::make_shared<SceneGraph>();
+	auto factory = std::make_shared<SceneTypeFactory>();
+	auto root = std::make_shared<SceneGraphNode>();
+	scene.graph->SetRootNode(root);
+
+	auto prototype = std::make_shared<MeshInfo>();
+	prototype->buffers = std::make_shared<BufferGroup>();
+	prototype->geometries.push_back(std::make_shared<MeshGeometry>());
+
+	for (uint32_t instanceIndex = 0; instanceIndex < c_InstanceCount; instanceIndex++)
+	{
+		auto instance = std::make_shared<SkinnedMeshInstance>(factory, prototype);
+		scene.graph->AttachLeafNode(root, instance);
+
+		auto jointNode = std::make_shared<SceneGraphNode>();
+		scene.graph->Attach(root, jointNode);
+		jointNode->SetLeaf(std::make_shared<SkinnedMeshReference>(instance));
+
+		SkinnedMeshJoint joint;
+		joint.node = jointNode;
+		joint.inverseBindMatrix = float4x4::identity();
+		instance->joints.push_back(joint);
+		scene.joints.push_back(jointNode);
+	}
+
+	scene.graph->Refresh(0);
+	return scene;
+}
+
+// Runs the schedule for one frame like Scene does, and returns the number of instances skinned on this frame
+static uint32_t runFrame(SkinnedScene& scene, uint32_t frameIndex, bool animate, std::vector<uint32_t>& updateCounts)
+{
+	if (animate)
+	{
+		for (const auto& joint : scene.joints)
+			joint->SetTranslation(double3(double(frameIndex), 0.0, 0.0));
+	}
+	scene.graph->Refresh(frameIndex);
+
+	uint32_t skinnedInstances = 0;
+	uint32_t instanceIndex = 0;
+	for (const auto& instance : scene.graph->GetSkinnedMeshInstances())
+	{
+		if (ScheduleSkinningUpdate(*instance, frameIndex, instanceIndex, c_UpdateInterval) == SkinningUpdate::Scheduled)
+		{
+			instance->skinningInitialized = true;
+			++updateCounts[instanceIndex];
+			++skinnedInstances;
+		}
+		++instanceIndex;
+	}
+
+	return skinnedInstances;
+}
+
+void test_skinning_lod_schedule()
+{
+	SkinnedScene scene = createScene();
+	std::vector<uint32_t> updateCounts(c_InstanceCount, 0);
+
+	// All instances are skinned on the first frame, regardless of their schedule
+	CHECK(runFrame(scene, 1, true, updateCounts) == c_InstanceCount);
+
+	// While animated, every instance is skinned once per interval, and the updates are spread evenly over the frames
+	std::fill(updateCounts.begin(), updateCounts.end(), 0);
+	for (uint32_t frameIndex = 2; frameIndex < 2 + c_UpdateInterval * 3; frameIndex++)
+		CHECK(runFrame(scene, frameIndex, true, updateCounts) == c_InstanceCount / c_UpdateInterval);
+
+	for (uint32_t count : updateCounts)
+		CHECK(count == 3);
+
+	// After the animation stops, the instances that were not skinned on the last animated frame pick up
+	// the final pose on their next scheduled frame. Then every instance is skinned once more to settle
+	// the previous positions, and it stays idle.
+	const uint32_t stopFrame = 2 + c_UpdateInterval * 3;
+	std::vector<bool> upToDate;
+	for (const auto& instance : scene.graph->GetSkinnedMeshInstances())
+		upToDate.push_back(instance->lastSkinningFrameIndex == stopFrame - 1);
+
+	std::fill(updateCounts.begin(), updateCounts.end(), 0);
+	for (uint32_t frameIndex = stopFrame; frameIndex < stopFrame + c_UpdateInterval * 3; frameIndex++)
+		runFrame(scene, frameIndex, false, updateCounts);
+
+	for (uint32_t instanceIndex = 0; instanceIndex < c_InstanceCount; instanceIndex++)
+		CHECK(updateCounts[instanceIndex] == (upToDate[instanceIndex] ? 1u : 2u));
+
+	for (const auto& instance : scene.graph->GetSkinnedMeshInstances())
+	{
+		CHECK(instance->skinningSettled);
+		CHECK(ScheduleSkinningUpdate(*instance, stopFrame + c_UpdateInterval * 3, 0, c_UpdateInterval) == SkinningUpdate::Idle);
+	}
+}
+
+void test_skinning_lod_deferred_animation()
+{
+	SkinnedScene scene = createScene();
+	std::vector<uint32_t> updateCounts(c_InstanceCount, 0);
+	runFrame(scene, 1, true, updateCounts);
+
+	// Animate a single frame: instances that are not scheduled on it pick the animation up on their next frame
+	const uint32_t animatedFrame = 8;
+	scene.joints[1]->SetTranslation(double3(5.0, 0.0, 0.0));
+	scene.graph->Refresh(animatedFrame);
+
+	auto& instance = *scene.graph->GetSkinnedMeshInstances()[1];
+	CHECK(ScheduleSkinningUpdate(instance, animatedFrame, 1, c_UpdateInterval) == SkinningUpdate::Deferred);
+	CHECK(ScheduleSkinningUpdate(instance, animatedFrame + 1, 1, c_UpdateInterval) == SkinningUpdate::Deferred);
+	CHECK(ScheduleSkinningUpdate(instance, animatedFrame + 2, 1, c_UpdateInterval) == SkinningUpdate::Deferred);
+	CHECK(ScheduleSkinningUpdate(instance, animatedFrame + 3, 1, c_UpdateInterval) == SkinningUpdate::Scheduled);
+	CHECK(instance.lastSkinningFrameIndex == animatedFrame + 3);
+	CHECK(!instance.skinningSettled);
+
+	// The settling update comes one interval later
+	CHECK(ScheduleSkinningUpdate(instance, animatedFrame + 4, 1, c_UpdateInterval) == SkinningUpdate::Deferred);
+	CHECK(ScheduleSkinningUpdate(instance, animatedFrame + 7, 1, c_UpdateInterval) == SkinningUpdate::Scheduled);
+	CHECK(instance.skinningSettled);
+	CHECK(ScheduleSkinningUpdate(instance, animatedFrame + 11, 1, c_UpdateInterval) == SkinningUpdate::Idle);
+
+	// An interval of 1 or 0 updates on every animated frame
+	scene.joints[1]->SetTranslation(double3(6.0, 0.0, 0.0));
+	scene.graph->Refresh(animatedFrame + 12);
+	CHECK(ScheduleSkinningUpdate(instance, animatedFrame + 12, 1, 0) == SkinningUpdate::Scheduled);
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_skinning_lod_schedule();
+		test_skinning_lod_deferred_animation();
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,210 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/SkinningPalette.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/SceneTypes.h>
+#include <donut/tests/utils.h>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+#include <cmath>
+#include <cstring>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+static const int c_InstanceCount = 16;
+static const int c_JointCount = 5;
+
+// Builds a scene with several skinned instances far from the origin, each with a chain of joints
+static std::shared_ptr<SceneGraph> createScene()
+{
+	auto graph = std::make_shared<SceneGraph>();
+	auto factory = std::make_shared<SceneTypeFactory>();
+	auto root = std::make_shared<SceneGraphNode>();
+	graph->SetRootNode(root);
+
+	auto prototype = std::make_shared<MeshInfo>();
+	prototype->name = "Prototype";
+	prototype->buffers = std::make_shared<BufferGroup>();
+	prototype->objectSpaceBounds = box3(float3(-1.f), float3(1.f));
+	auto geometry = std::make_shared<MeshGeometry>();
+	geometry->objectSpaceBounds = prototype->objectSpaceBounds;
+	prototype->geometries.push_back(geometry);
+
+	for (int instanceIndex = 0; instanceIndex < c_InstanceCount; instanceIndex++)
+	{
+		auto instance = std::make_shared<SkinnedMeshInstance>(factory, prototype);
+
+		auto instanceNode = std::make_shared<SceneGraphNode>();
+		instanceNode->SetTranslation(double3(100000.0 + instanceIndex * 3.0, 2.0, -50000.0));
+		instanceNode->SetRotation(dquat(std::cos(0.05 * instanceIndex), 0.0, std::sin(0.05 * instanceIndex), 0.0));
+		instanceNode->SetLeaf(instance);
+		graph->Attach(root, instanceNode);
+
+		std::shared_ptr<SceneGraphNode> parent = instanceNode;
+		for (int jointIndex = 0; jointIndex < c_JointCount; jointIndex++)
+		{
+			auto jointNode = std::make_shared<SceneGraphNode>();
+			jointNode->SetTranslation(double3(0.0, 0.5 + jointIndex * 0.25, 0.1 * instanceIndex));
+			jointNode->SetRotation(dquat(std::cos(0.1 * (jointIndex + 1)), std::sin(0.1 * (jointIndex + 1)), 0.0, 0.0));
+			graph->Attach(parent, jointNode);
+			jointNode->SetLeaf(std::make_shared<SkinnedMeshReference>(instance));
+
+			SkinnedMeshJoint joint;
+			joint.node = jointNode;
+			joint.inverseBindMatrix = affineToHomogeneous(translation(float3(0.f, -0.5f * float(jointIndex), 0.f)));
+			instance->joints.push_back(joint);
+
+			parent = jointNode;
+		}
+	}
+
+	graph->Refresh(0);
+	return graph;
+}
+
+static std::vector<const SkinnedMeshInstance*> getInstances(const SceneGraph& graph)
+{
+	std::vector<const SkinnedMeshInstance*> instances;
+	for (const auto& instance : graph.GetSkinnedMeshInstances())
+		instances.push_back(instance.get());
+	return instances;
+}
+
+// The palette matches inverseBindMatrix * jointToWorld * worldToRoot computed in double precision
+void test_skinning_palette_reference()
+{
+	auto graph = createScene();
+	auto instances = getInstances(*graph);
+
+	SkinningPalette palette;
+	palette.SetInstances(graph->GetSkinnedMeshInstances());
+	CHECK(palette.GetJointCount() == size_t(c_InstanceCount * c_JointCount));
+
+	uint32_t computedJoints = palette.Compute(instances.data(), nullptr, instances.size());
+	CHECK(computedJoints == uint32_t(c_InstanceCount * c_JointCount));
+
+	for (const SkinnedMeshInstance* instance : instances)
+	{
+		CHECK(instance->jointBufferOffset % c_JointCount == 0);
+
+		const daffine3 worldToRoot = inverse(instance->GetNode()->GetLocalToWorldTransform());
+		for (size_t jointIndex = 0; jointIndex < instance->joints.size(); jointIndex++)
+		{
+			const auto& joint = instance->joints[jointIndex];
+			const daffine3 jointToRoot = joint.node.lock()->GetLocalToWorldTransform() * worldToRoot;
+			const float4x4 expected = joint.inverseBindMatrix * affineToHomogeneous(affine3(jointToRoot));
+			const float4x4& actual = palette.GetJointMatrices()[instance->jointBufferOffset + jointIndex];
+
+			for (int element = 0; element < 16; element++)
+				CHECK(std::abs(actual.m_data[element] - expected.m_data[element]) < 1e-4f);
+		}
+	}
+}
+
+// Joints below the LOD depth copy the matrix of their ancestor at that depth
+void test_skinning_palette_lod()
+{
+	auto graph = createScene();
+	auto instances = getInstances(*graph);
+
+	SkinningPalette palette;
+	palette.SetInstances(graph->GetSkinnedMeshInstances());
+
+	std::vector<uint32_t> maxJointDepths(instances.size(), 1u);
+	uint32_t computedJoints = palette.Compute(instances.data(), maxJointDepths.data(), instances.size());
+	CHECK(computedJoints == uint32_t(c_InstanceCount * 2));
+
+	for (const SkinnedMeshInstance* instance : instances)
+	{
+		const float4x4* matrices = palette.GetJointMatrices() + instance->jointBufferOffset;
+		for (int jointIndex = 0; jointIndex < c_JointCount; jointIndex++)
+		{
+			CHECK(palette.GetJointDepth(instance->jointBufferOffset + jointIndex) == uint32_t(jointIndex));
+			if (jointIndex > 1)
+				CHECK(memcmp(&matrices[jointIndex], &matrices[1], sizeof(float4x4)) == 0);
+		}
+	}
+}
+
+// The parallel computation produces exactly the same palette as the serial one
+void test_skinning_palette_parallel()
+{
+#ifdef DONUT_WITH_TASKFLOW
+	auto graph = createScene();
+	auto instances = getInstances(*graph);
+
+	SkinningPalette serialPalette;
+	serialPalette.SetInstances(graph->GetSkinnedMeshInstances());
+	uint32_t serialJoints = serialPalette.Compute(instances.data(), nullptr, instances.size());
+
+	SkinningPalette parallelPalette;
+	parallelPalette.SetInstances(graph->GetSkinnedMeshInstances());
+	tf::Executor executor(4);
+	uint32_t parallelJoints = parallelPalette.Compute(instances.data(), nullptr, instances.size(), &executor);
+
+	CHECK(serialJoints == parallelJoints);
+	CHECK(serialPalette.GetJointCount() == parallelPalette.GetJointCount());
+	CHECK(memcmp(serialPalette.GetJointMatrices(), parallelPalette.GetJointMatrices(),
+		serialPalette.GetJointCount() * sizeof(float4x4)) == 0);
+
+	// A partial update with mixed LOD depths only touches the selected instances
+	std::vector<const SkinnedMeshInstance*> subset;
+	std::vector<uint32_t> maxJointDepths;
+	for (size_t index = 0; index < instances.size(); index += 3)
+	{
+		subset.push_back(instances[index]);
+		maxJointDepths.push_back(uint32_t(index % 4));
+	}
+
+	graph->GetRootNode()->GetChild(0)->SetTranslation(double3(-7.0, 3.0, 1.0));
+	graph->Refresh(1);
+
+	serialJoints = serialPalette.Compute(subset.data(), maxJointDepths.data(), subset.size());
+	parallelJoints = parallelPalette.Compute(subset.data(), maxJointDepths.data(), subset.size(), &executor);
+
+	CHECK(serialJoints == parallelJoints);
+	CHECK(memcmp(serialPalette.GetJointMatrices(), parallelPalette.GetJointMatrices(),
+		serialPalette.GetJointCount() * sizeof(float4x4)) == 0);
+#endif
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_skinning_palette_reference();
+		test_skinning_palette_lod();
+		test_skinning_palette_parallel();
+	}
+	catch (const std::runtime_error & err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,176 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/engine/SoftwareOcclusion.h>
+#include <donut/tests/utils.h>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+// The camera is at the origin looking along +Z, with a 90 degree vertical field of view
+static float4x4 makeProjection(bool reverseDepth)
+{
+	const float aspect = 2.f;
+	return reverseDepth
+		? perspProjD3DStyleReverse(radians(90.f), aspect, 0.1f)
+		: perspProjD3DStyle(radians(90.f), aspect, 0.1f, 100.f);
+}
+
+// Rasterizes a square wall at the given distance, covering [-halfSize, halfSize] in X and Y
+static void rasterizeWall(SoftwareOcclusionBuffer& buffer, float distance, float halfSize)
+{
+	const float3 positions[] = {
+		float3(-halfSize, -halfSize, distance),
+		float3(halfSize, -halfSize, distance),
+		float3(halfSize, halfSize, distance),
+		float3(-halfSize, halfSize, distance)
+	};
+	const uint32_t indices[] = { 0, 1, 2, 0, 2, 3 };
+
+	uint32_t triangles = buffer.RasterizeTriangles(positions, indices, 6, affine3::identity());
+	CHECK(triangles == 2);
+}
+
+void test_occlusion(bool reverseDepth)
+{
+	SoftwareOcclusionBuffer buffer(250, 125);
+	CHECK(buffer.GetWidth() == 256);
+	CHECK(buffer.GetHeight() == 128);
+
+	buffer.Begin(makeProjection(reverseDepth), reverseDepth);
+	rasterizeWall(buffer, 10.f, 5.f);
+	buffer.End();
+
+	// The wall covers the middle half of the buffer vertically and the middle quarter horizontally
+	float centerDepth = buffer.GetDepth(buffer.GetWidth() / 2, buffer.GetHeight() / 2);
+	CHECK(centerDepth > 0.f && centerDepth < 1.f);
+	CHECK(buffer.GetDepth(2, 2) == 1.f);
+
+	// Behind the wall
+	CHECK(!buffer.IsBoxVisible(box3(float3(-1.f, -1.f, 20.f), float3(1.f, 1.f, 21.f))));
+
+	// Partially behind the wall, partially beside it
+	CHECK(buffer.IsBoxVisible(box3(float3(3.f, -1.f, 20.f), float3(14.f, 1.f, 21.f))));
+
+	// In front of the wall
+	CHECK(buffer.IsBoxVisible(box3(float3(-1.f, -1.f, 5.f), float3(1.f, 1.f, 6.f))));
+
+	// Intersecting the wall
+	CHECK(buffer.IsBoxVisible(box3(float3(-1.f, -1.f, 9.f), float3(1.f, 1.f, 11.f))));
+
+	// Beside the wall
+	CHECK(buffer.IsBoxVisible(box3(float3(12.f, -1.f, 20.f), float3(14.f, 1.f, 21.f))));
+
+	// Crossing the near plane
+	CHECK(buffer.IsBoxVisible(box3(float3(-1.f, -1.f, -1.f), float3(1.f, 1.f, 21.f))));
+
+	// Outside of the view
+	CHECK(!buffer.IsBoxVisible(box3(float3(100.f, -1.f, 20.f), float3(101.f, 1.f, 21.f))));
+
+	CHECK(fabsf(buffer.GetScreenSize(box3(float3(-5.f, -5.f, 10.f), float3(5.f, 5.f, 10.f))) - 0.5f) < 1e-3f);
+	CHECK(buffer.GetScreenSize(box3(float3(-1.f, -1.f, -1.f), float3(1.f, 1.f, 1.f))) == 1.f);
+}
+
+void test_occluder_transform()
+{
+	SoftwareOcclusionBuffer buffer(128, 64);
+	buffer.Begin(makeProjection(false), false);
+
+	// The same wall, moved to the right so that it hides the box only after the transform
+	rasterizeWall(buffer, 10.f, 2.f);
+	buffer.End();
+	CHECK(buffer.IsBoxVisible(box3(float3(5.f, -1.f, 20.f), float3(7.f, 1.f, 21.f))));
+
+	buffer.Begin(makeProjection(false), false);
+	const float3 positions[] = { float3(-2.f, -2.f, 0.f), float3(2.f, -2.f, 0.f), float3(2.f, 2.f, 0.f), float3(-2.f, 2.f, 0.f) };
+	const uint32_t indices[] = { 0, 2, 1, 0, 3, 2 }; // opposite winding, triangles are not culled by orientation
+	buffer.RasterizeTriangles(positions, indices, 6, translation(float3(3.f, 0.f, 10.f)));
+	buffer.End();
+	CHECK(!buffer.IsBoxVisible(box3(float3(5.f, -1.f, 20.f), float3(7.f, 1.f, 21.f))));
+}
+
+void test_occluder_edges()
+{
+	// 128 pixels cover [-2, 2] in X / Z, so the wall's right edge at X / Z = 0.4875 lands at x = 79.6.
+	// Pixel 79 has its center under the wall and is covered, even though a part of it is not.
+	SoftwareOcclusionBuffer buffer(128, 64);
+	buffer.Begin(makeProjection(false), false);
+	rasterizeWall(buffer, 10.f, 4.875f);
+	buffer.End();
+	CHECK(buffer.GetDepth(79, 32) < 1.f);
+	CHECK(buffer.GetDepth(80, 32) == 1.f);
+
+	// A thin box that projects to x = [79.7, 79.9], within pixel 79 but entirely beside the wall
+	CHECK(buffer.IsBoxVisible(box3(float3(9.8125f, -1.f, 20.f), float3(9.9375f, 1.f, 20.01f))));
+
+	// The same box, moved behind the wall
+	CHECK(!buffer.IsBoxVisible(box3(float3(7.8125f, -1.f, 20.f), float3(7.9375f, 1.f, 20.01f))));
+}
+
+void test_near_plane_clipping()
+{
+	SoftwareOcclusionBuffer buffer(128, 64);
+	buffer.Begin(makeProjection(false), false);
+
+	// A floor that starts behind the camera and extends forward
+	const float3 positions[] = { float3(-50.f, -1.f, -10.f), float3(50.f, -1.f, -10.f), float3(0.f, -1.f, 50.f) };
+	const uint32_t indices[] = { 0, 1, 2 };
+	CHECK(buffer.RasterizeTriangles(positions, indices, 3, affine3::identity()) == 1);
+	buffer.End();
+
+	bool anyCovered = false;
+	for (uint32_t y = 0; y < buffer.GetHeight(); y++)
+	{
+		for (uint32_t x = 0; x < buffer.GetWidth(); x++)
+		{
+			float depth = buffer.GetDepth(x, y);
+			CHECK(depth >= 0.f && depth <= 1.f);
+			anyCovered = anyCovered || depth < 1.f;
+		}
+	}
+	CHECK(anyCovered);
+
+	// Under the floor
+	CHECK(!buffer.IsBoxVisible(box3(float3(-1.f, -5.f, 10.f), float3(1.f, -4.f, 12.f))));
+
+	// Above the floor
+	CHECK(buffer.IsBoxVisible(box3(float3(-1.f, 0.f, 10.f), float3(1.f, 1.f, 12.f))));
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_occlusion(false);
+		test_occlusion(true);
+		test_occluder_transform();
+		test_occluder_edges();
+		test_near_plane_clipping();
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,117 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/render/GpuCullingPass.h>
+#include <donut/engine/View.h>
+#include <donut/tests/engine_utils.h>
+#include <donut/tests/utils.h>
+#include <random>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+static bool isBoxInFrustum(const float4 planes[6], const affine3& transform, const box3& bounds)
+{
+	float columnMajor[12];
+	affineToColumnMajor(transform, columnMajor);
+	return GpuCullingPass::IsBoxInFrustum(planes, columnMajor, bounds);
+}
+
+void test_gpu_culling_planes()
+{
+	PlanarView view = makeView(1280, 720, radians(60.f));
+	float4 planes[6];
+	GpuCullingPass::GetFrustumPlanes(view.GetViewFrustum(), planes);
+
+	const box3 unitBox(float3(-0.5f), float3(0.5f));
+
+	// The translation is taken from the instance transform, not from the bounds
+	CHECK(isBoxInFrustum(planes, translation(float3(0.f, 0.f, 5.f)), unitBox));
+	CHECK(!isBoxInFrustum(planes, translation(float3(0.f, 0.f, -5.f)), unitBox));
+	CHECK(!isBoxInFrustum(planes, translation(float3(100.f, 0.f, 5.f)), unitBox));
+	CHECK(!isBoxInFrustum(planes, affine3::identity(), box3(float3(-0.5f, -0.5f, -5.5f), float3(0.5f, 0.5f, -4.5f))));
+
+	// A long thin box behind the camera that the rotation swings into view
+	const box3 stick(float3(-0.1f, -0.1f, -20.f), float3(0.1f, 0.1f, -10.f));
+	CHECK(!isBoxInFrustum(planes, affine3::identity(), stick));
+	CHECK(isBoxInFrustum(planes, rotation(float3(0.f, 1.f, 0.f), PI_f), stick));
+
+	// Scaling grows the box around the instance origin until it reaches the view
+	CHECK(!isBoxInFrustum(planes, translation(float3(0.f, 0.f, -2.f)), unitBox));
+	CHECK(isBoxInFrustum(planes, scaling(float3(10.f)) * translation(float3(0.f, 0.f, -2.f)), unitBox));
+}
+
+// Compares the shader math with frustum::intersectsWith on the transformed bounds
+void test_gpu_culling_reference()
+{
+	PlanarView view = makeView(1280, 720, radians(60.f));
+	const frustum viewFrustum = view.GetViewFrustum();
+	float4 planes[6];
+	GpuCullingPass::GetFrustumPlanes(viewFrustum, planes);
+
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> position(-30.f, 30.f);
+	std::uniform_real_distribution<float> size(0.01f, 4.f);
+	std::uniform_real_distribution<float> scale(0.1f, 3.f);
+	std::uniform_real_distribution<float> angle(-PI_f, PI_f);
+
+	int visible = 0, culled = 0;
+	for (int i = 0; i < 20000; i++)
+	{
+		const float3 boxCenter(position(rng) * 0.1f, position(rng) * 0.1f, position(rng) * 0.1f);
+		const float3 boxExtent(size(rng), size(rng), size(rng));
+		const box3 bounds(boxCenter - boxExtent, boxCenter + boxExtent);
+
+		const float3 axis = normalize(float3(angle(rng), angle(rng), angle(rng)) + float3(0.01f));
+		const affine3 transform = scaling(float3(scale(rng), scale(rng), scale(rng)))
+			* rotation(axis, angle(rng))
+			* translation(float3(position(rng), position(rng), position(rng)));
+
+		// Skip the boxes that touch a plane, where the rounding of the two methods can differ
+		const box3 worldBounds = bounds * transform;
+		const bool reference = viewFrustum.intersectsWith(worldBounds);
+		if (viewFrustum.intersectsWith(worldBounds.grow(-1e-3f)) != viewFrustum.intersectsWith(worldBounds.grow(1e-3f)))
+			continue;
+
+		CHECK(isBoxInFrustum(planes, transform, bounds) == reference);
+		(reference ? visible : culled)++;
+	}
+
+	CHECK(visible > 1000 && culled > 1000);
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_gpu_culling_planes();
+		test_gpu_culling_reference();
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,205 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/render/HzbCullingPass.h>
+#include <donut/engine/View.h>
+#include <donut/tests/engine_utils.h>
+#include <donut/tests/utils.h>
+#include <vector>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+struct HzbLoad
+{
+	int x;
+	int y;
+	uint32_t mip;
+};
+
+// Tests a box against an HZB where every texel contains hzbDepth, and records the texels that were read
+static bool isBoxOccluded(const float4x4& viewProjection, uint32_t mipLevels, const box3& box, float hzbDepth, std::vector<HzbLoad>& loads)
+{
+	const uint2 hzbSize(64, 32);
+	loads.clear();
+	return HzbCullingPass::IsBoxOccluded(viewProjection, false, hzbSize, mipLevels, box.center(), box.diagonal() * 0.5f,
+		[&](int x, int y, uint32_t mip)
+		{
+			CHECK(mip < mipLevels);
+			CHECK(x >= 0 && x < std::max(int(hzbSize.x >> mip), 1));
+			CHECK(y >= 0 && y < std::max(int(hzbSize.y >> mip), 1));
+			loads.push_back({ x, y, mip });
+			return hzbDepth;
+		});
+}
+
+static box3 makeSquare(float halfSize, float distance)
+{
+	return box3(float3(-halfSize, -halfSize, distance), float3(halfSize, halfSize, distance));
+}
+
+// With the 128x64 test view, the plane at Z = 10 covers [-20, 20] in X and [-10, 10] in Y,
+// which is 1.6 texels per unit of a 64x32 HZB.
+void test_hzb_mip_selection()
+{
+	const float4x4 viewProjection = makeView(128, 64, radians(90.f), 100.f).GetViewProjectionMatrix();
+	std::vector<HzbLoad> loads;
+
+	// The rectangle is at most one texel wide in the selected level, and the test reads its 2x2 corners
+	const struct { float halfSize; uint32_t mip; } cases[] = {
+		{ 0.25f, 0 },   // 0.8 texels
+		{ 0.5f, 1 },    // 1.6 texels
+		{ 2.5f, 3 },    // 8 texels
+		{ 2.55f, 4 },   // 8.16 texels
+		{ 9.f, 5 },     // 28.8 texels
+	};
+
+	for (const auto& c : cases)
+	{
+		CHECK(isBoxOccluded(viewProjection, 7, makeSquare(c.halfSize, 10.f), 0.5f, loads));
+		CHECK(loads.size() == 4);
+		for (const HzbLoad& load : loads)
+			CHECK(load.mip == c.mip);
+	}
+
+	// The level is clamped to the last one of the chain
+	CHECK(isBoxOccluded(viewProjection, 3, makeSquare(9.f, 10.f), 0.5f, loads));
+	CHECK(loads.size() == 4 && loads[0].mip == 2);
+
+	// A box that covers the whole HZB at the last level reads its single texel
+	CHECK(isBoxOccluded(viewProjection, 7, makeSquare(50.f, 10.f), 0.5f, loads));
+	for (const HzbLoad& load : loads)
+		CHECK(load.mip == 6 && load.x == 0 && load.y == 0);
+
+	// Texels in the top left corner, up is -Y in texture space
+	CHECK(isBoxOccluded(viewProjection, 7, box3(float3(-19.5f, 9.5f, 10.f), float3(-19.f, 9.9f, 10.f)), 0.5f, loads));
+	for (const HzbLoad& load : loads)
+		CHECK(load.mip == 0 && load.x <= 1 && load.y == 0);
+}
+
+void test_hzb_occlusion()
+{
+	const float4x4 viewProjection = makeView(128, 64, radians(90.f), 100.f).GetViewProjectionMatrix();
+	std::vector<HzbLoad> loads;
+
+	// The depth of the occluders is compared with the nearest depth of the box
+	CHECK(isBoxOccluded(viewProjection, 7, makeSquare(1.f, 10.f), 0.5f, loads));
+	CHECK(!isBoxOccluded(viewProjection, 7, makeSquare(1.f, 10.f), 1.f, loads));
+	CHECK(!isBoxOccluded(viewProjection, 7, box3(float3(-1.f, -1.f, 0.5f), float3(1.f, 1.f, 10.f)), 0.9f, loads));
+
+	// Crossing the near plane
+	CHECK(!isBoxOccluded(viewProjection, 7, box3(float3(-1.f, -1.f, -1.f), float3(1.f, 1.f, 10.f)), 0.f, loads));
+	CHECK(loads.empty());
+
+	// Outside of the view that the HZB was built for
+	CHECK(!isBoxOccluded(viewProjection, 7, box3(float3(30.f, -1.f, 10.f), float3(32.f, 1.f, 10.f)), 0.f, loads));
+	CHECK(loads.empty());
+}
+
+// Exposes the history management, which doesn't need a device
+class TestHzbCullingPass : public HzbCullingPass
+{
+public:
+	TestHzbCullingPass() : HzbCullingPass(nullptr, nullptr) { }
+
+	void SetItemBuffer(nvrhi::IBuffer* buffer) { m_ItemBuffer = buffer; }
+
+	// Fills the history like RenderViewTwoPhase does
+	ViewHistory& Render(const IView& view)
+	{
+		ViewHistory& history = GetViewHistory(view);
+		if (!history.visibilityBuffer)
+			history.visibilityBuffer = nvrhi::BufferHandle::Create(new TestBuffer());
+		history.cullingBindingSet = nvrhi::BindingSetHandle::Create(new TestBindingSet());
+		history.hzbValid = true;
+		return history;
+	}
+
+	ViewHistory& GetHistory(const IView& view) { return GetViewHistory(view); }
+};
+
+void test_hzb_history()
+{
+	PlanarView viewA = makeView(128, 64, radians(90.f), 100.f);
+	PlanarView viewB = makeView(128, 64, radians(90.f), 100.f);
+	nvrhi::BufferHandle itemBufferA = nvrhi::BufferHandle::Create(new TestBuffer());
+	nvrhi::BufferHandle itemBufferB = nvrhi::BufferHandle::Create(new TestBuffer());
+
+	TestHzbCullingPass pass;
+	pass.SetItemBuffer(itemBufferA);
+
+	nvrhi::IBuffer* visibilityA = pass.Render(viewA).visibilityBuffer;
+	CHECK(visibilityA != nullptr);
+
+	// The history is kept between frames
+	CHECK(pass.Render(viewA).visibilityBuffer == visibilityA);
+
+	// Every view has its own history
+	CHECK(&pass.GetHistory(viewB) != &pass.GetHistory(viewA));
+	CHECK(!pass.GetHistory(viewB).visibilityBuffer);
+	CHECK(!pass.GetHistory(viewB).hzbValid);
+	pass.Render(viewB);
+
+	// A new item buffer invalidates the visibility of every view, but not their HZB
+	pass.SetItemBuffer(itemBufferB);
+	for (const PlanarView* view : { &viewA, &viewB })
+	{
+		auto& history = pass.GetHistory(*view);
+		CHECK(!history.visibilityBuffer);
+		CHECK(!history.cullingBindingSet);
+		CHECK(history.hzbValid);
+		CHECK(history.itemBuffer == itemBufferB);
+	}
+
+	// Resetting forgets both
+	pass.Render(viewA);
+	pass.Render(viewB);
+	pass.ResetHistory();
+	for (const PlanarView* view : { &viewA, &viewB })
+	{
+		auto& history = pass.GetHistory(*view);
+		CHECK(!history.visibilityBuffer);
+		CHECK(!history.hzbValid);
+	}
+
+	pass.ReleaseViewHistory(&viewB);
+	CHECK(!pass.GetOcclusionStats(viewB).valid);
+	CHECK(!pass.GetHzbTexture(viewB));
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_hzb_mip_selection();
+		test_hzb_occlusion();
+		test_hzb_history();
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,202 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/render/GeometryPasses.h>
+#include <donut/render/DrawStrategy.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/SceneTypes.h>
+#include <donut/tests/engine_utils.h>
+#include <donut/tests/utils.h>
+
+using namespace donut;
+using namespace donut::engine;
+using namespace donut::render;
+
+// Returns a fixed list of items, like a strategy that has already culled and sorted the scene
+class ListDrawStrategy : public IDrawStrategy
+{
+public:
+	std::vector<DrawItem> items;
+
+	void PrepareForView(const std::shared_ptr<SceneGraphNode>& rootNode, const IView& view) override { }
+
+	const DrawItem* GetNextItem() override
+	{
+		return m_Next < items.size() ? &items[m_Next++] : nullptr;
+	}
+
+private:
+	size_t m_Next = 0;
+};
+
+static std::shared_ptr<MeshInfo> CreateMesh(const std::shared_ptr<BufferGroup>& buffers, uint32_t indexOffset)
+{
+	auto geometry = std::make_shared<MeshGeometry>();
+	geometry->numIndices = 3;
+	geometry->numVertices = 3;
+
+	auto mesh = std::make_shared<MeshInfo>();
+	mesh->buffers = buffers;
+	mesh->indexOffset = indexOffset;
+	mesh->totalIndices = 3;
+	mesh->totalVertices = 3;
+	mesh->geometries.push_back(geometry);
+	return mesh;
+}
+
+void test_instance_groups()
+{
+	auto buffers = std::make_shared<BufferGroup>();
+	auto meshA = CreateMesh(buffers, 0);
+	auto meshB = CreateMesh(buffers, 3);
+	auto meshC = CreateMesh(buffers, 6);
+	auto material = std::make_shared<Material>();
+
+	// Instances 0-5 alternate between A and B, instances 6 and 7 use C
+	auto graph = std::make_shared<SceneGraph>();
+	auto root = std::make_shared<SceneGraphNode>();
+	graph->SetRootNode(root);
+
+	std::vector<std::shared_ptr<MeshInstance>> instances;
+	for (int i = 0; i < 8; i++)
+	{
+		auto instance = std::make_shared<MeshInstance>(i < 6 ? (i & 1 ? meshB : meshA) : meshC);
+		auto node = std::make_shared<SceneGraphNode>();
+		node->SetLeaf(instance);
+		graph->Attach(root, node);
+		instances.push_back(instance);
+	}
+	graph->Refresh(0);
+
+	for (int i = 0; i < 8; i++)
+		CHECK(instances[i]->GetInstanceIndex() == i);
+
+	auto makeItem = [&](int instance, const Material* itemMaterial, nvrhi::RasterCullMode cullMode = nvrhi::RasterCullMode::Back, uint32_t lod = 0)
+	{
+		const MeshInfo* mesh = instances[instance]->GetMesh().get();
+		DrawItem item{};
+		item.instance = instances[instance].get();
+		item.mesh = mesh;
+		item.geometry = mesh->geometries[0].get();
+		item.material = itemMaterial;
+		item.buffers = mesh->buffers.get();
+		item.cullMode = cullMode;
+		item.lod = lod;
+		return item;
+	};
+
+	ListDrawStrategy strategy;
+	strategy.items = {
+		makeItem(0, material.get()),
+		makeItem(1, material.get()),
+		makeItem(2, material.get()),
+		makeItem(3, nullptr),
+		makeItem(3, material.get()),
+		makeItem(4, material.get()),
+		makeItem(4, material.get(), nvrhi::RasterCullMode::None),
+		makeItem(5, material.get()),
+		makeItem(2, material.get(), nvrhi::RasterCullMode::Back, 1),
+		makeItem(6, material.get()),
+		makeItem(7, material.get())
+	};
+
+	std::vector<InstanceGroup> groups;
+	InstancingStats stats;
+	CollectInstanceGroups(strategy, groups, stats);
+
+	// Groups appear in the order of their first item, items without a material are skipped
+	CHECK(stats.drawItems == 10);
+	CHECK(groups.size() == 5);
+	CHECK(groups[0].item.mesh == meshA.get() && groups[0].instances == std::vector<uint32_t>({ 0, 2, 4 }));
+	CHECK(groups[1].item.mesh == meshB.get() && groups[1].instances == std::vector<uint32_t>({ 1, 3, 5 }));
+	CHECK(groups[2].item.cullMode == nvrhi::RasterCullMode::None && groups[2].instances == std::vector<uint32_t>({ 4 }));
+	CHECK(groups[3].item.lod == 1 && groups[3].instances == std::vector<uint32_t>({ 2 }));
+	CHECK(groups[4].item.mesh == meshC.get() && groups[4].instances == std::vector<uint32_t>({ 6, 7 }));
+
+	// Without groups, only the consecutive instances of C would have been merged
+	CHECK(groups[0].drawCallsWithoutGroups == 3);
+	CHECK(groups[1].drawCallsWithoutGroups == 3);
+	CHECK(groups[2].drawCallsWithoutGroups == 1);
+	CHECK(groups[3].drawCallsWithoutGroups == 1);
+	CHECK(groups[4].drawCallsWithoutGroups == 1);
+}
+
+void test_input_binding_set_cache()
+{
+	InputBindingSetCache cache;
+	BufferGroup groupA, groupB;
+
+	auto createSet = []() { return nvrhi::BindingSetHandle::Create(new TestBindingSet()); };
+	auto createBuffer = []() { return nvrhi::BufferHandle::Create(new TestBuffer()); };
+
+	// The sets without indirection and with different indirection buffers are separate
+	nvrhi::BufferHandle first = createBuffer();
+	nvrhi::BufferHandle second = createBuffer();
+	nvrhi::BindingSetHandle direct = createSet();
+	nvrhi::BindingSetHandle indirectFirst = createSet();
+	nvrhi::BindingSetHandle indirectSecond = createSet();
+	cache.Insert(&groupA, nullptr, direct);
+	cache.Insert(&groupA, first, indirectFirst);
+	cache.Insert(&groupA, second, indirectSecond);
+	CHECK(cache.Find(&groupA, nullptr) == direct);
+	CHECK(cache.Find(&groupA, first) == indirectFirst);
+	CHECK(cache.Find(&groupA, second) == indirectSecond);
+	CHECK(!cache.Find(&groupB, first));
+
+	// Alternating between two indirection buffers, e.g. two views, keeps both sets
+	for (int i = 0; i < 4; i++)
+	{
+		CHECK(cache.Find(&groupA, i & 1 ? first : second));
+		CHECK(cache.Find(&groupA, i & 1 ? second : first));
+	}
+
+	// Only the sets of the most recently used indirection buffers are kept; the second one was used last above
+	std::vector<nvrhi::BufferHandle> replacements;
+	for (size_t i = 0; i < InputBindingSetCache::MaxIndirectionBuffers - 1; i++)
+	{
+		replacements.push_back(createBuffer());
+		cache.Insert(&groupA, replacements.back(), createSet());
+	}
+	CHECK(!cache.Find(&groupA, first));
+	CHECK(cache.Find(&groupA, second) == indirectSecond);
+	CHECK(cache.Find(&groupA, nullptr) == direct);
+	CHECK(cache.GetSize() == InputBindingSetCache::MaxIndirectionBuffers + 1);
+
+	cache.Clear();
+	CHECK(cache.GetSize() == 0);
+	CHECK(!cache.Find(&groupA, nullptr));
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_instance_groups();
+		test_input_binding_set_cache();
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,191 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/render/GeometryPasses.h>
+#include <donut/render/DrawStrategy.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/SceneTypes.h>
+#include <donut/engine/View.h>
+#include <donut/tests/engine_utils.h>
+#include <donut/tests/utils.h>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+static std::shared_ptr<MeshInfo> makeMesh(const std::shared_ptr<BufferGroup>& buffers, const std::shared_ptr<Material>& material,
+	uint32_t vertexOffset, uint32_t numVertices, uint32_t indexOffset, uint32_t numIndices, const box3& bounds)
+{
+	auto geometry = std::make_shared<MeshGeometry>();
+	geometry->material = material;
+	geometry->numVertices = numVertices;
+	geometry->numIndices = numIndices;
+	geometry->objectSpaceBounds = bounds;
+
+	auto mesh = std::make_shared<MeshInfo>();
+	mesh->buffers = buffers;
+	mesh->vertexOffset = vertexOffset;
+	mesh->totalVertices = numVertices;
+	mesh->indexOffset = indexOffset;
+	mesh->totalIndices = numIndices;
+	mesh->objectSpaceBounds = bounds;
+	mesh->geometries.push_back(geometry);
+	return mesh;
+}
+
+// A buffer group with a small triangle followed by a wall at Z = 10 that covers [-5, 5] in X and Y
+static std::shared_ptr<BufferGroup> makeBuffers()
+{
+	auto buffers = std::make_shared<BufferGroup>();
+	buffers->positionData = {
+		float3(-0.5f, -0.5f, 0.f), float3(0.5f, -0.5f, 0.f), float3(0.f, 0.5f, 0.f),
+		float3(-5.f, -5.f, 10.f), float3(5.f, -5.f, 10.f), float3(5.f, 5.f, 10.f), float3(-5.f, 5.f, 10.f)
+	};
+	buffers->indexData = { 0, 1, 2, 0, 1, 2, 0, 2, 3 };
+	return buffers;
+}
+
+// Releases the CPU data like Scene::CreateMeshBuffers does after uploading it
+static void releaseCpuData(BufferGroup& buffers)
+{
+	std::vector<uint32_t>().swap(buffers.indexData);
+	std::vector<float3>().swap(buffers.positionData);
+	buffers.indexDataView = nullptr;
+	buffers.vertexDataViews.fill(nullptr);
+}
+
+void test_copy_occluder_geometry()
+{
+	auto material = std::make_shared<Material>();
+	const box3 bounds(float3(-5.f, -5.f, 10.f), float3(5.f, 5.f, 10.f));
+
+	auto buffers = makeBuffers();
+	auto wall = makeMesh(buffers, material, 3, 4, 3, 6, bounds);
+	CHECK(CopyOccluderGeometry(*wall));
+	CHECK(wall->occluderPositions.size() == 4);
+	CHECK(all(wall->occluderPositions[0] == float3(-5.f, -5.f, 10.f)));
+	CHECK(wall->occluderIndices == std::vector<uint32_t>({ 0, 1, 2, 0, 2, 3 }));
+
+	// Data views, as set up by the baked scene loader
+	auto viewBuffers = std::make_shared<BufferGroup>();
+	const std::vector<float3> positions = makeBuffers()->positionData;
+	const std::vector<uint32_t> indices = makeBuffers()->indexData;
+	viewBuffers->indexDataView = indices.data();
+	viewBuffers->indexCount = indices.size();
+	viewBuffers->vertexDataViews[size_t(VertexAttribute::Position)] = positions.data();
+	viewBuffers->getVertexBufferRange(VertexAttribute::Position).byteSize = positions.size() * sizeof(float3);
+	auto viewWall = makeMesh(viewBuffers, material, 3, 4, 3, 6, bounds);
+	CHECK(CopyOccluderGeometry(*viewWall));
+	CHECK(viewWall->occluderPositions.size() == wall->occluderPositions.size());
+	for (size_t i = 0; i < wall->occluderPositions.size(); i++)
+		CHECK(all(viewWall->occluderPositions[i] == wall->occluderPositions[i]));
+	CHECK(viewWall->occluderIndices == wall->occluderIndices);
+
+	// The mesh range goes past the end of the data
+	auto invalid = makeMesh(buffers, material, 4, 4, 3, 6, bounds);
+	CHECK(!CopyOccluderGeometry(*invalid));
+	CHECK(invalid->occluderIndices.empty());
+
+	releaseCpuData(*buffers);
+	CHECK(!CopyOccluderGeometry(*invalid));
+}
+
+static uint32_t countItems(OcclusionCullingDrawStrategy& strategy)
+{
+	uint32_t count = 0;
+	while (strategy.GetNextItem())
+		++count;
+	return count;
+}
+
+void test_occlusion_culling_strategy(bool keepOccluderGeometry)
+{
+	auto material = std::make_shared<Material>();
+	auto buffers = makeBuffers();
+	auto wall = makeMesh(buffers, material, 3, 4, 3, 6, box3(float3(-5.f, -5.f, 10.f), float3(5.f, 5.f, 10.f)));
+	auto triangle = makeMesh(buffers, material, 0, 3, 0, 3, box3(float3(-0.5f, -0.5f, 0.f), float3(0.5f, 0.5f, 0.f)));
+
+	// What Scene::CreateMeshBuffers does with SetKeepOccluderGeometry enabled or disabled
+	if (keepOccluderGeometry)
+		CHECK(CopyOccluderGeometry(*wall));
+	releaseCpuData(*buffers);
+
+	auto graph = std::make_shared<SceneGraph>();
+	auto root = std::make_shared<SceneGraphNode>();
+	graph->SetRootNode(root);
+
+	auto wallNode = std::make_shared<SceneGraphNode>();
+	wallNode->SetLeaf(std::make_shared<MeshInstance>(wall));
+	graph->Attach(root, wallNode);
+
+	// One triangle behind the wall and one beside it
+	auto hiddenNode = std::make_shared<SceneGraphNode>();
+	hiddenNode->SetLeaf(std::make_shared<MeshInstance>(triangle));
+	hiddenNode->SetTranslation(double3(0.0, 0.0, 20.0));
+	graph->Attach(root, hiddenNode);
+
+	auto visibleNode = std::make_shared<SceneGraphNode>();
+	visibleNode->SetLeaf(std::make_shared<MeshInstance>(triangle));
+	visibleNode->SetTranslation(double3(15.0, 0.0, 20.0));
+	graph->Attach(root, visibleNode);
+
+	graph->Refresh(0);
+
+	OcclusionCullingDrawStrategy strategy;
+	strategy.SetOccluderMesh(wall.get(), true);
+	strategy.PrepareForView(root, makeView(256, 128, radians(90.f)));
+
+	const OcclusionCullingStats& stats = strategy.GetStats();
+	CHECK(stats.candidates == 3);
+
+	if (keepOccluderGeometry)
+	{
+		CHECK(stats.occluders == 1);
+		CHECK(stats.occluderTriangles == 2);
+		CHECK(stats.culled == 1);
+		CHECK(countItems(strategy) == 2);
+	}
+	else
+	{
+		// Without the copy, the mesh has no CPU data left and can't be an occluder
+		CHECK(stats.occluders == 0);
+		CHECK(stats.culled == 0);
+		CHECK(countItems(strategy) == 3);
+	}
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_copy_occluder_geometry();
+		test_occlusion_culling_strategy(true);
+		test_occlusion_culling_strategy(false);
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,166 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/render/ParallelViewRecorder.h>
+#include <donut/tests/utils.h>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace donut;
+using namespace donut::render;
+
+static void checkTask(const ParallelViewRecorder::Task& task, uint32_t viewIndex, size_t firstItem, size_t numItems)
+{
+	CHECK(task.viewIndex == viewIndex);
+	CHECK(task.firstItem == firstItem);
+	CHECK(task.numItems == numItems);
+}
+
+void test_split_into_tasks()
+{
+	std::vector<ParallelViewRecorder::Task> tasks;
+
+	// Views without items still get a task
+	ParallelViewRecorder::SplitIntoTasks({ 5, 0, 3 }, 2, tasks);
+	CHECK(tasks.size() == 6);
+	checkTask(tasks[0], 0, 0, 2);
+	checkTask(tasks[1], 0, 2, 2);
+	checkTask(tasks[2], 0, 4, 1);
+	checkTask(tasks[3], 1, 0, 0);
+	checkTask(tasks[4], 2, 0, 2);
+	checkTask(tasks[5], 2, 2, 1);
+
+	// One task per view
+	ParallelViewRecorder::SplitIntoTasks({ 5, 0, 3 }, 0, tasks);
+	CHECK(tasks.size() == 3);
+	checkTask(tasks[0], 0, 0, 5);
+	checkTask(tasks[1], 1, 0, 0);
+	checkTask(tasks[2], 2, 0, 3);
+
+	ParallelViewRecorder::SplitIntoTasks({ 4 }, 4, tasks);
+	CHECK(tasks.size() == 1);
+	checkTask(tasks[0], 0, 0, 4);
+}
+
+static void checkRunParallel(tf::Executor* executor, uint32_t maxThreads, size_t count)
+{
+	std::vector<std::atomic<int>> calls(count);
+	for (auto& value : calls)
+		value = 0;
+
+	uint32_t threads = ParallelViewRecorder::RunParallel(executor, maxThreads, count, [&calls](size_t index)
+	{
+		++calls[index];
+	});
+
+	for (const auto& value : calls)
+		CHECK(value == 1);
+
+	// The helpers may start after the calling thread has done all the work, so only the upper limit is known
+	uint32_t maxExpected = 0;
+	if (count > 0)
+		maxExpected = executor ? uint32_t(std::min<size_t>(std::max(maxThreads, 1u), count)) : 1;
+	CHECK(threads <= maxExpected);
+	CHECK(threads >= std::min<uint32_t>(maxExpected, 1));
+}
+
+void test_run_parallel()
+{
+	checkRunParallel(nullptr, 8, 100);
+	checkRunParallel(nullptr, 8, 0);
+
+#ifdef DONUT_WITH_TASKFLOW
+	tf::Executor executor(4);
+	for (uint32_t threads : { 0u, 1u, 2u, 4u, 8u })
+	{
+		checkRunParallel(&executor, threads, 0);
+		checkRunParallel(&executor, threads, 3);
+		checkRunParallel(&executor, threads, 1000);
+	}
+#endif
+}
+
+void test_run_parallel_concurrency()
+{
+#ifdef DONUT_WITH_TASKFLOW
+	// Every call waits until all of them have started, so the reported number of threads must be the real one.
+	// The wait has a time limit, so that a helper that never starts fails the test instead of hanging it.
+	tf::Executor executor(4);
+	const size_t count = 4;
+	std::atomic<size_t> started = 0;
+
+	uint32_t threads = ParallelViewRecorder::RunParallel(&executor, 4, count, [&started, count](size_t)
+	{
+		++started;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (started.load() < count && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::yield();
+	});
+
+	CHECK(threads == count);
+
+	// Serial loops never overlap
+	threads = ParallelViewRecorder::RunParallel(&executor, 1, 100, [](size_t) { });
+	CHECK(threads == 1);
+#endif
+}
+
+void test_run_parallel_from_workers()
+{
+#ifdef DONUT_WITH_TASKFLOW
+	// Every worker is busy with a task that waits for its own parallel loop, which must not deadlock
+	tf::Executor executor(2);
+	std::atomic<size_t> total = 0;
+
+	tf::Taskflow taskflow;
+	taskflow.for_each_index(0, 8, 1, [&executor, &total](int)
+	{
+		ParallelViewRecorder::RunParallel(&executor, 4, 100, [&total](size_t) { ++total; });
+	});
+	executor.run(taskflow).wait();
+
+	CHECK(total == 800);
+#endif
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_split_into_tasks();
+		test_run_parallel();
+		test_run_parallel_concurrency();
+		test_run_parallel_from_workers();
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,195 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/render/ShadowMapCache.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/SceneTypes.h>
+#include <donut/tests/utils.h>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+using CascadeReuse = ShadowMapCache::CascadeReuse;
+
+// A 256x256 cascade that covers 64x64 units, so the texels are 0.25 units wide
+static const int2 CascadeSize = int2(256);
+static const float TexelSize = 0.25f;
+
+static float4x4 makeProjection()
+{
+	return orthoProjD3DStyle(-32.f, 32.f, -32.f, 32.f, -50.f, 50.f);
+}
+
+static ShadowMapCache::CascadeState makeState()
+{
+	ShadowMapCache::CascadeState state;
+	state.valid = true;
+	state.viewMatrix = translation(float3(10.f, 20.f, 30.f));
+	state.projection = makeProjection();
+	return state;
+}
+
+static CascadeReuse classify(const ShadowMapCache::CascadeState& state, const affine3& viewMatrix, int2& texelOffset,
+	bool allowScrolling = true, const float4x4& projection = makeProjection())
+{
+	return ShadowMapCache::ClassifyCascade(state, viewMatrix, projection, CascadeSize, allowScrolling, texelOffset);
+}
+
+void test_is_whole_number()
+{
+	int result = 0;
+	CHECK(ShadowMapCache::IsWholeNumber(3.f, result) && result == 3);
+	CHECK(ShadowMapCache::IsWholeNumber(-2.995f, result) && result == -3);
+	CHECK(ShadowMapCache::IsWholeNumber(0.004f, result) && result == 0);
+	CHECK(!ShadowMapCache::IsWholeNumber(1.5f, result));
+	CHECK(!ShadowMapCache::IsWholeNumber(-7.02f, result));
+}
+
+void test_classify_cascade()
+{
+	const ShadowMapCache::CascadeState state = makeState();
+	const affine3 viewMatrix = state.viewMatrix;
+	int2 texelOffset = 0;
+
+	CHECK(classify(state, viewMatrix, texelOffset) == CascadeReuse::Hit);
+	CHECK(all(texelOffset == 0));
+
+	// Moves by less than the tolerance are hits
+	CHECK(classify(state, translation(float3(TexelSize * 0.001f, 0.f, 0.f)) * viewMatrix, texelOffset, false) == CascadeReuse::Hit);
+
+	// Whole texels: the static content moves with the view translation, but rows go down in the texture, so an
+	// upward move gives a negative row offset
+	CHECK(classify(state, translation(float3(TexelSize * 3.f, 0.f, 0.f)) * viewMatrix, texelOffset) == CascadeReuse::Scroll);
+	CHECK(all(texelOffset == int2(3, 0)));
+
+	CHECK(classify(state, translation(float3(-TexelSize * 2.f, TexelSize * 5.f, 0.f)) * viewMatrix, texelOffset) == CascadeReuse::Scroll);
+	CHECK(all(texelOffset == int2(-2, -5)));
+
+	// The same move without scrolling support
+	CHECK(classify(state, translation(float3(TexelSize * 3.f, 0.f, 0.f)) * viewMatrix, texelOffset, false) == CascadeReuse::Miss);
+	CHECK(all(texelOffset == 0));
+
+	// Fractions of texels
+	CHECK(classify(state, translation(float3(TexelSize * 0.5f, 0.f, 0.f)) * viewMatrix, texelOffset) == CascadeReuse::Miss);
+
+	// Depth changes
+	CHECK(classify(state, translation(float3(0.f, 0.f, 1.f)) * viewMatrix, texelOffset) == CascadeReuse::Miss);
+
+	// Moves by the whole cascade or more leave nothing to reuse
+	CHECK(classify(state, translation(float3(TexelSize * float(CascadeSize.x), 0.f, 0.f)) * viewMatrix, texelOffset) == CascadeReuse::Miss);
+	CHECK(classify(state, translation(float3(TexelSize * float(CascadeSize.x - 1), 0.f, 0.f)) * viewMatrix, texelOffset) == CascadeReuse::Scroll);
+
+	// Rotations and projection changes
+	CHECK(classify(state, rotation(float3(0.f, 0.f, 1.f), 0.1f) * viewMatrix, texelOffset) == CascadeReuse::Miss);
+	CHECK(classify(state, viewMatrix, texelOffset, true, orthoProjD3DStyle(-16.f, 16.f, -16.f, 16.f, -50.f, 50.f)) == CascadeReuse::Miss);
+
+	// Nothing cached
+	ShadowMapCache::CascadeState invalid = state;
+	invalid.valid = false;
+	CHECK(classify(invalid, viewMatrix, texelOffset) == CascadeReuse::Miss);
+}
+
+void test_cascade_copy_slice()
+{
+	const nvrhi::Viewport viewport(256.f, 256.f);
+
+	// Vulkan copies the cascade rectangle
+	nvrhi::TextureSlice slice = ShadowMapCache::GetCascadeCopySlice(viewport, 2, uint2(256), false);
+	CHECK(slice.x == 0 && slice.y == 0);
+	CHECK(slice.width == 256 && slice.height == 256 && slice.depth == 1);
+	CHECK(slice.arraySlice == 2);
+
+	// D3D copies the whole array slice, without a box
+	slice = ShadowMapCache::GetCascadeCopySlice(viewport, 2, uint2(256), true);
+	CHECK(slice.width == uint32_t(-1) && slice.height == uint32_t(-1) && slice.depth == uint32_t(-1));
+	CHECK(slice.arraySlice == 2);
+	CHECK(slice.mipLevel == 0);
+}
+
+void test_find_moved_instances()
+{
+	auto mesh = std::make_shared<MeshInfo>();
+
+	auto graph = std::make_shared<SceneGraph>();
+	auto root = std::make_shared<SceneGraphNode>();
+	graph->SetRootNode(root);
+
+	auto group = std::make_shared<SceneGraphNode>();
+	graph->Attach(root, group);
+
+	auto staticNode = std::make_shared<SceneGraphNode>();
+	auto staticInstance = std::make_shared<MeshInstance>(mesh);
+	staticNode->SetLeaf(staticInstance);
+	graph->Attach(group, staticNode);
+
+	auto movingNode = std::make_shared<SceneGraphNode>();
+	auto movingInstance = std::make_shared<MeshInstance>(mesh);
+	movingNode->SetLeaf(movingInstance);
+	graph->Attach(group, movingNode);
+
+	std::unordered_set<const MeshInstance*> dynamicInstances;
+
+	// New nodes have their transform flags set in the first refresh, which ShadowMapCache::BeginFrame skips
+	// because the structure version changes. Nothing moves in the second one.
+	graph->Refresh(0);
+	graph->Refresh(1);
+	CHECK(!ShadowMapCache::FindMovedInstances(root.get(), dynamicInstances));
+	CHECK(dynamicInstances.empty());
+
+	movingNode->SetTranslation(double3(1.0, 0.0, 0.0));
+	graph->Refresh(2);
+	CHECK(ShadowMapCache::FindMovedInstances(root.get(), dynamicInstances));
+	CHECK(dynamicInstances.size() == 1);
+	CHECK(dynamicInstances.count(movingInstance.get()) == 1);
+
+	// Moving again: already dynamic
+	movingNode->SetTranslation(double3(2.0, 0.0, 0.0));
+	graph->Refresh(3);
+	CHECK(!ShadowMapCache::FindMovedInstances(root.get(), dynamicInstances));
+	CHECK(dynamicInstances.size() == 1);
+
+	// Moving the parent moves both instances
+	group->SetTranslation(double3(0.0, 1.0, 0.0));
+	graph->Refresh(4);
+	CHECK(ShadowMapCache::FindMovedInstances(root.get(), dynamicInstances));
+	CHECK(dynamicInstances.size() == 2);
+	CHECK(dynamicInstances.count(staticInstance.get()) == 1);
+}
+
+int main(int, char**)
+{
+	try
+	{
+		test_is_whole_number();
+		test_classify_cascade();
+		test_cascade_copy_slice();
+		test_find_moved_instances();
+	}
+	catch (const std::runtime_error& err)
+	{
+		fprintf(stderr, "%s", err.what());
+		return 1;
+	}
+	return 0;
+}
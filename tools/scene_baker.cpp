@@ -0,0 +1,89 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+Converts a glTF model into a baked scene file that BakedSceneLoader and Scene can load without any
+per-vertex processing, see BakedScene.h. The textures are not converted: the baked file refers to the
+texture files of the model, relative to its own location, so it should be written next to the model.
+
+Usage: donut_scene_baker <model.gltf|model.glb> [output.bscene]
+*/
+
+#include <donut/engine/BakedScene.h>
+#include <donut/engine/GltfImporter.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/SceneTypes.h>
+#include <donut/engine/TextureCache.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/core/log.h>
+
+using namespace donut;
+using namespace donut::engine;
+
+int main(int argc, char** argv)
+{
+    log::ConsoleApplicationMode();
+
+    if (argc < 2 || argc > 3)
+    {
+        log::info("Usage: %s <model.gltf|model.glb> [output%s]", argv[0], c_BakedSceneExtension);
+        return 1;
+    }
+
+    const std::filesystem::path inputFileName = std::filesystem::absolute(argv[1]);
+    std::filesystem::path outputFileName;
+    if (argc == 3)
+        outputFileName = std::filesystem::absolute(argv[2]);
+    else
+        outputFileName = std::filesystem::path(inputFileName).replace_extension(c_BakedSceneExtension);
+
+    if (!IsBakedSceneFile(outputFileName))
+    {
+        log::error("The output file name must have the %s extension: %s", c_BakedSceneExtension, outputFileName.generic_string().c_str());
+        return 1;
+    }
+
+    auto fs = std::make_shared<vfs::NativeFileSystem>();
+    auto sceneTypeFactory = std::make_shared<SceneTypeFactory>();
+
+    // The textures are only referenced by their file names, so they don't need a device
+    TextureCache textureCache(nullptr, fs, nullptr);
+    SceneLoadingStats stats;
+
+    // BakeScene needs the vertex data on the CPU, which it is right after the import
+    GltfImporter importer(fs, sceneTypeFactory);
+    SceneImportResult model;
+    if (!importer.Load(inputFileName, textureCache, stats, nullptr, model))
+    {
+        log::error("Couldn't load the model %s", inputFileName.generic_string().c_str());
+        return 1;
+    }
+
+    if (!BakeScene(*fs, outputFileName, model))
+    {
+        log::error("Couldn't write the baked scene %s", outputFileName.generic_string().c_str());
+        return 1;
+    }
+
+    log::info("Baked %s into %s", inputFileName.generic_string().c_str(), outputFileName.generic_string().c_str());
+    return 0;
+}